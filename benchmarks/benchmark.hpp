@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace eosio { namespace benchmark {
+
+/// runs the measured operation the given number of times
+using benchmark_function = std::function<void(uint64_t iterations)>;
+
+struct benchmark_def {
+   std::string        name;
+   benchmark_function run;
+};
+
+std::vector<benchmark_def>& registry();
+
+struct registrar {
+   registrar(const char* name, benchmark_function run) { registry().push_back({name, std::move(run)}); }
+};
+
+/// keeps the compiler from discarding a result nothing else reads
+template<typename T>
+inline void do_not_optimize(const T& value) {
+   asm volatile("" : : "r,m"(value) : "memory");
+}
+
+} } /// eosio::benchmark
+
+/**
+ * Defines a benchmark, the body runs the operation `iterations` times, e.g.
+ *    EOSIO_BENCHMARK(transaction_id) {
+ *       for(uint64_t i = 0; i < iterations; ++i)
+ *          do_not_optimize(trx.id());
+ *    }
+ * Setup placed in front of the loop is not measured separately, keep it cheap or static.
+ */
+#define EOSIO_BENCHMARK(NAME) \
+   static void NAME(uint64_t iterations); \
+   static ::eosio::benchmark::registrar NAME##_registrar(#NAME, NAME); \
+   static void NAME(uint64_t iterations)
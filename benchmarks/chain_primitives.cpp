@@ -0,0 +1,216 @@
+/**
+ * Hot primitives of block production and validation, on inputs sized after busy mainnet blocks: a thousand
+ * transfers per block, a tree of the block ids of a 150M block chain, the 15 of 21 producer multisig.
+ */
+#include "benchmark.hpp"
+
+#include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/authority_checker.hpp>
+#include <eosio/chain/block.hpp>
+#include <eosio/chain/incremental_merkle.hpp>
+#include <eosio/chain/merkle.hpp>
+#include <eosio/chain/transaction.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <contracts.hpp>
+
+#include <bitset>
+#include <map>
+
+using namespace eosio::benchmark;
+using namespace eosio::chain;
+using eosio::testing::contracts;
+
+namespace {
+
+constexpr uint32_t block_transactions = 1000;
+constexpr uint64_t chain_blocks = 150'000'000;
+
+digest_type leaf(uint64_t i) {
+   return digest_type::hash(i);
+}
+
+struct transfer {
+   name   from;
+   name   to;
+   asset  quantity;
+   string memo;
+};
+
+}
+
+FC_REFLECT( transfer, (from)(to)(quantity)(memo) )
+
+namespace {
+
+const fc::crypto::private_key& signing_key() {
+   static const auto key = fc::crypto::private_key::regenerate(fc::sha256::hash(std::string("benchmark")));
+   return key;
+}
+
+signed_transaction make_transfer(uint32_t i) {
+   signed_transaction trx;
+   trx.expiration = fc::time_point_sec(1600000000);
+   trx.ref_block_num = 1234;
+   trx.ref_block_prefix = 0x12345678;
+   trx.actions.emplace_back(vector<permission_level>{{N(alice), config::active_name}}, N(eosio.token), N(transfer),
+                            fc::raw::pack(transfer{N(alice), N(bob), asset(10000 + i, symbol(4, "EOS")), "benchmark " + std::to_string(i)}));
+   trx.sign(signing_key(), chain_id_type(digest_type::hash(std::string("chain"))));
+   return trx;
+}
+
+const signed_block& mainnet_block() {
+   static const signed_block block = [] {
+      signed_block b;
+      b.timestamp = block_timestamp_type(fc::time_point_sec(1600000000));
+      b.producer = N(producer1111);
+      b.previous = block_id_type(leaf(1));
+      b.transaction_mroot = leaf(2);
+      b.action_mroot = leaf(3);
+      b.producer_signature = signing_key().sign(leaf(4));
+      for(uint32_t i = 0; i < block_transactions; ++i) {
+         transaction_receipt r(packed_transaction(make_transfer(i)));
+         r.status = transaction_receipt_header::executed;
+         r.cpu_usage_us = 150;
+         r.net_usage_words = 16;
+         b.transactions.push_back(std::move(r));
+      }
+      return b;
+   }();
+   return block;
+}
+
+const abi_serializer& abi(const std::vector<char>& json) {
+   static std::map<const void*, abi_serializer> serializers;
+   auto it = serializers.find(&json);
+   if(it == serializers.end())
+      it = serializers.emplace(&json, abi_serializer(fc::json::from_string(json.data()).as<abi_def>(),
+                                                     abi_serializer::create_yield_function(fc::seconds(10)))).first;
+   return it->second;
+}
+
+const std::vector<char>& token_abi() {
+   static const auto a = contracts::eosio_token_abi();
+   return a;
+}
+
+const std::vector<char>& system_abi() {
+   static const auto a = contracts::eosio_system_abi();
+   return a;
+}
+
+fc::variant voteproducer_args() {
+   vector<name> producers;
+   for(uint32_t i = 0; i < 30; ++i)
+      producers.push_back(name("producer" + std::string(1, 'a' + i % 26) + std::string(1, '1' + i / 26) + "11"));
+   return fc::mutable_variant_object()("voter", "alice")("proxy", "")("producers", producers);
+}
+
+}
+
+EOSIO_BENCHMARK(merkle_1000_leaves) {
+   vector<digest_type> ids;
+   for(uint32_t i = 0; i < block_transactions; ++i)
+      ids.push_back(leaf(i));
+   for(uint64_t i = 0; i < iterations; ++i)
+      do_not_optimize(merkle(ids));
+}
+
+EOSIO_BENCHMARK(incremental_merkle_append_150M) {
+   // the values of the active nodes don't change the work of append, only their number does
+   incremental_merkle m;
+   m._node_count = chain_blocks;
+   m._active_nodes.assign(std::bitset<64>(chain_blocks).count() + 1, leaf(0));
+   const auto id = leaf(1);
+   for(uint64_t i = 0; i < iterations; ++i)
+      do_not_optimize(m.append(id));
+}
+
+EOSIO_BENCHMARK(pack_signed_block_1000_trx) {
+   const auto& block = mainnet_block();
+   for(uint64_t i = 0; i < iterations; ++i)
+      do_not_optimize(fc::raw::pack(block));
+}
+
+EOSIO_BENCHMARK(unpack_signed_block_1000_trx) {
+   static const auto packed = fc::raw::pack(mainnet_block());
+   for(uint64_t i = 0; i < iterations; ++i) {
+      signed_block b;
+      fc::datastream<const char*> ds(packed.data(), packed.size());
+      fc::raw::unpack(ds, b);
+      do_not_optimize(b);
+   }
+}
+
+EOSIO_BENCHMARK(signed_block_id_1000_trx) {
+   const auto& block = mainnet_block();
+   for(uint64_t i = 0; i < iterations; ++i)
+      do_not_optimize(block.id());
+}
+
+EOSIO_BENCHMARK(transaction_id_transfer) {
+   static const signed_transaction trx = make_transfer(0);
+   for(uint64_t i = 0; i < iterations; ++i)
+      do_not_optimize(trx.id());
+}
+
+EOSIO_BENCHMARK(abi_variant_to_binary_transfer) {
+   const auto& ser = abi(token_abi());
+   const fc::variant args = fc::mutable_variant_object()("from", "alice")("to", "bob")("quantity", "1.0000 EOS")("memo", "benchmark");
+   for(uint64_t i = 0; i < iterations; ++i)
+      do_not_optimize(ser.variant_to_binary("transfer", args, abi_serializer::create_yield_function(fc::seconds(1))));
+}
+
+EOSIO_BENCHMARK(abi_binary_to_variant_transfer) {
+   const auto& ser = abi(token_abi());
+   const auto data = fc::raw::pack(transfer{N(alice), N(bob), asset(10000, symbol(4, "EOS")), "benchmark"});
+   for(uint64_t i = 0; i < iterations; ++i)
+      do_not_optimize(ser.binary_to_variant("transfer", data, abi_serializer::create_yield_function(fc::seconds(1))));
+}
+
+EOSIO_BENCHMARK(abi_variant_to_binary_voteproducer_30) {
+   const auto& ser = abi(system_abi());
+   const auto args = voteproducer_args();
+   for(uint64_t i = 0; i < iterations; ++i)
+      do_not_optimize(ser.variant_to_binary("voteproducer", args, abi_serializer::create_yield_function(fc::seconds(1))));
+}
+
+EOSIO_BENCHMARK(abi_binary_to_variant_voteproducer_30) {
+   const auto& ser = abi(system_abi());
+   const auto data = ser.variant_to_binary("voteproducer", voteproducer_args(), abi_serializer::create_yield_function(fc::seconds(1)));
+   for(uint64_t i = 0; i < iterations; ++i)
+      do_not_optimize(ser.binary_to_variant("voteproducer", data, abi_serializer::create_yield_function(fc::seconds(1))));
+}
+
+EOSIO_BENCHMARK(authority_checker_single_key) {
+   const auto key = signing_key().get_public_key();
+   const authority auth(key);
+   const flat_set<public_key_type> provided{key};
+   auto pta = [&](const permission_level&) -> authority { return auth; };
+   for(uint64_t i = 0; i < iterations; ++i) {
+      auto checker = make_auth_checker(pta, 6, provided);
+      do_not_optimize(checker.satisfied(auth));
+   }
+}
+
+EOSIO_BENCHMARK(authority_checker_producers_15_of_21) {
+   // eosio@active is satisfied by 15 of the active permissions of the 21 producers, each a single key
+   std::map<permission_level, authority> authorities;
+   flat_set<public_key_type> provided;
+   authority eosio_active(15, {}, {});
+   for(uint32_t i = 0; i < 21; ++i) {
+      const name producer("producer" + std::string(1, 'a' + i) + "111");
+      const auto key = fc::crypto::private_key::regenerate(fc::sha256::hash(producer.to_string())).get_public_key();
+      authorities[{producer, config::active_name}] = authority(key);
+      eosio_active.accounts.push_back({{producer, config::active_name}, 1});
+      if(i < 15)
+         provided.insert(key);
+   }
+   auto pta = [&](const permission_level& p) -> authority { return authorities.at(p); };
+   for(uint64_t i = 0; i < iterations; ++i) {
+      auto checker = make_auth_checker(pta, 6, provided);
+      do_not_optimize(checker.satisfied(eosio_active));
+   }
+}
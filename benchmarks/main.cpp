@@ -0,0 +1,156 @@
+/**
+ * Runs the benchmarks of this directory. Each benchmark is calibrated to run for at least --min-time-ms, then
+ * measured --repetitions times, the median time per operation is reported. --json writes the results as
+ *    {"benchmarks":[{"name":...,"iterations":...,"ns_per_op":...,"min_ns_per_op":...,"max_ns_per_op":...}]}
+ * which --baseline reads back to compare a branch against, failing when a benchmark got slower than --threshold.
+ */
+#include "benchmark.hpp"
+
+#include <fc/io/json.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <regex>
+
+namespace eosio { namespace benchmark {
+
+std::vector<benchmark_def>& registry() {
+   static std::vector<benchmark_def> benchmarks;
+   return benchmarks;
+}
+
+struct benchmark_result {
+   std::string name;
+   uint64_t    iterations = 0;
+   double      ns_per_op = 0;      ///< median of the repetitions
+   double      min_ns_per_op = 0;
+   double      max_ns_per_op = 0;
+};
+
+struct benchmark_results {
+   std::vector<benchmark_result> benchmarks;
+};
+
+} } /// eosio::benchmark
+
+FC_REFLECT( eosio::benchmark::benchmark_result, (name)(iterations)(ns_per_op)(min_ns_per_op)(max_ns_per_op) )
+FC_REFLECT( eosio::benchmark::benchmark_results, (benchmarks) )
+
+using namespace eosio::benchmark;
+namespace bpo = boost::program_options;
+
+namespace {
+
+double elapsed_ns(const benchmark_def& b, uint64_t iterations) {
+   const auto start = std::chrono::steady_clock::now();
+   b.run(iterations);
+   return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+benchmark_result measure(const benchmark_def& b, std::chrono::milliseconds min_time, uint32_t repetitions) {
+   // the first run also warms up caches and lazily built inputs
+   uint64_t iterations = 1;
+   double ns = elapsed_ns(b, iterations);
+   const double target = std::chrono::duration<double, std::nano>(min_time).count();
+   while(ns < target && iterations < (1ull << 40)) {
+      const double factor = ns > 0 ? std::min(10.0, std::max(2.0, 1.2 * target / ns)) : 10.0;
+      iterations = std::max<uint64_t>(iterations + 1, iterations * factor);
+      ns = elapsed_ns(b, iterations);
+   }
+
+   std::vector<double> per_op;
+   per_op.push_back(ns / iterations);
+   for(uint32_t r = 1; r < repetitions; ++r)
+      per_op.push_back(elapsed_ns(b, iterations) / iterations);
+   std::sort(per_op.begin(), per_op.end());
+
+   benchmark_result result;
+   result.name = b.name;
+   result.iterations = iterations;
+   result.ns_per_op = per_op[per_op.size() / 2];
+   result.min_ns_per_op = per_op.front();
+   result.max_ns_per_op = per_op.back();
+   return result;
+}
+
+}
+
+int main(int argc, char** argv) {
+   try {
+      bpo::options_description opts("chain_benchmarks");
+      opts.add_options()
+         ("filter", bpo::value<std::string>()->default_value(".*"), "Regular expression the names of the benchmarks run must match")
+         ("min-time-ms", bpo::value<uint32_t>()->default_value(200), "Minimum duration of each repetition")
+         ("repetitions", bpo::value<uint32_t>()->default_value(5), "Repetitions of each benchmark, the median is reported")
+         ("json", bpo::value<std::string>(), "Write the results to this file")
+         ("baseline", bpo::value<std::string>(), "Compare against the results of a previous --json")
+         ("threshold", bpo::value<double>()->default_value(10.0), "Percentage a benchmark may be slower than the baseline")
+         ("list", "List the benchmarks")
+         ("help,h", "Print this help");
+      bpo::variables_map vm;
+      bpo::store(bpo::parse_command_line(argc, argv, opts), vm);
+      bpo::notify(vm);
+      if(vm.count("help")) {
+         std::cout << opts << std::endl;
+         return 0;
+      }
+
+      auto benchmarks = registry();
+      std::sort(benchmarks.begin(), benchmarks.end(), [](const auto& a, const auto& b) { return a.name < b.name; });
+      if(vm.count("list")) {
+         for(const auto& b : benchmarks)
+            std::cout << b.name << std::endl;
+         return 0;
+      }
+
+      std::map<std::string, benchmark_result> baseline;
+      if(vm.count("baseline")) {
+         for(auto& r : fc::json::from_file(vm.at("baseline").as<std::string>()).as<benchmark_results>().benchmarks)
+            baseline[r.name] = r;
+      }
+
+      const std::regex filter(vm.at("filter").as<std::string>());
+      const std::chrono::milliseconds min_time(vm.at("min-time-ms").as<uint32_t>());
+      const uint32_t repetitions = std::max<uint32_t>(1, vm.at("repetitions").as<uint32_t>());
+      const double threshold = vm.at("threshold").as<double>();
+
+      benchmark_results results;
+      bool regressed = false;
+      std::cout << std::left << std::setw(44) << "benchmark" << std::right << std::setw(16) << "ns/op"
+                << std::setw(16) << "iterations" << (baseline.empty() ? "" : "      vs baseline") << std::endl;
+      for(const auto& b : benchmarks) {
+         if(!std::regex_search(b.name, filter))
+            continue;
+         const auto r = measure(b, min_time, repetitions);
+         results.benchmarks.push_back(r);
+
+         std::cout << std::left << std::setw(44) << r.name << std::right << std::fixed << std::setprecision(1)
+                   << std::setw(16) << r.ns_per_op << std::setw(16) << r.iterations;
+         auto base = baseline.find(r.name);
+         if(base != baseline.end() && base->second.ns_per_op > 0) {
+            const double change = 100.0 * (r.ns_per_op - base->second.ns_per_op) / base->second.ns_per_op;
+            std::cout << std::setw(16) << std::showpos << change << std::noshowpos << '%';
+            if(change > threshold) {
+               std::cout << "  REGRESSION";
+               regressed = true;
+            }
+         }
+         std::cout << std::endl;
+      }
+
+      if(vm.count("json"))
+         fc::json::save_to_file(results, vm.at("json").as<std::string>(), true);
+      return regressed ? 1 : 0;
+   } catch(const fc::exception& e) {
+      std::cerr << e.to_detail_string() << std::endl;
+   } catch(const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+   }
+   return 2;
+}
@@ -1,6 +1,7 @@
 #include <eosio/chain/abi_serializer.hpp>
 #include <eosio/chain/asset.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <fc/io/json.hpp>
 #include <fc/io/raw.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <fc/io/varint.hpp>
@@ -82,9 +83,112 @@ namespace eosio { namespace chain {
       set_abi(abi, max_serialization_time);
    }
 
+   abi_serializer::abi_serializer( const abi_serializer& other )
+   : typedefs( other.typedefs ), structs( other.structs ), actions( other.actions ), tables( other.tables ),
+     error_messages( other.error_messages ), variants( other.variants ), built_in_types( other.built_in_types ) {
+      compile_type_plans();
+   }
+
+   abi_serializer::abi_serializer( abi_serializer&& other )
+   : typedefs( std::move(other.typedefs) ), structs( std::move(other.structs) ), actions( std::move(other.actions) ),
+     tables( std::move(other.tables) ), error_messages( std::move(other.error_messages) ), variants( std::move(other.variants) ),
+     built_in_types( std::move(other.built_in_types) ) {
+      compile_type_plans();
+      other.type_plans.clear();
+   }
+
+   abi_serializer& abi_serializer::operator=( const abi_serializer& other ) {
+      if( this != &other ) {
+         abi_serializer copy( other );
+         *this = std::move( copy );
+      }
+      return *this;
+   }
+
+   abi_serializer& abi_serializer::operator=( abi_serializer&& other ) {
+      if( this != &other ) {
+         typedefs       = std::move( other.typedefs );
+         structs        = std::move( other.structs );
+         actions        = std::move( other.actions );
+         tables         = std::move( other.tables );
+         error_messages = std::move( other.error_messages );
+         variants       = std::move( other.variants );
+         built_in_types = std::move( other.built_in_types );
+         compile_type_plans();
+         other.type_plans.clear();
+      }
+      return *this;
+   }
+
    void abi_serializer::add_specialized_unpack_pack( const string& name,
                                                      std::pair<abi_serializer::unpack_function, abi_serializer::pack_function> unpack_pack ) {
       built_in_types[name] = std::move( unpack_pack );
+      compile_type_plans();
+   }
+
+   abi_serializer::type_plan abi_serializer::make_type_plan( const std::string_view& type )const {
+      type_plan plan;
+      plan.rtype        = resolve_type( type );
+      plan.ftype        = fundamental_type( plan.rtype );
+      plan.array        = is_array( plan.rtype );
+      plan.optional     = is_optional( plan.rtype );
+      plan.built_in_itr = built_in_types.find( plan.ftype );
+      plan.variant_itr  = variants.find( plan.rtype );
+      plan.struct_itr   = structs.find( plan.rtype );
+      return plan;
+   }
+
+   abi_serializer::type_plan abi_serializer::get_type_plan( const std::string_view& type )const {
+      auto itr = type_plans.find( type );
+      if( itr != type_plans.end() )
+         return itr->second;
+      return make_type_plan( type );
+   }
+
+   void abi_serializer::compile_type_plans() {
+      type_plans.clear();
+      // keys are copied into the plan map first, the plans refer to the key strings or the typedefs
+      auto add = [&]( const std::string_view& t ) {
+         if( type_plans.find( t ) == type_plans.end() )
+            type_plans.emplace( type_name( t ), type_plan() );
+      };
+      for( const auto& td : typedefs ) {
+         add( td.first );
+         add( td.second );
+      }
+      for( const auto& st : structs ) {
+         add( st.first );
+         if( st.second.base != type_name() )
+            add( st.second.base );
+         for( const auto& field : st.second.fields )
+            add( _remove_bin_extension( field.type ) );
+      }
+      for( const auto& v : variants ) {
+         add( v.first );
+         for( const auto& t : v.second.types )
+            add( t );
+      }
+      for( const auto& a : actions )
+         add( a.second );
+      for( const auto& t : tables )
+         add( t.second );
+      // element types of arrays and optionals, until no new type is added
+      for( bool added = true; added; ) {
+         vector<std::string_view> elements;
+         for( const auto& p : type_plans ) {
+            auto rtype = resolve_type( p.first );
+            if( is_array( rtype ) || is_optional( rtype ) ) {
+               auto element = fundamental_type( rtype );
+               if( type_plans.find( element ) == type_plans.end() )
+                  elements.emplace_back( element );
+            }
+         }
+         for( const auto& e : elements )
+            add( e );
+         added = !elements.empty();
+      }
+      for( auto& p : type_plans )
+         p.second = make_type_plan( p.first );
    }
 
    void abi_serializer::configure_built_in_types() {
@@ -135,6 +239,7 @@ namespace eosio { namespace chain {
 
       EOS_ASSERT(starts_with(abi.version, "eosio::abi/1."), unsupported_abi_version_exception, "ABI has an unsupported version");
 
+      type_plans.clear();
       typedefs.clear();
       structs.clear();
       actions.clear();
@@ -175,6 +280,7 @@ namespace eosio { namespace chain {
       EOS_ASSERT( variants.size() == abi.variants.value.size(), duplicate_abi_variant_def_exception, "duplicate variant definition detected" );
 
       validate(ctx);
+      compile_type_plans();
    }
 
    void abi_serializer::set_abi(const abi_def& abi, const fc::microseconds& max_serialization_time) {
@@ -319,12 +425,12 @@ namespace eosio { namespace chain {
                                             fc::mutable_variant_object& obj, impl::binary_to_variant_context& ctx )const
    {
       auto h = ctx.enter_scope();
-      auto s_itr = structs.find(type);
+      auto s_itr = get_type_plan(type).struct_itr;
       EOS_ASSERT( s_itr != structs.end(), invalid_type_inside_abi, "Unknown type ${type}", ("type",ctx.maybe_shorten(type)) );
       ctx.hint_struct_type_if_in_array( s_itr );
       const auto& st = s_itr->second;
       if( st.base != type_name() ) {
-         _binary_to_variant(resolve_type(st.base), stream, obj, ctx);
+         _binary_to_variant(get_type_plan(st.base).rtype, stream, obj, ctx);
       }
       bool encountered_extension = false;
       for( uint32_t i = 0; i < st.fields.size(); ++i ) {
@@ -344,7 +450,7 @@ namespace eosio { namespace chain {
 
          }
          auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = s_itr, .field_ordinal = i } );
-         obj( field.name, _binary_to_variant(resolve_type( extension ? _remove_bin_extension(field.type) : field.type ), stream, ctx) );
+         obj( field.name, _binary_to_variant(extension ? _remove_bin_extension(field.type) : std::string_view(field.type), stream, ctx) );
       }
    }
 
@@ -352,17 +458,18 @@ namespace eosio { namespace chain {
                                                    impl::binary_to_variant_context& ctx )const
    {
       auto h = ctx.enter_scope();
-      auto rtype = resolve_type(type);
-      auto ftype = fundamental_type(rtype);
-      auto btype = built_in_types.find(ftype );
+      const auto plan = get_type_plan(type);
+      const auto& rtype = plan.rtype;
+      const auto& ftype = plan.ftype;
+      auto btype = plan.built_in_itr;
       if( btype != built_in_types.end() ) {
          try {
-            return btype->second.first(stream, is_array(rtype), is_optional(rtype), ctx.get_yield_function());
+            return btype->second.first(stream, plan.array, plan.optional, ctx.get_yield_function());
          } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack ${class} type '${type}' while processing '${p}'",
-                                   ("class", is_array(rtype) ? "array of built-in" : is_optional(rtype) ? "optional of built-in" : "built-in")
+                                   ("class", plan.array ? "array of built-in" : plan.optional ? "optional of built-in" : "built-in")
                                    ("type", impl::limit_size(ftype))("p", ctx.get_path_string()) )
       }
-      if ( is_array(rtype) ) {
+      if ( plan.array ) {
          ctx.hint_array_type_if_in_array();
          fc::unsigned_int size;
          try {
@@ -385,14 +492,14 @@ namespace eosio { namespace chain {
                      "packed size does not match unpacked array size, packed size ${p} actual size ${a}",
                      ("p", size)("a", vars.size()) );
          return fc::variant( std::move(vars) );
-      } else if ( is_optional(rtype) ) {
+      } else if ( plan.optional ) {
          char flag;
          try {
             fc::raw::unpack(stream, flag);
          } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack presence flag of optional '${p}'", ("p", ctx.get_path_string()) )
          return flag ? _binary_to_variant(ftype, stream, ctx) : fc::variant();
       } else {
-         auto v_itr = variants.find(rtype);
+         auto v_itr = plan.variant_itr;
          if( v_itr != variants.end() ) {
             ctx.hint_variant_type_if_in_array( v_itr );
             fc::unsigned_int select;
@@ -413,6 +520,120 @@ namespace eosio { namespace chain {
       return fc::variant( std::move(mvo) );
    }
 
+   namespace {
+      void append_json( std::string& out, const fc::variant& v ) {
+         out += fc::json::to_string( v, fc::time_point::maximum() );
+      }
+   }
+
+   uint32_t abi_serializer::_binary_to_json_fields( const std::string_view& type, fc::datastream<const char *>& stream,
+                                                    std::string& out, impl::binary_to_variant_context& ctx )const
+   {
+      auto h = ctx.enter_scope();
+      auto s_itr = get_type_plan(type).struct_itr;
+      EOS_ASSERT( s_itr != structs.end(), invalid_type_inside_abi, "Unknown type ${type}", ("type",ctx.maybe_shorten(type)) );
+      ctx.hint_struct_type_if_in_array( s_itr );
+      const auto& st = s_itr->second;
+      uint32_t written = 0;
+      if( st.base != type_name() ) {
+         written = _binary_to_json_fields(get_type_plan(st.base).rtype, stream, out, ctx);
+      }
+      bool encountered_extension = false;
+      for( uint32_t i = 0; i < st.fields.size(); ++i ) {
+         const auto& field = st.fields[i];
+         bool extension = ends_with(field.type, "$");
+         encountered_extension |= extension;
+         if( !stream.remaining() ) {
+            if( extension ) {
+               continue;
+            }
+            if( encountered_extension ) {
+               EOS_THROW( abi_exception, "Encountered field '${f}' without binary extension designation while processing struct '${p}'",
+                          ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+            }
+            EOS_THROW( unpack_exception, "Stream unexpectedly ended; unable to unpack field '${f}' of struct '${p}'",
+                       ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+
+         }
+         auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = s_itr, .field_ordinal = i } );
+         if( written++ > 0 ) out += ',';
+         append_json( out, fc::variant(field.name) );
+         out += ':';
+         _binary_to_json(extension ? _remove_bin_extension(field.type) : std::string_view(field.type), stream, out, ctx);
+      }
+      return written;
+   }
+
+   bool abi_serializer::_binary_to_json( const std::string_view& type, fc::datastream<const char *>& stream,
+                                         std::string& out, impl::binary_to_variant_context& ctx )const
+   {
+      auto h = ctx.enter_scope();
+      const auto plan = get_type_plan(type);
+      const auto& rtype = plan.rtype;
+      const auto& ftype = plan.ftype;
+      auto btype = plan.built_in_itr;
+      if( btype != built_in_types.end() ) {
+         fc::variant v;
+         try {
+            v = btype->second.first(stream, plan.array, plan.optional, ctx.get_yield_function());
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack ${class} type '${type}' while processing '${p}'",
+                                   ("class", plan.array ? "array of built-in" : plan.optional ? "optional of built-in" : "built-in")
+                                   ("type", impl::limit_size(ftype))("p", ctx.get_path_string()) )
+         append_json( out, v );
+         return !v.is_null();
+      }
+      if ( plan.array ) {
+         ctx.hint_array_type_if_in_array();
+         fc::unsigned_int size;
+         try {
+            fc::raw::unpack(stream, size);
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack size of array '${p}'", ("p", ctx.get_path_string()) )
+         out += '[';
+         auto h1 = ctx.push_to_path( impl::array_index_path_item{} );
+         for( decltype(size.value) i = 0; i < size; ++i ) {
+            ctx.set_array_index_of_path_back(i);
+            if( i > 0 ) out += ',';
+            bool not_null = _binary_to_json(ftype, stream, out, ctx);
+            EOS_ASSERT( not_null, unpack_exception, "Invalid packed array '${p}'", ("p", ctx.get_path_string()) );
+         }
+         out += ']';
+         return true;
+      } else if ( plan.optional ) {
+         char flag;
+         try {
+            fc::raw::unpack(stream, flag);
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack presence flag of optional '${p}'", ("p", ctx.get_path_string()) )
+         if( flag )
+            return _binary_to_json(ftype, stream, out, ctx);
+         out += "null";
+         return false;
+      } else {
+         auto v_itr = plan.variant_itr;
+         if( v_itr != variants.end() ) {
+            ctx.hint_variant_type_if_in_array( v_itr );
+            fc::unsigned_int select;
+            try {
+               fc::raw::unpack(stream, select);
+            } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack tag of variant '${p}'", ("p", ctx.get_path_string()) )
+            EOS_ASSERT( (size_t)select < v_itr->second.types.size(), unpack_exception,
+                        "Unpacked invalid tag (${select}) for variant '${p}'", ("select", select.value)("p",ctx.get_path_string()) );
+            auto h1 = ctx.push_to_path( impl::variant_path_item{ .variant_itr = v_itr, .variant_ordinal = static_cast<uint32_t>(select) } );
+            out += '[';
+            append_json( out, fc::variant(v_itr->second.types[select]) );
+            out += ',';
+            _binary_to_json(v_itr->second.types[select], stream, out, ctx);
+            out += ']';
+            return true;
+         }
+      }
+
+      out += '{';
+      auto written = _binary_to_json_fields(rtype, stream, out, ctx);
+      EOS_ASSERT( written > 0, unpack_exception, "Unable to unpack '${p}' from stream", ("p", ctx.get_path_string()) );
+      out += '}';
+      return true;
+   }
+
    fc::variant abi_serializer::_binary_to_variant( const std::string_view& type, const bytes& binary, impl::binary_to_variant_context& ctx )const
    {
       auto h = ctx.enter_scope();
@@ -440,18 +661,32 @@ namespace eosio { namespace chain {
       return binary_to_variant( type, binary, create_yield_function(max_serialization_time), short_path );
    }
 
+   std::string abi_serializer::binary_to_json( const std::string_view& type, const bytes& binary, const yield_function_t& yield, bool short_path )const {
+      fc::datastream<const char*> ds( binary.data(), binary.size() );
+      return binary_to_json( type, ds, yield, short_path );
+   }
+
+   std::string abi_serializer::binary_to_json( const std::string_view& type, fc::datastream<const char*>& binary, const yield_function_t& yield, bool short_path )const {
+      impl::binary_to_variant_context ctx(*this, yield, type);
+      ctx.short_path = short_path;
+      std::string out;
+      _binary_to_json(type, binary, out, ctx);
+      return out;
+   }
+
    void abi_serializer::_variant_to_binary( const std::string_view& type, const fc::variant& var, fc::datastream<char *>& ds, impl::variant_to_binary_context& ctx )const
    { try {
       auto h = ctx.enter_scope();
-      auto rtype = resolve_type(type);
+      const auto plan = get_type_plan(type);
+      const auto& ftype = plan.ftype;
 
-      auto v_itr = variants.end();
-      auto s_itr = structs.end();
+      auto v_itr = plan.variant_itr;
+      auto s_itr = plan.struct_itr;
 
-      auto btype = built_in_types.find(fundamental_type(rtype));
+      auto btype = plan.built_in_itr;
       if( btype != built_in_types.end() ) {
-         btype->second.second(var, ds, is_array(rtype), is_optional(rtype), ctx.get_yield_function());
-      } else if ( is_array(rtype) ) {
+         btype->second.second(var, ds, plan.array, plan.optional, ctx.get_yield_function());
+      } else if ( plan.array ) {
          ctx.hint_array_type_if_in_array();
          vector<fc::variant> vars = var.get_array();
          fc::raw::pack(ds, (fc::unsigned_int)vars.size());
@@ -462,16 +697,16 @@ namespace eosio { namespace chain {
          int64_t i = 0;
          for (const auto& var : vars) {
             ctx.set_array_index_of_path_back(i);
-           _variant_to_binary(fundamental_type(rtype), var, ds, ctx);
+           _variant_to_binary(ftype, var, ds, ctx);
            ++i;
          }
-      } else if( is_optional(rtype) ) {
+      } else if( plan.optional ) {
          char flag = !var.is_null();
          fc::raw::pack(ds, flag);
          if( flag ) {
-            _variant_to_binary(fundamental_type(rtype), var, ds, ctx);
+            _variant_to_binary(ftype, var, ds, ctx);
          }
-      } else if( (v_itr = variants.find(rtype)) != variants.end() ) {
+      } else if( v_itr != variants.end() ) {
          ctx.hint_variant_type_if_in_array( v_itr );
          auto& v = v_itr->second;
          EOS_ASSERT( var.is_array() && var.size() == 2, pack_exception,
@@ -486,7 +721,7 @@ namespace eosio { namespace chain {
          fc::raw::pack(ds, fc::unsigned_int(it - v.types.begin()));
          auto h1 = ctx.push_to_path( impl::variant_path_item{ .variant_itr = v_itr, .variant_ordinal = static_cast<uint32_t>(it - v.types.begin()) } );
          _variant_to_binary( *it, var[size_t(1)], ds, ctx );
-      } else if( (s_itr = structs.find(rtype)) != structs.end() ) {
+      } else if( s_itr != structs.end() ) {
          ctx.hint_struct_type_if_in_array( s_itr );
          const auto& st = s_itr->second;
 
@@ -495,7 +730,7 @@ namespace eosio { namespace chain {
 
             if( st.base != type_name() ) {
                auto h2 = ctx.disallow_extensions_unless(false);
-               _variant_to_binary(resolve_type(st.base), var, ds, ctx);
+               _variant_to_binary(get_type_plan(st.base).rtype, var, ds, ctx);
             }
             bool disallow_additional_fields = false;
             for( uint32_t i = 0; i < st.fields.size(); ++i ) {
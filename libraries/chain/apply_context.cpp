@@ -569,28 +569,59 @@ uint32_t apply_context::schedule_action( action&& act_to_schedule, account_name
    return scheduled_action_ordinal;
 }
 
+const table_id_object* apply_context::find_table_lookup( name code, name scope, name table )const {
+   for( const auto& l : _table_lookups ) {
+      if( l.table == table && l.scope == scope && l.code == code )
+         return l.tab;
+   }
+   return nullptr;
+}
+
+void apply_context::add_table_lookup( name code, name scope, name table, const table_id_object* tab ) {
+   if( _table_lookups.size() < max_table_lookups ) {
+      _table_lookups.push_back( {code, scope, table, tab} );
+      return;
+   }
+   _table_lookups[_next_table_lookup] = {code, scope, table, tab};
+   _next_table_lookup = (_next_table_lookup + 1) % max_table_lookups;
+}
+
 const table_id_object* apply_context::find_table( name code, name scope, name table ) {
-   return db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
+   if( const auto* tab = find_table_lookup( code, scope, table ) )
+      return tab;
+   const auto* tab = db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
+   if( tab )
+      add_table_lookup( code, scope, table, tab );
+   return tab;
 }
 
 const table_id_object& apply_context::find_or_create_table( name code, name scope, name table, const account_name &payer ) {
-   const auto* existing_tid =  db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
+   const auto* existing_tid = find_table( code, scope, table );
    if (existing_tid != nullptr) {
       return *existing_tid;
    }
 
    update_db_usage(payer, config::billable_size_v<table_id_object>);
 
-   return db.create<table_id_object>([&](table_id_object &t_id){
+   const auto& tid = db.create<table_id_object>([&](table_id_object &t_id){
       t_id.code = code;
       t_id.scope = scope;
       t_id.table = table;
       t_id.payer = payer;
    });
+   add_table_lookup( code, scope, table, &tid );
+   control.table_created( tid );
+   return tid;
 }
 
 void apply_context::remove_table( const table_id_object& tid ) {
    update_db_usage(tid.payer, - config::billable_size_v<table_id_object>);
+   auto itr = std::find_if( _table_lookups.begin(), _table_lookups.end(), [&]( const auto& l ) { return l.tab == &tid; } );
+   if( itr != _table_lookups.end() ) {
+      _table_lookups.erase( itr );
+      _next_table_lookup = 0;
+   }
+   control.table_removed( tid );
    db.remove(tid);
 }
 
@@ -682,6 +713,7 @@ int apply_context::db_store_i64( name code, name scope, name table, const accoun
       o.payer       = payer;
    });
 
+   control.table_touched( tab );
    db.modify( tab, [&]( auto& t ) {
      ++t.count;
    });
@@ -701,26 +733,42 @@ void apply_context::db_update_i64( int iterator, account_name payer, const char*
 
 //   require_write_lock( table_obj.scope );
 
+   auto pending = trx_context.pending_row_updates.find( obj.id._id );
+   const bool is_pending = pending != trx_context.pending_row_updates.end();
+   const account_name obj_payer = is_pending ? pending->second.payer : obj.payer;
+
    const int64_t overhead = config::billable_size_v<key_value_object>;
-   int64_t old_size = (int64_t)(obj.value.size() + overhead);
+   int64_t old_size = (int64_t)((is_pending ? pending->second.value.size() : obj.value.size()) + overhead);
    int64_t new_size = (int64_t)(buffer_size + overhead);
 
-   if( payer == account_name() ) payer = obj.payer;
+   if( payer == account_name() ) payer = obj_payer;
 
-   if( account_name(obj.payer) != payer ) {
+   if( obj_payer != payer ) {
       // refund the existing payer
-      update_db_usage( obj.payer,  -(old_size) );
+      update_db_usage( obj_payer,  -(old_size) );
       // charge the new payer
       update_db_usage( payer,  (new_size));
    } else if(old_size != new_size) {
       // charge/refund the existing payer the difference
-      update_db_usage( obj.payer, new_size - old_size);
+      update_db_usage( obj_payer, new_size - old_size);
+   }
+   if( old_size != new_size ) {
+      control.table_touched( table_obj );
    }
 
-   db.modify( obj, [&]( auto& o ) {
-     o.value.assign( buffer, buffer_size );
-     o.payer = payer;
-   });
+   if( trx_context.undo_session ) {
+      // the row is written once, when the transaction is finalized, however often the transaction updates it;
+      // no index key changes so only db_get_i64 and the payer need to see the pending value
+      auto& u = is_pending ? pending->second : trx_context.pending_row_updates[obj.id._id];
+      u.value.assign( buffer, buffer + buffer_size );
+      u.payer = payer;
+   } else {
+      // without an undo session nothing is rolled back, a failing transaction must leave its writes behind as before
+      db.modify( obj, [&]( auto& o ) {
+        o.value.assign( buffer, buffer_size );
+        o.payer = payer;
+      });
+   }
 }
 
 void apply_context::db_remove_i64( int iterator ) {
@@ -731,8 +779,15 @@ void apply_context::db_remove_i64( int iterator ) {
 
 //   require_write_lock( table_obj.scope );
 
-   update_db_usage( obj.payer,  -(obj.value.size() + config::billable_size_v<key_value_object>) );
+   auto pending = trx_context.pending_row_updates.find( obj.id._id );
+   if( pending != trx_context.pending_row_updates.end() ) {
+      update_db_usage( pending->second.payer,  -(pending->second.value.size() + config::billable_size_v<key_value_object>) );
+      trx_context.pending_row_updates.erase( pending );
+   } else {
+      update_db_usage( obj.payer,  -(obj.value.size() + config::billable_size_v<key_value_object>) );
+   }
 
+   control.table_touched( table_obj );
    db.modify( table_obj, [&]( auto& t ) {
       --t.count;
    });
@@ -748,11 +803,19 @@ void apply_context::db_remove_i64( int iterator ) {
 int apply_context::db_get_i64( int iterator, char* buffer, size_t buffer_size ) {
    const key_value_object& obj = keyval_cache.get( iterator );
 
-   auto s = obj.value.size();
+   const char* data = obj.value.data();
+   size_t s = obj.value.size();
+   if( !trx_context.pending_row_updates.empty() ) {
+      auto pending = trx_context.pending_row_updates.find( obj.id._id );
+      if( pending != trx_context.pending_row_updates.end() ) {
+         data = pending->second.value.data();
+         s = pending->second.value.size();
+      }
+   }
    if( buffer_size == 0 ) return s;
 
    auto copy_size = std::min( buffer_size, s );
-   memcpy( buffer, obj.value.data(), copy_size );
+   memcpy( buffer, data, copy_size );
 
    return copy_size;
 }
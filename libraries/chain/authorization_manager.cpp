@@ -463,6 +463,10 @@ namespace eosio { namespace chain {
 
       map<permission_level, fc::microseconds> permissions_to_satisfy;
 
+      // (declared_auth, code, action) already found relevant, batches repeat the same action and authorization;
+      // nothing modifies permissions or links while the actions of one transaction are checked
+      flat_set<std::tuple<permission_level, account_name, action_name>> relevant_auths;
+
       for( const auto& act : actions ) {
          bool special_case = false;
          fc::microseconds delay = effective_provided_delay;
@@ -489,7 +493,7 @@ namespace eosio { namespace chain {
 
             checktime();
 
-            if( !special_case ) {
+            if( !special_case && !relevant_auths.count( std::make_tuple( declared_auth, act.account, act.name ) ) ) {
                auto min_permission_name = lookup_minimum_permission(declared_auth.actor, act.account, act.name);
                if( min_permission_name ) { // since special cases were already handled, it should only be false if the permission is eosio.any
                   const auto& min_permission = get_permission({declared_auth.actor, *min_permission_name});
@@ -499,6 +503,7 @@ namespace eosio { namespace chain {
                               "action declares irrelevant authority '${auth}'; minimum authority is ${min}",
                               ("auth", declared_auth)("min", permission_level{min_permission.owner, min_permission.name}) );
                }
+               relevant_auths.emplace( declared_auth, act.account, act.name );
             }
 
             if( satisfied_authorizations.find( declared_auth ) == satisfied_authorizations.end() ) {
@@ -1,4 +1,5 @@
 #include <eosio/chain/block.hpp>
+#include <eosio/chain/pack_buffer.hpp>
 
 namespace eosio { namespace chain {
    void additional_block_signatures_extension::reflector_init() {
@@ -61,4 +62,14 @@ namespace eosio { namespace chain {
 
    }
 
-} } /// namespace eosio::chain
\ No newline at end of file
+   std::shared_ptr<const vector<char>> signed_block::packed()const {
+      auto p = std::atomic_load( &_packed );
+      if( !p ) {
+         // threads racing here pack the same bytes, the last one stored wins
+         p = std::make_shared<const vector<char>>( pack_buffer::pack( *this ) );
+         std::atomic_store( &_packed, p );
+      }
+      return p;
+   }
+
+} } /// namespace eosio::chain
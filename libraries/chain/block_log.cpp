@@ -5,6 +5,17 @@
 #include <fc/io/cfile.hpp>
 #include <fc/io/raw.hpp>
 
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <regex>
+#include <shared_mutex>
+#include <thread>
+
 
 #define LOG_READ  (std::ios::in | std::ios::binary)
 #define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::app)
@@ -37,17 +48,207 @@ namespace eosio { namespace chain {
    namespace detail {
       using unique_file = std::unique_ptr<FILE, decltype(&fclose)>;
 
+      /**
+       * Read only memory map of a file only ever appended to, mapped again when a read goes past the mapped size.
+       * Safe for concurrent readers, the appends have to be flushed before the appended data can be read.
+       */
+      class mapped_file {
+         public:
+            void set_file_path( const fc::path& p ) {
+               std::unique_lock g( mtx );
+               path = p;
+            }
+
+            void unmap() {
+               std::unique_lock g( mtx );
+               region = boost::interprocess::mapped_region();
+               mapping = boost::interprocess::file_mapping();
+               mapped_size = 0;
+            }
+
+            /**
+             * Calls f(data, size) with the mapped bytes from pos to the end of the mapping, at least min_size of them
+             */
+            template<typename F>
+            auto read( uint64_t pos, uint64_t min_size, F&& f ) {
+               {
+                  std::shared_lock g( mtx );
+                  if( pos + min_size <= mapped_size )
+                     return f( static_cast<const char*>(region.get_address()) + pos, mapped_size - pos );
+               }
+               remap( pos + min_size );
+               std::shared_lock g( mtx );
+               EOS_ASSERT( pos + min_size <= mapped_size, block_log_exception,
+                           "Read of ${n} bytes at ${pos} is past the end of ${path}",
+                           ("n", min_size)("pos", pos)("path", path.generic_string()) );
+               return f( static_cast<const char*>(region.get_address()) + pos, mapped_size - pos );
+            }
+
+            uint64_t file_size()const {
+               std::shared_lock g( mtx );
+               return fc::file_size( path );
+            }
+
+         private:
+            void remap( uint64_t needed_size ) {
+               std::unique_lock g( mtx );
+               if( needed_size <= mapped_size )
+                  return; // another reader did it meanwhile
+               const uint64_t size = fc::file_size( path );
+               if( size < needed_size )
+                  return;
+               mapping = boost::interprocess::file_mapping( path.generic_string().c_str(), boost::interprocess::read_only );
+               region = boost::interprocess::mapped_region( mapping, boost::interprocess::read_only, 0, size );
+               mapped_size = size;
+            }
+
+            fc::path                               path;
+            boost::interprocess::file_mapping      mapping;
+            boost::interprocess::mapped_region     region;
+            uint64_t                               mapped_size = 0;
+            mutable std::shared_mutex              mtx;
+      };
+
+      /**
+       * Read path of a block log file and its index
+       */
+      struct block_file_reader {
+         mapped_file              block_map;
+         mapped_file              index_map;
+
+         void set_file_paths( const fc::path& block_file, const fc::path& index_file ) {
+            block_map.set_file_path( block_file );
+            index_map.set_file_path( index_file );
+         }
+
+         void unmap() {
+            block_map.unmap();
+            index_map.unmap();
+         }
+
+         uint64_t get_block_pos( uint32_t first_block_num, uint32_t last_block_num, uint32_t block_num ) {
+            if (!(block_num <= last_block_num && block_num >= first_block_num))
+               return block_log::npos;
+            uint64_t pos;
+            index_map.read(sizeof(uint64_t) * (block_num - first_block_num), sizeof(pos), [&](const char* data, uint64_t) {
+               memcpy(&pos, data, sizeof(pos));
+            });
+            return pos;
+         }
+
+         template<typename T>
+         void read( T& t, uint64_t pos ) {
+            block_map.read(pos, 1, [&](const char* data, uint64_t size) {
+               fc::datastream<const char*> ds(data, size);
+               fc::raw::unpack(ds, t);
+            });
+         }
+
+         /// end is the position of the next block, npos for the last block of the file, which ends at committed_end.
+         /// committed_end is npos for a file no longer written to, its size
+         std::vector<char> read_serialized_block( uint64_t pos, uint64_t end, uint64_t committed_end ) {
+            if (end == block_log::npos) {
+               // the writer may be appending the next block, only the flushed blocks up to the last readable one count
+               end = committed_end == block_log::npos ? block_map.file_size() : committed_end;
+            }
+            EOS_ASSERT(end >= pos + sizeof(uint64_t) + trim_data::blknum_offset + sizeof(uint32_t), block_log_exception,
+                       "Invalid block position ${pos} in block log", ("pos", pos));
+            std::vector<char> data(end - pos - sizeof(uint64_t));
+            block_map.read(pos, data.size(), [&](const char* block, uint64_t) {
+               memcpy(data.data(), block, data.size());
+            });
+            return data;
+         }
+      };
+
+      /**
+       * Block log of a completed stride, renamed to blocks-<first>-<last>.log and .index, can be read on its own
+       */
+      struct retained_block_file {
+         uint32_t                 first_block_num = 0;
+         uint32_t                 last_block_num = 0;
+         fc::path                 block_file;
+         fc::path                 index_file;
+         block_file_reader        reader;
+      };
+
+      /**
+       * Where a block is, pos is npos if it is not in the log
+       */
+      struct block_location {
+         block_file_reader*       reader = nullptr;
+         uint32_t                 first_block_num = 0;
+         uint32_t                 last_block_num = 0;
+         uint64_t                 pos = block_log::npos;
+         uint64_t                 committed_end = block_log::npos; // end of last_block_num in a file still written to
+      };
+
       class block_log_impl {
          public:
             signed_block_ptr         head;
             block_id_type            head_id;
+            std::atomic<uint32_t>    head_block_num{0}; // of head, 0 without head; read by get_block_pos from any thread
+            std::mutex               commit_mtx;        // head_block_num and committed_end change together under it
+            uint64_t                 committed_end = 0; // end of block_file after head_block_num, it is flushed up to there
             fc::cfile                block_file;
             fc::cfile                index_file;
+            block_file_reader        reader;     // read path of block_file and index_file
             bool                     open_files = false;
             bool                     genesis_written_to_block_log = false;
             uint32_t                 version = 0;
             uint32_t                 first_block_num = 0;
 
+            fc::path                 data_dir;
+            uint32_t                 stride = 0; // blocks per file, 0 keeps all blocks in blocks.log
+            uint32_t                 max_retained_files = std::numeric_limits<uint32_t>::max();
+            std::deque<std::unique_ptr<retained_block_file>> retained_files; // oldest first
+            mutable std::shared_mutex                        retained_mtx;   // exclusive while blocks move to a retained file
+
+            static std::deque<std::unique_ptr<retained_block_file>> find_retained_files( const fc::path& data_dir );
+            void open_retained_files();
+            void split();
+            void prune_retained_files();
+            void remove_retained_files();
+
+            block_log_write_options                          write_options;
+            std::thread                                      writer;
+            std::mutex                                       queue_mtx;
+            std::condition_variable                          queue_cv;      // blocks were queued or the writer stops
+            std::condition_variable                          written_cv;    // the writer flushed blocks or failed
+            std::deque<signed_block_ptr>                     queue;         // appended but not yet flushed, read from here
+            bool                                             stopping = false;
+            std::exception_ptr                               writer_error;
+
+            bool async_writes() const { return write_options.max_queued_blocks > 0; }
+            void run_writer();
+            void stop_writer();
+            void wait_for_writes();
+            signed_block_ptr queued_block( uint32_t block_num );
+
+            /// requires a lock of retained_mtx
+            block_location locate( uint32_t block_num ) {
+               for (auto& f : retained_files) {
+                  if (block_num >= f->first_block_num && block_num <= f->last_block_num)
+                     return { &f->reader, f->first_block_num, f->last_block_num,
+                              f->reader.get_block_pos(f->first_block_num, f->last_block_num, block_num) };
+               }
+               uint32_t last;
+               uint64_t end;
+               {
+                  std::lock_guard g( commit_mtx );
+                  last = head_block_num;
+                  end = committed_end;
+               }
+               return { &reader, first_block_num, last, reader.get_block_pos(first_block_num, last, block_num), end };
+            }
+
+            /// blocks up to block_num become readable, they end at end in the flushed block_file
+            void commit( uint32_t block_num, uint64_t end ) {
+               std::lock_guard g( commit_mtx );
+               committed_end = end;
+               head_block_num = block_num;
+            }
+
             inline void check_open_files() {
                if( !open_files ) {
                   reopen();
@@ -60,6 +261,7 @@ namespace eosio { namespace chain {
                   block_file.close();
                if( index_file.is_open() )
                   index_file.close();
+               reader.unmap();
                open_files = false;
             }
 
@@ -73,6 +275,8 @@ namespace eosio { namespace chain {
             void flush();
 
             uint64_t append(const signed_block_ptr& b);
+            uint64_t append_now(const signed_block_ptr& b);
+            uint64_t write_block(const signed_block_ptr& b);
 
             template <typename ChainContext, typename Lambda>
             static fc::optional<ChainContext> extract_chain_context( const fc::path& data_dir, Lambda&& lambda );
@@ -147,6 +351,13 @@ namespace eosio { namespace chain {
          constexpr static uint64_t          _max_buffer_length        = file_location_to_buffer_location(_buffer_bytes);
       };
 
+      /**
+       * Rebuilds the index on several threads. Each thread looks for a trailing position word close to the end of its
+       * region, the anchor, and then follows the position words back to the anchor of the region before it. Returns
+       * false if the log does not look like expected, the caller uses the sequential reverse_iterator then.
+       */
+      bool construct_index_parallel(const fc::path& block_file_name, const fc::path& index_file_name, uint32_t threads);
+
       /*
        *  @brief datastream adapter that adapts FILE* for use with fc unpack
        *
@@ -181,9 +392,17 @@ namespace eosio { namespace chain {
       };
    }
 
-   block_log::block_log(const fc::path& data_dir)
+   block_log::block_log(const fc::path& data_dir, uint32_t stride, uint32_t max_retained_files,
+                        const block_log_write_options& write_options)
    :my(new detail::block_log_impl()) {
+      my->stride = stride;
+      my->max_retained_files = max_retained_files;
+      my->write_options = write_options;
+      my->write_options.flush_interval = std::max( write_options.flush_interval, 1u );
       open(data_dir);
+      if (my->async_writes()) {
+         my->writer = std::thread( [impl = my.get()]() { impl->run_writer(); } );
+      }
    }
 
    block_log::block_log(block_log&& other) {
@@ -192,7 +411,8 @@ namespace eosio { namespace chain {
 
    block_log::~block_log() {
       if (my) {
-         flush();
+         my->stop_writer();
+         my->flush();
          my->close();
          my.reset();
       }
@@ -204,8 +424,11 @@ namespace eosio { namespace chain {
       if (!fc::is_directory(data_dir))
          fc::create_directories(data_dir);
 
+      my->data_dir = data_dir;
       my->block_file.set_file_path( data_dir / "blocks.log" );
       my->index_file.set_file_path( data_dir / "blocks.index" );
+      my->reader.set_file_paths( my->block_file.get_file_path(), my->index_file.get_file_path() );
+      my->open_retained_files();
 
       my->reopen();
 
@@ -256,6 +479,7 @@ namespace eosio { namespace chain {
          } else {
             my->head_id = {};
          }
+         my->commit( my->head ? my->head->block_num() : 0, fc::file_size( my->block_file.get_file_path() ) );
 
          if (index_size) {
             ilog("Index is nonempty");
@@ -291,9 +515,40 @@ namespace eosio { namespace chain {
    }
 
    uint64_t detail::block_log_impl::append(const signed_block_ptr& b) {
+      if (!async_writes())
+         return append_now(b);
+
+      std::unique_lock g( queue_mtx );
+      written_cv.wait( g, [&]() { return queue.size() < write_options.max_queued_blocks || writer_error; } );
+      if (writer_error)
+         std::rethrow_exception( writer_error );
+      EOS_ASSERT( queue.empty() || b->block_num() == queue.back()->block_num() + 1, block_log_append_fail,
+                  "Append of block ${num} after queued block ${last}", ("num", b->block_num())("last", queue.back()->block_num()) );
+      queue.push_back(b);
+      head = b;
+      head_id = b->id();
+      queue_cv.notify_one();
+      return block_log::npos;
+   }
+
+   uint64_t detail::block_log_impl::append_now(const signed_block_ptr& b) {
+      auto pos = write_block(b);
+      head = b;
+      head_id = b->id();
+
+      flush();
+      commit( b->block_num(), block_file.tellp() ); // the block is readable once flushed
+
+      return pos;
+   }
+
+   uint64_t detail::block_log_impl::write_block(const signed_block_ptr& b) {
       try {
          EOS_ASSERT( genesis_written_to_block_log, block_log_append_fail, "Cannot append to block log until the genesis is first written" );
 
+         if (stride && head_block_num != 0 && (b->block_num() - 1) % stride == 0)
+            split();
+
          check_open_files();
 
          block_file.seek_end(0);
@@ -304,27 +559,101 @@ namespace eosio { namespace chain {
                    "Append to index file occuring at wrong position.",
                    ("position", (uint64_t) index_file.tellp())
                    ("expected", (b->block_num() - first_block_num) * sizeof(uint64_t)));
-         auto data = fc::raw::pack(*b);
-         block_file.write(data.data(), data.size());
+         auto data = b->packed();
+         block_file.write(data->data(), data->size());
          block_file.write((char*)&pos, sizeof(pos));
          index_file.write((char*)&pos, sizeof(pos));
-         head = b;
-         head_id = b->id();
-
-         flush();
 
          return pos;
       }
       FC_LOG_AND_RETHROW()
    }
 
+   void detail::block_log_impl::run_writer() {
+      std::unique_lock g( queue_mtx );
+      for (;;) {
+         queue_cv.wait( g, [this]() { return stopping || !queue.empty(); } );
+         if (queue.empty())
+            return;
+         try {
+            // only this thread removes blocks from the queue, the ones at the front stay there until they are flushed
+            size_t written = 0;
+            uint32_t last_written = 0;
+            while (written < queue.size() && written < write_options.flush_interval) {
+               auto b = queue[written];
+               // a split needs the head of blocks.log to be flushed
+               if (written && stride && (b->block_num() - 1) % stride == 0)
+                  break;
+               g.unlock();
+               write_block(b);
+               g.lock();
+               ++written;
+               last_written = b->block_num();
+            }
+            g.unlock();
+            flush();
+            commit( last_written, block_file.tellp() );
+            g.lock();
+            queue.erase( queue.begin(), queue.begin() + written );
+         } catch (...) {
+            if (!g.owns_lock())
+               g.lock();
+            writer_error = std::current_exception();
+            written_cv.notify_all();
+            return;
+         }
+         written_cv.notify_all();
+      }
+   }
+
+   void detail::block_log_impl::stop_writer() {
+      if (!writer.joinable())
+         return;
+      {
+         std::lock_guard g( queue_mtx );
+         stopping = true;
+      }
+      queue_cv.notify_one();
+      writer.join();
+      if (writer_error) {
+         try {
+            std::rethrow_exception( writer_error );
+         } FC_LOG_AND_DROP();
+      }
+   }
+
+   void detail::block_log_impl::wait_for_writes() {
+      if (!async_writes())
+         return;
+      std::unique_lock g( queue_mtx );
+      written_cv.wait( g, [this]() { return queue.empty() || writer_error; } );
+      if (writer_error)
+         std::rethrow_exception( writer_error );
+   }
+
+   signed_block_ptr detail::block_log_impl::queued_block( uint32_t block_num ) {
+      if (!async_writes())
+         return {};
+      std::lock_guard g( queue_mtx );
+      if (queue.empty() || block_num < queue.front()->block_num() || block_num > queue.back()->block_num())
+         return {};
+      return queue[block_num - queue.front()->block_num()];
+   }
+
    void block_log::flush() {
+      my->wait_for_writes();
       my->flush();
    }
 
    void detail::block_log_impl::flush() {
       block_file.flush();
       index_file.flush();
+      if (write_options.fsync) {
+         if (block_file.is_open())
+            block_file.sync();
+         if (index_file.is_open())
+            index_file.sync();
+      }
    }
 
    template<typename T>
@@ -351,10 +680,9 @@ namespace eosio { namespace chain {
       block_file.write((char*)&totem, sizeof(totem));
 
       if (first_block) {
-         append(first_block);
+         append_now(first_block);
       } else {
-         head.reset();
-         head_id = {};
+         commit( 0, block_file.tellp() );
       }
 
       auto pos = block_file.tellp();
@@ -370,15 +698,117 @@ namespace eosio { namespace chain {
    }
 
    void block_log::reset( const genesis_state& gs, const signed_block_ptr& first_block ) {
+      my->wait_for_writes();
+      my->remove_retained_files();
+      my->head.reset();
+      my->head_id = {};
       my->reset(gs, first_block, 1);
    }
 
    void block_log::reset( const chain_id_type& chain_id, uint32_t first_block_num ) {
       EOS_ASSERT( first_block_num > 1, block_log_exception,
                   "Block log version ${ver} needs to be created with a genesis state if starting from block number 1." );
+      my->wait_for_writes();
+      my->remove_retained_files();
+      my->head.reset();
+      my->head_id = {};
       my->reset(chain_id, signed_block_ptr(), first_block_num);
    }
 
+   std::deque<std::unique_ptr<detail::retained_block_file>> detail::block_log_impl::find_retained_files( const fc::path& data_dir ) {
+      std::deque<std::unique_ptr<retained_block_file>> files;
+      static const std::regex retained_file_name( "blocks-([0-9]+)-([0-9]+)\\.log" );
+      for (fc::directory_iterator itr( data_dir ), end; itr != end; ++itr) {
+         const auto name = itr->filename().generic_string();
+         std::smatch match;
+         if (!std::regex_match( name, match, retained_file_name ))
+            continue;
+         auto f = std::make_unique<retained_block_file>();
+         f->first_block_num = std::stoul( match[1].str() );
+         f->last_block_num = std::stoul( match[2].str() );
+         f->block_file = *itr;
+         f->index_file = data_dir / (name.substr( 0, name.size() - 4 ) + ".index");
+         if (f->first_block_num == 0 || f->last_block_num < f->first_block_num) {
+            wlog( "Ignoring block log file ${f} with an invalid block range", ("f", name) );
+            continue;
+         }
+         files.push_back( std::move(f) );
+      }
+      std::sort( files.begin(), files.end(), []( const auto& a, const auto& b ) {
+         return a->first_block_num < b->first_block_num;
+      } );
+      return files;
+   }
+
+   void detail::block_log_impl::open_retained_files() {
+      std::unique_lock g( retained_mtx );
+      retained_files = find_retained_files( data_dir );
+      for (auto& f : retained_files) {
+         if (!fc::exists( f->index_file ) ||
+             fc::file_size( f->index_file ) != sizeof(uint64_t) * (f->last_block_num - f->first_block_num + 1)) {
+            ilog( "Reconstructing index of ${f}", ("f", f->block_file.generic_string()) );
+            fc::remove_all( f->index_file );
+            block_log::construct_index( f->block_file, f->index_file );
+         }
+         f->reader.set_file_paths( f->block_file, f->index_file );
+      }
+
+      // split moves the blocks to a retained file before it creates the new blocks.log, take them back after a crash in between
+      const auto log_file = block_file.get_file_path();
+      if (!retained_files.empty() && (!fc::exists( log_file ) || fc::file_size( log_file ) == 0)) {
+         auto& last = retained_files.back();
+         ilog( "Block log is empty, continuing ${f}", ("f", last->block_file.generic_string()) );
+         last->reader.unmap();
+         fc::remove_all( log_file );
+         fc::remove_all( index_file.get_file_path() );
+         fc::rename( last->block_file, log_file );
+         fc::rename( last->index_file, index_file.get_file_path() );
+         retained_files.pop_back();
+      }
+   }
+
+   void detail::block_log_impl::split() {
+      std::unique_lock g( retained_mtx );
+      const auto chain_id = block_log::extract_chain_id( data_dir );
+
+      auto f = std::make_unique<retained_block_file>();
+      f->first_block_num = first_block_num;
+      f->last_block_num = head_block_num;
+      const auto name = "blocks-" + std::to_string( f->first_block_num ) + "-" + std::to_string( f->last_block_num );
+      f->block_file = data_dir / (name + ".log");
+      f->index_file = data_dir / (name + ".index");
+      ilog( "Moving blocks ${first} to ${last} to ${f}", ("first", f->first_block_num)("last", f->last_block_num)("f", f->block_file.generic_string()) );
+
+      close();
+      fc::rename( block_file.get_file_path(), f->block_file );
+      fc::rename( index_file.get_file_path(), f->index_file );
+      f->reader.set_file_paths( f->block_file, f->index_file );
+      retained_files.push_back( std::move(f) );
+      prune_retained_files();
+
+      // the caller appends the next block right away, blocks.log is never left without a head
+      reset( chain_id, signed_block_ptr(), retained_files.back()->last_block_num + 1 );
+   }
+
+   void detail::block_log_impl::prune_retained_files() {
+      while (retained_files.size() > max_retained_files) {
+         auto& f = retained_files.front();
+         ilog( "Removing block log file ${f}", ("f", f->block_file.generic_string()) );
+         f->reader.unmap();
+         fc::remove_all( f->block_file );
+         fc::remove_all( f->index_file );
+         retained_files.pop_front();
+      }
+   }
+
+   void detail::block_log_impl::remove_retained_files() {
+      std::unique_lock g( retained_mtx );
+      auto max = max_retained_files;
+      max_retained_files = 0;
+      prune_retained_files();
+      max_retained_files = max;
+   }
+
    void detail::block_log_impl::write( const genesis_state& gs ) {
       auto data = fc::raw::pack(gs);
       block_file.write(data.data(), data.size());
@@ -389,29 +819,25 @@ namespace eosio { namespace chain {
    }
 
    signed_block_ptr block_log::read_block(uint64_t pos)const {
-      my->check_open_files();
-
-      my->block_file.seek(pos);
       signed_block_ptr result = std::make_shared<signed_block>();
-      auto ds = my->block_file.create_datastream();
-      fc::raw::unpack(ds, *result);
+      my->reader.read(*result, pos);
       return result;
    }
 
    void block_log::read_block_header(block_header& bh, uint64_t pos)const {
-      my->check_open_files();
-
-      my->block_file.seek(pos);
-      auto ds = my->block_file.create_datastream();
-      fc::raw::unpack(ds, bh);
+      my->reader.read(bh, pos);
    }
 
    signed_block_ptr block_log::read_block_by_num(uint32_t block_num)const {
       try {
+         if (auto b = my->queued_block(block_num))
+            return b;
+         std::shared_lock g(my->retained_mtx);
          signed_block_ptr b;
-         uint64_t pos = get_block_pos(block_num);
-         if (pos != npos) {
-            b = read_block(pos);
+         auto l = my->locate(block_num);
+         if (l.pos != npos) {
+            b = std::make_shared<signed_block>();
+            l.reader->read(*b, l.pos);
             EOS_ASSERT(b->block_num() == block_num, reversible_blocks_exception,
                       "Wrong block was read from block log.", ("returned", b->block_num())("expected", block_num));
          }
@@ -419,12 +845,37 @@ namespace eosio { namespace chain {
       } FC_LOG_AND_RETHROW()
    }
 
+   std::vector<char> block_log::read_serialized_block(uint32_t block_num)const {
+      try {
+         if (auto b = my->queued_block(block_num))
+            return *b->packed();
+         std::shared_lock g(my->retained_mtx);
+         std::vector<char> data;
+         auto l = my->locate(block_num);
+         if (l.pos != npos) {
+            // each block is followed by its position, so it ends where the next block starts or at the end of the file
+            uint64_t end = l.reader->get_block_pos(l.first_block_num, l.last_block_num, block_num + 1);
+            data = l.reader->read_serialized_block(l.pos, end, l.committed_end);
+
+            uint32_t prev_block_num;
+            memcpy(&prev_block_num, data.data() + trim_data::blknum_offset, sizeof(prev_block_num));
+            EOS_ASSERT(fc::endian_reverse_u32(prev_block_num) + 1 == block_num, reversible_blocks_exception,
+                       "Wrong block was read from block log.",
+                       ("returned", fc::endian_reverse_u32(prev_block_num) + 1)("expected", block_num));
+         }
+         return data;
+      } FC_LOG_AND_RETHROW()
+   }
+
    block_id_type block_log::read_block_id_by_num(uint32_t block_num)const {
       try {
-         uint64_t pos = get_block_pos(block_num);
-         if (pos != npos) {
+         if (auto b = my->queued_block(block_num))
+            return b->id();
+         std::shared_lock g(my->retained_mtx);
+         auto l = my->locate(block_num);
+         if (l.pos != npos) {
             block_header bh;
-            read_block_header(bh, pos);
+            l.reader->read(bh, l.pos);
             EOS_ASSERT(bh.block_num() == block_num, reversible_blocks_exception,
                        "Wrong block header was read from block log.", ("returned", bh.block_num())("expected", block_num));
             return bh.id();
@@ -434,16 +885,11 @@ namespace eosio { namespace chain {
    }
 
    uint64_t block_log::get_block_pos(uint32_t block_num) const {
-      my->check_open_files();
-      if (!(my->head && block_num <= block_header::num_from_id(my->head_id) && block_num >= my->first_block_num))
-         return npos;
-      my->index_file.seek(sizeof(uint64_t) * (block_num - my->first_block_num));
-      uint64_t pos;
-      my->index_file.read((char*)&pos, sizeof(pos));
-      return pos;
+      return my->reader.get_block_pos(my->first_block_num, my->head_block_num, block_num);
    }
 
    signed_block_ptr block_log::read_head()const {
+      my->wait_for_writes();
       my->check_open_files();
 
       uint64_t pos;
@@ -471,7 +917,8 @@ namespace eosio { namespace chain {
    }
 
    uint32_t block_log::first_block_num() const {
-      return my->first_block_num;
+      std::shared_lock g(my->retained_mtx);
+      return my->retained_files.empty() ? my->first_block_num : my->retained_files.front()->first_block_num;
    }
 
    void block_log::construct_index() {
@@ -490,7 +937,20 @@ namespace eosio { namespace chain {
       my->reopen();
    } // construct_index
 
-   void block_log::construct_index(const fc::path& block_file_name, const fc::path& index_file_name) {
+   void block_log::construct_index(const fc::path& block_file_name, const fc::path& index_file_name, uint32_t threads) {
+      if (threads == 0) {
+         threads = std::max(std::thread::hardware_concurrency(), 1u);
+      }
+      if (threads > 1) {
+         try {
+            if (detail::construct_index_parallel(block_file_name, index_file_name, threads)) {
+               return;
+            }
+         } FC_LOG_AND_DROP();
+         wlog("Parallel reconstruction of ${file} failed, scanning it sequentially", ("file", index_file_name.generic_string()));
+         fc::remove_all(index_file_name);
+      }
+
       detail::reverse_iterator block_log_iter;
 
       ilog("Will read existing blocks.log file ${file}", ("file", block_file_name.generic_string()));
@@ -541,6 +1001,23 @@ namespace eosio { namespace chain {
       fc::create_directories(blocks_dir);
       auto block_log_path = blocks_dir / "blocks.log";
 
+      // a hard replay needs every block from 1, retained files hold the ones before blocks.log and are copied as they are
+      uint32_t expected_first_block_num = 1;
+      for( const auto& f : detail::block_log_impl::find_retained_files( backup_dir ) ) {
+         EOS_ASSERT( f->first_block_num == expected_first_block_num, block_log_exception,
+                     "Block log file ${file} starts at block ${first}, expected block ${expected}. Retained block log files "
+                     "must cover every block from block 1 to repair the block log.",
+                     ("file", f->block_file.generic_string())("first", f->first_block_num)("expected", expected_first_block_num) );
+         EOS_ASSERT( truncate_at_block == 0 || truncate_at_block > f->last_block_num, block_log_exception,
+                     "Cannot truncate at block ${num}, it is in retained block log file ${file}",
+                     ("num", truncate_at_block)("file", f->block_file.generic_string()) );
+         ilog( "Copying '${file}' from backed up blocks directory", ("file", f->block_file.filename().generic_string()) );
+         fc::copy( f->block_file, blocks_dir / f->block_file.filename() );
+         if( fc::exists( f->index_file ) )
+            fc::copy( f->index_file, blocks_dir / f->index_file.filename() );
+         expected_first_block_num = f->last_block_num + 1;
+      }
+
       ilog( "Reconstructing '${new_block_log}' from backed up block log", ("new_block_log", block_log_path) );
 
       std::fstream  old_block_stream;
@@ -569,10 +1046,11 @@ namespace eosio { namespace chain {
          // this assert is only here since repair_log is only used for --hard-replay-blockchain, which removes any
          // existing state, if another API needs to use it, this can be removed and the check for the first block's
          // previous block id will need to accommodate this.
-         EOS_ASSERT( first_block_num == 1, block_log_exception,
-                     "Block log ${file} must contain a genesis state and start at block number 1.  This block log "
-                     "starts at block number ${first_block_num}.",
-                     ("file", (backup_dir / "blocks.log").generic_string())("first_block_num", first_block_num));
+         EOS_ASSERT( first_block_num == expected_first_block_num, block_log_exception,
+                     "Block log ${file} must start at block number ${expected}, after the retained block log files if there "
+                     "are any, the first of which contains the genesis state.  This block log starts at block number ${first_block_num}.",
+                     ("file", (backup_dir / "blocks.log").generic_string())("expected", expected_first_block_num)
+                     ("first_block_num", first_block_num));
 
          new_block_stream.write( (char*)&first_block_num, sizeof(first_block_num) );
       }
@@ -630,6 +1108,10 @@ namespace eosio { namespace chain {
          }
 
          auto id = tmp.id();
+         if( previous == block_id_type() && first_block_num != 1 ) {
+            // the previous block is the last one of a retained file
+            previous = tmp.previous;
+         }
          if( block_header::num_from_id(previous) + 1 != block_header::num_from_id(id) ) {
             elog( "Block ${num} (${id}) skips blocks. Previous block in block log is block ${prev_num} (${previous})",
                   ("num", block_header::num_from_id(id))("id", id)
@@ -706,8 +1188,14 @@ namespace eosio { namespace chain {
       EOS_ASSERT( fc::is_directory(data_dir) && fc::is_regular_file(data_dir / "blocks.log"), block_log_not_found,
                   "Block log not found in '${blocks_dir}'", ("blocks_dir", data_dir)          );
 
+      // the oldest retained file is the one that can still have the genesis state, they all share the chain id
+      auto block_file = data_dir / "blocks.log";
+      const auto retained = find_retained_files( data_dir );
+      if( !retained.empty() )
+         block_file = retained.front()->block_file;
+
       std::fstream  block_stream;
-      block_stream.open( (data_dir / "blocks.log").generic_string().c_str(), LOG_READ );
+      block_stream.open( block_file.generic_string().c_str(), LOG_READ );
 
       uint32_t version = 0;
       block_stream.read( (char*)&version, sizeof(version) );
@@ -944,6 +1432,170 @@ namespace eosio { namespace chain {
       }
    }
 
+   bool detail::construct_index_parallel(const fc::path& block_file_name, const fc::path& index_file_name, uint32_t threads) {
+      namespace bip = boost::interprocess;
+
+      const uint64_t size = fc::file_size(block_file_name);
+      if (size < sizeof(uint32_t) + sizeof(uint64_t)) {
+         return false;
+      }
+      bip::file_mapping log_mapping(block_file_name.generic_string().c_str(), bip::read_only);
+      bip::mapped_region log_region(log_mapping, bip::read_only, 0, size);
+      const char* const data = static_cast<const char*>(log_region.get_address());
+
+      auto word = [&](uint64_t offset) {
+         uint64_t w;
+         memcpy(&w, data + offset, sizeof(w));
+         return w;
+      };
+      // block number of the block starting at pos, the header only holds the big endian number of its previous block
+      auto block_num_at = [&](uint64_t pos) {
+         uint32_t prev_block_num;
+         memcpy(&prev_block_num, data + pos + trim_data::blknum_offset, sizeof(prev_block_num));
+         return fc::endian_reverse_u32(prev_block_num) + 1;
+      };
+
+      uint32_t version;
+      memcpy(&version, data, sizeof(version));
+      EOS_ASSERT( block_log::is_supported_version(version), block_log_unsupported_version,
+                  "block log version ${v} is not supported", ("v", version));
+      uint32_t first_block_num = 1;
+      if (version != 1) {
+         memcpy(&first_block_num, data + sizeof(version), sizeof(first_block_num));
+      }
+
+      const uint64_t min_block_size = trim_data::blknum_offset + sizeof(uint32_t);
+      const uint64_t last_word = size - sizeof(uint64_t);
+      const uint64_t last_pos = word(last_word);
+      if (last_pos == block_log::npos || last_pos < sizeof(uint64_t) || last_pos + min_block_size > last_word) {
+         return false;
+      }
+      const uint32_t last_block_num = block_num_at(last_pos);
+      if (last_block_num < first_block_num) {
+         return false;
+      }
+      const uint32_t num_blocks = last_block_num - first_block_num + 1;
+
+      // position of the block ending at the trailing word at offset end, npos if that word does not point to a block
+      auto block_ending_at = [&](uint64_t end) {
+         const uint64_t pos = word(end);
+         return pos >= sizeof(uint64_t) && pos < end && end - pos >= min_block_size ? pos : block_log::npos;
+      };
+
+      // a word that happens to look like a position is ruled out by following a few more positions back
+      constexpr uint32_t anchor_depth = 4;
+      auto is_trailing_word = [&](uint64_t end, uint32_t& num) {
+         uint64_t pos = block_ending_at(end);
+         if (pos == block_log::npos) {
+            return false;
+         }
+         num = block_num_at(pos);
+         if (num < first_block_num || num > last_block_num) {
+            return false;
+         }
+         for (uint32_t expected = num, depth = 0; depth < anchor_depth && expected > first_block_num; ++depth) {
+            pos = block_ending_at(pos - sizeof(uint64_t));
+            if (pos == block_log::npos || block_num_at(pos) != --expected) {
+               return false;
+            }
+         }
+         return true;
+      };
+
+      struct anchor {
+         uint64_t end = block_log::npos;   // offset of the trailing position word
+         uint32_t num = 0;
+      };
+      constexpr uint64_t min_region_size = 4096;
+      threads = std::min<uint64_t>(threads, std::max<uint64_t>(size / min_region_size, 1));
+      const uint64_t region_size = size / threads;
+      std::vector<anchor> anchors(threads);
+      std::atomic<bool> failed{false};
+
+      auto run = [&](auto&& f) {
+         std::vector<std::thread> workers;
+         for (uint32_t i = 0; i < threads; ++i) {
+            workers.emplace_back([&f, &failed, i]() {
+               try {
+                  f(i);
+               } catch (...) {
+                  failed = true;
+               }
+            });
+         }
+         for (auto& w : workers) {
+            w.join();
+         }
+      };
+
+      run([&](uint32_t i) {
+         const uint64_t region_begin = i * region_size;
+         uint64_t end = i + 1 == threads ? last_word : std::min((i + 1) * region_size - 1, last_word);
+         for (uint32_t num; end >= region_begin && end >= sizeof(uint64_t) && !failed; --end) {
+            if (is_trailing_word(end, num)) {
+               anchors[i] = anchor{end, num};
+               return;
+            }
+         }
+      });
+      if (failed) {
+         return false;
+      }
+
+      // a block covering a whole region leaves it without an anchor
+      anchors.erase(std::remove_if(anchors.begin(), anchors.end(), [](const anchor& a) { return a.end == block_log::npos; }),
+                    anchors.end());
+      if (anchors.empty() || anchors.back().end != last_word || anchors.back().num != last_block_num) {
+         return false;
+      }
+      for (size_t i = 1; i < anchors.size(); ++i) {
+         if (anchors[i].num <= anchors[i - 1].num) {
+            return false;
+         }
+      }
+
+      fc::remove_all(index_file_name);
+      {
+         std::ofstream index_stream(index_file_name.generic_string().c_str(), LOG_WRITE);
+      }
+      boost::filesystem::resize_file(index_file_name.generic_string(), uint64_t(num_blocks) * sizeof(uint64_t));
+      bip::file_mapping index_mapping(index_file_name.generic_string().c_str(), bip::read_write);
+      bip::mapped_region index_region(index_mapping, bip::read_write);
+      char* const index = static_cast<char*>(index_region.get_address());
+
+      std::atomic<uint32_t> blocks_written{0};
+      run([&](uint32_t i) {
+         if (i >= anchors.size()) {
+            return;
+         }
+         // walk back to the block after the previous anchor, whose trailing word must then come right before
+         const uint32_t lowest = i == 0 ? first_block_num : anchors[i - 1].num + 1;
+         uint64_t end = anchors[i].end;
+         for (uint32_t num = anchors[i].num; !failed; --num) {
+            const uint64_t pos = block_ending_at(end);
+            EOS_ASSERT( pos != block_log::npos && block_num_at(pos) == num, block_log_exception,
+                        "Unexpected block position ${pos} at ${end} in '${blocks_log}'",
+                        ("pos", pos)("end", end)("blocks_log", block_file_name.generic_string()) );
+            memcpy(index + uint64_t(num - first_block_num) * sizeof(uint64_t), &pos, sizeof(pos));
+            if (num == lowest) {
+               EOS_ASSERT( i == 0 || pos - sizeof(uint64_t) == anchors[i - 1].end, block_log_exception,
+                           "Block ${num} in '${blocks_log}' does not follow the block before it", ("num", num)("blocks_log", block_file_name.generic_string()) );
+               blocks_written += anchors[i].num - lowest + 1;
+               return;
+            }
+            end = pos - sizeof(uint64_t);
+         }
+      });
+      if (failed || blocks_written != num_blocks) {
+         return false;
+      }
+      index_region.flush();
+
+      ilog("Reconstructed index of ${n} blocks, first block ${first}, on ${threads} threads",
+           ("n", num_blocks)("first", first_block_num)("threads", threads));
+      return true;
+   }
+
    bool block_log::contains_genesis_state(uint32_t version, uint32_t first_block_num) {
       return version <= 2 || first_block_num == 1;
    }
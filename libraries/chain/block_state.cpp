@@ -101,4 +101,16 @@ namespace eosio { namespace chain {
    ,_cached_trxs( std::move(trx_metas) )
    {}
 
+   std::shared_ptr<const merkle_tree> block_state::transaction_merkle_tree()const {
+      auto tree = std::atomic_load( &_transaction_merkle_tree );
+      if( tree || !block ) return tree;
+
+      const auto& trxs = block->transactions;
+      auto trx_digests = hash_many( trxs.size(), [&trxs]( size_t i ) { return trxs[i].digest(); } );
+
+      tree = std::make_shared<const merkle_tree>( std::move(trx_digests) );
+      std::atomic_store( &_transaction_merkle_tree, tree );
+      return tree;
+   }
+
 } } /// eosio::chain
@@ -25,14 +25,23 @@
 #include <eosio/chain/chain_snapshot.hpp>
 #include <eosio/chain/thread_utils.hpp>
 #include <eosio/chain/platform_timer.hpp>
+#include <eosio/chain/trace_spans.hpp>
+#include <eosio/chain/signal_stats.hpp>
 
 #include <chainbase/chainbase.hpp>
+#include <fc/filesystem.hpp>
 #include <fc/io/json.hpp>
 #include <fc/log/logger_config.hpp>
 #include <fc/scoped_exit.hpp>
 #include <fc/variant_object.hpp>
 
+#include <condition_variable>
+#include <fstream>
+#include <future>
+#include <map>
 #include <new>
+#include <mutex>
+#include <thread>
 
 namespace eosio { namespace chain {
 
@@ -123,6 +132,7 @@ struct building_block {
    vector<transaction_metadata_ptr>      _pending_trx_metas;
    vector<transaction_receipt>           _pending_trx_receipts;
    vector<action_receipt>                _actions;
+   vector<transaction_trace_ptr>         _action_receipt_traces; ///< traces for applied_block_action_receipts
    optional<checksum256_type>            _transaction_mroot;
 };
 
@@ -244,7 +254,17 @@ struct controller_impl {
    bool                           trusted_producer_light_validation = false;
    uint32_t                       snapshot_head_block = 0;
    named_thread_pool              thread_pool;
+   shared_state_lock              state_lock;
    platform_timer                 timer;
+   table_touched_callback         on_table_touched;
+   table_lifecycle_callback       on_table_lifecycle;
+   block_deltas_applier           deltas_applier;
+
+   // key recovery started by start_recover_block_keys() for blocks not applied yet, taken by apply_block
+   static constexpr size_t                                 max_recover_keys_lookahead = 64; // blocks
+   std::mutex                                              recover_keys_lookahead_mtx;
+   std::map<block_id_type, vector<recover_keys_future>>    recover_keys_lookahead;
+   std::deque<block_id_type>                               recover_keys_lookahead_order; // oldest first
 #if defined(EOSIO_EOS_VM_RUNTIME_ENABLED) || defined(EOSIO_EOS_VM_JIT_RUNTIME_ENABLED)
    vm::wasm_allocator                 wasm_alloc;
 #endif
@@ -305,7 +325,8 @@ struct controller_impl {
     reversible_blocks( cfg.blocks_dir/config::reversible_blocks_dir_name,
         cfg.read_only ? database::read_only : database::read_write,
         cfg.reversible_cache_size, false, cfg.db_map_mode, cfg.db_hugepage_paths ),
-    blog( cfg.blocks_dir ),
+    blog( cfg.blocks_dir, cfg.blocks_log_stride, cfg.max_retained_block_files,
+          block_log_write_options{ cfg.blocks_log_queue_size, cfg.blocks_log_flush_interval, cfg.blocks_log_fsync } ),
     fork_db( cfg.state_dir ),
     wasmif( cfg.wasm_runtime, cfg.eosvmoc_tierup, db, cfg.state_dir, cfg.eosvmoc_config ),
     resource_limits( db ),
@@ -316,6 +337,9 @@ struct controller_impl {
     read_mode( cfg.read_mode ),
     thread_pool( "chain", cfg.thread_pool_size )
    {
+      // span recording is process wide, tracing may also be switched on and off at runtime
+      if( cfg.trace_spans ) span_tracer::set_enabled( true );
+
       fork_db.open( [this]( block_timestamp_type timestamp,
                             const flat_set<digest_type>& cur_features,
                             const vector<digest_type>& new_features )
@@ -353,6 +377,18 @@ struct controller_impl {
    SET_APP_HANDLER( eosio, eosio, canceldelay );
    }
 
+   const char* signal_name( const void* s ) const {
+      if( s == &self.block_start )                   return "block_start";
+      if( s == &self.pre_accepted_block )            return "pre_accepted_block";
+      if( s == &self.accepted_block_header )         return "accepted_block_header";
+      if( s == &self.accepted_block )                return "accepted_block";
+      if( s == &self.irreversible_block )            return "irreversible_block";
+      if( s == &self.accepted_transaction )          return "accepted_transaction";
+      if( s == &self.applied_transaction )           return "applied_transaction";
+      if( s == &self.applied_block_action_receipts ) return "applied_block_action_receipts";
+      return "signal";
+   }
+
    /**
     *  Plugins / observers listening to signals emited (such as accepted_transaction) might trigger
     *  errors and throw exceptions. Unless those exceptions are caught it could impact consensus and/or
@@ -364,6 +400,12 @@ struct controller_impl {
     */
    template<typename Signal, typename Arg>
    void emit( const Signal& s, Arg&& a ) {
+      const char* name = signal_name( &s );
+      scoped_span span( name, "signal", head ? head->block_num : 0 );
+      const auto start = fc::time_point::now();
+      auto record = fc::make_scoped_exit( [name, start]() {
+         signal_stats::record( name, "all", ( fc::time_point::now() - start ).count() );
+      } );
       try {
          s( std::forward<Arg>( a ));
       } catch (std::bad_alloc& e) {
@@ -386,6 +428,7 @@ struct controller_impl {
 
    void log_irreversible() {
       EOS_ASSERT( fork_db.root(), fork_database_exception, "fork database not properly initialized" );
+      scoped_span span( "log_irreversible", "controller", head ? head->block_num : 0 );
 
       const auto& log_head = blog.head();
 
@@ -469,6 +512,134 @@ struct controller_impl {
       initialize_database(genesis);
    }
 
+   /**
+    *  Irreversible replay in three stages bounded by a queue of depth blocks: the replay-io thread reads serialized
+    *  blocks from the block log, the chain thread pool unpacks them, which computes the transaction ids, and creates
+    *  the transaction metadata or starts recovering the keys, and the main thread only applies them, in order.
+    */
+   struct replay_pipeline {
+      static constexpr size_t depth = max_recover_keys_lookahead / 2; // so no key recovery started ahead is dropped
+
+      struct decoded_block {
+         signed_block_ptr                 block;
+         vector<transaction_metadata_ptr> trx_metas; // when auth checks are skipped
+      };
+
+      controller_impl&                       my;
+      uint32_t                               next_num;
+      std::mutex                             mtx;
+      std::condition_variable                cv;
+      std::deque<std::future<decoded_block>> queue;
+      bool                                   done = false; // the read stage reached the end of the block log
+      bool                                   stop = false;
+      std::thread                            io_thread;
+
+      // busy time of each stage, in microseconds
+      std::atomic<int64_t>                   read_us{0};
+      std::atomic<int64_t>                   decode_us{0};
+      int64_t                                wait_us = 0; // main thread waiting for the next block
+      int64_t                                apply_us = 0;
+
+      replay_pipeline( controller_impl& my, uint32_t first_block_num ) : my( my ), next_num( first_block_num ) {
+         io_thread = std::thread( [this]() {
+            fc::set_os_thread_name( "replay-io" );
+            read_loop();
+         } );
+      }
+
+      ~replay_pipeline() {
+         {
+            std::lock_guard<std::mutex> g( mtx );
+            stop = true;
+         }
+         cv.notify_all();
+         io_thread.join();
+         // decode tasks still running refer to this
+         for( auto& f : queue )
+            f.wait();
+      }
+
+      void read_loop() {
+         try {
+            while( true ) {
+               {
+                  std::unique_lock<std::mutex> g( mtx );
+                  cv.wait( g, [&]() { return stop || queue.size() < depth; } );
+                  if( stop ) break;
+               }
+               auto start = fc::time_point::now();
+               auto data = my.blog.read_serialized_block( next_num );
+               read_us += (fc::time_point::now() - start).count();
+               if( data.empty() ) break;
+               ++next_num;
+
+               auto f = async_thread_pool( my.thread_pool.get_executor(), [this, data{std::move( data )}]() {
+                  return decode( data );
+               } );
+               {
+                  std::lock_guard<std::mutex> g( mtx );
+                  queue.emplace_back( std::move( f ) );
+               }
+               cv.notify_all();
+            }
+         } catch( ... ) {
+            // handed to the main thread in place of the block that could not be read
+            std::promise<decoded_block> failed;
+            failed.set_exception( std::current_exception() );
+            std::lock_guard<std::mutex> g( mtx );
+            queue.emplace_back( failed.get_future() );
+         }
+         {
+            std::lock_guard<std::mutex> g( mtx );
+            done = true;
+         }
+         cv.notify_all();
+      }
+
+      decoded_block decode( const std::vector<char>& data ) {
+         auto start = fc::time_point::now();
+         decoded_block d;
+         d.block = std::make_shared<signed_block>();
+         fc::datastream<const char*> ds( data.data(), data.size() );
+         fc::raw::unpack( ds, *d.block );
+         if( my.conf.force_all_checks ) {
+            my.start_recover_block_keys( d.block );
+         } else {
+            for( const auto& receipt : d.block->transactions ) {
+               if( receipt.trx.contains<packed_transaction>() )
+                  d.trx_metas.emplace_back( transaction_metadata::create_no_recover_keys(
+                        receipt.trx.get<packed_transaction>(), transaction_metadata::trx_type::input ) );
+            }
+         }
+         decode_us += (fc::time_point::now() - start).count();
+         return d;
+      }
+
+      /// @return the next block of the block log, an empty block at its end
+      decoded_block next() {
+         auto start = fc::time_point::now();
+         std::future<decoded_block> f;
+         {
+            std::unique_lock<std::mutex> g( mtx );
+            cv.wait( g, [&]() { return done || !queue.empty(); } );
+            if( queue.empty() ) return {};
+            f = std::move( queue.front() );
+            queue.pop_front();
+         }
+         cv.notify_all();
+         decoded_block d = f.get();
+         wait_us += (fc::time_point::now() - start).count();
+         return d;
+      }
+
+      void log_stages( uint32_t blocks ) const {
+         if( blocks == 0 ) return;
+         ilog( "replay stages per block: read ${r} us, decode ${d} us (on ${t} threads), apply ${a} us, waiting for blocks ${w} us",
+               ("r", read_us / blocks)("d", decode_us / blocks)("t", my.conf.thread_pool_size)
+               ("a", apply_us / blocks)("w", wait_us / blocks) );
+      }
+   };
+
    void replay(std::function<bool()> shutdown) {
       auto blog_head = blog.head();
       auto blog_head_time = blog_head->timestamp.to_time_point();
@@ -482,10 +653,19 @@ struct controller_impl {
          ilog( "existing block log, attempting to replay from ${s} to ${n} blocks",
                ("s", start_block_num)("n", blog_head->block_num()) );
          try {
-            while( auto next = blog.read_block_by_num( head->block_num + 1 ) ) {
-               replay_push_block( next, controller::block_status::irreversible );
-               if( next->block_num() % 500 == 0 ) {
-                  ilog( "${n} of ${head}", ("n", next->block_num())("head", blog_head->block_num()) );
+            replay_pipeline pipeline( *this, start_block_num );
+            auto log_stages = fc::make_scoped_exit( [&]() { pipeline.log_stages( head->block_num + 1 - start_block_num ); } );
+            while( true ) {
+               auto next = pipeline.next();
+               if( !next.block ) break;
+               const auto block_num = next.block->block_num();
+               auto apply_start = fc::time_point::now();
+               replay_push_block( next.block, controller::block_status::irreversible, std::move( next.trx_metas ) );
+               pipeline.apply_us += (fc::time_point::now() - apply_start).count();
+               if( conf.replay_checkpoint_interval > 0 && block_num % conf.replay_checkpoint_interval == 0 )
+                  write_replay_checkpoint();
+               if( block_num % 500 == 0 ) {
+                  ilog( "${n} of ${head}", ("n", block_num)("head", blog_head->block_num()) );
                   if( shutdown() ) break;
                }
             }
@@ -536,6 +716,40 @@ struct controller_impl {
       }
    }
 
+   /// snapshot of the state after the last replayed block, an interrupted replay can resume from it
+   void write_replay_checkpoint() {
+      try {
+         const auto& dir = conf.replay_checkpoint_dir;
+         fc::create_directories( dir );
+         const auto name = "replay-" + std::to_string( head->block_num ) + ".bin";
+         const auto tmp = dir / (name + ".tmp");
+         {
+            std::ofstream out( tmp.generic_string(), std::ios::out | std::ios::binary );
+            auto writer = std::make_shared<ostream_snapshot_writer>( out );
+            // the fork database head is not advanced by the irreversible replay
+            add_to_snapshot( writer, *head );
+            writer->finalize();
+            out.flush();
+            EOS_ASSERT( out.good(), snapshot_exception, "failed to write replay checkpoint ${p}", ("p", tmp.generic_string()) );
+         }
+         fc::rename( tmp, dir / name );
+         ilog( "wrote replay checkpoint ${p}", ("p", (dir / name).generic_string()) );
+
+         // keep the previous checkpoint too, in case the process dies while writing the next one
+         std::map<uint32_t, fc::path> checkpoints;
+         for( fc::directory_iterator it( dir ), end; it != end; ++it ) {
+            uint32_t num = 0;
+            char extra = 0;
+            if( sscanf( (*it).filename().generic_string().c_str(), "replay-%u.bin%c", &num, &extra ) == 1 )
+               checkpoints[num] = *it;
+         }
+         while( checkpoints.size() > 2 ) {
+            fc::remove( checkpoints.begin()->second );
+            checkpoints.erase( checkpoints.begin() );
+         }
+      } FC_LOG_AND_DROP()
+   }
+
    void startup(std::function<bool()> shutdown, const snapshot_reader_ptr& snapshot) {
       EOS_ASSERT( snapshot, snapshot_exception, "No snapshot reader provided" );
       ilog( "Starting initialization from snapshot, this may take a significant amount of time" );
@@ -758,6 +972,51 @@ struct controller_impl {
             maybe_switch_forks( pending_head, controller::block_status::complete, forked_branch_callback{}, trx_meta_cache_lookup{} );
          }
       }
+
+      eosvmoc_warmup();
+   }
+
+   /**
+    *  Queues EOS VM OC compiles of the contracts called by the last eosvmoc_config.warmup_blocks blocks of the block log,
+    *  most called first, so hot contracts run optimized from their first execution after a cache wipe or upgrade.
+    *  Only the receivers of the transactions' own actions are counted, notifications and inline actions are not in blocks.
+    */
+   void eosvmoc_warmup() {
+      if( !conf.eosvmoc_tierup || conf.eosvmoc_config.warmup_blocks == 0 || !blog.head() )
+         return;
+
+      const uint32_t last = blog.head()->block_num();
+      const uint32_t first = std::max( blog.first_block_num(),
+                                       last > conf.eosvmoc_config.warmup_blocks ? last - conf.eosvmoc_config.warmup_blocks + 1 : 1 );
+      std::map<account_name, uint32_t> calls;
+      for( uint32_t n = first; n <= last; ++n ) {
+         const auto b = blog.read_block_by_num( n );
+         if( !b ) continue;
+         for( const auto& receipt : b->transactions ) {
+            if( !receipt.trx.contains<packed_transaction>() ) continue;
+            const transaction& trx = receipt.trx.get<packed_transaction>().get_transaction();
+            for( const auto& a : trx.context_free_actions )
+               ++calls[a.account];
+            for( const auto& a : trx.actions )
+               ++calls[a.account];
+         }
+      }
+
+      vector<std::pair<uint32_t, account_name>> by_calls;
+      by_calls.reserve( calls.size() );
+      for( const auto& c : calls )
+         by_calls.emplace_back( c.second, c.first );
+      std::sort( by_calls.begin(), by_calls.end(), []( const auto& a, const auto& b ) { return a.first > b.first; } );
+
+      uint32_t queued = 0;
+      for( const auto& c : by_calls ) {
+         const auto* metadata = db.find<account_metadata_object, by_name>( c.second );
+         if( !metadata || metadata->code_hash == digest_type() )
+            continue;
+         wasmif.eosvmoc_warmup( metadata->code_hash, metadata->vm_version );
+         ++queued;
+      }
+      ilog( "queued EOS VM OC warmup of ${q} contracts called in blocks ${f} to ${l}", ("q", queued)("f", first)("l", last) );
    }
 
    ~controller_impl() {
@@ -841,12 +1100,16 @@ struct controller_impl {
    }
 
    void add_to_snapshot( const snapshot_writer_ptr& snapshot ) const {
+      add_to_snapshot( snapshot, *fork_db.head() );
+   }
+
+   void add_to_snapshot( const snapshot_writer_ptr& snapshot, const block_header_state& head_state ) const {
       snapshot->write_section<chain_snapshot_header>([this]( auto &section ){
          section.add_row(chain_snapshot_header(), db);
       });
 
-      snapshot->write_section<block_state>([this]( auto &section ){
-         section.template add_row<block_header_state>(*fork_db.head(), db);
+      snapshot->write_section<block_state>([this, &head_state]( auto &section ){
+         section.template add_row<block_header_state>(head_state, db);
       });
 
       controller_index_set::walk_indices([this, &snapshot]( auto utils ){
@@ -996,6 +1259,12 @@ struct controller_impl {
       return enc.result();
    }
 
+   sha256 calculate_tree_integrity_hash( size_t num_threads ) const {
+      auto hash_writer = std::make_shared<tree_integrity_hash_snapshot_writer>(num_threads);
+      add_to_snapshot(hash_writer);
+      return hash_writer->finalize();
+   }
+
    void create_native_account( const fc::time_point& initial_timestamp, account_name name, const authority& owner, const authority& active, bool is_privileged = false ) {
       db.create<account_object>([&](auto& a) {
          a.name = name;
@@ -1084,22 +1353,41 @@ struct controller_impl {
                                                                              genesis.initial_timestamp );
    }
 
+   /**
+    * Remember trace for applied_block_action_receipts if it contains a token transfer, i.e. a transfer
+    * action executed by its own contract. Subscribers decide which token contracts they care about.
+    * Called for every transaction that makes it into the pending block, so produced,
+    * speculative and validated blocks are all covered.
+    */
+   void record_action_receipt_trace( const transaction_trace_ptr& trace ) {
+      if( !trace || self.applied_block_action_receipts.empty() ) return; // only pay for filtering when somebody listens
+      for( const auto& at : trace->action_traces ) {
+         if( at.act.name == N(transfer) && at.receiver == at.act.account ) {
+            pending->_block_stage.get<building_block>()._action_receipt_traces.push_back( trace );
+            return;
+         }
+      }
+   }
+
    // The returned scoped_exit should not exceed the lifetime of the pending which existed when make_block_restore_point was called.
    fc::scoped_exit<std::function<void()>> make_block_restore_point() {
       auto& bb = pending->_block_stage.get<building_block>();
       auto orig_block_transactions_size = bb._pending_trx_receipts.size();
       auto orig_state_transactions_size = bb._pending_trx_metas.size();
       auto orig_state_actions_size      = bb._actions.size();
+      auto orig_receipt_traces_size     = bb._action_receipt_traces.size();
 
       std::function<void()> callback = [this,
                                         orig_block_transactions_size,
                                         orig_state_transactions_size,
-                                        orig_state_actions_size]()
+                                        orig_state_actions_size,
+                                        orig_receipt_traces_size]()
       {
          auto& bb = pending->_block_stage.get<building_block>();
          bb._pending_trx_receipts.resize(orig_block_transactions_size);
          bb._pending_trx_metas.resize(orig_state_transactions_size);
          bb._actions.resize(orig_state_actions_size);
+         bb._action_receipt_traces.resize(orig_receipt_traces_size);
       };
 
       return fc::make_scoped_exit( std::move(callback) );
@@ -1144,6 +1432,7 @@ struct controller_impl {
          trace->receipt = push_receipt( gtrx.trx_id, transaction_receipt::soft_fail,
                                         trx_context.billed_cpu_time_us, trace->net_usage );
          fc::move_append( pending->_block_stage.get<building_block>()._actions, move(trx_context.executed) );
+         record_action_receipt_trace( trace );
 
          trx_context.squash();
          restore.cancel();
@@ -1287,6 +1576,7 @@ struct controller_impl {
                                         trace->net_usage );
 
          fc::move_append( pending->_block_stage.get<building_block>()._actions, move(trx_context.executed) );
+         record_action_receipt_trace( trace );
 
          trace->account_ram_delta = account_delta( gtrx.payer, trx_removal_ram_delta );
 
@@ -1423,6 +1713,9 @@ struct controller_impl {
             }
          }
 
+         // without an undo session the changes of a dry run could not be reverted
+         EOS_ASSERT( !trx->dry_run || !self.skip_db_sessions(), transaction_type_exception, "dry run requires undo sessions" );
+
          const signed_transaction& trn = trx->packed_trx()->get_signed_transaction();
          transaction_checktime_timer trx_timer(timer);
          transaction_context trx_context(self, trn, trx->id(), std::move(trx_timer), start);
@@ -1459,6 +1752,11 @@ struct controller_impl {
             trx_context.exec();
             trx_context.finalize(); // Automatically rounds up network and CPU usage in trace and bills payers if successful
 
+            if( trx->dry_run ) {
+               trx_context.undo();
+               return trace;
+            }
+
             auto restore = make_block_restore_point();
 
             if (!trx->implicit) {
@@ -1477,6 +1775,7 @@ struct controller_impl {
             }
 
             fc::move_append(pending->_block_stage.get<building_block>()._actions, move(trx_context.executed));
+            record_action_receipt_trace( trace );
 
             // call the accept signal but only once for this transaction
             if (!trx->accepted) {
@@ -1505,8 +1804,10 @@ struct controller_impl {
             trace->except_ptr = std::current_exception();
          }
 
-         emit( self.accepted_transaction, trx );
-         emit( self.applied_transaction, std::tie(trace, trn) );
+         if( !trx->dry_run ) {
+            emit( self.accepted_transaction, trx );
+            emit( self.applied_transaction, std::tie(trace, trn) );
+         }
 
          return trace;
       } FC_CAPTURE_AND_RETHROW((trace))
@@ -1615,7 +1916,7 @@ struct controller_impl {
 
          if( gpo.proposed_schedule_block_num.valid() && // if there is a proposed schedule that was proposed in a block ...
              ( *gpo.proposed_schedule_block_num <= pbhs.dpos_irreversible_blocknum ) && // ... that has now become irreversible ...
-             pbhs.prev_pending_schedule.schedule.producers.size() == 0 // ... and there was room for a new pending schedule prior to any possible promotion
+             pbhs.prev_pending_schedule.schedule->producers.size() == 0 // ... and there was room for a new pending schedule prior to any possible promotion
          )
          {
             // Promote proposed schedule to pending schedule.
@@ -1686,9 +1987,14 @@ struct controller_impl {
 
       auto& bb = pending->_block_stage.get<building_block>();
 
+      if( !bb._action_receipt_traces.empty() ) {
+         const uint32_t block_num = pbhs.block_num;
+         emit( self.applied_block_action_receipts, std::tie( block_num, bb._action_receipt_traces, bb._actions ) );
+      }
+
       // Create (unsigned) block:
       auto block_ptr = std::make_shared<signed_block>( pbhs.make_block_header(
-         bb._transaction_mroot ? *bb._transaction_mroot : calculate_trx_merkle( bb._pending_trx_receipts ),
+         bb._transaction_mroot ? *bb._transaction_mroot : calculate_trx_merkle( bb._pending_trx_receipts, &thread_pool.get_executor() ),
          calculate_action_merkle(),
          bb._new_pending_producer_schedule,
          std::move( bb._new_protocol_feature_activations ),
@@ -1854,7 +2160,13 @@ struct controller_impl {
 
    void apply_block( const block_state_ptr& bsp, controller::block_status s, const trx_meta_cache_lookup& trx_lookup )
    { try {
+      scoped_span span( "apply_block", "controller", bsp->block_num );
       try {
+         if( deltas_applier ) {
+            apply_block_deltas( bsp, s );
+            return;
+         }
+
          const signed_block_ptr& b = bsp->block;
          const auto& new_protocol_feature_activations = bsp->get_new_protocol_feature_activations();
 
@@ -1869,10 +2181,15 @@ struct controller_impl {
          if( pub_keys_recovered || (skip_auth_checks && existing_trxs_metas) ) {
             use_bsp_cached = true;
          } else {
+            auto lookahead = take_recover_keys_lookahead( bsp->id );
             trx_metas.reserve( b->transactions.size() );
+            // recovered together once the whole block has been looked at
+            vector<size_t> recover_idxs;
+            vector<packed_transaction_ptr> recover_trxs;
             for( const auto& receipt : b->transactions ) {
                if( receipt.trx.contains<packed_transaction>()) {
                   const auto& pt = receipt.trx.get<packed_transaction>();
+                  const size_t idx = trx_metas.size();
                   transaction_metadata_ptr trx_meta_ptr = trx_lookup ? trx_lookup( pt.id() ) : transaction_metadata_ptr{};
                   if( trx_meta_ptr && ( skip_auth_checks || !trx_meta_ptr->recovered_keys().empty() ) ) {
                      trx_metas.emplace_back( std::move( trx_meta_ptr ), recover_keys_future{} );
@@ -1880,20 +2197,26 @@ struct controller_impl {
                      trx_metas.emplace_back(
                            transaction_metadata::create_no_recover_keys( pt, transaction_metadata::trx_type::input ),
                            recover_keys_future{} );
+                  } else if( idx < lookahead.size() && lookahead[idx].valid() ) {
+                     trx_metas.emplace_back( transaction_metadata_ptr{}, std::move( lookahead[idx] ) );
                   } else {
-                     auto ptrx = std::make_shared<packed_transaction>( pt );
-                     auto fut = transaction_metadata::start_recover_keys(
-                           std::move( ptrx ), thread_pool.get_executor(), chain_id, microseconds::maximum() );
-                     trx_metas.emplace_back( transaction_metadata_ptr{}, std::move( fut ) );
+                     recover_idxs.push_back( idx );
+                     recover_trxs.emplace_back( std::make_shared<packed_transaction>( pt ) );
+                     trx_metas.emplace_back( transaction_metadata_ptr{}, recover_keys_future{} );
                   }
                }
             }
+            if( !recover_trxs.empty() ) {
+               auto futures = transaction_metadata::start_recover_keys(
+                     std::move( recover_trxs ), thread_pool.get_executor(), chain_id, microseconds::maximum() );
+               for( size_t i = 0; i < futures.size(); ++i ) {
+                  std::get<1>( trx_metas[recover_idxs[i]] ) = std::move( futures[i] );
+               }
+            }
          }
 
          transaction_trace_ptr trace;
-         transaction_trace_ptr cross_trade_trace;
 
-         std::vector<transaction_trace_ptr> trx_traces;
          size_t packed_idx = 0;
          for( const auto& receipt : b->transactions ) {
             const auto& trx_receipts = pending->_block_stage.get<building_block>()._pending_trx_receipts;
@@ -1911,19 +2234,6 @@ struct controller_impl {
                EOS_ASSERT( false, block_validate_exception, "encountered unexpected receipt type" );
             }
 
-            // filter cross trade trace
-            auto action_traces = trace->action_traces;
-            for (size_t i = 0; i < action_traces.size(); ++i) {
-               auto act = action_traces[i].act;
-               auto receiver = action_traces[i].receiver;
-               if (act.account == name("eosio.token") && act.name == name("transfer") && receiver == name("eosio.token")) {
-                  cross_trade_trace = trace;
-                  if (cross_trade_trace) {
-                        trx_traces.push_back(cross_trade_trace);
-                  }
-               }
-            }
-
             bool transaction_failed =  trace && trace->except;
             bool transaction_can_fail = receipt.status == transaction_receipt_header::hard_fail && receipt.trx.contains<transaction_id_type>();
             if( transaction_failed && !transaction_can_fail) {
@@ -1948,12 +2258,6 @@ struct controller_impl {
          // validated in create_block_state_future()
          pending->_block_stage.get<building_block>()._transaction_mroot = b->transaction_mroot;
 
-         auto _actions = pending->_block_stage.get<building_block>()._actions;
-
-         for (auto i = 0; i < trx_traces.size(); ++i) {
-            emit(self.apply_action_receipt, std::tie(trx_traces[i], _actions));
-         }
-
          finalize_block();
 
          auto& ab = pending->_block_stage.get<assembled_block>();
@@ -1966,7 +2270,10 @@ struct controller_impl {
                         ("producer_block_id", producer_block_id)("validator_block_id", ab._id) );
          }
 
-         if( !use_bsp_cached ) {
+         // the metas are only kept to recapture the transactions when the block is popped, which can not happen
+         // to a block applied as irreversible or applied in irreversible mode
+         const bool may_be_popped = s != controller::block_status::irreversible && read_mode != db_read_mode::IRREVERSIBLE;
+         if( !use_bsp_cached && may_be_popped ) {
             bsp->set_trxs_metas( std::move( ab._trx_metas ), !skip_auth_checks );
          }
          // create completed_block with the existing block_state as we just verified it is the same as assembled_block
@@ -1981,6 +2288,78 @@ struct controller_impl {
       }
    } FC_CAPTURE_AND_RETHROW() } /// apply_block
 
+   /// apply_block for a block whose state changes are written by deltas_applier instead of executing its transactions
+   void apply_block_deltas( const block_state_ptr& bsp, controller::block_status s ) {
+      EOS_ASSERT( !pending, block_validate_exception, "pending block already exists" );
+      EOS_ASSERT( db.revision() == head->block_num, database_exception, "db revision is not on par with head block",
+                  ("db.revision()", db.revision())("controller_head_block", head->block_num) );
+
+      emit( self.block_start, bsp->block_num );
+
+      const auto& new_protocol_feature_activations = bsp->get_new_protocol_feature_activations();
+      pending.emplace( maybe_session(db), *head, bsp->header.timestamp, bsp->header.confirmed, new_protocol_feature_activations );
+      pending->_block_status = s;
+      pending->_producer_block_id = bsp->id;
+
+      // the protocol state object is among the deltas, the feature set kept in memory and the whitelisted
+      // intrinsics the activation handlers add are not
+      const auto& pfs = protocol_features.get_protocol_feature_set();
+      for( const auto& feature_digest : new_protocol_feature_activations ) {
+         const auto& f = pfs.get_protocol_feature( feature_digest );
+         if( f.builtin_feature ) {
+            trigger_activation_handler( *f.builtin_feature );
+         }
+         protocol_features.activate_feature( feature_digest, bsp->block_num );
+      }
+
+      const bool applied = deltas_applier( bsp );
+      EOS_ASSERT( applied, block_validate_exception, "no state changes for block ${n} ${id}",
+                  ("n", bsp->block_num)("id", bsp->id) );
+
+      // block summaries are not among the deltas, transactions referencing the block need them
+      create_block_summary( bsp->id );
+
+      pending->_block_stage = completed_block{ bsp };
+      commit_block( false );
+   }
+
+   void start_recover_block_keys( const signed_block_ptr& b ) {
+      auto id = b->id();
+      {
+         std::lock_guard<std::mutex> g( recover_keys_lookahead_mtx );
+         if( recover_keys_lookahead.count( id ) ) return;
+      }
+
+      vector<packed_transaction_ptr> trxs;
+      trxs.reserve( b->transactions.size() );
+      for( const auto& receipt : b->transactions ) {
+         if( receipt.trx.contains<packed_transaction>() ) {
+            trxs.emplace_back( std::make_shared<packed_transaction>( receipt.trx.get<packed_transaction>() ) );
+         }
+      }
+      auto futures = transaction_metadata::start_recover_keys(
+            std::move( trxs ), thread_pool.get_executor(), chain_id, microseconds::maximum() );
+
+      std::lock_guard<std::mutex> g( recover_keys_lookahead_mtx );
+      if( !recover_keys_lookahead.emplace( id, std::move( futures ) ).second ) return;
+      recover_keys_lookahead_order.push_back( id );
+      while( recover_keys_lookahead_order.size() > max_recover_keys_lookahead ) {
+         recover_keys_lookahead.erase( recover_keys_lookahead_order.front() );
+         recover_keys_lookahead_order.pop_front();
+      }
+   }
+
+   /// @returns one future per packed_transaction of block id, empty if no lookahead was started for it
+   vector<recover_keys_future> take_recover_keys_lookahead( const block_id_type& id ) {
+      std::lock_guard<std::mutex> g( recover_keys_lookahead_mtx );
+      auto itr = recover_keys_lookahead.find( id );
+      if( itr == recover_keys_lookahead.end() ) return {};
+      auto result = std::move( itr->second );
+      recover_keys_lookahead.erase( itr );
+      recover_keys_lookahead_order.erase( std::find( recover_keys_lookahead_order.begin(), recover_keys_lookahead_order.end(), id ) );
+      return result;
+   }
+
    std::future<block_state_ptr> create_block_state_future( const signed_block_ptr& b ) {
       EOS_ASSERT( b, block_validate_exception, "null block" );
 
@@ -1995,6 +2374,7 @@ struct controller_impl {
                   "unlinkable block ${id}", ("id", id)("previous", b->previous) );
 
       return async_thread_pool( thread_pool.get_executor(), [b, prev, control=this]() {
+         scoped_span span( "create_block_state", "controller", prev->block_num + 1 );
          const bool skip_validate_signee = false;
 
          auto trx_mroot = calculate_trx_merkle( b->transactions );
@@ -2024,7 +2404,9 @@ struct controller_impl {
          trusted_producer_light_validation = old_value;
       });
       try {
+         scoped_span span( "push_block", "controller" );
          block_state_ptr bsp = block_state_future.get();
+         span.set_block_num( bsp->block_num );
          const auto& b = bsp->block;
 
          emit( self.pre_accepted_block, b );
@@ -2046,7 +2428,8 @@ struct controller_impl {
       } FC_LOG_AND_RETHROW( )
    }
 
-   void replay_push_block( const signed_block_ptr& b, controller::block_status s ) {
+   /// trx_metas, if not empty, are the metadata of the packed transactions of b, created without recovering keys
+   void replay_push_block( const signed_block_ptr& b, controller::block_status s, vector<transaction_metadata_ptr>&& trx_metas = {} ) {
       self.validate_db_available_size();
       self.validate_reversible_available_size();
 
@@ -2069,6 +2452,8 @@ struct controller_impl {
                         { check_protocol_features( timestamp, cur_features, new_features ); },
                         skip_validate_signee
          );
+         if( !trx_metas.empty() )
+            bsp->set_trxs_metas( std::move( trx_metas ), false );
 
          if( s != controller::block_status::irreversible ) {
             fork_db.add( bsp, true );
@@ -2116,6 +2501,23 @@ struct controller_impl {
               ("current_head_id", head->id)("current_head_num", head->block_num)("new_head_id", new_head->id)("new_head_num", new_head->block_num) );
          auto branches = fork_db.fetch_branch_from( new_head->id, head->id );
 
+         // Short fork take-overs mostly carry the same transactions on both branches. The metadata of the popped
+         // branch, recovered keys included, is reused for them before trx_lookup is asked, which on a node that
+         // does not produce has no forked transactions to offer. The state itself is redone by applying the blocks,
+         // chainbase keeps no undo sessions of popped blocks.
+         std::map<transaction_id_type, transaction_metadata_ptr> popped_trxs;
+         for( const auto& bsp : branches.second ) {
+            for( const auto& trx : bsp->trxs_metas() ) popped_trxs.emplace( trx->id(), trx );
+         }
+         trx_meta_cache_lookup switch_lookup = trx_lookup;
+         if( !popped_trxs.empty() ) {
+            switch_lookup = [&popped_trxs, &trx_lookup]( const transaction_id_type& id ) {
+               auto itr = popped_trxs.find( id );
+               if( itr != popped_trxs.end() ) return itr->second;
+               return trx_lookup ? trx_lookup( id ) : transaction_metadata_ptr{};
+            };
+         }
+
          if( branches.second.size() > 0 ) {
             for( auto itr = branches.second.begin(); itr != branches.second.end(); ++itr ) {
                pop_block();
@@ -2130,7 +2532,7 @@ struct controller_impl {
             optional<fc::exception> except;
             try {
                apply_block( *ritr, (*ritr)->is_valid() ? controller::block_status::validated
-                                                       : controller::block_status::complete, trx_lookup );
+                                                       : controller::block_status::complete, switch_lookup );
                fork_db.mark_valid( *ritr );
                head = *ritr;
             } catch (const fc::exception& e) {
@@ -2182,26 +2584,23 @@ struct controller_impl {
    }
 
    checksum256_type calculate_action_merkle() {
-      vector<digest_type> action_digests;
       const auto& actions = pending->_block_stage.get<building_block>()._actions;
-      action_digests.reserve( actions.size() );
-      for( const auto& a : actions )
-         action_digests.emplace_back( a.digest() );
+      auto action_digests = hash_many( actions.size(), [&actions]( size_t i ) { return actions[i].digest(); },
+                                       &thread_pool.get_executor() );
 
-      return merkle( move(action_digests) );
+      return merkle( move(action_digests), thread_pool.get_executor() );
    }
 
-   static checksum256_type calculate_trx_merkle( const vector<transaction_receipt>& trxs ) {
-      vector<digest_type> trx_digests;
-      trx_digests.reserve( trxs.size() );
-      for( const auto& a : trxs )
-         trx_digests.emplace_back( a.digest() );
+   // thread_pool is null when already running on a thread_pool thread
+   static checksum256_type calculate_trx_merkle( const vector<transaction_receipt>& trxs,
+                                                 boost::asio::io_context* thread_pool = nullptr ) {
+      auto trx_digests = hash_many( trxs.size(), [&trxs]( size_t i ) { return trxs[i].digest(); }, thread_pool );
 
-      return merkle( move(trx_digests) );
+      return thread_pool ? merkle( move(trx_digests), *thread_pool ) : merkle( move(trx_digests) );
    }
 
    void update_producers_authority() {
-      const auto& producers = pending->get_pending_block_header_state().active_schedule.producers;
+      const auto& producers = pending->get_pending_block_header_state().active_schedule->producers;
 
       auto update_permission = [&]( auto& permission, auto threshold ) {
          auto auth = authority( threshold, {}, {});
@@ -2621,6 +3020,7 @@ void controller::validate_protocol_features( const vector<digest_type>& features
 
 void controller::start_block( block_timestamp_type when, uint16_t confirm_block_count )
 {
+   std::lock_guard<shared_state_lock> g( my->state_lock );
    validate_db_available_size();
 
    EOS_ASSERT( !my->pending, block_validate_exception, "pending block already exists" );
@@ -2646,6 +3046,7 @@ void controller::start_block( block_timestamp_type when,
                               uint16_t confirm_block_count,
                               const vector<digest_type>& new_protocol_feature_activations )
 {
+   std::lock_guard<shared_state_lock> g( my->state_lock );
    validate_db_available_size();
 
    if( new_protocol_feature_activations.size() > 0 ) {
@@ -2657,6 +3058,7 @@ void controller::start_block( block_timestamp_type when,
 }
 
 block_state_ptr controller::finalize_block( const signer_callback_type& signer_callback ) {
+   std::lock_guard<shared_state_lock> g( my->state_lock );
    validate_db_available_size();
 
    my->finalize_block();
@@ -2681,19 +3083,29 @@ block_state_ptr controller::finalize_block( const signer_callback_type& signer_c
 }
 
 void controller::commit_block() {
+   std::lock_guard<shared_state_lock> g( my->state_lock );
    validate_db_available_size();
    validate_reversible_available_size();
    my->commit_block(true);
 }
 
 vector<transaction_metadata_ptr> controller::abort_block() {
+   std::lock_guard<shared_state_lock> g( my->state_lock );
    return my->abort_block();
 }
 
+void controller::start_recover_block_keys( const signed_block_ptr& b ) {
+   my->start_recover_block_keys( b );
+}
+
 boost::asio::io_context& controller::get_thread_pool() {
    return my->thread_pool.get_executor();
 }
 
+shared_state_lock& controller::get_state_lock()const {
+   return my->state_lock;
+}
+
 std::future<block_state_ptr> controller::create_block_state_future( const signed_block_ptr& b ) {
    return my->create_block_state_future( b );
 }
@@ -2701,6 +3113,7 @@ std::future<block_state_ptr> controller::create_block_state_future( const signed
 void controller::push_block( std::future<block_state_ptr>& block_state_future,
                              const forked_branch_callback& forked_branch_cb, const trx_meta_cache_lookup& trx_lookup )
 {
+   std::lock_guard<shared_state_lock> g( my->state_lock );
    validate_db_available_size();
    validate_reversible_available_size();
    my->push_block( block_state_future, forked_branch_cb, trx_lookup );
@@ -2708,6 +3121,7 @@ void controller::push_block( std::future<block_state_ptr>& block_state_future,
 
 transaction_trace_ptr controller::push_transaction( const transaction_metadata_ptr& trx, fc::time_point deadline,
                                                     uint32_t billed_cpu_time_us, bool explicit_billed_cpu_time ) {
+   std::lock_guard<shared_state_lock> g( my->state_lock );
    validate_db_available_size();
    EOS_ASSERT( get_read_mode() != db_read_mode::IRREVERSIBLE, transaction_type_exception, "push transaction not allowed in irreversible mode" );
    EOS_ASSERT( trx && !trx->implicit && !trx->scheduled, transaction_type_exception, "Implicit/Scheduled transaction not allowed" );
@@ -2717,6 +3131,7 @@ transaction_trace_ptr controller::push_transaction( const transaction_metadata_p
 transaction_trace_ptr controller::push_scheduled_transaction( const transaction_id_type& trxid, fc::time_point deadline,
                                                               uint32_t billed_cpu_time_us, bool explicit_billed_cpu_time )
 {
+   std::lock_guard<shared_state_lock> g( my->state_lock );
    EOS_ASSERT( get_read_mode() != db_read_mode::IRREVERSIBLE, transaction_type_exception, "push scheduled transaction not allowed in irreversible mode" );
    validate_db_available_size();
    return my->push_scheduled_transaction( trxid, deadline, billed_cpu_time_us, explicit_billed_cpu_time );
@@ -2891,6 +3306,10 @@ signed_block_ptr controller::fetch_block_by_number( uint32_t block_num )const  {
    return my->blog.read_block_by_num(block_num);
 } FC_CAPTURE_AND_RETHROW( (block_num) ) }
 
+std::vector<char> controller::fetch_serialized_block_by_number( uint32_t block_num )const  { try {
+   return my->blog.read_serialized_block(block_num);
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
 block_state_ptr controller::fetch_block_state_by_id( block_id_type id )const {
    auto state = my->fork_db.get_block(id);
    return state;
@@ -2947,6 +3366,10 @@ sha256 controller::calculate_integrity_hash()const { try {
    return my->calculate_integrity_hash();
 } FC_LOG_AND_RETHROW() }
 
+sha256 controller::calculate_tree_integrity_hash( size_t num_threads )const { try {
+   return my->calculate_tree_integrity_hash( num_threads );
+} FC_LOG_AND_RETHROW() }
+
 void controller::write_snapshot( const snapshot_writer_ptr& snapshot ) const {
    EOS_ASSERT( !my->pending, block_validate_exception, "cannot take a consistent snapshot with a pending block" );
    return my->add_to_snapshot(snapshot);
@@ -3005,20 +3428,20 @@ int64_t controller::set_proposed_producers( vector<producer_authority> producers
 
 const producer_authority_schedule&    controller::active_producers()const {
    if( !(my->pending) )
-      return  my->head->active_schedule;
+      return *my->head->active_schedule;
 
    if( my->pending->_block_stage.contains<completed_block>() )
-      return my->pending->_block_stage.get<completed_block>()._block_state->active_schedule;
+      return *my->pending->_block_stage.get<completed_block>()._block_state->active_schedule;
 
-   return my->pending->get_pending_block_header_state().active_schedule;
+   return *my->pending->get_pending_block_header_state().active_schedule;
 }
 
 const producer_authority_schedule& controller::pending_producers()const {
    if( !(my->pending) )
-      return  my->head->pending_schedule.schedule;
+      return *my->head->pending_schedule.schedule;
 
    if( my->pending->_block_stage.contains<completed_block>() )
-      return my->pending->_block_stage.get<completed_block>()._block_state->pending_schedule.schedule;
+      return *my->pending->_block_stage.get<completed_block>()._block_state->pending_schedule.schedule;
 
    if( my->pending->_block_stage.contains<assembled_block>() ) {
       const auto& new_prods_cache = my->pending->_block_stage.get<assembled_block>()._new_producer_authority_cache;
@@ -3032,7 +3455,7 @@ const producer_authority_schedule& controller::pending_producers()const {
    if( bb._new_pending_producer_schedule )
       return *bb._new_pending_producer_schedule;
 
-   return bb._pending_block_header_state.prev_pending_schedule.schedule;
+   return *bb._pending_block_header_state.prev_pending_schedule.schedule;
 }
 
 optional<producer_authority_schedule> controller::proposed_producers()const {
@@ -3118,11 +3541,30 @@ wasm_interface& controller::get_wasm_interface() {
    return my->wasmif;
 }
 
+const wasm_interface& controller::get_wasm_interface()const {
+   return my->wasmif;
+}
+
 const account_object& controller::get_account( account_name name )const
 { try {
    return my->db.get<account_object, by_name>(name);
 } FC_CAPTURE_AND_RETHROW( (name) ) }
 
+versioned_abi_serializer controller::get_versioned_abi_serializer( account_name n, const abi_serializer::yield_function_t& yield )const {
+   if( n.good() ) {
+      try {
+         const auto* a = my->db.find<account_object, by_name>( n );
+         abi_def abi;
+         if( a && abi_serializer::to_abi( a->abi, abi ) ) {
+            const auto& metadata = my->db.get<account_metadata_object, by_name>( n );
+            return versioned_abi_serializer( abi_serializer( abi, yield ),
+                                             abi_version{ metadata.abi_sequence, fc::sha256::hash( a->abi.data(), a->abi.size() ) } );
+         }
+      } FC_CAPTURE_AND_LOG((n))
+   }
+   return versioned_abi_serializer();
+}
+
 bool controller::sender_avoids_whitelist_blacklist_enforcement( account_name sender )const {
    return my->sender_avoids_whitelist_blacklist_enforcement( sender );
 }
@@ -3242,6 +3684,33 @@ uint32_t controller::get_greylist_limit()const {
    return my->conf.greylist_limit;
 }
 
+void controller::set_table_touched_callback( table_touched_callback cb ) {
+   my->on_table_touched = std::move(cb);
+}
+
+void controller::table_touched( const table_id_object& tid )const {
+   if( my->on_table_touched )
+      my->on_table_touched( tid );
+}
+
+void controller::set_table_lifecycle_callback( table_lifecycle_callback cb ) {
+   my->on_table_lifecycle = std::move(cb);
+}
+
+void controller::table_created( const table_id_object& tid )const {
+   if( my->on_table_lifecycle )
+      my->on_table_lifecycle( tid, true );
+}
+
+void controller::table_removed( const table_id_object& tid )const {
+   if( my->on_table_lifecycle )
+      my->on_table_lifecycle( tid, false );
+}
+
+void controller::set_block_deltas_applier( block_deltas_applier applier ) {
+   my->deltas_applier = std::move(applier);
+}
+
 void controller::add_resource_greylist(const account_name &name) {
    my->conf.resource_greylist.insert(name);
 }
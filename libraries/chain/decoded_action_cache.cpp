@@ -0,0 +1,59 @@
+#include <eosio/chain/decoded_action_cache.hpp>
+#include <fc/io/raw.hpp>
+
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+decoded_action_cache& decoded_action_cache::instance() {
+   static decoded_action_cache c;
+   return c;
+}
+
+decoded_action_cache::key decoded_action_cache::make_key( account_name account, const abi_version& abi, action_name act, const bytes& data ) {
+   fc::sha256::encoder enc;
+   fc::raw::pack( enc, abi.abi_hash );
+   fc::raw::pack( enc, act );
+   enc.write( data.data(), data.size() );
+   return key{ account, abi.abi_sequence, enc.result() };
+}
+
+void decoded_action_cache::set_max_size( size_t max_size ) {
+   std::unique_lock<std::shared_mutex> g( _mtx );
+   _max_size = max_size;
+   while( _insertion_order.size() > max_size ) {
+      _entries.erase( _insertion_order.front() );
+      _insertion_order.pop_front();
+   }
+}
+
+std::shared_ptr<const fc::variant> decoded_action_cache::find( const key& k ) const {
+   if( !enabled() )
+      return {};
+   std::shared_lock<std::shared_mutex> g( _mtx );
+   auto itr = _entries.find( k );
+   return itr != _entries.end() ? itr->second : nullptr;
+}
+
+std::shared_ptr<const fc::variant> decoded_action_cache::insert( const key& k, fc::variant decoded ) {
+   auto result = std::make_shared<const fc::variant>( std::move( decoded ) );
+   std::unique_lock<std::shared_mutex> g( _mtx );
+   if( _max_size == 0 )
+      return result;
+   auto r = _entries.emplace( k, result );
+   if( !r.second )
+      return r.first->second;
+   _insertion_order.push_back( k );
+   if( _insertion_order.size() > _max_size ) {
+      _entries.erase( _insertion_order.front() );
+      _insertion_order.pop_front();
+   }
+   return result;
+}
+
+size_t decoded_action_cache::size() const {
+   std::shared_lock<std::shared_mutex> g( _mtx );
+   return _entries.size();
+}
+
+} } // eosio::chain
@@ -8,7 +8,11 @@
 #include <boost/multi_index/global_fun.hpp>
 #include <boost/multi_index/composite_key.hpp>
 #include <fc/io/fstream.hpp>
+#include <fc/io/cfile.hpp>
+#include <algorithm>
+#include <deque>
 #include <fstream>
+#include <set>
 
 namespace eosio { namespace chain {
    using boost::multi_index_container;
@@ -17,7 +21,10 @@ namespace eosio { namespace chain {
    const uint32_t fork_database::magic_number = 0x30510FDB;
 
    const uint32_t fork_database::min_supported_version = 1;
-   const uint32_t fork_database::max_supported_version = 1;
+   const uint32_t fork_database::max_supported_version = 2;
+
+   // the journal is compacted when it holds this many more records than blocks in the fork database
+   static const uint32_t journal_compaction_slack = 1024;
 
    // work around block_state::is_valid being private
    inline bool block_state_is_valid( const block_state& bs ) {
@@ -27,8 +34,26 @@ namespace eosio { namespace chain {
    /**
     * History:
     * Version 1: initial version of the new refactored fork database portable format
+    * Version 2: fork_db.dat written on close replaced by the append-only journal fork_db.log
     */
 
+   /**
+    * Every change to the fork database is appended to the journal as a record of
+    * (uint32_t payload size, journal_op, payload). The journal starts with a reset record
+    * carrying the root, opening the fork database replays it. A record cut short by a crash
+    * is dropped on replay. advance_root rewrites the journal with only the live blocks
+    * once the records of pruned blocks dominate it.
+    */
+   enum class journal_op : uint8_t {
+      reset,                  ///< payload: root block_header_state
+      add,                    ///< payload: block_state
+      mark_valid,             ///< payload: block id
+      remove,                 ///< payload: block id
+      advance_root,           ///< payload: block id
+      rollback_head_to_root,  ///< no payload
+      set_head                ///< payload: block id
+   };
+
    struct by_block_id;
    struct by_lib_block_num;
    struct by_prev;
@@ -36,7 +61,7 @@ namespace eosio { namespace chain {
       block_state_ptr,
       indexed_by<
          hashed_unique< tag<by_block_id>, member<block_header_state, block_id_type, &block_header_state::id>, std::hash<block_id_type>>,
-         ordered_non_unique< tag<by_prev>, const_mem_fun<block_header_state, const block_id_type&, &block_header_state::prev> >,
+         hashed_non_unique< tag<by_prev>, const_mem_fun<block_header_state, const block_id_type&, &block_header_state::prev>, std::hash<block_id_type> >,
          ordered_unique< tag<by_lib_block_num>,
             composite_key< block_state,
                global_fun<const block_state&,            bool,          &block_state_is_valid>,
@@ -70,12 +95,68 @@ namespace eosio { namespace chain {
       block_state_ptr       root; // Only uses the block_header_state portion
       block_state_ptr       head;
       fc::path              datadir;
+      fc::cfile             journal;
+      uint32_t              journal_records = 0;
+
+      /// blocks of index by block number, slot i holds the blocks numbered first_block_num + i
+      std::deque<vector<block_state_ptr>> blocks_by_num;
+      uint32_t                            first_block_num = 0;
+      /// block numbers held by more than one block, empty while the fork database is a single chain
+      std::set<uint32_t>                  forked_block_nums;
+
+      void insert_block_num( const block_state_ptr& n );
+      void erase_block_num( const block_state_ptr& n );
+      void clear() {
+         index.clear();
+         blocks_by_num.clear();
+         forked_block_nums.clear();
+      }
+
+      /// true if there is only one block at each of the block numbers [lo, hi]
+      bool is_linear( uint32_t lo, uint32_t hi )const {
+         auto itr = forked_block_nums.lower_bound( lo );
+         return itr == forked_block_nums.end() || *itr > hi;
+      }
+
+      /// the only block numbered block_num, valid if is_linear covers block_num
+      block_state_ptr only_block( uint32_t block_num )const {
+         if( block_num < first_block_num || block_num - first_block_num >= blocks_by_num.size() ) return {};
+         const auto& slot = blocks_by_num[block_num - first_block_num];
+         return slot.empty() ? block_state_ptr() : slot.front();
+      }
 
       void add( const block_state_ptr& n,
                 bool ignore_duplicate, bool validate,
                 const std::function<void( block_timestamp_type,
                                           const flat_set<digest_type>&,
                                           const vector<digest_type>& )>& validator );
+      void remove( const block_id_type& id );
+
+      /// blocks in an order in which each block follows the block it links to
+      vector<block_state_ptr> ordered_blocks()const;
+
+      void read_fork_db_dat( const fc::path& fork_db_dat,
+                             const std::function<void( block_timestamp_type,
+                                                       const flat_set<digest_type>&,
+                                                       const vector<digest_type>& )>& validator );
+
+      /// @return false if the journal ended with an incomplete record
+      bool replay_journal( const fc::path& journal_path,
+                           const std::function<void( block_timestamp_type,
+                                                     const flat_set<digest_type>&,
+                                                     const vector<digest_type>& )>& validator );
+
+      static void write_record( fc::cfile& f, journal_op op, const vector<char>& payload );
+
+      /// appends to the journal unless it is closed, which it is while opening the fork database
+      void append( journal_op op, const vector<char>& payload = vector<char>() ) {
+         if( !journal.is_open() ) return;
+         write_record( journal, op, payload );
+         ++journal_records;
+      }
+
+      /// rewrites the journal with the current root, blocks and head
+      void compact();
    };
 
 
@@ -92,95 +173,208 @@ namespace eosio { namespace chain {
          fc::create_directories(my->datadir);
 
       auto fork_db_dat = my->datadir / config::forkdb_filename;
+      auto journal_path = my->datadir / config::forkdb_journal_filename;
+      bool rewrite = true;
       if( fc::exists( fork_db_dat ) ) {
+         // written by a version without the journal
          try {
-            string content;
-            fc::read_file_contents( fork_db_dat, content );
-
-            fc::datastream<const char*> ds( content.data(), content.size() );
-
-            // validate totem
-            uint32_t totem = 0;
-            fc::raw::unpack( ds, totem );
-            EOS_ASSERT( totem == magic_number, fork_database_exception,
-                        "Fork database file '${filename}' has unexpected magic number: ${actual_totem}. Expected ${expected_totem}",
-                        ("filename", fork_db_dat.generic_string())
-                        ("actual_totem", totem)
-                        ("expected_totem", magic_number)
-            );
-
-            // validate version
-            uint32_t version = 0;
-            fc::raw::unpack( ds, version );
-            EOS_ASSERT( version >= min_supported_version && version <= max_supported_version,
-                        fork_database_exception,
-                       "Unsupported version of fork database file '${filename}'. "
-                       "Fork database version is ${version} while code supports version(s) [${min},${max}]",
-                       ("filename", fork_db_dat.generic_string())
-                       ("version", version)
-                       ("min", min_supported_version)
-                       ("max", max_supported_version)
-            );
-
-            block_header_state bhs;
-            fc::raw::unpack( ds, bhs );
-            reset( bhs );
-
-            unsigned_int size; fc::raw::unpack( ds, size );
-            for( uint32_t i = 0, n = size.value; i < n; ++i ) {
-               block_state s;
-               fc::raw::unpack( ds, s );
-               // do not populate transaction_metadatas, they will be created as needed in apply_block with appropriate key recovery
-               s.header_exts = s.block->validate_and_extract_header_extensions();
-               my->add( std::make_shared<block_state>( move( s ) ), false, true, validator );
-            }
-            block_id_type head_id;
-            fc::raw::unpack( ds, head_id );
-
-            if( my->root->id == head_id ) {
-               my->head = my->root;
-            } else {
-               my->head = get_block( head_id );
-               EOS_ASSERT( my->head, fork_database_exception,
-                           "could not find head while reconstructing fork database from file; '${filename}' is likely corrupted",
-                           ("filename", fork_db_dat.generic_string()) );
-            }
-
-            auto candidate = my->index.get<by_lib_block_num>().begin();
-            if( candidate == my->index.get<by_lib_block_num>().end() || !(*candidate)->is_valid() ) {
-               EOS_ASSERT( my->head->id == my->root->id, fork_database_exception,
-                           "head not set to root despite no better option available; '${filename}' is likely corrupted",
-                           ("filename", fork_db_dat.generic_string()) );
-            } else {
-               EOS_ASSERT( !first_preferred( **candidate, *my->head ), fork_database_exception,
-                           "head not set to best available option available; '${filename}' is likely corrupted",
-                           ("filename", fork_db_dat.generic_string()) );
-            }
+            my->read_fork_db_dat( fork_db_dat, validator );
          } FC_CAPTURE_AND_RETHROW( (fork_db_dat) )
 
          fc::remove( fork_db_dat );
+      } else if( fc::exists( journal_path ) ) {
+         try {
+            rewrite = !my->replay_journal( journal_path, validator );
+         } FC_CAPTURE_AND_RETHROW( (journal_path) )
+      }
+
+      if( rewrite ) {
+         my->compact();
+      } else {
+         my->journal.set_file_path( journal_path );
+         my->journal.open( "ab+" );
       }
    }
 
-   void fork_database::close() {
-      auto fork_db_dat = my->datadir / config::forkdb_filename;
+   void fork_database_impl::read_fork_db_dat( const fc::path& fork_db_dat,
+                                              const std::function<void( block_timestamp_type,
+                                                                        const flat_set<digest_type>&,
+                                                                        const vector<digest_type>& )>& validator )
+   {
+      string content;
+      fc::read_file_contents( fork_db_dat, content );
+
+      fc::datastream<const char*> ds( content.data(), content.size() );
+
+      // validate totem
+      uint32_t totem = 0;
+      fc::raw::unpack( ds, totem );
+      EOS_ASSERT( totem == fork_database::magic_number, fork_database_exception,
+                  "Fork database file '${filename}' has unexpected magic number: ${actual_totem}. Expected ${expected_totem}",
+                  ("filename", fork_db_dat.generic_string())
+                  ("actual_totem", totem)
+                  ("expected_totem", fork_database::magic_number)
+      );
+
+      // validate version
+      uint32_t version = 0;
+      fc::raw::unpack( ds, version );
+      EOS_ASSERT( version == 1, fork_database_exception,
+                  "Unsupported version of fork database file '${filename}'. "
+                  "Fork database version is ${version} while only version 1 was written to this file",
+                  ("filename", fork_db_dat.generic_string())
+                  ("version", version)
+      );
 
-      if( !my->root ) {
-         if( my->index.size() > 0 ) {
-            elog( "fork_database is in a bad state when closing; not writing out '${filename}'",
-                  ("filename", fork_db_dat.generic_string()) );
+      block_header_state bhs;
+      fc::raw::unpack( ds, bhs );
+      self.reset( bhs );
+
+      unsigned_int size; fc::raw::unpack( ds, size );
+      for( uint32_t i = 0, n = size.value; i < n; ++i ) {
+         block_state s;
+         fc::raw::unpack( ds, s );
+         // do not populate transaction_metadatas, they will be created as needed in apply_block with appropriate key recovery
+         s.header_exts = s.block->validate_and_extract_header_extensions();
+         add( std::make_shared<block_state>( move( s ) ), false, true, validator );
+      }
+      block_id_type head_id;
+      fc::raw::unpack( ds, head_id );
+
+      if( root->id == head_id ) {
+         head = root;
+      } else {
+         head = self.get_block( head_id );
+         EOS_ASSERT( head, fork_database_exception,
+                     "could not find head while reconstructing fork database from file; '${filename}' is likely corrupted",
+                     ("filename", fork_db_dat.generic_string()) );
+      }
+
+      auto candidate = index.get<by_lib_block_num>().begin();
+      if( candidate == index.get<by_lib_block_num>().end() || !(*candidate)->is_valid() ) {
+         EOS_ASSERT( head->id == root->id, fork_database_exception,
+                     "head not set to root despite no better option available; '${filename}' is likely corrupted",
+                     ("filename", fork_db_dat.generic_string()) );
+      } else {
+         EOS_ASSERT( !first_preferred( **candidate, *head ), fork_database_exception,
+                     "head not set to best available option available; '${filename}' is likely corrupted",
+                     ("filename", fork_db_dat.generic_string()) );
+      }
+   }
+
+   bool fork_database_impl::replay_journal( const fc::path& journal_path,
+                                            const std::function<void( block_timestamp_type,
+                                                                      const flat_set<digest_type>&,
+                                                                      const vector<digest_type>& )>& validator )
+   {
+      string content;
+      fc::read_file_contents( journal_path, content );
+
+      fc::datastream<const char*> ds( content.data(), content.size() );
+
+      uint32_t totem = 0;
+      fc::raw::unpack( ds, totem );
+      EOS_ASSERT( totem == fork_database::magic_number, fork_database_exception,
+                  "Fork database journal '${filename}' has unexpected magic number: ${actual_totem}. Expected ${expected_totem}",
+                  ("filename", journal_path.generic_string())
+                  ("actual_totem", totem)
+                  ("expected_totem", fork_database::magic_number)
+      );
+
+      uint32_t version = 0;
+      fc::raw::unpack( ds, version );
+      EOS_ASSERT( version == fork_database::max_supported_version, fork_database_exception,
+                  "Unsupported version of fork database journal '${filename}'. "
+                  "Journal version is ${version} while code supports version ${max}",
+                  ("filename", journal_path.generic_string())
+                  ("version", version)
+                  ("max", fork_database::max_supported_version)
+      );
+
+      journal_records = 0;
+      while( ds.remaining() > 0 ) {
+         uint32_t size = 0;
+         journal_op op;
+         if( ds.remaining() < sizeof(size) + sizeof(op) ) break;
+         fc::raw::unpack( ds, size );
+         ds.read( (char*)&op, sizeof(op) );
+         if( ds.remaining() < size ) break;
+
+         fc::datastream<const char*> rds( ds.pos(), size );
+         ds.skip( size );
+         ++journal_records;
+
+         block_id_type id;
+         switch( op ) {
+            case journal_op::reset: {
+               block_header_state bhs;
+               fc::raw::unpack( rds, bhs );
+               self.reset( bhs );
+               break;
+            }
+            case journal_op::add: {
+               block_state s;
+               fc::raw::unpack( rds, s );
+               // do not populate transaction_metadatas, they will be created as needed in apply_block with appropriate key recovery
+               s.header_exts = s.block->validate_and_extract_header_extensions();
+               add( std::make_shared<block_state>( move( s ) ), false, true, validator );
+               break;
+            }
+            case journal_op::mark_valid: {
+               fc::raw::unpack( rds, id );
+               auto bsp = self.get_block( id );
+               EOS_ASSERT( bsp, fork_database_exception,
+                           "journal marks unknown block ${id} as valid; '${filename}' is likely corrupted",
+                           ("id", id)("filename", journal_path.generic_string()) );
+               self.mark_valid( bsp );
+               break;
+            }
+            case journal_op::remove:
+               fc::raw::unpack( rds, id );
+               remove( id );
+               break;
+            case journal_op::advance_root:
+               fc::raw::unpack( rds, id );
+               self.advance_root( id );
+               break;
+            case journal_op::rollback_head_to_root:
+               self.rollback_head_to_root();
+               break;
+            case journal_op::set_head:
+               fc::raw::unpack( rds, id );
+               head = (root && root->id == id) ? root : self.get_block( id );
+               EOS_ASSERT( head, fork_database_exception,
+                           "could not find head while replaying fork database journal; '${filename}' is likely corrupted",
+                           ("filename", journal_path.generic_string()) );
+               break;
+            default:
+               EOS_THROW( fork_database_exception,
+                          "unknown record ${op} in fork database journal; '${filename}' is likely corrupted",
+                          ("op", static_cast<uint32_t>(op))("filename", journal_path.generic_string()) );
          }
-         return;
       }
 
-      std::ofstream out( fork_db_dat.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc );
-      fc::raw::pack( out, magic_number );
-      fc::raw::pack( out, max_supported_version ); // write out current version which is always max_supported_version
-      fc::raw::pack( out, *static_cast<block_header_state*>(&*my->root) );
-      uint32_t num_blocks_in_fork_db = my->index.size();
-      fc::raw::pack( out, unsigned_int{num_blocks_in_fork_db} );
+      if( ds.remaining() > 0 ) {
+         wlog( "dropping incomplete record at the end of fork database journal '${filename}'",
+               ("filename", journal_path.generic_string()) );
+         return false;
+      }
+      return true;
+   }
 
-      const auto& indx = my->index.get<by_lib_block_num>();
+   void fork_database_impl::write_record( fc::cfile& f, journal_op op, const vector<char>& payload ) {
+      uint32_t size = payload.size();
+      f.write( (const char*)&size, sizeof(size) );
+      f.write( (const char*)&op, sizeof(op) );
+      f.write( payload.data(), payload.size() );
+      f.flush();
+   }
+
+   vector<block_state_ptr> fork_database_impl::ordered_blocks()const {
+      vector<block_state_ptr> blocks;
+      blocks.reserve( index.size() );
+
+      const auto& indx = index.get<by_lib_block_num>();
 
       auto unvalidated_itr = indx.rbegin();
       auto unvalidated_end = boost::make_reverse_iterator( indx.lower_bound( false ) );
@@ -212,17 +406,55 @@ namespace eosio { namespace chain {
             ++validated_itr;
          }
 
-         fc::raw::pack( out, *(*itr) );
+         blocks.push_back( *itr );
       }
 
-      if( my->head ) {
-         fc::raw::pack( out, my->head->id );
-      } else {
-         elog( "head not set in fork database; '${filename}' will be corrupted",
-               ("filename", fork_db_dat.generic_string()) );
+      return blocks;
+   }
+
+   void fork_database_impl::compact() {
+      auto journal_path = datadir / config::forkdb_journal_filename;
+      auto journal_tmp  = datadir / (std::string(config::forkdb_journal_filename) + ".tmp");
+
+      if( journal.is_open() )
+         journal.close();
+
+      {
+         fc::cfile out;
+         out.set_file_path( journal_tmp );
+         out.open( "wb" );
+         out.write( (const char*)&fork_database::magic_number, sizeof(fork_database::magic_number) );
+         // write out current version which is always max_supported_version
+         out.write( (const char*)&fork_database::max_supported_version, sizeof(fork_database::max_supported_version) );
+         journal_records = 0;
+         if( root ) {
+            write_record( out, journal_op::reset, fc::raw::pack( *static_cast<block_header_state*>(&*root) ) );
+            for( const auto& bsp : ordered_blocks() ) {
+               write_record( out, journal_op::add, fc::raw::pack( *bsp ) );
+            }
+            if( head ) {
+               write_record( out, journal_op::set_head, fc::raw::pack( head->id ) );
+            }
+            journal_records = index.size() + 2;
+         }
+         out.close();
       }
+      fc::rename( journal_tmp, journal_path );
 
-      my->index.clear();
+      journal.set_file_path( journal_path );
+      journal.open( "ab+" );
+   }
+
+   void fork_database::close() {
+      if( !my->root && my->index.size() > 0 ) {
+         elog( "fork_database is in a bad state when closing" );
+      }
+
+      // every change is already in the journal
+      if( my->journal.is_open() )
+         my->journal.close();
+
+      my->clear();
    }
 
    fork_database::~fork_database() {
@@ -230,11 +462,15 @@ namespace eosio { namespace chain {
    }
 
    void fork_database::reset( const block_header_state& root_bhs ) {
-      my->index.clear();
+      my->clear();
       my->root = std::make_shared<block_state>();
       static_cast<block_header_state&>(*my->root) = root_bhs;
       my->root->validated = true;
       my->head = my->root;
+
+      // nothing before the reset is needed anymore
+      if( my->journal.is_open() )
+         my->compact();
    }
 
    void fork_database::rollback_head_to_root() {
@@ -247,6 +483,8 @@ namespace eosio { namespace chain {
          ++itr;
       }
       my->head = my->root;
+
+      my->append( journal_op::rollback_head_to_root );
    }
 
    void fork_database::advance_root( const block_id_type& id ) {
@@ -268,11 +506,12 @@ namespace eosio { namespace chain {
 
       // The new root block should be erased from the fork database index individually rather than with the remove method,
       // because we do not want the blocks branching off of it to be removed from the fork database.
+      my->erase_block_num( new_root );
       my->index.erase( my->index.find( id ) );
 
       // The other blocks to be removed are removed using the remove method so that orphaned branches do not remain in the fork database.
       for( const auto& block_id : blocks_to_remove ) {
-         remove( block_id );
+         my->remove( block_id );
       }
 
       // Even though fork database no longer needs block or trxs when a block state becomes a root of the tree,
@@ -280,6 +519,11 @@ namespace eosio { namespace chain {
       // parts of the code which run asynchronously (e.g. mongo_db_plugin) may later expect it remain unmodified.
 
       my->root = new_root;
+
+      my->append( journal_op::advance_root, fc::raw::pack( id ) );
+      if( my->journal.is_open() && my->journal_records > 2 * my->index.size() + journal_compaction_slack ) {
+         my->compact();
+      }
    }
 
    block_header_state_ptr fork_database::get_block_header( const block_id_type& id )const {
@@ -326,6 +570,9 @@ namespace eosio { namespace chain {
          if( ignore_duplicate ) return;
          EOS_THROW( fork_database_exception, "duplicate block added", ("id", n->id) );
       }
+      insert_block_num( n );
+
+      append( journal_op::add, fc::raw::pack( *n ) );
 
       auto candidate = index.get<by_lib_block_num>().begin();
       if( (*candidate)->is_valid() ) {
@@ -360,7 +607,21 @@ namespace eosio { namespace chain {
 
    branch_type fork_database::fetch_branch( const block_id_type& h, uint32_t trim_after_block_num )const {
       branch_type result;
-      for( auto s = get_block(h); s; s = get_block( s->header.previous ) ) {
+      auto head = get_block(h);
+      if( !head ) return result;
+
+      // on a single chain the branch is every block from h down to the root
+      if( my->is_linear( my->first_block_num, head->block_num ) ) {
+         uint32_t num = std::min( head->block_num, trim_after_block_num );
+         if( num < my->first_block_num ) return result;
+         result.reserve( num - my->first_block_num + 1 );
+         for( ; num >= my->first_block_num; --num ) {
+            result.push_back( my->only_block( num ) );
+         }
+         return result;
+      }
+
+      for( auto s = head; s; s = get_block( s->header.previous ) ) {
          if( s->block_num <= trim_after_block_num )
              result.push_back( s );
       }
@@ -369,7 +630,15 @@ namespace eosio { namespace chain {
    }
 
    block_state_ptr fork_database::search_on_branch( const block_id_type& h, uint32_t block_num )const {
-      for( auto s = get_block(h); s; s = get_block( s->header.previous ) ) {
+      auto head = get_block(h);
+      if( !head || block_num > head->block_num ) return {};
+
+      // every block between block_num and h is on the branch when there is no other block at those numbers
+      if( my->is_linear( block_num, head->block_num ) ) {
+         return my->only_block( block_num );
+      }
+
+      for( auto s = head; s; s = get_block( s->header.previous ) ) {
          if( s->block_num == block_num )
              return s;
       }
@@ -442,25 +711,70 @@ namespace eosio { namespace chain {
 
    /// remove all of the invalid forks built off of this id including this id
    void fork_database::remove( const block_id_type& id ) {
+      my->remove( id );
+      my->append( journal_op::remove, fc::raw::pack( id ) );
+   }
+
+   void fork_database_impl::remove( const block_id_type& id ) {
       vector<block_id_type> remove_queue{id};
-      const auto& previdx = my->index.get<by_prev>();
-      const auto head_id = my->head->id;
+      const auto& previdx = index.get<by_prev>();
+      const auto head_id = head->id;
 
       for( uint32_t i = 0; i < remove_queue.size(); ++i ) {
          EOS_ASSERT( remove_queue[i] != head_id, fork_database_exception,
                      "removing the block and its descendants would remove the current head block" );
 
-         auto previtr = previdx.lower_bound( remove_queue[i] );
-         while( previtr != previdx.end() && (*previtr)->header.previous == remove_queue[i] ) {
+         auto children = previdx.equal_range( remove_queue[i] );
+         for( auto previtr = children.first; previtr != children.second; ++previtr ) {
             remove_queue.push_back( (*previtr)->id );
-            ++previtr;
          }
       }
 
       for( const auto& block_id : remove_queue ) {
-         auto itr = my->index.find( block_id );
-         if( itr != my->index.end() )
-            my->index.erase(itr);
+         auto itr = index.find( block_id );
+         if( itr != index.end() ) {
+            erase_block_num( *itr );
+            index.erase(itr);
+         }
+      }
+   }
+
+   void fork_database_impl::insert_block_num( const block_state_ptr& n ) {
+      if( blocks_by_num.empty() ) {
+         first_block_num = n->block_num;
+      }
+      while( n->block_num < first_block_num ) {
+         blocks_by_num.emplace_front();
+         --first_block_num;
+      }
+      while( n->block_num - first_block_num >= blocks_by_num.size() ) {
+         blocks_by_num.emplace_back();
+      }
+
+      auto& slot = blocks_by_num[n->block_num - first_block_num];
+      slot.push_back( n );
+      if( slot.size() == 2 ) {
+         forked_block_nums.insert( n->block_num );
+      }
+   }
+
+   void fork_database_impl::erase_block_num( const block_state_ptr& n ) {
+      if( n->block_num < first_block_num || n->block_num - first_block_num >= blocks_by_num.size() ) return;
+
+      auto& slot = blocks_by_num[n->block_num - first_block_num];
+      auto itr = std::find( slot.begin(), slot.end(), n );
+      if( itr == slot.end() ) return;
+      slot.erase( itr );
+      if( slot.size() == 1 ) {
+         forked_block_nums.erase( n->block_num );
+      }
+
+      while( !blocks_by_num.empty() && blocks_by_num.front().empty() ) {
+         blocks_by_num.pop_front();
+         ++first_block_num;
+      }
+      while( !blocks_by_num.empty() && blocks_by_num.back().empty() ) {
+         blocks_by_num.pop_back();
       }
    }
 
@@ -478,6 +792,8 @@ namespace eosio { namespace chain {
          bsp->validated = true;
       } );
 
+      my->append( journal_op::mark_valid, fc::raw::pack( h->id ) );
+
       auto candidate = my->index.get<by_lib_block_num>().begin();
       if( first_preferred( **candidate, *my->head ) ) {
          my->head = *candidate;
@@ -2,6 +2,8 @@
 #include <eosio/chain/abi_def.hpp>
 #include <eosio/chain/trace.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/decoded_action_cache.hpp>
+#include <type_traits>
 #include <utility>
 #include <fc/variant_object.hpp>
 #include <fc/scoped_exit.hpp>
@@ -35,6 +37,10 @@ struct abi_serializer {
 
    abi_serializer(){ configure_built_in_types(); }
    abi_serializer( const abi_def& abi, const yield_function_t& yield );
+   abi_serializer( const abi_serializer& other );
+   abi_serializer( abi_serializer&& other );
+   abi_serializer& operator=( const abi_serializer& other );
+   abi_serializer& operator=( abi_serializer&& other );
    [[deprecated("use the overload with yield_function_t[=create_yield_function(max_serialization_time)]")]]
    abi_serializer( const abi_def& abi, const fc::microseconds& max_serialization_time );
    void set_abi( const abi_def& abi, const yield_function_t& yield );
@@ -70,6 +76,13 @@ struct abi_serializer {
    [[deprecated("use the overload with yield_function_t[=create_yield_function(max_serialization_time)]")]]
    fc::variant binary_to_variant( const std::string_view& type, fc::datastream<const char*>& binary, const fc::microseconds& max_serialization_time, bool short_path = false )const;
 
+   /**
+    * Same as fc::json::to_string( binary_to_variant(type, binary, ...) ), written directly from the binary.
+    * Only the values of built-in types are converted to a variant, no variant tree of the whole value is built.
+    */
+   std::string binary_to_json( const std::string_view& type, const bytes& binary, const yield_function_t& yield, bool short_path = false )const;
+   std::string binary_to_json( const std::string_view& type, fc::datastream<const char*>& binary, const yield_function_t& yield, bool short_path = false )const;
+
    [[deprecated("use the overload with yield_function_t[=create_yield_function(max_serialization_time)]")]]
    bytes       variant_to_binary( const std::string_view& type, const fc::variant& var, const fc::microseconds& max_serialization_time, bool short_path = false )const;
    bytes       variant_to_binary( const std::string_view& type, const fc::variant& var, const yield_function_t& yield, bool short_path = false )const;
@@ -143,11 +156,38 @@ private:
    map<type_name, pair<unpack_function, pack_function>, std::less<>> built_in_types;
    void configure_built_in_types();
 
+   /**
+    * How to (de)serialize a type, resolved once instead of on every value. Refers into the maps above,
+    * so it is recompiled whenever they change, including on copy and move.
+    */
+   struct type_plan {
+      std::string_view rtype;       // typedefs resolved
+      std::string_view ftype;       // rtype without the array or optional suffix
+      bool             array    = false;
+      bool             optional = false;
+      decltype(built_in_types)::const_iterator built_in_itr; // of ftype
+      decltype(variants)::const_iterator       variant_itr;  // of rtype
+      decltype(structs)::const_iterator        struct_itr;   // of rtype
+   };
+   // plans of the types named in the abi, other types are planned on every use
+   map<type_name, type_plan, std::less<>> type_plans;
+
+   type_plan make_type_plan( const std::string_view& type )const;
+   type_plan get_type_plan( const std::string_view& type )const;
+   void      compile_type_plans();
+
    fc::variant _binary_to_variant( const std::string_view& type, const bytes& binary, impl::binary_to_variant_context& ctx )const;
    fc::variant _binary_to_variant( const std::string_view& type, fc::datastream<const char*>& binary, impl::binary_to_variant_context& ctx )const;
    void        _binary_to_variant( const std::string_view& type, fc::datastream<const char*>& stream,
                                    fc::mutable_variant_object& obj, impl::binary_to_variant_context& ctx )const;
 
+   // return false if null was written
+   bool        _binary_to_json( const std::string_view& type, fc::datastream<const char*>& stream, std::string& out,
+                                impl::binary_to_variant_context& ctx )const;
+   // writes the fields of struct type, returns the number of fields written
+   uint32_t    _binary_to_json_fields( const std::string_view& type, fc::datastream<const char*>& stream, std::string& out,
+                                       impl::binary_to_variant_context& ctx )const;
+
    bytes       _variant_to_binary( const std::string_view& type, const fc::variant& var, impl::variant_to_binary_context& ctx )const;
    void        _variant_to_binary( const std::string_view& type, const fc::variant& var,
                                    fc::datastream<char*>& ds, impl::variant_to_binary_context& ctx )const;
@@ -162,6 +202,27 @@ private:
    friend struct impl::abi_traverse_context_with_path;
 };
 
+/**
+ * Resolver result of an abi_serializer along with the version of the ABI it was built from. The data of actions
+ * resolved through it is decoded through decoded_action_cache, see decoded_action_key().
+ */
+class versioned_abi_serializer {
+public:
+   versioned_abi_serializer() = default;
+   versioned_abi_serializer( abi_serializer serializer, const abi_version& version )
+   : _serializer( std::move(serializer) ), _version( version ) {}
+
+   bool valid() const { return _serializer.valid(); }
+   const abi_serializer* operator->() const { return &*_serializer; }
+   const abi_serializer& operator*() const { return *_serializer; }
+
+   const abi_version& decoded_action_key() const { return _version; }
+
+private:
+   fc::optional<abi_serializer> _serializer;
+   abi_version                  _version;
+};
+
 namespace impl {
 
    struct abi_traverse_context {
@@ -398,6 +459,25 @@ namespace impl {
          mvo(name, std::move(obj_mvo["_"]));
       }
 
+      // resolver results providing decoded_action_key() share the decoded data of actions through decoded_action_cache
+      template<typename Abi, typename = void>
+      struct has_decoded_action_key : std::false_type {};
+      template<typename Abi>
+      struct has_decoded_action_key<Abi, std::void_t<decltype( std::declval<const Abi&>().decoded_action_key() )>> : std::true_type {};
+
+      template<typename Abi, typename Decode>
+      static fc::variant decode_action_data( const Abi& abi, const action& act, Decode&& decode )
+      {
+         if constexpr( has_decoded_action_key<Abi>::value ) {
+            auto& cache = decoded_action_cache::instance();
+            if( cache.enabled() ) {
+               return cache.get_or_decode( decoded_action_cache::make_key( act.account, abi.decoded_action_key(), act.name, act.data ),
+                                           std::forward<Decode>( decode ) );
+            }
+         }
+         return decode();
+      }
+
       /**
        * overload of to_variant_object for actions
        *
@@ -423,9 +503,11 @@ namespace impl {
                auto type = abi->get_action_type(act.name);
                if (!type.empty()) {
                   try {
-                     binary_to_variant_context _ctx(*abi, ctx, type);
-                     _ctx.short_path = true; // Just to be safe while avoiding the complexity of threading an override boolean all over the place
-                     mvo( "data", abi->_binary_to_variant( type, act.data, _ctx ));
+                     mvo( "data", decode_action_data( abi, act, [&]() {
+                        binary_to_variant_context _ctx(*abi, ctx, type);
+                        _ctx.short_path = true; // Just to be safe while avoiding the complexity of threading an override boolean all over the place
+                        return abi->_binary_to_variant( type, act.data, _ctx );
+                     } ));
                      mvo("hex_data", act.data);
                   } catch(...) {
                      // any failure to serialize data, then leave as not serailzed
@@ -22,6 +22,7 @@ class apply_context {
             iterator_cache(){
                _end_iterator_to_table.reserve(8);
                _iterator_to_object.reserve(32);
+               _object_to_iterator.reserve(32);
             }
 
             /// Returns end iterator of the table.
@@ -90,7 +91,7 @@ class apply_context {
             map<table_id_object::id_type, pair<const table_id_object*, int>> _table_cache;
             vector<const table_id_object*>                  _end_iterator_to_table;
             vector<const T*>                                _iterator_to_object;
-            map<const T*,int>                               _object_to_iterator;
+            std::unordered_map<const T*,int>                _object_to_iterator;
 
             /// Precondition: std::numeric_limits<int>::min() < ei < -1
             /// Iterator of -1 is reserved for invalid iterators (i.e. when the appropriate table has not yet been created).
@@ -189,6 +190,7 @@ class apply_context {
                   o.payer         = payer;
                });
 
+               context.control.table_touched( tab );
                context.db.modify( tab, [&]( auto& t ) {
                  ++t.count;
                });
@@ -208,6 +210,7 @@ class apply_context {
 
 //               context.require_write_lock( table_obj.scope );
 
+               context.control.table_touched( table_obj );
                context.db.modify( table_obj, [&]( auto& t ) {
                   --t.count;
                });
@@ -580,6 +583,20 @@ class apply_context {
    private:
 
       iterator_cache<key_value_object>    keyval_cache;
+
+      /// tables of this action found or created so far, most actions touch a few tables many times
+      struct table_lookup {
+         name                   code;
+         name                   scope;
+         name                   table;
+         const table_id_object* tab;
+      };
+      static constexpr size_t             max_table_lookups = 16;
+      vector<table_lookup>                _table_lookups;
+      size_t                              _next_table_lookup = 0; ///< slot replaced once _table_lookups is full
+      const table_id_object* find_table_lookup( name code, name scope, name table )const;
+      void                   add_table_lookup( name code, name scope, name table, const table_id_object* tab );
+
       vector< std::pair<account_name, uint32_t> > _notified; ///< keeps track of new accounts to be notifed of current message
       vector<uint32_t>                    _inline_actions; ///< action_ordinals of queued inline actions
       vector<uint32_t>                    _cfa_inline_actions; ///< action_ordinals of queued inline context-free actions
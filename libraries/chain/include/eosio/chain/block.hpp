@@ -88,7 +88,9 @@ namespace eosio { namespace chain {
     */
    struct signed_block : public signed_block_header{
    private:
-      signed_block( const signed_block& ) = default;
+      // a clone is changed afterwards, it packs itself again
+      signed_block( const signed_block& b )
+      :signed_block_header(b), transactions(b.transactions), block_extensions(b.block_extensions) {}
    public:
       signed_block() = default;
       explicit signed_block( const signed_block_header& h ):signed_block_header(h){}
@@ -100,6 +102,15 @@ namespace eosio { namespace chain {
       extensions_type               block_extensions;
 
       flat_multimap<uint16_t, block_extension> validate_and_extract_extensions()const;
+
+      /**
+       * The block packed with fc::raw, packed on the first call only so that the net, the block log and state
+       * history share the bytes. For complete blocks only, changes made after the first call are not packed.
+       */
+      std::shared_ptr<const vector<char>> packed()const;
+
+   private:
+      mutable std::shared_ptr<const vector<char>> _packed; ///< accessed with std::atomic_load and std::atomic_store
    };
    using signed_block_ptr = std::shared_ptr<signed_block>;
 
@@ -7,6 +7,12 @@ namespace eosio { namespace chain {
 
    namespace detail { class block_log_impl; }
 
+   struct block_log_write_options {
+      uint32_t max_queued_blocks = 0;     ///< appended blocks wait for a writer thread while there are fewer, 0 writes them in append
+      uint32_t flush_interval    = 1;     ///< blocks the writer thread writes between flushes, it also flushes whenever it runs out of blocks
+      bool     fsync             = false; ///< fsync the files with every flush instead of leaving it to the OS when they get to disk
+   };
+
    /* The block log is an external append only log of the blocks with a header. Blocks should only
     * be written to the log after they irreverisble as the log is append only. The log is a doubly
     * linked list of blocks. There is a secondary index file of only block positions that enables
@@ -30,15 +36,25 @@ namespace eosio { namespace chain {
     *
     * The main file is the only file that needs to persist. The index file can be reconstructed during a
     * linear scan of the main file.
+    *
+    * With a stride, the blocks of every completed range of stride blocks are moved to their own pair of files
+    * blocks-<first>-<last>.log and blocks-<first>-<last>.index, each a complete block log of its range. Only the
+    * newest max_retained_files of them are kept, older ones are deleted.
+    *
+    * With max_queued_blocks of the write options, append only queues the block and a writer thread packs and writes it.
+    * The queued blocks are read from the queue until they are flushed, reads are consistent with the returned appends.
+    * The position of a queued block is not known yet, append returns npos for it then.
     */
 
    class block_log {
       public:
-         block_log(const fc::path& data_dir);
+         block_log(const fc::path& data_dir, uint32_t stride = 0, uint32_t max_retained_files = std::numeric_limits<uint32_t>::max(),
+                   const block_log_write_options& write_options = block_log_write_options());
          block_log(block_log&& other);
          ~block_log();
 
          uint64_t append(const signed_block_ptr& b);
+         /// waits for the queued blocks to be written
          void flush();
          void reset( const genesis_state& gs, const signed_block_ptr& genesis_block );
          void reset( const chain_id_type& chain_id, uint32_t first_block_num );
@@ -46,19 +62,23 @@ namespace eosio { namespace chain {
          signed_block_ptr read_block(uint64_t file_pos)const;
          void             read_block_header(block_header& bh, uint64_t file_pos)const;
          signed_block_ptr read_block_by_num(uint32_t block_num)const;
+         /**
+          * Return the packed signed_block as stored in the log, empty if it does not exist.
+          */
+         std::vector<char> read_serialized_block(uint32_t block_num)const;
          block_id_type    read_block_id_by_num(uint32_t block_num)const;
          signed_block_ptr read_block_by_id(const block_id_type& id)const {
             return read_block_by_num(block_header::num_from_id(id));
          }
 
          /**
-          * Return offset of block in file, or block_log::npos if it does not exist.
+          * Return offset of block in blocks.log, or block_log::npos if it is not in that file (yet).
           */
          uint64_t get_block_pos(uint32_t block_num) const;
          signed_block_ptr        read_head()const;
          const signed_block_ptr& head()const;
          const block_id_type&    head_id()const;
-         uint32_t                first_block_num() const;
+         uint32_t                first_block_num() const; ///< including the retained block files
 
          static const uint64_t npos = std::numeric_limits<uint64_t>::max();
 
@@ -71,7 +91,12 @@ namespace eosio { namespace chain {
 
          static chain_id_type extract_chain_id( const fc::path& data_dir );
 
-         static void construct_index(const fc::path& block_file_name, const fc::path& index_file_name);
+         /**
+          * Writes the index of block_file_name to index_file_name. With more than one thread the file is split into
+          * regions whose blocks are found concurrently, falls back to the sequential backwards scan if the log is
+          * not laid out as expected. threads == 0 uses one thread per core.
+          */
+         static void construct_index(const fc::path& block_file_name, const fc::path& index_file_name, uint32_t threads = 0);
 
          static bool contains_genesis_state(uint32_t version, uint32_t first_block_num);
 
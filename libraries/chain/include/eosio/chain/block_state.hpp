@@ -4,6 +4,7 @@
 #include <eosio/chain/block.hpp>
 #include <eosio/chain/transaction_metadata.hpp>
 #include <eosio/chain/action_receipt.hpp>
+#include <eosio/chain/merkle.hpp>
 
 namespace eosio { namespace chain {
 
@@ -32,6 +33,9 @@ namespace eosio { namespace chain {
 
       signed_block_ptr                                    block;
 
+      /// merkle tree of the transaction receipts of block, built on the first call and shared by later ones
+      std::shared_ptr<const merkle_tree> transaction_merkle_tree()const;
+
    private: // internal use only, not thread safe
       friend struct fc::reflector<block_state>;
       friend bool block_state_is_valid( const block_state& ); // work-around for multi-index access
@@ -62,6 +66,9 @@ namespace eosio { namespace chain {
       /// this data is redundant with the data stored in block, but facilitates
       /// recapturing transactions when we pop a block
       vector<transaction_metadata_ptr>                    _cached_trxs;
+
+      /// only accessed through std::atomic_load/std::atomic_store, proofs may be requested from any thread
+      mutable std::shared_ptr<const merkle_tree>          _transaction_merkle_tree;
    };
 
    using block_state_ptr = std::shared_ptr<block_state>;
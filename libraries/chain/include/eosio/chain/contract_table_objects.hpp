@@ -6,6 +6,7 @@
 
 #include <array>
 #include <type_traits>
+#include <utility>
 
 namespace eosio { namespace chain {
 
@@ -58,7 +59,7 @@ namespace eosio { namespace chain {
       table_id              t_id; //< t_id should not be changed within a chainbase modifier lambda
       uint64_t              primary_key; //< primary_key should not be changed within a chainbase modifier lambda
       account_name          payer;
-      shared_blob           value;
+      shared_blob           value; //< values up to the short string capacity of shared_string are stored inside the row, larger ones in a separate allocation
    };
 
    using key_value_index = chainbase::shared_multi_index_container<
@@ -126,15 +127,38 @@ namespace eosio { namespace chain {
    typedef secondary_index<key256_t,index256_object_type>::index_object index256_object;
    typedef secondary_index<key256_t,index256_object_type>::index_index  index256_index;
 
+   /**
+    *  Orders float64_t as f64_lt does, with integer compares only: the bits of a negative value are inverted, the sign
+    *  bit of any other value is set, and -0 is taken as +0. NaN, on which f64_lt is not an order, is never a key.
+    */
    struct soft_double_less {
+      static uint64_t ordered_bits( const float64_t& f ) {
+         constexpr uint64_t sign = uint64_t(1) << 63;
+         const uint64_t v = ( f.v << 1 ) == 0 ? 0 : f.v;
+         return ( v & sign ) ? ~v : ( v | sign );
+      }
+
       bool operator()( const float64_t& lhs, const float64_t& rhs ) const {
-         return f64_lt( lhs, rhs );
+         return ordered_bits( lhs ) < ordered_bits( rhs );
       }
    };
 
+   /**
+    *  Orders float128_t as f128_lt does, see soft_double_less. v[1] holds the sign and exponent, softfloat is built
+    *  little endian.
+    */
    struct soft_long_double_less {
+      static std::pair<uint64_t, uint64_t> ordered_bits( const float128_t& f ) {
+         constexpr uint64_t sign = uint64_t(1) << 63;
+         uint64_t hi = f.v[1];
+         const uint64_t lo = f.v[0];
+         if( ( hi << 1 ) == 0 && lo == 0 ) hi = 0;
+         if( hi & sign ) return { ~hi, ~lo };
+         return { hi | sign, lo };
+      }
+
       bool operator()( const float128_t& lhs, const float128_t& rhs ) const {
-         return f128_lt( lhs, rhs );
+         return ordered_bits( lhs ) < ordered_bits( rhs );
       }
    };
 
@@ -35,13 +35,21 @@ namespace eosio { namespace chain {
    class global_property_object;
    class permission_object;
    class account_object;
+   class table_id_object;
    using resource_limits::resource_limits_manager;
    using apply_handler = std::function<void(apply_context&)>;
    using forked_branch_callback = std::function<void(const branch_type&)>;
    // lookup transaction_metadata via supplied function to avoid re-creation
    using trx_meta_cache_lookup = std::function<transaction_metadata_ptr( const transaction_id_type&)>;
+   // contract table whose row count or payload size changes, see controller::set_table_touched_callback
+   using table_touched_callback = std::function<void(const table_id_object&)>;
+   // contract table created (true) or removed (false), see controller::set_table_lifecycle_callback
+   using table_lifecycle_callback = std::function<void(const table_id_object&, bool)>;
+   // writes the state changes of a block instead of executing it, see controller::set_block_deltas_applier
+   using block_deltas_applier = std::function<bool(const block_state_ptr&)>;
 
    class fork_database;
+   class shared_state_lock;
 
    enum class db_read_mode {
       SPECULATIVE,
@@ -66,6 +74,11 @@ namespace eosio { namespace chain {
             flat_set< pair<account_name, action_name> > action_blacklist;
             flat_set<public_key_type> key_blacklist;
             path                     blocks_dir             =  chain::config::default_blocks_dir_name;
+            uint32_t                 blocks_log_stride      =  0; ///< blocks per block log file, 0 for a single file
+            uint32_t                 max_retained_block_files = std::numeric_limits<uint32_t>::max();
+            uint32_t                 blocks_log_queue_size  =  0; ///< irreversible blocks waiting for the block log writer thread, 0 writes them on the main thread
+            uint32_t                 blocks_log_flush_interval = 1;
+            bool                     blocks_log_fsync       =  false;
             path                     state_dir              =  chain::config::default_state_dir_name;
             uint64_t                 state_size             =  chain::config::default_state_size;
             uint64_t                 state_guard_size       =  chain::config::default_state_guard_size;
@@ -77,7 +90,10 @@ namespace eosio { namespace chain {
             bool                     read_only              =  false;
             bool                     force_all_checks       =  false;
             bool                     disable_replay_opts    =  false;
+            uint32_t                 replay_checkpoint_interval = 0; ///< irreversible replay writes a snapshot every this many blocks, 0 for none
+            path                     replay_checkpoint_dir;          ///< of the replay checkpoints, the two latest are kept
             bool                     contracts_console      =  false;
+            bool                     trace_spans            =  false; ///< record block life cycle spans, see span_tracer
             bool                     allow_ram_billing_in_notify = false;
             uint32_t                 maximum_variable_signature_length = chain::config::default_max_variable_signature_length;
             bool                     disable_all_subjective_mitigations = false; //< for testing purposes only
@@ -168,8 +184,22 @@ namespace eosio { namespace chain {
                           const forked_branch_callback& cb,
                           const trx_meta_cache_lookup& trx_lookup );
 
+         /**
+          * Starts recovering the signing keys of the transactions of a block that is about to be applied,
+          * e.g. a block queued during sync, so recovery overlaps the execution of the blocks before it.
+          * apply_block of that block then takes the results instead of starting the recovery itself.
+          * Thread safe.
+          */
+         void start_recover_block_keys( const signed_block_ptr& b );
+
          boost::asio::io_context& get_thread_pool();
 
+         /**
+          * Held exclusively by the block and transaction entry points while they change the state.
+          * Threads other than the main thread must hold it shared for as long as they read db() or fork_db().
+          */
+         shared_state_lock& get_state_lock()const;
+
          const chainbase::database& db()const;
 
          const fork_database& fork_db()const;
@@ -232,6 +262,8 @@ namespace eosio { namespace chain {
 
          signed_block_ptr fetch_block_by_number( uint32_t block_num )const;
          signed_block_ptr fetch_block_by_id( block_id_type id )const;
+         /// packed irreversible block as stored in the block log, empty if it is not in the block log
+         std::vector<char> fetch_serialized_block_by_number( uint32_t block_num )const;
 
          block_state_ptr fetch_block_state_by_number( uint32_t block_num )const;
          block_state_ptr fetch_block_state_by_id( block_id_type id )const;
@@ -239,6 +271,8 @@ namespace eosio { namespace chain {
          block_id_type get_block_id_for_num( uint32_t block_num )const;
 
          sha256 calculate_integrity_hash()const;
+         /// version 2 integrity hash, see tree_integrity_hash_snapshot_writer
+         sha256 calculate_tree_integrity_hash( size_t num_threads )const;
          void write_snapshot( const snapshot_writer_ptr& snapshot )const;
 
          bool sender_avoids_whitelist_blacklist_enforcement( account_name sender )const;
@@ -292,6 +326,22 @@ namespace eosio { namespace chain {
          void set_greylist_limit( uint32_t limit );
          uint32_t get_greylist_limit()const;
 
+         /// for accounting outside of the chain state: cb is called on the main thread before a contract row is stored,
+         /// removed or changes its payload size. Undoing these changes does not call it again.
+         void set_table_touched_callback( table_touched_callback cb );
+         void table_touched( const table_id_object& tid )const;
+
+         /// for indices outside of the chain state: cb is called on the main thread after a contract table is created
+         /// and before it is removed. Undoing these changes does not call it again.
+         void set_table_lifecycle_callback( table_lifecycle_callback cb );
+         void table_created( const table_id_object& tid )const;
+         void table_removed( const table_id_object& tid )const;
+
+         /// for a node following a trusted one: blocks are applied by having applier write their state changes,
+         /// taken from the trusted node, instead of executing their transactions. The headers and producer signatures
+         /// are still validated. applier returns false if it has no state changes for the block, which is rejected.
+         void set_block_deltas_applier( block_deltas_applier applier );
+
          void add_to_ram_correction( account_name account, uint64_t ram_bytes );
          bool all_subjective_mitigations_disabled()const;
 
@@ -310,8 +360,10 @@ namespace eosio { namespace chain {
          signal<void(std::tuple<const transaction_trace_ptr&, const signed_transaction&>)> applied_transaction;
          signal<void(const int&)>                      bad_alloc;
 
-         // a signal for collecting action receipts
-         signal<void(std::tuple<const transaction_trace_ptr&, const std::vector<action_receipt>&>)>    apply_action_receipt;
+         // a signal for collecting action receipts, emitted once per block from finalize_block, for validated as well
+         // as locally produced blocks, with the traces of its transactions that contain a token transfer
+         // and all action receipts of the block
+         signal<void(std::tuple<uint32_t, const std::vector<transaction_trace_ptr>&, const std::vector<action_receipt>&>)> applied_block_action_receipts;
 
          /*
          signal<void()>                                  pre_apply_block;
@@ -325,6 +377,7 @@ namespace eosio { namespace chain {
 
          const apply_handler* find_apply_handler( account_name contract, scope_name scope, action_name act )const;
          wasm_interface& get_wasm_interface();
+         const wasm_interface& get_wasm_interface()const;
 
 
          optional<abi_serializer> get_abi_serializer( account_name n, const abi_serializer::yield_function_t& yield )const {
@@ -339,11 +392,14 @@ namespace eosio { namespace chain {
             return optional<abi_serializer>();
          }
 
+         /// as get_abi_serializer, the data of actions resolved through the result is shared by decoded_action_cache
+         versioned_abi_serializer get_versioned_abi_serializer( account_name n, const abi_serializer::yield_function_t& yield )const;
+
          template<typename T>
          fc::variant to_variant_with_abi( const T& obj, const abi_serializer::yield_function_t& yield ) {
             fc::variant pretty_output;
             abi_serializer::to_variant( obj, pretty_output,
-                                        [&]( account_name n ){ return get_abi_serializer( n, yield ); }, yield );
+                                        [&]( account_name n ){ return get_versioned_abi_serializer( n, yield ); }, yield );
             return pretty_output;
          }
 
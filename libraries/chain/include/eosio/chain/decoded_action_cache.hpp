@@ -0,0 +1,75 @@
+#pragma once
+
+#include <eosio/chain/types.hpp>
+#include <fc/variant.hpp>
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <tuple>
+
+namespace eosio { namespace chain {
+
+   /**
+    * The ABI an action is decoded with: abi_sequence of the account and hash of the ABI. The hash tells apart a
+    * setabi rolled back with a fork and redone differently under the same sequence. Operator provided ABIs use
+    * abi_sequence 0, which no on-chain ABI has.
+    */
+   struct abi_version {
+      uint64_t   abi_sequence = 0;
+      fc::sha256 abi_hash;
+   };
+
+   /**
+    * Process wide cache of ABI decoded action data, shared by every consumer decoding actions with the same ABI,
+    * e.g. the chain API, history and trace exporters, so an action is decoded once however many of them are enabled.
+    * Bounded by a number of entries, the oldest entries are evicted first. Lookups only take a shared lock.
+    */
+   class decoded_action_cache {
+   public:
+      struct key {
+         account_name account;
+         uint64_t     abi_sequence = 0;
+         fc::sha256   act_digest;   ///< of the ABI hash, the action name and the action data
+
+         friend bool operator<( const key& a, const key& b ) {
+            return std::tie( a.account, a.abi_sequence, a.act_digest ) < std::tie( b.account, b.abi_sequence, b.act_digest );
+         }
+      };
+
+      static constexpr size_t default_max_size = 10000;
+
+      static decoded_action_cache& instance();
+
+      static key make_key( account_name account, const abi_version& abi, action_name act, const bytes& data );
+
+      /// 0 disables the cache and drops its entries
+      void set_max_size( size_t max_size );
+      bool enabled() const { return _max_size != 0; }
+
+      /// nullptr if the action was not decoded yet
+      std::shared_ptr<const fc::variant> find( const key& k ) const;
+
+      /// the decoded data already stored under k if another thread was first, decoded otherwise
+      std::shared_ptr<const fc::variant> insert( const key& k, fc::variant decoded );
+
+      /// the decoded data of k, decode is called only if k is not cached
+      template<typename Decode>
+      fc::variant get_or_decode( const key& k, Decode&& decode ) {
+         if( auto d = find( k ) )
+            return *d;
+         return *insert( k, decode() );
+      }
+
+      size_t size() const;
+
+   private:
+      mutable std::shared_mutex                                 _mtx;
+      std::atomic<size_t>                                       _max_size{default_max_size};
+      std::map<key, std::shared_ptr<const fc::variant>>        _entries;
+      std::deque<key>                                           _insertion_order; // oldest first
+   };
+
+} } // eosio::chain
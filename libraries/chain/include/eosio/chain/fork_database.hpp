@@ -16,6 +16,9 @@ namespace eosio { namespace chain {
     * database tracks the longest chain and the last irreversible block number. All
     * blocks older than the last irreversible block are freed after emitting the
     * irreversible signal.
+    *
+    * Every change is appended to a journal in the data directory as it happens, so
+    * closing writes nothing and a crash does not lose the reversible blocks.
     */
    class fork_database {
       public:
@@ -3,6 +3,43 @@
 #include <eosio/chain/merkle.hpp>
 #include <fc/io/raw.hpp>
 
+#include <boost/container/small_vector.hpp>
+
+namespace fc {
+   // packed and converted like a vector
+
+   template<typename DataStream, typename T, std::size_t N>
+   DataStream& operator << ( DataStream& ds, const boost::container::small_vector<T, N>& v ) {
+      fc::raw::pack( ds, unsigned_int((uint32_t)v.size()) );
+      for( const auto& i : v )
+         fc::raw::pack( ds, i );
+      return ds;
+   }
+
+   template<typename DataStream, typename T, std::size_t N>
+   DataStream& operator >> ( DataStream& ds, boost::container::small_vector<T, N>& v ) {
+      unsigned_int size;
+      fc::raw::unpack( ds, size );
+      FC_ASSERT( size.value <= MAX_NUM_ARRAY_ELEMENTS );
+      v.resize( size.value );
+      for( auto& i : v )
+         fc::raw::unpack( ds, i );
+      return ds;
+   }
+
+   template<typename T, std::size_t N>
+   void to_variant( const boost::container::small_vector<T, N>& sv, variant& v ) {
+      to_variant( std::vector<T>( sv.begin(), sv.end() ), v );
+   }
+
+   template<typename T, std::size_t N>
+   void from_variant( const variant& v, boost::container::small_vector<T, N>& sv ) {
+      std::vector<T> _v;
+      from_variant( v, _v );
+      sv.assign( _v.begin(), _v.end() );
+   }
+}
+
 namespace eosio { namespace chain {
 
 namespace detail {
@@ -64,6 +101,15 @@ constexpr int calcluate_max_depth(uint64_t node_count) {
    return clz_power_2(implied_count) + 1;
 }
 
+/**
+ * The active nodes of a tree are at most its depth, the depth of a tree of 2^32 nodes (one per block number) fits
+ * in place so appending to and copying a block header state's merkle does not allocate
+ */
+constexpr size_t max_inline_active_nodes = calcluate_max_depth(uint64_t(1) << 32);
+
+template<typename T>
+using active_nodes_vector = boost::container::small_vector<T, max_inline_active_nodes>;
+
 template<typename ContainerA, typename ContainerB>
 inline void move_nodes(ContainerA& to, const ContainerB& from) {
    to.clear();
@@ -172,8 +218,7 @@ class incremental_merkle_impl {
          auto index = _node_count;
          auto top = digest;
          auto active_iter = _active_nodes.begin();
-         auto updated_active_nodes = vector<DigestType>();
-         updated_active_nodes.reserve(max_depth);
+         auto updated_active_nodes = detail::active_nodes_vector<DigestType>();
 
          while (current_depth > 0) {
             if (!(index & 0x1)) {
@@ -243,8 +288,8 @@ class incremental_merkle_impl {
       Container<DigestType, Args...>   _active_nodes;
 };
 
-typedef incremental_merkle_impl<digest_type>               incremental_merkle;
-typedef incremental_merkle_impl<digest_type,shared_vector> shared_incremental_merkle;
+typedef incremental_merkle_impl<digest_type,detail::active_nodes_vector> incremental_merkle;
+typedef incremental_merkle_impl<digest_type,shared_vector>               shared_incremental_merkle;
 
 } } /// eosio::chain
 
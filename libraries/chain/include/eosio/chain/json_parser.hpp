@@ -0,0 +1,30 @@
+#pragma once
+
+#include <fc/optional.hpp>
+#include <fc/variant.hpp>
+#include <string>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Parses JSON request bodies to the same fc::variant as fc::json::from_string with its default parser.
+    *
+    * Built with EOSIO_SIMD_JSON_ENABLED, strict JSON is parsed in two stages like simdjson does: the positions of
+    * the structural characters outside of strings are indexed 16 bytes at a time, with SSE2 where available, and
+    * the variant is then built walking that index, so strings without escapes, e.g. hex action data, are copied
+    * in one go instead of character by character. Input the fast path does not reproduce exactly, e.g. escapes
+    * other than \" \\ \/ \n \r \t, non ASCII or control characters in strings, fractions, exponents, numbers of
+    * more than 18 digits, unquoted strings or nesting deeper than max_fast_depth, is parsed by fc::json::from_string
+    * instead, as is all input when built without EOSIO_SIMD_JSON_ENABLED.
+    */
+   class json_parser {
+   public:
+      static constexpr uint32_t max_fast_depth = 64;
+
+      static fc::variant from_string( const std::string& json );
+
+      /// the fast path alone, nothing if json is outside of what it parses
+      static fc::optional<fc::variant> try_fast_parse( const std::string& json );
+   };
+
+} } // eosio::chain
@@ -1,5 +1,7 @@
 #pragma once
 #include <eosio/chain/types.hpp>
+#include <boost/asio/io_context.hpp>
+#include <functional>
 
 namespace eosio { namespace chain {
 
@@ -14,11 +16,55 @@ namespace eosio { namespace chain {
       return make_pair(make_canonical_left(l), make_canonical_right(r));
    };
 
+   /**
+    *  Same as digest_type::hash( make_canonical_pair( l, r ) ), the 64 bytes are hashed in one call instead of
+    *  being packed through an encoder.
+    */
+   digest_type hash_canonical_pair(const digest_type& l, const digest_type& r);
+
+   /**
+    *  digest_of(i) of every i below count, in order. Large batches are split over thread_pool, the calling
+    *  thread computes the last part. Must not be called from a thread of thread_pool.
+    */
+   vector<digest_type> hash_many( size_t count, const std::function<digest_type(size_t)>& digest_of,
+                                  boost::asio::io_context* thread_pool = nullptr );
+
    /**
     *  Calculates the merkle root of a set of digests, if ids is odd it will duplicate the last id.
     */
    digest_type merkle( vector<digest_type> ids );
 
+   /**
+    *  Same as merkle(), large levels are hashed in parallel on thread_pool. Must not be called from
+    *  a thread of thread_pool, it waits for tasks queued behind the caller.
+    */
+   digest_type merkle( vector<digest_type> ids, boost::asio::io_context& thread_pool );
+
    vector<digest_type> get_proof(int position, vector<digest_type> ids);
 
+   /**
+    *  Every level of the merkle tree of a set of digests, built once so that the proof of any leaf
+    *  is read off the levels without hashing. Levels are stored leaves first in one buffer, each level
+    *  but the root padded to an even size the same way merkle() duplicates the last id.
+    */
+   class merkle_tree {
+      public:
+         merkle_tree() = default;
+         explicit merkle_tree( vector<digest_type> leaves, boost::asio::io_context* thread_pool = nullptr );
+
+         size_t             leaf_count()const { return _leaf_count; }
+         const digest_type& leaf( size_t position )const { return _nodes[position]; }
+
+         /// same as merkle() of the leaves
+         digest_type root()const;
+
+         /// same as get_proof() of the leaves
+         vector<digest_type> proof( size_t position )const;
+
+      private:
+         vector<digest_type> _nodes;
+         vector<size_t>      _level_offsets; ///< index of the first node of every level in _nodes
+         size_t              _leaf_count = 0;
+   };
+
 } } /// eosio::chain
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <fc/io/raw.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Growable stream for fc::raw::pack, packs in a single pass instead of fc::raw::pack_size followed by
+    * fc::raw::pack. Meant to be kept and reused, e.g. thread_local, so that it only grows to the largest object
+    * packed and the bytes are copied once into a buffer of the exact size.
+    */
+   class pack_buffer {
+   public:
+      void clear() { _size = 0; }
+
+      char*       data()       { return _data.data(); }
+      const char* data() const { return _data.data(); }
+      size_t      size() const { return _size; }
+
+      // the part of the fc::datastream interface fc::raw::pack uses
+      bool write( const char* d, size_t s ) {
+         grow( _size + s );
+         memcpy( _data.data() + _size, d, s );
+         _size += s;
+         return true;
+      }
+
+      bool put( char c ) {
+         grow( _size + 1 );
+         _data[_size++] = c;
+         return true;
+      }
+
+      size_t tellp() const { return _size; }
+
+      /// same bytes as fc::raw::pack( v ), packed into the buffer of the calling thread
+      template<typename T>
+      static std::vector<char> pack( const T& v ) {
+         thread_local pack_buffer buffer;
+         buffer.clear();
+         fc::raw::pack( buffer, v );
+         return std::vector<char>( buffer.data(), buffer.data() + buffer.size() );
+      }
+
+   private:
+      void grow( size_t n ) {
+         if( n > _data.size() )
+            _data.resize( std::max( n, _data.size() * 2 ) );
+      }
+
+      std::vector<char> _data;
+      size_t            _size = 0;
+   };
+
+} } // eosio::chain
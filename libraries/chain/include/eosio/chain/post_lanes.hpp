@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Process wide bounded lanes of work in front of the application queue, e.g. transactions from peers and API
+    * requests. A lane keeps its tasks itself and only a window of them sits in the application queue at a time,
+    * handed over lane by lane by weighted round robin. A flood in one lane is bounded by its capacity, doesn't
+    * starve the other lanes and never piles up in the application queue ahead of what is posted to it directly,
+    * like blocks.
+    *
+    * The application queue is reached through the post function set by the plugins using the lanes, so this does
+    * not depend on appbase.
+    */
+   class post_lanes {
+   public:
+      /// move only callable, tasks may own move only state
+      class task {
+      public:
+         template<typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, task>::value>>
+         task( F&& f ) : _impl( std::make_unique<model<std::decay_t<F>>>( std::forward<F>( f ) ) ) {}
+         void operator()() { (*_impl)(); }
+
+      private:
+         struct base {
+            virtual ~base() = default;
+            virtual void operator()() = 0;
+         };
+         template<typename F>
+         struct model : base {
+            template<typename G>
+            explicit model( G&& g ) : f( std::forward<G>( g ) ) {}
+            void operator()() override { f(); }
+            F f;
+         };
+         std::unique_ptr<base> _impl;
+      };
+
+      /// posts to the application queue at the priority
+      using post_function = std::function<void( int priority, std::function<void()> )>;
+
+      struct lane_config {
+         std::string name;
+         int         priority = 0;     ///< of the hand-overs to the application queue
+         uint32_t    weight   = 1;     ///< hand-overs in a row while other lanes wait
+         size_t      capacity = 10000; ///< tasks queued in the lane, more are rejected
+      };
+
+      struct lane_stats {
+         std::string name;
+         uint64_t    depth = 0;      ///< queued now, including the ones handed over
+         uint64_t    max_depth = 0;
+         uint64_t    executed = 0;
+         uint64_t    rejected = 0;
+         int64_t     total_wait_us = 0; ///< from post to execution
+         int64_t     max_wait_us = 0;
+      };
+
+      /// tasks of all lanes in the application queue at a time
+      static constexpr uint32_t default_window = 8;
+
+      static post_lanes& instance();
+
+      void set_post_function( post_function post );
+
+      /// index of the lane, a lane added again under the same name keeps its index and takes the new config
+      size_t add_lane( const lane_config& config );
+
+      /// false if the lane is full, the task is destroyed without running then
+      bool post( size_t lane, task t );
+
+      /// drops the queued tasks of the lane, for a plugin shutting down
+      void clear( size_t lane );
+
+      std::vector<lane_stats> get_stats() const;
+
+   private:
+      struct queued_task {
+         task                                  t;
+         std::chrono::steady_clock::time_point queued;
+      };
+
+      struct lane {
+         lane_config             config;
+         std::deque<queued_task> tasks;
+         uint32_t                handed_over = 0; ///< front tasks the application queue holds a slot for
+         lane_stats              stats;
+      };
+
+      /// picks the lanes the freed window goes to, the slots are posted once the mutex is released
+      std::vector<size_t> hand_over();
+      void post_slots( const std::vector<size_t>& lanes );
+      void run_slot( size_t lane );
+
+      mutable std::mutex  _mtx;
+      post_function       _post;
+      std::vector<lane>   _lanes;
+      uint32_t            _window = default_window;
+      uint32_t            _in_queue = 0;  ///< slots posted and not yet run
+      size_t              _cursor = 0;    ///< lane of the current round robin turn
+      uint32_t            _credit = 0;    ///< hand-overs left in the turn
+   };
+
+} } // eosio::chain
@@ -287,6 +287,46 @@ namespace eosio { namespace chain {
       }
    };
 
+   /**
+    * Immutable producer_authority_schedule shared by the block states that carry it instead of a copy per block
+    * state. Equal schedules are interned to one instance while any block state holds it. Serialized as the
+    * schedule itself.
+    */
+   class producer_authority_schedule_ptr {
+   public:
+      /// the empty schedule
+      producer_authority_schedule_ptr();
+      producer_authority_schedule_ptr( const producer_authority_schedule& s );
+      producer_authority_schedule_ptr( producer_authority_schedule&& s );
+      // no move, a moved from instance would not point to a schedule
+      producer_authority_schedule_ptr( const producer_authority_schedule_ptr& ) = default;
+      producer_authority_schedule_ptr& operator=( const producer_authority_schedule_ptr& ) = default;
+
+      const producer_authority_schedule& operator*()const { return *_schedule; }
+      const producer_authority_schedule* operator->()const { return _schedule.get(); }
+      operator const producer_authority_schedule&()const { return *_schedule; }
+
+      /// schedules interned now, for tests
+      static size_t interned_count();
+
+   private:
+      std::shared_ptr<const producer_authority_schedule> _schedule;
+   };
+
+   template<typename DataStream>
+   DataStream& operator << ( DataStream& ds, const producer_authority_schedule_ptr& s ) {
+      fc::raw::pack( ds, *s );
+      return ds;
+   }
+
+   template<typename DataStream>
+   DataStream& operator >> ( DataStream& ds, producer_authority_schedule_ptr& s ) {
+      producer_authority_schedule tmp;
+      fc::raw::unpack( ds, tmp );
+      s = std::move( tmp );
+      return ds;
+   }
+
    /**
     * Block Header Extension Compatibility
     */
@@ -333,3 +373,14 @@ FC_REFLECT( eosio::chain::shared_block_signing_authority_v0, (threshold)(keys))
 FC_REFLECT( eosio::chain::shared_producer_authority, (producer_name)(authority) )
 FC_REFLECT( eosio::chain::shared_producer_authority_schedule, (version)(producers) )
 
+namespace fc {
+   inline void to_variant( const eosio::chain::producer_authority_schedule_ptr& s, variant& v ) {
+      to_variant( *s, v );
+   }
+
+   inline void from_variant( const variant& v, eosio::chain::producer_authority_schedule_ptr& s ) {
+      eosio::chain::producer_authority_schedule tmp;
+      from_variant( v, tmp );
+      s = std::move( tmp );
+   }
+}
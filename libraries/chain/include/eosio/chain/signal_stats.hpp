@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Process wide elapsed time histograms of controller signal handlers, keyed by signal and slot name.
+    * controller::emit records every signal under the slot name "all", the handlers of the plugins record
+    * themselves through timed_slot.
+    */
+   class signal_stats {
+   public:
+      struct histogram {
+         uint64_t              calls = 0;
+         int64_t               total_us = 0;
+         int64_t               max_us = 0;
+         std::vector<uint64_t> buckets; ///< calls per bucket_upper_bounds_us(), the last bucket is unbounded
+      };
+
+      struct slot_stats {
+         std::string signal;
+         std::string slot;
+         histogram   elapsed;
+      };
+
+      static const std::vector<int64_t>& bucket_upper_bounds_us();
+
+      /// signal and slot must be string literals
+      static void record( const char* signal, const char* slot, int64_t elapsed_us );
+
+      /// ordered by signal, then slot
+      static std::vector<slot_stats> get();
+   };
+
+   /**
+    * Wraps a signal handler so every call is recorded in signal_stats, e.g.
+    * @code{.cpp}
+    * chain.irreversible_block.connect( timed_slot( "irreversible_block", "bridge_plugin", [this]( const block_state_ptr& b ){ ... } ) );
+    * @endcode
+    */
+   template<typename F>
+   auto timed_slot( const char* signal, const char* slot, F&& f ) {
+      return [signal, slot, f = std::forward<F>( f )]( auto&&... args ) {
+         const auto start = std::chrono::steady_clock::now();
+         struct record_on_exit {
+            const char* signal; const char* slot; std::chrono::steady_clock::time_point start;
+            ~record_on_exit() {
+               signal_stats::record( signal, slot,
+                     std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - start ).count() );
+            }
+         } r{ signal, slot, start };
+         f( std::forward<decltype(args)>( args )... );
+      };
+   }
+
+   /**
+    * Wraps a handler of a signal carrying a shared_ptr so that the controller only queues it through post, the
+    * handler runs later on whatever executor post delivers to. The queued call holds a copy of the shared_ptr.
+    * Only for handlers that do not need to observe the chain state as of the signal.
+    */
+   template<typename Post, typename F>
+   auto async_slot( Post&& post, F&& f ) {
+      return [post = std::forward<Post>( post ), f = std::forward<F>( f )]( const auto& ptr ) {
+         post( [f, ptr]() { f( ptr ); } );
+      };
+   }
+
+} } // eosio::chain
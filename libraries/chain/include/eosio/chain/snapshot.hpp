@@ -5,8 +5,16 @@
 #include <fc/variant_object.hpp>
 #include <boost/core/demangle.hpp>
 #include <ostream>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <sstream>
+#include <tuple>
 
 namespace eosio { namespace chain {
+   class named_thread_pool;
+
    /**
     * History:
     * Version 1: initial version with string identified sections and rows
@@ -133,10 +141,7 @@ namespace eosio { namespace chain {
 
          template<typename F>
          void write_section(const std::string section_name, F f) {
-            write_start_section(section_name);
-            auto section = section_writer(*this);
-            f(section);
-            write_end_section();
+            write_section_rows(section_name, [f{std::move(f)}](section_writer& section) mutable { f(section); });
          }
 
          template<typename T, typename F>
@@ -147,6 +152,23 @@ namespace eosio { namespace chain {
       virtual ~snapshot_writer(){};
 
       protected:
+         using section_rows_func = std::function<void(section_writer&)>;
+
+         /**
+          * writes all rows of a section, by default synchronously between write_start_section and
+          * write_end_section; writers may override it to serialize the section elsewhere
+          */
+         virtual void write_section_rows( const std::string& section_name, section_rows_func f ) {
+            write_start_section(section_name);
+            auto section = section_writer(*this);
+            f(section);
+            write_end_section();
+         }
+
+         static section_writer make_section_writer( snapshot_writer& writer ) {
+            return section_writer(writer);
+         }
+
          virtual void write_start_section( const std::string& section_name ) = 0;
          virtual void write_row( const detail::abstract_snapshot_row_writer& row_writer ) = 0;
          virtual void write_end_section() = 0;
@@ -337,6 +359,10 @@ namespace eosio { namespace chain {
 
          static const uint32_t magic_number = 0x30510550;
 
+      protected:
+         /// appends a section whose rows were already serialized in the binary row format
+         void write_serialized_section( const std::string& section_name, const std::string& rows, uint64_t rows_in_section );
+
       private:
          detail::ostream_wrapper snapshot;
          std::streampos          header_pos;
@@ -345,6 +371,41 @@ namespace eosio { namespace chain {
 
    };
 
+   /**
+    * Produces the same binary snapshot as ostream_snapshot_writer, but serializes the sections
+    * concurrently on a thread pool. Sections are appended to the stream in the order write_section
+    * was called. Section functions run after write_section returns, so the state being snapshotted
+    * must not be modified until finalize() returns. At most one section per thread is held in memory.
+    */
+   class threaded_ostream_snapshot_writer : public ostream_snapshot_writer {
+      public:
+         threaded_ostream_snapshot_writer(std::ostream& snapshot, size_t num_threads);
+         ~threaded_ostream_snapshot_writer();
+
+         /// waits for all pending sections, rethrowing the first failure, and writes the end marker
+         void finalize();
+
+      protected:
+         void write_section_rows( const std::string& section_name, section_rows_func f ) override;
+
+      private:
+         struct serialized_section {
+            std::string rows;
+            uint64_t    row_count = 0;
+         };
+
+         struct pending_section {
+            std::string                     name;
+            std::future<serialized_section> result;
+         };
+
+         void write_pending_section();
+
+         std::unique_ptr<named_thread_pool> thread_pool;
+         size_t                             max_pending;
+         std::deque<pending_section>        pending;
+   };
+
    class istream_snapshot_reader : public snapshot_reader {
       public:
          explicit istream_snapshot_reader(std::istream& snapshot);
@@ -380,4 +441,185 @@ namespace eosio { namespace chain {
 
    };
 
+   /**
+    * Version 2 integrity hash, a tree of digests computed concurrently on a thread pool instead of one digest over
+    * all rows. The packed rows of a section are hashed in chunks of about a MiB, a section digest covers the section
+    * name, its row count and its chunk digests, and the integrity hash covers the version and the section digests.
+    * Chunks end where the rows say so, the hash does not depend on the number of threads. It is not comparable to
+    * the version 1 hash of integrity_hash_snapshot_writer. As with threaded_ostream_snapshot_writer, the state must
+    * not be modified until finalize() returns.
+    */
+   class tree_integrity_hash_snapshot_writer : public snapshot_writer {
+      public:
+         static constexpr uint32_t version = 2;
+
+         explicit tree_integrity_hash_snapshot_writer(size_t num_threads);
+         ~tree_integrity_hash_snapshot_writer();
+
+         /// waits for all sections, rethrowing the first failure
+         fc::sha256 finalize();
+
+         /// digest of a chunk of packed rows, hashed by the thread pool unless too many bytes already wait for it
+         std::future<fc::sha256> hash_chunk( std::string rows );
+
+      protected:
+         void write_section_rows( const std::string& section_name, section_rows_func f ) override;
+
+         // rows only reach the writers of the sections
+         void write_start_section( const std::string& ) override {}
+         void write_row( const detail::abstract_snapshot_row_writer& ) override {}
+         void write_end_section() override {}
+
+      private:
+         struct section_hashes {
+            uint64_t                             row_count = 0;
+            std::vector<std::future<fc::sha256>> chunks;
+         };
+
+         struct pending_section {
+            std::string                 name;
+            std::future<section_hashes> result;
+         };
+
+         std::unique_ptr<named_thread_pool> thread_pool;
+         std::atomic<size_t>                queued_bytes{0};
+         std::deque<pending_section>        pending;
+   };
+
+   /**
+    * Writes the row index of a binary snapshot, the packed size of each of its rows by section, which a binary snapshot
+    * needs next to it to be the base of diff snapshots. Rows have no size in the snapshot itself, they are only
+    * delimited by unpacking them as their type. indexed_ostream_snapshot_writer writes it along with the snapshot.
+    */
+   class snapshot_row_index_writer : public snapshot_writer {
+      public:
+         snapshot_row_index_writer(std::ostream& index, const block_id_type& block_id);
+
+         void write_start_section( const std::string& section_name ) override;
+         void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override;
+         void write_end_section( ) override;
+         void finalize();
+
+         /// adds a row of size packed bytes to the current section
+         void write_row_size( uint64_t size );
+
+         /// the head block id the row index was written at, checking its header
+         static block_id_type read_block_id( std::istream& index );
+
+         static const uint32_t magic_number = 0x30510551;
+         static const uint32_t version = 1;
+
+      private:
+         detail::ostream_wrapper index;
+         std::streampos          section_pos;
+         uint64_t                row_count;
+         std::ostringstream      row_buffer;
+   };
+
+   /**
+    * Writes a binary snapshot and its row index in a single pass, the size of each row is taken from the bytes it
+    * added to the snapshot.
+    */
+   class indexed_ostream_snapshot_writer : public ostream_snapshot_writer {
+      public:
+         indexed_ostream_snapshot_writer(std::ostream& snapshot, std::ostream& index, const block_id_type& block_id);
+
+         void write_start_section( const std::string& section_name ) override;
+         void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override;
+         void write_end_section( ) override;
+         void finalize();
+
+      private:
+         std::ostream&             out;
+         snapshot_row_index_writer index;
+   };
+
+   /**
+    * Writes a diff snapshot, the rows of the state which are not already in a base binary snapshot, read along with its
+    * row index. A section of the diff is a sequence of runs, either rows copied from a byte range of the base, or rows
+    * stored in the diff. Rows are matched by their packed bytes whatever their position in the base section, updated
+    * rows are stored whole. The diff references the base by its head block id, checked by diff_istream_snapshot_reader.
+    *
+    * The row index of the largest base section, 24 bytes a row, is held in memory while writing it.
+    */
+   class diff_ostream_snapshot_writer : public snapshot_writer {
+      public:
+         diff_ostream_snapshot_writer(std::ostream& diff, std::istream& base, std::istream& base_row_index, const block_id_type& block_id);
+
+         void write_start_section( const std::string& section_name ) override;
+         void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override;
+         void write_end_section( ) override;
+         void finalize();
+
+         const block_id_type& base_block_id() const { return base_id; }
+
+         static const uint32_t magic_number = 0x30510552;
+         static const uint32_t version = 1;
+
+         enum run_type : uint8_t {
+            copied_rows = 0, ///< base offset, byte size and row count follow
+            stored_rows = 1  ///< row count and the rows follow
+         };
+
+      private:
+         struct base_row {
+            uint64_t hash;
+            uint64_t row;
+            bool operator<( const base_row& other ) const { return std::tie(hash, row) < std::tie(other.hash, other.row); }
+         };
+
+         void load_base_section( const std::string& section_name );
+         bool base_row_equals( uint64_t row, const std::string& packed );
+         void start_copy( uint64_t row );
+         void flush_run();
+
+         detail::ostream_wrapper diff;
+         std::istream&           base;
+         std::istream&           base_row_index;
+         std::streampos          base_header_pos;
+         std::streampos          base_index_pos;
+         block_id_type           base_id;
+         std::streampos          section_pos;
+         uint64_t                row_count;
+
+         std::vector<uint64_t>   base_offsets; ///< of each row of the base section and its end, absolute
+         std::vector<base_row>   base_rows;    ///< sorted by the hash of their packed bytes
+
+         std::ostringstream      row_buffer;
+         std::string             base_buffer;
+         uint64_t                copy_start = 0;
+         uint64_t                copy_rows = 0;
+         std::string             stored;
+         uint64_t                stored_rows_count = 0;
+   };
+
+   /**
+    * Reads the state of a diff snapshot in a single pass, each row coming either from the diff or from the base binary
+    * snapshot it was written against. validate() checks both and that the head block of the base is the one the diff
+    * references.
+    */
+   class diff_istream_snapshot_reader : public snapshot_reader {
+      public:
+         diff_istream_snapshot_reader(std::istream& base, std::istream& diff);
+
+         void validate() const override;
+         bool has_section( const string& section_name ) override;
+         void set_section( const string& section_name ) override;
+         bool read_row( detail::abstract_snapshot_row_reader& row_reader ) override;
+         bool empty ( ) override;
+         void clear_section() override;
+         void return_to_header() override;
+
+      private:
+         std::istream&  base;
+         std::istream&  diff;
+         std::streampos base_header_pos;
+         std::streampos header_pos;
+         uint64_t       num_rows;
+         uint64_t       cur_row;
+         std::istream*  run_stream;
+         uint64_t       run_rows;
+         std::streampos run_end;
+   };
+
 }}
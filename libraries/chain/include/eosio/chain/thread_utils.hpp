@@ -4,8 +4,11 @@
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/thread_pool.hpp>
 #include <boost/asio/post.hpp>
+#include <condition_variable>
 #include <future>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 namespace eosio { namespace chain {
 
@@ -36,6 +39,56 @@ namespace eosio { namespace chain {
    };
 
 
+   /**
+    * Reader/writer lock over the chain state. Writers are preferred: once a writer waits no new reader is admitted,
+    * so readers on other threads can not delay block processing by more than the readers already running.
+    * The exclusive side is reentrant for the owning thread, signal handlers may call back into the controller.
+    * Satisfies Lockable and SharedLockable, use with std::unique_lock / std::shared_lock.
+    */
+   class shared_state_lock {
+   public:
+      void lock() {
+         std::unique_lock<std::mutex> g( _mtx );
+         if( _owner == std::this_thread::get_id() ) {
+            ++_depth;
+            return;
+         }
+         ++_writers_waiting;
+         _cv.wait( g, [this]() { return _depth == 0 && _readers == 0; } );
+         --_writers_waiting;
+         _owner = std::this_thread::get_id();
+         _depth = 1;
+      }
+
+      void unlock() {
+         std::lock_guard<std::mutex> g( _mtx );
+         if( --_depth == 0 ) {
+            _owner = std::thread::id();
+            _cv.notify_all();
+         }
+      }
+
+      void lock_shared() {
+         std::unique_lock<std::mutex> g( _mtx );
+         _cv.wait( g, [this]() { return _depth == 0 && _writers_waiting == 0; } );
+         ++_readers;
+      }
+
+      void unlock_shared() {
+         std::lock_guard<std::mutex> g( _mtx );
+         if( --_readers == 0 )
+            _cv.notify_all();
+      }
+
+   private:
+      std::mutex              _mtx;
+      std::condition_variable _cv;
+      std::thread::id         _owner;
+      uint32_t                _depth = 0;
+      uint32_t                _readers = 0;
+      uint32_t                _writers_waiting = 0;
+   };
+
    // async on thread_pool and return future
    template<typename F>
    auto async_thread_pool( boost::asio::io_context& thread_pool, F&& f ) {
@@ -28,6 +28,13 @@ namespace eosio { namespace chain {
                      uint32_t closest_unnotified_ancestor_action_ordinal );
       action_trace(){}
 
+      /// noexcept so that a growing action_traces moves its traces instead of copying the data of every action.
+      /// The members only move pointers, fc::exception and fc::optional just don't declare their moves noexcept.
+      action_trace( action_trace&& other ) noexcept;
+      action_trace( const action_trace& ) = default;
+      action_trace& operator=( action_trace&& ) = default;
+      action_trace& operator=( const action_trace& ) = default;
+
       fc::unsigned_int                action_ordinal;
       fc::unsigned_int                creator_action_ordinal;
       fc::unsigned_int                closest_unnotified_ancestor_action_ordinal;
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <fc/variant.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace eosio { namespace chain {
+
+   /**
+    * A completed span of block processing work. name must be a string literal, spans only keep the pointer.
+    */
+   struct trace_span {
+      const char* name        = nullptr;
+      const char* category    = nullptr;
+      uint32_t    block_num   = 0;
+      uint32_t    thread_id   = 0;  ///< small id assigned to the recording thread on its first span
+      uint64_t    start_ns    = 0;  ///< steady clock
+      uint64_t    duration_ns = 0;
+   };
+
+   /**
+    * Process wide collector of trace_spans. Every thread records into its own fixed size ring buffer, the oldest
+    * spans of a thread are overwritten once its ring is full. Recording is a no-op while tracing is disabled.
+    */
+   class span_tracer {
+   public:
+      static constexpr size_t ring_capacity = 8192;
+
+      static void set_enabled( bool enabled ) { _enabled.store( enabled, std::memory_order_relaxed ); }
+      static bool enabled() { return _enabled.load( std::memory_order_relaxed ); }
+
+      static void record( const trace_span& s );
+
+      /// moves the spans recorded so far by all threads out of their rings, ordered by start time
+      static std::vector<trace_span> drain();
+
+      /// Chrome trace event format, loadable by chrome://tracing and Perfetto
+      static fc::variant to_chrome_trace( const std::vector<trace_span>& spans );
+
+      /// OTLP/JSON ExportTraceServiceRequest, one trace per block number
+      static fc::variant to_otlp( const std::vector<trace_span>& spans );
+
+      static uint64_t now_ns() {
+         return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+      }
+
+   private:
+      static std::atomic<bool> _enabled;
+   };
+
+   /**
+    * Records a trace_span covering its own lifetime, if tracing was enabled when it was constructed.
+    */
+   class scoped_span {
+   public:
+      scoped_span( const char* name, const char* category, uint32_t block_num = 0 ) {
+         if( span_tracer::enabled() ) {
+            _span.name = name;
+            _span.category = category;
+            _span.block_num = block_num;
+            _span.start_ns = span_tracer::now_ns();
+         }
+      }
+
+      ~scoped_span() {
+         if( _span.name ) {
+            _span.duration_ns = span_tracer::now_ns() - _span.start_ns;
+            span_tracer::record( _span );
+         }
+      }
+
+      /// for spans started before the block number is known
+      void set_block_num( uint32_t block_num ) { _span.block_num = block_num; }
+
+      scoped_span( const scoped_span& ) = delete;
+      scoped_span& operator=( const scoped_span& ) = delete;
+
+   private:
+      trace_span _span;
+   };
+
+} } // eosio::chain
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <eosio/chain/action.hpp>
+#include <memory>
+#include <mutex>
 #include <numeric>
 
 namespace eosio { namespace chain {
@@ -140,10 +142,11 @@ namespace eosio { namespace chain {
       };
 
       packed_transaction() = default;
-      packed_transaction(packed_transaction&&) = default;
+      /// the moved from transaction gets a cache of its own, it stays usable
+      packed_transaction(packed_transaction&& other);
       explicit packed_transaction(const packed_transaction&) = default;
       packed_transaction& operator=(const packed_transaction&) = delete;
-      packed_transaction& operator=(packed_transaction&&) = default;
+      packed_transaction& operator=(packed_transaction&& other);
 
       explicit packed_transaction(const signed_transaction& t, compression_type _compression = compression_type::none)
       :signatures(t.signatures), compression(_compression), unpacked_trx(t), trx_id(unpacked_trx.id())
@@ -167,7 +170,10 @@ namespace eosio { namespace chain {
       uint32_t get_unprunable_size()const;
       uint32_t get_prunable_size()const;
 
+      /// computed once per transaction, the copies share the result
       digest_type packed_digest()const;
+      /// same as signed_transaction::sig_digest() of the context free data, computed once per transaction and chain id
+      digest_type sig_digest( const chain_id_type& chain_id )const;
 
       const transaction_id_type& id()const { return trx_id; }
       bytes               get_raw_transaction()const;
@@ -191,6 +197,12 @@ namespace eosio { namespace chain {
       friend struct fc::reflector_init_visitor<packed_transaction>;
       friend struct fc::has_reflector_init<packed_transaction>;
       void reflector_init();
+
+      struct digest_cache {
+         std::mutex                                          mtx;
+         fc::optional<digest_type>                           packed_digest;
+         fc::optional<std::pair<chain_id_type, digest_type>> sig_digest;
+      };
    private:
       vector<signature_type>                  signatures;
       fc::enum_type<uint8_t,compression_type> compression;
@@ -201,6 +213,8 @@ namespace eosio { namespace chain {
       // cache unpacked trx, for thread safety do not modify after construction
       signed_transaction                      unpacked_trx;
       transaction_id_type                     trx_id;
+      // shared with the copies, which have the same contents
+      std::shared_ptr<digest_cache>           digests = std::make_shared<digest_cache>();
    };
 
    using packed_transaction_ptr = std::shared_ptr<packed_transaction>;
@@ -3,6 +3,7 @@
 #include <eosio/chain/trace.hpp>
 #include <eosio/chain/platform_timer.hpp>
 #include <signal.h>
+#include <unordered_map>
 
 namespace eosio { namespace chain {
 
@@ -15,6 +16,9 @@ namespace eosio { namespace chain {
 
          void start(fc::time_point tp);
          void stop();
+         /* Expires the timer if its deadline has passed, without waiting for it to fire. For runtimes that poll
+            the clock. */
+         void poll();
 
          /* Sets a callback for when timer expires. Be aware this could might fire from a signal handling context and/or
             on any particular thread. Only a single callback can be registered at once; trying to register more will
@@ -24,6 +28,7 @@ namespace eosio { namespace chain {
          std::atomic_bool& expired;
       private:
          platform_timer& _timer;
+         fc::time_point _deadline = fc::time_point::maximum();
 
          transaction_checktime_timer(platform_timer& timer);
          friend controller_impl;
@@ -75,6 +80,8 @@ namespace eosio { namespace chain {
          friend class apply_context;
 
          void add_ram_usage( account_name account, int64_t ram_delta );
+         void apply_pending_ram_usage();
+         void apply_pending_row_updates();
 
          action_trace& get_action_trace( uint32_t action_ordinal );
          const action_trace& get_action_trace( uint32_t action_ordinal )const;
@@ -137,6 +144,16 @@ namespace eosio { namespace chain {
          bool                          is_initialized = false;
 
 
+         /// ram deltas of the transaction netted per account, written to resource_usage_object once in finalize
+         flat_map<account_name, int64_t> pending_ram_usage;
+
+         struct pending_row_update {
+            vector<char>                 value;
+            account_name                 payer;
+         };
+         /// db_update_i64 results by key_value_object id, written to the rows once in finalize; reads of the rows look here first
+         std::unordered_map<int64_t, pending_row_update> pending_row_updates;
+
          uint64_t                      net_limit = 0;
          bool                          net_limit_due_to_block = true;
          bool                          net_limit_due_to_greylist = false;
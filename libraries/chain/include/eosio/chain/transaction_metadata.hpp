@@ -23,7 +23,8 @@ class transaction_metadata {
       enum class trx_type {
          input,
          implicit,
-         scheduled
+         scheduled,
+         dry_run     ///< input transaction executed only for its trace, never added to the pending block
       };
 
    private:
@@ -34,6 +35,7 @@ class transaction_metadata {
    public:
       const bool                                                 implicit;
       const bool                                                 scheduled;
+      const bool                                                 dry_run;
       bool                                                       accepted = false;       // not thread safe
       uint32_t                                                   billed_cpu_time_us = 0; // not thread safe
 
@@ -50,12 +52,13 @@ class transaction_metadata {
       // creation of tranaction_metadata restricted to start_recover_keys and create_no_recover_keys below, public for make_shared
       explicit transaction_metadata( const private_type& pt, packed_transaction_ptr ptrx,
                                      fc::microseconds sig_cpu_usage, flat_set<public_key_type> recovered_pub_keys,
-                                     bool _implicit = false, bool _scheduled = false)
+                                     bool _implicit = false, bool _scheduled = false, bool _dry_run = false)
          : _packed_trx( std::move( ptrx ) )
          , _sig_cpu_usage( sig_cpu_usage )
          , _recovered_pub_keys( std::move( recovered_pub_keys ) )
          , implicit( _implicit )
-         , scheduled( _scheduled ) {
+         , scheduled( _scheduled )
+         , dry_run( _dry_run ) {
       }
 
       transaction_metadata() = delete;
@@ -75,14 +78,25 @@ class transaction_metadata {
       static recover_keys_future
       start_recover_keys( packed_transaction_ptr trx, boost::asio::io_context& thread_pool,
                           const chain_id_type& chain_id, fc::microseconds time_limit,
-                          uint32_t max_variable_sig_size = UINT32_MAX );
+                          uint32_t max_variable_sig_size = UINT32_MAX, trx_type t = trx_type::input );
+
+      /// Thread safe. Same as start_recover_keys() for each of trxs, a few transactions share one thread_pool task.
+      /// @returns one future per transaction, in order
+      static std::vector<recover_keys_future>
+      start_recover_keys( std::vector<packed_transaction_ptr> trxs, boost::asio::io_context& thread_pool,
+                          const chain_id_type& chain_id, fc::microseconds time_limit );
+
+      /// Thread safe. Recovers the keys on the calling thread, for callers already running on a thread_pool task.
+      static transaction_metadata_ptr
+      recover_keys( packed_transaction_ptr trx, const chain_id_type& chain_id, fc::microseconds time_limit,
+                    uint32_t max_variable_sig_size = UINT32_MAX, trx_type t = trx_type::input );
 
       /// @returns constructed transaction_metadata with no key recovery (sig_cpu_usage=0, recovered_pub_keys=empty)
       static transaction_metadata_ptr
       create_no_recover_keys( const packed_transaction& trx, trx_type t ) {
          return std::make_shared<transaction_metadata>( private_type(),
                std::make_shared<packed_transaction>( trx ), fc::microseconds(), flat_set<public_key_type>(),
-                     t == trx_type::implicit, t == trx_type::scheduled );
+                     t == trx_type::implicit, t == trx_type::scheduled, t == trx_type::dry_run );
       }
 
 };
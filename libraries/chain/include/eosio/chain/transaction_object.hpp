@@ -16,6 +16,10 @@ namespace eosio { namespace chain {
     * The purpose of this object is to enable the detection of duplicate transactions. When a transaction is included
     * in a block a transaction_object is added. At the end of block processing all transaction_objects that have
     * expired can be removed from the index.
+    *
+    * The index is part of the undo sessions and of snapshots like any other chainbase index, which is why it is
+    * ordered rather than hashed: chainbase undo indices only support ordered_unique. Removing the expired ids, in
+    * clear_expired_input_transactions, takes them from the front of by_expiration one by one.
     */
    class transaction_object : public chainbase::object<transaction_object_type, transaction_object>
    {
@@ -8,6 +8,9 @@
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
+#include <boost/multi_index/composite_key.hpp>
+
+#include <functional>
 
 namespace fc {
   inline std::size_t hash_value( const fc::sha256& v ) {
@@ -30,6 +33,7 @@ struct unapplied_transaction {
    const transaction_metadata_ptr trx_meta;
    const fc::time_point           expiry;
    trx_enum_type                  trx_type = trx_enum_type::unknown;
+   uint64_t                       priority = 0;
 
    const transaction_id_type& id()const { return trx_meta->id(); }
 
@@ -42,6 +46,7 @@ struct unapplied_transaction {
 /**
  * Track unapplied transactions for persisted, forked blocks, and aborted blocks.
  * Persisted are first so that they can be applied in each block until expired.
+ * Within a type, transactions are ordered by descending priority, then by insertion.
  */
 class unapplied_transaction_queue {
 public:
@@ -51,6 +56,9 @@ public:
       speculative_producer       // can produce
    };
 
+   /// higher values are applied first, evaluated once when a transaction is added
+   using priority_func = std::function<uint64_t( const transaction_metadata& )>;
+
 private:
    struct by_trx_id;
    struct by_type;
@@ -61,13 +69,24 @@ private:
          hashed_unique< tag<by_trx_id>,
                const_mem_fun<unapplied_transaction, const transaction_id_type&, &unapplied_transaction::id>
          >,
-         ordered_non_unique< tag<by_type>, member<unapplied_transaction, trx_enum_type, &unapplied_transaction::trx_type> >,
+         ordered_non_unique< tag<by_type>,
+               composite_key< unapplied_transaction,
+                  member<unapplied_transaction, trx_enum_type, &unapplied_transaction::trx_type>,
+                  member<unapplied_transaction, uint64_t, &unapplied_transaction::priority>
+               >,
+               composite_key_compare< std::less<trx_enum_type>, std::greater<uint64_t> >
+         >,
          ordered_non_unique< tag<by_expiry>, member<unapplied_transaction, const fc::time_point, &unapplied_transaction::expiry> >
       >
    > unapplied_trx_queue_type;
 
    unapplied_trx_queue_type queue;
    process_mode mode = process_mode::speculative_producer;
+   priority_func priority_of;
+
+   uint64_t get_priority( const transaction_metadata_ptr& trx ) const {
+      return priority_of ? priority_of( *trx ) : 0;
+   }
 
 public:
 
@@ -78,6 +97,11 @@ public:
       mode = new_mode;
    }
 
+   /// applies only to transactions added afterwards
+   void set_priority_function( priority_func f ) {
+      priority_of = std::move( f );
+   }
+
    bool empty() const {
       return queue.empty();
    }
@@ -91,7 +115,7 @@ public:
    }
 
    bool contains_persisted()const {
-      return queue.get<by_type>().find( trx_enum_type::persisted ) != queue.get<by_type>().end();
+      return queue.get<by_type>().find( boost::make_tuple( trx_enum_type::persisted ) ) != queue.get<by_type>().end();
    }
 
    bool is_persisted(const transaction_metadata_ptr& trx)const {
@@ -143,7 +167,7 @@ public:
          for( auto itr = bsptr->trxs_metas().begin(), end = bsptr->trxs_metas().end(); itr != end; ++itr ) {
             const auto& trx = *itr;
             fc::time_point expiry = trx->packed_trx()->expiration();
-            queue.insert( { trx, expiry, trx_enum_type::forked } );
+            queue.insert( { trx, expiry, trx_enum_type::forked, get_priority( trx ) } );
          }
       }
    }
@@ -152,7 +176,8 @@ public:
       if( mode == process_mode::non_speculative || mode == process_mode::speculative_non_producer ) return;
       for( auto& trx : aborted_trxs ) {
          fc::time_point expiry = trx->packed_trx()->expiration();
-         queue.insert( { std::move( trx ), expiry, trx_enum_type::aborted } );
+         auto priority = get_priority( trx );
+         queue.insert( { std::move( trx ), expiry, trx_enum_type::aborted, priority } );
       }
    }
 
@@ -161,7 +186,7 @@ public:
       auto itr = queue.get<by_trx_id>().find( trx->id() );
       if( itr == queue.get<by_trx_id>().end() ) {
          fc::time_point expiry = trx->packed_trx()->expiration();
-         queue.insert( { trx, expiry, trx_enum_type::persisted } );
+         queue.insert( { trx, expiry, trx_enum_type::persisted, get_priority( trx ) } );
       } else if( itr->trx_type != trx_enum_type::persisted ) {
          queue.get<by_trx_id>().modify( itr, [](auto& un){
             un.trx_type = trx_enum_type::persisted;
@@ -174,8 +199,8 @@ public:
    iterator begin() { return queue.get<by_type>().begin(); }
    iterator end() { return queue.get<by_type>().end(); }
 
-   iterator persisted_begin() { return queue.get<by_type>().lower_bound( trx_enum_type::persisted ); }
-   iterator persisted_end() { return queue.get<by_type>().upper_bound( trx_enum_type::persisted ); }
+   iterator persisted_begin() { return queue.get<by_type>().lower_bound( boost::make_tuple( trx_enum_type::persisted ) ); }
+   iterator persisted_end() { return queue.get<by_type>().upper_bound( boost::make_tuple( trx_enum_type::persisted ) ); }
 
    iterator erase( iterator itr ) { return queue.get<by_type>().erase( itr ); }
 
@@ -598,15 +598,16 @@ struct op_types {
 
 /** 
  * Section for cached ops
+ * Decoding unpacks the immediates in to these, so each thread has its own
  */
 template <class Op_Types>
 class cached_ops {
 #define GEN_FIELD( r, P, OP ) \
-   static std::unique_ptr<typename Op_Types::BOOST_PP_CAT(OP,_t)> BOOST_PP_CAT(P, OP);
+   static thread_local std::unique_ptr<typename Op_Types::BOOST_PP_CAT(OP,_t)> BOOST_PP_CAT(P, OP);
    BOOST_PP_SEQ_FOR_EACH( GEN_FIELD, cached_, WASM_OP_SEQ )
 #undef GEN_FIELD
 
-   static std::vector<instr*> _cached_ops;
+   static thread_local std::vector<instr*> _cached_ops;
    public:
    static std::vector<instr*>* get_cached_ops() {
 #define PUSH_BACK_OP( r, T, OP ) \
@@ -622,11 +623,11 @@ class cached_ops {
 };
 
 template <class Op_Types>
-std::vector<instr*> cached_ops<Op_Types>::_cached_ops; 
+thread_local std::vector<instr*> cached_ops<Op_Types>::_cached_ops; 
 
 #define INIT_FIELD( r, P, OP ) \
    template <class Op_Types>   \
-   std::unique_ptr<typename Op_Types::BOOST_PP_CAT(OP,_t)> cached_ops<Op_Types>::BOOST_PP_CAT(P, OP) = std::make_unique<typename Op_Types::BOOST_PP_CAT(OP,_t)>();
+   thread_local std::unique_ptr<typename Op_Types::BOOST_PP_CAT(OP,_t)> cached_ops<Op_Types>::BOOST_PP_CAT(P, OP) = std::make_unique<typename Op_Types::BOOST_PP_CAT(OP,_t)>();
    BOOST_PP_SEQ_FOR_EACH( INIT_FIELD, cached_, WASM_OP_SEQ )
 
 template <class Op_Types>
@@ -695,14 +696,14 @@ struct EOSIO_OperatorDecoderStream
    inline uint32_t index() { return nextByte - start; }
 private:
    // cached ops to take the address of 
-   static const std::vector<instr*>* _cached_ops;
+   static thread_local const std::vector<instr*>* _cached_ops;
    const U8* start;
    const U8* nextByte;
    const U8* end;
 };
 
 template <class Op_Types>
-const std::vector<instr*>* EOSIO_OperatorDecoderStream<Op_Types>::_cached_ops;
+thread_local const std::vector<instr*>* EOSIO_OperatorDecoderStream<Op_Types>::_cached_ops;
 
 }}} // namespace eosio, chain, wasm_ops
 
@@ -4,7 +4,9 @@
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/wasm_eosio_binary_ops.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <functional>
+#include <future>
 #include <vector>
 #include <iostream>
 #include "IR/Module.h"
@@ -337,7 +339,45 @@ namespace eosio { namespace chain { namespace wasm_validations {
 
          void validate() {
             _module_validators.validate( *_module );
-            for ( auto& fd : _module->functions.defs ) {
+            validate_functions( 0, _module->functions.defs.size() );
+         }
+
+         // same checks as validate(), the functions are split in to chunks checked on thread_pool. Only done when the
+         // nested_validator is disabled, its depth is carried from one function to the next
+         void validate( boost::asio::io_context& thread_pool ) {
+            auto& defs = _module->functions.defs;
+            if( !nested_validator::disabled || defs.size() < 2 ) {
+               validate();
+               return;
+            }
+            _module_validators.validate( *_module );
+
+            std::vector<std::future<void>> checks;
+            for( size_t begin = 0; begin < defs.size(); ) {
+               size_t end = begin;
+               for( size_t bytes = 0; end < defs.size() && bytes < parallel_chunk_bytes; ++end )
+                  bytes += defs[end].code.size();
+               checks.emplace_back( async_thread_pool( thread_pool, [this, begin, end]() { validate_functions( begin, end ); } ) );
+               begin = end;
+            }
+            // the chunks use _module, wait for all of them, report the failure of the first function failing
+            std::exception_ptr failure;
+            for( auto& c : checks ) {
+               try {
+                  c.get();
+               } catch( ... ) {
+                  if( !failure ) failure = std::current_exception();
+               }
+            }
+            if( failure )
+               std::rethrow_exception( failure );
+         }
+      private:
+         static constexpr size_t parallel_chunk_bytes = 64*1024;
+
+         void validate_functions( size_t begin, size_t end ) {
+            for ( size_t i = begin; i < end; ++i ) {
+               auto& fd = _module->functions.defs[i];
                wasm_ops::EOSIO_OperatorDecoderStream<op_constrainers> decoder(fd.code);
                while ( decoder ) {
                   wasm_ops::instruction_stream new_code(0);
@@ -346,7 +386,7 @@ namespace eosio { namespace chain { namespace wasm_validations {
                }
             }
          }
-      private:
+
          IR::Module* _module;
          static standard_module_constraints_validators _module_validators;
    };
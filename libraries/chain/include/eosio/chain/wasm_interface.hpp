@@ -9,12 +9,16 @@
 #include "Runtime/Linker.h"
 #include "Runtime/Runtime.h"
 
+namespace boost { namespace asio {
+   class io_context;
+}}
+
 namespace eosio { namespace chain {
 
    class apply_context;
    class wasm_runtime_interface;
    class controller;
-   namespace eosvmoc { struct config; }
+   namespace eosvmoc { struct config; struct code_cache_metrics; }
 
    struct wasm_exit {
       int32_t code = 0;
@@ -105,12 +109,22 @@ namespace eosio { namespace chain {
          //validates code -- does a WASM validation pass and checks the wasm against EOSIO specific constraints
          static void validate(const controller& control, const bytes& code);
 
+         //as above, the functions are checked on thread_pool when possible. Codes that validated are remembered by code_hash
+         //until the whitelisted intrinsics change, so executing the same setcode again skips the validation
+         void validate(const controller& control, const bytes& code, const digest_type& code_hash, boost::asio::io_context& thread_pool);
+
          //indicate that a particular code probably won't be used after given block_num
          void code_block_num_last_used(const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version, const uint32_t& block_num);
 
          //indicate the current LIB. evicts old cache entries
          void current_lib(const uint32_t lib);
 
+         //queue an EOS VM OC tier-up compile of code ahead of its first use. no-op without tier-up or if already cached
+         void eosvmoc_warmup(const digest_type& code_hash, const uint8_t& vm_version);
+
+         //returns false if EOS VM OC tier-up is not enabled
+         bool get_eosvmoc_metrics(eosvmoc::code_cache_metrics& metrics) const;
+
          //Calls apply or error on a given code
          void apply(const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version, apply_context& context);
 
@@ -5,6 +5,7 @@
 #include <eosio/chain/webassembly/wabt.hpp>
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
 #include <eosio/chain/webassembly/eos-vm-oc.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/profile.hpp>
 #else
 #define _REGISTER_EOSVMOC_INTRINSIC(CLS, MOD, METHOD, WASM_SIG, NAME, SIG)
 #endif
@@ -54,10 +55,27 @@ namespace eosio { namespace chain {
 
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
       struct eosvmoc_tier {
-         eosvmoc_tier(const boost::filesystem::path& d, const eosvmoc::config& c, const chainbase::database& db) : cc(d, c, db), exec(cc) {}
+         eosvmoc_tier(const boost::filesystem::path& d, const eosvmoc::config& c, const chainbase::database& db) :
+            cc(c.shared_cache_writer ? c.shared_cache_dir : d, c, db), exec(cc), pinned_accounts(c.pinned_accounts) {
+            exec.deadline_poll_interval = c.deadline_poll_interval;
+            exec.map_hot_code(c.hot_code_size);
+            if(!c.shared_cache_dir.empty() && !c.shared_cache_writer) {
+               shared_cc = std::make_unique<eosvmoc::code_cache_shared_reader>(c.shared_cache_dir, eosvmoc::codegen_version_for(c.deadline_poll_interval));
+               shared_exec = std::make_unique<eosvmoc::executor>(shared_cc->fd());
+               shared_exec->deadline_poll_interval = c.deadline_poll_interval;
+               shared_exec->map_hot_code(c.hot_code_size);
+            }
+            if(!c.profile_dir.empty())
+               prof = std::make_unique<eosvmoc::profiler>(c.profile_dir, c.profile_interval_us);
+         }
          eosvmoc::code_cache_async cc;
          eosvmoc::executor exec;
-         eosvmoc::memory mem;
+         eosvmoc::memory_pool mem_pool;
+         std::set<name> pinned_accounts;
+         //codes another nodeos on the host compiled in to the shared cache are executed from there, saving the compile and the memory
+         std::unique_ptr<eosvmoc::code_cache_shared_reader> shared_cc;
+         std::unique_ptr<eosvmoc::executor> shared_exec;
+         std::unique_ptr<eosvmoc::profiler> prof; ///< samples the memories of mem_pool, so destroyed before it
       };
 #endif
 
@@ -159,6 +177,13 @@ namespace eosio { namespace chain {
                trx_context.resume_billing_timer();
             });
             trx_context.pause_billing_timer();
+            if(!runtime_interface->needs_ir_module()) {
+               // eos-vm parses and validates the code itself and builds its memory from the data segments
+               wasm_instantiation_cache.modify(it, [&](auto& c) {
+                  c.module = runtime_interface->instantiate_module(codeobject->code.data(), codeobject->code.size(), {}, code_hash, vm_type, vm_version);
+               });
+               return it->module;
+            }
             IR::Module module;
             std::vector<U8> bytes = {
                 (const U8*)codeobject->code.data(),
@@ -195,6 +220,16 @@ namespace eosio { namespace chain {
       }
 
       bool is_shutting_down = false;
+
+      struct validated_code {
+         digest_type intrinsics_digest; ///< of the whitelisted intrinsics the code was linked against
+         bool        nesting_checked = false;
+      };
+      struct code_hash_hash {
+         size_t operator()( const digest_type& d )const { return d._hash[0]; }
+      };
+      static constexpr size_t max_validated_codes = 1024;
+      std::unordered_map<digest_type, validated_code, code_hash_hash> validated_codes; ///< cleared when full
       std::unique_ptr<wasm_runtime_interface> runtime_interface;
 
       typedef boost::multi_index_container<
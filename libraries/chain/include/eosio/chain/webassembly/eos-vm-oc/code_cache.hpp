@@ -14,8 +14,11 @@
 #include <boost/asio/local/datagram_protocol.hpp>
 
 
+#include <chrono>
 #include <thread>
 
+#include <sys/stat.h>
+
 namespace std {
     template<> struct hash<eosio::chain::eosvmoc::code_tuple> {
         size_t operator()(const eosio::chain::eosvmoc::code_tuple& ct) const noexcept {
@@ -36,6 +39,14 @@ using allocator_t = bip::rbtree_best_fit<bip::null_mutex_family, bip::offset_ptr
 
 struct config;
 
+//index of a shared code cache, published by its writer next to the cache file for the readers
+struct shared_code_cache_index {
+   uint64_t                     id = 0;
+   uint64_t                     cache_inode = 0; ///< of the cache file the offsets refer to
+   uint64_t                     cache_size = 0;
+   std::vector<code_descriptor> codes;
+};
+
 class code_cache_base {
    public:
       code_cache_base(const bfs::path data_dir, const eosvmoc::config& eosvmoc_config, const chainbase::database& db);
@@ -45,6 +56,11 @@ class code_cache_base {
 
       void free_code(const digest_type& code_id, const uint8_t& vm_version);
 
+      //never evict the code once it is in the cache; for the async cache it is also compiled on first use
+      void pin(const digest_type& code_id, const uint8_t& vm_version);
+
+      code_cache_metrics metrics() const;
+
    protected:
       struct by_hash;
 
@@ -73,13 +89,31 @@ class code_cache_base {
 
       //these are really only useful to the async code cache, but keep them here so
       //free_code can be shared
-      std::unordered_set<code_tuple> _queued_compiles;
+      struct queued_compile {
+         uint32_t misses = 0;   ///< halved every admission window; the most missed code is compiled first
+         bool     recent = true; ///< missed during the current admission window
+      };
+      std::unordered_map<code_tuple, queued_compile> _queued_compiles;
       std::unordered_map<code_tuple, bool> _outstanding_compiles_and_poison;
 
+      std::unordered_set<code_tuple> _pinned;
+      code_cache_metrics _metrics;
+
+      //compiles are requested with it, codes of the index compiled with another one are not used
+      uint8_t _codegen_version = 0;
+
       size_t _free_bytes_eviction_threshold;
       void check_eviction_threshold(size_t free_bytes);
       void run_eviction_round();
 
+      //a shared cache is append only: readers in other processes may be executing any code it ever held, so its
+      // writer never evicts or frees a code. Only one writer is allowed, enforced with a lock file.
+      bool _shared_writer = false;
+      wrapped_fd _shared_lock;
+      bool _shared_index_dirty = false;
+      std::chrono::steady_clock::time_point _shared_index_published;
+      void publish_shared_index();
+
       void set_on_disk_region_dirty(bool);
 
       template <typename T>
@@ -96,6 +130,9 @@ class code_cache_async : public code_cache_base {
       //otherwise: return nullptr
       const code_descriptor* const get_descriptor_for_code(const digest_type& code_id, const uint8_t& vm_version);
 
+      //as get_descriptor_for_code, but the code is admitted for compilation on this call already
+      void warmup(const digest_type& code_id, const uint8_t& vm_version);
+
    private:
       std::thread _monitor_reply_thread;
       boost::lockfree::spsc_queue<wasm_compilation_result_message> _result_queue;
@@ -103,6 +140,45 @@ class code_cache_async : public code_cache_base {
       std::tuple<size_t, size_t> consume_compile_thread_queue();
       std::unordered_set<code_tuple> _blacklist;
       size_t _threads;
+
+      //frequency based admission: one-off codes must not push frequently executed codes out of the cache
+      bool admit(const code_tuple& ct);
+      //halves the execution counts once per admission window; queued compiles of codes not missed during the last
+      // window are cancelled
+      void age_execution_counts();
+      //takes the pinned or most missed code off the queue; false if it no longer exists
+      bool compile_next_queued();
+      std::unordered_map<code_tuple, uint32_t> _execution_counts;
+      uint32_t _admission_executions;
+      uint32_t _admission_window;
+      uint32_t _admission_misses = 0;
+};
+
+//read only view of a shared code cache other nodeos processes on the host compile in to
+class code_cache_shared_reader {
+   public:
+      code_cache_shared_reader(const bfs::path& dir, uint8_t codegen_version);
+      ~code_cache_shared_reader();
+
+      const int& fd() const { return _cache_fd; }
+
+      //rereads the writer's index at most once a second; the pointer is valid until the next call
+      const code_descriptor* const get_descriptor_for_code(const digest_type& code_id, const uint8_t& vm_version);
+
+   private:
+      void reload_index();
+
+      bfs::path _index_path;
+      uint8_t   _codegen_version;
+      int       _cache_fd;
+      uint64_t  _cache_inode;
+      uint64_t  _cache_size;
+
+      std::unordered_map<code_tuple, code_descriptor> _codes;
+      std::chrono::steady_clock::time_point _last_check;
+      struct timespec _index_mtime = {};
+      ino_t           _index_inode = 0;
+      bool            _mismatch_logged = false;
 };
 
 class code_cache_sync : public code_cache_base {
@@ -114,4 +190,6 @@ class code_cache_sync : public code_cache_base {
       const code_descriptor* const get_descriptor_for_code_sync(const digest_type& code_id, const uint8_t& vm_version);
 };
 
-}}}
\ No newline at end of file
+}}}
+
+FC_REFLECT(eosio::chain::eosvmoc::shared_code_cache_index, (id)(cache_inode)(cache_size)(codes))
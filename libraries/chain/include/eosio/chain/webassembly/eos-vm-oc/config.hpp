@@ -1,18 +1,62 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <istream>
 #include <ostream>
 #include <vector>
 #include <string>
+#include <set>
 
 #include <boost/filesystem/path.hpp>
 #include <fc/reflect/reflect.hpp>
+#include <eosio/chain/name.hpp>
 
 namespace eosio { namespace chain { namespace eosvmoc {
 
 struct config {
    uint64_t cache_size = 1024u*1024u*1024u;
    uint64_t threads    = 1u;
+   uint32_t warmup_blocks = 0u; ///< at startup, queue compiles of the contracts called in this many of the last blocks
+   uint32_t admission_executions = 1u; ///< compile a code only once it missed the cache this many times within the window
+   uint32_t admission_window = 10000u; ///< cache misses after which the execution counts of uncompiled codes are halved
+   std::set<name> pinned_accounts;     ///< codes of these accounts are compiled on first use and never evicted
+   boost::filesystem::path profile_dir;  ///< when not empty, profile the executions and write the profiles here
+   uint32_t profile_interval_us = 1000u; ///< cpu time between two profile samples
+   boost::filesystem::path shared_cache_dir; ///< when not empty, also execute the compiled codes of the shared code cache in this directory
+   bool shared_cache_writer = false;         ///< compile in to the shared code cache instead of a private one, only one writer per shared cache
+   uint32_t deadline_poll_interval = 0u;     ///< function entries and loop iterations of compiled code between two reads of the clock against the transaction deadline, 0 for the timer alone
+   uint64_t hot_code_size = 0u;              ///< when not 0, execute the codes from a copy in a region of this many bytes backed by huge pages, laid out in the order they are first executed
+};
+
+struct code_cache_metrics {
+   uint64_t hits = 0;
+   uint64_t misses = 0;
+   uint64_t compiles = 0;             ///< compiles handed to the compile threads
+   uint64_t rejected_admissions = 0;  ///< misses not compiled because the code was not executed often enough yet
+   uint64_t evictions = 0;
+   uint64_t entries = 0;
+   uint64_t pinned = 0;
+   uint64_t queued_compiles = 0;      ///< waiting for a compile thread
+   uint64_t outstanding_compiles = 0; ///< on a compile thread
+   uint64_t cancelled_compiles = 0;   ///< dropped from the queue because the code was not executed for a window
+   uint64_t compile_time_us_total = 0;
+   uint64_t compile_time_us_max = 0;
+   std::vector<uint64_t> compile_time_histogram = std::vector<uint64_t>(compile_time_bucket_bounds_ms.size()+1); ///< compiles per bucket, the last one is above all bounds
+
+   static constexpr std::array<uint64_t, 4> compile_time_bucket_bounds_ms = {10u, 100u, 1000u, 10000u};
+
+   void record_compile_time(uint64_t us) {
+      compile_time_us_total += us;
+      compile_time_us_max = std::max(compile_time_us_max, us);
+      size_t b = 0;
+      while(b < compile_time_bucket_bounds_ms.size() && us >= compile_time_bucket_bounds_ms[b]*1000u)
+         ++b;
+      ++compile_time_histogram[b];
+   }
 };
 
 }}}
+
+FC_REFLECT(eosio::chain::eosvmoc::code_cache_metrics, (hits)(misses)(compiles)(rejected_admissions)(evictions)(entries)(pinned)(queued_compiles)(outstanding_compiles)
+           (cancelled_compiles)(compile_time_us_total)(compile_time_us_max)(compile_time_histogram))
@@ -35,4 +35,6 @@ struct eos_vm_oc_control_block {
    uintptr_t running_code_base;
    int64_t  first_invalid_memory_address;
    unsigned is_running;
+   unsigned deadline_poll_countdown; //function entries and loop iterations left until the compiled code polls the deadline
+   unsigned deadline_poll_interval;  //0 when the deadline is only enforced by the transaction timer
 };
\ No newline at end of file
@@ -26,6 +26,13 @@ struct intrinsic_ordinal{ size_t ordinal; };
 
 using eosvmoc_optional_offset_or_import_t = fc::static_variant<no_offset, code_offset, intrinsic_ordinal>;
 
+//code_descriptor::codegen_version of code polling the deadline, see config::deadline_poll_interval; 0 is code without the polls
+constexpr uint8_t codegen_version_deadline_poll = 1;
+
+inline uint8_t codegen_version_for(uint32_t deadline_poll_interval) {
+   return deadline_poll_interval ? codegen_version_deadline_poll : 0;
+}
+
 struct code_descriptor {
    digest_type code_hash;
    uint8_t vm_version;
@@ -8,6 +8,7 @@
 #include <list>
 #include <vector>
 #include <cstddef>
+#include <unordered_map>
 
 namespace eosio { namespace chain {
 
@@ -22,15 +23,32 @@ struct code_descriptor;
 class executor {
    public:
       executor(const code_cache_base& cc);
+      explicit executor(int cache_fd);
       ~executor();
 
-      void execute(const code_descriptor& code, const memory& mem, apply_context& context);
+      void execute(const code_descriptor& code, memory& mem, apply_context& context);
+
+      uint32_t deadline_poll_interval = 0; ///< see config::deadline_poll_interval
+
+      //executes the codes from a copy in a region of size bytes backed by huge pages, see config::hot_code_size
+      void map_hot_code(size_t size);
 
    private:
       uint8_t* code_mapping;
       size_t code_mapping_size;
       bool mapping_is_executable;
 
+      //codes are copied in the order they are first executed, the region starts over once it is full
+      struct hot_code_entry {
+         size_t offset;
+         uint64_t code_hash_prefix; ///< an evicted code's place in the cache can be taken by another code
+      };
+      uint8_t* hot_code = nullptr;
+      size_t hot_code_size = 0;
+      size_t hot_code_used = 0;
+      std::unordered_map<size_t, hot_code_entry> hot_code_entries; ///< by code_begin
+      uint8_t* hot_code_base(const code_descriptor& code);
+
       std::exception_ptr executors_exception_ptr;
       sigjmp_buf executors_sigjmp_buf;
       std::list<std::vector<std::byte>> executors_bounce_buffers;
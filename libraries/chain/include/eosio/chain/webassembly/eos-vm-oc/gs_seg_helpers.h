@@ -26,6 +26,8 @@ int32_t eos_vm_oc_grow_memory(int32_t grow, int32_t max);
 sigjmp_buf* eos_vm_oc_get_jmp_buf();
 void* eos_vm_oc_get_exception_ptr();
 void* eos_vm_oc_get_bounce_buffer_list();
+void* eos_vm_oc_get_apply_context();
+unsigned eos_vm_oc_restart_deadline_poll();
 
 #ifdef __cplusplus
 }
@@ -8,6 +8,13 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 namespace eosio { namespace chain { namespace eosvmoc {
 
 class memory {
@@ -51,12 +58,46 @@ class memory {
       static_assert(-cb_offset == EOS_VM_OC_CONTROL_BLOCK_OFFSET, "EOS VM OC control block offset has slid out of place somehow");
       static_assert(stride == EOS_VM_OC_MEMORY_STRIDE, "EOS VM OC memory stride has slid out of place somehow");
 
+      //number of wasm pages, from the start of linear memory, that may be non-zero
+      uint32_t dirty_pages() const { return dirty; }
+      void touched_pages(uint32_t pages) { if(pages > dirty) dirty = pages; }
+      //zero the first pages of linear memory, those beyond dirty_pages() are zero already
+      void zero_pages(uint32_t pages);
+
    private:
       uint8_t* mapbase;
       uint64_t mapsize;
 
       uint8_t* zeropage_base;
       uint8_t* fullpage_base;
+
+      uint32_t dirty = 0;
+};
+
+/**
+ * Memories for consecutive executions. A memory released after an execution has its linear memory zeroed on a
+ * background thread, so the next execution usually starts on a clean memory and skips zeroing its initial pages.
+ * Only one memory is in use at a time.
+ */
+class memory_pool {
+   public:
+      explicit memory_pool(size_t size = 2u);
+      ~memory_pool();
+
+      //a zeroed memory if one is ready, otherwise a dirty one
+      memory& acquire();
+      void release(memory& mem);
+
+   private:
+      void zero_loop();
+
+      std::vector<std::unique_ptr<memory>> _memories;
+      std::mutex                           _mtx;
+      std::condition_variable              _cv;
+      std::deque<memory*>                  _clean;
+      std::deque<memory*>                  _dirty;
+      bool                                 _done = false;
+      std::thread                          _thread;
 };
 
 }}}
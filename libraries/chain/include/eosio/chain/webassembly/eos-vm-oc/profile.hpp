@@ -0,0 +1,91 @@
+#pragma once
+
+#include <eosio/chain/types.hpp>
+
+#include <boost/filesystem/path.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <time.h>
+
+namespace eosio { namespace chain { namespace eosvmoc {
+
+/**
+ * Samples the instruction pointer of the thread that created the profiler with a SIGPROF timer on its cpu clock.
+ * Samples taken while a contract runs are attributed to the function of the contract containing the instruction
+ * pointer, or to "[host]" while an intrinsic runs. Every few seconds, and on destruction, the profile of each code
+ * is written to <dir>/<code hash>.folded in the folded stack format flamegraph.pl and speedscope read. There is no
+ * stack unwinding, each sample is a single frame. Functions are named by their wasm function index.
+ *
+ * Only one profiler may exist at a time.
+ */
+class profiler {
+   public:
+      profiler(const boost::filesystem::path& dir, uint32_t interval_us);
+      ~profiler();
+
+      //main thread, around the execution of code_hash
+      void enter(const digest_type& code_hash) {
+         _current_code = code_hash;
+         std::atomic_signal_fence(std::memory_order_release);
+         _in_code = true;
+      }
+      void leave() {
+         _in_code = false;
+         std::atomic_signal_fence(std::memory_order_release);
+      }
+
+      //packed vector of {wasm function index, offset from the start of the code} pairs, as the compile sends them
+      static std::vector<uint8_t> pack_function_offsets(const std::map<unsigned, uintptr_t>& def_offsets, uint32_t imported_functions);
+      //any thread; ignored when no profiler exists
+      static void add_function_offsets(const digest_type& code_hash, const std::vector<uint8_t>& packed);
+
+   private:
+      struct sample {
+         digest_type code_hash;
+         uint32_t    offset;  ///< from the start of the code
+         bool        in_host;
+      };
+      struct code_profile {
+         std::map<uint32_t, uint64_t> offsets; ///< offset => samples
+         uint64_t                     host = 0;
+         bool                         dirty = false;
+      };
+
+      static void sig_handler(int, siginfo_t* si, void* ctx);
+      void record(uintptr_t ip);
+      void drain_loop();
+      void drain();
+      void write_profiles();
+
+      static constexpr uint32_t ring_size = 1u<<14;
+
+      boost::filesystem::path _dir;
+      timer_t                 _timerid;
+
+      digest_type             _current_code;
+      volatile bool           _in_code = false;
+
+      std::unique_ptr<sample[]> _ring;
+      std::atomic<uint32_t>     _head{0}; ///< written by the signal handler
+      std::atomic<uint32_t>     _tail{0}; ///< written by the drain thread
+      std::atomic<uint64_t>     _dropped{0};
+
+      std::map<digest_type, code_profile>                             _profiles;
+      std::mutex                                                      _offsets_mtx;
+      std::map<digest_type, std::vector<std::pair<uint32_t, uint32_t>>> _function_offsets; ///< {offset, function index}, sorted
+
+      std::mutex              _mtx;
+      std::condition_variable _cv;
+      bool                    _done = false;
+      std::thread             _thread;
+};
+
+}}}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cfloat>
+#include <cmath>
+
+namespace eosio { namespace chain { namespace webassembly { namespace native_float {
+
+   /**
+    * Add, sub, mul, div and sqrt of SSE2 and ARMv8 FP are correctly rounded IEEE-754 operations under the default
+    * round to nearest even, without flush to zero, so they give the same bits as softfloat for every result but a
+    * NaN, whose payload depends on the FPU. Compares give the same result for every input, NaNs included.
+    *
+    * Built with EOSIO_NATIVE_FLOAT_ENABLED for one of these FPUs, and with intermediate results not kept at a higher
+    * precision, the softfloat intrinsics use the FPU for these operations and have softfloat compute NaN results.
+    */
+#if defined(EOSIO_NATIVE_FLOAT_ENABLED) && (defined(__x86_64__) || defined(__aarch64__)) && FLT_EVAL_METHOD == 0 && !defined(__FAST_MATH__)
+   constexpr bool enabled = true;
+#else
+   constexpr bool enabled = false;
+#endif
+
+   /// the result of native, or of soft if native's is a NaN or the fast path is disabled
+   template<typename T, typename Native, typename Soft>
+   inline T or_softfloat( Native&& native, Soft&& soft ) {
+      if constexpr( enabled ) {
+         const T r = native();
+         if( !std::isnan( r ) )
+            return r;
+      }
+      return soft();
+   }
+
+} } } } // eosio::chain::webassembly::native_float
@@ -20,6 +20,8 @@ class wasm_instantiated_module_interface {
 class wasm_runtime_interface {
    public:
       virtual bool inject_module(IR::Module& module) = 0;
+      //false if instantiate_module only needs the code bytes, the WAVM parse for inject_module and the initial memory is skipped then
+      virtual bool needs_ir_module() const { return true; }
       virtual std::unique_ptr<wasm_instantiated_module_interface> instantiate_module(const char* code_bytes, size_t code_size, std::vector<uint8_t> initial_memory,
                                                                                      const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version) = 0;
 
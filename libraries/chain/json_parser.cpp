@@ -0,0 +1,305 @@
+#include <eosio/chain/json_parser.hpp>
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <cctype>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#if defined(EOSIO_SIMD_JSON_ENABLED) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace eosio { namespace chain {
+
+#if defined(EOSIO_SIMD_JSON_ENABLED)
+
+namespace {
+
+   constexpr size_t block_size = 16;
+
+   /// one bit per byte of a block
+   struct block_masks {
+      uint32_t quote      = 0;
+      uint32_t backslash  = 0;
+      uint32_t structural = 0; ///< {}[]:,
+      uint32_t whitespace = 0;
+      uint32_t special    = 0; ///< control characters, including whitespace other than space, and non ASCII bytes
+   };
+
+#if defined(__SSE2__)
+   block_masks classify( const char* p ) {
+      const __m128i in = _mm_loadu_si128( reinterpret_cast<const __m128i*>( p ) );
+      auto eq = [&]( char c ) { return uint32_t( _mm_movemask_epi8( _mm_cmpeq_epi8( in, _mm_set1_epi8( c ) ) ) ); };
+      block_masks m;
+      m.quote      = eq( '"' );
+      m.backslash  = eq( '\\' );
+      m.structural = eq( '{' ) | eq( '}' ) | eq( '[' ) | eq( ']' ) | eq( ':' ) | eq( ',' );
+      m.whitespace = eq( ' ' ) | eq( '\t' ) | eq( '\n' ) | eq( '\r' );
+      // the compare is signed, non ASCII bytes are below 0x20 as well
+      const uint32_t non_ascii = uint32_t( _mm_movemask_epi8( in ) );
+      m.special    = non_ascii | uint32_t( _mm_movemask_epi8( _mm_cmplt_epi8( in, _mm_set1_epi8( 0x20 ) ) ) );
+      return m;
+   }
+#else
+   block_masks classify( const char* p ) {
+      block_masks m;
+      for( uint32_t i = 0; i < block_size; ++i ) {
+         const unsigned char c = p[i];
+         const uint32_t bit = 1u << i;
+         switch( c ) {
+            case '"':  m.quote |= bit; break;
+            case '\\': m.backslash |= bit; break;
+            case '{': case '}': case '[': case ']': case ':': case ',': m.structural |= bit; break;
+            case ' ': case '\t': case '\n': case '\r': m.whitespace |= bit; break;
+         }
+         if( c < 0x20 || c >= 0x80 ) m.special |= bit;
+      }
+      return m;
+   }
+#endif
+
+   /// bit i is the xor of bits 0..i, i.e. set from an opening quote up to but excluding its closing quote
+   uint32_t prefix_xor( uint32_t x ) {
+      x ^= x << 1;
+      x ^= x << 2;
+      x ^= x << 4;
+      x ^= x << 8;
+      return x & 0xffff;
+   }
+
+   /**
+    * Stage 1: the positions of the structural characters outside of strings and of the quotes delimiting strings,
+    * false if the input has characters the fast path does not handle inside or outside of strings
+    */
+   bool index_structurals( const std::string& json, std::vector<uint32_t>& index ) {
+      index.reserve( json.size() / 8 + 4 );
+      bool in_string = false;
+      bool escape_next = false; ///< the previous block ended in an odd run of backslashes
+      char padded[block_size];
+      for( size_t pos = 0; pos < json.size(); pos += block_size ) {
+         const char* p = json.data() + pos;
+         if( json.size() - pos < block_size ) {
+            memset( padded, ' ', block_size );
+            memcpy( padded, p, json.size() - pos );
+            p = padded;
+         }
+         block_masks m = classify( p );
+
+         if( m.backslash || escape_next ) {
+            // escapes are rare in requests, resolve them a byte at a time
+            uint32_t escaped = 0;
+            for( uint32_t i = 0; i < block_size; ++i ) {
+               if( escape_next ) {
+                  escaped |= 1u << i;
+                  escape_next = false;
+               } else if( m.backslash & ( 1u << i ) ) {
+                  escape_next = true;
+               }
+            }
+            m.quote &= ~escaped;
+         }
+
+         uint32_t inside = prefix_xor( m.quote );
+         if( in_string ) inside ^= 0xffff;
+         in_string = inside & 0x8000;
+
+         if( m.special & inside ) return false;
+         if( m.special & ~inside & ~m.whitespace ) return false;
+
+         for( uint32_t bits = ( m.structural & ~inside ) | m.quote; bits; bits &= bits - 1 ) {
+            index.push_back( uint32_t( pos ) + __builtin_ctz( bits ) );
+         }
+      }
+      return !in_string;
+   }
+
+   /// Stage 2: the variant built walking the index
+   class variant_builder {
+   public:
+      variant_builder( const std::string& json, const std::vector<uint32_t>& index ) : _json( json ), _index( index ) {}
+
+      bool parse( fc::variant& out ) {
+         uint32_t end = 0;
+         if( !parse_value( 0, 0, out, end ) ) return false;
+         return skip_whitespace( end ) == _json.size() && _next == _index.size();
+      }
+
+   private:
+      uint32_t skip_whitespace( uint32_t pos ) const {
+         while( pos < _json.size() ) {
+            const char c = _json[pos];
+            if( c != ' ' && c != '\t' && c != '\n' && c != '\r' ) break;
+            ++pos;
+         }
+         return pos;
+      }
+
+      /// the next structural is c, with nothing but whitespace from pos
+      bool expect( char c, uint32_t pos ) {
+         if( _next == _index.size() || skip_whitespace( pos ) != _index[_next] || _json[_index[_next]] != c ) return false;
+         ++_next;
+         return true;
+      }
+
+      bool peek( char c ) const {
+         return _next < _index.size() && _json[_index[_next]] == c;
+      }
+
+      bool parse_value( uint32_t pos, uint32_t depth, fc::variant& out, uint32_t& end ) {
+         pos = skip_whitespace( pos );
+         if( pos == _json.size() ) return false;
+         const char c = _json[pos];
+         if( c == '{' || c == '[' || c == '"' ) {
+            if( _next == _index.size() || _index[_next] != pos ) return false;
+            if( c == '"' ) {
+               std::string s;
+               if( !parse_string( s, end ) ) return false;
+               out = fc::variant( std::move( s ) );
+               return true;
+            }
+            if( depth == json_parser::max_fast_depth ) return false;
+            return c == '{' ? parse_object( depth + 1, out, end ) : parse_array( depth + 1, out, end );
+         }
+         return parse_scalar( pos, out, end );
+      }
+
+      bool parse_string( std::string& s, uint32_t& end ) {
+         // opening and closing quote are consecutive in the index, escaped quotes are not indexed
+         if( _next + 1 >= _index.size() || _json[_index[_next + 1]] != '"' ) return false;
+         const uint32_t begin = _index[_next] + 1;
+         end = _index[_next + 1];
+         _next += 2;
+         const char* first = _json.data() + begin;
+         const char* last = _json.data() + end;
+         if( !memchr( first, '\\', last - first ) ) {
+            s.assign( first, last );
+            end += 1;
+            return true;
+         }
+         s.reserve( last - first );
+         for( const char* p = first; p < last; ++p ) {
+            if( *p != '\\' ) {
+               s.push_back( *p );
+               continue;
+            }
+            switch( *++p ) {
+               case '"': case '\\': case '/': s.push_back( *p ); break;
+               case 'n': s.push_back( '\n' ); break;
+               case 'r': s.push_back( '\r' ); break;
+               case 't': s.push_back( '\t' ); break;
+               default: return false; // fc::json has its own take on the others
+            }
+         }
+         end += 1;
+         return true;
+      }
+
+      bool parse_object( uint32_t depth, fc::variant& out, uint32_t& end ) {
+         uint32_t pos = _index[_next++] + 1;
+         fc::mutable_variant_object obj;
+         if( peek( '}' ) ) {
+            if( !expect( '}', pos ) ) return false;
+         } else {
+            while( true ) {
+               std::string key;
+               if( !peek( '"' ) || skip_whitespace( pos ) != _index[_next] || !parse_string( key, pos ) ) return false;
+               if( !expect( ':', pos ) ) return false;
+               fc::variant value;
+               if( !parse_value( _index[_next - 1] + 1, depth, value, pos ) ) return false;
+               obj( std::move( key ), std::move( value ) );
+               if( peek( ',' ) ) {
+                  if( !expect( ',', pos ) ) return false;
+                  pos = _index[_next - 1] + 1;
+                  continue;
+               }
+               if( !expect( '}', pos ) ) return false;
+               break;
+            }
+         }
+         end = _index[_next - 1] + 1;
+         out = fc::variant( std::move( obj ) );
+         return true;
+      }
+
+      bool parse_array( uint32_t depth, fc::variant& out, uint32_t& end ) {
+         uint32_t pos = _index[_next++] + 1;
+         fc::variants arr;
+         if( peek( ']' ) && skip_whitespace( pos ) == _index[_next] ) {
+            ++_next;
+         } else {
+            while( true ) {
+               fc::variant value;
+               if( !parse_value( pos, depth, value, pos ) ) return false;
+               arr.push_back( std::move( value ) );
+               if( peek( ',' ) ) {
+                  if( !expect( ',', pos ) ) return false;
+                  pos = _index[_next - 1] + 1;
+                  continue;
+               }
+               if( !expect( ']', pos ) ) return false;
+               break;
+            }
+         }
+         end = _index[_next - 1] + 1;
+         out = fc::variant( std::move( arr ) );
+         return true;
+      }
+
+      /// integers of up to 18 digits, true, false and null; the caller checks what follows
+      bool parse_scalar( uint32_t pos, fc::variant& out, uint32_t& end ) {
+         const char* p = _json.data() + pos;
+         const size_t left = _json.size() - pos;
+         auto literal = [&]( const char* lit, size_t n ) { return left >= n && memcmp( p, lit, n ) == 0; };
+         if( literal( "true", 4 ) )  { out = fc::variant( true );  end = pos + 4; return true; }
+         if( literal( "false", 5 ) ) { out = fc::variant( false ); end = pos + 5; return true; }
+         if( literal( "null", 4 ) )  { out = fc::variant();        end = pos + 4; return true; }
+
+         const bool neg = *p == '-';
+         size_t i = neg ? 1 : 0;
+         uint64_t value = 0;
+         const size_t first_digit = i;
+         for( ; i < left && p[i] >= '0' && p[i] <= '9'; ++i ) {
+            if( i - first_digit == 18 ) return false;
+            value = value * 10 + uint64_t( p[i] - '0' );
+         }
+         if( i == first_digit ) return false;
+         // a fraction or trailing letters make fc::json produce a double or a string
+         if( i < left && ( p[i] == '.' || isalnum( static_cast<unsigned char>( p[i] ) ) ) ) return false;
+         out = neg ? fc::variant( -int64_t( value ) ) : fc::variant( value );
+         end = pos + i;
+         return true;
+      }
+
+      const std::string&           _json;
+      const std::vector<uint32_t>& _index;
+      size_t                       _next = 0;
+   };
+
+}
+
+fc::optional<fc::variant> json_parser::try_fast_parse( const std::string& json ) {
+   if( json.empty() || json.size() >= std::numeric_limits<uint32_t>::max() ) return {};
+   std::vector<uint32_t> index;
+   if( !index_structurals( json, index ) ) return {};
+   fc::variant result;
+   if( !variant_builder( json, index ).parse( result ) ) return {};
+   return result;
+}
+
+#else
+
+fc::optional<fc::variant> json_parser::try_fast_parse( const std::string& ) {
+   return {};
+}
+
+#endif
+
+fc::variant json_parser::from_string( const std::string& json ) {
+   if( auto result = try_fast_parse( json ) )
+      return std::move( *result );
+   return fc::json::from_string( json );
+}
+
+} } // eosio::chain
@@ -1,6 +1,10 @@
 #include <eosio/chain/merkle.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <fc/io/raw.hpp>
 
+#include <openssl/sha.h>
+
 namespace eosio { namespace chain {
 
 /**
@@ -32,48 +36,144 @@ bool is_canonical_right(const digest_type& val) {
 }
 
 
-digest_type merkle(vector<digest_type> ids) {
-   if( 0 == ids.size() ) { return digest_type(); }
+digest_type hash_canonical_pair(const digest_type& l, const digest_type& r) {
+   // laid out as fc::raw::pack lays out the pair, OpenSSL picks SHA-NI or the ARMv8 crypto extensions at runtime
+   // on CPUs that have them
+   static_assert( sizeof(digest_type) == 32, "a canonical pair is packed as 64 bytes" );
+   const digest_type pair[2] = { make_canonical_left(l), make_canonical_right(r) };
+   digest_type result;
+   SHA256( reinterpret_cast<const unsigned char*>(pair), sizeof(pair), reinterpret_cast<unsigned char*>(result.data()) );
+   return result;
+}
+
+namespace {
+
+   // pairs hashed per thread_pool task, smaller levels are hashed on the calling thread
+   constexpr size_t merkle_pairs_per_task = 1024;
+   // digests of hash_many per thread_pool task, they usually cover more than the 64 bytes of a pair
+   constexpr size_t digests_per_task = 256;
+
+   /**
+    * calls f( begin, end ) for consecutive ranges of [0, count)
+    *
+    * with a thread_pool and at least two ranges of per_task the ranges are tasks, the calling thread takes the last one
+    */
+   template<typename F>
+   void for_ranges( size_t count, size_t per_task, boost::asio::io_context* thread_pool, F&& f ) {
+      if( !thread_pool || count < 2 * per_task ) {
+         f( 0, count );
+         return;
+      }
+
+      vector<std::future<void>> tasks;
+      tasks.reserve( count / per_task );
+      size_t begin = 0;
+      for( ; begin + 2 * per_task <= count; begin += per_task ) {
+         tasks.emplace_back( async_thread_pool( *thread_pool, [&f, begin, per_task]() {
+            f( begin, begin + per_task );
+         } ) );
+      }
+      f( begin, count );
+      for( auto& t : tasks )
+         t.get();
+   }
+
+   /// hashes the pairs of an even sized level into next, which must not overlap level
+   void hash_level( const digest_type* level, size_t pairs, digest_type* next, boost::asio::io_context* thread_pool ) {
+      for_ranges( pairs, merkle_pairs_per_task, thread_pool, [level, next]( size_t begin, size_t end ) {
+         for( size_t i = begin; i < end; ++i ) {
+            next[i] = hash_canonical_pair( level[2 * i], level[(2 * i) + 1] );
+         }
+      } );
+   }
+
+   digest_type merkle_root( vector<digest_type>&& ids, boost::asio::io_context* thread_pool ) {
+      if( 0 == ids.size() ) { return digest_type(); }
 
-   while( ids.size() > 1 ) {
-      if( ids.size() % 2 )
-         ids.push_back(ids.back());
+      vector<digest_type> next;
+      next.reserve( ids.size() / 2 + 1 );
+      while( ids.size() > 1 ) {
+         if( ids.size() % 2 )
+            ids.push_back(ids.back());
 
-      for (size_t i = 0; i < ids.size() / 2; i++) {
-         ids[i] = digest_type::hash(make_canonical_pair(ids[2 * i], ids[(2 * i) + 1]));
+         next.resize( ids.size() / 2 );
+         hash_level( ids.data(), next.size(), next.data(), thread_pool );
+         ids.swap( next );
       }
 
-      ids.resize(ids.size() / 2);
+      return ids.front();
    }
 
-   return ids.front();
 }
 
-vector<digest_type> get_proof(int position, vector<digest_type> ids) {
-   vector<digest_type> paths;
+vector<digest_type> hash_many( size_t count, const std::function<digest_type(size_t)>& digest_of,
+                               boost::asio::io_context* thread_pool ) {
+   vector<digest_type> result( count );
+   for_ranges( count, digests_per_task, thread_pool, [&result, &digest_of]( size_t begin, size_t end ) {
+      for( size_t i = begin; i < end; ++i ) {
+         result[i] = digest_of( i );
+      }
+   } );
+   return result;
+}
+
+digest_type merkle(vector<digest_type> ids) {
+   return merkle_root( std::move(ids), nullptr );
+}
 
+digest_type merkle(vector<digest_type> ids, boost::asio::io_context& thread_pool) {
+   return merkle_root( std::move(ids), &thread_pool );
+}
+
+vector<digest_type> get_proof(int position, vector<digest_type> ids) {
    if (ids.empty())  {
       return vector<digest_type>();
    }
 
-   while (ids.size() > 1) {
-      if(ids.size() % 2) {
-         ids.push_back(ids.back());
-      }
+   return merkle_tree( std::move(ids) ).proof( position );
+}
 
+merkle_tree::merkle_tree( vector<digest_type> leaves, boost::asio::io_context* thread_pool )
+:_leaf_count( leaves.size() )
+{
+   if( leaves.empty() ) return;
+
+   // every level but the root is stored with an even number of nodes
+   size_t total = 0;
+   for( size_t size = leaves.size(); size > 1; size = (size + 1) / 2 ) {
+      _level_offsets.push_back( total );
+      total += size + size % 2;
+   }
+   _level_offsets.push_back( total );
+
+   _nodes = std::move( leaves );
+   _nodes.resize( total + 1 );
+   for( size_t k = 0, size = _leaf_count; k + 1 < _level_offsets.size(); ++k, size = (size + 1) / 2 ) {
+      digest_type* level = _nodes.data() + _level_offsets[k];
+      if( size % 2 )
+         level[size] = level[size - 1];
+      hash_level( level, (size + 1) / 2, _nodes.data() + _level_offsets[k + 1], thread_pool );
+   }
+}
+
+digest_type merkle_tree::root()const {
+   return _nodes.empty() ? digest_type() : _nodes.back();
+}
+
+vector<digest_type> merkle_tree::proof( size_t position )const {
+   EOS_ASSERT( position < _leaf_count, misc_exception, "leaf ${p} is not part of the tree", ("p", position) );
+
+   vector<digest_type> paths;
+   paths.reserve( _level_offsets.size() - 1 );
+   for( size_t k = 0; k + 1 < _level_offsets.size(); ++k ) {
+      const digest_type* level = _nodes.data() + _level_offsets[k];
       // if right node
-      if (position % 2) {
-         paths.push_back(make_canonical_left(ids[position - 1]));
+      if( position % 2 ) {
+         paths.push_back(make_canonical_left(level[position - 1]));
       } else {
-         paths.push_back(make_canonical_right(ids[position + 1]));
+         paths.push_back(make_canonical_right(level[position + 1]));
       }
       position /= 2;
-
-      for (size_t i = 0; i < ids.size() / 2; i++) {
-         ids[i] = digest_type::hash(make_canonical_pair(ids[2 * i], ids[(2 * i) + 1]));
-      }
-
-      ids.resize(ids.size() / 2);
    }
 
    return paths;
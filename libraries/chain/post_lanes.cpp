@@ -0,0 +1,127 @@
+#include <eosio/chain/post_lanes.hpp>
+
+#include <algorithm>
+#include <memory>
+
+namespace eosio { namespace chain {
+
+post_lanes& post_lanes::instance() {
+   static post_lanes l;
+   return l;
+}
+
+void post_lanes::set_post_function( post_function post ) {
+   std::lock_guard<std::mutex> g( _mtx );
+   _post = std::move( post );
+}
+
+size_t post_lanes::add_lane( const lane_config& config ) {
+   std::lock_guard<std::mutex> g( _mtx );
+   for( size_t i = 0; i < _lanes.size(); ++i ) {
+      if( _lanes[i].config.name == config.name ) {
+         _lanes[i].config = config;
+         return i;
+      }
+   }
+   _lanes.emplace_back();
+   _lanes.back().config = config;
+   _lanes.back().stats.name = config.name;
+   return _lanes.size() - 1;
+}
+
+bool post_lanes::post( size_t lane, task t ) {
+   std::vector<size_t> slots;
+   {
+      std::lock_guard<std::mutex> g( _mtx );
+      auto& l = _lanes.at( lane );
+      if( l.tasks.size() >= l.config.capacity ) {
+         ++l.stats.rejected;
+         return false;
+      }
+      l.tasks.push_back( { std::move( t ), std::chrono::steady_clock::now() } );
+      l.stats.max_depth = std::max<uint64_t>( l.stats.max_depth, l.tasks.size() );
+      slots = hand_over();
+   }
+   post_slots( slots );
+   return true;
+}
+
+void post_lanes::clear( size_t lane ) {
+   std::deque<queued_task> dropped;
+   std::lock_guard<std::mutex> g( _mtx );
+   auto& l = _lanes.at( lane );
+   dropped.swap( l.tasks );
+   l.handed_over = 0;
+}
+
+std::vector<post_lanes::lane_stats> post_lanes::get_stats() const {
+   std::lock_guard<std::mutex> g( _mtx );
+   std::vector<lane_stats> result;
+   result.reserve( _lanes.size() );
+   for( const auto& l : _lanes ) {
+      result.push_back( l.stats );
+      result.back().depth = l.tasks.size();
+   }
+   return result;
+}
+
+std::vector<size_t> post_lanes::hand_over() {
+   std::vector<size_t> slots;
+   if( !_post || _lanes.empty() ) return slots;
+   while( _in_queue < _window ) {
+      // a lane keeps the turn while it has credit and queued tasks, then the next lane with queued tasks gets it
+      size_t tries = 0;
+      for( ; tries <= _lanes.size(); ++tries ) {
+         const auto& l = _lanes[_cursor];
+         if( _credit > 0 && l.tasks.size() > l.handed_over ) break;
+         _cursor = ( _cursor + 1 ) % _lanes.size();
+         _credit = std::max<uint32_t>( _lanes[_cursor].config.weight, 1 );
+      }
+      if( tries > _lanes.size() ) break;
+      --_credit;
+      ++_lanes[_cursor].handed_over;
+      ++_in_queue;
+      slots.push_back( _cursor );
+   }
+   return slots;
+}
+
+void post_lanes::post_slots( const std::vector<size_t>& lanes ) {
+   if( lanes.empty() ) return;
+   post_function post;
+   std::vector<int> priorities;
+   {
+      std::lock_guard<std::mutex> g( _mtx );
+      post = _post;
+      for( auto lane : lanes ) priorities.push_back( _lanes[lane].config.priority );
+   }
+   for( size_t i = 0; i < lanes.size(); ++i ) {
+      post( priorities[i], [this, lane = lanes[i]]() { run_slot( lane ); } );
+   }
+}
+
+void post_lanes::run_slot( size_t lane ) {
+   std::vector<size_t> slots;
+   std::unique_ptr<queued_task> next;
+   {
+      std::lock_guard<std::mutex> g( _mtx );
+      --_in_queue;
+      auto& l = _lanes[lane];
+      if( l.handed_over > 0 ) --l.handed_over;
+      // a cleared lane leaves its slots in the application queue, they find nothing to run
+      if( !l.tasks.empty() ) {
+         next = std::make_unique<queued_task>( std::move( l.tasks.front() ) );
+         l.tasks.pop_front();
+         const auto wait_us = std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - next->queued ).count();
+         ++l.stats.executed;
+         l.stats.total_wait_us += wait_us;
+         l.stats.max_wait_us = std::max<int64_t>( l.stats.max_wait_us, wait_us );
+      }
+      slots = hand_over();
+   }
+   post_slots( slots );
+   if( next ) next->t();
+}
+
+} } // eosio::chain
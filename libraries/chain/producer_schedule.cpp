@@ -1,5 +1,9 @@
 #include <eosio/chain/producer_schedule.hpp>
 
+#include <algorithm>
+#include <map>
+#include <mutex>
+
 namespace eosio { namespace chain {
 
 fc::variant producer_authority::get_abi_variant() const {
@@ -20,4 +24,60 @@ fc::variant producer_authority::get_abi_variant() const {
             ("authority", std::move(authority_variant));
 }
 
+namespace {
+
+   // keyed by the digest of the schedule, entries of schedules no block state holds anymore are erased on the
+   // next intern
+   struct schedule_interner {
+      std::mutex                                                                 mtx;
+      std::multimap<digest_type, std::weak_ptr<const producer_authority_schedule>> schedules;
+   };
+
+   schedule_interner& interner() {
+      static schedule_interner i;
+      return i;
+   }
+
+   std::shared_ptr<const producer_authority_schedule> intern( producer_authority_schedule&& s ) {
+      const auto digest = digest_type::hash( s );
+      auto& i = interner();
+      std::lock_guard<std::mutex> g( i.mtx );
+      for( auto itr = i.schedules.begin(); itr != i.schedules.end(); ) {
+         if( itr->second.expired() ) itr = i.schedules.erase( itr );
+         else ++itr;
+      }
+      auto range = i.schedules.equal_range( digest );
+      for( auto itr = range.first; itr != range.second; ++itr ) {
+         auto existing = itr->second.lock();
+         if( existing && *existing == s ) return existing;
+      }
+      auto result = std::make_shared<const producer_authority_schedule>( std::move( s ) );
+      i.schedules.emplace( digest, result );
+      return result;
+   }
+
+}
+
+producer_authority_schedule_ptr::producer_authority_schedule_ptr()
+:_schedule( [](){
+   // shared by all default constructed instances, never erased from the interner
+   static const auto empty = intern( producer_authority_schedule() );
+   return empty;
+}() )
+{}
+
+producer_authority_schedule_ptr::producer_authority_schedule_ptr( const producer_authority_schedule& s )
+:_schedule( intern( producer_authority_schedule( s ) ) )
+{}
+
+producer_authority_schedule_ptr::producer_authority_schedule_ptr( producer_authority_schedule&& s )
+:_schedule( intern( std::move( s ) ) )
+{}
+
+size_t producer_authority_schedule_ptr::interned_count() {
+   auto& i = interner();
+   std::lock_guard<std::mutex> g( i.mtx );
+   return std::count_if( i.schedules.begin(), i.schedules.end(), []( const auto& s ) { return !s.second.expired(); } );
+}
+
 } } /// eosio::chain
\ No newline at end of file
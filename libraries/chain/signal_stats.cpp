@@ -0,0 +1,66 @@
+#include <eosio/chain/signal_stats.hpp>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+namespace {
+
+   // keyed by the literal pointers, equal names from different translation units are merged by get()
+   struct stats_registry {
+      std::mutex                                                              mtx;
+      std::map<std::pair<const char*, const char*>, signal_stats::histogram> slots;
+   };
+
+   stats_registry& registry() {
+      static stats_registry r;
+      return r;
+   }
+
+   void add( signal_stats::histogram& to, const signal_stats::histogram& from ) {
+      if( to.buckets.size() < from.buckets.size() ) to.buckets.resize( from.buckets.size() );
+      for( size_t i = 0; i < from.buckets.size(); ++i ) to.buckets[i] += from.buckets[i];
+      to.calls += from.calls;
+      to.total_us += from.total_us;
+      to.max_us = std::max( to.max_us, from.max_us );
+   }
+
+}
+
+const std::vector<int64_t>& signal_stats::bucket_upper_bounds_us() {
+   static const std::vector<int64_t> bounds{ 10, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 50000 };
+   return bounds;
+}
+
+void signal_stats::record( const char* signal, const char* slot, int64_t elapsed_us ) {
+   const auto& bounds = bucket_upper_bounds_us();
+   auto& r = registry();
+   std::lock_guard<std::mutex> g( r.mtx );
+   auto& h = r.slots[{ signal, slot }];
+   if( h.buckets.empty() ) h.buckets.resize( bounds.size() + 1 );
+   ++h.buckets[std::lower_bound( bounds.begin(), bounds.end(), elapsed_us ) - bounds.begin()];
+   ++h.calls;
+   h.total_us += elapsed_us;
+   h.max_us = std::max( h.max_us, elapsed_us );
+}
+
+std::vector<signal_stats::slot_stats> signal_stats::get() {
+   std::map<std::pair<std::string, std::string>, histogram> merged;
+   {
+      auto& r = registry();
+      std::lock_guard<std::mutex> g( r.mtx );
+      for( const auto& s : r.slots ) {
+         add( merged[{ s.first.first, s.first.second }], s.second );
+      }
+   }
+   std::vector<slot_stats> result;
+   result.reserve( merged.size() );
+   for( auto& m : merged ) {
+      result.push_back( { m.first.first, m.first.second, std::move( m.second ) } );
+   }
+   return result;
+}
+
+} } // eosio::chain
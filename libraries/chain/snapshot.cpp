@@ -1,6 +1,11 @@
 #include <eosio/chain/snapshot.hpp>
+#include <eosio/chain/block_state.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <fc/scoped_exit.hpp>
+#include <algorithm>
+#include <sstream>
+#include <string_view>
 
 namespace eosio { namespace chain {
 
@@ -190,6 +195,77 @@ void ostream_snapshot_writer::finalize() {
    snapshot.write((char*)&end_marker, sizeof(end_marker));
 }
 
+void ostream_snapshot_writer::write_serialized_section( const std::string& section_name, const std::string& rows, uint64_t rows_in_section ) {
+   write_start_section(section_name);
+   snapshot.write(rows.data(), rows.size());
+   row_count = rows_in_section;
+   write_end_section();
+}
+
+namespace {
+   /// collects the binary rows of a single section in memory
+   class section_buffer_writer : public snapshot_writer {
+      public:
+         explicit section_buffer_writer(std::ostream& out)
+         :out(out)
+         {}
+
+         void write_start_section( const std::string& ) override {}
+
+         void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override {
+            row_writer.write(out);
+            row_count++;
+         }
+
+         void write_end_section() override {}
+
+         detail::ostream_wrapper out;
+         uint64_t                row_count = 0;
+   };
+}
+
+threaded_ostream_snapshot_writer::threaded_ostream_snapshot_writer(std::ostream& snapshot, size_t num_threads)
+:ostream_snapshot_writer(snapshot)
+,thread_pool(std::make_unique<named_thread_pool>("snap", std::max<size_t>(num_threads, 1)))
+,max_pending(std::max<size_t>(num_threads, 1))
+{
+}
+
+threaded_ostream_snapshot_writer::~threaded_ostream_snapshot_writer() {
+   // section functions reference the caller's state, never leave one running
+   for( auto& p : pending ) {
+      if( p.result.valid() ) p.result.wait();
+   }
+}
+
+void threaded_ostream_snapshot_writer::write_section_rows( const std::string& section_name, section_rows_func f ) {
+   if( pending.size() >= max_pending )
+      write_pending_section();
+
+   auto result = async_thread_pool( thread_pool->get_executor(), [f{std::move(f)}]() mutable {
+      std::ostringstream out;
+      section_buffer_writer writer(out);
+      auto section = make_section_writer(writer);
+      f(section);
+      return serialized_section{ out.str(), writer.row_count };
+   });
+   pending.emplace_back( pending_section{ section_name, std::move(result) } );
+}
+
+void threaded_ostream_snapshot_writer::write_pending_section() {
+   auto& front = pending.front();
+   auto section = front.result.get();
+   auto name = std::move(front.name);
+   pending.pop_front();
+   write_serialized_section( name, section.rows, section.row_count );
+}
+
+void threaded_ostream_snapshot_writer::finalize() {
+   while( !pending.empty() )
+      write_pending_section();
+   ostream_snapshot_writer::finalize();
+}
+
 istream_snapshot_reader::istream_snapshot_reader(std::istream& snapshot)
 :snapshot(snapshot)
 ,header_pos(snapshot.tellg())
@@ -368,4 +444,548 @@ void integrity_hash_snapshot_writer::finalize() {
    // no-op for structural details
 }
 
+namespace {
+   // a chunk ends with the row reaching this many packed bytes
+   constexpr size_t integrity_hash_chunk_size = 1024 * 1024;
+   // bytes waiting for the thread pool, more chunks are hashed by the thread packing them
+   constexpr size_t integrity_hash_max_queued_bytes = 64 * 1024 * 1024;
+
+   /// packs the rows of a single section into chunks handed to the tree_integrity_hash_snapshot_writer
+   class chunk_hash_writer : public snapshot_writer {
+      public:
+         explicit chunk_hash_writer(tree_integrity_hash_snapshot_writer& tree)
+         :tree(tree)
+         ,out(buffer)
+         {}
+
+         void write_start_section( const std::string& ) override {}
+
+         void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override {
+            row_writer.write(out);
+            row_count++;
+            if( static_cast<size_t>(buffer.tellp()) >= integrity_hash_chunk_size )
+               flush();
+         }
+
+         void write_end_section() override {}
+
+         void flush() {
+            if( buffer.tellp() == 0 ) return;
+            chunks.emplace_back( tree.hash_chunk( buffer.str() ) );
+            buffer.str( std::string() );
+         }
+
+         tree_integrity_hash_snapshot_writer&  tree;
+         std::ostringstream                    buffer;
+         detail::ostream_wrapper               out;
+         uint64_t                              row_count = 0;
+         std::vector<std::future<fc::sha256>>  chunks;
+   };
+}
+
+tree_integrity_hash_snapshot_writer::tree_integrity_hash_snapshot_writer(size_t num_threads)
+:thread_pool(std::make_unique<named_thread_pool>("hash", std::max<size_t>(num_threads, 1)))
+{
+}
+
+tree_integrity_hash_snapshot_writer::~tree_integrity_hash_snapshot_writer() {
+   // section tasks reference the caller's state and chunk tasks reference this, stopping joins the running ones
+   // and drops the queued ones
+   thread_pool->stop();
+}
+
+std::future<fc::sha256> tree_integrity_hash_snapshot_writer::hash_chunk( std::string rows ) {
+   const size_t size = rows.size();
+   if( queued_bytes.fetch_add( size ) + size > integrity_hash_max_queued_bytes ) {
+      queued_bytes -= size;
+      std::promise<fc::sha256> hashed;
+      hashed.set_value( fc::sha256::hash( rows.data(), rows.size() ) );
+      return hashed.get_future();
+   }
+   return async_thread_pool( thread_pool->get_executor(), [this, rows{std::move(rows)}, size]() {
+      auto digest = fc::sha256::hash( rows.data(), rows.size() );
+      queued_bytes -= size;
+      return digest;
+   });
+}
+
+void tree_integrity_hash_snapshot_writer::write_section_rows( const std::string& section_name, section_rows_func f ) {
+   // section tasks never wait for chunk tasks, so all sections can be queued at once
+   auto result = async_thread_pool( thread_pool->get_executor(), [this, f{std::move(f)}]() mutable {
+      chunk_hash_writer writer(*this);
+      auto section = make_section_writer(writer);
+      f(section);
+      writer.flush();
+      return section_hashes{ writer.row_count, std::move(writer.chunks) };
+   });
+   pending.emplace_back( pending_section{ section_name, std::move(result) } );
+}
+
+fc::sha256 tree_integrity_hash_snapshot_writer::finalize() {
+   fc::sha256::encoder enc;
+   fc::raw::pack( enc, version );
+   while( !pending.empty() ) {
+      auto section = pending.front().result.get();
+      std::vector<fc::sha256> chunk_digests;
+      chunk_digests.reserve( section.chunks.size() );
+      for( auto& c : section.chunks )
+         chunk_digests.emplace_back( c.get() );
+
+      fc::sha256::encoder section_enc;
+      fc::raw::pack( section_enc, pending.front().name );
+      fc::raw::pack( section_enc, section.row_count );
+      fc::raw::pack( section_enc, chunk_digests );
+      fc::raw::pack( enc, section_enc.result() );
+      pending.pop_front();
+   }
+   return enc.result();
+}
+
+namespace {
+   /// size of the header of a row index, magic number, version and block id
+   constexpr std::streamoff row_index_header_size = sizeof(uint32_t) + sizeof(uint32_t) + sizeof(block_id_type);
+   /// size of the header of a diff snapshot, magic number, version, base block id and block id
+   constexpr std::streamoff diff_header_size = sizeof(uint32_t) + sizeof(uint32_t) + 2 * sizeof(block_id_type);
+   /// stored rows are flushed as a run once they reach this many bytes
+   constexpr size_t diff_max_stored_run_size = 1024 * 1024;
+
+   /**
+    * finds a section in the section layout shared by binary snapshots, row indexes and diff snapshots, leaving the
+    * stream after the section name when found
+    */
+   bool find_section( std::istream& in, std::streampos first_section_pos, const std::string& section_name,
+                      uint64_t& row_count, std::streampos& section_end ) {
+      auto next_section_pos = first_section_pos;
+
+      while (true) {
+         in.seekg(next_section_pos);
+         uint64_t section_size = 0;
+         in.read((char*)&section_size,sizeof(section_size));
+         if (section_size == std::numeric_limits<uint64_t>::max()) {
+            return false;
+         }
+
+         next_section_pos = in.tellg() + std::streamoff(section_size);
+
+         in.read((char*)&row_count,sizeof(row_count));
+
+         bool match = true;
+         for(auto c : section_name) {
+            if(in.get() != c) {
+               match = false;
+               break;
+            }
+         }
+
+         if (match && in.get() == 0) {
+            section_end = next_section_pos;
+            return true;
+         }
+      }
+   }
+
+   void write_section_placeholders( detail::ostream_wrapper& out, const std::string& section_name ) {
+      uint64_t placeholder = std::numeric_limits<uint64_t>::max();
+
+      // section size and row count
+      out.write((char*)&placeholder, sizeof(placeholder));
+      out.write((char*)&placeholder, sizeof(placeholder));
+
+      out.write(section_name.data(), section_name.size());
+      out.put(0);
+   }
+
+   void write_section_size( detail::ostream_wrapper& out, std::streampos section_pos, uint64_t row_count ) {
+      auto restore = out.tellp();
+
+      uint64_t section_size = restore - section_pos - sizeof(uint64_t);
+
+      out.seekp(section_pos);
+      out.write((char*)&section_size, sizeof(section_size));
+      out.write((char*)&row_count, sizeof(row_count));
+      out.seekp(restore);
+   }
+
+   void write_end_marker( detail::ostream_wrapper& out ) {
+      uint64_t end_marker = std::numeric_limits<uint64_t>::max();
+      out.write((char*)&end_marker, sizeof(end_marker));
+   }
+
+   template<typename T>
+   void write_value( detail::ostream_wrapper& out, const T& value ) {
+      out.write((const char*)&value, sizeof(value));
+   }
+
+   template<typename T>
+   T read_value( std::istream& in ) {
+      T value{};
+      in.read((char*)&value, sizeof(value));
+      return value;
+   }
+
+   void check_header( std::istream& in, uint32_t expected_totem, uint32_t expected_version, const char* what ) {
+      auto actual_totem = read_value<uint32_t>(in);
+      EOS_ASSERT(actual_totem == expected_totem, snapshot_exception,
+                 "${what} has unexpected magic number!", ("what", what));
+
+      auto actual_version = read_value<uint32_t>(in);
+      EOS_ASSERT(actual_version == expected_version, snapshot_exception,
+                 "${what} is an unsuppored version.  Expected : ${expected}, Got: ${actual}",
+                 ("what", what)("expected", expected_version)("actual", actual_version));
+   }
+
+   uint64_t row_hash( std::string_view packed ) {
+      return std::hash<std::string_view>()(packed);
+   }
+}
+
+snapshot_row_index_writer::snapshot_row_index_writer(std::ostream& index, const block_id_type& block_id)
+:index(index)
+,section_pos(-1)
+,row_count(0)
+{
+   write_value(this->index, magic_number);
+   write_value(this->index, version);
+   fc::raw::pack(this->index, block_id);
+}
+
+void snapshot_row_index_writer::write_start_section( const std::string& section_name ) {
+   EOS_ASSERT(section_pos == std::streampos(-1), snapshot_exception, "Attempting to write a new section without closing the previous section");
+   section_pos = index.tellp();
+   row_count = 0;
+   write_section_placeholders(index, section_name);
+}
+
+void snapshot_row_index_writer::write_row( const detail::abstract_snapshot_row_writer& row_writer ) {
+   row_buffer.str(std::string());
+   detail::ostream_wrapper out(row_buffer);
+   row_writer.write(out);
+   write_row_size(row_buffer.tellp());
+}
+
+void snapshot_row_index_writer::write_row_size( uint64_t size ) {
+   fc::raw::pack(index, fc::unsigned_int(static_cast<uint32_t>(size)));
+   row_count++;
+}
+
+void snapshot_row_index_writer::write_end_section( ) {
+   write_section_size(index, section_pos, row_count);
+   section_pos = std::streampos(-1);
+   row_count = 0;
+}
+
+void snapshot_row_index_writer::finalize() {
+   write_end_marker(index);
+}
+
+indexed_ostream_snapshot_writer::indexed_ostream_snapshot_writer(std::ostream& snapshot, std::ostream& index, const block_id_type& block_id)
+:ostream_snapshot_writer(snapshot)
+,out(snapshot)
+,index(index, block_id)
+{
+}
+
+void indexed_ostream_snapshot_writer::write_start_section( const std::string& section_name ) {
+   ostream_snapshot_writer::write_start_section(section_name);
+   index.write_start_section(section_name);
+}
+
+void indexed_ostream_snapshot_writer::write_row( const detail::abstract_snapshot_row_writer& row_writer ) {
+   const auto start = out.tellp();
+   ostream_snapshot_writer::write_row(row_writer);
+   index.write_row_size(out.tellp() - start);
+}
+
+void indexed_ostream_snapshot_writer::write_end_section( ) {
+   ostream_snapshot_writer::write_end_section();
+   index.write_end_section();
+}
+
+void indexed_ostream_snapshot_writer::finalize() {
+   ostream_snapshot_writer::finalize();
+   index.finalize();
+}
+
+block_id_type snapshot_row_index_writer::read_block_id( std::istream& index ) {
+   check_header(index, magic_number, version, "Snapshot row index");
+   block_id_type block_id;
+   fc::raw::unpack(index, block_id);
+   return block_id;
+}
+
+diff_ostream_snapshot_writer::diff_ostream_snapshot_writer(std::ostream& diff, std::istream& base, std::istream& base_row_index, const block_id_type& block_id)
+:diff(diff)
+,base(base)
+,base_row_index(base_row_index)
+,base_header_pos(base.tellg())
+,base_index_pos(base_row_index.tellg())
+,section_pos(-1)
+,row_count(0)
+{
+   check_header(base, ostream_snapshot_writer::magic_number, current_snapshot_version, "Base snapshot");
+   check_header(base_row_index, snapshot_row_index_writer::magic_number, snapshot_row_index_writer::version, "Base snapshot row index");
+   fc::raw::unpack(base_row_index, base_id);
+
+   write_value(this->diff, magic_number);
+   write_value(this->diff, version);
+   fc::raw::pack(this->diff, base_id);
+   fc::raw::pack(this->diff, block_id);
+}
+
+void diff_ostream_snapshot_writer::load_base_section( const std::string& section_name ) {
+   base_offsets.clear();
+   base_rows.clear();
+
+   uint64_t index_rows = 0;
+   std::streampos index_end;
+   if (!find_section(base_row_index, base_index_pos + row_index_header_size, section_name, index_rows, index_end)) {
+      return;
+   }
+
+   uint64_t base_section_rows = 0;
+   std::streampos base_end;
+   EOS_ASSERT(find_section(base, base_header_pos + std::streamoff(2 * sizeof(uint32_t)), section_name, base_section_rows, base_end),
+              snapshot_exception, "Base snapshot has no section named ${n} but its row index has", ("n", section_name));
+   EOS_ASSERT(base_section_rows == index_rows, snapshot_exception,
+              "Row index of section ${n} does not match the base snapshot", ("n", section_name));
+
+   base_offsets.reserve(index_rows + 1);
+   base_offsets.push_back(base.tellg());
+   for (uint64_t i = 0; i < index_rows; ++i) {
+      fc::unsigned_int size;
+      fc::raw::unpack(base_row_index, size);
+      base_offsets.push_back(base_offsets.back() + size.value);
+   }
+   EOS_ASSERT(base_offsets.back() == static_cast<uint64_t>(base_end), snapshot_exception,
+              "Row index of section ${n} does not match the base snapshot", ("n", section_name));
+
+   // the rows are hashed in one pass over the base section
+   base_rows.reserve(index_rows);
+   for (uint64_t i = 0; i < index_rows; ++i) {
+      base_buffer.resize(base_offsets[i + 1] - base_offsets[i]);
+      base.read(base_buffer.data(), base_buffer.size());
+      base_rows.push_back(base_row{row_hash(base_buffer), i});
+   }
+   EOS_ASSERT(base.good(), snapshot_exception, "Unable to read section ${n} of the base snapshot", ("n", section_name));
+   std::sort(base_rows.begin(), base_rows.end());
+}
+
+bool diff_ostream_snapshot_writer::base_row_equals( uint64_t row, const std::string& packed ) {
+   if (base_offsets[row + 1] - base_offsets[row] != packed.size()) {
+      return false;
+   }
+   base.seekg(base_offsets[row]);
+   base_buffer.resize(packed.size());
+   base.read(base_buffer.data(), base_buffer.size());
+   return base.good() && base_buffer == packed;
+}
+
+void diff_ostream_snapshot_writer::start_copy( uint64_t row ) {
+   flush_run();
+   copy_start = row;
+   copy_rows = 1;
+}
+
+void diff_ostream_snapshot_writer::flush_run() {
+   if (copy_rows > 0) {
+      write_value(diff, copied_rows);
+      write_value(diff, base_offsets[copy_start] - static_cast<uint64_t>(base_header_pos));
+      write_value(diff, base_offsets[copy_start + copy_rows] - base_offsets[copy_start]);
+      write_value(diff, copy_rows);
+      copy_rows = 0;
+   }
+   if (stored_rows_count > 0) {
+      write_value(diff, stored_rows);
+      write_value(diff, stored_rows_count);
+      diff.write(stored.data(), stored.size());
+      stored.clear();
+      stored_rows_count = 0;
+   }
+}
+
+void diff_ostream_snapshot_writer::write_start_section( const std::string& section_name ) {
+   EOS_ASSERT(section_pos == std::streampos(-1), snapshot_exception, "Attempting to write a new section without closing the previous section");
+   section_pos = diff.tellp();
+   row_count = 0;
+   write_section_placeholders(diff, section_name);
+   load_base_section(section_name);
+}
+
+void diff_ostream_snapshot_writer::write_row( const detail::abstract_snapshot_row_writer& row_writer ) {
+   row_buffer.str(std::string());
+   detail::ostream_wrapper out(row_buffer);
+   row_writer.write(out);
+   const std::string packed = row_buffer.str();
+   const auto hash = row_hash(packed);
+
+   // the row following the copied ones is the likely match, then any base row of the same hash
+   if (copy_rows > 0) {
+      const uint64_t next = copy_start + copy_rows;
+      if (std::binary_search(base_rows.begin(), base_rows.end(), base_row{hash, next}) && base_row_equals(next, packed)) {
+         ++copy_rows;
+         ++row_count;
+         return;
+      }
+   }
+
+   bool copied = false;
+   for (auto itr = std::lower_bound(base_rows.begin(), base_rows.end(), base_row{hash, 0});
+        itr != base_rows.end() && itr->hash == hash; ++itr) {
+      if (base_row_equals(itr->row, packed)) {
+         start_copy(itr->row);
+         copied = true;
+         break;
+      }
+   }
+
+   if (!copied) {
+      if (copy_rows > 0 || stored.size() >= diff_max_stored_run_size) {
+         flush_run();
+      }
+      stored += packed;
+      ++stored_rows_count;
+   }
+   ++row_count;
+}
+
+void diff_ostream_snapshot_writer::write_end_section( ) {
+   flush_run();
+   write_section_size(diff, section_pos, row_count);
+
+   section_pos = std::streampos(-1);
+   row_count = 0;
+   base_offsets = std::vector<uint64_t>();
+   base_rows = std::vector<base_row>();
+}
+
+void diff_ostream_snapshot_writer::finalize() {
+   write_end_marker(diff);
+}
+
+diff_istream_snapshot_reader::diff_istream_snapshot_reader(std::istream& base, std::istream& diff)
+:base(base)
+,diff(diff)
+,base_header_pos(base.tellg())
+,header_pos(diff.tellg())
+,num_rows(0)
+,cur_row(0)
+,run_stream(nullptr)
+,run_rows(0)
+{
+}
+
+void diff_istream_snapshot_reader::validate() const {
+   // make sure to restore the read pos of both streams
+   auto restore_pos = fc::make_scoped_exit([this,pos=diff.tellg(),ex=diff.exceptions(),base_pos=base.tellg()](){
+      diff.seekg(pos);
+      diff.exceptions(ex);
+      base.clear();
+      base.seekg(base_pos);
+   });
+
+   block_id_type base_id;
+   try {
+      diff.exceptions(std::istream::failbit|std::istream::eofbit);
+      diff.seekg(header_pos);
+      check_header(diff, diff_ostream_snapshot_writer::magic_number, diff_ostream_snapshot_writer::version, "Diff snapshot");
+      fc::raw::unpack(diff, base_id);
+
+      diff.seekg(header_pos + diff_header_size);
+      while (true) {
+         auto section_size = read_value<uint64_t>(diff);
+         if (section_size == std::numeric_limits<uint64_t>::max()) {
+            break;
+         }
+         diff.seekg(diff.tellg() + std::streamoff(section_size));
+      }
+   } catch( const std::exception& e ) {
+      snapshot_exception fce(FC_LOG_MESSAGE( warn, "Diff snapshot validation threw IO exception (${what})",("what",e.what())));
+      throw fce;
+   }
+
+   base.seekg(base_header_pos);
+   istream_snapshot_reader base_reader(base);
+   base_reader.validate();
+
+   block_header_state head;
+   base_reader.read_section<block_state>([&head]( auto& section ) {
+      section.read_row(head);
+   });
+   EOS_ASSERT(head.id == base_id, snapshot_exception,
+              "Diff snapshot was written against the snapshot of block ${expected}, not of block ${actual}",
+              ("expected", base_id)("actual", head.id));
+}
+
+bool diff_istream_snapshot_reader::has_section( const string& section_name ) {
+   auto restore_pos = fc::make_scoped_exit([this,pos=diff.tellg()](){
+      diff.seekg(pos);
+   });
+
+   uint64_t row_count = 0;
+   std::streampos section_end;
+   return find_section(diff, header_pos + diff_header_size, section_name, row_count, section_end);
+}
+
+void diff_istream_snapshot_reader::set_section( const string& section_name ) {
+   auto restore_pos = fc::make_scoped_exit([this,pos=diff.tellg()](){
+      diff.seekg(pos);
+   });
+
+   uint64_t row_count = 0;
+   std::streampos section_end;
+   EOS_ASSERT(find_section(diff, header_pos + diff_header_size, section_name, row_count, section_end),
+              snapshot_exception, "Diff snapshot has no section named ${n}", ("n", section_name));
+
+   num_rows = row_count;
+   cur_row = 0;
+   run_stream = nullptr;
+   run_rows = 0;
+
+   // leave the stream at the right point
+   restore_pos.cancel();
+}
+
+bool diff_istream_snapshot_reader::read_row( detail::abstract_snapshot_row_reader& row_reader ) {
+   if (run_rows == 0) {
+      EOS_ASSERT(run_stream != &base || base.tellg() == run_end, snapshot_exception,
+                 "Rows copied from the base snapshot do not end where the diff snapshot says");
+
+      auto type = read_value<uint8_t>(diff);
+      if (type == diff_ostream_snapshot_writer::copied_rows) {
+         auto offset = read_value<uint64_t>(diff);
+         auto size = read_value<uint64_t>(diff);
+         run_rows = read_value<uint64_t>(diff);
+         base.seekg(base_header_pos + std::streamoff(offset));
+         run_end = base.tellg() + std::streamoff(size);
+         run_stream = &base;
+      } else {
+         EOS_ASSERT(type == diff_ostream_snapshot_writer::stored_rows, snapshot_exception,
+                    "Diff snapshot has a run of unknown type ${t}", ("t", type));
+         run_rows = read_value<uint64_t>(diff);
+         run_stream = &diff;
+      }
+      EOS_ASSERT(diff.good() && run_rows > 0, snapshot_exception, "Diff snapshot has an invalid run of rows");
+   }
+
+   row_reader.provide(*run_stream);
+   --run_rows;
+   return ++cur_row < num_rows;
+}
+
+bool diff_istream_snapshot_reader::empty ( ) {
+   return num_rows == 0;
+}
+
+void diff_istream_snapshot_reader::clear_section() {
+   num_rows = 0;
+   cur_row = 0;
+   run_stream = nullptr;
+   run_rows = 0;
+}
+
+void diff_istream_snapshot_reader::return_to_header() {
+   diff.seekg( header_pos );
+   clear_section();
+}
+
 }}
@@ -34,4 +34,23 @@ action_trace::action_trace(
 ,producer_block_id( trace.producer_block_id )
 {}
 
+action_trace::action_trace( action_trace&& other ) noexcept
+:action_ordinal( other.action_ordinal )
+,creator_action_ordinal( other.creator_action_ordinal )
+,closest_unnotified_ancestor_action_ordinal( other.closest_unnotified_ancestor_action_ordinal )
+,receipt( std::move(other.receipt) )
+,receiver( other.receiver )
+,act( std::move(other.act) )
+,context_free( other.context_free )
+,elapsed( other.elapsed )
+,console( std::move(other.console) )
+,trx_id( other.trx_id )
+,block_num( other.block_num )
+,block_time( other.block_time )
+,producer_block_id( std::move(other.producer_block_id) )
+,account_ram_deltas( std::move(other.account_ram_deltas) )
+,except( std::move(other.except) )
+,error_code( std::move(other.error_code) )
+{}
+
 } } // eosio::chain
@@ -0,0 +1,150 @@
+#include <eosio/chain/trace_spans.hpp>
+#include <fc/crypto/sha256.hpp>
+#include <fc/variant_object.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+namespace {
+
+   // written by its own thread only, the mutex is contended only while draining
+   struct span_ring {
+      explicit span_ring( uint32_t id ) : thread_id( id ), spans( span_tracer::ring_capacity ) {}
+
+      std::mutex              mtx;
+      const uint32_t          thread_id;
+      std::vector<trace_span> spans;
+      size_t                  next = 0;
+      size_t                  size = 0;
+   };
+
+   struct ring_registry {
+      std::mutex                              mtx;
+      std::vector<std::shared_ptr<span_ring>> rings;
+   };
+
+   ring_registry& registry() {
+      static ring_registry r;
+      return r;
+   }
+
+   span_ring& thread_ring() {
+      // the registry keeps the ring of an exited thread alive until its spans are drained
+      thread_local std::shared_ptr<span_ring> ring = []() {
+         auto& r = registry();
+         std::lock_guard<std::mutex> g( r.mtx );
+         r.rings.emplace_back( std::make_shared<span_ring>( r.rings.size() + 1 ) );
+         return r.rings.back();
+      }();
+      return *ring;
+   }
+
+   std::string to_hex64( uint64_t v ) {
+      static const char digits[] = "0123456789abcdef";
+      std::string s( 16, '0' );
+      for( int i = 15; i >= 0; --i, v >>= 4 ) s[i] = digits[v & 0xf];
+      return s;
+   }
+
+}
+
+std::atomic<bool> span_tracer::_enabled{false};
+
+void span_tracer::record( const trace_span& s ) {
+   auto& ring = thread_ring();
+   std::lock_guard<std::mutex> g( ring.mtx );
+   trace_span& slot = ring.spans[ring.next];
+   slot = s;
+   slot.thread_id = ring.thread_id;
+   ring.next = ( ring.next + 1 ) % ring.spans.size();
+   ring.size = std::min( ring.size + 1, ring.spans.size() );
+}
+
+std::vector<trace_span> span_tracer::drain() {
+   std::vector<std::shared_ptr<span_ring>> rings;
+   {
+      auto& r = registry();
+      std::lock_guard<std::mutex> g( r.mtx );
+      rings = r.rings;
+   }
+
+   std::vector<trace_span> result;
+   for( const auto& ring : rings ) {
+      std::lock_guard<std::mutex> g( ring->mtx );
+      const size_t cap = ring->spans.size();
+      for( size_t i = ( ring->next + cap - ring->size ) % cap, n = 0; n < ring->size; ++n, i = ( i + 1 ) % cap ) {
+         result.push_back( ring->spans[i] );
+      }
+      ring->size = 0;
+   }
+   std::sort( result.begin(), result.end(), []( const trace_span& a, const trace_span& b ) { return a.start_ns < b.start_ns; } );
+   return result;
+}
+
+fc::variant span_tracer::to_chrome_trace( const std::vector<trace_span>& spans ) {
+   fc::variants events;
+   events.reserve( spans.size() );
+   for( const auto& s : spans ) {
+      // complete events, timestamps in microseconds
+      events.emplace_back( fc::mutable_variant_object()
+            ( "name", s.name )
+            ( "cat", s.category )
+            ( "ph", "X" )
+            ( "ts", s.start_ns / 1000.0 )
+            ( "dur", s.duration_ns / 1000.0 )
+            ( "pid", 1 )
+            ( "tid", s.thread_id )
+            ( "args", fc::mutable_variant_object()( "block_num", s.block_num ) ) );
+   }
+   return fc::mutable_variant_object()
+         ( "traceEvents", std::move( events ) )
+         ( "displayTimeUnit", "ms" );
+}
+
+fc::variant span_tracer::to_otlp( const std::vector<trace_span>& spans ) {
+   // spans carry steady clock times, OTLP wants unix epoch nanoseconds
+   const uint64_t system_now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::system_clock::now().time_since_epoch() ).count();
+   const int64_t epoch_offset_ns = int64_t( system_now_ns ) - int64_t( now_ns() );
+
+   fc::variants otlp_spans;
+   otlp_spans.reserve( spans.size() );
+   uint64_t span_id = 0;
+   for( const auto& s : spans ) {
+      const auto trace_id = fc::sha256::hash( "block-" + std::to_string( s.block_num ) ).str().substr( 0, 32 );
+      const uint64_t start = s.start_ns + epoch_offset_ns;
+      fc::variants attributes{
+         fc::mutable_variant_object()( "key", "eosio.block_num" )( "value", fc::mutable_variant_object()( "intValue", std::to_string( s.block_num ) ) ),
+         fc::mutable_variant_object()( "key", "eosio.category" )( "value", fc::mutable_variant_object()( "stringValue", s.category ) ),
+         fc::mutable_variant_object()( "key", "thread.id" )( "value", fc::mutable_variant_object()( "intValue", std::to_string( s.thread_id ) ) )
+      };
+      otlp_spans.emplace_back( fc::mutable_variant_object()
+            ( "traceId", trace_id )
+            ( "spanId", to_hex64( ++span_id ) )
+            ( "name", s.name )
+            ( "kind", 1 ) // SPAN_KIND_INTERNAL
+            ( "startTimeUnixNano", std::to_string( start ) )
+            ( "endTimeUnixNano", std::to_string( start + s.duration_ns ) )
+            ( "attributes", std::move( attributes ) ) );
+   }
+
+   fc::variants resource_attributes{
+      fc::mutable_variant_object()( "key", "service.name" )( "value", fc::mutable_variant_object()( "stringValue", "nodeos" ) )
+   };
+   fc::variants scope_spans{
+      fc::mutable_variant_object()
+            ( "scope", fc::mutable_variant_object()( "name", "eosio.chain" ) )
+            ( "spans", std::move( otlp_spans ) )
+   };
+   fc::variants resource_spans{
+      fc::mutable_variant_object()
+            ( "resource", fc::mutable_variant_object()( "attributes", std::move( resource_attributes ) ) )
+            ( "scopeSpans", std::move( scope_spans ) )
+   };
+   return fc::mutable_variant_object()( "resourceSpans", std::move( resource_spans ) );
+}
+
+} } // eosio::chain
@@ -1,6 +1,7 @@
 #include <fc/io/raw.hpp>
 #include <fc/bitutil.hpp>
 #include <algorithm>
+#include <utility>
 
 #include <boost/range/adaptor/transformed.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
@@ -147,7 +148,34 @@ uint32_t packed_transaction::get_prunable_size()const {
    return static_cast<uint32_t>(size);
 }
 
+packed_transaction::packed_transaction(packed_transaction&& other)
+:signatures(std::move(other.signatures))
+,compression(other.compression)
+,packed_context_free_data(std::move(other.packed_context_free_data))
+,packed_trx(std::move(other.packed_trx))
+,unpacked_trx(std::move(other.unpacked_trx))
+,trx_id(other.trx_id)
+,digests(std::exchange(other.digests, std::make_shared<digest_cache>()))
+{
+}
+
+packed_transaction& packed_transaction::operator=(packed_transaction&& other) {
+   if( this != &other ) {
+      signatures = std::move(other.signatures);
+      compression = other.compression;
+      packed_context_free_data = std::move(other.packed_context_free_data);
+      packed_trx = std::move(other.packed_trx);
+      unpacked_trx = std::move(other.unpacked_trx);
+      trx_id = other.trx_id;
+      digests = std::exchange(other.digests, std::make_shared<digest_cache>());
+   }
+   return *this;
+}
+
 digest_type packed_transaction::packed_digest()const {
+   std::lock_guard<std::mutex> g( digests->mtx );
+   if( digests->packed_digest ) return *digests->packed_digest;
+
    digest_type::encoder prunable;
    fc::raw::pack( prunable, signatures );
    fc::raw::pack( prunable, packed_context_free_data );
@@ -157,7 +185,16 @@ digest_type packed_transaction::packed_digest()const {
    fc::raw::pack( enc, packed_trx  );
    fc::raw::pack( enc, prunable.result() );
 
-   return enc.result();
+   digests->packed_digest = enc.result();
+   return *digests->packed_digest;
+}
+
+digest_type packed_transaction::sig_digest( const chain_id_type& chain_id )const {
+   std::lock_guard<std::mutex> g( digests->mtx );
+   if( !digests->sig_digest || digests->sig_digest->first != chain_id ) {
+      digests->sig_digest.emplace( chain_id, unpacked_trx.sig_digest( chain_id, unpacked_trx.context_free_data ) );
+   }
+   return digests->sig_digest->second;
 }
 
 namespace bio = boost::iostreams;
@@ -314,6 +351,7 @@ void packed_transaction::reflector_init()
    EOS_ASSERT( unpacked_trx.expiration == time_point_sec(), tx_decompression_error, "packed_transaction already unpacked" );
    local_unpack_transaction({});
    local_unpack_context_free_data();
+   digests = std::make_shared<digest_cache>();
 }
 
 void packed_transaction::local_unpack_transaction(vector<bytes>&& context_free_data)
@@ -27,6 +27,7 @@ namespace eosio { namespace chain {
    }
 
    void transaction_checktime_timer::start(fc::time_point tp) {
+      _deadline = tp;
       _timer.start(tp);
    }
 
@@ -34,6 +35,11 @@ namespace eosio { namespace chain {
       _timer.stop();
    }
 
+   void transaction_checktime_timer::poll() {
+      if(!expired && fc::time_point::now() >= _deadline)
+         _timer.stop(); // disarms the timer before marking it expired, as if it had fired
+   }
+
    void transaction_checktime_timer::set_expiration_callback(void(*func)(void*), void* user) {
       _timer.set_expiration_callback(func, user);
    }
@@ -263,6 +269,9 @@ namespace eosio { namespace chain {
    void transaction_context::exec() {
       EOS_ASSERT( is_initialized, transaction_exception, "must first initialize" );
 
+      // room for the usual notifications of an action, e.g. the two of a token transfer, before action_traces grows
+      trace->action_traces.reserve( 3 * ( trx.context_free_actions.size() + trx.actions.size() ) );
+
       if( apply_context_free ) {
          for( const auto& act : trx.context_free_actions ) {
             schedule_action( act, act.account, true, 0, 0 );
@@ -298,6 +307,9 @@ namespace eosio { namespace chain {
          }
       }
 
+      apply_pending_row_updates();
+      apply_pending_ram_usage();
+
       auto& rl = control.get_mutable_resource_limits_manager();
       for( auto a : validate_ram_usage ) {
          rl.verify_account_ram_usage( a );
@@ -470,13 +482,37 @@ namespace eosio { namespace chain {
    }
 
    void transaction_context::add_ram_usage( account_name account, int64_t ram_delta ) {
-      auto& rl = control.get_mutable_resource_limits_manager();
-      rl.add_pending_ram_usage( account, ram_delta );
+      if( undo_session ) {
+         // the deltas are dropped together with the undo session if the transaction fails
+         pending_ram_usage[account] += ram_delta;
+      } else {
+         // without an undo session the changes of a failing transaction stay, so does their ram usage
+         control.get_mutable_resource_limits_manager().add_pending_ram_usage( account, ram_delta );
+      }
       if( ram_delta > 0 ) {
          validate_ram_usage.insert( account );
       }
    }
 
+   void transaction_context::apply_pending_ram_usage() {
+      auto& rl = control.get_mutable_resource_limits_manager();
+      for( const auto& d : pending_ram_usage ) {
+         rl.add_pending_ram_usage( d.first, d.second );
+      }
+      pending_ram_usage.clear();
+   }
+
+   void transaction_context::apply_pending_row_updates() {
+      auto& db = control.mutable_db();
+      for( auto& u : pending_row_updates ) {
+         db.modify( db.get<key_value_object>( key_value_object::id_type( u.first ) ), [&]( auto& o ) {
+            o.value.assign( u.second.value.data(), u.second.value.size() );
+            o.payer = u.second.payer;
+         });
+      }
+      pending_row_updates.clear();
+   }
+
    uint32_t transaction_context::update_billed_cpu_time( fc::time_point now ) {
       if( explicit_billed_cpu_time ) return static_cast<uint32_t>(billed_cpu_time_us);
 
@@ -575,7 +611,9 @@ namespace eosio { namespace chain {
    {
       uint32_t new_action_ordinal = trace->action_traces.size() + 1;
 
-      trace->action_traces.reserve( new_action_ordinal );
+      // grown geometrically, reserving exactly one more trace for every notification moved all traces every time
+      if( trace->action_traces.capacity() < new_action_ordinal )
+         trace->action_traces.reserve( std::max<size_t>( new_action_ordinal, 2 * trace->action_traces.capacity() ) );
 
       const action& provided_action = get_action_trace( action_ordinal ).act;
 
@@ -1,25 +1,160 @@
 #include <eosio/chain/transaction_metadata.hpp>
+#include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/thread_utils.hpp>
 #include <boost/asio/thread_pool.hpp>
+#include <algorithm>
+#include <array>
+#include <future>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 
 namespace eosio { namespace chain {
 
+namespace {
+
+   /**
+    * Public keys recovered from (sig_digest, signature), shared by every transaction_metadata of the node.
+    * The same signature is otherwise recovered again when its transaction arrives as input, in a block
+    * and after a fork switch. Sharded to keep the recovery threads from contending on one lock.
+    */
+   class recovery_cache {
+   public:
+      fc::optional<public_key_type> get( const digest_type& key ) {
+         auto& s = get_shard( key );
+         std::lock_guard<std::mutex> g( s.mtx );
+         auto itr = s.index.find( key );
+         if( itr == s.index.end() ) return {};
+         s.lru.splice( s.lru.begin(), s.lru, itr->second );
+         return itr->second->second;
+      }
+
+      void put( const digest_type& key, const public_key_type& pub ) {
+         auto& s = get_shard( key );
+         std::lock_guard<std::mutex> g( s.mtx );
+         if( s.index.count( key ) ) return;
+         s.lru.emplace_front( key, pub );
+         s.index.emplace( key, s.lru.begin() );
+         if( s.lru.size() > shard_capacity ) {
+            s.index.erase( s.lru.back().first );
+            s.lru.pop_back();
+         }
+      }
+
+   private:
+      static constexpr size_t shard_count    = 16;
+      static constexpr size_t shard_capacity = 4096;
+
+      struct digest_hash {
+         size_t operator()( const digest_type& d )const { return d._hash[0]; }
+      };
+
+      using lru_type = std::list<std::pair<digest_type, public_key_type>>; // most recently used first
+
+      struct shard {
+         std::mutex                                                      mtx;
+         lru_type                                                        lru;
+         std::unordered_map<digest_type, lru_type::iterator, digest_hash> index;
+      };
+
+      shard& get_shard( const digest_type& key ) { return shards[key._hash[1] % shard_count]; }
+
+      std::array<shard, shard_count> shards;
+   };
+
+   recovery_cache& get_recovery_cache() {
+      static recovery_cache cache;
+      return cache;
+   }
+
+   // transactions recovered by one thread_pool task of the batched start_recover_keys()
+   constexpr size_t recover_keys_per_task = 8;
+
+   /// same as signed_transaction::get_signature_keys() but consults the recovery_cache first
+   fc::microseconds recover_signature_keys( const packed_transaction& ptrx, const chain_id_type& chain_id, fc::time_point deadline,
+                                            flat_set<public_key_type>& recovered_pub_keys )
+   { try {
+      auto start = fc::time_point::now();
+      recovered_pub_keys.clear();
+      const signed_transaction& trn = ptrx.get_signed_transaction();
+      const digest_type digest = ptrx.sig_digest( chain_id );
+
+      auto& cache = get_recovery_cache();
+      for( const signature_type& sig : trn.signatures ) {
+         auto now = fc::time_point::now();
+         EOS_ASSERT( now < deadline, tx_cpu_usage_exceeded, "transaction signature verification executed for too long ${time}us",
+                     ("time", now - start)("now", now)("deadline", deadline)("start", start) );
+         const digest_type key = digest_type::hash( std::make_pair( digest, sig ) );
+         auto pub = cache.get( key );
+         if( !pub ) {
+            pub = public_key_type( sig, digest );
+            cache.put( key, *pub );
+         }
+         auto[ itr, successful_insertion ] = recovered_pub_keys.emplace( std::move( *pub ) );
+         EOS_ASSERT( successful_insertion, tx_duplicate_sig,
+                     "transaction includes more than one signature signed using the same key associated with public key: ${key}",
+                     ("key", *itr ) );
+      }
+
+      return fc::time_point::now() - start;
+   } FC_CAPTURE_AND_RETHROW() }
+
+}
+
 recover_keys_future transaction_metadata::start_recover_keys( packed_transaction_ptr trx,
                                                               boost::asio::io_context& thread_pool,
                                                               const chain_id_type& chain_id,
                                                               fc::microseconds time_limit,
-                                                              uint32_t max_variable_sig_size )
+                                                              uint32_t max_variable_sig_size,
+                                                              trx_type t )
 {
-   return async_thread_pool( thread_pool, [trx{std::move(trx)}, chain_id, time_limit, max_variable_sig_size]() mutable {
-         fc::time_point deadline = time_limit == fc::microseconds::maximum() ?
-                                   fc::time_point::maximum() : fc::time_point::now() + time_limit;
-         check_variable_sig_size( trx, max_variable_sig_size );
-         const signed_transaction& trn = trx->get_signed_transaction();
-         flat_set<public_key_type> recovered_pub_keys;
-         fc::microseconds cpu_usage = trn.get_signature_keys( chain_id, deadline, recovered_pub_keys );
-         return std::make_shared<transaction_metadata>( private_type(), std::move( trx ), cpu_usage, std::move( recovered_pub_keys ) );
+   EOS_ASSERT( t == trx_type::input || t == trx_type::dry_run, transaction_type_exception, "only input transactions have keys to recover" );
+   return async_thread_pool( thread_pool, [trx{std::move(trx)}, chain_id, time_limit, max_variable_sig_size, t]() mutable {
+         return recover_keys( std::move( trx ), chain_id, time_limit, max_variable_sig_size, t );
       }
    );
 }
 
+std::vector<recover_keys_future> transaction_metadata::start_recover_keys( std::vector<packed_transaction_ptr> trxs,
+                                                                           boost::asio::io_context& thread_pool,
+                                                                           const chain_id_type& chain_id,
+                                                                           fc::microseconds time_limit )
+{
+   std::vector<recover_keys_future> futures;
+   futures.reserve( trxs.size() );
+   for( size_t begin = 0; begin < trxs.size(); begin += recover_keys_per_task ) {
+      const size_t end = std::min( begin + recover_keys_per_task, trxs.size() );
+      auto promises = std::make_shared<std::vector<std::promise<transaction_metadata_ptr>>>( end - begin );
+      auto group = std::make_shared<std::vector<packed_transaction_ptr>>( std::make_move_iterator( trxs.begin() + begin ),
+                                                                           std::make_move_iterator( trxs.begin() + end ) );
+      for( auto& p : *promises )
+         futures.emplace_back( p.get_future() );
+      boost::asio::post( thread_pool, [promises, group, chain_id, time_limit]() {
+         for( size_t i = 0; i < group->size(); ++i ) {
+            try {
+               (*promises)[i].set_value( recover_keys( std::move( (*group)[i] ), chain_id, time_limit ) );
+            } catch( ... ) {
+               (*promises)[i].set_exception( std::current_exception() );
+            }
+         }
+      } );
+   }
+   return futures;
+}
+
+transaction_metadata_ptr transaction_metadata::recover_keys( packed_transaction_ptr trx, const chain_id_type& chain_id,
+                                                             fc::microseconds time_limit, uint32_t max_variable_sig_size,
+                                                             trx_type t )
+{
+   EOS_ASSERT( t == trx_type::input || t == trx_type::dry_run, transaction_type_exception, "only input transactions have keys to recover" );
+   fc::time_point deadline = time_limit == fc::microseconds::maximum() ?
+                             fc::time_point::maximum() : fc::time_point::now() + time_limit;
+   check_variable_sig_size( trx, max_variable_sig_size );
+   flat_set<public_key_type> recovered_pub_keys;
+   fc::microseconds cpu_usage = recover_signature_keys( *trx, chain_id, deadline, recovered_pub_keys );
+   return std::make_shared<transaction_metadata>( private_type(), std::move( trx ), cpu_usage, std::move( recovered_pub_keys ),
+                                                  false, false, t == trx_type::dry_run );
+}
+
 } } // eosio::chain
@@ -13,10 +13,12 @@
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/protocol_state_object.hpp>
 #include <eosio/chain/account_object.hpp>
+#include <eosio/chain/webassembly/native_float.hpp>
 #include <fc/exception/exception.hpp>
 #include <fc/crypto/sha256.hpp>
 #include <fc/crypto/sha1.hpp>
 #include <fc/io/raw.hpp>
+#include <fc/scoped_exit.hpp>
 
 #include <softfloat.hpp>
 #include <compiler_builtins.hpp>
@@ -61,6 +63,41 @@ namespace eosio { namespace chain {
       //Hard: Kick off instantiation in a separate thread at this location
 	 }
 
+   void wasm_interface::validate(const controller& control, const bytes& code, const digest_type& code_hash, boost::asio::io_context& thread_pool) {
+      const auto& pso = control.db().get<protocol_state_object>();
+      const bool nesting_checked = control.is_producing_block();
+
+      digest_type::encoder enc;
+      for( const auto& i : pso.whitelisted_intrinsics )
+         enc.write( i.second.data(), i.second.size() );
+      const digest_type intrinsics_digest = enc.result();
+
+      auto itr = my->validated_codes.find( code_hash );
+      if( itr != my->validated_codes.end() && itr->second.intrinsics_digest == intrinsics_digest
+          && (itr->second.nesting_checked || !nesting_checked) )
+         return;
+
+      Module module;
+      try {
+         Serialization::MemoryInputStream stream((U8*)code.data(), code.size());
+         WASM::serialize(stream, module);
+      } catch(const Serialization::FatalSerializationException& e) {
+         EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+      } catch(const IR::ValidationException& e) {
+         EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+      }
+
+      wasm_validations::wasm_binary_validation validator(control, module);
+      validator.validate(thread_pool);
+
+      root_resolver resolver( pso.whitelisted_intrinsics );
+      LinkResult link_result = linkModule(module, resolver);
+
+      if( my->validated_codes.size() >= wasm_interface_impl::max_validated_codes )
+         my->validated_codes.clear();
+      my->validated_codes[code_hash] = { intrinsics_digest, nesting_checked };
+   }
+
    void wasm_interface::indicate_shutting_down() {
       my->is_shutting_down = true;
    }
@@ -73,12 +110,39 @@ namespace eosio { namespace chain {
       my->current_lib(lib);
    }
 
+   void wasm_interface::eosvmoc_warmup(const digest_type& code_hash, const uint8_t& vm_version) {
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      if(my->eosvmoc) {
+         try {
+            my->eosvmoc->cc.warmup(code_hash, vm_version);
+         } FC_LOG_AND_DROP()
+      }
+#endif
+   }
+
+   bool wasm_interface::get_eosvmoc_metrics(eosvmoc::code_cache_metrics& metrics) const {
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      if(my->eosvmoc) {
+         metrics = my->eosvmoc->cc.metrics();
+         return true;
+      }
+#endif
+      return false;
+   }
+
    void wasm_interface::apply( const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version, apply_context& context ) {
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
       if(my->eosvmoc) {
          const chain::eosvmoc::code_descriptor* cd = nullptr;
+         eosvmoc::executor* exec = &my->eosvmoc->exec;
          try {
-            cd = my->eosvmoc->cc.get_descriptor_for_code(code_hash, vm_version);
+            if(my->eosvmoc->shared_cc && (cd = my->eosvmoc->shared_cc->get_descriptor_for_code(code_hash, vm_version)))
+               exec = my->eosvmoc->shared_exec.get();
+            else {
+               if(my->eosvmoc->pinned_accounts.count(context.get_receiver()))
+                  my->eosvmoc->cc.pin(code_hash, vm_version);
+               cd = my->eosvmoc->cc.get_descriptor_for_code(code_hash, vm_version);
+            }
          }
          catch(...) {
             //swallow errors here, if EOS VM OC has gone in to the weeds we shouldn't bail: continue to try and run baseline
@@ -89,7 +153,13 @@ namespace eosio { namespace chain {
             once_is_enough = true;
          }
          if(cd) {
-            my->eosvmoc->exec.execute(*cd, my->eosvmoc->mem, context);
+            eosvmoc::memory& mem = my->eosvmoc->mem_pool.acquire();
+            auto release = fc::make_scoped_exit([&]() { my->eosvmoc->mem_pool.release(mem); });
+            eosvmoc::profiler* prof = my->eosvmoc->prof.get();
+            if(prof)
+               prof->enter(code_hash);
+            auto leave = fc::make_scoped_exit([prof]() { if(prof) prof->leave(); });
+            exec->execute(*cd, mem, context);
             return;
          }
       }
@@ -326,20 +396,28 @@ class softfloat_api : public context_aware_api {
 #pragma GCC diagnostic ignored "-Wstrict-aliasing"
       // float binops
       float _eosio_f32_add( float a, float b ) {
-         float32_t ret = ::f32_add( to_softfloat32(a), to_softfloat32(b) );
-         return *reinterpret_cast<float*>(&ret);
+         return webassembly::native_float::or_softfloat<float>( [&]{ return a + b; }, [&]{
+            float32_t ret = ::f32_add( to_softfloat32(a), to_softfloat32(b) );
+            return *reinterpret_cast<float*>(&ret);
+         } );
       }
       float _eosio_f32_sub( float a, float b ) {
-         float32_t ret = ::f32_sub( to_softfloat32(a), to_softfloat32(b) );
-         return *reinterpret_cast<float*>(&ret);
+         return webassembly::native_float::or_softfloat<float>( [&]{ return a - b; }, [&]{
+            float32_t ret = ::f32_sub( to_softfloat32(a), to_softfloat32(b) );
+            return *reinterpret_cast<float*>(&ret);
+         } );
       }
       float _eosio_f32_div( float a, float b ) {
-         float32_t ret = ::f32_div( to_softfloat32(a), to_softfloat32(b) );
-         return *reinterpret_cast<float*>(&ret);
+         return webassembly::native_float::or_softfloat<float>( [&]{ return a / b; }, [&]{
+            float32_t ret = ::f32_div( to_softfloat32(a), to_softfloat32(b) );
+            return *reinterpret_cast<float*>(&ret);
+         } );
       }
       float _eosio_f32_mul( float a, float b ) {
-         float32_t ret = ::f32_mul( to_softfloat32(a), to_softfloat32(b) );
-         return *reinterpret_cast<float*>(&ret);
+         return webassembly::native_float::or_softfloat<float>( [&]{ return a * b; }, [&]{
+            float32_t ret = ::f32_mul( to_softfloat32(a), to_softfloat32(b) );
+            return *reinterpret_cast<float*>(&ret);
+         } );
       }
 #pragma GCC diagnostic pop
       float _eosio_f32_min( float af, float bf ) {
@@ -392,8 +470,10 @@ class softfloat_api : public context_aware_api {
          return from_softfloat32(a);
       }
       float _eosio_f32_sqrt( float a ) {
-         float32_t ret = ::f32_sqrt( to_softfloat32(a) );
-         return from_softfloat32(ret);
+         return webassembly::native_float::or_softfloat<float>( [&]{ return std::sqrt(a); }, [&]{
+            float32_t ret = ::f32_sqrt( to_softfloat32(a) );
+            return from_softfloat32(ret);
+         } );
       }
       // ceil, floor, trunc and nearest are lifted from libc
       float _eosio_f32_ceil( float af ) {
@@ -470,11 +550,24 @@ class softfloat_api : public context_aware_api {
       }
 
       // float relops
-      bool _eosio_f32_eq( float a, float b ) {  return ::f32_eq( to_softfloat32(a), to_softfloat32(b) ); }
-      bool _eosio_f32_ne( float a, float b ) { return !::f32_eq( to_softfloat32(a), to_softfloat32(b) ); }
-      bool _eosio_f32_lt( float a, float b ) { return ::f32_lt( to_softfloat32(a), to_softfloat32(b) ); }
-      bool _eosio_f32_le( float a, float b ) { return ::f32_le( to_softfloat32(a), to_softfloat32(b) ); }
+      bool _eosio_f32_eq( float a, float b ) {
+         if constexpr( webassembly::native_float::enabled ) return a == b;
+         return ::f32_eq( to_softfloat32(a), to_softfloat32(b) );
+      }
+      bool _eosio_f32_ne( float a, float b ) {
+         if constexpr( webassembly::native_float::enabled ) return a != b;
+         return !::f32_eq( to_softfloat32(a), to_softfloat32(b) );
+      }
+      bool _eosio_f32_lt( float a, float b ) {
+         if constexpr( webassembly::native_float::enabled ) return a < b;
+         return ::f32_lt( to_softfloat32(a), to_softfloat32(b) );
+      }
+      bool _eosio_f32_le( float a, float b ) {
+         if constexpr( webassembly::native_float::enabled ) return a <= b;
+         return ::f32_le( to_softfloat32(a), to_softfloat32(b) );
+      }
       bool _eosio_f32_gt( float af, float bf ) {
+         if constexpr( webassembly::native_float::enabled ) return af > bf;
          float32_t a = to_softfloat32(af);
          float32_t b = to_softfloat32(bf);
          if (is_nan(a))
@@ -484,6 +577,7 @@ class softfloat_api : public context_aware_api {
          return !::f32_le( a, b );
       }
       bool _eosio_f32_ge( float af, float bf ) {
+         if constexpr( webassembly::native_float::enabled ) return af >= bf;
          float32_t a = to_softfloat32(af);
          float32_t b = to_softfloat32(bf);
          if (is_nan(a))
@@ -495,20 +589,28 @@ class softfloat_api : public context_aware_api {
 
       // double binops
       double _eosio_f64_add( double a, double b ) {
-         float64_t ret = ::f64_add( to_softfloat64(a), to_softfloat64(b) );
-         return from_softfloat64(ret);
+         return webassembly::native_float::or_softfloat<double>( [&]{ return a + b; }, [&]{
+            float64_t ret = ::f64_add( to_softfloat64(a), to_softfloat64(b) );
+            return from_softfloat64(ret);
+         } );
       }
       double _eosio_f64_sub( double a, double b ) {
-         float64_t ret = ::f64_sub( to_softfloat64(a), to_softfloat64(b) );
-         return from_softfloat64(ret);
+         return webassembly::native_float::or_softfloat<double>( [&]{ return a - b; }, [&]{
+            float64_t ret = ::f64_sub( to_softfloat64(a), to_softfloat64(b) );
+            return from_softfloat64(ret);
+         } );
       }
       double _eosio_f64_div( double a, double b ) {
-         float64_t ret = ::f64_div( to_softfloat64(a), to_softfloat64(b) );
-         return from_softfloat64(ret);
+         return webassembly::native_float::or_softfloat<double>( [&]{ return a / b; }, [&]{
+            float64_t ret = ::f64_div( to_softfloat64(a), to_softfloat64(b) );
+            return from_softfloat64(ret);
+         } );
       }
       double _eosio_f64_mul( double a, double b ) {
-         float64_t ret = ::f64_mul( to_softfloat64(a), to_softfloat64(b) );
-         return from_softfloat64(ret);
+         return webassembly::native_float::or_softfloat<double>( [&]{ return a * b; }, [&]{
+            float64_t ret = ::f64_mul( to_softfloat64(a), to_softfloat64(b) );
+            return from_softfloat64(ret);
+         } );
       }
       double _eosio_f64_min( double af, double bf ) {
          float64_t a = to_softfloat64(af);
@@ -555,8 +657,10 @@ class softfloat_api : public context_aware_api {
          return from_softfloat64(a);
       }
       double _eosio_f64_sqrt( double a ) {
-         float64_t ret = ::f64_sqrt( to_softfloat64(a) );
-         return from_softfloat64(ret);
+         return webassembly::native_float::or_softfloat<double>( [&]{ return std::sqrt(a); }, [&]{
+            float64_t ret = ::f64_sqrt( to_softfloat64(a) );
+            return from_softfloat64(ret);
+         } );
       }
       // ceil, floor, trunc and nearest are lifted from libc
       double _eosio_f64_ceil( double af ) {
@@ -640,11 +744,24 @@ class softfloat_api : public context_aware_api {
       }
 
       // double relops
-      bool _eosio_f64_eq( double a, double b ) { return ::f64_eq( to_softfloat64(a), to_softfloat64(b) ); }
-      bool _eosio_f64_ne( double a, double b ) { return !::f64_eq( to_softfloat64(a), to_softfloat64(b) ); }
-      bool _eosio_f64_lt( double a, double b ) { return ::f64_lt( to_softfloat64(a), to_softfloat64(b) ); }
-      bool _eosio_f64_le( double a, double b ) { return ::f64_le( to_softfloat64(a), to_softfloat64(b) ); }
+      bool _eosio_f64_eq( double a, double b ) {
+         if constexpr( webassembly::native_float::enabled ) return a == b;
+         return ::f64_eq( to_softfloat64(a), to_softfloat64(b) );
+      }
+      bool _eosio_f64_ne( double a, double b ) {
+         if constexpr( webassembly::native_float::enabled ) return a != b;
+         return !::f64_eq( to_softfloat64(a), to_softfloat64(b) );
+      }
+      bool _eosio_f64_lt( double a, double b ) {
+         if constexpr( webassembly::native_float::enabled ) return a < b;
+         return ::f64_lt( to_softfloat64(a), to_softfloat64(b) );
+      }
+      bool _eosio_f64_le( double a, double b ) {
+         if constexpr( webassembly::native_float::enabled ) return a <= b;
+         return ::f64_le( to_softfloat64(a), to_softfloat64(b) );
+      }
       bool _eosio_f64_gt( double af, double bf ) {
+         if constexpr( webassembly::native_float::enabled ) return af > bf;
          float64_t a = to_softfloat64(af);
          float64_t b = to_softfloat64(bf);
          if (is_nan(a))
@@ -654,6 +771,7 @@ class softfloat_api : public context_aware_api {
          return !::f64_le( a, b );
       }
       bool _eosio_f64_ge( double af, double bf ) {
+         if constexpr( webassembly::native_float::enabled ) return af >= bf;
          float64_t a = to_softfloat64(af);
          float64_t b = to_softfloat64(bf);
          if (is_nan(a))
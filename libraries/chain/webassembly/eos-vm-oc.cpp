@@ -37,6 +37,8 @@ class eosvmoc_instantiated_module : public wasm_instantiated_module_interface {
 
 eosvmoc_runtime::eosvmoc_runtime(const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config, const chainbase::database& db)
    : cc(data_dir, eosvmoc_config, db), exec(cc) {
+   exec.deadline_poll_interval = eosvmoc_config.deadline_poll_interval;
+   exec.map_hot_code(eosvmoc_config.hot_code_size);
 }
 
 eosvmoc_runtime::~eosvmoc_runtime() {
@@ -45,6 +45,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 
 #include <eosio/chain/webassembly/eos-vm-oc/intrinsic.hpp>
 #include <eosio/chain/webassembly/eos-vm-oc/memory.hpp>
+#include <eosio/chain/webassembly/native_float.hpp>
 
 #define ENABLE_LOGGING 0
 #define ENABLE_FUNCTION_ENTER_EXIT_HOOKS 0
@@ -134,14 +135,17 @@ namespace LLVMJIT
 		llvm::Constant* defaultTableMaxElementIndex;
 		llvm::Constant* defaultMemoryBase;
 		llvm::Constant* depthCounter;
+		llvm::Constant* deadlinePollCountdown;
+		bool deadlinePoll;
 		bool tableOnlyHasDefinedFuncs = true;
 
 		llvm::MDNode* likelyFalseBranchWeights;
 		llvm::MDNode* likelyTrueBranchWeights;
 
-		EmitModuleContext(const Module& inModule)
+		EmitModuleContext(const Module& inModule,bool inDeadlinePoll)
 		: module(inModule)
 		, llvmModule(new llvm::Module("",context))
+		, deadlinePoll(inDeadlinePoll)
 		{
 			auto zeroAsMetadata = llvm::ConstantAsMetadata::get(emitLiteral(I32(0)));
 			auto i32MaxAsMetadata = llvm::ConstantAsMetadata::get(emitLiteral(I32(INT32_MAX)));
@@ -360,6 +364,31 @@ namespace LLVMJIT
 		}
 
 		// A helper function to emit a conditional call to a non-returning intrinsic function.
+		// Counts down the function entries and loop iterations until the executor's deadline poll, which restarts the count.
+		// Nothing is emitted when the module is compiled without deadline polls.
+		void emitDeadlinePoll()
+		{
+			if(!moduleContext.deadlinePoll) { return; }
+
+			llvm::LoadInst* countdown_loadinst;
+			llvm::StoreInst* countdown_storeinst;
+			llvm::Value* countdown = countdown_loadinst = irBuilder.CreateLoad(moduleContext.deadlinePollCountdown);
+			countdown = irBuilder.CreateSub(countdown, emitLiteral((I32)1));
+			countdown_storeinst = irBuilder.CreateStore(countdown, moduleContext.deadlinePollCountdown);
+			countdown_loadinst->setVolatile(true);
+			countdown_storeinst->setVolatile(true);
+
+			auto pollBlock = llvm::BasicBlock::Create(context,"deadlinePoll",llvmFunction);
+			auto endBlock = llvm::BasicBlock::Create(context,"deadlinePollSkip",llvmFunction);
+			irBuilder.CreateCondBr(irBuilder.CreateICmpEQ(countdown, emitLiteral((I32)0)),pollBlock,endBlock,moduleContext.likelyFalseBranchWeights);
+
+			irBuilder.SetInsertPoint(pollBlock);
+			emitRuntimeIntrinsic("eosvmoc_internal.deadline_poll",FunctionType::get(),{});
+			irBuilder.CreateBr(endBlock);
+
+			irBuilder.SetInsertPoint(endBlock);
+		}
+
 		void emitConditionalTrapIntrinsic(llvm::Value* booleanCondition,const char* intrinsicName,const FunctionType* intrinsicType,const std::initializer_list<llvm::Value*>& args)
 		{
 			auto trueBlock = llvm::BasicBlock::Create(context,llvm::Twine(intrinsicName) + "Trap",llvmFunction);
@@ -426,6 +455,8 @@ namespace LLVMJIT
 			// Branch to the loop body and switch the IR builder to emit there.
 			irBuilder.CreateBr(loopBodyBlock);
 			irBuilder.SetInsertPoint(loopBodyBlock);
+			// Every iteration branches back to the start of the body, which polls the deadline.
+			emitDeadlinePoll();
 
 			// Push a control context that ends at the end block/phi.
 			pushControlStack(ControlContext::Type::loop,imm.resultType,endBlock,endPHI);
@@ -678,6 +709,51 @@ namespace LLVMJIT
 			push(irBuilder.CreateSelect(coerceI32ToBool(condition),trueValue,falseValue));
 		}
 
+		// Emits the FPU operation for a call to one of the injected softfloat add, sub, mul, div, sqrt and compare
+		// intrinsics, calling the intrinsic only for a NaN result, see native_float.hpp. nullptr for other imports.
+		llvm::Value* emitNativeFloatIntrinsic(const Import<IndexedFunctionType>& import,llvm::Value* callee,llvm::Value** args)
+		{
+			if(!eosio::chain::webassembly::native_float::enabled || import.moduleName != "eosio_injection") return nullptr;
+			const std::string& name = import.exportName;
+			if(name.compare(0,11,"_eosio_f32_") != 0 && name.compare(0,11,"_eosio_f64_") != 0) return nullptr;
+			const std::string op = name.substr(11);
+
+			if(op == "eq") return coerceBoolToI32(irBuilder.CreateFCmpOEQ(args[0],args[1]));
+			if(op == "ne") return coerceBoolToI32(irBuilder.CreateFCmpUNE(args[0],args[1]));
+			if(op == "lt") return coerceBoolToI32(irBuilder.CreateFCmpOLT(args[0],args[1]));
+			if(op == "le") return coerceBoolToI32(irBuilder.CreateFCmpOLE(args[0],args[1]));
+			if(op == "gt") return coerceBoolToI32(irBuilder.CreateFCmpOGT(args[0],args[1]));
+			if(op == "ge") return coerceBoolToI32(irBuilder.CreateFCmpOGE(args[0],args[1]));
+
+			llvm::Value* result;
+			Uptr numArgs = 2;
+			if(op == "add") result = irBuilder.CreateFAdd(args[0],args[1]);
+			else if(op == "sub") result = irBuilder.CreateFSub(args[0],args[1]);
+			else if(op == "mul") result = irBuilder.CreateFMul(args[0],args[1]);
+			else if(op == "div") result = irBuilder.CreateFDiv(args[0],args[1]);
+			else if(op == "sqrt")
+			{
+				result = irBuilder.CreateCall(getLLVMIntrinsic({args[0]->getType()},llvm::Intrinsic::sqrt),llvm::ArrayRef<llvm::Value*>({args[0]}));
+				numArgs = 1;
+			}
+			else return nullptr;
+
+			auto nativeBlock = irBuilder.GetInsertBlock();
+			auto nanBlock = llvm::BasicBlock::Create(context,"nativeFloatNaN",llvmFunction);
+			auto endBlock = llvm::BasicBlock::Create(context,"nativeFloatEnd",llvmFunction);
+			irBuilder.CreateCondBr(irBuilder.CreateFCmpUNO(result,result),nanBlock,endBlock,moduleContext.likelyFalseBranchWeights);
+
+			irBuilder.SetInsertPoint(nanBlock);
+			auto softResult = irBuilder.CreateCall(callee,llvm::ArrayRef<llvm::Value*>(args,numArgs));
+			irBuilder.CreateBr(endBlock);
+
+			irBuilder.SetInsertPoint(endBlock);
+			auto phi = irBuilder.CreatePHI(result->getType(),2);
+			phi->addIncoming(result,nativeBlock);
+			phi->addIncoming(softResult,nanBlock);
+			return phi;
+		}
+
 		//
 		// Call operators
 		//
@@ -707,7 +783,11 @@ namespace LLVMJIT
 			popMultiple(llvmArgs,calleeType->parameters.size());
 
 			// Call the function.
-			auto result = irBuilder.CreateCall(callee,llvm::ArrayRef<llvm::Value*>(llvmArgs,calleeType->parameters.size()));
+			llvm::Value* result = nullptr;
+			if(imm.functionIndex < moduleContext.importedFunctionOffsets.size())
+				result = emitNativeFloatIntrinsic(module.functions.imports[imm.functionIndex],callee,llvmArgs);
+			if(!result)
+				result = irBuilder.CreateCall(callee,llvm::ArrayRef<llvm::Value*>(llvmArgs,calleeType->parameters.size()));
 			if(isExit) {
 				irBuilder.CreateUnreachable();
 				enterUnreachable();
@@ -1202,6 +1282,8 @@ namespace LLVMJIT
 		emitConditionalTrapIntrinsic(irBuilder.CreateICmpEQ(depth, emitLiteral((I32)0)), "eosvmoc_internal.depth_assert", FunctionType::get(), {});
 		depth_loadinst->setVolatile(true);
 		depth_storeinst->setVolatile(true);
+		// Recursion without loops is bounded only by the deadline too.
+		emitDeadlinePoll();
 
 		// Decode the WebAssembly opcodes and emit LLVM IR for them.
 		OperatorDecoderStream decoder(functionDef.code);
@@ -1236,6 +1318,7 @@ namespace LLVMJIT
 		defaultMemoryBase = emitLiteralPointer(0,llvmI8Type->getPointerTo(256));
 
 		depthCounter = emitLiteralPointer((void*)OFFSET_OF_CONTROL_BLOCK_MEMBER(current_call_depth_remaining), llvmI32Type->getPointerTo(256));
+		deadlinePollCountdown = emitLiteralPointer((void*)OFFSET_OF_CONTROL_BLOCK_MEMBER(deadline_poll_countdown), llvmI32Type->getPointerTo(256));
 
 		// Create LLVM pointer constants for the module's imported functions.
 		for(Uptr functionIndex = 0;functionIndex < module.functions.imports.size();++functionIndex)
@@ -1291,7 +1374,7 @@ namespace LLVMJIT
 		return llvmModule;
 	}
 
-	llvm::Module* emitModule(const Module& module)
+	llvm::Module* emitModule(const Module& module,bool deadlinePoll)
 	{
 		static bool inited;
 		if(!inited) {
@@ -1319,7 +1402,7 @@ namespace LLVMJIT
 			typedZeroConstants[(Uptr)ValueType::f64] = emitLiteral((F64)0.0);
 		}
 
-		return EmitModuleContext(module).emit();
+		return EmitModuleContext(module,deadlinePoll).emit();
 	}
 }
 }}}
\ No newline at end of file
@@ -267,7 +267,7 @@ namespace LLVMJIT
 		final_pic_code = std::move(*unitmemorymanager->code);
 	}
 
-	instantiated_code instantiateModule(const IR::Module& module)
+	instantiated_code instantiateModule(const IR::Module& module, bool deadline_poll)
 	{
 		static bool inited;
 		if(!inited) {
@@ -289,7 +289,7 @@ namespace LLVMJIT
 		}
 
 		// Emit LLVM IR for the module.
-		auto llvmModule = emitModule(module);
+		auto llvmModule = emitModule(module, deadline_poll);
 
 		// Construct the JIT compilation pipeline for this module.
 		auto jitModule = new JITModule();
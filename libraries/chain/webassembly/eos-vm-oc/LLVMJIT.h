@@ -19,7 +19,8 @@ struct instantiated_code {
 
 namespace LLVMJIT {
    bool getFunctionIndexFromExternalName(const char* externalName,Uptr& outFunctionDefIndex);
-   llvm::Module* emitModule(const IR::Module& module);
-   instantiated_code instantiateModule(const IR::Module& module);
+   //deadline_poll emits the polls of the deadline, see config::deadline_poll_interval
+   llvm::Module* emitModule(const IR::Module& module, bool deadline_poll);
+   instantiated_code instantiateModule(const IR::Module& module, bool deadline_poll);
 }
 }}}
\ No newline at end of file
@@ -7,11 +7,13 @@
 #include <eosio/chain/webassembly/eos-vm-oc/eos-vm-oc.hpp>
 #include <eosio/chain/webassembly/eos-vm-oc/intrinsic.hpp>
 #include <eosio/chain/webassembly/eos-vm-oc/compile_monitor.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/profile.hpp>
 #include <eosio/chain/exceptions.hpp>
 
 #include <unistd.h>
 #include <sys/syscall.h>
 #include <sys/mman.h>
+#include <sys/file.h>
 #include <linux/memfd.h>
 
 #include "IR/Module.h"
@@ -42,7 +44,9 @@ static_assert(sizeof(code_cache_header) <= header_size, "code_cache_header too b
 code_cache_async::code_cache_async(const bfs::path data_dir, const eosvmoc::config& eosvmoc_config, const chainbase::database& db) :
    code_cache_base(data_dir, eosvmoc_config, db),
    _result_queue(eosvmoc_config.threads * 2),
-   _threads(eosvmoc_config.threads)
+   _threads(eosvmoc_config.threads),
+   _admission_executions(eosvmoc_config.admission_executions),
+   _admission_window(eosvmoc_config.admission_window)
 {
    FC_ASSERT(_threads, "EOS VM OC requires at least 1 compile thread");
 
@@ -74,7 +78,10 @@ void code_cache_async::wait_on_compile_monitor_message() {
          return;
       }
 
-      _result_queue.push(message.get<wasm_compilation_result_message>());
+      const wasm_compilation_result_message& result = message.get<wasm_compilation_result_message>();
+      if(fds.size() == 1 && result.result.contains<code_descriptor>())
+         profiler::add_function_offsets(result.code.code_id, vector_for_memfd(fds[0]));
+      _result_queue.push(result);
 
       wait_on_compile_monitor_message();
    });
@@ -85,16 +92,21 @@ void code_cache_async::wait_on_compile_monitor_message() {
 std::tuple<size_t, size_t> code_cache_async::consume_compile_thread_queue() {
    size_t bytes_remaining = 0;
    size_t gotsome = _result_queue.consume_all([&](const wasm_compilation_result_message& result) {
+      _metrics.record_compile_time(result.compile_time_us);
       if(_outstanding_compiles_and_poison[result.code] == false) {
          result.result.visit(overloaded {
             [&](const code_descriptor& cd) {
                _cache_index.push_front(cd);
+               _shared_index_dirty = _shared_writer;
             },
             [&](const compilation_result_unknownfailure&) {
                wlog("code ${c} failed to tier-up with EOS VM OC", ("c", result.code.code_id));
                _blacklist.emplace(result.code);
             },
             [&](const compilation_result_toofull&) {
+               //a shared cache never evicts, don't compile the code again and again
+               if(_shared_writer)
+                  _blacklist.emplace(result.code);
                run_eviction_round();
             }
          });
@@ -114,29 +126,23 @@ const code_descriptor* const code_cache_async::get_descriptor_for_code(const dig
       if(count_processed)
          check_eviction_threshold(bytes_remaining);
 
-      while(count_processed && _queued_compiles.size()) {
-         auto nextup = _queued_compiles.begin();
-
-         //it's not clear this check is required: if apply() was called for code then it existed in the code_index; and then
-         // if we got notification of it no longer existing we would have removed it from queued_compiles
-         const code_object* const codeobject = _db.find<code_object,by_code_hash>(boost::make_tuple(nextup->code_id, 0, nextup->vm_version));
-         if(codeobject) {
-            _outstanding_compiles_and_poison.emplace(*nextup, false);
-            std::vector<wrapped_fd> fds_to_pass;
-            fds_to_pass.emplace_back(memfd_for_bytearray(codeobject->code));
-            FC_ASSERT(write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ *nextup }, fds_to_pass), "EOS VM failed to communicate to OOP manager");
+      while(count_processed && _queued_compiles.size())
+         if(compile_next_queued())
             --count_processed;
-         }
-         _queued_compiles.erase(nextup);
-      }
    }
 
+   if(_shared_index_dirty && std::chrono::steady_clock::now() - _shared_index_published >= std::chrono::seconds(1))
+      publish_shared_index();
+
    //check for entry in cache
    code_cache_index::index<by_hash>::type::iterator it = _cache_index.get<by_hash>().find(boost::make_tuple(code_id, vm_version));
    if(it != _cache_index.get<by_hash>().end()) {
       _cache_index.relocate(_cache_index.begin(), _cache_index.project<0>(it));
+      ++_metrics.hits;
       return &*it;
    }
+   ++_metrics.misses;
+   age_execution_counts();
 
    const code_tuple ct = code_tuple{code_id, vm_version};
 
@@ -146,11 +152,16 @@ const code_descriptor* const code_cache_async::get_descriptor_for_code(const dig
       it->second = false;
       return nullptr;
    }
-   if(_queued_compiles.find(ct) != _queued_compiles.end())
+   if(auto it = _queued_compiles.find(ct); it != _queued_compiles.end()) {
+      ++it->second.misses;
+      it->second.recent = true;
+      return nullptr;
+   }
+   if(!admit(ct))
       return nullptr;
 
    if(_outstanding_compiles_and_poison.size() >= _threads) {
-      _queued_compiles.emplace(ct);
+      _queued_compiles.emplace(ct, queued_compile{1u, true});
       return nullptr;
    }
 
@@ -161,10 +172,78 @@ const code_descriptor* const code_cache_async::get_descriptor_for_code(const dig
    _outstanding_compiles_and_poison.emplace(ct, false);
    std::vector<wrapped_fd> fds_to_pass;
    fds_to_pass.emplace_back(memfd_for_bytearray(codeobject->code));
-   write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ ct }, fds_to_pass);
+   write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ ct, _codegen_version }, fds_to_pass);
+   ++_metrics.compiles;
    return nullptr;
 }
 
+void code_cache_async::warmup(const digest_type& code_id, const uint8_t& vm_version) {
+   if(_admission_executions > 1)
+      _execution_counts[code_tuple{code_id, vm_version}] = _admission_executions - 1;
+   get_descriptor_for_code(code_id, vm_version);
+}
+
+bool code_cache_async::compile_next_queued() {
+   auto nextup = _queued_compiles.begin();
+   for(auto it = std::next(nextup); it != _queued_compiles.end(); ++it)
+      if(std::make_tuple(_pinned.count(it->first), it->second.misses) > std::make_tuple(_pinned.count(nextup->first), nextup->second.misses))
+         nextup = it;
+   const code_tuple ct = nextup->first;
+   _queued_compiles.erase(nextup);
+
+   //it's not clear this check is required: if apply() was called for code then it existed in the code_index; and then
+   // if we got notification of it no longer existing we would have removed it from queued_compiles
+   const code_object* const codeobject = _db.find<code_object,by_code_hash>(boost::make_tuple(ct.code_id, 0, ct.vm_version));
+   if(!codeobject)
+      return false;
+
+   _outstanding_compiles_and_poison.emplace(ct, false);
+   std::vector<wrapped_fd> fds_to_pass;
+   fds_to_pass.emplace_back(memfd_for_bytearray(codeobject->code));
+   FC_ASSERT(write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ ct, _codegen_version }, fds_to_pass), "EOS VM failed to communicate to OOP manager");
+   ++_metrics.compiles;
+   return true;
+}
+
+void code_cache_async::age_execution_counts() {
+   //age the counts so codes that were popular long ago do not stay admitted, or first in the compile queue
+   if(++_admission_misses < _admission_window)
+      return;
+   _admission_misses = 0;
+
+   for(auto it = _execution_counts.begin(); it != _execution_counts.end();) {
+      it->second /= 2;
+      if(it->second == 0)
+         it = _execution_counts.erase(it);
+      else
+         ++it;
+   }
+
+   for(auto it = _queued_compiles.begin(); it != _queued_compiles.end();) {
+      if(!it->second.recent && !_pinned.count(it->first)) {
+         it = _queued_compiles.erase(it);
+         ++_metrics.cancelled_compiles;
+         continue;
+      }
+      it->second.misses = (it->second.misses+1)/2;
+      it->second.recent = false;
+      ++it;
+   }
+}
+
+bool code_cache_async::admit(const code_tuple& ct) {
+   if(_admission_executions <= 1 || _pinned.count(ct))
+      return true;
+
+   auto& count = _execution_counts[ct];
+   if(++count < _admission_executions) {
+      ++_metrics.rejected_admissions;
+      return false;
+   }
+   _execution_counts.erase(ct);
+   return true;
+}
+
 code_cache_sync::~code_cache_sync() {
    //it's exceedingly critical that we wait for the compile monitor to be done with all its work
    //This is easy in the sync case
@@ -189,12 +268,13 @@ const code_descriptor* const code_cache_sync::get_descriptor_for_code_sync(const
    std::vector<wrapped_fd> fds_to_pass;
    fds_to_pass.emplace_back(memfd_for_bytearray(codeobject->code));
 
-   write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ {code_id, vm_version} }, fds_to_pass);
+   write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ {code_id, vm_version}, _codegen_version }, fds_to_pass);
    auto [success, message, fds] = read_message_with_fds(_compile_monitor_read_socket);
    EOS_ASSERT(success, wasm_execution_error, "failed to read response from monitor process");
    EOS_ASSERT(message.contains<wasm_compilation_result_message>(), wasm_execution_error, "unexpected response from monitor process");
 
    wasm_compilation_result_message result = message.get<wasm_compilation_result_message>();
+   _metrics.record_compile_time(result.compile_time_us);
    EOS_ASSERT(result.result.contains<code_descriptor>(), wasm_execution_error, "failed to compile wasm");
 
    check_eviction_threshold(result.cache_free_bytes);
@@ -210,6 +290,17 @@ code_cache_base::code_cache_base(const boost::filesystem::path data_dir, const e
 
    bfs::create_directories(data_dir);
 
+   _shared_writer = eosvmoc_config.shared_cache_writer;
+   _codegen_version = codegen_version_for(eosvmoc_config.deadline_poll_interval);
+   if(_shared_writer) {
+      const bfs::path lock_path = data_dir/"code_cache.lock";
+      const int lock_fd = ::open(lock_path.generic_string().c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+      EOS_ASSERT(lock_fd >= 0, database_exception, "failure to open shared code cache lock file ${p}", ("p", lock_path.generic_string()));
+      _shared_lock = wrapped_fd(lock_fd);
+      EOS_ASSERT(flock(_shared_lock, LOCK_EX | LOCK_NB) == 0, database_exception,
+                 "another nodeos is already writing the shared EOS VM OC code cache in ${d}", ("d", data_dir.generic_string()));
+   }
+
    if(!bfs::exists(_cache_file_path)) {
       EOS_ASSERT(eosvmoc_config.cache_size >= allocator_t::get_min_size(total_header_size), database_exception, "configured code cache size is too small");
       std::ofstream ofs(_cache_file_path.generic_string(), std::ofstream::trunc);
@@ -262,7 +353,8 @@ code_cache_base::code_cache_base(const boost::filesystem::path data_dir, const e
       for(unsigned i = 0; i < number_entries; ++i) {
          code_descriptor cd;
          fc::raw::unpack(ds, cd);
-         if(cd.codegen_version != 0) {
+         //compiled with other settings, e.g. a changed eos-vm-oc-deadline-poll-interval
+         if(cd.codegen_version != _codegen_version) {
             allocator->deallocate(code_mapping + cd.code_begin);
             allocator->deallocate(code_mapping + cd.initdata_begin);
             continue;
@@ -284,6 +376,31 @@ code_cache_base::code_cache_base(const boost::filesystem::path data_dir, const e
    int duped = dup(compile_monitor_conn);
    _compile_monitor_write_socket.assign(local::datagram_protocol(), duped);
    _compile_monitor_read_socket.assign(local::datagram_protocol(), compile_monitor_conn.release());
+
+   if(_shared_writer)
+      publish_shared_index();
+}
+
+void code_cache_base::publish_shared_index() {
+   _shared_index_dirty = false;
+   _shared_index_published = std::chrono::steady_clock::now();
+
+   struct stat st;
+   if(fstat(_cache_fd, &st))
+      return;
+   shared_code_cache_index index{header_id, (uint64_t)st.st_ino, (uint64_t)st.st_size, {_cache_index.begin(), _cache_index.end()}};
+
+   //readers only ever see a complete index
+   const bfs::path index_path = _cache_file_path.parent_path()/"code_cache.index";
+   const bfs::path tmp_path = _cache_file_path.parent_path()/"code_cache.index.tmp";
+   try {
+      const std::vector<char> bytes = fc::raw::pack(index);
+      std::ofstream ofs(tmp_path.generic_string(), std::ofstream::binary | std::ofstream::trunc);
+      ofs.write(bytes.data(), bytes.size());
+      ofs.close();
+      EOS_ASSERT(!ofs.fail(), database_exception, "failure to write shared code cache index ${p}", ("p", tmp_path.generic_string()));
+      bfs::rename(tmp_path, index_path);
+   } FC_LOG_AND_DROP();
 }
 
 void code_cache_base::set_on_disk_region_dirty(bool dirty) {
@@ -322,7 +439,7 @@ code_cache_base::~code_cache_base() {
    char* p = nullptr;
    while(_cache_index.size()) {
       p = (char*)allocator->allocate(sz);
-      if(p != nullptr)
+      if(p != nullptr || _shared_writer)
          break;
       //in theory, there could be too little free space avaiable to store the cache index
       //try to free up some space
@@ -353,12 +470,15 @@ code_cache_base::~code_cache_base() {
 void code_cache_base::free_code(const digest_type& code_id, const uint8_t& vm_version) {
    code_cache_index::index<by_hash>::type::iterator it = _cache_index.get<by_hash>().find(boost::make_tuple(code_id, vm_version));
    if(it != _cache_index.get<by_hash>().end()) {
-      write_message_with_fds(_compile_monitor_write_socket, evict_wasms_message{ {*it} });
+      if(!_shared_writer)
+         write_message_with_fds(_compile_monitor_write_socket, evict_wasms_message{ {*it} });
       _cache_index.get<by_hash>().erase(it);
+      _shared_index_dirty = _shared_writer;
    }
 
    //if it's in the queued list, erase it
    _queued_compiles.erase({code_id, vm_version});
+   _pinned.erase({code_id, vm_version});
 
    //however, if it's currently being compiled there is no way to cancel the compile,
    //so instead set a poison boolean that indicates not to insert the code in to the cache
@@ -368,12 +488,34 @@ void code_cache_base::free_code(const digest_type& code_id, const uint8_t& vm_ve
       compiling_it->second = true;
 }
 
+void code_cache_base::pin(const digest_type& code_id, const uint8_t& vm_version) {
+   _pinned.insert({code_id, vm_version});
+}
+
+code_cache_metrics code_cache_base::metrics() const {
+   code_cache_metrics m = _metrics;
+   m.entries = _cache_index.size();
+   m.pinned = _pinned.size();
+   m.queued_compiles = _queued_compiles.size();
+   m.outstanding_compiles = _outstanding_compiles_and_poison.size();
+   return m;
+}
+
 void code_cache_base::run_eviction_round() {
+   if(_shared_writer)
+      return;
+
    evict_wasms_message evict_msg;
-   for(unsigned int i = 0; i < 25 && _cache_index.size() > 1; ++i) {
-      evict_msg.codes.emplace_back(_cache_index.back());
-      _cache_index.pop_back();
+   //least recently used first, skipping pinned codes
+   auto it = _cache_index.end();
+   while(evict_msg.codes.size() < 25 && _cache_index.size() > 1 && it != _cache_index.begin()) {
+      --it;
+      if(_pinned.count({it->code_hash, it->vm_version}))
+         continue;
+      evict_msg.codes.emplace_back(*it);
+      it = _cache_index.erase(it);
    }
+   _metrics.evictions += evict_msg.codes.size();
    write_message_with_fds(_compile_monitor_write_socket, evict_msg);
 }
 
@@ -382,4 +524,78 @@ void code_cache_base::check_eviction_threshold(size_t free_bytes) {
       run_eviction_round();
 }
 
-}}}
\ No newline at end of file
+code_cache_shared_reader::code_cache_shared_reader(const bfs::path& dir, uint8_t codegen_version) :
+   _index_path(dir/"code_cache.index"),
+   _codegen_version(codegen_version)
+{
+   const bfs::path cache_path = dir/"code_cache.bin";
+   EOS_ASSERT(bfs::exists(cache_path), database_exception,
+              "shared EOS VM OC code cache ${p} does not exist, start its writer first", ("p", cache_path.generic_string()));
+   _cache_fd = ::open(cache_path.generic_string().c_str(), O_RDONLY | O_CLOEXEC);
+   EOS_ASSERT(_cache_fd >= 0, database_exception, "failure to open shared code cache");
+
+   struct stat st;
+   EOS_ASSERT(fstat(_cache_fd, &st) == 0, database_exception, "failure to get size of shared code cache");
+   _cache_inode = st.st_ino;
+   _cache_size = st.st_size;
+
+   reload_index();
+   _last_check = std::chrono::steady_clock::now();
+   ilog("Using shared EOS VM Optimized Compiler code cache ${p} with ${c} entries", ("p", cache_path.generic_string())("c", _codes.size()));
+}
+
+code_cache_shared_reader::~code_cache_shared_reader() {
+   close(_cache_fd);
+}
+
+const code_descriptor* const code_cache_shared_reader::get_descriptor_for_code(const digest_type& code_id, const uint8_t& vm_version) {
+   const auto now = std::chrono::steady_clock::now();
+   if(now - _last_check >= std::chrono::seconds(1)) {
+      _last_check = now;
+      reload_index();
+   }
+
+   auto it = _codes.find(code_tuple{code_id, vm_version});
+   return it == _codes.end() ? nullptr : &it->second;
+}
+
+void code_cache_shared_reader::reload_index() {
+   struct stat st;
+   if(stat(_index_path.generic_string().c_str(), &st))
+      return;
+   //the writer replaces the index by renaming a new one over it
+   if(st.st_ino == _index_inode && st.st_mtim.tv_sec == _index_mtime.tv_sec && st.st_mtim.tv_nsec == _index_mtime.tv_nsec)
+      return;
+   _index_inode = st.st_ino;
+   _index_mtime = st.st_mtim;
+
+   shared_code_cache_index index;
+   try {
+      std::ifstream ifs(_index_path.generic_string(), std::ifstream::binary);
+      const std::vector<char> bytes((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+      index = fc::raw::unpack<shared_code_cache_index>(bytes);
+   } catch(...) {
+      wlog("failed to read shared EOS VM OC code cache index ${p}", ("p", _index_path.generic_string()));
+      return;
+   }
+
+   //offsets in to a cache file that was recreated or grown since it was mapped are meaningless here
+   if(index.id != header_id || index.cache_inode != _cache_inode || index.cache_size > _cache_size) {
+      if(!_mismatch_logged)
+         wlog("shared EOS VM OC code cache was recreated or resized by its writer, its codes are not used until restart");
+      _mismatch_logged = true;
+      _codes.clear();
+      return;
+   }
+
+   _codes.clear();
+   for(code_descriptor& cd : index.codes) {
+      //the writer compiles with its own deadline poll setting, such codes are compiled in to the private cache
+      if(cd.codegen_version != _codegen_version)
+         continue;
+      const code_tuple ct{cd.code_hash, cd.vm_version};
+      _codes.emplace(ct, std::move(cd));
+   }
+}
+
+}}}
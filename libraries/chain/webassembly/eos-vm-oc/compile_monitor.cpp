@@ -12,6 +12,8 @@
 #include <boost/asio/local/datagram_protocol.hpp>
 #include <boost/signals2.hpp>
 
+#include <chrono>
+
 namespace eosio { namespace chain { namespace eosvmoc {
 
 using namespace boost::asio;
@@ -72,7 +74,7 @@ struct compile_monitor_session {
                   connection_dead_signal();
                   return;
                }
-               kick_compile_off(compile.code, std::move(fds[0]));
+               kick_compile_off(compile, std::move(fds[0]));
             },
             [&](const evict_wasms_message& evict) {
                for(const code_descriptor& cd : evict.codes) {
@@ -91,7 +93,8 @@ struct compile_monitor_session {
       });
    }
 
-   void kick_compile_off(const code_tuple& code_id, wrapped_fd&& wasm_code) {
+   void kick_compile_off(const compile_wasm_message& compile, wrapped_fd&& wasm_code) {
+      const code_tuple& code_id = compile.code;
       //prepare a requst to go out to the trampoline
       int socks[2];
       socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, socks);
@@ -101,30 +104,32 @@ struct compile_monitor_session {
       fds_pass_to_trampoline.emplace_back(socks[1]);
       fds_pass_to_trampoline.emplace_back(std::move(wasm_code));
 
-      eosvmoc_message trampoline_compile_request = compile_wasm_message{code_id};
+      eosvmoc_message trampoline_compile_request = compile;
       if(write_message_with_fds(_trampoline_socket, trampoline_compile_request, fds_pass_to_trampoline) == false) {
          wasm_compilation_result_message reply{code_id, compilation_result_unknownfailure{}, _allocator->get_free_memory()};
          write_message_with_fds(_nodeos_instance_socket, reply);
          return;
       }
 
-      current_compiles.emplace_front(code_id, std::move(response_socket));
+      current_compiles.emplace_front(code_id, compile.codegen_version, std::move(response_socket), std::chrono::steady_clock::now());
       read_message_from_compile_task(current_compiles.begin());
    }
 
-   void read_message_from_compile_task(std::list<std::tuple<code_tuple, local::datagram_protocol::socket>>::iterator current_compile_it) {
-      auto& [code, socket] = *current_compile_it;
+   void read_message_from_compile_task(std::list<std::tuple<code_tuple, uint8_t, local::datagram_protocol::socket, std::chrono::steady_clock::time_point>>::iterator current_compile_it) {
+      auto& [code, codegen_version, socket, start] = *current_compile_it;
       socket.async_wait(local::datagram_protocol::socket::wait_read, [this, current_compile_it](auto ec) {
          //at this point we only expect 1 of 2 things to happen: we either get a reply (success), or we get no reply (failure)
-         auto& [code, socket] = *current_compile_it;
+         auto& [code, codegen_version, socket, start] = *current_compile_it;
          auto [success, message, fds] = read_message_with_fds(socket);
          
          wasm_compilation_result_message reply{code, compilation_result_unknownfailure{}, _allocator->get_free_memory()};
+         reply.compile_time_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
          
          void* code_ptr = nullptr;
          void* mem_ptr = nullptr;
+         std::vector<wrapped_fd> function_offsets;
          try {
-            if(success && message.contains<code_compilation_result_message>() && fds.size() == 2) {
+            if(success && message.contains<code_compilation_result_message>() && fds.size() >= 2) {
                code_compilation_result_message& result = message.get<code_compilation_result_message>();
                code_ptr = _allocator->allocate(get_size_of_fd(fds[0]));
                mem_ptr = _allocator->allocate(get_size_of_fd(fds[1]));
@@ -141,7 +146,7 @@ struct compile_monitor_session {
                   reply.result = code_descriptor {
                      code.code_id,
                      code.vm_version,
-                     0,
+                     codegen_version,
                      (uintptr_t)code_ptr - (uintptr_t)_code_mapping,
                      result.start,
                      result.apply_offset,
@@ -150,6 +155,9 @@ struct compile_monitor_session {
                      (unsigned)get_size_of_fd(fds[1]),
                      result.initdata_prologue_size
                   };
+                  //function offsets for the profiler, passed through as is
+                  if(fds.size() == 3)
+                     function_offsets.emplace_back(std::move(fds[2]));
                }
             }
          }
@@ -158,7 +166,7 @@ struct compile_monitor_session {
             _allocator->deallocate(mem_ptr);
          }
 
-         write_message_with_fds(_nodeos_instance_socket, reply);
+         write_message_with_fds(_nodeos_instance_socket, reply, function_offsets);
 
          //either way, we are done
          _ctx.post([this, current_compile_it]() {
@@ -180,7 +188,7 @@ private:
    size_t _code_size;
    allocator_t* _allocator;
 
-   std::list<std::tuple<code_tuple, local::datagram_protocol::socket>> current_compiles;
+   std::list<std::tuple<code_tuple, uint8_t, local::datagram_protocol::socket, std::chrono::steady_clock::time_point>> current_compiles;
 };
 
 struct compile_monitor {
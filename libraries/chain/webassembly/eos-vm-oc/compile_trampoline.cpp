@@ -2,6 +2,7 @@
 #include <eosio/chain/webassembly/eos-vm-oc/ipc_protocol.hpp>
 #include <eosio/chain/webassembly/eos-vm-oc/memory.hpp>
 #include <eosio/chain/webassembly/eos-vm-oc/intrinsic.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/profile.hpp>
 #include <eosio/chain/wasm_eosio_injection.hpp>
 
 #include <sys/prctl.h>
@@ -17,7 +18,7 @@ using namespace IR;
 
 namespace eosio { namespace chain { namespace eosvmoc {
 
-void run_compile(wrapped_fd&& response_sock, wrapped_fd&& wasm_code) noexcept {  //noexcept; we'll just blow up if anything tries to cross this boundry
+void run_compile(wrapped_fd&& response_sock, wrapped_fd&& wasm_code, uint8_t codegen_version) noexcept {  //noexcept; we'll just blow up if anything tries to cross this boundry
    std::vector<uint8_t> wasm = vector_for_memfd(wasm_code);
 
    //ideally we catch exceptions and sent them upstream as strings for easier reporting
@@ -29,7 +30,7 @@ void run_compile(wrapped_fd&& response_sock, wrapped_fd&& wasm_code) noexcept {
    wasm_injections::wasm_binary_injection<false> injector(module);
    injector.inject();
 
-   instantiated_code code = LLVMJIT::instantiateModule(module);
+   instantiated_code code = LLVMJIT::instantiateModule(module, codegen_version == codegen_version_deadline_poll);
 
    code_compilation_result_message result_message;
 
@@ -132,6 +133,7 @@ void run_compile(wrapped_fd&& response_sock, wrapped_fd&& wasm_code) noexcept {
    std::vector<wrapped_fd> fds_to_send;
    fds_to_send.emplace_back(memfd_for_bytearray(code.code));
    fds_to_send.emplace_back(memfd_for_bytearray(initdata_prep));
+   fds_to_send.emplace_back(memfd_for_bytearray(profiler::pack_function_offsets(function_to_offsets, module.functions.imports.size())));
    write_message_with_fds(response_sock, result_message, fds_to_send);
 }
 
@@ -173,7 +175,7 @@ void run_compile_trampoline(int fd) {
          struct rlimit core_limits = {0u, 0u};
          setrlimit(RLIMIT_CORE, &core_limits);
 
-         run_compile(std::move(fds[0]), std::move(fds[1]));
+         run_compile(std::move(fds[0]), std::move(fds[1]), message.get<compile_wasm_message>().codegen_version);
          _exit(0);
       }
       else if(pid == -1)
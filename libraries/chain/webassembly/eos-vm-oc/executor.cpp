@@ -15,6 +15,7 @@
 #include <boost/hana/equal.hpp>
 
 #include <asm/prctl.h>
+#include <sys/mman.h>
 #include <sys/prctl.h>
 #include <sys/syscall.h>
 
@@ -117,6 +118,27 @@ DEFINE_EOSVMOC_TRAP_INTRINSIC(eosvmoc_internal,unreachable) {
    throw_internal_exception("Unreachable reached");
 }
 
+//compiled code calls this every deadline_poll_interval function entries and loop iterations; reading the clock here stops
+// the code right at the deadline, where the timer signal may be late or, on some virtual machines, much later
+static void deadline_poll() {
+   if(eos_vm_oc_restart_deadline_poll() == 0)
+      return;
+   try {
+      transaction_context& trx_context = static_cast<apply_context*>(eos_vm_oc_get_apply_context())->trx_context;
+      trx_context.transaction_timer.poll();
+      trx_context.checktime();
+      return;
+   }
+   catch(...) {
+      *reinterpret_cast<std::exception_ptr*>(eos_vm_oc_get_exception_ptr()) = std::current_exception();
+   }
+   siglongjmp(*eos_vm_oc_get_jmp_buf(), EOSVMOC_EXIT_EXCEPTION);
+   __builtin_unreachable();
+}
+static intrinsic deadline_poll_intrinsic EOSVMOC_INTRINSIC_INIT_PRIORITY("eosvmoc_internal.deadline_poll", IR::FunctionType::get(), (void*)&deadline_poll,
+  boost::hana::index_if(intrinsic_table, ::boost::hana::equal.to(BOOST_HANA_STRING("eosvmoc_internal.deadline_poll"))).value()
+);
+
 struct executor_signal_init {
    executor_signal_init() {
       struct sigaction sig_action, old_sig_action;
@@ -131,7 +153,9 @@ struct executor_signal_init {
    }
 };
 
-executor::executor(const code_cache_base& cc) {
+executor::executor(const code_cache_base& cc) : executor(cc.fd()) {}
+
+executor::executor(int cache_fd) {
    //if we're the first executor created, go setup the signal handling. For now we'll just leave this attached forever
    static executor_signal_init the_executor_signal_init;
 
@@ -140,23 +164,87 @@ executor::executor(const code_cache_base& cc) {
       wlog("x86_64 GS register is not set as expected. EOS VM OC may not run correctly on this platform");
 
    struct stat s;
-   FC_ASSERT(fstat(cc.fd(), &s) == 0, "executor failed to get code cache size");
-   code_mapping = (uint8_t*)mmap(nullptr, s.st_size, PROT_EXEC|PROT_READ, MAP_SHARED, cc.fd(), 0);
+   FC_ASSERT(fstat(cache_fd, &s) == 0, "executor failed to get code cache size");
+   code_mapping = (uint8_t*)mmap(nullptr, s.st_size, PROT_EXEC|PROT_READ, MAP_SHARED, cache_fd, 0);
    FC_ASSERT(code_mapping != MAP_FAILED, "failed to map code cache in to executor");
    code_mapping_size = s.st_size;
    mapping_is_executable = true;
 }
 
-void executor::execute(const code_descriptor& code, const memory& mem, apply_context& context) {
+static constexpr size_t huge_page_size = 2u*1024u*1024u;
+static constexpr size_t hot_code_alignment = 64u;
+
+void executor::map_hot_code(size_t size) {
+   size = (size + huge_page_size - 1) & ~(huge_page_size - 1);
+   if(size == 0)
+      return;
+
+   //reserved huge pages if there are enough of them, otherwise transparent huge pages of a 2MiB aligned region
+   void* p = mmap(nullptr, size, PROT_READ|PROT_EXEC, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+   if(p == MAP_FAILED) {
+      uint8_t* reserved = (uint8_t*)mmap(nullptr, size + huge_page_size, PROT_READ|PROT_EXEC, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+      FC_ASSERT(reserved != MAP_FAILED, "failed to map the EOS VM OC hot code region");
+      uint8_t* aligned = (uint8_t*)(((uintptr_t)reserved + huge_page_size - 1) & ~(uintptr_t)(huge_page_size - 1));
+      if(aligned != reserved)
+         munmap(reserved, aligned - reserved);
+      if(aligned + size != reserved + size + huge_page_size)
+         munmap(aligned + size, reserved + size + huge_page_size - (aligned + size));
+      if(madvise(aligned, size, MADV_HUGEPAGE)) {
+         wlog("neither reserved nor transparent huge pages are available, EOS VM OC executes the codes from the code cache");
+         munmap(aligned, size);
+         return;
+      }
+      p = aligned;
+      ilog("EOS VM OC executes the codes from ${s} MiB of transparent huge pages", ("s", size/(1024u*1024u)));
+   }
+   else
+      ilog("EOS VM OC executes the codes from ${s} MiB of reserved huge pages", ("s", size/(1024u*1024u)));
+   hot_code = (uint8_t*)p;
+   hot_code_size = size;
+}
+
+uint8_t* executor::hot_code_base(const code_descriptor& code) {
+   if(!hot_code)
+      return code_mapping + code.code_begin;
+
+   auto it = hot_code_entries.find(code.code_begin);
+   if(it != hot_code_entries.end() && it->second.code_hash_prefix == code.code_hash._hash[0])
+      return hot_code + it->second.offset;
+
+   //the allocation holding the code in the cache, its size is kept by the allocator at the start of the cache
+   uint8_t* const cached = code_mapping + code.code_begin;
+   const size_t size = reinterpret_cast<const allocator_t*>(code_mapping)->size(cached);
+   const size_t aligned_size = (size + hot_code_alignment - 1) & ~(hot_code_alignment - 1);
+   if(aligned_size > hot_code_size)
+      return cached;
+   if(hot_code_used + aligned_size > hot_code_size) {
+      hot_code_entries.clear();
+      hot_code_used = 0;
+   }
+
+   //nothing executes from the region while it is written
+   mprotect(hot_code, hot_code_size, PROT_READ|PROT_WRITE);
+   memcpy(hot_code + hot_code_used, cached, size);
+   mprotect(hot_code, hot_code_size, PROT_READ|PROT_EXEC);
+   hot_code_entries[code.code_begin] = {hot_code_used, code.code_hash._hash[0]};
+   hot_code_used += aligned_size;
+   return hot_code + hot_code_entries[code.code_begin].offset;
+}
+
+void executor::execute(const code_descriptor& code, memory& mem, apply_context& context) {
    if(mapping_is_executable == false) {
       mprotect(code_mapping, code_mapping_size, PROT_EXEC|PROT_READ);
+      if(hot_code)
+         mprotect(hot_code, hot_code_size, PROT_EXEC|PROT_READ);
       mapping_is_executable = true;
    }
+   uint8_t* const code_base = hot_code_base(code);
+   const bool from_hot_code = code_base != code_mapping + code.code_begin;
 
    //prepare initial memory, mutable globals, and table data
    if(code.starting_memory_pages > 0 ) {
       arch_prctl(ARCH_SET_GS, (unsigned long*)(mem.zero_page_memory_base()+code.starting_memory_pages*memory::stride));
-      memset(mem.full_page_memory_base(), 0, 64u*1024u*code.starting_memory_pages);
+      mem.zero_pages(code.starting_memory_pages);
    }
    else
       arch_prctl(ARCH_SET_GS, (unsigned long*)mem.zero_page_memory_base());
@@ -164,8 +252,8 @@ void executor::execute(const code_descriptor& code, const memory& mem, apply_con
 
    control_block* const cb = mem.get_control_block();
    cb->magic = signal_sentinel;
-   cb->execution_thread_code_start = (uintptr_t)code_mapping;
-   cb->execution_thread_code_length = code_mapping_size;
+   cb->execution_thread_code_start = from_hot_code ? (uintptr_t)hot_code : (uintptr_t)code_mapping;
+   cb->execution_thread_code_length = from_hot_code ? hot_code_size : code_mapping_size;
    cb->execution_thread_memory_start = (uintptr_t)mem.start_of_memory_slices();
    cb->execution_thread_memory_length = mem.size_of_memory_slice_mapping();
    cb->ctx = &context;
@@ -177,18 +265,23 @@ void executor::execute(const code_descriptor& code, const memory& mem, apply_con
    cb->full_linear_memory_start = (char*)mem.full_page_memory_base();
    cb->jmp = &executors_sigjmp_buf;
    cb->bounce_buffers = &executors_bounce_buffers;
-   cb->running_code_base = (uintptr_t)(code_mapping + code.code_begin);
+   cb->running_code_base = (uintptr_t)code_base;
+   cb->deadline_poll_interval = deadline_poll_interval;
+   cb->deadline_poll_countdown = deadline_poll_interval ? deadline_poll_interval : UINT32_MAX;
    cb->is_running = true;
 
    context.trx_context.transaction_timer.set_expiration_callback([](void* user) {
       executor* self = (executor*)user;
       syscall(SYS_mprotect, self->code_mapping, self->code_mapping_size, PROT_NONE);
+      if(self->hot_code)
+         syscall(SYS_mprotect, self->hot_code, self->hot_code_size, PROT_NONE);
       self->mapping_is_executable = false;
    }, this);
    context.trx_context.checktime(); //catch any expiration that might have occurred before setting up callback
 
-   auto cleanup = fc::make_scoped_exit([cb, &tt=context.trx_context.transaction_timer](){
+   auto cleanup = fc::make_scoped_exit([cb, &mem, &tt=context.trx_context.transaction_timer](){
       cb->is_running = false;
+      mem.touched_pages(cb->current_linear_memory_pages);
       cb->bounce_buffers->clear();
       tt.set_expiration_callback(nullptr, nullptr);
    });
@@ -225,6 +318,8 @@ void executor::execute(const code_descriptor& code, const memory& mem, apply_con
 
 executor::~executor() {
    arch_prctl(ARCH_SET_GS, nullptr);
+   if(hot_code)
+      munmap(hot_code, hot_code_size);
 }
 
 }}}
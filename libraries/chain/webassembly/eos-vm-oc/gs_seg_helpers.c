@@ -43,4 +43,15 @@ void* eos_vm_oc_get_exception_ptr() {
 void* eos_vm_oc_get_bounce_buffer_list() {
    EOSVMOC_MEMORY_PTR_cb_ptr;
    return cb_ptr->bounce_buffers;
-}
\ No newline at end of file
+}
+
+void* eos_vm_oc_get_apply_context() {
+   EOSVMOC_MEMORY_PTR_cb_ptr;
+   return cb_ptr->ctx;
+}
+
+unsigned eos_vm_oc_restart_deadline_poll() {
+   EOSVMOC_MEMORY_PTR_cb_ptr;
+   cb_ptr->deadline_poll_countdown = cb_ptr->deadline_poll_interval ? cb_ptr->deadline_poll_interval : UINT32_MAX;
+   return cb_ptr->deadline_poll_interval;
+}
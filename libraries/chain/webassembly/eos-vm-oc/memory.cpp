@@ -2,7 +2,9 @@
 #include <eosio/chain/webassembly/eos-vm-oc/intrinsic.hpp>
 
 #include <fc/scoped_exit.hpp>
+#include <fc/log/logger_config.hpp> //set_thread_name
 
+#include <string.h>
 #include <unistd.h>
 #include <sys/syscall.h>
 #include <sys/mman.h>
@@ -44,4 +46,73 @@ memory::~memory() {
    munmap(mapbase, mapsize);
 }
 
+void memory::zero_pages(uint32_t pages) {
+   if(pages > dirty)
+      pages = dirty;
+   memset(fullpage_base, 0, 64u*1024u*pages);
+   if(pages == dirty)
+      dirty = 0;
+}
+
+memory_pool::memory_pool(size_t size) {
+   FC_ASSERT(size >= 1, "EOS VM OC memory pool needs at least one memory");
+   for(size_t i = 0; i < size; ++i) {
+      _memories.emplace_back(std::make_unique<memory>());
+      _clean.push_back(_memories.back().get());
+   }
+   if(size > 1)
+      _thread = std::thread([this]() {
+         fc::set_os_thread_name("oc-memzero");
+         zero_loop();
+      });
+}
+
+memory_pool::~memory_pool() {
+   {
+      std::lock_guard<std::mutex> g(_mtx);
+      _done = true;
+   }
+   _cv.notify_all();
+   if(_thread.joinable())
+      _thread.join();
+}
+
+memory& memory_pool::acquire() {
+   std::unique_lock<std::mutex> g(_mtx);
+   //with a single memory, or all others being zeroed, wait for the zeroing thread instead of sharing the memory
+   _cv.wait(g, [this]() { return !_clean.empty() || !_dirty.empty(); });
+   std::deque<memory*>& from = _clean.empty() ? _dirty : _clean;
+   memory* mem = from.front();
+   from.pop_front();
+   return *mem;
+}
+
+void memory_pool::release(memory& mem) {
+   {
+      std::lock_guard<std::mutex> g(_mtx);
+      if(mem.dirty_pages() == 0 || !_thread.joinable()) {
+         _clean.push_back(&mem);
+         return;
+      }
+      _dirty.push_back(&mem);
+   }
+   _cv.notify_all();
+}
+
+void memory_pool::zero_loop() {
+   std::unique_lock<std::mutex> g(_mtx);
+   while(true) {
+      _cv.wait(g, [this]() { return _done || !_dirty.empty(); });
+      if(_done)
+         return;
+      memory* mem = _dirty.front();
+      _dirty.pop_front();
+      g.unlock();
+      mem->zero_pages(mem->dirty_pages());
+      g.lock();
+      _clean.push_back(mem);
+      _cv.notify_all();
+   }
+}
+
 }}}
\ No newline at end of file
@@ -0,0 +1,218 @@
+#include <eosio/chain/webassembly/eos-vm-oc/profile.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/memory.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/eos-vm-oc.h>
+
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger_config.hpp> //set_os_thread_name()
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+#include <asm/prctl.h>
+#include <signal.h>
+#include <string.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+namespace eosio { namespace chain { namespace eosvmoc {
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free, "Only lock-free atomics AS-safe.");
+
+static constexpr auto write_interval = std::chrono::seconds(10);
+
+static std::mutex instance_mutex;
+static profiler* instance;
+
+profiler::profiler(const boost::filesystem::path& dir, uint32_t interval_us) : _dir(dir), _ring(new sample[ring_size]) {
+   FC_ASSERT(interval_us > 0, "EOS VM OC profile interval must be positive");
+   boost::filesystem::create_directories(_dir);
+
+   {
+      std::lock_guard g(instance_mutex);
+      FC_ASSERT(instance == nullptr, "only one EOS VM OC profiler may exist");
+      instance = this;
+   }
+
+   struct sigaction act;
+   sigemptyset(&act.sa_mask);
+   act.sa_sigaction = sig_handler;
+   act.sa_flags = SA_SIGINFO | SA_RESTART;
+   FC_ASSERT(sigaction(SIGPROF, &act, NULL) == 0, "failed to aquire SIGPROF signal");
+
+   struct sigevent se;
+   memset(&se, 0, sizeof(se));
+   se.sigev_notify = SIGEV_THREAD_ID;
+   se.sigev_signo = SIGPROF;
+   se.sigev_value.sival_ptr = (void*)this;
+   se.sigev_notify_thread_id = syscall(SYS_gettid);
+   FC_ASSERT(timer_create(CLOCK_THREAD_CPUTIME_ID, &se, &_timerid) == 0, "failed to create profile timer");
+
+   _thread = std::thread([this]() {
+      fc::set_os_thread_name("oc-profile");
+      drain_loop();
+   });
+
+   struct itimerspec enable = {{interval_us/1000000, (interval_us%1000000)*1000}, {interval_us/1000000, (interval_us%1000000)*1000}};
+   FC_ASSERT(timer_settime(_timerid, 0, &enable, NULL) == 0, "failed to start profile timer");
+}
+
+profiler::~profiler() {
+   timer_delete(_timerid);
+   {
+      std::lock_guard g(instance_mutex);
+      instance = nullptr;
+   }
+   {
+      std::lock_guard g(_mtx);
+      _done = true;
+   }
+   _cv.notify_one();
+   _thread.join();
+}
+
+std::vector<uint8_t> profiler::pack_function_offsets(const std::map<unsigned, uintptr_t>& def_offsets, uint32_t imported_functions) {
+   std::vector<uint8_t> packed(def_offsets.size()*2*sizeof(uint32_t));
+   uint8_t* p = packed.data();
+   for(const auto& [def, offset] : def_offsets) {
+      const uint32_t entry[2] = {(uint32_t)offset, (uint32_t)(def+imported_functions)};
+      memcpy(p, entry, sizeof(entry));
+      p += sizeof(entry);
+   }
+   return packed;
+}
+
+void profiler::add_function_offsets(const digest_type& code_hash, const std::vector<uint8_t>& packed) {
+   std::vector<std::pair<uint32_t, uint32_t>> offsets(packed.size()/(2*sizeof(uint32_t)));
+   for(size_t i = 0; i < offsets.size(); ++i) {
+      uint32_t entry[2];
+      memcpy(entry, packed.data() + i*sizeof(entry), sizeof(entry));
+      offsets[i] = {entry[0], entry[1]};
+   }
+   std::sort(offsets.begin(), offsets.end());
+
+   std::lock_guard g(instance_mutex);
+   if(instance == nullptr)
+      return;
+   std::lock_guard og(instance->_offsets_mtx);
+   instance->_function_offsets[code_hash] = std::move(offsets);
+}
+
+void profiler::sig_handler(int, siginfo_t* si, void* ctx) {
+   profiler* self = (profiler*)si->si_value.sival_ptr;
+   self->record(((ucontext_t*)ctx)->uc_mcontext.gregs[REG_RIP]);
+}
+
+void profiler::record(uintptr_t ip) {
+   if(!_in_code)
+      return;
+   std::atomic_signal_fence(std::memory_order_acquire);
+
+   //same check as the segv handler: the executor points GS at the memory of the running code
+   uint64_t current_gs;
+   syscall(SYS_arch_prctl, ARCH_GET_GS, &current_gs);
+   if(current_gs == 0)
+      return;
+   const control_block* cb = reinterpret_cast<const control_block*>(current_gs - memory::cb_offset);
+   if(cb->is_running == false)
+      return;
+
+   const uint32_t head = _head.load(std::memory_order_relaxed);
+   if(head - _tail.load(std::memory_order_acquire) >= ring_size) {
+      ++_dropped;
+      return;
+   }
+   sample& s = _ring[head % ring_size];
+   s.code_hash = _current_code;
+   s.in_host = ip < cb->running_code_base || ip >= cb->execution_thread_code_start + cb->execution_thread_code_length;
+   s.offset = s.in_host ? 0 : ip - cb->running_code_base;
+   _head.store(head+1, std::memory_order_release);
+}
+
+void profiler::drain_loop() {
+   auto next_write = std::chrono::steady_clock::now() + write_interval;
+   std::unique_lock g(_mtx);
+   while(!_done) {
+      _cv.wait_for(g, std::chrono::milliseconds(100));
+      drain();
+      if(std::chrono::steady_clock::now() >= next_write) {
+         write_profiles();
+         next_write = std::chrono::steady_clock::now() + write_interval;
+      }
+   }
+   drain();
+   write_profiles();
+}
+
+void profiler::drain() {
+   uint32_t tail = _tail.load(std::memory_order_relaxed);
+   const uint32_t head = _head.load(std::memory_order_acquire);
+   for(; tail != head; ++tail) {
+      const sample& s = _ring[tail % ring_size];
+      code_profile& p = _profiles[s.code_hash];
+      if(s.in_host)
+         ++p.host;
+      else
+         ++p.offsets[s.offset];
+      p.dirty = true;
+   }
+   _tail.store(tail, std::memory_order_release);
+}
+
+void profiler::write_profiles() {
+   if(auto dropped = _dropped.exchange(0))
+      wlog("EOS VM OC profiler dropped ${d} samples", ("d", dropped));
+
+   for(auto& [code_hash, p] : _profiles) {
+      if(!p.dirty)
+         continue;
+      p.dirty = false;
+
+      std::vector<std::pair<uint32_t, uint32_t>> functions;
+      {
+         std::lock_guard g(_offsets_mtx);
+         auto it = _function_offsets.find(code_hash);
+         if(it != _function_offsets.end())
+            functions = it->second;
+      }
+
+      std::map<std::string, uint64_t> frames;
+      if(p.host)
+         frames["[host]"] = p.host;
+      for(const auto& [offset, count] : p.offsets) {
+         //the function starting last at or before the offset
+         auto f = std::upper_bound(functions.begin(), functions.end(), std::make_pair(offset, UINT32_MAX));
+         if(f == functions.begin())
+            frames["[unknown]"] += count;
+         else
+            frames["wasm-function[" + std::to_string(std::prev(f)->second) + "]"] += count;
+      }
+
+      try {
+         const boost::filesystem::path file = _dir / (code_hash.str() + ".folded");
+         const boost::filesystem::path tmp = _dir / (code_hash.str() + ".folded.tmp");
+         {
+            boost::filesystem::ofstream out(tmp, std::ios::trunc);
+            for(const auto& [frame, count] : frames)
+               out << frame << ' ' << count << '\n';
+            FC_ASSERT(out.good(), "failed to write ${f}", ("f", tmp.string()));
+         }
+         boost::filesystem::rename(tmp, file);
+      }
+      catch(const fc::exception& e) {
+         wlog("EOS VM OC profiler failed to write profile of ${c}: ${e}", ("c", code_hash)("e", e.to_detail_string()));
+      }
+      catch(const std::exception& e) {
+         wlog("EOS VM OC profiler failed to write profile of ${c}: ${e}", ("c", code_hash)("e", e.what()));
+      }
+   }
+}
+
+}}}
@@ -1,5 +1,6 @@
 #pragma once
 #include <eosio/chain/controller.hpp>
+#include <eosio/chain/snapshot.hpp>
 #include <eosio/chain/asset.hpp>
 #include <eosio/chain/contract_table_objects.hpp>
 #include <eosio/chain/account_object.hpp>
@@ -137,6 +138,18 @@ namespace eosio { namespace testing {
       };
    }
 
+   /**
+    * State of a tester right after execute_setup_policy, shared by the testers started from it, see
+    * base_tester::get_setup_fixture
+    */
+   struct setup_fixture {
+      std::string                                   snapshot;
+      fc::optional<fc::time_point>                  pending_block_time;
+      vector<packed_transaction>                    pending_transactions;
+      map<account_name, block_id_type>              last_produced_block;
+      map<transaction_id_type, transaction_receipt> chain_transactions;
+   };
+
    /**
     *  @class tester
     *  @brief provides utility function to simplify the creation of unit tests
@@ -159,8 +172,17 @@ namespace eosio { namespace testing {
          void              init(controller::config config, protocol_feature_set&& pfs, const snapshot_reader_ptr& snapshot);
          void              init(controller::config config, protocol_feature_set&& pfs, const genesis_state& genesis);
          void              init(controller::config config, protocol_feature_set&& pfs);
+         void              init(controller::config config, const setup_fixture& fixture);
          void              execute_setup_policy(const setup_policy policy);
 
+         /**
+          * With --snapshot-fixture on the test command line, the state after execute_setup_policy is built once for
+          * each policy, genesis and config, kept as an in memory snapshot, and testers start from it instead of
+          * executing the setup again. Their block log then starts after the setup blocks. Returns null when it is
+          * not enabled or the setup can not be shared, e.g. in another read mode, the tester executing it then.
+          */
+         static std::shared_ptr<const setup_fixture> get_setup_fixture( setup_policy policy, const controller::config& conf, const genesis_state& genesis );
+
          void              close();
          template <typename Lambda>
          void              open( protocol_feature_set&& pfs, fc::optional<chain_id_type> expected_chain_id, Lambda lambda );
@@ -533,6 +555,12 @@ namespace eosio { namespace testing {
          config_validator(vcfg);
          vcfg.trusted_producers = trusted_producers;
 
+         if( auto fixture = get_setup_fixture(setup_policy::full, def_conf.first, def_conf.second) ) {
+            validating_node = create_validating_node(vcfg, *fixture);
+            init(def_conf.first, *fixture);
+            return;
+         }
+
          validating_node = create_validating_node(vcfg, def_conf.second, true);
 
          init(def_conf.first, def_conf.second);
@@ -561,6 +589,16 @@ namespace eosio { namespace testing {
          return validating_node;
       }
 
+      static unique_ptr<controller> create_validating_node(controller::config vcfg, const setup_fixture& fixture) {
+         std::istringstream in(fixture.snapshot);
+         auto snapshot = std::make_shared<istream_snapshot_reader>(in);
+         unique_ptr<controller> validating_node = std::make_unique<controller>(vcfg, make_protocol_feature_set(), controller::extract_chain_id(*snapshot));
+         snapshot->return_to_header();
+         validating_node->add_indices();
+         validating_node->startup( []() { return false; }, snapshot );
+         return validating_node;
+      }
+
       validating_tester(const fc::temp_directory& tempdir, bool use_genesis) {
          auto def_conf = default_config(tempdir);
          vcfg = def_conf.first;
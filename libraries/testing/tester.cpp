@@ -155,10 +155,85 @@ namespace eosio { namespace testing {
       def_conf.first.read_mode = read_mode;
       cfg = def_conf.first;
 
+      if( auto fixture = get_setup_fixture(policy, def_conf.first, def_conf.second) ) {
+         init(def_conf.first, *fixture);
+         return;
+      }
+
       open(def_conf.second);
       execute_setup_policy(policy);
    }
 
+   void base_tester::init(controller::config config, const setup_fixture& fixture) {
+      cfg = config;
+      std::istringstream in(fixture.snapshot);
+      open(std::make_shared<istream_snapshot_reader>(in));
+
+      last_produced_block = fixture.last_produced_block;
+      chain_transactions.insert(fixture.chain_transactions.begin(), fixture.chain_transactions.end());
+      if( fixture.pending_block_time ) {
+         _start_block(*fixture.pending_block_time);
+         for( auto trx : fixture.pending_transactions )
+            push_transaction(trx);
+      }
+   }
+
+   namespace {
+      bool snapshot_fixture_enabled() {
+         const auto& suite = boost::unit_test::framework::master_test_suite();
+         for( int i = 0; i < suite.argc; ++i ) {
+            if( suite.argv[i] == std::string("--snapshot-fixture") )
+               return true;
+         }
+         return false;
+      }
+   }
+
+   std::shared_ptr<const setup_fixture> base_tester::get_setup_fixture( setup_policy policy, const controller::config& conf, const genesis_state& genesis ) {
+      static const bool enabled = snapshot_fixture_enabled();
+      static std::map<std::string, std::shared_ptr<const setup_fixture>> fixtures;
+
+      // a snapshot holds the head block, the other read modes would start elsewhere
+      if( !enabled || policy == setup_policy::none || conf.read_mode != db_read_mode::SPECULATIVE )
+         return {};
+
+      // what default_config lets differ between the testers sharing a fixture
+      const auto key = fc::json::to_string( fc::mutable_variant_object()
+         ( "policy", static_cast<uint32_t>(policy) )
+         ( "genesis", genesis )
+         ( "wasm_runtime", static_cast<uint32_t>(conf.wasm_runtime) )
+         ( "max_nonprivileged_inline_action_size", conf.max_nonprivileged_inline_action_size ) );
+      auto itr = fixtures.find( key );
+      if( itr != fixtures.end() )
+         return itr->second;
+
+      fc::temp_directory dir;
+      auto builder_config = conf;
+      builder_config.blocks_dir = dir.path() / config::default_blocks_dir_name;
+      builder_config.state_dir  = dir.path() / config::default_state_dir_name;
+      tester builder( builder_config, genesis );
+      builder.execute_setup_policy( policy );
+
+      auto fixture = std::make_shared<setup_fixture>();
+      if( builder.control->is_building_block() ) {
+         fixture->pending_block_time = builder.control->pending_block_time();
+         for( const auto& trx : builder.control->abort_block() )
+            fixture->pending_transactions.emplace_back( *trx->packed_trx() );
+      }
+
+      std::ostringstream out;
+      auto writer = std::make_shared<ostream_snapshot_writer>( out );
+      builder.control->write_snapshot( writer );
+      writer->finalize();
+      fixture->snapshot = out.str();
+
+      const base_tester& b = builder;
+      fixture->last_produced_block = b.last_produced_block;
+      fixture->chain_transactions = b.chain_transactions;
+
+      return fixtures.emplace( key, std::move(fixture) ).first->second;
+   }
+
    void base_tester::init(controller::config config, const snapshot_reader_ptr& snapshot) {
       cfg = config;
       open(snapshot);
@@ -466,7 +541,7 @@ namespace eosio { namespace testing {
    void base_tester::produce_min_num_of_blocks_to_spend_time_wo_inactive_prod(const fc::microseconds target_elapsed_time) {
       fc::microseconds elapsed_time;
       while (elapsed_time < target_elapsed_time) {
-         for(uint32_t i = 0; i < control->head_block_state()->active_schedule.producers.size(); i++) {
+         for(uint32_t i = 0; i < control->head_block_state()->active_schedule->producers.size(); i++) {
             const auto time_to_skip = fc::milliseconds(config::producer_repetitions * config::block_interval_ms);
             produce_block(time_to_skip);
             elapsed_time += time_to_skip;
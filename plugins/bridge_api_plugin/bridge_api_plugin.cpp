@@ -0,0 +1,47 @@
+#include <fc/variant.hpp>
+#include <fc/io/json.hpp>
+#include <eosio/bridge_api_plugin/bridge_api_plugin.hpp>
+
+namespace eosio {
+
+static appbase::abstract_plugin& _bridge_api_plugin = app().register_plugin<bridge_api_plugin>();
+
+using namespace eosio;
+
+#define CALL(api_name, api_handle, call_name, INVOKE, http_response_code) \
+{std::string("/v1/" #api_name "/" #call_name), \
+   [&api_handle](string, string body, url_response_callback cb) mutable { \
+          try { \
+             if (body.empty()) body = "{}"; \
+             INVOKE \
+             cb(http_response_code, fc::variant(result)); \
+          } catch (...) { \
+             http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+          } \
+       }}
+
+#define INVOKE_R_R(api_handle, call_name, in_param) \
+     auto result = api_handle.call_name(fc::json::from_string(body).as<in_param>());
+
+#define INVOKE_R_V(api_handle, call_name) \
+     auto result = api_handle.call_name();
+
+
+void bridge_api_plugin::plugin_startup() {
+   ilog("starting bridge_api_plugin");
+   // lifetime of plugin is lifetime of application
+   auto& bridge = app().get_plugin<bridge_plugin>();
+
+   app().get_plugin<http_plugin>().add_api({
+       CALL(bridge, bridge, get_metrics,
+            INVOKE_R_V(bridge, get_metrics), 200),
+       CALL(bridge, bridge, get_proofs,
+            INVOKE_R_R(bridge, get_proofs, bridge_get_proofs_params), 200),
+   });
+}
+
+#undef INVOKE_R_R
+#undef INVOKE_R_V
+#undef CALL
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <eosio/bridge_plugin/bridge_plugin.hpp>
+#include <eosio/http_plugin/http_plugin.hpp>
+
+#include <appbase/application.hpp>
+
+namespace eosio {
+
+using namespace appbase;
+
+class bridge_api_plugin : public plugin<bridge_api_plugin> {
+public:
+   APPBASE_PLUGIN_REQUIRES((bridge_plugin) (http_plugin))
+
+   bridge_api_plugin() = default;
+   bridge_api_plugin(const bridge_api_plugin&) = delete;
+   bridge_api_plugin(bridge_api_plugin&&) = delete;
+   bridge_api_plugin& operator=(const bridge_api_plugin&) = delete;
+   bridge_api_plugin& operator=(bridge_api_plugin&&) = delete;
+   virtual ~bridge_api_plugin() override = default;
+
+   virtual void set_program_options(options_description& cli, options_description& cfg) override {}
+   void plugin_initialize(const variables_map& vm) {}
+   void plugin_startup();
+   void plugin_shutdown() {}
+
+private:
+};
+
+}
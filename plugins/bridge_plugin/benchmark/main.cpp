@@ -0,0 +1,205 @@
+/**
+ * Floods a tester chain with eosio.token transfers to and from bifrostcross and relays them with bridge_plugin,
+ * whose bifrost rpc client is replaced by mock_bifrost_rpc. Prints one line
+ *    bridge_relay_benchmark {...}
+ * with the capture to submission latency, the memory held per pending entry and the transfers/sec the relay
+ * finalized. Options of bridge_plugin are accepted as well, e.g. --bridge-batch-size or --bridge-max-in-flight.
+ */
+#include <eosio/bridge_plugin/bridge_plugin.hpp>
+#include <eosio/testing/tester.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include <contracts.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#include "mock_bifrost_rpc.hpp"
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+using mvo = fc::mutable_variant_object;
+namespace bpo = boost::program_options;
+
+struct bridge_relay_benchmark_result {
+   uint32_t transfers = 0;
+   uint32_t mock_latency_ms = 0;
+   uint64_t captured = 0;
+   uint64_t finalized = 0;
+   uint64_t ffi_calls = 0;
+   double   capture_to_submitted_avg_ms = 0;
+   uint64_t capture_to_submitted_p99_ms = 0;  ///< upper bound of the histogram bucket
+   double   submitted_to_finalized_avg_ms = 0;
+   uint32_t max_pending = 0;                  ///< entries not finalized yet
+   double   entry_bytes_per_pending = 0;      ///< packed entries, at max_pending
+   double   window_bytes_per_pending = 0;     ///< blocks kept to prove them, at max_pending
+   double   generated_per_sec = 0;
+   double   finalized_per_sec = 0;            ///< from the first transfer until all are finalized
+   bool     drained = false;                  ///< every captured transfer finalized before the timeout
+};
+FC_REFLECT( bridge_relay_benchmark_result, (transfers)(mock_latency_ms)(captured)(finalized)(ffi_calls)
+            (capture_to_submitted_avg_ms)(capture_to_submitted_p99_ms)(submitted_to_finalized_avg_ms)(max_pending)
+            (entry_bytes_per_pending)(window_bytes_per_pending)(generated_per_sec)(finalized_per_sec)(drained) )
+
+namespace {
+
+double average_ms(const bridge_latency_histogram &h) {
+   return h.count ? double(h.sum_ms) / h.count : 0;
+}
+
+uint64_t percentile_ms(const bridge_latency_histogram &h, uint32_t p) {
+   const uint64_t rank = (h.count * p + 99) / 100;
+   uint64_t seen = 0;
+   for (size_t i = 0; i < h.counts.size(); ++i) {
+      seen += h.counts[i];
+      if (seen >= rank && seen > 0)
+         return i < h.bounds_ms.size() ? h.bounds_ms[i] : UINT64_MAX;
+   }
+   return 0;
+}
+
+// runs the timers of the relay and the completions its submission threads posted back, as application::exec does
+void pump() {
+   auto &ios = app().get_io_service();
+   if (ios.stopped()) ios.restart();
+   bool more = true;
+   while (more) {
+      while (ios.poll_one()) {}
+      more = app().get_priority_queue().execute_highest();
+   }
+}
+
+uint32_t pending(const bridge_metrics &m) {
+   return m.prove_actions.collecting + m.prove_actions.ready + m.prove_actions.submitting;
+}
+
+}
+
+int main(int argc, char **argv) {
+   try {
+      bpo::options_description cli("bridge_relay_benchmark"), cfg;
+      auto &bridge = app().get_plugin<bridge_plugin>();
+      bridge.set_program_options(cli, cfg);
+      cli.add_options()
+         ("transfers", bpo::value<uint32_t>()->default_value(5000), "Number of transfers generated")
+         ("transfers-per-block", bpo::value<uint32_t>()->default_value(100), "Transfers in each block")
+         ("outgoing-percent", bpo::value<uint32_t>()->default_value(50), "Percentage of the transfers sent by bifrostcross, the others are sent to it")
+         ("mock-latency-ms", bpo::value<uint32_t>()->default_value(200), "Time the mock bifrost takes to finalize each extrinsic")
+         ("drain-timeout-sec", bpo::value<uint32_t>()->default_value(300), "Maximum time waited for the relay to finalize every transfer")
+         ("help,h", "Print this help");
+      cli.add(cfg);
+
+      bpo::variables_map vm;
+      bpo::store(bpo::parse_command_line(argc, argv, cli), vm);
+      bpo::notify(vm);
+      if (vm.count("help")) {
+         std::cout << cli << std::endl;
+         return 0;
+      }
+
+      bridge_relay_benchmark_result r;
+      r.transfers = vm.at("transfers").as<uint32_t>();
+      r.mock_latency_ms = vm.at("mock-latency-ms").as<uint32_t>();
+      const uint32_t per_block = std::max<uint32_t>(1, vm.at("transfers-per-block").as<uint32_t>());
+      const uint32_t outgoing_percent = vm.at("outgoing-percent").as<uint32_t>();
+      mock_bifrost_rpc::set_latency(std::chrono::milliseconds(r.mock_latency_ms));
+
+      // the relay keeps its database under the data dir of the application, which is the working directory here
+      fc::temp_directory data_dir;
+      boost::filesystem::current_path(data_dir.path());
+
+      tester chain;
+      const account_name cross = account_name(vm.at("bifrost-crossaccount").as<std::string>());
+      chain.create_accounts({N(eosio.token), cross, N(alice)});
+      chain.set_code(N(eosio.token), contracts::eosio_token_wasm());
+      chain.set_abi(N(eosio.token), contracts::eosio_token_abi().data());
+      chain.push_action(N(eosio.token), N(create), N(eosio.token), mvo()
+         ("issuer", "alice")
+         ("maximum_supply", "1000000000.0000 EOS"));
+      chain.push_action(N(eosio.token), N(issue), N(alice), mvo()
+         ("to", "alice")
+         ("quantity", "1000000000.0000 EOS")
+         ("memo", ""));
+      chain.push_action(N(eosio.token), N(transfer), N(alice), mvo()
+         ("from", "alice")
+         ("to", cross)
+         ("quantity", "500000000.0000 EOS")
+         ("memo", ""));
+      chain.produce_blocks(2);
+
+      bridge.plugin_initialize(vm, *chain.control);
+      bridge.plugin_startup();
+      pump();
+
+      const auto start = fc::time_point::now();
+      bridge_metrics m;
+      auto sample = [&]() {
+         m = bridge.get_metrics();
+         const uint32_t p = pending(m);
+         if (p > r.max_pending) {
+            r.max_pending = p;
+            const uint32_t entries = p + m.prove_actions.sent;
+            r.entry_bytes_per_pending = entries ? double(m.entry_bytes) / entries : 0;
+            r.window_bytes_per_pending = double(m.window_bytes) / p;
+         }
+      };
+
+      for (uint32_t i = 0; i < r.transfers; ++i) {
+         const bool outgoing = i % 100 < outgoing_percent;
+         const account_name from = outgoing ? cross : N(alice);
+         const account_name to = outgoing ? N(alice) : cross;
+         chain.push_action(N(eosio.token), N(transfer), from, mvo()
+            ("from", from)
+            ("to", to)
+            ("quantity", "0.0001 EOS")
+            ("memo", std::to_string(i) + "@bifrost:vEOS"));
+         if ((i + 1) % per_block == 0) {
+            chain.produce_block();
+            pump();
+            sample();
+         }
+      }
+      const auto generated = fc::time_point::now();
+      r.generated_per_sec = r.transfers / std::max(1e-6, (generated - start).count() / 1e6);
+
+      // empty blocks finish the header windows of the last transfers
+      const auto deadline = generated + fc::seconds(vm.at("drain-timeout-sec").as<uint32_t>());
+      do {
+         chain.produce_block();
+         pump();
+         sample();
+         std::this_thread::sleep_for(std::chrono::milliseconds(10));
+         r.drained = pending(m) == 0 && m.prove_actions.sent > 0;
+      } while (!r.drained && fc::time_point::now() < deadline);
+      const auto end = fc::time_point::now();
+
+      const auto &lat = m.prove_action_latencies;
+      r.captured = lat.capture_to_ready.count + m.prove_actions.collecting;
+      r.finalized = lat.submitted_to_finalized.count;
+      const auto calls = mock_bifrost_rpc::stats();
+      r.ffi_calls = calls.prove_action_calls + calls.prove_action_batch_calls + calls.change_schedule_calls;
+      r.capture_to_submitted_avg_ms = average_ms(lat.capture_to_ready) + average_ms(lat.ready_to_submitted);
+      r.capture_to_submitted_p99_ms = percentile_ms(lat.capture_to_ready, 99) + percentile_ms(lat.ready_to_submitted, 99);
+      r.submitted_to_finalized_avg_ms = average_ms(lat.submitted_to_finalized);
+      r.finalized_per_sec = r.finalized / std::max(1e-6, (end - start).count() / 1e6);
+
+      bridge.plugin_shutdown();
+      boost::filesystem::current_path(data_dir.path().parent_path());
+
+      std::cout << "bridge_relay_benchmark " << fc::json::to_string(r, fc::time_point::maximum()) << std::endl;
+      return r.drained ? 0 : 1;
+   } catch (const fc::exception &e) {
+      std::cerr << e.to_detail_string() << std::endl;
+   } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+   }
+   return 2;
+}
@@ -0,0 +1,166 @@
+// Stands in for the rust rpc client of bifrost_rpc.h, so the relay runs without a bifrost chain.
+
+#include "mock_bifrost_rpc.hpp"
+#include "bifrost_rpc.h"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace eosio { namespace mock_bifrost_rpc {
+
+static std::atomic<int64_t>  latency_ms{0};
+static std::atomic<uint64_t> prove_action_calls{0};
+static std::atomic<uint64_t> prove_action_batch_calls{0};
+static std::atomic<uint64_t> proved_actions{0};
+static std::atomic<uint64_t> change_schedule_calls{0};
+static std::atomic<uint64_t> extrinsics{0};
+
+void set_latency(std::chrono::milliseconds latency) {
+   latency_ms = latency.count();
+}
+
+call_stats stats() {
+   call_stats s;
+   s.prove_action_calls = prove_action_calls;
+   s.prove_action_batch_calls = prove_action_batch_calls;
+   s.proved_actions = proved_actions;
+   s.change_schedule_calls = change_schedule_calls;
+   return s;
+}
+
+static rpc_result *make_result(bool success, const std::string &msg) {
+   auto result = static_cast<rpc_result *>(std::malloc(sizeof(rpc_result)));
+   result->success = success;
+   result->msg = strdup(msg.c_str());
+   return result;
+}
+
+// the hash of the finalized extrinsic
+static rpc_result *finalized() {
+   std::this_thread::sleep_for(std::chrono::milliseconds(latency_ms.load()));
+   return make_result(true, "0xmock" + std::to_string(++extrinsics));
+}
+
+// stands in for the runtime of the rpc client, submissions wait on timers instead of holding a thread
+struct runtime {
+   boost::asio::io_context                                                   ctx;
+   boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work{ctx.get_executor()};
+   std::vector<std::thread>                                                  threads;
+};
+static std::mutex               runtime_mtx;
+static std::unique_ptr<runtime> rt;
+
+static void submit(rpc_callback callback, void *user_data) {
+   std::lock_guard<std::mutex> g(runtime_mtx);
+   if (!rt) {
+      callback(make_result(false, "bifrost rpc runtime is not started"), user_data);
+      return;
+   }
+   auto timer = std::make_shared<boost::asio::steady_timer>(rt->ctx, std::chrono::milliseconds(latency_ms.load()));
+   timer->async_wait([timer, callback, user_data](const boost::system::error_code &ec) {
+      if (ec) return; // dropped by stop_rpc_runtime
+      callback(make_result(true, "0xmock" + std::to_string(++extrinsics)), user_data);
+   });
+}
+
+} }
+
+using namespace eosio;
+
+extern "C" {
+
+rpc_result *init_client_pool(const char *) {
+   return mock_bifrost_rpc::make_result(true, "[{\"url\":\"mock\",\"healthy\":true}]");
+}
+
+rpc_result *check_client_pool() {
+   return mock_bifrost_rpc::make_result(true, "[{\"url\":\"mock\",\"healthy\":true}]");
+}
+
+void free_rpc_result(rpc_result *result) {
+   if (!result) return;
+   std::free(result->msg);
+   std::free(result);
+}
+
+rpc_result *change_schedule(const char *, const char *, const digest_type, const char *, size_t, const char *, size_t,
+                            const char *, size_t, const char *, size_t) {
+   ++mock_bifrost_rpc::change_schedule_calls;
+   return mock_bifrost_rpc::finalized();
+}
+
+rpc_result *prove_action(const char *, const char *, const action_ffi *, const incremental_merkle_ffi *,
+                         const action_receipt_ffi *, const block_id_type_list *, const signed_block_header_ffi *, size_t,
+                         const block_id_type_list *, size_t, const transaction_id_type) {
+   ++mock_bifrost_rpc::prove_action_calls;
+   ++mock_bifrost_rpc::proved_actions;
+   return mock_bifrost_rpc::finalized();
+}
+
+rpc_result *prove_action_batch(const char *, const char *, const prove_action_item_ffi *, size_t items_size,
+                               const incremental_merkle_ffi *, const signed_block_header_ffi *, size_t,
+                               const block_id_type_list *, size_t) {
+   ++mock_bifrost_rpc::prove_action_batch_calls;
+   mock_bifrost_rpc::proved_actions += items_size;
+   return mock_bifrost_rpc::finalized();
+}
+
+rpc_result *start_rpc_runtime(size_t worker_threads) {
+   std::lock_guard<std::mutex> g(mock_bifrost_rpc::runtime_mtx);
+   if (!mock_bifrost_rpc::rt) {
+      mock_bifrost_rpc::rt = std::make_unique<mock_bifrost_rpc::runtime>();
+      for (size_t i = 0; i < std::max<size_t>(1, worker_threads); ++i)
+         mock_bifrost_rpc::rt->threads.emplace_back([ctx = &mock_bifrost_rpc::rt->ctx]() { ctx->run(); });
+   }
+   return mock_bifrost_rpc::make_result(true, "bifrost rpc runtime is started");
+}
+
+void stop_rpc_runtime() {
+   std::unique_ptr<mock_bifrost_rpc::runtime> r;
+   {
+      std::lock_guard<std::mutex> g(mock_bifrost_rpc::runtime_mtx);
+      r = std::move(mock_bifrost_rpc::rt);
+   }
+   if (!r) return;
+   r->ctx.stop();
+   for (auto &t : r->threads) t.join();
+}
+
+// the mock chain requests no redeems
+rpc_result *subscribe_redeem_events(const char *, uint32_t, rpc_callback, void *) {
+   return mock_bifrost_rpc::make_result(true, "subscribed to bifrost redeem events");
+}
+
+void submit_change_schedule(const char *, const char *, const digest_type, const char *, size_t, const char *, size_t,
+                            const char *, size_t, const char *, size_t, rpc_callback callback, void *user_data) {
+   ++mock_bifrost_rpc::change_schedule_calls;
+   mock_bifrost_rpc::submit(callback, user_data);
+}
+
+void submit_prove_action(const char *, const char *, const action_ffi *, const incremental_merkle_ffi *,
+                         const action_receipt_ffi *, const block_id_type_list *, const signed_block_header_ffi *, size_t,
+                         const block_id_type_list *, size_t, const transaction_id_type, rpc_callback callback, void *user_data) {
+   ++mock_bifrost_rpc::prove_action_calls;
+   ++mock_bifrost_rpc::proved_actions;
+   mock_bifrost_rpc::submit(callback, user_data);
+}
+
+void submit_prove_action_batch(const char *, const char *, const prove_action_item_ffi *, size_t items_size,
+                               const incremental_merkle_ffi *, const signed_block_header_ffi *, size_t,
+                               const block_id_type_list *, size_t, rpc_callback callback, void *user_data) {
+   ++mock_bifrost_rpc::prove_action_batch_calls;
+   mock_bifrost_rpc::proved_actions += items_size;
+   mock_bifrost_rpc::submit(callback, user_data);
+}
+
+}
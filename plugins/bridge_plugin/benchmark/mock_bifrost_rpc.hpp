@@ -0,0 +1,19 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace eosio { namespace mock_bifrost_rpc {
+
+struct call_stats {
+   uint64_t prove_action_calls = 0;
+   uint64_t prove_action_batch_calls = 0;
+   uint64_t proved_actions = 0;     // of both prove_action and prove_action_batch
+   uint64_t change_schedule_calls = 0;
+};
+
+// every submission takes latency before it reports the extrinsic finalized, as the rpc client does
+void set_latency(std::chrono::milliseconds latency);
+call_stats stats();
+
+} }
@@ -30,14 +30,43 @@ extern "C" {
 #endif
 
 // bifrost rpc api
+// urls is a comma separated list of bifrost node addresses, connects to all of them once
+eosio::rpc_result *init_client_pool(const char *urls);
+
+// reconnects dropped endpoints and measures their latency, msg is the json status of every endpoint
+eosio::rpc_result *check_client_pool();
+
+// releases a result returned by any of these functions
+void free_rpc_result(eosio::rpc_result *result);
+
+// called once with the result of a submit_* call, on a thread of the rpc runtime.
+// result must be released by free_rpc_result
+typedef void (*rpc_callback)(eosio::rpc_result *result, void *user_data);
+
+// starts the multi-threaded runtime running the submit_* calls, a started runtime is kept
+eosio::rpc_result *start_rpc_runtime(size_t worker_threads);
+
+// drops the pending submissions without calling their callbacks, returns once no callback runs anymore
+void stop_rpc_runtime();
+
+// subscribes to the redeems requested on bifrost from the finalized block from_block on, or from the next finalized
+// block when it is 0, until stop_rpc_runtime. Unlike for the submit_* calls callback is called once per redeem, with
+// msg the json {"block", "id", "to", "quantity", "memo"} of the redeem, then once per block with {"block"} when all
+// its redeems are delivered. success is false when the subscription dropped, it resumes after the last block
+// delivered in full, so the redeems of a block may be delivered twice.
+eosio::rpc_result *subscribe_redeem_events(const char *urls, uint32_t from_block, rpc_callback callback, void *user_data);
+
+// schedule, imcre_merkle, blocks and ids_list are fc::raw packed, sizes are in bytes
 eosio::rpc_result *change_schedule(
    const char                                   *urls,
    const char                                   *signer,
    const eosio::digest_type                     legacy_schedule_hash,
    const char                                   *schedule,
+   size_t                                       schedule_size,
    const char                                   *imcre_merkle,
-   const char                                   *blocks_ffi,
-   size_t                                       blocks_ffi_size,
+   size_t                                       imcre_merkle_size,
+   const char                                   *blocks,
+   size_t                                       blocks_size,
    const char                                   *ids_list,
    size_t                                       ids_list_size
 );
@@ -56,6 +85,67 @@ eosio::rpc_result *prove_action(
    const eosio::transaction_id_type             trx_id
 );
 
+// proofs of several actions in the same block, sent as one batched extrinsic
+eosio::rpc_result *prove_action_batch(
+   const char                                   *urls,
+   const char                                   *signer,
+   const eosio::prove_action_item_ffi           *items,
+   size_t                                       items_size,
+   const eosio::incremental_merkle_ffi          *imcre_merkle,
+   const eosio::signed_block_header_ffi         *blocks_ffi,
+   size_t                                       blocks_ffi_size,
+   const eosio::block_id_type_list              *ids_list,
+   size_t                                       ids_list_size
+);
+
+// The submit_* variants read their arguments before returning, so they don't need to outlive the call,
+// and call callback with user_data once the extrinsic is finalized or failed.
+void submit_change_schedule(
+   const char                                   *urls,
+   const char                                   *signer,
+   const eosio::digest_type                     legacy_schedule_hash,
+   const char                                   *schedule,
+   size_t                                       schedule_size,
+   const char                                   *imcre_merkle,
+   size_t                                       imcre_merkle_size,
+   const char                                   *blocks,
+   size_t                                       blocks_size,
+   const char                                   *ids_list,
+   size_t                                       ids_list_size,
+   rpc_callback                                 callback,
+   void                                         *user_data
+);
+
+void submit_prove_action(
+   const char                                   *urls,
+   const char                                   *signer,
+   const eosio::action_ffi                      *act_ffi,
+   const eosio::incremental_merkle_ffi          *imcre_merkle,
+   const eosio::action_receipt_ffi              *act_receipt,
+   const eosio::block_id_type_list              *action_merkle_paths,
+   const eosio::signed_block_header_ffi         *blocks_ffi,
+   size_t                                       blocks_ffi_size,
+   const eosio::block_id_type_list              *ids_list,
+   size_t                                       ids_list_size,
+   const eosio::transaction_id_type             trx_id,
+   rpc_callback                                 callback,
+   void                                         *user_data
+);
+
+void submit_prove_action_batch(
+   const char                                   *urls,
+   const char                                   *signer,
+   const eosio::prove_action_item_ffi           *items,
+   size_t                                       items_size,
+   const eosio::incremental_merkle_ffi          *imcre_merkle,
+   const eosio::signed_block_header_ffi         *blocks_ffi,
+   size_t                                       blocks_ffi_size,
+   const eosio::block_id_type_list              *ids_list,
+   size_t                                       ids_list_size,
+   rpc_callback                                 callback,
+   void                                         *user_data
+);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,166 @@
+// Copyright 2019-2020 Liebi Technologies.
+// This file is part of Bifrost.
+
+// Bifrost is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// Bifrost is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with Bifrost.  If not, see <http://www.gnu.org/licenses/>.
+
+// Long-lived subxt clients, one per bifrost endpoint. The websocket handshake and the metadata
+// download happen once per endpoint instead of once per call. Calls go to the healthy endpoint
+// with the lowest latency, an endpoint failing a call is skipped until a health check revives it.
+
+use once_cell::sync::OnceCell;
+use std::sync::{
+	Mutex,
+	atomic::{AtomicBool, AtomicU64, Ordering},
+};
+use std::time::Instant;
+use subxt::{Client, DefaultNodeRuntime as BifrostRuntime};
+
+const UNKNOWN_LATENCY: u64 = u64::MAX;
+
+struct Endpoint {
+	url:        String,
+	client:     Mutex<Option<Client<BifrostRuntime>>>, // Client is a cheap handle to the shared connection
+	healthy:    AtomicBool,
+	latency_us: AtomicU64, // of the last health check
+}
+
+pub(crate) struct ClientPool {
+	endpoints: Vec<Endpoint>,
+}
+
+static POOL: OnceCell<ClientPool> = OnceCell::new();
+
+impl Endpoint {
+	fn new(url: String) -> Self {
+		Self {
+			url,
+			client:     Mutex::new(None),
+			healthy:    AtomicBool::new(true),
+			latency_us: AtomicU64::new(UNKNOWN_LATENCY),
+		}
+	}
+
+	fn cached(&self) -> Option<Client<BifrostRuntime>> {
+		self.client.lock().ok().and_then(|c| c.clone())
+	}
+
+	fn drop_client(&self) {
+		self.healthy.store(false, Ordering::Relaxed);
+		if let Ok(mut c) = self.client.lock() {
+			*c = None;
+		}
+	}
+
+	async fn connect(&self) -> Result<Client<BifrostRuntime>, crate::Error> {
+		if let Some(client) = self.cached() {
+			return Ok(client);
+		}
+		let client = subxt::ClientBuilder::<BifrostRuntime>::new()
+			.set_url(self.url.clone())
+			.build()
+			.await
+			.map_err(|_| crate::Error::SubxtError("failed to create subxt client"))?;
+		if let Ok(mut c) = self.client.lock() {
+			*c = Some(client.clone());
+		}
+		Ok(client)
+	}
+
+	// round trip of a cheap rpc call, reconnects if the endpoint was dropped
+	async fn check(&self) {
+		let start = Instant::now();
+		let ok = match self.connect().await {
+			Ok(client) => client.block_hash(None).await.is_ok(),
+			Err(_) => false,
+		};
+		if ok {
+			self.latency_us.store(start.elapsed().as_micros() as u64, Ordering::Relaxed);
+			self.healthy.store(true, Ordering::Relaxed);
+		} else {
+			self.latency_us.store(UNKNOWN_LATENCY, Ordering::Relaxed);
+			self.drop_client();
+		}
+	}
+}
+
+impl ClientPool {
+	fn new(urls: impl IntoIterator<Item=String>) -> Self {
+		Self { endpoints: urls.into_iter().map(Endpoint::new).collect() }
+	}
+
+	// indexes of the endpoints to try, healthy and fast ones first
+	fn candidates(&self) -> Vec<usize> {
+		let mut order: Vec<usize> = (0..self.endpoints.len()).collect();
+		order.sort_by_key(|&i| {
+			let e = &self.endpoints[i];
+			(!e.healthy.load(Ordering::Relaxed), e.latency_us.load(Ordering::Relaxed))
+		});
+		order
+	}
+
+	pub(crate) async fn client(&self) -> Result<(usize, Client<BifrostRuntime>), crate::Error> {
+		for i in self.candidates() {
+			match self.endpoints[i].connect().await {
+				Ok(client) => return Ok((i, client)),
+				Err(_) => self.endpoints[i].drop_client(),
+			}
+		}
+
+		Err(crate::Error::SubxtError("no bifrost node is available"))
+	}
+
+	// the connection may be broken, let the next call pick another endpoint
+	pub(crate) fn report_failure(&self, index: usize) {
+		if let Some(e) = self.endpoints.get(index) {
+			e.drop_client();
+		}
+	}
+
+	pub(crate) async fn check(&self) {
+		for e in self.endpoints.iter() {
+			e.check().await;
+		}
+	}
+
+	pub(crate) fn status(&self) -> String {
+		let status: Vec<serde_json::Value> = self.endpoints.iter().map(|e| {
+			let latency = e.latency_us.load(Ordering::Relaxed);
+			serde_json::json!({
+				"url":        e.url,
+				"healthy":    e.healthy.load(Ordering::Relaxed),
+				"latency_us": if latency == UNKNOWN_LATENCY { serde_json::Value::Null } else { latency.into() },
+			})
+		}).collect();
+		serde_json::Value::Array(status).to_string()
+	}
+}
+
+// urls is a comma separated list of bifrost node addresses
+pub(crate) fn parse_urls(urls: &str) -> Vec<String> {
+	urls.split(',').map(|u| u.trim()).filter(|u| !u.is_empty()).map(|u| u.to_owned()).collect()
+}
+
+// returns false if the pool was already initialized, the urls are ignored then
+pub(crate) fn init(urls: impl IntoIterator<Item=String>) -> bool {
+	POOL.set(ClientPool::new(urls)).is_ok()
+}
+
+// the pool is normally created by init_client_pool in plugin_startup, otherwise by the first call
+pub(crate) fn pool(urls: impl IntoIterator<Item=String>) -> &'static ClientPool {
+	POOL.get_or_init(|| ClientPool::new(urls))
+}
+
+pub(crate) fn get() -> Option<&'static ClientPool> {
+	POOL.get()
+}
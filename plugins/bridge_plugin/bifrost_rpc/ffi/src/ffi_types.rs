@@ -19,7 +19,7 @@ use eos_chain::{
     Action, AccountName, ActionName, ActionReceipt, PermissionLevel, Checksum256,
     Signature, BlockHeader, Extension, utils::flat_map::FlatMap, UnsignedInt, PublicKey,
     ProducerKey, BlockTimestamp, ProducerSchedule, IncrementalMerkle, SignedBlockHeader,
-    ProducerAuthoritySchedule, ProducerAuthority, BlockSigningAuthorityV0, BlockSigningAuthority, KeyWeight
+    ProducerAuthoritySchedule, ProducerAuthority, BlockSigningAuthorityV0, BlockSigningAuthority, KeyWeight, Read
 };
 use std::{
     convert::TryInto,
@@ -131,6 +131,43 @@ impl<'a> TryInto<ActionReceipt> for &'a ActionReceiptFFI {
     }
 }
 
+#[derive(Clone, Debug)]
+#[repr(C)]
+pub struct ProveActionItemFFI {
+    pub act: *const ActionFFI,
+    pub act_receipt: *const ActionReceiptFFI,
+    pub action_merkle_paths: Checksum256FFI,
+    pub trx_id: Checksum256,
+}
+
+// one action proof of a batch, all of them share merkle, block headers and id lists
+pub(crate) struct ProveActionItem {
+    pub action: Action,
+    pub action_receipt: ActionReceipt,
+    pub action_merkle_paths: Vec<Checksum256>,
+    pub trx_id: Checksum256,
+}
+
+impl<'a> TryInto<ProveActionItem> for &'a ProveActionItemFFI {
+    type Error = Error;
+    fn try_into(self) -> Result<ProveActionItem, Self::Error> {
+        if self.act.is_null() || self.act_receipt.is_null() {
+            Err(Error::NullPtr("ProveActionItemFFI".to_owned()))
+        } else {
+            let action: Action = unsafe { &*self.act }.try_into()?;
+            let action_receipt: ActionReceipt = unsafe { &*self.act_receipt }.try_into()?;
+            let action_merkle_paths: Vec<Checksum256> = (&self.action_merkle_paths).try_into()?;
+
+            Ok(ProveActionItem {
+                action,
+                action_receipt,
+                action_merkle_paths,
+                trx_id: self.trx_id,
+            })
+        }
+    }
+}
+
 #[derive(Clone, Debug)]
 #[repr(C)]
 pub struct IncrementalMerkleFFI {
@@ -191,8 +228,8 @@ impl<'a> TryInto<Vec<Extension>> for &'a ExtensionsFFI {
         } else {
             let exts = unsafe { slice::from_raw_parts(self.extensions, self.extensions_size) };
             let mut extensions: Vec<_> = Vec::with_capacity(exts.len());
-            for (i, v) in exts.iter().enumerate() {
-                extensions[i] = v.try_into()?;
+            for v in exts.iter() {
+                extensions.push(v.try_into()?);
             }
 
             Ok(extensions)
@@ -243,8 +280,8 @@ impl<'a> TryInto<ProducerSchedule> for &'a ProducerScheduleFFI {
         } else {
             let producers_ffi = unsafe { slice::from_raw_parts(self.producers, self.producers_size) };
             let mut producers: Vec<ProducerKey> = Vec::with_capacity(producers_ffi.len());
-            for (i, p) in producers_ffi.iter().enumerate() {
-                producers[i] = p.try_into()?;
+            for p in producers_ffi.iter() {
+                producers.push(p.try_into()?);
             }
 
             Ok(ProducerSchedule {
@@ -509,6 +546,16 @@ impl Deref for Char<'_> {
     }
 }
 
+// decode a fc::raw packed buffer handed over by c++
+pub(crate) fn read_packed<T: Read>(ptr: *const c_char, size: size_t, what: &'static str) -> FFIResult<T> {
+    if ptr.is_null() {
+        return Err(Error::NullPtr(what.to_owned()));
+    }
+    let bytes = unsafe { slice::from_raw_parts(ptr as *const u8, size) };
+    let mut pos = 0usize;
+    T::read(bytes, &mut pos).map_err(|_| Error::ReadError(what))
+}
+
 pub(crate) fn generate_raw_result(success: bool, msg: impl AsRef<str>) -> Box<RpcResponse> {
     let c_str = CString::new(msg.as_ref())
                 .unwrap_or(
@@ -523,6 +570,6 @@ pub(crate) fn generate_raw_result(success: bool, msg: impl AsRef<str>) -> Box<Rp
 #[derive(Clone, Debug)]
 #[repr(C)]
 pub struct RpcResponse {
-    success: bool,
-    msg: *const c_char, // this could be error message or successful message
+    pub(crate) success: bool,
+    pub(crate) msg: *const c_char, // this could be error message or successful message
 }
@@ -18,14 +18,21 @@ use eos_chain::{Action, ActionReceipt, Checksum256, IncrementalMerkle, ProducerA
 use std::{
     convert::TryInto,
     fmt::{self, Display},
-    os::raw::c_char,
+    os::raw::{c_char, c_void},
     ptr,
     slice,
 };
 
+mod client_pool;
 mod ffi_types;
 use ffi_types::*;
+mod nonce;
+mod redeem;
 mod rpc_calls;
+mod runtime;
+
+// called once with the result of a submit_* call on a thread of the runtime, result must be released by free_rpc_result
+pub type RpcCallback = extern "C" fn(result: *mut RpcResponse, user_data: *mut c_void);
 
 #[derive(Clone, Debug)]
 pub enum Error {
@@ -35,6 +42,8 @@ pub enum Error {
     SignatureError,
     WrongSudoSeed,
     SubxtError(&'static str),
+    ReadError(&'static str),
+    Rpc(String), // what the bifrost node reported about a submitted extrinsic
 }
 
 impl Display for Error {
@@ -46,6 +55,8 @@ impl Display for Error {
             Self::SignatureError => write!(f, "Failed to convert string to Signature."),
             Self::WrongSudoSeed => write!(f, "Wrong sudo seed, failed to sign transaction."),
             Self::SubxtError(e) => write!(f, "Error from subxt crate: {}", e),
+            Self::ReadError(what) => write!(f, "Failed to deserialize {}.", what),
+            Self::Rpc(ref e) => write!(f, "Error from bifrost node: {}", e),
         }
     }
 }
@@ -59,155 +70,261 @@ impl std::error::Error for Error {
             Self::SignatureError => "Failed to convert string to Signature.",
             Self::WrongSudoSeed => "Wrong sudo seed, failed to sign transaction.",
             Self::SubxtError(e) => e,
+            Self::ReadError(_) => "Failed to deserialize packed data.",
+            Self::Rpc(ref e) => e,
         }
     }
 }
 
+// urls is a comma separated list of bifrost node addresses, all of them are connected once here
 #[no_mangle]
-pub extern "C" fn change_schedule(
+pub extern "C" fn init_client_pool(urls: *const c_char) -> Box<RpcResponse> {
+    let urls = match char_to_string(urls) {
+        Ok(urls) => client_pool::parse_urls(&urls),
+        Err(e) => return generate_raw_result(false, e.to_string()),
+    };
+    if urls.is_empty() {
+        return generate_raw_result(false, "This is not an valid bifrost node address.");
+    }
+    // a submission made before may have created the pool already, it's checked either way
+    client_pool::init(urls);
+
+    check_client_pool()
+}
+
+// reconnects dropped endpoints and measures their latency, msg is the json status of all endpoints
+#[no_mangle]
+pub extern "C" fn check_client_pool() -> Box<RpcResponse> {
+    match client_pool::get() {
+        Some(pool) => {
+            futures::executor::block_on(pool.check());
+            generate_raw_result(true, pool.status())
+        }
+        None => generate_raw_result(false, "bifrost client pool is not initialized"),
+    }
+}
+
+// every rpc_result returned to c++ must be released by this
+#[no_mangle]
+pub extern "C" fn free_rpc_result(result: *mut RpcResponse) {
+    if result.is_null() {
+        return;
+    }
+    let result = unsafe { Box::from_raw(result) };
+    if !result.msg.is_null() {
+        unsafe { std::ffi::CString::from_raw(result.msg as *mut c_char) };
+    }
+}
+
+// starts the runtime running the submit_* calls, a started runtime is kept
+#[no_mangle]
+pub extern "C" fn start_rpc_runtime(worker_threads: size_t) -> Box<RpcResponse> {
+    match runtime::start(worker_threads) {
+        Ok(()) => generate_raw_result(true, "bifrost rpc runtime is started"),
+        Err(e) => generate_raw_result(false, e),
+    }
+}
+
+// drops the pending submissions without calling their callbacks, returns once no callback runs anymore
+#[no_mangle]
+pub extern "C" fn stop_rpc_runtime() {
+    runtime::stop();
+    redeem::unsubscribed();
+}
+
+// callback gets every redeem requested on bifrost from block from_block on, or from the next finalized block when
+// it is 0, until the runtime is stopped
+#[no_mangle]
+pub extern "C" fn subscribe_redeem_events(
+    urls:       *const c_char,
+    from_block: u32,
+    callback:   RpcCallback,
+    user_data:  *mut c_void
+) -> Box<RpcResponse> {
+    let urls = match char_to_string(urls) {
+        Ok(urls) => client_pool::parse_urls(&urls),
+        Err(e) => return generate_raw_result(false, e.to_string()),
+    };
+    match redeem::subscribe(urls, from_block, callback, user_data) {
+        Ok(()) => generate_raw_result(true, "subscribed to bifrost redeem events"),
+        Err(e) => generate_raw_result(false, e),
+    }
+}
+
+// arguments of a call read out of the c++ structs, which are only valid during the call
+struct ChangeScheduleArgs {
+    urls:                 Vec<String>,
+    signer:               String,
+    legacy_schedule_hash: Checksum256,
+    new_schedule:         ProducerAuthoritySchedule,
+    merkle:               IncrementalMerkle,
+    block_headers:        Vec<SignedBlockHeader>,
+    ids_lists:            Vec<Vec<Checksum256>>,
+}
+
+struct ProveActionArgs {
+    urls:                Vec<String>,
+    signer:              String,
+    action:              Action,
+    action_receipt:      ActionReceipt,
+    action_merkle_paths: Vec<Checksum256>,
+    merkle:              IncrementalMerkle,
+    block_headers:       Vec<SignedBlockHeader>,
+    ids_lists:           Vec<Vec<Checksum256>>,
+    trx_id:              Checksum256,
+}
+
+struct ProveActionBatchArgs {
+    urls:                Vec<String>,
+    signer:              String,
+    items:               Vec<ProveActionItem>,
+    merkle:              IncrementalMerkle,
+    block_headers:       Vec<SignedBlockHeader>,
+    ids_lists:           Vec<Vec<Checksum256>>,
+}
+
+fn read_change_schedule_args(
     urls:                 *const c_char,
     signer:               *const c_char,
     legacy_schedule_hash: Checksum256,
     schedule:             *const c_char,
+    schedule_size:        size_t,
     imcre_merkle:         *const c_char,
-    blocks_ffi:           *const c_char,
-    blocks_ffi_size:      size_t,
+    imcre_merkle_size:    size_t,
+    blocks:               *const c_char,
+    blocks_size:          size_t,
     ids_list:             *const c_char,
     ids_list_size:        size_t
-) -> Box<RpcResponse> {
+) -> Result<ChangeScheduleArgs, Box<RpcResponse>> {
     // check pointers null or not
-    match (urls.is_null(), signer.is_null(), schedule.is_null(), imcre_merkle.is_null(), blocks_ffi.is_null(), ids_list.is_null()) {
+    match (urls.is_null(), signer.is_null(), schedule.is_null(), imcre_merkle.is_null(), blocks.is_null(), ids_list.is_null()) {
         (false, false, false, false, false, false) => (),
         _ => {
-            return generate_raw_result(false, "cannot send action to bifrost node to prove it due to there're null points");
+            return Err(generate_raw_result(false, "cannot send action to bifrost node to prove it due to there're null points"));
         }
     }
 
     let urls = {
         let urls = char_to_string(urls);
         if urls.is_err() {
-            return generate_raw_result(false, "This is not an valid bifrost node address.");
+            return Err(generate_raw_result(false, "This is not an valid bifrost node address."));
         }
 
-        vec![urls.unwrap()]
+        crate::client_pool::parse_urls(&urls.unwrap())
     };
 
     let signer = {
         let signer = char_to_string(signer);
         if signer.is_err() {
-            return generate_raw_result(false, "This is not an valid bifrost node address.");
+            return Err(generate_raw_result(false, "This is not an valid bifrost node address."));
         }
         signer.unwrap()
     };
 
-    let new_schedule = {
-        let new_schedule_str = char_to_string(schedule);
-        if new_schedule_str.is_err() {
-            return generate_raw_result(false, "This is not an valid producer schedule.");
-        }
-        let new_schedule: Result<ProducerAuthoritySchedule, _> = serde_json::from_str(new_schedule_str.as_ref().unwrap());
-        if new_schedule.is_err() {
-            return generate_raw_result(false, "Failed to deserialize producer schedule".to_owned());
+    // all of them are packed by fc::raw, which is the same binary format eos_chain reads
+    let new_schedule: ProducerAuthoritySchedule = {
+        let r = read_packed(schedule, schedule_size, "producer schedule");
+        if r.is_err() {
+            return Err(generate_raw_result(false, r.unwrap_err().to_string()));
         }
-        new_schedule.unwrap()
+        r.unwrap()
     };
 
     let merkle: IncrementalMerkle = {
-        let imcre_merkle_str = char_to_string(imcre_merkle);
-        if imcre_merkle_str.is_err() {
-            return generate_raw_result(false, "This is not an valid IncrementalMerklee.");
-        }
-        let merkle: Result<IncrementalMerkle, _> = serde_json::from_str(imcre_merkle_str.as_ref().unwrap());
-        if merkle.is_err() {
-            return generate_raw_result(false, "Failed to deserialize IncrementalMerklee".to_owned());
+        let r = read_packed(imcre_merkle, imcre_merkle_size, "IncrementalMerkle");
+        if r.is_err() {
+            return Err(generate_raw_result(false, r.unwrap_err().to_string()));
         }
-        merkle.unwrap()
+        r.unwrap()
     };
 
     let block_headers: Vec<SignedBlockHeader> = {
-        let blockers_str = char_to_string(blocks_ffi);
-        if blockers_str.is_err() {
-            return generate_raw_result(false, "This is not an valid SignedBlockHeader.");
-        }
-        let block_headers: Result<Vec<SignedBlockHeader>, _> = serde_json::from_str(blockers_str.as_ref().unwrap());
-        if block_headers.is_err() {
-            return generate_raw_result(false, "Failed to deserialize SignedBlockHeader".to_owned());
+        let r = read_packed(blocks, blocks_size, "SignedBlockHeader");
+        if r.is_err() {
+            return Err(generate_raw_result(false, r.unwrap_err().to_string()));
         }
-        block_headers.unwrap()
+        r.unwrap()
     };
 
     let ids_lists: Vec<Vec<Checksum256>> = {
-        let ids_lists_str = char_to_string(blocks_ffi);
-        if ids_lists_str.is_err() {
-            return generate_raw_result(false, "This is not an valid block id list string.");
-        }
-        let ids_lists: Result<Vec<Vec<Checksum256>>, _> = serde_json::from_str(ids_lists_str.as_ref().unwrap());
-        if ids_lists.is_err() {
-            return generate_raw_result(false, "Failed to deserialize block id list".to_owned());
+        let r = read_packed(ids_list, ids_list_size, "block id list");
+        if r.is_err() {
+            return Err(generate_raw_result(false, r.unwrap_err().to_string()));
         }
-        ids_lists.unwrap()
+        r.unwrap()
     };
-//    let merkle: IncrementalMerkle = {
-//        let imcre_merkle = &unsafe { ptr::read(imcre_merkle) };
-//        let r: Result<IncrementalMerkle, _> = imcre_merkle.try_into();
-//        if r.is_err() {
-//            return generate_raw_result(false, r.unwrap_err().to_string());
-//        }
-//        r.unwrap()
-//    };
-
-//    let block_headers: Vec<SignedBlockHeader> = {
-//        let blocks_ffi = &unsafe { slice::from_raw_parts(blocks_ffi, blocks_ffi_size) };
-//        let mut block_headers: Vec<_> = Vec::with_capacity(blocks_ffi_size);
-//        for block in blocks_ffi.iter() {
-//            let ffi = &unsafe { ptr::read(block) };
-//            let r: Result<SignedBlockHeader, Error> = ffi.try_into();
-//            if r.is_err() {
-//                return generate_raw_result(false, r.unwrap_err().to_string());
-//            }
-//            block_headers.push(r.unwrap());
-//        }
-//        block_headers
-//    };
-
-//    let mut ids_lists: Vec<Vec<Checksum256>>= Vec::with_capacity(15);
-//    ids_lists.push(Vec::new());
-//    let ids_list_ffi = &unsafe { slice::from_raw_parts(ids_list, ids_list_size) };
-//    for ids in ids_list_ffi.iter().skip(1) { // skip first ids due to it's am empty list(null pointer)
-//        let r: Result<Vec<Checksum256>, _> = ids.try_into();
-//        if r.is_err() {
-//            return generate_raw_result(false, r.unwrap_err().to_string());
-//        }
-//        ids_lists.push(r.unwrap());
-//    }
-
-    let result = futures::executor::block_on(async move {
-        crate::rpc_calls::change_schedule_call(
-            urls,
-            signer,
-            legacy_schedule_hash,
-            new_schedule,
-            merkle,
-            block_headers,
-            ids_lists,
-        ).await
-    });
-
-    // send and watch extrinsic until finalized
-    match result {
-        Ok(tx_hash) => {
-            println!("[+] Transaction got finalized and its id: {:?}\n", tx_hash);
-            generate_raw_result(true, tx_hash.to_string())
-        }
-        Err(e) => {
-            println!("[+] Transaction got failure due to: {:?}\n", e);
-            generate_raw_result(false, e.to_string())
-        }
+
+    Ok(ChangeScheduleArgs { urls, signer, legacy_schedule_hash, new_schedule, merkle, block_headers, ids_lists })
+}
+
+#[no_mangle]
+pub extern "C" fn change_schedule(
+    urls:                 *const c_char,
+    signer:               *const c_char,
+    legacy_schedule_hash: Checksum256,
+    schedule:             *const c_char,
+    schedule_size:        size_t,
+    imcre_merkle:         *const c_char,
+    imcre_merkle_size:    size_t,
+    blocks:               *const c_char,
+    blocks_size:          size_t,
+    ids_list:             *const c_char,
+    ids_list_size:        size_t
+) -> Box<RpcResponse> {
+    match read_change_schedule_args(
+        urls, signer, legacy_schedule_hash, schedule, schedule_size, imcre_merkle, imcre_merkle_size, blocks,
+        blocks_size, ids_list, ids_list_size
+    ) {
+        Ok(args) => runtime::block_on(send_change_schedule(args)),
+        Err(e) => e,
     }
 }
 
+// returns once the arguments are read, callback gets the result once the extrinsic is finalized, or failed: it was
+// dropped, failed at dispatch, its block was retracted or it was not finalized in time
 #[no_mangle]
-pub extern "C" fn prove_action(
+pub extern "C" fn submit_change_schedule(
+    urls:                 *const c_char,
+    signer:               *const c_char,
+    legacy_schedule_hash: Checksum256,
+    schedule:             *const c_char,
+    schedule_size:        size_t,
+    imcre_merkle:         *const c_char,
+    imcre_merkle_size:    size_t,
+    blocks:               *const c_char,
+    blocks_size:          size_t,
+    ids_list:             *const c_char,
+    ids_list_size:        size_t,
+    callback:             RpcCallback,
+    user_data:            *mut c_void
+) {
+    match read_change_schedule_args(
+        urls, signer, legacy_schedule_hash, schedule, schedule_size, imcre_merkle, imcre_merkle_size, blocks,
+        blocks_size, ids_list, ids_list_size
+    ) {
+        Ok(args) => runtime::submit(send_change_schedule(args), callback, user_data),
+        Err(e) => callback(Box::into_raw(e), user_data),
+    }
+}
+
+async fn send_change_schedule(args: ChangeScheduleArgs) -> Box<RpcResponse> {
+    let result = crate::rpc_calls::change_schedule_call(
+        args.urls,
+        args.signer,
+        args.legacy_schedule_hash,
+        args.new_schedule,
+        args.merkle,
+        args.block_headers,
+        args.ids_lists,
+    ).await;
+    // the extrinsic is finalized or failed, c++ logs the message
+    match result {
+        Ok(msg) => generate_raw_result(true, msg),
+        Err(e) => generate_raw_result(false, e.to_string()),
+    }
+}
+
+fn read_prove_action_args(
     urls:                *const c_char,
     signer:              *const c_char,
     act_ffi:             *const ActionFFI,
@@ -219,14 +336,14 @@ pub extern "C" fn prove_action(
     ids_list:            *const Checksum256FFI,
     ids_list_size:       size_t,
     trx_id:              Checksum256
-) -> Box<RpcResponse> {
+) -> Result<ProveActionArgs, Box<RpcResponse>> {
     match (
         urls.is_null(), signer.is_null(), act_ffi.is_null(), imcre_merkle.is_null(),
         act_receipt.is_null(), action_merkle_paths.is_null(), blocks_ffi.is_null(), ids_list.is_null()
     ) {
         (false, false, false, false, false, false, false, false) => (),
         _ => { // if there's any null pointer, just return
-            return generate_raw_result(false, "cannot send action to bifrost node to prove it due to there're null points");
+            return Err(generate_raw_result(false, "cannot send action to bifrost node to prove it due to there're null points"));
         }
     }
 
@@ -234,7 +351,7 @@ pub extern "C" fn prove_action(
         let ffi = &unsafe { ptr::read(act_ffi) };
         let r: Result<Action, _> = ffi.try_into();
         if r.is_err() {
-            return generate_raw_result(false, r.unwrap_err().to_string());
+            return Err(generate_raw_result(false, r.unwrap_err().to_string()));
         }
         r.unwrap()
     };
@@ -243,7 +360,7 @@ pub extern "C" fn prove_action(
         let imcre_merkle = &unsafe { ptr::read(imcre_merkle) };
         let r: Result<IncrementalMerkle, _> = imcre_merkle.try_into();
         if r.is_err() {
-            return generate_raw_result(false, r.unwrap_err().to_string());
+            return Err(generate_raw_result(false, r.unwrap_err().to_string()));
         }
         r.unwrap()
     };
@@ -252,7 +369,7 @@ pub extern "C" fn prove_action(
         let act_ffi = &unsafe { ptr::read(act_receipt) };
         let r: Result<ActionReceipt, _> = act_ffi.try_into();
         if r.is_err() {
-            return generate_raw_result(false, r.unwrap_err().to_string());
+            return Err(generate_raw_result(false, r.unwrap_err().to_string()));
         }
         r.unwrap()
     };
@@ -261,7 +378,7 @@ pub extern "C" fn prove_action(
         let paths = &unsafe { ptr::read(action_merkle_paths) };
         let r: Result<Vec<Checksum256>, _> = paths.try_into();
         if r.is_err() {
-            return generate_raw_result(false, r.unwrap_err().to_string());
+            return Err(generate_raw_result(false, r.unwrap_err().to_string()));
         }
         r.unwrap()
     };
@@ -273,7 +390,7 @@ pub extern "C" fn prove_action(
             let ffi = &unsafe { ptr::read(block) };
             let r: Result<SignedBlockHeader, Error> = ffi.try_into();
             if r.is_err() {
-                return generate_raw_result(false, r.unwrap_err().to_string());
+                return Err(generate_raw_result(false, r.unwrap_err().to_string()));
             }
             block_headers.push(r.unwrap());
         }
@@ -286,7 +403,7 @@ pub extern "C" fn prove_action(
     for ids in ids_list_ffi.iter().skip(1) { // skip first ids due to it's am empty list(null pointer)
         let r: Result<Vec<Checksum256>, _> = ids.try_into();
         if r.is_err() {
-            return generate_raw_result(false, r.unwrap_err().to_string());
+            return Err(generate_raw_result(false, r.unwrap_err().to_string()));
         }
         ids_lists.push(r.unwrap());
     }
@@ -294,42 +411,233 @@ pub extern "C" fn prove_action(
     let urls = {
         let urls = char_to_string(urls);
         if urls.is_err() {
-            return generate_raw_result(false, "This is not an valid bifrost node address.");
+            return Err(generate_raw_result(false, "This is not an valid bifrost node address."));
         }
-        vec![urls.unwrap()]
+        crate::client_pool::parse_urls(&urls.unwrap())
     };
 
     let signer = {
         let signer = char_to_string(signer);
         if signer.is_err() {
-            return generate_raw_result(false, "This is not an valid bifrost node address.");
+            return Err(generate_raw_result(false, "This is not an valid bifrost node address."));
         }
         signer.unwrap()
     };
 
-    let result = futures::executor::block_on(async move {
-        crate::rpc_calls::prove_action_call(
-            urls,
-            signer,
-            action,
-            action_receipt,
-            action_merkle_paths,
-            merkle,
-            block_headers,
-            ids_lists,
-            trx_id
-        ).await
-    });
-
-    // send and watch extrinsic until finalized
+    Ok(ProveActionArgs { urls, signer, action, action_receipt, action_merkle_paths, merkle, block_headers, ids_lists, trx_id })
+}
+
+#[no_mangle]
+pub extern "C" fn prove_action(
+    urls:                *const c_char,
+    signer:              *const c_char,
+    act_ffi:             *const ActionFFI,
+    imcre_merkle:        *const IncrementalMerkleFFI,
+    act_receipt:         *const ActionReceiptFFI,
+    action_merkle_paths: *const Checksum256FFI,
+    blocks_ffi:          *const SignedBlockHeaderFFI,
+    blocks_ffi_size:     size_t,
+    ids_list:            *const Checksum256FFI,
+    ids_list_size:       size_t,
+    trx_id:              Checksum256
+) -> Box<RpcResponse> {
+    match read_prove_action_args(
+        urls, signer, act_ffi, imcre_merkle, act_receipt, action_merkle_paths, blocks_ffi, blocks_ffi_size,
+        ids_list, ids_list_size, trx_id
+    ) {
+        Ok(args) => runtime::block_on(send_prove_action(args)),
+        Err(e) => e,
+    }
+}
+
+// returns once the arguments are read, callback gets the result once the extrinsic is finalized, or failed: it was
+// dropped, failed at dispatch, its block was retracted or it was not finalized in time
+#[no_mangle]
+pub extern "C" fn submit_prove_action(
+    urls:                *const c_char,
+    signer:              *const c_char,
+    act_ffi:             *const ActionFFI,
+    imcre_merkle:        *const IncrementalMerkleFFI,
+    act_receipt:         *const ActionReceiptFFI,
+    action_merkle_paths: *const Checksum256FFI,
+    blocks_ffi:          *const SignedBlockHeaderFFI,
+    blocks_ffi_size:     size_t,
+    ids_list:            *const Checksum256FFI,
+    ids_list_size:       size_t,
+    trx_id:              Checksum256,
+    callback:            RpcCallback,
+    user_data:           *mut c_void
+) {
+    match read_prove_action_args(
+        urls, signer, act_ffi, imcre_merkle, act_receipt, action_merkle_paths, blocks_ffi, blocks_ffi_size,
+        ids_list, ids_list_size, trx_id
+    ) {
+        Ok(args) => runtime::submit(send_prove_action(args), callback, user_data),
+        Err(e) => callback(Box::into_raw(e), user_data),
+    }
+}
+
+async fn send_prove_action(args: ProveActionArgs) -> Box<RpcResponse> {
+    let result = crate::rpc_calls::prove_action_call(
+        args.urls,
+        args.signer,
+        args.action,
+        args.action_receipt,
+        args.action_merkle_paths,
+        args.merkle,
+        args.block_headers,
+        args.ids_lists,
+        args.trx_id
+    ).await;
+    // the extrinsic is finalized or failed, c++ logs the message
     match result {
-        Ok(tx_hash) => {
-            println!("[+] Transaction got finalized and its id: {:?}\n", tx_hash);
-            generate_raw_result(true, tx_hash.to_string())
+        Ok(msg) => generate_raw_result(true, msg),
+        Err(e) => generate_raw_result(false, e.to_string()),
+    }
+}
+
+fn read_prove_action_batch_args(
+    urls:                *const c_char,
+    signer:              *const c_char,
+    items:               *const ProveActionItemFFI,
+    items_size:          size_t,
+    imcre_merkle:        *const IncrementalMerkleFFI,
+    blocks_ffi:          *const SignedBlockHeaderFFI,
+    blocks_ffi_size:     size_t,
+    ids_list:            *const Checksum256FFI,
+    ids_list_size:       size_t
+) -> Result<ProveActionBatchArgs, Box<RpcResponse>> {
+    match (
+        urls.is_null(), signer.is_null(), items.is_null(), imcre_merkle.is_null(), blocks_ffi.is_null(), ids_list.is_null()
+    ) {
+        (false, false, false, false, false, false) => (),
+        _ => { // if there's any null pointer, just return
+            return Err(generate_raw_result(false, "cannot send actions to bifrost node to prove them due to there're null points"));
+        }
+    }
+
+    let items: Vec<ProveActionItem> = {
+        let items_ffi = &unsafe { slice::from_raw_parts(items, items_size) };
+        let mut items: Vec<_> = Vec::with_capacity(items_size);
+        for item in items_ffi.iter() {
+            let r: Result<ProveActionItem, Error> = item.try_into();
+            if r.is_err() {
+                return Err(generate_raw_result(false, r.unwrap_err().to_string()));
+            }
+            items.push(r.unwrap());
+        }
+        items
+    };
+
+    let merkle: IncrementalMerkle = {
+        let imcre_merkle = &unsafe { ptr::read(imcre_merkle) };
+        let r: Result<IncrementalMerkle, _> = imcre_merkle.try_into();
+        if r.is_err() {
+            return Err(generate_raw_result(false, r.unwrap_err().to_string()));
+        }
+        r.unwrap()
+    };
+
+    let block_headers: Vec<SignedBlockHeader> = {
+        let blocks_ffi = &unsafe { slice::from_raw_parts(blocks_ffi, blocks_ffi_size) };
+        let mut block_headers: Vec<_> = Vec::with_capacity(blocks_ffi_size);
+        for block in blocks_ffi.iter() {
+            let ffi = &unsafe { ptr::read(block) };
+            let r: Result<SignedBlockHeader, Error> = ffi.try_into();
+            if r.is_err() {
+                return Err(generate_raw_result(false, r.unwrap_err().to_string()));
+            }
+            block_headers.push(r.unwrap());
         }
-        Err(e) => {
-            println!("[+] Transaction got failure due to: {:?}\n", e);
-            generate_raw_result(false, e.to_string())
+        block_headers
+    };
+
+    let mut ids_lists: Vec<Vec<Checksum256>>= Vec::with_capacity(15);
+    ids_lists.push(Vec::new());
+    let ids_list_ffi = &unsafe { slice::from_raw_parts(ids_list, ids_list_size) };
+    for ids in ids_list_ffi.iter().skip(1) { // skip first ids due to it's am empty list(null pointer)
+        let r: Result<Vec<Checksum256>, _> = ids.try_into();
+        if r.is_err() {
+            return Err(generate_raw_result(false, r.unwrap_err().to_string()));
+        }
+        ids_lists.push(r.unwrap());
+    }
+
+    let urls = {
+        let urls = char_to_string(urls);
+        if urls.is_err() {
+            return Err(generate_raw_result(false, "This is not an valid bifrost node address."));
         }
+        crate::client_pool::parse_urls(&urls.unwrap())
+    };
+
+    let signer = {
+        let signer = char_to_string(signer);
+        if signer.is_err() {
+            return Err(generate_raw_result(false, "This is not an valid bifrost node address."));
+        }
+        signer.unwrap()
+    };
+
+    Ok(ProveActionBatchArgs { urls, signer, items, merkle, block_headers, ids_lists })
+}
+
+#[no_mangle]
+pub extern "C" fn prove_action_batch(
+    urls:                *const c_char,
+    signer:              *const c_char,
+    items:               *const ProveActionItemFFI,
+    items_size:          size_t,
+    imcre_merkle:        *const IncrementalMerkleFFI,
+    blocks_ffi:          *const SignedBlockHeaderFFI,
+    blocks_ffi_size:     size_t,
+    ids_list:            *const Checksum256FFI,
+    ids_list_size:       size_t
+) -> Box<RpcResponse> {
+    match read_prove_action_batch_args(
+        urls, signer, items, items_size, imcre_merkle, blocks_ffi, blocks_ffi_size, ids_list, ids_list_size
+    ) {
+        Ok(args) => runtime::block_on(send_prove_action_batch(args)),
+        Err(e) => e,
+    }
+}
+
+// returns once the arguments are read, callback gets the result once the extrinsic is finalized, or failed: it was
+// dropped, failed at dispatch, its block was retracted or it was not finalized in time
+#[no_mangle]
+pub extern "C" fn submit_prove_action_batch(
+    urls:                *const c_char,
+    signer:              *const c_char,
+    items:               *const ProveActionItemFFI,
+    items_size:          size_t,
+    imcre_merkle:        *const IncrementalMerkleFFI,
+    blocks_ffi:          *const SignedBlockHeaderFFI,
+    blocks_ffi_size:     size_t,
+    ids_list:            *const Checksum256FFI,
+    ids_list_size:       size_t,
+    callback:            RpcCallback,
+    user_data:           *mut c_void
+) {
+    match read_prove_action_batch_args(
+        urls, signer, items, items_size, imcre_merkle, blocks_ffi, blocks_ffi_size, ids_list, ids_list_size
+    ) {
+        Ok(args) => runtime::submit(send_prove_action_batch(args), callback, user_data),
+        Err(e) => callback(Box::into_raw(e), user_data),
+    }
+}
+
+async fn send_prove_action_batch(args: ProveActionBatchArgs) -> Box<RpcResponse> {
+    let result = crate::rpc_calls::prove_action_batch_call(
+        args.urls,
+        args.signer,
+        args.items,
+        args.merkle,
+        args.block_headers,
+        args.ids_lists
+    ).await;
+    // the extrinsic is finalized or failed, c++ logs the message
+    match result {
+        Ok(msg) => generate_raw_result(true, msg),
+        Err(e) => generate_raw_result(false, e.to_string()),
     }
 }
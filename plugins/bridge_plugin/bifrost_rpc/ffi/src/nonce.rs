@@ -0,0 +1,104 @@
+// Copyright 2019-2020 Liebi Technologies.
+// This file is part of Bifrost.
+
+// Bifrost is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// Bifrost is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with Bifrost.  If not, see <http://www.gnu.org/licenses/>.
+
+// Local nonce of every signer, so several extrinsics of one signer can be signed and submitted
+// back to back without waiting for the previous one to be included. The local nonce is reconciled
+// with the on-chain one on first use, after any failed submission and every RESYNC_INTERVAL: nonces
+// at or above the on-chain one that are neither in flight nor handed out are gaps, filled first.
+// https://substrate.dev/docs/en/knowledgebase/learn-substrate/tx-pool
+
+use once_cell::sync::Lazy;
+use std::collections::{BTreeSet, HashMap};
+use std::sync::Mutex;
+use std::time::{Duration, Instant};
+use subxt::{Client, DefaultNodeRuntime as BifrostRuntime, system::AccountStoreExt};
+
+const RESYNC_INTERVAL: Duration = Duration::from_secs(30);
+
+#[derive(Default)]
+struct SignerNonce {
+	synced:    Option<Instant>, // when last read from the chain, None until then and after a failed submission
+	next:      u32,
+	pending:   BTreeSet<u32>,   // handed out, the extrinsic is not finalized or failed yet
+	released:  BTreeSet<u32>,   // gaps below next, handed out again first
+}
+
+static NONCES: Lazy<Mutex<HashMap<String, SignerNonce>>> = Lazy::new(|| Mutex::new(HashMap::new()));
+
+fn lock() -> Result<std::sync::MutexGuard<'static, HashMap<String, SignerNonce>>, crate::Error> {
+	NONCES.lock().map_err(|_| crate::Error::SubxtError("nonce lock is poisoned"))
+}
+
+// nonce for the next extrinsic of signer, account is the signer's account id. Every reserved nonce
+// must be given back by completed()
+pub(crate) async fn reserve(
+	pool:     &crate::client_pool::ClientPool,
+	endpoint: usize,
+	client:   &Client<BifrostRuntime>,
+	signer:   &str,
+	account:  &<BifrostRuntime as subxt::system::System>::AccountId,
+) -> Result<u32, crate::Error> {
+	let synced = lock()?.get(signer).and_then(|s| s.synced).map_or(false, |at| at.elapsed() < RESYNC_INTERVAL);
+	let chain_nonce = if synced {
+		None
+	} else {
+		let account = client.account(account, None).await.map_err(|_| {
+			pool.report_failure(endpoint);
+			crate::Error::SubxtError("failed to read the signer nonce")
+		})?;
+		Some(account.nonce)
+	};
+
+	let mut nonces = lock()?;
+	let state = nonces.entry(signer.to_owned()).or_default();
+	if let Some(chain_nonce) = chain_nonce {
+		// extrinsics still in the pool keep their nonces, never go below what was handed out
+		state.next = state.next.max(chain_nonce);
+		state.released = state.released.split_off(&chain_nonce);
+		for nonce in chain_nonce..state.next {
+			if !state.pending.contains(&nonce) {
+				state.released.insert(nonce);
+			}
+		}
+		state.synced = Some(Instant::now());
+	}
+
+	let nonce = match state.released.iter().next() {
+		Some(&nonce) => {
+			state.released.remove(&nonce);
+			nonce
+		}
+		None => {
+			state.next += 1;
+			state.next - 1
+		}
+	};
+	state.pending.insert(nonce);
+	Ok(nonce)
+}
+
+// the extrinsic using nonce is finalized, or failed. Whatever the failure, the nonce may or may not
+// be used on chain, so it's reconciled on the next reservation
+pub(crate) fn completed(signer: &str, nonce: u32, success: bool) {
+	if let Ok(mut nonces) = lock() {
+		if let Some(state) = nonces.get_mut(signer) {
+			state.pending.remove(&nonce);
+			if !success {
+				state.synced = None;
+			}
+		}
+	}
+}
@@ -0,0 +1,151 @@
+// Copyright 2019-2020 Liebi Technologies.
+// This file is part of Bifrost.
+
+// Bifrost is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// Bifrost is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with Bifrost.  If not, see <http://www.gnu.org/licenses/>.
+
+// Subscription to the redeem requests of bifrost, read off the events of the bridge module in every finalized block
+// on a connection of the client pool and handed to c++ one at a time, followed by a marker of the block. A dropped
+// subscription is resumed on the next available endpoint after the last block delivered in full, so no redeem is
+// missed but those of a block delivered in part come again.
+
+use codec::{Decode, Input};
+use sp_core::{storage::StorageKey, twox_128};
+use std::{
+	os::raw::c_void,
+	sync::atomic::{AtomicBool, Ordering},
+	time::Duration,
+};
+use subxt::{sp_runtime::traits::Header, DefaultNodeRuntime as BifrostRuntime, Event, Raw};
+
+use crate::{
+	ffi_types::generate_raw_result,
+	rpc_calls::RedeemRequestedEvent,
+	runtime::{self, UserData},
+	RpcCallback,
+};
+
+const RESUBSCRIBE_DELAY: Duration = Duration::from_secs(1);
+
+static SUBSCRIBED: AtomicBool = AtomicBool::new(false);
+
+// json handed to c++ for every redeem
+fn redeem_json(block: u32, event: &RedeemRequestedEvent<BifrostRuntime>) -> String {
+	serde_json::json!({
+		"block":    block,
+		"id":       event.redeem_id,
+		"to":       String::from_utf8_lossy(&event.to),
+		"quantity": String::from_utf8_lossy(&event.quantity),
+		"memo":     String::from_utf8_lossy(&event.memo),
+	}).to_string()
+}
+
+// json handed to c++ once every redeem of block is
+fn block_json(block: u32) -> String {
+	serde_json::json!({ "block": block }).to_string()
+}
+
+// the events of a block, stored as they are encoded
+struct EncodedEvents(Vec<u8>);
+
+impl Decode for EncodedEvents {
+	fn decode<I: Input>(input: &mut I) -> Result<Self, codec::Error> {
+		let mut data = vec![0u8; input.remaining_len()?.unwrap_or(0)];
+		input.read(&mut data)?;
+		Ok(EncodedEvents(data))
+	}
+}
+
+fn events_key() -> StorageKey {
+	let mut key = twox_128(b"System").to_vec();
+	key.extend_from_slice(&twox_128(b"Events"));
+	StorageKey(key)
+}
+
+// passes the redeems of every finalized block from *next on to callback, *next is the block to deliver after the
+// last one delivered in full, 0 starts at the next finalized block
+async fn watch(urls: Vec<String>, next: &mut u32, callback: RpcCallback, user_data: &UserData) -> Result<(), crate::Error> {
+	let pool = crate::client_pool::pool(urls);
+	let (endpoint, client) = pool.client().await?;
+	let connection_error = |what| {
+		pool.report_failure(endpoint);
+		crate::Error::SubxtError(what)
+	};
+
+	let mut heads = client.subscribe_finalized_blocks().await
+		.map_err(|_| connection_error("failed to subscribe to finalized blocks"))?;
+	let decoder = client.events_decoder();
+
+	while let Some(head) = heads.next().await {
+		let finalized = *head.number();
+		if *next == 0 {
+			*next = finalized;
+		}
+		while *next <= finalized {
+			let hash = client.block_hash(Some((*next).into())).await
+				.map_err(|_| connection_error("failed to read a finalized block hash"))?
+				.ok_or(crate::Error::SubxtError("finalized block is unknown"))?;
+			let events = client.fetch_unhashed::<EncodedEvents>(events_key(), Some(hash)).await
+				.map_err(|_| connection_error("failed to read the events of a finalized block"))?;
+			if let Some(EncodedEvents(data)) = events {
+				let decoded = decoder.decode_events(&mut &data[..])
+					.map_err(|_| crate::Error::ReadError("events of a finalized block"))?;
+				for (_, raw) in decoded {
+					let raw = match raw {
+						Raw::Event(raw) => raw,
+						Raw::Error(_) => continue,
+					};
+					if raw.module != RedeemRequestedEvent::<BifrostRuntime>::MODULE
+						|| raw.variant != RedeemRequestedEvent::<BifrostRuntime>::EVENT {
+						continue;
+					}
+					let event = RedeemRequestedEvent::<BifrostRuntime>::decode(&mut &raw.data[..])
+						.map_err(|_| crate::Error::ReadError("redeem event"))?;
+					callback(Box::into_raw(generate_raw_result(true, redeem_json(*next, &event))), user_data.0);
+				}
+			}
+			callback(Box::into_raw(generate_raw_result(true, block_json(*next))), user_data.0);
+			*next += 1;
+		}
+	}
+
+	pool.report_failure(endpoint);
+	Err(crate::Error::SubxtError("finalized block subscription ended"))
+}
+
+// runs on the runtime until it is stopped, a failure is reported to callback before the subscription is resumed
+pub(crate) fn subscribe(urls: Vec<String>, from_block: u32, callback: RpcCallback, user_data: *mut c_void) -> Result<(), &'static str> {
+	if SUBSCRIBED.swap(true, Ordering::SeqCst) {
+		return Err("redeem events are already subscribed");
+	}
+	let user_data = UserData(user_data);
+	let started = runtime::spawn(async move {
+		let mut next = from_block;
+		loop {
+			if let Err(e) = watch(urls.clone(), &mut next, callback, &user_data).await {
+				callback(Box::into_raw(generate_raw_result(false, e.to_string())), user_data.0);
+			}
+			tokio::time::delay_for(RESUBSCRIBE_DELAY).await;
+		}
+	});
+	if !started {
+		SUBSCRIBED.store(false, Ordering::SeqCst);
+		return Err("bifrost rpc runtime is not started");
+	}
+	Ok(())
+}
+
+// the subscription task was dropped with the runtime
+pub(crate) fn unsubscribed() {
+	SUBSCRIBED.store(false, Ordering::SeqCst);
+}
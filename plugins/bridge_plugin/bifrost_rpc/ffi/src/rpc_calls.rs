@@ -14,35 +14,28 @@
 // You should have received a copy of the GNU General Public License
 // along with Bifrost.  If not, see <http://www.gnu.org/licenses/>.
 
-use codec::Encode;
+use codec::{Decode, Encode};
 use core::marker::PhantomData;
 use eos_chain::{
 	Action, ActionReceipt, Checksum256, Digest, IncrementalMerkle,
 	ProducerAuthoritySchedule, SignedBlockHeader
 };
-use once_cell::sync::Lazy; // sync::OnceCell is thread-safe
-use once_cell::sync::OnceCell; // sync::OnceCell is thread-safe
+use std::time::Duration;
 use subxt::{
-	PairSigner, DefaultNodeRuntime as BifrostRuntime, Call, Client,
-	system::{AccountStoreExt, System, SystemEventsDecoder}, Error as SubxtErr,
+	PairSigner, DefaultNodeRuntime as BifrostRuntime, Call, Event, ExtrinsicSuccess,
+	sp_runtime::traits::Header,
+	system::{System, SystemEventsDecoder}, Error as SubxtErr,
 };
 use sp_core::{sr25519::Pair, Pair as TraitPair};
-use std::sync::{Arc, Mutex};
-use std::sync::atomic::{AtomicU32, Ordering};
 
-static BIFROST_RPC_CLIENT: Lazy<Arc<Mutex<subxt::ClientBuilder<BifrostRuntime>>>> = {
-	Lazy::new(move || {
-		let builder: subxt::ClientBuilder<BifrostRuntime> = subxt::ClientBuilder::new();
-		Arc::new(Mutex::new(builder))
-	})
-};
+// an extrinsic not finalized within this time is reported as failed, about 20 blocks of bifrost
+const FINALIZE_TIMEOUT: Duration = Duration::from_secs(120);
+// how often the finalized head is read while the block including an extrinsic is not finalized yet
+const FINALIZE_POLL: Duration = Duration::from_secs(2);
 
-async fn global_client(url: &str) -> Result<&'static Mutex<subxt::Client<BifrostRuntime>>, crate::Error> {
-	static INSTANCE: OnceCell<Mutex<subxt::Client<BifrostRuntime>>> = OnceCell::new();
-	let builder = subxt::ClientBuilder::new().set_url(url).build().await.map_err(|_| crate::Error::SubxtError("failed to create subxt client"))?;
-	Ok(INSTANCE.get_or_init(|| {
-		Mutex::new(builder)
-	}))
+// errors after which the connection to the endpoint is not trusted anymore
+fn is_connection_error(e: &SubxtErr) -> bool {
+	matches!(e, SubxtErr::Io(_) | SubxtErr::Rpc(_))
 }
 
 #[subxt::module]
@@ -50,6 +43,74 @@ pub trait BridgeEos: System {}
 
 impl BridgeEos for BifrostRuntime {}
 
+#[subxt::module]
+pub trait Utility: System {}
+
+impl Utility for BifrostRuntime {}
+
+// sign call with the next local nonce of signer, submit it and wait until it is finalized
+async fn submit_with_nonce<C: Call<BifrostRuntime> + Send + Sync>(
+	pool:     &crate::client_pool::ClientPool,
+	endpoint: usize,
+	client:   &subxt::Client<BifrostRuntime>,
+	seed:     &str,
+	call:     C,
+) -> Result<String, crate::Error> {
+	let pair = Pair::from_string(seed, None).map_err(|_| crate::Error::WrongSudoSeed)?;
+	let mut signer = PairSigner::<BifrostRuntime, Pair>::new(pair);
+
+	let nonce = crate::nonce::reserve(pool, endpoint, client, seed, &signer.signer().public().into()).await?;
+	signer.set_nonce(nonce);
+
+	let watched = tokio::time::timeout(FINALIZE_TIMEOUT, submit_and_finalize(pool, endpoint, client, &signer, call)).await;
+	let result = watched.unwrap_or_else(|_| Err(crate::Error::Rpc(format!(
+		"extrinsic with nonce {} was not finalized within {} seconds", nonce, FINALIZE_TIMEOUT.as_secs()
+	))));
+	crate::nonce::completed(seed, nonce, result.is_ok());
+	result
+}
+
+// watches the extrinsic until it is in a block, which fails on a dispatch error, then until that block is finalized
+async fn submit_and_finalize<C: Call<BifrostRuntime> + Send + Sync>(
+	pool:     &crate::client_pool::ClientPool,
+	endpoint: usize,
+	client:   &subxt::Client<BifrostRuntime>,
+	signer:   &PairSigner<BifrostRuntime, Pair>,
+	call:     C,
+) -> Result<String, crate::Error> {
+	let connection_error = |e: SubxtErr| {
+		if is_connection_error(&e) {
+			pool.report_failure(endpoint);
+		}
+		crate::Error::Rpc(e.to_string())
+	};
+
+	let success: ExtrinsicSuccess<BifrostRuntime> = client.watch(call, signer).await.map_err(|e| match e {
+		SubxtErr::Runtime(e) => crate::Error::Rpc(format!("extrinsic failed at dispatch: {}", e)),
+		e => connection_error(e),
+	})?;
+	let included = client.header(Some(success.block)).await.map_err(connection_error)?
+		.ok_or_else(|| crate::Error::Rpc(format!("block {:?} including the extrinsic is unknown", success.block)))?;
+	let number = *included.number();
+
+	loop {
+		let head = client.finalized_head().await.map_err(connection_error)?;
+		let finalized = client.header(Some(head)).await.map_err(connection_error)?
+			.map_or(0, |h| *h.number());
+		if finalized >= number {
+			// another block of the same number may have been finalized instead
+			let hash = client.block_hash(Some(number.into())).await.map_err(connection_error)?;
+			if hash != Some(success.block) {
+				return Err(crate::Error::Rpc(format!(
+					"block #{} {:?} including extrinsic {:?} was retracted", number, success.block, success.extrinsic
+				)));
+			}
+			return Ok(format!("extrinsic {:?} finalized in block #{} {:?}", success.extrinsic, number, success.block));
+		}
+		tokio::time::delay_for(FINALIZE_POLL).await;
+	}
+}
+
 #[derive(Clone, Debug, PartialEq, Call, Encode)]
 pub struct ChangeScheduleCall<T: BridgeEos> {
 	legacy_schedule_hash: Checksum256,
@@ -72,6 +133,23 @@ pub struct ProveActionCall<T: BridgeEos> {
 	pub _runtime:         PhantomData<T>,
 }
 
+// a redeem of an asset on bifrost back to an eos account, paid out by the relay as a transfer from the cross account
+#[derive(Clone, Debug, Eq, PartialEq, Event, Decode)]
+pub struct RedeemRequestedEvent<T: BridgeEos> {
+	pub redeem_id:        u64,
+	pub to:               Vec<u8>, // eos account name
+	pub quantity:         Vec<u8>, // eos asset, like "43.0000 EOS"
+	pub memo:             Vec<u8>,
+	pub _runtime:         PhantomData<T>,
+}
+
+// utility.batch, every call is already encoded with its module and call index
+#[derive(Clone, Debug, PartialEq, Call, Encode)]
+pub struct BatchCall<T: Utility> {
+	calls:                Vec<subxt::Encoded>,
+	pub _runtime:         PhantomData<T>,
+}
+
 pub async fn change_schedule_call(
 	urls:                 impl IntoIterator<Item=String>,
 	signer:               impl AsRef<str>,
@@ -81,15 +159,8 @@ pub async fn change_schedule_call(
 	block_headers:        Vec<SignedBlockHeader>,
 	block_ids_list:       Vec<Vec<Checksum256>>
 ) -> Result<String, crate::Error> {
-	let url: String = urls.into_iter().take(1).next().ok_or(crate::Error::SubxtError("failed to create subxt client"))?;
-	let client: Client<BifrostRuntime> = subxt::ClientBuilder::new()
-		.set_url(url)
-		.build()
-		.await
-		.map_err(|_| crate::Error::SubxtError("failed to create subxt client"))?;
-
-	let signer = Pair::from_string(signer.as_ref(), None).map_err(|_| crate::Error::WrongSudoSeed)?;
-	let signer = PairSigner::<BifrostRuntime, Pair>::new(signer);
+	let pool = crate::client_pool::pool(urls);
+	let (endpoint, client) = pool.client().await?;
 
 	let args = ChangeScheduleCall::<BifrostRuntime> {
 		legacy_schedule_hash,
@@ -99,9 +170,7 @@ pub async fn change_schedule_call(
 		block_ids_list,
 		_runtime: PhantomData
 	};
-	let block_hash = client.submit(args, &signer).await.map_err(|_| crate::Error::SubxtError("failed to commit this transaction"))?;
-
-	Ok(block_hash.to_string())
+	submit_with_nonce(pool, endpoint, &client, signer.as_ref(), args).await
 }
 
 pub async fn prove_action_call(
@@ -115,70 +184,8 @@ pub async fn prove_action_call(
 	block_ids_list:      Vec<Vec<Checksum256>>,
 	trx_id:              Checksum256
 ) -> Result<String, crate::Error> {
-	let url: String = urls.into_iter().take(1).next().ok_or(crate::Error::SubxtError("failed to create subxt client"))?;
-	let client: Client<BifrostRuntime> = subxt::ClientBuilder::new()
-		.set_url(url)
-		.build()
-		.await
-		.map_err(|_| crate::Error::SubxtError("failed to create subxt client"))?;
-
-	let signer = Pair::from_string(signer.as_ref(), None).map_err(|_| crate::Error::WrongSudoSeed)?;
-	let mut signer = PairSigner::<BifrostRuntime, Pair>::new(signer);
-
-	// set nonce to avoid multiple trades using the same nonce, that will cause some trades will be abandoned.
-	// https://substrate.dev/docs/en/knowledgebase/learn-substrate/tx-pool
-	static atomic_nonce: AtomicU32 = AtomicU32::new(0);
-//	static atomic_nonce: AtomicU32 = AtomicU32::new(0);
-//	static signer_current_nonce: AtomicU32 = AtomicU32::new(0);
-//	static mut latest_nonce: u32 = 0;
-	let current_nonce = client.account(&signer.signer().public().into(), None).await.map_err(|_| crate::Error::WrongSudoSeed)?.nonce;
-	// initialize signer current nonce
-//	if signer_current_nonce.load(Ordering::Relaxed) == 0 {
-//		signer_current_nonce.swap(current_nonce, Ordering::Relaxed);
-//	}
-
-	// ensure atomic nonce is bigger than current user nonce
-	if atomic_nonce.load(Ordering::Relaxed) <= current_nonce {
-		atomic_nonce.swap(current_nonce, Ordering::Relaxed);
-	}
-//
-//	// this means signer nonce has changed.
-//	if signer_current_nonce.load(Ordering::Relaxed) < current_nonce {
-//		signer_current_nonce.swap(current_nonce, Ordering::Relaxed);
-//	}
-
-//	println!("current nonce is: {:?}", current_nonce);
-//	let gap = signer_current_nonce.load(Ordering::Relaxed) as i32 - current_nonce as i32;
-//	match gap {
-//		gap if gap == 0 => {
-//			// no change on nonce
-////			atomic_nonce.fetch_add(1, Ordering::SeqCst); // increment 1
-//			signer.set_nonce(atomic_nonce.load(Ordering::Relaxed) + 1 + current_nonce);
-//			println!("equal signer current nonce is: {:?}", atomic_nonce.load(Ordering::Relaxed) + 1 + current_nonce);
-//			println!("equal atomic_nonce is: {:?}", atomic_nonce);
-////			atomic_nonce.fetch_add(1, Ordering::SeqCst); // increment 1
-//		}
-//		gap if gap > 0 => {
-//			// maybe it's unlikely to happen
-//			();
-//		}
-//		gap if gap < 0 => {
-//			// nonce has changed
-//			signer.set_nonce(current_nonce);
-//			println!("new signer current nonce is: {:?}", current_nonce);
-//			println!("new atomic_nonce is: {:?}", atomic_nonce);
-////			atomic_nonce.swap(0, Ordering::Relaxed);
-////			signer_current_nonce.swap(current_nonce, Ordering::Relaxed);
-////			atomic_nonce.swap(0, Ordering::Relaxed);
-//		}
-//		_ => (),
-//	}
-
-//	println!("atomic_nonce is: {:?}", atomic_nonce);
-//	println!("signer_current_nonce is: {:?}", atomic_nonce.load(Ordering::Relaxed));
-	println!("signer_current_nonce is: {:?}", current_nonce);
-	signer.set_nonce(atomic_nonce.load(Ordering::Relaxed));
-	atomic_nonce.fetch_add(1, Ordering::SeqCst);
+	let pool = crate::client_pool::pool(urls);
+	let (endpoint, client) = pool.client().await?;
 
 	let call = ProveActionCall::<BifrostRuntime> {
 		action,
@@ -190,120 +197,39 @@ pub async fn prove_action_call(
 		trx_id,
 		_runtime: PhantomData
 	};
-//	let block_hash = client.submit(call, &signer).await.map_err(|e| {
-//		if let SubxtErr::Rpc(err) = e {
-//			// the full error: Rpc(Request(Error { code: ServerError(1014), message: "Priority is too low: (0 vs 0)",
-//			// data: Some(String("The transaction has too low priority to replace another transaction already in the pool.")) }))
-//			println ! ("error is: {:?}", err.to_string());
-//			//			if err.to_string().as_str().contains("Priority is too low") {
-//			//				atomic_nonce.fetch_add(1, Ordering::SeqCst);
-//			//			}
-//		}
-//		crate::Error::SubxtError("failed to commit this transaction")
-//	})?;
-//	if let Err(SubxtErr::Rpc(e)) = client.submit(call, &signer).await {
-//		signer.increment_nonce();
-//		let trx_id = client.submit(call, &signer).await.map_err(|e| {
-//			println ! ("error is: {:?}", e.to_string());
-//			crate::Error::SubxtError("failed to commit this transaction")
-//		})?;
-//		return Ok(trx_id.to_string());
-//	}
-	match client.submit(call.clone(), &signer).await {
-		Ok(trx_id) => Ok(trx_id.to_string()),
-		Err(SubxtErr::Rpc(e)) => {
-//			signer.increment_nonce();
-			let trx_id = client.submit(call, &signer).await.map_err(|e| {
-				println ! ("error is: {:?}", e.to_string());
-				crate::Error::SubxtError("failed to commit this transaction")
-			})?;
-			Ok(trx_id.to_string())
-		}
-		_ => Err(crate::Error::SubxtError("failed to commit this transaction"))
-	}
-
-//	let mut index = 0u32;
-//	loop {
-//		println!("signer_current_nonce is: {:?}, index: {:?}", current_nonce, index);
-//		match client.submit(call.clone(), &signer).await {
-//			Ok(trx_id) => return Ok(trx_id.to_string()),
-//			Err(SubxtErr::Rpc(e)) => {
-//				if e.to_string().as_str().contains("Priority is too low") {
-//					index += 1;
-//					signer.increment_nonce();
-//				}
-//			}
-//			_ => {}
-//		}
-//
-//		if index >= 30 {
-//			break;
-//		}
-//	}
-//
-//	Err(crate::Error::SubxtError("failed to commit this transaction"))
-//	while let Err(SubxtErr::Rpc(e)) = client.submit(call.clone(), &signer).await {
-//		if err.to_string().as_str().contains("Priority is too low") {
-//			signer.increment_nonce();
-//		}
-//	}
-//	atomic_nonce.fetch_add(1, Ordering::SeqCst);
-
-//	let gap = atomic_nonce.load(Ordering::Relaxed) as i32 - current_nonce as i32;
-//	if gap >= 30 {
-//		atomic_nonce.swap(current_nonce, Ordering::Relaxed);
-//	}
-
-//	match gap {
-//		gap if gap == 0 => {
-//			// no change on nonce
-//			atomic_nonce.fetch_add(1, Ordering::SeqCst); // increment 1
-//		}
-//		gap if gap > 0 => {
-//			// maybe it's unlikely to happen
-//			();
-//		}
-//		gap if gap < 0 => {
-//			// nonce has changed
-//			signer_current_nonce.swap(current_nonce, Ordering::Relaxed);
-//			atomic_nonce.swap(0, Ordering::Relaxed);
-//		}
-//		_ => (),
-//	}
-
-	// if trade success, change nonce
-//	atomic_update_nonce(&atomic_nonce, current_nonce);
-//	atomic_nonce.fetch_add(1, Ordering::SeqCst);
-
-//	Ok(block_hash.to_string())
+	submit_with_nonce(pool, endpoint, &client, signer.as_ref(), call).await
 }
 
-async fn get_available_bifrost_client(urls: impl IntoIterator<Item=String>)
-	-> Result<&'static Mutex<subxt::Client<BifrostRuntime>>, crate::Error>
-{
-	for url in urls.into_iter() {
-		let client = global_client(url.as_ref()).await;
-		if client.is_ok() {
-			return client;
-		}
-	}
-
-	Err(crate::Error::SubxtError("failed to get client builder"))
-}
-
-// update nonce to avoid using the same nonce
-pub fn get_latest_nonce(atomic_nonce: &AtomicU32, current_nonce: u32) -> u32 {
-	if atomic_nonce.load(Ordering::Relaxed) < current_nonce {
-		current_nonce
-	} else {
-		atomic_nonce.load(Ordering::Relaxed) + 1
+pub(crate) async fn prove_action_batch_call(
+	urls:                impl IntoIterator<Item=String>,
+	signer:              impl AsRef<str>,
+	items:               Vec<crate::ffi_types::ProveActionItem>,
+	merkle:              IncrementalMerkle,
+	block_headers:       Vec<SignedBlockHeader>,
+	block_ids_list:      Vec<Vec<Checksum256>>
+) -> Result<String, crate::Error> {
+	let pool = crate::client_pool::pool(urls);
+	let (endpoint, client) = pool.client().await?;
+
+	// headers and id lists are converted once for the whole batch
+	let mut calls = Vec::with_capacity(items.len());
+	for item in items.into_iter() {
+		let call = ProveActionCall::<BifrostRuntime> {
+			action:              item.action,
+			action_receipt:      item.action_receipt,
+			action_merkle_paths: item.action_merkle_paths,
+			merkle:              merkle.clone(),
+			block_headers:       block_headers.clone(),
+			block_ids_list:      block_ids_list.clone(),
+			trx_id:              item.trx_id,
+			_runtime:            PhantomData
+		};
+		calls.push(client.encode(call).map_err(|_| crate::Error::SubxtError("failed to encode prove action call"))?);
 	}
-}
 
-pub fn atomic_update_nonce(atomic_nonce: &AtomicU32, current_nonce: u32) {
-	if atomic_nonce.load(Ordering::Relaxed) < current_nonce {
-		atomic_nonce.swap(current_nonce, Ordering::Relaxed);
-	} else {
-		atomic_nonce.fetch_add(1, Ordering::SeqCst);
-	}
+	let batch = BatchCall::<BifrostRuntime> {
+		calls,
+		_runtime: PhantomData
+	};
+	submit_with_nonce(pool, endpoint, &client, signer.as_ref(), batch).await
 }
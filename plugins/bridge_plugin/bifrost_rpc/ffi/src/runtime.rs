@@ -0,0 +1,106 @@
+// Copyright 2019-2020 Liebi Technologies.
+// This file is part of Bifrost.
+
+// Bifrost is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// Bifrost is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with Bifrost.  If not, see <http://www.gnu.org/licenses/>.
+
+// Multi-threaded runtime owned by the library, driving the submit_* calls. A submission only holds a
+// worker thread while it makes progress, so hundreds of them can await finalization at the same time
+// and share the connections and timers of the runtime.
+
+use once_cell::sync::Lazy;
+use std::{future::Future, os::raw::c_void, sync::Mutex, time::Duration};
+use tokio::runtime::{Builder, Runtime};
+
+use crate::{ffi_types::{generate_raw_result, RpcResponse}, RpcCallback};
+
+static RUNTIME: Lazy<Mutex<Option<Runtime>>> = Lazy::new(|| Mutex::new(None));
+
+// the c++ caller owns user_data, it's only handed back to the callback
+pub(crate) struct UserData(pub(crate) *mut c_void);
+unsafe impl Send for UserData {}
+
+pub(crate) fn start(worker_threads: usize) -> Result<(), String> {
+	let mut runtime = RUNTIME.lock().map_err(|e| e.to_string())?;
+	if runtime.is_none() {
+		*runtime = Some(
+			Builder::new()
+				.threaded_scheduler()
+				.core_threads(worker_threads.max(1))
+				.thread_name("bifrost-rpc")
+				.enable_all()
+				.build()
+				.map_err(|e| e.to_string())?
+		);
+	}
+	Ok(())
+}
+
+pub(crate) fn stop() {
+	let runtime = RUNTIME.lock().ok().and_then(|mut r| r.take());
+	if let Some(runtime) = runtime {
+		runtime.shutdown_timeout(Duration::from_secs(5));
+	}
+}
+
+pub(crate) fn submit<F>(f: F, callback: RpcCallback, user_data: *mut c_void)
+	where F: Future<Output=Box<RpcResponse>> + Send + 'static
+{
+	let handle = RUNTIME.lock().ok().and_then(|r| r.as_ref().map(|r| r.handle().clone()));
+	let user_data = UserData(user_data);
+	match handle {
+		Some(handle) => {
+			handle.spawn(async move {
+				let result = f.await;
+				callback(Box::into_raw(result), user_data.0);
+			});
+		}
+		None => callback(Box::into_raw(generate_raw_result(false, "bifrost rpc runtime is not started")), user_data.0),
+	}
+}
+
+// runs f until it completes or the runtime is stopped, false if the runtime is not started
+pub(crate) fn spawn<F>(f: F) -> bool
+	where F: Future<Output=()> + Send + 'static
+{
+	let handle = RUNTIME.lock().ok().and_then(|r| r.as_ref().map(|r| r.handle().clone()));
+	match handle {
+		Some(handle) => {
+			handle.spawn(f);
+			true
+		}
+		None => false,
+	}
+}
+
+// blocks the calling thread on f, which may use the timers of tokio. f runs on the runtime of the library
+// when it's started, otherwise on a runtime made for this call
+pub(crate) fn block_on<F>(f: F) -> Box<RpcResponse>
+	where F: Future<Output=Box<RpcResponse>> + Send + 'static
+{
+	let handle = RUNTIME.lock().ok().and_then(|r| r.as_ref().map(|r| r.handle().clone()));
+	match handle {
+		Some(handle) => {
+			let (tx, rx) = std::sync::mpsc::channel();
+			handle.spawn(async move {
+				let _ = tx.send(f.await);
+			});
+			// the sender is dropped without a result if the runtime is stopped meanwhile
+			rx.recv().unwrap_or_else(|_| generate_raw_result(false, "bifrost rpc runtime is stopped"))
+		}
+		None => match Builder::new().basic_scheduler().enable_all().build() {
+			Ok(mut runtime) => runtime.block_on(f),
+			Err(e) => generate_raw_result(false, e.to_string()),
+		},
+	}
+}
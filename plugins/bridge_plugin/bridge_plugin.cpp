@@ -1,19 +1,36 @@
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/merkle.hpp>
+#include <eosio/chain/signal_stats.hpp>
+#include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/trace_spans.hpp>
 #include <eosio/chain/types.hpp>
 
 #include <boost/multi_index_container.hpp>
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/algorithm/string.hpp>
 #include <boost/asio/steady_timer.hpp>
 #include <fc/io/fstream.hpp>
+#include <algorithm>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <fc/log/logger_config.hpp>
 #include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+#include <map>
 #include <mutex>
+#include <random>
+#include <set>
 #include <thread>
+#include <unordered_map>
 
 #include "bifrost_rpc.h"
 #include <eosio/bridge_plugin/bridge_plugin.hpp>
 #include <eosio/bridge_plugin/ffi_types.hpp>
+#include <eosio/state_history_plugin/state_history_log.hpp>
 
 namespace eosio {
    using boost::multi_index_container;
@@ -22,17 +39,10 @@ namespace eosio {
    static appbase::abstract_plugin &_bridge_plugin = app().register_plugin<bridge_plugin>();
 
    struct by_status;
+   struct by_trx;
    digest_type digest(const action &act) { return digest_type::hash(act); }
    std::mutex mtx;
 
-   typedef multi_index_container<
-           bridge_blocks,
-           indexed_by<
-              ordered_unique<tag<by_id>,
-              member<bridge_blocks, block_id_type, &bridge_blocks::id>>
-           >
-   > bridge_block_index;
-
    typedef multi_index_container<
            bridge_change_schedule,
            indexed_by<
@@ -42,7 +52,10 @@ namespace eosio {
               >,
               ordered_non_unique<
                  tag<by_status>,
-                 member<bridge_change_schedule, uint8_t, &bridge_change_schedule::status>
+                 composite_key< bridge_change_schedule,
+                    member<bridge_change_schedule, uint8_t, &bridge_change_schedule::status>,
+                    member<bridge_change_schedule, uint32_t, &bridge_change_schedule::block_num>
+                 >
               >
            >
    > bridge_change_schedule_index;
@@ -56,491 +69,2261 @@ namespace eosio {
               >,
               ordered_non_unique<
                  tag<by_status>,
-                 member<bridge_prove_action, uint8_t, &bridge_prove_action::status>
+                 composite_key< bridge_prove_action,
+                    member<bridge_prove_action, uint8_t, &bridge_prove_action::status>,
+                    member<bridge_prove_action, uint32_t, &bridge_prove_action::block_num>
+                 >
+              >,
+              ordered_non_unique<
+                 tag<by_trx>,
+                 member<bridge_prove_action, transaction_id_type, &bridge_prove_action::trx_id>
               >
            >
     > bridge_prove_action_index;
 
+   /**
+    * Shape of the block headers proving the finality of a block to the Bifrost verifier.
+    * One header is taken every round_stride blocks, so consecutive headers are signed by
+    * distinct producers, until 2/3+1 of the active producers signed (capped by max_headers).
+    * The blocks in between each pair of headers are passed by id, except the last one whose id is the
+    * previous of the next header, as verify_finality_proof expects. max_ids_per_gap is the most the
+    * verifier accepts, checked against round_stride on startup.
+    */
+   struct bridge_window_geometry {
+      uint32_t round_stride    = config::producer_repetitions;
+      uint32_t max_headers     = 15;
+      uint32_t max_ids_per_gap = 10;
+
+      uint32_t required_headers(size_t producer_count) const {
+         return std::max<uint32_t>(1, std::min<uint32_t>(max_headers, producer_count * 2 / 3 + 1));
+      }
+
+      // number of blocks starting at the proved block which have to be collected
+      uint32_t span(size_t producer_count) const {
+         return round_stride * (required_headers(producer_count) - 1) + 1;
+      }
+
+      uint32_t max_span() const { return round_stride * (max_headers - 1) + 1; }
+
+      uint32_t ids_per_gap() const { return round_stride - 2; }
+   };
+
+   /**
+    * Share of the bridge work submitted by this relay when several relays, each with its own signer,
+    * watch the same accounts. Every relay sees all transfers but only captures those whose receipt
+    * digest falls into its partition, schedule changes are proved by the relay of partition 0 only.
+    */
+   struct bridge_partition {
+      uint32_t index = 0;
+      uint32_t count = 1;
+
+      bool owns(const digest_type &act_receipt_digest) const { return act_receipt_digest._hash[0] % count == index; }
+      bool leader() const { return index == 0; }
+   };
+
+   bridge_header_record make_header_record(const block_state &bs) {
+      return bridge_header_record{bs.block_num, bs.id, bs.header, bs.blockroot_merkle, uint32_t(bs.active_schedule->producers.size())};
+   }
+
+   /**
+    * Irreversible blocks shared by all pending bridge entries, addressed by block number.
+    * Pending entries only keep their block number and refer to the range
+    * [block_num, block_num + span) in it, so memory grows with the window
+    * size rather than with window size times pending entries.
+    */
+   class bridge_block_window {
+   public:
+      // blocks must be appended in order, a gap starts a new window
+      void push_back(bridge_header_record rec) {
+         if (!empty() && rec.block_num != last_block_num() + 1) clear();
+         if (count == ring.size()) grow();
+         if (empty()) first = rec.block_num;
+         ring[slot(rec.block_num)] = std::move(rec);
+         ++count;
+      }
+
+      // nullptr if the block is not in the window, valid until the window is modified
+      const bridge_header_record *get(uint32_t block_num) const {
+         if (empty() || block_num < first_block_num() || block_num > last_block_num()) return nullptr;
+         return &ring[slot(block_num)];
+      }
+
+      bool contains(uint32_t first_num, uint32_t last_num) const {
+         return !empty() && first_num >= first_block_num() && last_num <= last_block_num();
+      }
+
+      // drop all blocks before first_needed
+      void prune(uint32_t first_needed) {
+         while (!empty() && first < first_needed) {
+            ring[slot(first)] = bridge_header_record();
+            ++first;
+            --count;
+         }
+      }
+
+      // drop all blocks after last_needed, a fork switch replaces them
+      void truncate(uint32_t last_needed) {
+         while (!empty() && last_block_num() > last_needed) {
+            ring[slot(last_block_num())] = bridge_header_record();
+            --count;
+         }
+      }
+
+      uint32_t first_block_num() const { return first; }
+      uint32_t last_block_num() const { return first + count - 1; }
+      size_t size() const { return count; }
+      bool empty() const { return count == 0; }
+      void clear() {
+         for (auto &b : ring) b = bridge_header_record();
+         count = 0;
+      }
+
+      class const_iterator {
+      public:
+         const_iterator(const bridge_block_window &w, uint32_t n) : window(&w), num(n) {}
+         const bridge_header_record &operator*() const { return window->ring[window->slot(num)]; }
+         const_iterator &operator++() { ++num; return *this; }
+         bool operator!=(const const_iterator &o) const { return num != o.num; }
+      private:
+         const bridge_block_window *window;
+         uint32_t                   num;
+      };
+
+      const_iterator begin() const { return const_iterator(*this, first); }
+      const_iterator end() const { return const_iterator(*this, first + count); }
+
+   private:
+      // capacity is a power of two, so a block's slot is its number masked
+      size_t slot(uint32_t block_num) const { return block_num & (ring.size() - 1); }
+
+      void grow() {
+         std::vector<bridge_header_record> bigger(std::max<size_t>(256, ring.size() * 2));
+         for (uint32_t i = 0; i < count; ++i) bigger[(first + i) & (bigger.size() - 1)] = std::move(ring[slot(first + i)]);
+         ring.swap(bigger);
+      }
+
+      std::vector<bridge_header_record> ring;
+      uint32_t                          first = 0;
+      uint32_t                          count = 0;
+   };
+
+   // headers proving a block from the window and the ids of the blocks in between, false if the window lacks part of them
+   std::tuple<std::vector<signed_block_header>, std::vector<std::vector<block_id_type>>, bool>
+   collect_window_blocks(const bridge_block_window &window, const bridge_window_geometry &geometry, uint32_t block_num) {
+      auto bl_state = window.get(block_num); // which block is need to be verified
+      if (!bl_state) return std::make_tuple(std::vector<signed_block_header>(), std::vector<std::vector<block_id_type>>(), false);
+      const uint32_t required = geometry.required_headers(bl_state->producer_count);
+
+      std::vector<signed_block_header> block_headers;
+      block_headers.reserve(required);
+      block_headers.push_back(bl_state->header);
+
+      // block_id_lists[k] holds the ids following headers[k - 1], the first list is empty
+      std::vector<std::vector<block_id_type>> block_id_lists;
+      block_id_lists.reserve(required);
+      block_id_lists.push_back(std::vector<block_id_type>());
+      const uint32_t ids_per_gap = geometry.ids_per_gap();
+      for (uint32_t k = 1; k < required; ++k) {
+         const uint32_t prev = block_num + (k - 1) * geometry.round_stride;
+         auto header = window.get(prev + geometry.round_stride);
+         if (!header) return std::make_tuple(std::vector<signed_block_header>(), std::vector<std::vector<block_id_type>>(), false);
+
+         block_id_lists.push_back(std::vector<block_id_type>());
+         auto &ids = block_id_lists.back();
+         ids.reserve(ids_per_gap);
+         for (uint32_t num = prev + 1; num <= prev + ids_per_gap; ++num) ids.push_back(window.get(num)->id);
+         block_headers.push_back(header->header);
+      }
+
+      return std::make_tuple(std::move(block_headers), std::move(block_id_lists), true);
+   }
+
+   /**
+    * Producer schedules and pending schedule hashes the recent blocks were signed under, which a proof's
+    * signatures are checked against. Only the changes of the hash are kept, and schedules by version as
+    * there are few of them. Kept in memory only, blocks older than the first one seen since startup have none.
+    */
+   class bridge_signing_history {
+   public:
+      void add(const block_state &bs) {
+         schedules.emplace(bs.active_schedule->version, bs.active_schedule);
+         const auto &hash = bs.pending_schedule.schedule_hash;
+         if (bs.block_num <= last_num) {
+            auto known = schedule_hash(bs.block_num);
+            if (known && *known == hash) return;
+            // a fork switch replaced the block, the blocks after it are replaced as well
+            hashes.erase(hashes.lower_bound(bs.block_num), hashes.end());
+         } else if (bs.block_num != last_num + 1) {
+            hashes.clear();
+         }
+         if (hashes.empty() || hashes.rbegin()->second != hash) hashes.emplace(bs.block_num, hash);
+         last_num = bs.block_num;
+      }
+
+      // pending_schedule.schedule_hash of the block, part of its signature digest
+      fc::optional<digest_type> schedule_hash(uint32_t block_num) const {
+         if (hashes.empty() || block_num < hashes.begin()->first || block_num > last_num) return {};
+         return std::prev(hashes.upper_bound(block_num))->second;
+      }
+
+      const producer_authority_schedule *schedule(uint32_t version) const {
+         auto itr = schedules.find(version);
+         return itr == schedules.end() ? nullptr : &*itr->second;
+      }
+
+      // drop the hashes of the blocks before first_needed
+      void prune(uint32_t first_needed) {
+         while (hashes.size() > 1 && std::next(hashes.begin())->first <= first_needed) hashes.erase(hashes.begin());
+      }
+
+   private:
+      std::map<uint32_t, digest_type>                     hashes; // first block of each schedule hash
+      std::map<uint32_t, producer_authority_schedule_ptr> schedules;
+      uint32_t                                            last_num = 0;
+   };
+
+   /**
+    * Checks the headers proving the finality of block_num the way the Bifrost verifier does, returns why
+    * they would be rejected. imcre_merkle is the blockroot_merkle of the block before block_num, it has to
+    * lead to the blockroot_merkle of every header once the ids in between are appended, which together with
+    * the schedule hash gives the digest the header's producer signed. Signatures are only checked for the
+    * headers whose schedule hash and schedule are in history.
+    */
+   fc::optional<string> verify_finality_proof(const bridge_signing_history &history, uint32_t block_num,
+                                              const incremental_merkle &imcre_merkle,
+                                              const std::vector<signed_block_header> &headers,
+                                              const std::vector<std::vector<block_id_type>> &id_lists) {
+      if (headers.empty()) return string("no block header");
+      if (id_lists.size() != headers.size()) {
+         return fc::format_string("${h} headers but ${l} id lists", fc::mutable_variant_object()("h", headers.size())("l", id_lists.size()));
+      }
+      if (!id_lists.front().empty()) return string("the id list of the first header is not empty");
+      if (imcre_merkle._node_count + 2 != block_num) {
+         return fc::format_string("incremental merkle covers ${c} blocks, block ${n} needs ${e}",
+               fc::mutable_variant_object()("c", imcre_merkle._node_count)("n", block_num)("e", block_num - 2));
+      }
+
+      incremental_merkle merkle = imcre_merkle;
+      std::set<account_name> signers;
+      uint32_t expected_num = block_num;
+      for (size_t k = 0; k < headers.size(); ++k) {
+         const auto &header = headers[k];
+         if (k > 0) {
+            const uint32_t prev_num = headers[k - 1].block_num();
+            merkle.append(headers[k - 1].id());
+            for (size_t j = 0; j < id_lists[k].size(); ++j) {
+               const uint32_t num = block_header::num_from_id(id_lists[k][j]);
+               if (num != prev_num + 1 + j) {
+                  return fc::format_string("id ${j} after header ${k} is of block ${n}, expected ${e}",
+                        fc::mutable_variant_object()("j", j)("k", k - 1)("n", num)("e", prev_num + 1 + j));
+               }
+               merkle.append(id_lists[k][j]);
+            }
+            expected_num = prev_num + id_lists[k].size() + 2;
+         }
+         if (header.block_num() != expected_num) {
+            return fc::format_string("header ${k} is of block ${n}, expected ${e}, it doesn't link to the blocks before it",
+                  fc::mutable_variant_object()("k", k)("n", header.block_num())("e", expected_num));
+         }
+         merkle.append(header.previous);
+
+         if (!signers.insert(header.producer).second) {
+            return fc::format_string("header ${k} of block ${n} is signed by ${p} again",
+                  fc::mutable_variant_object()("k", k)("n", expected_num)("p", header.producer));
+         }
+
+         auto schedule_hash = history.schedule_hash(expected_num);
+         auto schedule = history.schedule(header.schedule_version);
+         if (!schedule_hash || !schedule) continue;
+
+         auto producer = std::find_if(schedule->producers.begin(), schedule->producers.end(),
+                                      [&](const producer_authority &p) { return p.producer_name == header.producer; });
+         if (producer == schedule->producers.end()) {
+            return fc::format_string("producer ${p} of block ${n} is not part of schedule ${v}",
+                  fc::mutable_variant_object()("p", header.producer)("n", expected_num)("v", header.schedule_version));
+         }
+         const auto header_bmroot = digest_type::hash(std::make_pair(header.digest(), merkle.get_root()));
+         const auto sig_digest = digest_type::hash(std::make_pair(header_bmroot, *schedule_hash));
+         std::set<public_key_type> keys;
+         try {
+            keys.emplace(fc::crypto::public_key(header.producer_signature, sig_digest, true));
+         } catch (const fc::exception &e) {
+            return fc::format_string("signature of block ${n} can't be recovered: ${e}", fc::mutable_variant_object()("n", expected_num)("e", e.to_string()));
+         }
+         if (!producer->keys_satisfy_and_relevant(keys).first) {
+            return fc::format_string("block ${n} is not signed by a key of ${p}, the blockroot merkle or the header doesn't match what was signed",
+                  fc::mutable_variant_object()("n", expected_num)("p", header.producer));
+         }
+      }
+      return {};
+   }
+
+   // checks that the receipt of the entry is a leaf of the action_mroot of its block header
+   fc::optional<string> verify_action_proof(const bridge_prove_action &entry, const signed_block_header &header) {
+      if (entry.receipt.act_digest != digest(entry.act)) return string("the receipt is not the one of the action");
+      if (entry.receipt.digest() != entry.act_receipt_digest) return string("act_receipt_digest is not the digest of the receipt");
+
+      digest_type node = entry.act_receipt_digest;
+      for (const auto &p : entry.action_merkle_paths) {
+         node = is_canonical_left(p) ? hash_canonical_pair(p, node)
+                                     : hash_canonical_pair(node, p);
+      }
+      if (node != header.action_mroot) {
+         return fc::format_string("merkle path leads to ${r}, the action_mroot of block ${n} is ${m}",
+               fc::mutable_variant_object()("r", node)("n", header.block_num())("m", header.action_mroot));
+      }
+      return {};
+   }
+
+   // a redeem requested on bifrost, paid out as a token transfer from the cross account
+   struct bridge_redeem {
+      uint64_t                                 id = 0;
+      account_name                             to;
+      asset                                    quantity;
+      string                                   memo;
+      uint32_t                                 bifrost_block = 0; // block of bifrost the redeem was requested in
+      fc::time_point                           requested; // arrival of the event, for the latency up to its receipt
+   };
+
+   // a transaction of redeem transfers pushed to the producer, kept until its receipt is irreversible
+   struct redeem_transaction {
+      std::vector<bridge_redeem>               redeems;
+      fc::time_point_sec                       expiration;
+      uint32_t                                 lib_num = 0; // irreversible when it was pushed, it can only be in later blocks
+      packed_transaction_ptr                   trx;
+   };
+}
+
+// requested is not kept, a redeem read back from the journal or bridge_db.dat arrived when it was read
+FC_REFLECT( eosio::bridge_redeem, (id)(to)(quantity)(memo)(bifrost_block) )
+
+namespace eosio {
+
+   // leads a bridge_db.dat holding bridge_header_records, every byte has its high bit set so as the varint
+   // block count older versions start with it would stand for more blocks than any file of theirs holds
+   static constexpr uint32_t bridge_db_magic = 0xf0b1d8e2;
+
+   // compact bridge_db.dat once the journal grows beyond this
+   static constexpr uint64_t bridge_journal_max_size = 64 * 1024 * 1024;
+
+   /**
+    * Append-only log of every change of the bridge indexes since bridge_db.dat was written.
+    * Each change is flushed when it happens, so a crash only loses the record being written.
+    * Records are length prefixed, a torn record at the end of the log is ignored on replay.
+    * Replaying a record which is already part of bridge_db.dat is harmless.
+    */
+   class bridge_journal {
+   public:
+      enum record_type : uint8_t {
+         block_record                  = 0, // irreversible block_state appended to the window, written by older versions
+         prove_action_record           = 1, // bridge_prove_action inserted or replaced
+         prove_action_status_record    = 2, // act_receipt_digest, status
+         erase_prove_action_record     = 3, // act_receipt_digest
+         change_schedule_record        = 4, // bridge_change_schedule inserted or replaced
+         change_schedule_status_record = 5, // block_num, status
+         erase_change_schedule_record  = 6, // block_num
+         header_record                 = 7, // bridge_header_record of an irreversible block appended to the window
+         redeem_record                 = 8, // bridge_redeem received from bifrost
+         redeem_trx_record             = 9, // lib_num, packed_transaction, bridge_redeems of a redeem transaction pushed
+         requeue_redeem_trx_record     = 10, // transaction id, its redeems are queued again
+         redeem_trx_done_record        = 11, // transaction id, its receipt is irreversible
+         redeem_block_record           = 12, // bifrost block whose redeems are all received
+      };
+
+      ~bridge_journal() { close(); }
+
+      void open(const fc::path &p) {
+         close();
+         path = p;
+         journal_size = fc::exists(path) ? fc::file_size(path) : 0;
+         out.open(path.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::app);
+         EOS_ASSERT( out.good(), plugin_exception, "unable to open bridge journal ${p}", ("p", path) );
+      }
+
+      void close() {
+         if (out.is_open()) out.close();
+      }
+
+      // drop all records, they are part of bridge_db.dat now
+      void truncate() {
+         close();
+         out.open(path.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc);
+         journal_size = 0;
+      }
+
+      uint64_t size() const { return journal_size; }
+
+      void append_block(const bridge_header_record &rec) { append(header_record, rec); }
+
+      void upsert(const bridge_prove_action &entry) { append(prove_action_record, entry); }
+      void upsert(const bridge_change_schedule &entry) { append(change_schedule_record, entry); }
+
+      void set_status(const bridge_prove_action &entry) { append(prove_action_status_record, entry.act_receipt_digest, entry.status); }
+      void set_status(const bridge_change_schedule &entry) { append(change_schedule_status_record, entry.block_num, entry.status); }
+
+      void erase(const bridge_prove_action &entry) { append(erase_prove_action_record, entry.act_receipt_digest); }
+      void erase(const bridge_change_schedule &entry) { append(erase_change_schedule_record, entry.block_num); }
+
+      void add_redeem(const bridge_redeem &r) { append(redeem_record, r); }
+      void push_redeem_trx(const redeem_transaction &t) { append(redeem_trx_record, t.lib_num, *t.trx, t.redeems); }
+      void requeue_redeem_trx(const transaction_id_type &id) { append(requeue_redeem_trx_record, id); }
+      void redeem_trx_done(const transaction_id_type &id) { append(redeem_trx_done_record, id); }
+      void redeem_block(uint32_t bifrost_block) { append(redeem_block_record, bifrost_block); }
+
+   private:
+      template<typename... T>
+      void append(record_type type, const T&... payload) {
+         if (!out.is_open()) return;
+         const uint8_t t = type;
+         uint32_t len = fc::raw::pack_size(t);
+         ((len += fc::raw::pack_size(payload)), ...);
+
+         std::vector<char> data(sizeof(len) + len);
+         fc::datastream<char*> ds(data.data(), data.size());
+         fc::raw::pack(ds, len);
+         fc::raw::pack(ds, t);
+         (fc::raw::pack(ds, payload), ...);
+
+         out.write(data.data(), data.size());
+         out.flush();
+         journal_size += data.size();
+      }
+
+      fc::path      path;
+      std::ofstream out;
+      uint64_t      journal_size = 0;
+   };
+
+   // by_status is ordered by (status, block_num), so the entries of one status are
+   // visited in block order and lookups only touch the entries they affect
+
+   // only while an entry collects blocks its collectors have anything to do
+   template<typename Index>
+   bool has_collecting(const Index &index) {
+      auto &idx = index.template get<by_status>();
+      auto itr = idx.lower_bound(std::make_tuple(uint8_t(bridge_status::collecting)));
+      return itr != idx.end() && itr->status == bridge_status::collecting;
+   }
+
+   // entries still collecting whose whole block range is now in the window become ready,
+   // the range depends on the producer count of the schedule that was active for the entry's block
+   template<typename Index, typename OnReady>
+   void mark_collected(Index &index, const bridge_block_window &window, const bridge_window_geometry &geometry,
+                       bridge_journal &journal, const block_state_ptr &block, const char *what, OnReady &&on_ready) {
+      auto &idx = index.template get<by_status>();
+
+      // need previous block blockroot_merkle
+      auto range = idx.equal_range(std::make_tuple(uint8_t(bridge_status::collecting), block->block_num + 1));
+      for (auto itr = range.first; itr != range.second; ++itr) {
+         idx.modify(itr, [&](auto &entry) {
+            entry.imcre_merkle = block->blockroot_merkle;
+         });
+         journal.upsert(*itr);
+      }
+
+      auto itr = idx.lower_bound(std::make_tuple(uint8_t(bridge_status::collecting)));
+      while (itr != idx.end() && itr->status == bridge_status::collecting && itr->block_num <= block->block_num) {
+         auto cur = itr++; // cur leaves the collecting range once modified
+         if (cur->block_num == 0) continue;
+         auto first = window.get(cur->block_num);
+         if (!first) continue;
+         const uint32_t span = geometry.span(first->producer_count);
+         if (!window.contains(cur->block_num, cur->block_num + span - 1)) continue;
+         idx.modify(cur, [&](auto &entry) {
+            ilog("collected blocks for ${what}: ${to}", ("what", what)("to", block->block_num));
+            entry.status = bridge_status::ready; // full
+         });
+         journal.set_status(*cur);
+         on_ready(*cur);
+      }
+   }
+
+   // entries still collecting whose block is irreversible become ready as soon as the reversible blocks of the
+   // speculative window cover their range, on_ready gets the proof taken from it. Only if the speculative window
+   // holds the very block that became irreversible, the proof of a block of an abandoned fork is never used.
+   template<typename Index, typename OnReady>
+   void mark_speculatively_collected(Index &index, const bridge_block_window &window, const bridge_block_window &speculative,
+                                     const bridge_window_geometry &geometry, bridge_journal &journal,
+                                     const block_state_ptr &block, const char *what, OnReady &&on_ready) {
+      auto &idx = index.template get<by_status>();
+      auto itr = idx.lower_bound(std::make_tuple(uint8_t(bridge_status::collecting)));
+      while (itr != idx.end() && itr->status == bridge_status::collecting && itr->block_num <= block->block_num) {
+         auto cur = itr++; // cur leaves the collecting range once modified
+         if (cur->block_num == 0) continue;
+         auto first = window.get(cur->block_num);
+         auto candidate = speculative.get(cur->block_num);
+         if (!first || !candidate || candidate->id != first->id) continue;
+         const uint32_t span = geometry.span(first->producer_count);
+         if (!speculative.contains(cur->block_num, cur->block_num + span - 1)) continue;
+         auto proof = collect_window_blocks(speculative, geometry, cur->block_num);
+         if (!std::get<2>(proof)) continue;
+         idx.modify(cur, [&](auto &entry) {
+            ilog("collected reversible blocks for ${what}: ${to}", ("what", what)("to", speculative.last_block_num()));
+            entry.status = bridge_status::ready;
+         });
+         journal.set_status(*cur);
+         on_ready(*cur, std::move(std::get<0>(proof)), std::move(std::get<1>(proof)));
+      }
+   }
+
+   // lowest block number still needed by an entry which is not sent yet
+   template<typename Index>
+   uint32_t first_needed_block_num(const Index &index, uint32_t first_needed) {
+      return first_needed_block_num(index, first_needed, [](uint32_t) { return false; });
+   }
+
+   // entries of blocks for which held_elsewhere is true don't need the window
+   template<typename Index, typename HeldElsewhere>
+   uint32_t first_needed_block_num(const Index &index, uint32_t first_needed, HeldElsewhere &&held_elsewhere) {
+      auto &idx = index.template get<by_status>();
+      for (uint8_t status : { uint8_t(bridge_status::collecting), uint8_t(bridge_status::ready), uint8_t(bridge_status::submitting) }) {
+         auto itr = idx.lower_bound(std::make_tuple(status));
+         while (itr != idx.end() && itr->status == status && held_elsewhere(itr->block_num)) ++itr;
+         if (itr != idx.end() && itr->status == status) first_needed = std::min(first_needed, itr->block_num);
+      }
+      return first_needed;
+   }
+
+   template<typename Index, typename Iterator>
+   void set_status(Index &index, bridge_journal &journal, Iterator itr, uint8_t status) {
+      index.modify(itr, [&](auto &entry) {
+         entry.status = status;
+      });
+      journal.set_status(*itr);
+   }
+
+   template<typename Index>
+   void reset_submitting(Index &index) {
+      auto &idx = index.template get<by_status>();
+      auto itr = idx.lower_bound(std::make_tuple(uint8_t(bridge_status::submitting)));
+      while (itr != idx.end() && itr->status == bridge_status::submitting) {
+         auto cur = itr++;
+         idx.modify(cur, [](auto &entry) { entry.status = bridge_status::ready; });
+      }
+   }
+
+   // primary iterators of all ready entries, taken before submitting since submission changes the status
+   template<typename Index>
+   std::vector<typename Index::iterator> ready_entries(Index &index) {
+      std::vector<typename Index::iterator> ready;
+      auto &idx = index.template get<by_status>();
+      auto range = idx.equal_range(std::make_tuple(uint8_t(bridge_status::ready)));
+      for (auto itr = range.first; itr != range.second; ++itr) {
+         ready.push_back(index.template project<0>(itr));
+      }
+      return ready;
+   }
+
+   /**
+    * Next attempt time of entries whose submission failed. A failed entry goes back to ready and
+    * is skipped until its backoff expired; the backoff doubles with every failure up to max_backoff
+    * and is jittered by +-50% so entries failing together do not retry in lockstep.
+    * Kept in memory only, after a restart every ready entry is due immediately.
+    */
+   template<typename Key>
+   class bridge_retry_schedule {
+   public:
+      using clock = std::chrono::steady_clock;
+
+      void set_backoff(clock::duration base, clock::duration max) {
+         base_backoff = base;
+         max_backoff = std::max(base, max);
+      }
+
+      bool due(const Key &key, clock::time_point now) const {
+         auto itr = retries.find(key);
+         return itr == retries.end() || itr->second.next_attempt <= now;
+      }
+
+      void failed(const Key &key, clock::time_point now) {
+         ++failures;
+         auto &r = retries[key];
+         auto backoff = base_backoff;
+         for (uint32_t i = 0; i < r.attempts && backoff < max_backoff; ++i) backoff *= 2;
+         backoff = std::min(backoff, max_backoff);
+         std::uniform_real_distribution<double> jitter(0.5, 1.5);
+         r.next_attempt = now + std::chrono::duration_cast<clock::duration>(backoff * jitter(rng));
+         ++r.attempts;
+      }
+
+      void succeeded(const Key &key) { retries.erase(key); }
+
+      uint32_t attempts(const Key &key) const {
+         auto itr = retries.find(key);
+         return itr == retries.end() ? 0 : itr->second.attempts;
+      }
+
+      uint64_t total_failures() const { return failures; }
+      size_t pending() const { return retries.size(); }
+
+   private:
+      struct retry {
+         uint32_t          attempts = 0;
+         clock::time_point next_attempt;
+      };
+
+      clock::duration         base_backoff = std::chrono::seconds(1);
+      clock::duration         max_backoff = std::chrono::minutes(1);
+      std::map<Key, retry>    retries;
+      uint64_t                failures = 0;
+      std::minstd_rand        rng{std::random_device{}()};
+   };
+
+   // limits on what the bridge keeps in memory
+   struct bridge_retention {
+      uint32_t max_entries = 65536;             // prove action and change schedule entries
+      uint64_t max_bytes = 256 * 1024 * 1024;   // packed size of these entries
+      uint32_t finalized_retain_blocks = 7200;  // finalized entries are dropped once this many blocks old
+      uint32_t spill_after_failures = 8;        // prove actions failing this often wait for their retry on disk
+   };
+
+   /**
+    * Prove actions waiting for a long retry, one file per entry named by its receipt digest.
+    * Spilled entries are neither in prove_action_index nor in bridge_db.dat, the file is the only copy.
+    */
+   class bridge_spill_store {
+   public:
+      // remembers the spilled entries, their contents stay on disk
+      void open(const fc::path &d) {
+         dir = d;
+         if (!fc::is_directory(dir)) fc::create_directories(dir);
+         for (fc::directory_iterator itr(dir), end; itr != end; ++itr) {
+            auto proof = read(*itr);
+            if (proof) entries.emplace(proof->entry.act_receipt_digest, proof->entry.block_num);
+            else fc::remove(*itr);
+         }
+      }
+
+      void put(const bridge_proof &proof) {
+         auto p = path(proof.entry.act_receipt_digest);
+         auto data = fc::raw::pack(proof);
+         {
+            std::ofstream out(p.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc);
+            out.write(data.data(), data.size());
+         }
+         entries.emplace(proof.entry.act_receipt_digest, proof.entry.block_num);
+      }
+
+      fc::optional<bridge_proof> take(const block_id_type &key) {
+         auto p = path(key);
+         auto proof = read(p);
+         fc::remove(p);
+         entries.erase(key);
+         return proof;
+      }
+
+      fc::optional<bridge_proof> get(const block_id_type &key) const {
+         if (!entries.count(key)) return fc::optional<bridge_proof>();
+         return read(path(key));
+      }
+
+      const std::map<block_id_type, uint32_t> &spilled() const { return entries; }
+
+   private:
+      fc::path path(const block_id_type &key) const { return dir / (key.str() + ".bin"); }
+
+      static fc::optional<bridge_proof> read(const fc::path &p) {
+         try {
+            string content;
+            fc::read_file_contents(p, content);
+            fc::datastream<const char *> ds(content.data(), content.size());
+            bridge_proof proof;
+            fc::raw::unpack(ds, proof);
+            return proof;
+         } catch (const fc::exception &e) {
+            wlog("ignoring unreadable spilled bridge entry ${p}: ${e}", ("p", p)("e", e.to_detail_string()));
+         }
+         return fc::optional<bridge_proof>();
+      }
+
+      fc::path                          dir;
+      std::map<block_id_type, uint32_t> entries; // receipt digest => block_num
+   };
+
+   bridge_latency_histogram::bridge_latency_histogram()
+      : bounds_ms{100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000, 120000, 300000, 600000}
+      , counts(bounds_ms.size() + 1, 0) {}
+
+   void bridge_latency_histogram::add(fc::microseconds latency) {
+      const uint64_t ms = std::max<int64_t>(latency.count(), 0) / 1000;
+      auto itr = std::lower_bound(bounds_ms.begin(), bounds_ms.end(), ms);
+      ++counts[itr - bounds_ms.begin()];
+      ++count;
+      sum_ms += ms;
+   }
+
+   /**
+    * When the entries in memory entered their current stage, for the bridge_stage_latencies metrics.
+    * Not persisted, entries restored from bridge_db.dat are not timed until they reach the next stage.
+    */
+   template<typename Key>
+   class bridge_stage_tracker {
+   public:
+      void captured(const Key &key) { stages[key] = fc::time_point::now(); }
+
+      void ready(const Key &key) { advance(key, latencies.capture_to_ready); }
+      void submitted(const Key &key) { advance(key, latencies.ready_to_submitted); }
+      void failed(const Key &key) { stages[key] = fc::time_point::now(); } // back to ready
+      // the rpc client called back after the block including the extrinsic got finalized on bifrost
+      void finalized(const Key &key) {
+         advance(key, latencies.submitted_to_finalized);
+         stages.erase(key);
+      }
+      void forget(const Key &key) { stages.erase(key); }
+
+      const bridge_stage_latencies &get_latencies() const { return latencies; }
+
+   private:
+      void advance(const Key &key, bridge_latency_histogram &h) {
+         const auto now = fc::time_point::now();
+         auto itr = stages.find(key);
+         if (itr != stages.end()) {
+            h.add(now - itr->second);
+            itr->second = now;
+         } else {
+            stages.emplace(key, now);
+         }
+      }
+
+      std::map<Key, fc::time_point> stages;
+      bridge_stage_latencies        latencies;
+   };
+
+   template<typename Index>
+   bridge_status_counts count_statuses(const Index &index) {
+      bridge_status_counts counts;
+      const auto &idx = index.template get<by_status>();
+      auto count = [&](uint8_t status) {
+         auto range = idx.equal_range(std::make_tuple(status));
+         return uint32_t(std::distance(range.first, range.second));
+      };
+      counts.collecting = count(bridge_status::collecting);
+      counts.ready = count(bridge_status::ready);
+      counts.submitting = count(bridge_status::submitting);
+      counts.sent = count(bridge_status::sent);
+      return counts;
+   }
+
+   /**
+    * Digests of all action receipts of one block together with every level of their merkle tree.
+    * All bridge transfers found in a block share it, so receipts are hashed once per block and
+    * each proof is read off the levels in O(log n).
+    */
+   class block_receipt_tree {
+   public:
+      block_receipt_tree(uint32_t block_num, const std::vector<action_receipt> &receipts)
+      : block_num(block_num)
+      , last_global_sequence(receipts.empty() ? 0 : receipts.back().global_sequence)
+      , tree(digests(receipts))
+      {}
+
+      // receipts vector of every transaction of a block is the same
+      bool matches(uint32_t num, const std::vector<action_receipt> &receipts) const {
+         return block_num == num && tree.leaf_count() == receipts.size() &&
+                (receipts.empty() || receipts.back().global_sequence == last_global_sequence);
+      }
+
+      // leaf index of the receipt digest, -1 if the receipt is not part of the block
+      int find(const digest_type &receipt_digest) const {
+         for (size_t i = 0; i < tree.leaf_count(); ++i) {
+            if (tree.leaf(i) == receipt_digest) return i;
+         }
+         return -1;
+      }
+
+      std::vector<digest_type> proof(uint32_t position) const { return tree.proof(position); }
+
+      digest_type root() const { return tree.root(); }
+
+   private:
+      static std::vector<digest_type> digests(const std::vector<action_receipt> &receipts) {
+         return hash_many(receipts.size(), [&receipts](size_t i) { return receipts[i].digest(); });
+      }
+
+      uint32_t                               block_num = 0;
+      uint64_t                               last_global_sequence = 0;
+      merkle_tree                            tree;
+   };
+
    struct bifrost_config {
       std::string bifrost_addr;
       std::string bifrost_crossaccount;
       std::string bifrost_signer;
+      std::vector<std::string> extra_signers; // used round-robin with bifrost_signer
+   };
+
+   /**
+    * Decides whether an action trace is a watched token action from or to a cross account.
+    * Watches are (token contract, action, cross account) tuples, compiled into one hash lookup
+    * keyed by (contract, action), so an action is matched once whatever the number of assets.
+    * from/to are read straight from the first 16 bytes of the packed action data (two uint64
+    * names, as in transfer), so the common case of an unrelated action is rejected without
+    * unpacking it.
+    */
+   class bridge_transfer_matcher {
+   public:
+      enum direction : uint8_t {
+         none     = 0,
+         outgoing = 1, // from a watched account, Bifrost => EOS
+         incoming = 2, // to a watched account, EOS => Bifrost
+      };
+
+      void add_watch(account_name contract, action_name act, account_name cross_account) {
+         watches[std::make_pair(contract.to_uint64_t(), act.to_uint64_t())].insert(cross_account);
+      }
+
+      bool empty() const { return watches.empty(); }
+      size_t size() const {
+         size_t n = 0;
+         for (const auto &w : watches) n += w.second.size();
+         return n;
+      }
+
+      direction match(const action_trace &at) const {
+         const auto &act = at.act;
+         if (at.receiver != act.account) return none; // skip notifications
+         if (act.data.size() < 2 * sizeof(uint64_t)) return none;
+         auto itr = watches.find(std::make_pair(act.account.to_uint64_t(), act.name.to_uint64_t()));
+         if (itr == watches.end()) return none;
+
+         uint64_t from, to;
+         memcpy(&from, act.data.data(), sizeof(from));
+         memcpy(&to, act.data.data() + sizeof(from), sizeof(to));
+         if (itr->second.count(account_name(from))) return outgoing;
+         if (itr->second.count(account_name(to))) return incoming;
+         return none;
+      }
+
+   private:
+      struct key_hash {
+         size_t operator()(const std::pair<uint64_t, uint64_t> &k) const {
+            return std::hash<uint64_t>()(k.first * 0x9e3779b97f4a7c15ull ^ k.second);
+         }
+      };
+
+      // (contract, action) => cross accounts
+      std::unordered_map<std::pair<uint64_t, uint64_t>, flat_set<account_name>, key_hash> watches;
+   };
+
+   // traces of one block of the state history trace log, reduced to what capturing bridge transfers needs
+   struct bridge_backfill_traces {
+      block_id_type                         block_id;
+      std::vector<transaction_trace_ptr>    traces;   // executed transactions with a bridge transfer
+      std::vector<action_receipt>           receipts; // every receipt of the block in execution order
+   };
+
+   // Read only access to trace_history.log of state_history_plugin, laid out as described in
+   // state_history_log.hpp. Entries are zlib compressed traces in the ship abi, decoded here without
+   // a chainbase, every worker thread opens its own reader.
+   class bridge_trace_log {
+   public:
+      bool open(const fc::path &dir) {
+         const auto log_path = dir / "trace_history.log";
+         const auto index_path = dir / "trace_history.index";
+         if (!fc::exists(log_path) || !fc::exists(index_path)) return false;
+
+         log.set_file_path(log_path);
+         log.open("rb");
+         index.set_file_path(index_path);
+         index.open("rb");
+
+         index.seek_end(0);
+         const uint64_t count = index.tellp() / sizeof(uint64_t);
+         if (count == 0) return false;
+         state_history_log_header header;
+         log.seek(0);
+         read_header(header);
+         begin = block_header::num_from_id(header.block_id);
+         end = begin + count;
+         return true;
+      }
+
+      uint32_t begin_block() const { return begin; }
+      uint32_t end_block() const { return end; }
+
+      bridge_backfill_traces read(uint32_t block_num, const bridge_transfer_matcher &matcher) {
+         EOS_ASSERT(block_num >= begin && block_num < end, plugin_exception,
+                    "block ${n} is not in trace_history.log", ("n", block_num));
+         uint64_t pos;
+         index.seek((block_num - begin) * sizeof(pos));
+         index.read((char *)&pos, sizeof(pos));
+         log.seek(pos);
+
+         state_history_log_header header;
+         read_header(header);
+         const bytes packed = state_history::unpack_payload(log, header);
+
+         bridge_backfill_traces result;
+         result.block_id = header.block_id;
+         fc::datastream<const char *> ds(packed.data(), packed.size());
+         unsigned_int count;
+         fc::raw::unpack(ds, count);
+         for (uint32_t i = 0; i < count.value; ++i) {
+            auto tt = unpack_transaction_trace(ds, block_num);
+            // actions of failed transactions were rolled back, the receipts of onerror are in the outer trace
+            if (!tt->receipt || tt->receipt->status != transaction_receipt_header::executed || tt->except) continue;
+
+            bool transfer = false;
+            for (const auto &at : tt->action_traces) {
+               if (at.receipt) result.receipts.push_back(*at.receipt);
+               transfer = transfer || matcher.match(at) != bridge_transfer_matcher::none;
+            }
+            if (transfer) result.traces.push_back(tt);
+         }
+         if (result.traces.empty()) {
+            result.receipts.clear();
+         } else {
+            std::sort(result.receipts.begin(), result.receipts.end(),
+                      [](const action_receipt &a, const action_receipt &b) { return a.global_sequence < b.global_sequence; });
+         }
+         return result;
+      }
+
+   private:
+      void read_header(state_history_log_header &header) {
+         char data[state_history_log_header_serial_size];
+         log.read(data, sizeof(data));
+         fc::datastream<const char *> ds(data, sizeof(data));
+         fc::raw::unpack(ds, header);
+         EOS_ASSERT(is_ship(header.magic) && is_ship_supported_version(header.magic), plugin_exception,
+                    "unsupported trace_history.log");
+      }
+
+      static void skip_variant_tag(fc::datastream<const char *> &ds) {
+         unsigned_int tag;
+         fc::raw::unpack(ds, tag);
+         EOS_ASSERT(tag.value == 0, plugin_exception, "unsupported trace version ${v}", ("v", tag.value));
+      }
+
+      // action_trace_v0 of the ship abi
+      static action_trace unpack_action_trace(fc::datastream<const char *> &ds, uint32_t block_num,
+                                              const transaction_id_type &trx_id) {
+         skip_variant_tag(ds);
+         action_trace at;
+         at.block_num = block_num;
+         at.trx_id = trx_id;
+         fc::raw::unpack(ds, at.action_ordinal);
+         fc::raw::unpack(ds, at.creator_action_ordinal);
+         bool has_receipt;
+         fc::raw::unpack(ds, has_receipt);
+         if (has_receipt) {
+            skip_variant_tag(ds);
+            action_receipt r;
+            fc::raw::unpack(ds, r); // same layout as action_receipt_v0
+            at.receipt = std::move(r);
+         }
+         fc::raw::unpack(ds, at.receiver);
+         fc::raw::unpack(ds, at.act);
+         fc::raw::unpack(ds, at.context_free);
+         int64_t elapsed;
+         fc::raw::unpack(ds, elapsed);
+         at.elapsed = fc::microseconds(elapsed);
+         fc::raw::unpack(ds, at.console);
+         fc::raw::unpack(ds, at.account_ram_deltas);
+         fc::optional<string> except;
+         fc::raw::unpack(ds, except);
+         if (except) at.except = fc::exception(fc::log_messages(), fc::unspecified_exception_code, "ship", *except);
+         fc::raw::unpack(ds, at.error_code);
+         return at;
+      }
+
+      // transaction_trace_v0 of the ship abi
+      static transaction_trace_ptr unpack_transaction_trace(fc::datastream<const char *> &ds, uint32_t block_num) {
+         skip_variant_tag(ds);
+         auto tt = std::make_shared<transaction_trace>();
+         tt->block_num = block_num;
+         fc::raw::unpack(ds, tt->id);
+         transaction_receipt_header receipt;
+         uint8_t status;
+         fc::raw::unpack(ds, status);
+         receipt.status = transaction_receipt_header::status_enum(status);
+         fc::raw::unpack(ds, receipt.cpu_usage_us);
+         fc::raw::unpack(ds, receipt.net_usage_words);
+         tt->receipt = receipt;
+         int64_t elapsed;
+         fc::raw::unpack(ds, elapsed);
+         tt->elapsed = fc::microseconds(elapsed);
+         fc::raw::unpack(ds, tt->net_usage);
+         fc::raw::unpack(ds, tt->scheduled);
+
+         unsigned_int count;
+         fc::raw::unpack(ds, count);
+         tt->action_traces.reserve(count.value);
+         for (uint32_t i = 0; i < count.value; ++i) tt->action_traces.push_back(unpack_action_trace(ds, block_num, tt->id));
+
+         fc::raw::unpack(ds, tt->account_ram_delta);
+         fc::optional<string> except;
+         fc::raw::unpack(ds, except);
+         if (except) tt->except = fc::exception(fc::log_messages(), fc::unspecified_exception_code, "ship", *except);
+         fc::raw::unpack(ds, tt->error_code);
+
+         bool has_failed_dtrx;
+         fc::raw::unpack(ds, has_failed_dtrx);
+         if (has_failed_dtrx) tt->failed_dtrx_trace = unpack_transaction_trace(ds, block_num);
+
+         bool has_partial;
+         fc::raw::unpack(ds, has_partial);
+         if (has_partial) {
+            skip_variant_tag(ds);
+            time_point_sec expiration;
+            uint16_t ref_block_num;
+            uint32_t ref_block_prefix;
+            unsigned_int max_net_usage_words;
+            uint8_t max_cpu_usage_ms;
+            unsigned_int delay_sec;
+            extensions_type transaction_extensions;
+            std::vector<signature_type> signatures;
+            std::vector<bytes> context_free_data;
+            fc::raw::unpack(ds, expiration);
+            fc::raw::unpack(ds, ref_block_num);
+            fc::raw::unpack(ds, ref_block_prefix);
+            fc::raw::unpack(ds, max_net_usage_words);
+            fc::raw::unpack(ds, max_cpu_usage_ms);
+            fc::raw::unpack(ds, delay_sec);
+            fc::raw::unpack(ds, transaction_extensions);
+            fc::raw::unpack(ds, signatures);
+            fc::raw::unpack(ds, context_free_data);
+         }
+         return tt;
+      }
+
+      fc::cfile log;
+      fc::cfile index;
+      uint32_t  begin = 0;
+      uint32_t  end   = 0;
+   };
+
+   // everything needed to build the ffi arguments of prove_action, copied out of prove_action_index
+   // so the entry can be modified while the ffi arguments are built
+   struct prove_action_item {
+      block_id_type                            act_receipt_digest;
+      action                                   act;
+      action_receipt                           receipt;
+      std::vector<block_id_type>               merkle_paths;
+      transaction_id_type                      trx_id;
+   };
+
+   // proofs of actions in the same block share merkle, headers and id lists, so they are sent together
+   struct prove_action_submission {
+      std::vector<prove_action_item>           items;
+      incremental_merkle                       imcre_merkle;
+      std::vector<signed_block_header>         block_headers;
+      std::vector<std::vector<block_id_type>>  block_id_lists;
+   };
+
+   // arguments of change_schedule in fc::raw encoding, decoded as is by the rust side
+   struct change_schedule_submission {
+      uint32_t                                 block_num = 0;
+      digest_type                              legacy_schedule_hash;
+      bytes                                    schedule;
+      bytes                                    imcre_merkle;
+      bytes                                    block_headers;
+      bytes                                    block_id_lists;
    };
 
    class bridge_plugin_impl {
    public:
-      chain_plugin *chain_plug = nullptr;
+      chain::controller *chain_control = nullptr;
 
       unique_ptr<boost::asio::steady_timer> change_schedule_timer;
       unique_ptr<boost::asio::steady_timer> prove_action_timer;
+      unique_ptr<boost::asio::steady_timer> health_check_timer;
 
       boost::asio::steady_timer::duration change_schedule_timeout{std::chrono::milliseconds{1000}};
       boost::asio::steady_timer::duration prove_action_timeout{std::chrono::milliseconds{1000}};
-
-      bridge_block_index            block_index;
+      boost::asio::steady_timer::duration health_check_timeout{std::chrono::seconds{30}};
+
+      // json status of the bifrost endpoints as of the last health check, with their latency
+      string rpc_pool_status;
+
+      bridge_block_window           block_window;
+      // reversible blocks of the current fork above the last irreversible one, fed by accepted_block
+      bridge_block_window           speculative_window;
+      bool                          speculative_proofs = true;
+      // schedules the blocks of both windows were signed under, for checking proofs before they are submitted
+      bridge_signing_history        signing_history;
+      bool                          verify_proofs = true;
+      uint64_t                      preflight_failures = 0;
+      // blockroot_merkle of the last appended block and of its predecessor, which proves a change of schedule
+      incremental_merkle            last_blockroot_merkle;
+      incremental_merkle            previous_blockroot_merkle;
+      uint32_t                      last_block_num = 0;
       bridge_change_schedule_index  change_schedule_index;
       bridge_prove_action_index     prove_action_index;
+      bridge_journal                journal;
+
+      // receipt tree of the block being filtered
+      std::shared_ptr<const block_receipt_tree> receipt_tree;
 
       bifrost_config config;
+      bridge_transfer_matcher transfer_matcher;
+      bridge_window_geometry window_geometry;
+      bridge_partition partition;
 
       fc::path datadir;
 
+      // catch up on irreversible blocks missed while the relay was offline, 0 continues after bridge_db.dat
+      bool      backfill_enabled = false;
+      uint32_t  backfill_from = 0;
+      fc::path  backfill_trace_dir;
+      uint16_t  backfill_threads = 2;
+
+      // irreversible_block runs from the application queue instead of inside the controller's emit
+      bool      async_irreversible_block = false;
+
+      // submissions run on the runtime of the rpc client, which calls back once the extrinsic is finalized on bifrost,
+      // or it failed at dispatch, was dropped, retracted or not finalized in time.
+      // Their ffi arguments are only read during the submit_* call, so one arena serves all of them.
+      uint16_t                              rpc_runtime_threads = 2;
+      uint32_t                              max_batch_size = 1; // max proofs in one extrinsic, 1 disables batching
+      ffi_arena                             submit_arena;
+      // check_client_pool() blocks while it reconnects, so it is never called on the main thread
+      fc::optional<named_thread_pool>       health_check_thread;
+
+      // extrinsics submitted and awaiting finalization, only touched on the main thread
+      uint32_t                              max_in_flight = 64;
+      uint32_t                              in_flight = 0;
+      bridge_retry_schedule<block_id_type>  prove_action_retries;
+      bridge_retry_schedule<uint32_t>       change_schedule_retries;
+
+      // Bifrost => EOS redeems, issued by the relay of partition 0 as batched transfers from the cross account.
+      // Redeems are journaled like the bridge indexes. On startup the transactions not yet irreversible are looked
+      // up in the irreversible blocks, and the subscription resumes after the last bifrost block fully received.
+      bool                                          redeem_enabled = false;
+      account_name                                  redeem_token_contract = N(eosio.token);
+      permission_name                               redeem_permission = config::active_name;
+      fc::crypto::private_key                       redeem_key;
+      uint32_t                                      redeem_batch_size = 10; // max transfers in one transaction
+      uint32_t                                      redeem_max_pending = 4; // max transactions awaiting irreversibility
+      fc::microseconds                              redeem_trx_expiration = fc::seconds(30);
+      std::deque<bridge_redeem>                     queued_redeems;
+      // bifrost block of the redeems received, kept until their block is fully received and they are done, so a
+      // redeem delivered again by a resumed subscription is issued once
+      std::map<uint64_t, uint32_t>                  known_redeems;
+      std::map<transaction_id_type, redeem_transaction> redeem_trxs;
+      uint32_t                                      redeem_block = 0; // last bifrost block whose redeems are all received
+      // a redeem failing in a batch is issued alone afterwards, so it can't fail the others again
+      bridge_retry_schedule<uint64_t>               redeem_retries;
+      uint64_t                                      completed_redeems = 0;
+      bridge_latency_histogram                      redeem_latency;
+      unique_ptr<boost::asio::steady_timer>         redeem_timer;
+
+      bridge_stage_tracker<block_id_type>   prove_action_stages;
+      bridge_stage_tracker<uint32_t>        change_schedule_stages;
+      bridge_latency_histogram              ffi_call_latency;
+
+      bridge_retention                      retention;
+      bridge_spill_store                    spill_store;
+      uint64_t                              entry_bytes = 0;
+      bool                                  over_budget = false; // warned about a budget that can't be met
+      // headers and ids proving reloaded spilled entries and entries readied from the speculative window,
+      // the irreversible window may lack their blocks
+      std::map<uint32_t, std::pair<std::vector<signed_block_header>, std::vector<std::vector<block_id_type>>>> detached_proofs;
+
+      template<typename Entry> void track_insert(const Entry &e) { entry_bytes += fc::raw::pack_size(e); }
+      template<typename Entry> void track_erase(const Entry &e) { entry_bytes -= std::min<uint64_t>(entry_bytes, fc::raw::pack_size(e)); }
+
+      void enforce_retention(uint32_t block_num);
+      bool evict_oldest_finalized();
+      bool spill_oldest_failed();
+      void spill_prove_action(bridge_prove_action_index::iterator);
+      void reload_spilled(std::chrono::steady_clock::time_point now);
+      void erase_entry(bridge_prove_action_index::iterator);
+      void erase_entry(bridge_change_schedule_index::iterator);
+
+      bridge_metrics get_metrics() const;
+      bridge_get_proofs_results get_proofs(const bridge_get_proofs_params &);
+
       void change_schedule_timer_tick();
       void prove_action_timer_tick();
 
+      void submit_prove_actions(std::vector<bridge_prove_action_index::iterator> &);
+      void make_prove_action_item(bridge_prove_action_index::iterator &, prove_action_item &);
+      void submit_change_schedule(bridge_change_schedule_index::iterator &);
+      void prove_action_preflight_failed(bridge_prove_action_index::iterator, const string &reason);
+      void prove_action_submitted(const block_id_type &act_receipt_digest, bool success, const string &msg);
+      void change_schedule_submitted(uint32_t block_num, bool success, const string &msg);
+
       void collect_blocks_timer_tick();
+      void health_check_timer_tick();
+      void redeem_timer_tick();
+      void subscribe_redeems();
+      void redeem_requested(bool success, const string &msg);
+      void issue_redeems();
+      void push_redeems(std::vector<bridge_redeem> &&);
+      void redeem_trx_pushed(const transaction_id_type &, const fc::static_variant<fc::exception_ptr, transaction_trace_ptr> &);
+      void requeue_redeems(std::map<transaction_id_type, redeem_transaction>::iterator, const string &reason);
+      void redeems_irreversible(const chain::block_state &);
+      void redeem_trx_done(std::map<transaction_id_type, redeem_transaction>::iterator, uint32_t block_num);
+      void recover_redeems();
+      void prune_known_redeems();
+      const string &next_signer();
+      uint32_t next_signer_index = 0;
+      void check_rpc_pool(bool init);
 
       void irreversible_block(const chain::block_state_ptr &);
-      void apply_action_receipt(std::tuple<const transaction_trace_ptr &, const std::vector<action_receipt>&>);
+      void accepted_block(const chain::block_state_ptr &);
+      void backfill();
+      void applied_block_action_receipts(std::tuple<uint32_t, const std::vector<transaction_trace_ptr>&, const std::vector<action_receipt>&>);
 
       void open_db();
       void close_db();
+      void write_db();
+      void replay_journal(const fc::path &);
+      void apply_journal_record(fc::datastream<const char *> &);
+
+      void append_block(bridge_header_record);
+      void prune_block_window(uint32_t block_num);
 
       std::atomic<bool>                     in_shutdown{false};
 
+      std::tuple<std::vector<signed_block_header>, std::vector<std::vector<block_id_type>>, bool> collect_blocks(uint32_t block_num);
       std::tuple<std::vector<signed_block_header>, std::vector<std::vector<block_id_type>>, bool> collect_incremental_merkle_and_blocks(bridge_change_schedule_index::iterator &);
       std::tuple<std::vector<signed_block_header>, std::vector<std::vector<block_id_type>>, bool> collect_incremental_merkle_and_blocks(bridge_prove_action_index::iterator &);
 
-      void filter_action(const std::string &contract, const std::vector<action_trace> &, const std::vector<action_receipt> &, transaction_id_type&);
+      void filter_action(const std::vector<action_trace> &, const std::vector<action_receipt> &, const transaction_id_type &);
+      void capture_transfer(const action_trace &, const std::vector<action_receipt> &, const transaction_id_type &);
    };
 
+   // completion of a submission, user_data is the rpc_done allocated for it
+   using rpc_done = std::function<void(bool success, const string &msg)>;
+   void rpc_completed(rpc_result *result, void *user_data) {
+      std::unique_ptr<rpc_done> done(static_cast<rpc_done *>(user_data));
+      bool success = result && result->success;
+      string msg = (result && result->msg) ? string(result->msg) : string("null result from bifrost rpc");
+      free_rpc_result(result);
+      (*done)(success, msg);
+   }
+
+   std::tuple<std::vector<signed_block_header>, std::vector<std::vector<block_id_type>>, bool> bridge_plugin_impl::collect_blocks(uint32_t block_num) {
+      auto detached = detached_proofs.find(block_num);
+      if (detached != detached_proofs.end()) return std::make_tuple(detached->second.first, detached->second.second, true);
+      return collect_window_blocks(block_window, window_geometry, block_num);
+   }
+
    std::tuple<std::vector<signed_block_header>, std::vector<std::vector<block_id_type>>, bool> bridge_plugin_impl::collect_incremental_merkle_and_blocks(bridge_prove_action_index::iterator &ti) {
-      auto bl_state = block_state();
-      std::vector<signed_block_header> block_headers; // can reserve a buffer to store id
-      block_headers.reserve(15);
-
-      std::vector<std::vector<block_id_type>> block_id_lists; // can reserve a buffer to store id
-      block_id_lists.reserve(15);
-
-      bool block_found = false;
-      for (auto bls: ti->bs) {
-         if (ti->block_num == bls.block_num) { // which block is need to be verified
-            block_headers.push_back(bls.header);
-            bl_state = bls;
-            block_found = true;
-            break;
+      return collect_blocks(ti->block_num);
+   }
+
+   std::tuple<std::vector<signed_block_header>, std::vector<std::vector<block_id_type>>, bool> bridge_plugin_impl::collect_incremental_merkle_and_blocks(bridge_change_schedule_index::iterator &ti) {
+      // blockroot_merkle of the predecessor is taken when the entry is created
+      if (ti->imcre_merkle._node_count == 0) {
+         return std::make_tuple(std::vector<signed_block_header>(), std::vector<std::vector<block_id_type>>(), false);
+      }
+      return collect_blocks(ti->block_num);
+   }
+
+   void bridge_plugin_impl::change_schedule_timer_tick() {
+      if( in_shutdown ) return;
+
+      change_schedule_timer->expires_from_now(change_schedule_timeout);
+      change_schedule_timer->async_wait([&](boost::system::error_code ec) {
+         if( in_shutdown ) return;
+         if (ec) {
+            ilog("error happened while trigger sending change schedule");
+         } else {
+            const auto now = std::chrono::steady_clock::now();
+            for (auto ti : ready_entries(change_schedule_index)) {
+               if (in_flight >= max_in_flight) break;
+               if (!change_schedule_retries.due(ti->block_num, now)) continue;
+               submit_change_schedule(ti);
+            }
+         }
+
+         change_schedule_timer_tick();
+      });
+   }
+
+   void bridge_plugin_impl::submit_change_schedule(bridge_change_schedule_index::iterator &ti) {
+      auto tuple = collect_incremental_merkle_and_blocks(ti);
+      auto block_headers = std::get<0>(tuple);
+      auto block_id_lists = std::get<1>(tuple);
+      auto found = std::get<2>(tuple);
+
+      if (!found) {
+         ilog("It doesn't finish collecting related blocks, cotinue");
+         return;
+      }
+
+      if (verify_proofs) {
+         auto failure = verify_finality_proof(signing_history, ti->block_num, ti->imcre_merkle, block_headers, block_id_lists);
+         if (failure) {
+            ++preflight_failures;
+            change_schedule_retries.failed(ti->block_num, std::chrono::steady_clock::now());
+            elog("proof of the schedule change at block ${n} fails local verification, not submitted: ${err}, attempts: ${a}",
+                 ("n", ti->block_num)("err", *failure)("a", change_schedule_retries.attempts(ti->block_num)));
+            return;
          }
       }
-      if (!block_found) {
-         return std::make_tuple(block_headers, block_id_lists, false);
+
+      auto sub = std::make_shared<change_schedule_submission>();
+      sub->block_num = ti->block_num;
+      sub->legacy_schedule_hash = ti->legacy_schedule_hash;
+      sub->schedule = fc::raw::pack(ti->schedule);
+      sub->imcre_merkle = fc::raw::pack(ti->imcre_merkle);
+      sub->block_headers = fc::raw::pack(block_headers);
+      sub->block_id_lists = fc::raw::pack(block_id_lists);
+
+      set_status(change_schedule_index, journal, ti, bridge_status::submitting);
+      change_schedule_stages.submitted(ti->block_num);
+      ++in_flight;
+
+      const auto start = fc::time_point::now();
+      auto done = new rpc_done([this, block_num = sub->block_num, start](bool success, const string &msg) {
+         const auto duration = fc::time_point::now() - start;
+         app().post(priority::medium, [this, block_num, success, msg, duration]() {
+            ffi_call_latency.add(duration);
+            change_schedule_submitted(block_num, success, msg);
+         });
+      });
+      submit_change_schedule(
+         config.bifrost_addr.c_str(),
+         next_signer().c_str(),
+         sub->legacy_schedule_hash,
+         sub->schedule.data(),
+         sub->schedule.size(),
+         sub->imcre_merkle.data(),
+         sub->imcre_merkle.size(),
+         sub->block_headers.data(),
+         sub->block_headers.size(),
+         sub->block_id_lists.data(),
+         sub->block_id_lists.size(),
+         rpc_completed,
+         done
+      );
+   }
+
+   void bridge_plugin_impl::change_schedule_submitted(uint32_t block_num, bool success, const string &msg) {
+      --in_flight;
+      auto ti = change_schedule_index.find(block_num);
+      if (ti == change_schedule_index.end()) return;
+
+      // put it back to ready on failure, a later tick will submit it again once its backoff expired
+      set_status(change_schedule_index, journal, ti, success ? bridge_status::sent : bridge_status::ready);
+      if (success) {
+         change_schedule_retries.succeeded(block_num);
+         change_schedule_stages.finalized(block_num);
+         ilog("schedule change of block ${n} is finalized on bifrost: ${msg}.", ("n", block_num)("msg", msg));
+      } else {
+         change_schedule_retries.failed(block_num, std::chrono::steady_clock::now());
+         change_schedule_stages.failed(block_num);
+         ilog("failed to send data to bifrost for changing schedule due to: ${err}, attempts: ${n}.",
+              ("err", msg)("n", change_schedule_retries.attempts(block_num)));
       }
+   }
 
-      auto reserved = std::vector<block_id_type>();
-      reserved.reserve(10);
-      block_id_lists.push_back(std::vector<block_id_type>());
-      block_id_lists.push_back(reserved);
-      for (auto bls: ti->bs) {
-         if (bls.block_num <= ti->block_num) continue;
-         if (bls.block_num - block_headers.back().block_num() == 12) {
-            block_headers.push_back(bls.header);
-            if (block_headers.size() >= 15) break;
-            block_id_lists.push_back(std::vector<block_id_type>());
+   void bridge_plugin_impl::health_check_timer_tick() {
+      if( in_shutdown ) return;
+
+      health_check_timer->expires_from_now(health_check_timeout);
+      health_check_timer->async_wait([this](boost::system::error_code ec) {
+         if( in_shutdown || ec ) return;
+         check_rpc_pool(false);
+      });
+   }
+
+   // every signer has its own nonce sequence on bifrost, spreading submissions over several
+   // signers lets more extrinsics be in flight at once
+   const string &bridge_plugin_impl::next_signer() {
+      const uint32_t i = next_signer_index++ % (config.extra_signers.size() + 1);
+      return i == 0 ? config.bifrost_signer : config.extra_signers[i - 1];
+   }
+
+   // connecting and the round trips of the health check block, so they run on the submission threads
+   void bridge_plugin_impl::check_rpc_pool(bool init) {
+      boost::asio::post(health_check_thread->get_executor(), [this, init, addr = config.bifrost_addr]() {
+         rpc_result *result = init ? init_client_pool(addr.data()) : check_client_pool();
+         bool success = result && result->success;
+         string msg = (result && result->msg) ? string(result->msg) : string("null result from bifrost rpc");
+         free_rpc_result(result);
+         app().post(priority::low, [this, success, msg]() {
+            if( in_shutdown ) return;
+            if (success) {
+               rpc_pool_status = msg;
+               ilog("bifrost endpoints: ${status}", ("status", msg));
+            } else {
+               elog("failed to check bifrost endpoints: ${err}", ("err", msg));
+            }
+            health_check_timer_tick();
+         });
+      });
+   }
+
+   void bridge_plugin_impl::redeem_timer_tick() {
+      if( in_shutdown ) return;
+
+      redeem_timer->expires_from_now(prove_action_timeout);
+      redeem_timer->async_wait([this](boost::system::error_code ec) {
+         if( in_shutdown || ec ) return;
+         // redeems are issued as they arrive, the tick picks up those whose backoff expired
+         issue_redeems();
+         redeem_timer_tick();
+      });
+   }
+
+   // called on a thread of the rpc runtime for every redeem, the user_data is never released
+   void redeem_event(rpc_result *result, void *user_data) {
+      auto my = static_cast<bridge_plugin_impl *>(user_data);
+      bool success = result && result->success;
+      string msg = (result && result->msg) ? string(result->msg) : string("null result from bifrost rpc");
+      free_rpc_result(result);
+      app().post(priority::medium, [my, success, msg]() {
+         if( my->in_shutdown ) return;
+         my->redeem_requested(success, msg);
+      });
+   }
+
+   // resumes after the last bifrost block fully received, the redeems of a block received in part are delivered
+   // again and dropped as known
+   void bridge_plugin_impl::subscribe_redeems() {
+      const uint32_t from_block = redeem_block ? redeem_block + 1 : 0;
+      rpc_result *result = subscribe_redeem_events(config.bifrost_addr.c_str(), from_block, redeem_event, this);
+      const bool success = result && result->success;
+      const string msg = (result && result->msg) ? string(result->msg) : string("null result from bifrost rpc");
+      free_rpc_result(result);
+      EOS_ASSERT( success, plugin_exception, "failed to subscribe to bifrost redeem events: ${m}", ("m", msg) );
+      ilog("issuing bifrost redeems as ${c} transfers from ${a}@${p}, ${f}",
+           ("c", redeem_token_contract)("a", config.bifrost_crossaccount)("p", redeem_permission)
+           ("f", from_block ? "from bifrost block " + std::to_string(from_block) : string("from the next bifrost block")));
+   }
+
+   void bridge_plugin_impl::redeem_requested(bool success, const string &msg) {
+      if (!success) {
+         wlog("bifrost redeem subscription dropped, it resumes after bifrost block ${b}: ${err}", ("b", redeem_block)("err", msg));
+         return;
+      }
+
+      bridge_redeem r;
+      try {
+         const auto v = fc::json::from_string(msg);
+         r.bifrost_block = v["block"].as<uint32_t>();
+         if (!v.get_object().contains("id")) {
+            // every redeem of the block is received
+            if (r.bifrost_block <= redeem_block) return;
+            redeem_block = r.bifrost_block;
+            journal.redeem_block(redeem_block);
+            prune_known_redeems();
+            return;
+         }
+         r.id = v["id"].as_uint64();
+         r.to = account_name(v["to"].as_string());
+         r.quantity = asset::from_string(v["quantity"].as_string());
+         r.memo = v["memo"].as_string();
+      } catch (const fc::exception &e) {
+         elog("invalid bifrost redeem ${r}: ${e}", ("r", msg)("e", e.to_detail_string()));
+         return;
+      }
+      if (!known_redeems.emplace(r.id, r.bifrost_block).second) {
+         dlog("bifrost redeem ${id} is already issued", ("id", r.id));
+         return;
+      }
+      r.requested = fc::time_point::now();
+      ilog("bifrost redeem ${id} of ${q} to ${to}", ("id", r.id)("q", r.quantity)("to", r.to));
+      journal.add_redeem(r);
+      queued_redeems.push_back(std::move(r));
+      issue_redeems();
+   }
+
+   // the redeems of the blocks fully received can't be delivered again, only those still pending are kept
+   void bridge_plugin_impl::prune_known_redeems() {
+      std::set<uint64_t> pending;
+      for (const auto &r : queued_redeems) pending.insert(r.id);
+      for (const auto &t : redeem_trxs) {
+         for (const auto &r : t.second.redeems) pending.insert(r.id);
+      }
+      for (auto itr = known_redeems.begin(); itr != known_redeems.end();) {
+         if (itr->second <= redeem_block && !pending.count(itr->first)) itr = known_redeems.erase(itr);
+         else ++itr;
+      }
+   }
+
+   void bridge_plugin_impl::issue_redeems() {
+      const auto now = std::chrono::steady_clock::now();
+      while (redeem_trxs.size() < redeem_max_pending) {
+         std::vector<bridge_redeem> batch;
+         for (auto itr = queued_redeems.begin(); itr != queued_redeems.end() && batch.size() < redeem_batch_size;) {
+            if (!redeem_retries.due(itr->id, now)) { ++itr; continue; }
+            const bool alone = redeem_retries.attempts(itr->id) > 0;
+            if (alone && !batch.empty()) { ++itr; continue; }
+            batch.push_back(std::move(*itr));
+            itr = queued_redeems.erase(itr);
+            if (alone) break;
+         }
+         if (batch.empty()) break;
+         push_redeems(std::move(batch));
+      }
+   }
+
+   void bridge_plugin_impl::push_redeems(std::vector<bridge_redeem> &&batch) {
+      const account_name cross_account(config.bifrost_crossaccount);
+      signed_transaction trx;
+      for (const auto &r : batch) {
+         trx.actions.emplace_back(vector<permission_level>{{cross_account, redeem_permission}}, redeem_token_contract, N(transfer),
+                                  fc::raw::pack(action_transfer{cross_account, r.to, r.quantity, r.memo}));
+      }
+      trx.expiration = chain_control->head_block_time() + redeem_trx_expiration;
+      trx.set_reference_block(chain_control->head_block_id());
+      trx.sign(redeem_key, chain_control->get_chain_id());
+      auto ptrx = std::make_shared<packed_transaction>(std::move(trx));
+
+      const auto id = ptrx->id();
+      dlog("pushing redeem transaction ${id} with ${n} transfers", ("id", id)("n", batch.size()));
+      auto &t = redeem_trxs[id];
+      t = redeem_transaction{std::move(batch), ptrx->expiration(), chain_control->last_irreversible_block_num(), ptrx};
+      // journaled before it is pushed, after a crash it is looked up in the chain rather than issued again
+      journal.push_redeem_trx(t);
+      // kept by the producer until it expires, so it is retried in the following blocks
+      app().get_method<incoming::methods::transaction_async>()(ptrx, true,
+            [this, id](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr> &result) {
+         redeem_trx_pushed(id, result);
+      });
+   }
+
+   void bridge_plugin_impl::redeem_trx_pushed(const transaction_id_type &id,
+                                              const fc::static_variant<fc::exception_ptr, transaction_trace_ptr> &result) {
+      if( in_shutdown ) return;
+      auto itr = redeem_trxs.find(id);
+      if (itr == redeem_trxs.end()) return;
+
+      string reason;
+      if (result.contains<fc::exception_ptr>()) {
+         const auto &ex = result.get<fc::exception_ptr>();
+         // already pending or in a block, its receipt decides
+         if (ex->code() == tx_duplicate::code_value) return;
+         reason = ex->to_string();
+      } else if (const auto &trace = result.get<transaction_trace_ptr>(); trace->except) {
+         reason = trace->except->to_string();
+      } else {
+         return;
+      }
+      requeue_redeems(itr, reason);
+   }
+
+   void bridge_plugin_impl::requeue_redeems(std::map<transaction_id_type, redeem_transaction>::iterator itr, const string &reason) {
+      journal.requeue_redeem_trx(itr->first);
+      const auto now = std::chrono::steady_clock::now();
+      for (auto &r : itr->second.redeems) {
+         redeem_retries.failed(r.id, now);
+         elog("bifrost redeem ${id} of ${q} to ${to} failed: ${err}, attempts: ${a}",
+              ("id", r.id)("q", r.quantity)("to", r.to)("err", reason)("a", redeem_retries.attempts(r.id)));
+         queued_redeems.push_front(std::move(r));
+      }
+      redeem_trxs.erase(itr);
+   }
+
+   // the redeems are done once the receipt of their transaction is irreversible, the transfers are then proved
+   // back to bifrost as outgoing transfers of the cross account
+   void bridge_plugin_impl::redeems_irreversible(const chain::block_state &bs) {
+      for (const auto &receipt : bs.block->transactions) {
+         const auto &id = receipt.trx.contains<transaction_id_type>() ? receipt.trx.get<transaction_id_type>()
+                                                                      : receipt.trx.get<packed_transaction>().id();
+         auto itr = redeem_trxs.find(id);
+         if (itr == redeem_trxs.end()) continue;
+         if (receipt.status != transaction_receipt_header::executed) {
+            requeue_redeems(itr, "transaction failed in block " + std::to_string(bs.block_num));
+            continue;
+         }
+         redeem_trx_done(itr, bs.block_num);
+      }
+
+      // an irreversible block past its expiration means it can no longer be included
+      for (auto itr = redeem_trxs.begin(); itr != redeem_trxs.end();) {
+         auto cur = itr++;
+         if (fc::time_point(cur->second.expiration) < bs.header.timestamp.to_time_point()) requeue_redeems(cur, "transaction expired");
+      }
+      issue_redeems();
+   }
+
+   void bridge_plugin_impl::redeem_trx_done(std::map<transaction_id_type, redeem_transaction>::iterator itr, uint32_t block_num) {
+      journal.redeem_trx_done(itr->first);
+      const auto now = fc::time_point::now();
+      for (const auto &r : itr->second.redeems) {
+         redeem_retries.succeeded(r.id);
+         redeem_latency.add(now - r.requested);
+         ++completed_redeems;
+      }
+      ilog("redeem transaction ${id} with ${n} transfers is irreversible in block ${b}",
+           ("id", itr->first)("n", itr->second.redeems.size())("b", block_num));
+      redeem_trxs.erase(itr);
+      prune_known_redeems();
+   }
+
+   // the redeem transactions journaled as pushed but not as irreversible may have made it into a block while the
+   // relay was stopped, they are looked up in the irreversible blocks they could be in before anything is issued
+   void bridge_plugin_impl::recover_redeems() {
+      if (redeem_trxs.empty() && queued_redeems.empty()) return;
+      ilog("recovering ${q} queued bifrost redeems and ${t} redeem transactions", ("q", queued_redeems.size())("t", redeem_trxs.size()));
+      const uint32_t lib = chain_control->last_irreversible_block_num();
+      for (auto itr = redeem_trxs.begin(); itr != redeem_trxs.end();) {
+         auto cur = itr++;
+         const auto &id = cur->first;
+         bool found = false, expired = false;
+         for (uint32_t n = cur->second.lib_num + 1; n <= lib && !found && !expired; ++n) {
+            const auto block = chain_control->fetch_block_by_number(n);
+            if (!block) break;
+            if (block->timestamp.to_time_point() > fc::time_point(cur->second.expiration)) {
+               expired = true;
+               break;
+            }
+            for (const auto &receipt : block->transactions) {
+               const auto &trx_id = receipt.trx.contains<transaction_id_type>() ? receipt.trx.get<transaction_id_type>()
+                                                                                : receipt.trx.get<packed_transaction>().id();
+               if (trx_id != id) continue;
+               found = true;
+               if (receipt.status == transaction_receipt_header::executed) redeem_trx_done(cur, n);
+               else requeue_redeems(cur, "transaction failed in block " + std::to_string(n));
+               break;
+            }
+         }
+         if (found) continue;
+         if (expired) {
+            requeue_redeems(cur, "transaction expired");
+            continue;
+         }
+         // it may still make it into a block, pushing the same transaction again can't issue it twice
+         app().get_method<incoming::methods::transaction_async>()(cur->second.trx, true,
+               [this, id](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr> &result) {
+            redeem_trx_pushed(id, result);
+         });
+      }
+      issue_redeems();
+   }
+
+   void bridge_plugin_impl::prove_action_timer_tick() {
+      if( in_shutdown ) return;
+
+      prove_action_timer->expires_from_now(prove_action_timeout);
+      prove_action_timer->async_wait([&](boost::system::error_code ec) {
+         if( in_shutdown ) return;
+         dlog("prove_action_index size: ${to}", ("to", prove_action_index.size()));
+         if (ec) {
+            ilog("error happened while trigger sending transaction");
          } else {
-            auto block_ids = block_id_lists.back();
-            if (block_ids.size() < 10) block_id_lists.back().push_back(bls.id);
+            // ready entries come ordered by block number, group the ones of the same block
+            const auto now = std::chrono::steady_clock::now();
+            reload_spilled(now);
+            std::vector<bridge_prove_action_index::iterator> batch;
+            for (auto ti : ready_entries(prove_action_index)) {
+               if (!prove_action_retries.due(ti->act_receipt_digest, now)) continue;
+               if (!batch.empty() && (batch.front()->block_num != ti->block_num || batch.size() >= max_batch_size)) {
+                  if (in_flight >= max_in_flight) break;
+                  submit_prove_actions(batch);
+                  batch.clear();
+               }
+               batch.push_back(ti);
+            }
+            if (!batch.empty() && in_flight < max_in_flight) submit_prove_actions(batch);
+         }
+
+         prove_action_timer_tick();
+      });
+   }
+
+   void bridge_plugin_impl::make_prove_action_item(bridge_prove_action_index::iterator &ti, prove_action_item &item) {
+      item.act_receipt_digest = ti->act_receipt_digest;
+      item.act = ti->act;
+      item.receipt = ti->receipt;
+      item.merkle_paths = ti->action_merkle_paths;
+      item.trx_id = ti->trx_id;
+   }
+
+   // all entries must belong to the same block
+   void bridge_plugin_impl::submit_prove_actions(std::vector<bridge_prove_action_index::iterator> &batch) {
+      if (batch.empty()) return;
+
+      auto tuple = collect_incremental_merkle_and_blocks(batch.front());
+      auto found = std::get<2>(tuple);
+
+      if (!found) {
+         ilog("It doesn't finish collecting related blocks, cotinue");
+         return;
+      }
+
+      // entries whose proof bifrost would reject wait for their retry without being sent
+      if (verify_proofs) {
+         const auto &headers = std::get<0>(tuple);
+         auto failure = verify_finality_proof(signing_history, batch.front()->block_num, batch.front()->imcre_merkle,
+                                              headers, std::get<1>(tuple));
+         batch.erase(std::remove_if(batch.begin(), batch.end(), [&](const bridge_prove_action_index::iterator &ti) {
+            auto reason = failure ? failure : verify_action_proof(*ti, headers.front());
+            if (!reason) return false;
+            prove_action_preflight_failed(ti, *reason);
+            return true;
+         }), batch.end());
+         if (batch.empty()) return;
+      }
+
+      auto sub = std::make_shared<prove_action_submission>();
+      sub->imcre_merkle = batch.front()->imcre_merkle;
+      sub->block_headers = std::move(std::get<0>(tuple));
+      sub->block_id_lists = std::move(std::get<1>(tuple));
+      sub->items.reserve(batch.size());
+      for (auto &ti : batch) {
+         prove_action_item item;
+         make_prove_action_item(ti, item);
+         sub->items.push_back(std::move(item));
+         set_status(prove_action_index, journal, ti, bridge_status::submitting);
+         prove_action_stages.submitted(ti->act_receipt_digest);
+      }
+      ++in_flight;
+
+      std::vector<block_id_type> keys;
+      keys.reserve(sub->items.size());
+      for (const auto &item : sub->items) keys.push_back(item.act_receipt_digest);
+      const auto start = fc::time_point::now();
+      auto done = new rpc_done([this, keys{std::move(keys)}, start](bool success, const string &msg) {
+         const auto duration = fc::time_point::now() - start;
+         app().post(priority::medium, [this, keys, success, msg, duration]() {
+            --in_flight;
+            ffi_call_latency.add(duration);
+            for (const auto &key : keys) prove_action_submitted(key, success, msg);
+         });
+      });
+
+      // every ffi struct points into sub or into the arena, both outlive the call
+      auto &arena = submit_arena;
+      arena.reset();
+
+      auto blocks_ffi = convert_ffi(sub->block_headers, arena);
+      auto merkle_ptr = convert_ffi(sub->imcre_merkle);
+      auto ids_list = convert_ffi(sub->block_id_lists, arena);
+
+      if (sub->items.size() == 1) {
+         const auto &item = sub->items.front();
+         auto receipts = action_receipt_ffi(item.receipt);
+         auto act_ffi = action_ffi(item.act);
+         auto merkle_paths = convert_ffi(item.merkle_paths);
+
+         submit_prove_action(
+           config.bifrost_addr.c_str(),
+           next_signer().c_str(),
+           &act_ffi,
+           &merkle_ptr,
+           &receipts,
+           &merkle_paths,
+           blocks_ffi,
+           sub->block_headers.size(),
+           ids_list,
+           sub->block_id_lists.size(),
+           item.trx_id,
+           rpc_completed,
+           done
+         );
+      } else {
+         auto items_ffi = arena.alloc<prove_action_item_ffi>(sub->items.size());
+         for (size_t i = 0; i < sub->items.size(); ++i) {
+            const auto &item = sub->items[i];
+            items_ffi[i].act = arena.emplace<action_ffi>(item.act);
+            items_ffi[i].act_receipt = arena.emplace<action_receipt_ffi>(item.receipt);
+            items_ffi[i].action_merkle_paths = convert_ffi(item.merkle_paths);
+            items_ffi[i].trx_id = item.trx_id;
          }
-         if (block_id_lists.size() >= 15 && block_id_lists.back().size() >= 10 && block_headers.size() >= 15) break;
+
+         submit_prove_action_batch(
+           config.bifrost_addr.c_str(),
+           next_signer().c_str(),
+           items_ffi,
+           sub->items.size(),
+           &merkle_ptr,
+           blocks_ffi,
+           sub->block_headers.size(),
+           ids_list,
+           sub->block_id_lists.size(),
+           rpc_completed,
+           done
+         );
       }
+   }
 
-      return std::make_tuple(block_headers, block_id_lists, true);
+   void bridge_plugin_impl::prove_action_preflight_failed(bridge_prove_action_index::iterator ti, const string &reason) {
+      ++preflight_failures;
+      prove_action_retries.failed(ti->act_receipt_digest, std::chrono::steady_clock::now());
+      const uint32_t attempts = prove_action_retries.attempts(ti->act_receipt_digest);
+      elog("proof of action ${d} in block ${n} fails local verification, not submitted: ${err}, attempts: ${a}",
+           ("d", ti->act_receipt_digest)("n", ti->block_num)("err", reason)("a", attempts));
+      if (attempts >= retention.spill_after_failures) spill_prove_action(ti);
    }
 
-   std::tuple<std::vector<signed_block_header>, std::vector<std::vector<block_id_type>>, bool> bridge_plugin_impl::collect_incremental_merkle_and_blocks(bridge_change_schedule_index::iterator &ti) {
-      auto bl_state = block_state();
-      std::vector<signed_block_header> block_headers; // can reserve a buffer to store id
-      block_headers.reserve(15);
-
-      std::vector<std::vector<block_id_type>>  block_id_lists; // can reserve a buffer to store id
-      block_id_lists.reserve(15);
-
-      bool block_found = false;
-      for (auto bls: ti->bs) {
-         if (ti->block_num == bls.block_num) {
-            block_headers.push_back(bls.header);
-            bl_state = bls;
-            block_found = true;
-            break;
-         }
+   void bridge_plugin_impl::prove_action_submitted(const block_id_type &act_receipt_digest, bool success, const string &msg) {
+      auto ti = prove_action_index.find(act_receipt_digest);
+      if (ti == prove_action_index.end()) return;
+
+      // put it back to ready on failure, a later tick will submit it again once its backoff expired
+      set_status(prove_action_index, journal, ti, success ? bridge_status::sent : bridge_status::ready);
+      if (success) {
+         prove_action_retries.succeeded(act_receipt_digest);
+         prove_action_stages.finalized(act_receipt_digest);
+         ilog("action proof ${d} is finalized on bifrost: ${msg}.", ("d", act_receipt_digest)("msg", msg));
+      } else {
+         prove_action_retries.failed(act_receipt_digest, std::chrono::steady_clock::now());
+         prove_action_stages.failed(act_receipt_digest);
+         ilog("failed to send data to bifrost for proving action due to: ${err}, attempts: ${n}.",
+              ("err", msg)("n", prove_action_retries.attempts(act_receipt_digest)));
+         if (prove_action_retries.attempts(act_receipt_digest) >= retention.spill_after_failures) spill_prove_action(ti);
       }
+   }
 
-      // get incremental_merkle
-      auto pre_block_state = block_index.find(bl_state.header.previous);
-      auto blockroot_merkle = pre_block_state->bls.blockroot_merkle;
-      if (blockroot_merkle._node_count != 0)  {
-         change_schedule_index.modify(ti, [&](auto &entry) {
-            entry.imcre_merkle = blockroot_merkle;
-            block_found = true;
-            ilog("bl_state blockroot_merkle ${times}.", ("times", blockroot_merkle));
-         });
-      }
+   void bridge_plugin_impl::append_block(bridge_header_record rec) {
+      previous_blockroot_merkle = (last_block_num != 0 && last_block_num + 1 == rec.block_num)
+                                ? last_blockroot_merkle : incremental_merkle();
+      last_blockroot_merkle = rec.blockroot_merkle;
+      last_block_num = rec.block_num;
 
-      if (!block_found) {
-         return std::make_tuple(block_headers, block_id_lists, false);
-      }
+      block_window.push_back(std::move(rec));
+   }
 
-      auto reserved = std::vector<block_id_type>();
-      reserved.reserve(10);
-      block_id_lists.push_back(std::vector<block_id_type>());
-      block_id_lists.push_back(reserved);
-      for (auto bls: ti->bs) {
-         if (bls.block_num <= ti->block_num) continue;
-         if (bls.block_num - block_headers.back().block_num() == 12) {
-            block_headers.push_back(bls.header);
-            if (block_headers.size() >= 15) break;
-            block_id_lists.push_back(std::vector<block_id_type>());
-         } else {
-            auto block_ids = block_id_lists.back();
-            if (block_ids.size() < 10) block_id_lists.back().push_back(bls.id);
+   // blocks older than the oldest entry still waiting to be sent are not needed anymore
+   void bridge_plugin_impl::prune_block_window(uint32_t block_num) {
+      // entries proved by detached_proofs don't need the window, drop the proofs no pending entry refers to
+      auto &idx = prove_action_index.get<by_status>();
+      auto &cs_idx = change_schedule_index.get<by_status>();
+      for (auto itr = detached_proofs.begin(); itr != detached_proofs.end(); ) {
+         bool pending = false;
+         for (uint8_t status : { uint8_t(bridge_status::ready), uint8_t(bridge_status::submitting) }) {
+            pending = pending || idx.find(std::make_tuple(status, itr->first)) != idx.end()
+                              || cs_idx.find(std::make_tuple(status, itr->first)) != cs_idx.end();
          }
-         if (block_id_lists.size() >= 15 && block_id_lists.back().size() >= 10 && block_headers.size() >= 15) break;
+         itr = pending ? std::next(itr) : detached_proofs.erase(itr);
       }
 
-      return std::make_tuple(block_headers, block_id_lists, true);
+      auto held_elsewhere = [this](uint32_t num) { return detached_proofs.count(num) > 0; };
+      uint32_t first_needed = first_needed_block_num(prove_action_index, block_num + 1, held_elsewhere);
+      first_needed = first_needed_block_num(change_schedule_index, first_needed, held_elsewhere);
+      block_window.prune(first_needed);
+      signing_history.prune(detached_proofs.empty() ? first_needed : std::min(first_needed, detached_proofs.begin()->first));
+      // blocks up to the irreversible one are in block_window
+      speculative_window.prune(block_num + 1);
    }
 
-   void bridge_plugin_impl::change_schedule_timer_tick() {
-      change_schedule_timer->expires_from_now(change_schedule_timeout);
-      change_schedule_timer->async_wait([&](boost::system::error_code ec) {
-         for (auto ti = change_schedule_index.begin(); ti != change_schedule_index.end(); ++ti) {
-            if (ti->status != 1) continue;
-
-            auto tuple = collect_incremental_merkle_and_blocks(ti);
-            incremental_merkle blockroot_merkle = ti->imcre_merkle;
+   void bridge_plugin_impl::accepted_block(const chain::block_state_ptr &block) {
+      signing_history.add(*block);
+      // a fork switch applies the blocks of the new branch again, they replace those of the old one
+      speculative_window.truncate(block->block_num - 1);
+      auto prev = speculative_window.get(block->block_num - 1);
+      if (prev && prev->id != block->header.previous) speculative_window.clear();
+      speculative_window.push_back(make_header_record(*block));
+   }
 
-            string new_schedule = fc::json::to_pretty_string(ti->schedule);
+   void bridge_plugin_impl::erase_entry(bridge_prove_action_index::iterator itr) {
+      journal.erase(*itr);
+      track_erase(*itr);
+      prove_action_stages.forget(itr->act_receipt_digest);
+      prove_action_retries.succeeded(itr->act_receipt_digest);
+      prove_action_index.erase(itr);
+   }
 
-            auto block_headers = std::get<0>(tuple);
-            auto block_id_lists = std::get<1>(tuple);
-            auto found = std::get<2>(tuple);
+   void bridge_plugin_impl::erase_entry(bridge_change_schedule_index::iterator itr) {
+      journal.erase(*itr);
+      track_erase(*itr);
+      change_schedule_stages.forget(itr->block_num);
+      change_schedule_retries.succeeded(itr->block_num);
+      change_schedule_index.erase(itr);
+   }
 
-            if (!found) {
-               ilog("It doesn't finish collecting related blocks, cotinue");
-               continue;
-            }
+   // finalized entries are dropped by age, then the oldest finalized and failing ones until within budget
+   void bridge_plugin_impl::enforce_retention(uint32_t block_num) {
+      if (block_num > retention.finalized_retain_blocks) {
+         const uint32_t oldest_kept = block_num - retention.finalized_retain_blocks;
+         auto &pa_idx = prove_action_index.get<by_status>();
+         for (auto itr = pa_idx.lower_bound(std::make_tuple(uint8_t(bridge_status::sent)));
+              itr != pa_idx.end() && itr->status == bridge_status::sent && itr->block_num < oldest_kept; ) {
+            erase_entry(prove_action_index.project<0>(itr++));
+         }
+         auto &cs_idx = change_schedule_index.get<by_status>();
+         for (auto itr = cs_idx.lower_bound(std::make_tuple(uint8_t(bridge_status::sent)));
+              itr != cs_idx.end() && itr->status == bridge_status::sent && itr->block_num < oldest_kept; ) {
+            erase_entry(change_schedule_index.project<0>(itr++));
+         }
+      }
 
-            string blocks_json = fc::json::to_pretty_string(block_headers);
-            string ids_json = fc::json::to_pretty_string(block_id_lists);
-            string mroot_json = fc::json::to_pretty_string(blockroot_merkle);
-
-//            signed_block_header_ffi *blocks_ffi = new signed_block_header_ffi[block_headers.size()];
-//            for (size_t i = 0; i < block_headers.size(); ++i) {
-//               auto p = new signed_block_header_ffi(block_headers[i]);
-//               blocks_ffi[i] = *p;
-//            }
-
-//            auto merkle_ptr = convert_ffi(blockroot_merkle);
-
-//            block_id_type_list *ids_list = new block_id_type_list[block_id_lists.size()];
-//            for (size_t i = 0; i < block_id_lists.size(); ++i) {
-//               ids_list[i] = convert_ffi(block_id_lists[i]);
-//            }
-
-            rpc_result *result = change_schedule(
-               config.bifrost_addr.data(),
-               config.bifrost_signer.data(),
-               ti->legacy_schedule_hash,
-               new_schedule.data(),
-               mroot_json.data(),
-               blocks_json.data(),
-               block_headers.size(),
-               ids_json.data(),
-               block_id_lists.size()
-            );
-
-            if (result) { // not null
-               if (result->success) {
-                  change_schedule_index.modify(ti, [&](auto &entry) {
-                     entry.status = 2; // sent successfully
-                  });
-                  ilog("sent data to bifrost for changing schedule.");
-                  ilog("Transaction got finalized. Hash: ${hash}.", ("hash", std::string(result->msg)));
-               } else {
-                  ilog("failed to send data to bifrost for changing schedule due to: ${err}.", ("err", std::string(result->msg)));
-               }
+      auto within_budget = [this]() {
+         return prove_action_index.size() + change_schedule_index.size() <= retention.max_entries && entry_bytes <= retention.max_bytes;
+      };
+      while (!within_budget()) {
+         if (!evict_oldest_finalized() && !spill_oldest_failed()) {
+            if (!over_budget) {
+               wlog("bridge entries exceed the memory budget, ${n} entries, ${b} bytes, none of them can be evicted",
+                    ("n", prove_action_index.size() + change_schedule_index.size())("b", entry_bytes));
             }
-
-//            if (blocks_ffi) delete []blocks_ffi;
-//            if (ids_list) delete []ids_list;
+            over_budget = true;
+            return;
          }
-
-         change_schedule_timer_tick();
-      });
+      }
+      over_budget = false;
    }
 
-   void bridge_plugin_impl::prove_action_timer_tick() {
-      if( in_shutdown ) return;
-
-      prove_action_timer->expires_from_now(prove_action_timeout);
-      prove_action_timer->async_wait([&](boost::system::error_code ec) {
-         ilog("prove_action_index size: ${to}", ("to", prove_action_index.size()));
-         if (ec) {
-            ilog("error happened while trigger sending transaction");
-            if( in_shutdown ) return;
-            prove_action_timer_tick();
-         } else {
-            for (auto ti = prove_action_index.begin(); ti != prove_action_index.end(); ++ti) {
-               if (ti->status != 1) continue;
-
-               auto tuple = collect_incremental_merkle_and_blocks(ti);
-               incremental_merkle blockroot_merkle = ti->imcre_merkle;
-               auto block_headers = std::get<0>(tuple);
-               auto block_id_lists = std::get<1>(tuple);
-               auto found = std::get<2>(tuple);
-
-               if (!found) {
-                  ilog("It doesn't finish collecting related blocks, cotinue");
-                  continue;
-               }
-
-               signed_block_header_ffi *blocks_ffi = new signed_block_header_ffi[block_headers.size()];
-               for (size_t i = 0; i < block_headers.size(); ++i) {
-                  auto p = new signed_block_header_ffi(block_headers[i]);
-                  blocks_ffi[i] = *p;
-               }
+   bool bridge_plugin_impl::evict_oldest_finalized() {
+      auto &pa_idx = prove_action_index.get<by_status>();
+      auto &cs_idx = change_schedule_index.get<by_status>();
+      auto pa = pa_idx.lower_bound(std::make_tuple(uint8_t(bridge_status::sent)));
+      auto cs = cs_idx.lower_bound(std::make_tuple(uint8_t(bridge_status::sent)));
+      const bool has_pa = pa != pa_idx.end() && pa->status == bridge_status::sent;
+      const bool has_cs = cs != cs_idx.end() && cs->status == bridge_status::sent;
+      if (has_cs && (!has_pa || cs->block_num < pa->block_num)) {
+         erase_entry(change_schedule_index.project<0>(cs));
+         return true;
+      }
+      if (has_pa) {
+         erase_entry(prove_action_index.project<0>(pa));
+         return true;
+      }
+      return false;
+   }
 
-               auto receipts = action_receipt_ffi(ti->receipt);
-               auto act_ffi = action_ffi(ti->act);
-               auto merkle_ptr = convert_ffi(blockroot_merkle);
+   bool bridge_plugin_impl::spill_oldest_failed() {
+      auto &idx = prove_action_index.get<by_status>();
+      auto range = idx.equal_range(std::make_tuple(uint8_t(bridge_status::ready)));
+      for (auto itr = range.first; itr != range.second; ++itr) {
+         if (prove_action_retries.attempts(itr->act_receipt_digest) == 0) continue;
+         const auto before = prove_action_index.size();
+         spill_prove_action(prove_action_index.project<0>(itr));
+         return prove_action_index.size() < before;
+      }
+      return false;
+   }
 
-               std::vector<block_id_type> act_receipts_digs;
-               int j = -1;
-               for (size_t i = 0; i < ti->act_receipts.size(); ++i) {
-                  auto dig = ti->act_receipts[i].digest();
-                  if (dig == ti->act_receipt_digest) j = i;
-                  act_receipts_digs.push_back(dig);
-               }
-               if (j < 0) {
-                  ilog("This is an invalid transaction due to wrong action receipt: ${act}", ("act", ti->act));
-                  ilog("all receipts: ${to}", ("to", ti->act_receipts));
-                  ilog("all receipts hash: ${to}", ("to", ti->act_receipt_digest));
-                  ilog("act_receipt_digest: ${to}", ("to", ti->act_receipt_digest));
-                  ilog("imcre_merkle: ${to}", ("to", ti->imcre_merkle));
-                  ilog("receipt: ${to}", ("to", ti->receipt));
-                  continue;
-               }
-               auto paths = get_proof(j, act_receipts_digs);
-               auto merkle_paths = convert_ffi(paths);
+   // the entry leaves memory with its proof, so the window doesn't have to hold its blocks meanwhile
+   void bridge_plugin_impl::spill_prove_action(bridge_prove_action_index::iterator ti) {
+      if (ti->status != bridge_status::ready) return;
+      auto tuple = collect_blocks(ti->block_num);
+      if (!std::get<2>(tuple)) return;
 
-               block_id_type_list *ids_list = new block_id_type_list[block_id_lists.size()];
-               for (size_t i = 0; i < block_id_lists.size(); ++i) {
-                  ids_list[i] = convert_ffi(block_id_lists[i]);
-               }
+      bridge_proof proof{*ti, std::move(std::get<0>(tuple)), std::move(std::get<1>(tuple))};
+      try {
+         spill_store.put(proof);
+      } catch (const std::exception &e) {
+         wlog("failed to spill bridge entry ${d}: ${e}", ("d", ti->act_receipt_digest)("e", e.what()));
+         return;
+      }
+      dlog("spilled bridge entry ${d} of block ${n}", ("d", ti->act_receipt_digest)("n", ti->block_num));
+      // no erase record, replaying the journal may restore it next to the spilled copy which reload tolerates
+      track_erase(*ti);
+      prove_action_stages.forget(ti->act_receipt_digest);
+      prove_action_index.erase(ti);
+   }
 
-               rpc_result *result = prove_action(
-                 config.bifrost_addr.data(),
-                 config.bifrost_signer.data(),
-                 &act_ffi,
-                 &merkle_ptr,
-                 &receipts,
-                 &merkle_paths,
-                 blocks_ffi,
-                 block_headers.size(),
-                 ids_list,
-                 block_id_lists.size(),
-                 ti->trx_id
-               );
-
-               if (result) { // not null
-                  if (result->success) {
-                     prove_action_index.modify(ti, [&](auto &entry) {
-                        entry.status = 2; // sent successfully
-                     });
-                     ilog("sent data to bifrost for proving action.");
-                     ilog("Transaction got finalized. Hash: ${hash}.", ("hash", std::string(result->msg)));
-                  } else {
-                     ilog("failed to send data to bifrost for proving action due to: ${err}.",
-                          ("err", std::string(result->msg)));
-                  }
-               }
+   void bridge_plugin_impl::reload_spilled(std::chrono::steady_clock::time_point now) {
+      std::vector<block_id_type> due;
+      for (const auto &s : spill_store.spilled()) {
+         if (due.size() >= max_in_flight) break;
+         if (prove_action_retries.due(s.first, now)) due.push_back(s.first);
+      }
 
-               if (blocks_ffi) delete []blocks_ffi;
-               if (ids_list) delete []ids_list;
-            }
+      for (const auto &key : due) {
+         auto proof = spill_store.take(key);
+         if (!proof) continue;
+         auto &entry = proof->entry;
+         entry.status = bridge_status::ready;
+         auto itr = prove_action_index.find(key);
+         if (itr == prove_action_index.end()) {
+            prove_action_index.insert(entry);
+            journal.upsert(entry);
+            track_insert(entry);
+         } else if (itr->status == bridge_status::sent) {
+            continue; // finalized by an earlier submission
          }
-
-         prove_action_timer_tick();
-      });
+         detached_proofs[entry.block_num] = std::make_pair(std::move(proof->block_headers), std::move(proof->block_id_lists));
+      }
    }
 
    // listen and retrieve block headers, collecting block headers for verifying
    void bridge_plugin_impl::irreversible_block(const chain::block_state_ptr &block) {
-      // flush buffer
-      uint64_t block_index_max_size = 512; // How many transaction will be stored.
-      if (prove_action_index.size() >= block_index_max_size) {
-         if (prove_action_index.begin()->status == 2) prove_action_index.erase(prove_action_index.begin());
-      }
-
-      if (change_schedule_index.size() >= block_index_max_size && change_schedule_index.begin()->status == 2) {
-         change_schedule_index.erase(change_schedule_index.begin());
-      }
+      chain::scoped_span span("irreversible_block", "bridge_plugin", block->block_num);
+      enforce_retention(block->block_num);
+      signing_history.add(*block);
+      if (!redeem_trxs.empty()) redeems_irreversible(*block);
 
-      auto bb = bridge_blocks{ block->id, *block };
-      if (block_index.size() >= block_index_max_size) {
-         block_index.erase(block_index.begin());
-      }
-      block_index.insert(bb);
+      auto rec = make_header_record(*block);
+      journal.append_block(rec);
+      append_block(std::move(rec));
 
       // collect blocks for prove_action
-      for (auto iter = prove_action_index.begin(); iter !=prove_action_index.end(); ++iter) {
-         if (iter->status == 0 && iter->bs.size() <= 12 * 16) {
-            prove_action_index.modify(iter, [=](auto &entry) {
-               if (entry.block_num <= block->block_num) {
-                  entry.bs.push_back(*block);
-               }
-               if (entry.block_num - 1 == block->block_num) { // need previous block blockroot_merkle
-                  entry.imcre_merkle = block->blockroot_merkle;
-               }
-            });
-         }
-         if (iter->status == 0 && iter->block_num != 0 && iter->bs.size() >= 12 * 16) {
-            prove_action_index.modify(iter, [=](auto &entry) {
-               ilog("collected blocks for proving action: ${to}", ("to", block->block_num));
-               entry.status = 1; // full
-            });
-            // trigger cross trade
-            // prove_action_timer_tick();
-         }
+      const bool collecting_actions = has_collecting(prove_action_index);
+      if (collecting_actions) {
+         mark_collected(prove_action_index, block_window, window_geometry, journal, block, "proving action",
+                        [this](const bridge_prove_action &entry) { prove_action_stages.ready(entry.act_receipt_digest); });
       }
 
-      // check if block has new producers, and collect blocks for change_schedule
-      auto blk = block->block;
       // Once also the block with the new producers list becomes final the new schedule actually
       // becomes active and the schedule_version field increments. By committing proofs of the
       // finality of the block with the new producers list, one can prove a BP set change has occurred.
-      if (block->header.schedule_version + 1 == block->active_schedule.version) {
+      // block_header_state promotes the pending schedule only at this one block, so the check is all a
+      // block costs while no schedule change is in flight.
+      if (partition.leader() && block->header.schedule_version + 1 == block->active_schedule->version) {
          // insert blocks
          ilog("new producers list coming: ${to}", ("to", block->active_schedule));
          // ilog("new producers list coming: ${to}", ("to", block->active_schedule));
 
+         if (previous_blockroot_merkle._node_count == 0) {
+            wlog("blockroot_merkle of block ${n} is unknown, new schedule can't be proved", ("n", block->block_num - 1));
+         }
          auto trace = bridge_change_schedule {
             block->block_num,
-            incremental_merkle(),
-            std::vector<block_state>(),
+            previous_blockroot_merkle,
             0,
             block->pending_schedule.schedule_hash, // this is legacy producer schedule hash
             block->active_schedule // this is new producer schedule
          };
-         change_schedule_index.insert(trace);
+         if (change_schedule_index.insert(trace).second) {
+            journal.upsert(trace);
+            track_insert(trace);
+            change_schedule_stages.captured(trace.block_num);
+         }
+      }
+
+      // the collector of schedule changes is only scoped to the blocks following a promotion
+      const bool collecting_schedules = has_collecting(change_schedule_index);
+      if (collecting_schedules) {
+         mark_collected(change_schedule_index, block_window, window_geometry, journal, block, "changing schedule",
+                        [this](const bridge_change_schedule &entry) { change_schedule_stages.ready(entry.block_num); });
+      }
+
+      // the rest of the range doesn't have to wait for irreversibility, its headers carry the producer signatures
+      // proving the finality of the entry's block either way
+      if (speculative_proofs && collecting_actions) {
+         mark_speculatively_collected(prove_action_index, block_window, speculative_window, window_geometry, journal, block,
+               "proving action", [this](const bridge_prove_action &entry, auto &&headers, auto &&ids) {
+            detached_proofs[entry.block_num] = std::make_pair(std::move(headers), std::move(ids));
+            prove_action_stages.ready(entry.act_receipt_digest);
+         });
+      }
+      if (speculative_proofs && collecting_schedules) {
+         mark_speculatively_collected(change_schedule_index, block_window, speculative_window, window_geometry, journal, block,
+               "changing schedule", [this](const bridge_change_schedule &entry, auto &&headers, auto &&ids) {
+            detached_proofs[entry.block_num] = std::make_pair(std::move(headers), std::move(ids));
+            change_schedule_stages.ready(entry.block_num);
+         });
+      }
+
+      prune_block_window(block->block_num);
+
+      if (journal.size() >= bridge_journal_max_size) write_db();
+   }
+
+   // Blocks that became irreversible while the relay was offline are fed through irreversible_block()
+   // again. Headers come from block_log, transfers from the state history trace log, which workers
+   // decode chunk by chunk ahead of the main thread. A block_state is rebuilt from its header alone:
+   // blockroot_merkle is rolled forward from the last block the relay knows, the active schedule is
+   // followed through the schedule changes found in the scanned headers.
+   void bridge_plugin_impl::backfill() {
+      const chain::controller &cc = *chain_control;
+      const uint32_t lib = cc.last_irreversible_block_num();
+
+      bridge_trace_log probe;
+      const bool has_traces = probe.open(backfill_trace_dir);
+      if (!has_traces) {
+         wlog("no trace_history.log in ${d}, bridge backfill rebuilds block windows only and misses transfers",
+              ("d", backfill_trace_dir));
+      }
+
+      uint32_t first = backfill_from;
+      if (first == 0) first = last_block_num ? last_block_num + 1 : (has_traces ? probe.begin_block() : lib + 1);
+      if (first > lib) {
+         ilog("bridge backfill has nothing to scan before irreversible block ${lib}", ("lib", lib));
+         return;
       }
+      ilog("bridge backfill of blocks ${f} to ${l}", ("f", first)("l", lib));
+
+      const uint32_t chunk = 256;
+      named_thread_pool pool("bridgebf", backfill_threads);
+      std::deque<std::future<std::vector<bridge_backfill_traces>>> decoded;
+      uint32_t next_chunk = first;
+      auto decode_chunk = [&]() {
+         const uint32_t from = next_chunk;
+         const uint32_t to = uint32_t(std::min<uint64_t>(lib, uint64_t(from) + chunk - 1));
+         next_chunk = to + 1;
+         decoded.push_back(async_thread_pool(pool.get_executor(), [this, from, to, has_traces]() {
+            std::vector<bridge_backfill_traces> result(to - from + 1);
+            bridge_trace_log log;
+            if (!has_traces || !log.open(backfill_trace_dir)) return result;
+            for (uint32_t n = std::max(from, log.begin_block()); n <= to && n < log.end_block(); ++n) {
+               result[n - from] = log.read(n, transfer_matcher);
+            }
+            return result;
+         }));
+      };
+      for (uint32_t i = 0; i < 2u * backfill_threads && next_chunk <= lib; ++i) decode_chunk();
+
+      // blockroot_merkle of a block covers the ids of all blocks before it
+      auto prev = block_window.get(first - 1);
+      const bool merkle_known = first == 1 || (prev && last_block_num + 1 == first);
+      incremental_merkle merkle = (first > 1 && merkle_known) ? last_blockroot_merkle : incremental_merkle();
+      if (first > 1 && merkle_known) merkle.append(prev->id);
+      if (!merkle_known) wlog("blockroot_merkle before block ${n} is unknown, backfilled schedule changes can't be proved", ("n", first));
+
+      producer_authority_schedule_ptr active = cc.active_producers(); // until the first schedule change is seen
+      fc::optional<std::pair<producer_authority_schedule_ptr, digest_type>> proposed;
+      const size_t captured_before = prove_action_index.size();
+      std::vector<bridge_backfill_traces> traces;
+
+      uint32_t n = first;
+      signed_block_ptr block = cc.fetch_block_by_number(n);
+      try {
+         for (; n <= lib && block && !in_shutdown; ++n) {
+            if ((n - first) % chunk == 0) {
+               traces = decoded.front().get();
+               decoded.pop_front();
+               if (next_chunk <= lib) decode_chunk();
+            }
+            auto next = n < lib ? cc.fetch_block_by_number(n + 1) : signed_block_ptr();
+
+            if (block->new_producers) {
+               proposed = std::make_pair(producer_authority_schedule_ptr(producer_authority_schedule(*block->new_producers)), digest_type::hash(*block->new_producers));
+            }
+            auto exts = block->validate_and_extract_header_extensions();
+            if (exts.count(producer_schedule_change_extension::extension_id()) > 0) {
+               const auto &s = exts.lower_bound(producer_schedule_change_extension::extension_id())->second.get<producer_schedule_change_extension>();
+               proposed = std::make_pair(producer_authority_schedule_ptr(s), digest_type::hash(s));
+            }
 
-      for (auto iter = change_schedule_index.begin(); iter !=change_schedule_index.end(); ++iter) {
-         if (iter->status == 0 && iter->bs.size() <= 12 * 16) {
-            change_schedule_index.modify(iter, [=](auto &entry) {
-               if (entry.block_num <= block->block_num) {
-                  entry.bs.push_back(*block);
+            auto bsp = std::make_shared<block_state>();
+            bsp->block_num = n;
+            bsp->id = block->id();
+            bsp->header = *block;
+            bsp->block = block;
+            bsp->blockroot_merkle = merkle_known ? merkle : incremental_merkle();
+            // the proposed schedule is active from the last block still carrying the old schedule_version
+            if (next && next->schedule_version == block->schedule_version + 1) {
+               if (proposed) {
+                  active = proposed->first;
+                  bsp->pending_schedule.schedule_hash = proposed->second;
+                  proposed.reset();
+               } else {
+                  wlog("schedule proposed before block ${f} becomes active in block ${n}, its change can't be proved", ("f", first)("n", n));
                }
-               if (entry.block_num - 1 == block->block_num) { // need previous block blockroot_merkle
-                  entry.imcre_merkle = block->blockroot_merkle;
+            }
+            bsp->active_schedule = active;
+
+            auto &t = traces[(n - first) % chunk];
+            if (!t.traces.empty()) {
+               receipt_tree = std::make_shared<const block_receipt_tree>(n, t.receipts);
+               if (t.block_id != bsp->id) {
+                  wlog("traces of block ${n} are of another fork, skipped", ("n", n));
+               } else if (receipt_tree->root() != block->action_mroot) {
+                  wlog("action receipts of block ${n} from trace_history.log don't match its action_mroot, skipped", ("n", n));
+               } else {
+                  for (const auto &tt : t.traces) filter_action(tt->action_traces, t.receipts, tt->id);
                }
-            });
-         }
-         if (iter->status == 0 && iter->block_num != 0 && iter->bs.size() >= 12 * 16) {
-            change_schedule_index.modify(iter, [=](auto &entry) {
-               ilog("collected blocks for changing schedule: ${to}", ("to", block->block_num));
-               entry.status = 1; // full
-            });
+               receipt_tree.reset();
+            }
+
+            irreversible_block(bsp);
+            merkle.append(bsp->id);
+            block = next;
+
+            if ((n - first + 1) % 100000 == 0) ilog("bridge backfill reached block ${n}", ("n", n));
          }
+      } catch (const fc::exception &e) {
+         elog("bridge backfill stopped at block ${n}: ${e}", ("n", n)("e", e.to_detail_string()));
+      } catch (const std::exception &e) {
+         elog("bridge backfill stopped at block ${n}: ${e}", ("n", n)("e", e.what()));
       }
+      pool.stop();
+
+      if (n <= lib && !in_shutdown) wlog("bridge backfill ended at block ${n}, block_log doesn't hold it", ("n", n));
+      ilog("bridge backfill scanned ${c} blocks and captured ${t} transfers",
+           ("c", n - first)("t", prove_action_index.size() - captured_before));
+      write_db();
    }
 
-   // Listen a transaction from or to contract user or
+   // Listen a transaction from or to a watched account
    void bridge_plugin_impl::filter_action(
-      const std::string &contract,
       const std::vector<action_trace> &action_traces,
       const std::vector<action_receipt> &receipts,
-      transaction_id_type &trx_id
+      const transaction_id_type &trx_id
    ) {
-      int index = -1;
-      transaction_id_type current_trx_id = transaction_id_type();
-
-      static int times = 0;
-
-      for (size_t i = 0; i < action_traces.size(); ++i) {
-         // in case action traces has errors
-         if (action_traces[i].except) {
-            ilog("An invalid action occured due to: ${reason}", ("reason", action_traces[i].except));
+      // in case action traces has errors
+      for (const auto &at : action_traces) {
+         if (at.except) {
+            ilog("An invalid action occured due to: ${reason}", ("reason", at.except));
             return;
          }
+      }
 
-         auto act = action_traces[i].act;
-         auto act_dig = digest(act);
-         auto receiver = action_traces[i].receiver;
-         if (act.account == name("eosio.token") && act.name == name("transfer") && receiver == name("eosio.token")) {
-            action_transfer der_act;
-            fc::raw::unpack<action_transfer>(act.data, der_act);
-            ilog("money from: ${from}", ("from", der_act.from));
-            ilog("money to: ${to}", ("to", der_act.to));
-            ilog("action_transfer: ${to}", ("to", der_act));
-            ilog("action traces from: ${to}", ("to", action_traces[i]));
-
-            // filter a transaction by contract user, example bifrostcross is a contract user.
-            if (der_act.from == name(contract)) {
+      for (const auto &at : action_traces) {
+         switch (transfer_matcher.match(at)) {
+            case bridge_transfer_matcher::outgoing:
                // Bifrost => EOS, do need to transaction id, and it depends.
                // 1. redeem assets by Bifrost offchain worker, trigger from bifrost
                // 2. directly redeem assets by cleos command, we may not need this transaction id
                // ["bifrostcross", "jim", "43.0000 EOS", "5GrwvaEF5zXb26Fz9rcQpDWS57CtERHpNehXCPcNoHGKutQY@bifrost:vEOS"]
-               current_trx_id = trx_id;
-            }
-            if (der_act.to == name(contract)) {
+               capture_transfer(at, receipts, trx_id);
+               break;
+            case bridge_transfer_matcher::incoming:
                // EOS => Bifrost, doesn't need to transaction id
-               current_trx_id = transaction_id_type();
-            }
-
-            if (der_act.to != name(contract) && der_act.from != name(contract)) return;
-
-            if (!action_traces[i].receipt) {
-               ilog("action traces is exception.");
-               return;
-            }
-            int k = -1;
-            if (der_act.from == name(contract) || der_act.to == name(contract)) {
-               index = action_traces[i].action_ordinal;
-               k = action_traces[i].action_ordinal;
-            }
+               capture_transfer(at, receipts, transaction_id_type());
+               break;
+            default:
+               break;
          }
       }
+   }
 
-      if (index < 0) {
-         ilog("cannot find action traces index.");
+   void bridge_plugin_impl::capture_transfer(
+      const action_trace &at,
+      const std::vector<action_receipt> &receipts,
+      const transaction_id_type &trx_id
+   ) {
+      if (!at.receipt) {
+         ilog("action traces is exception.");
          return;
       }
 
-      times += 1;
-      ilog("Times of cross trade: ${to}", ("to", times));
+      auto receipt_dig = at.receipt->digest(); // this can be unique as index
+      if (!partition.owns(receipt_dig)) {
+         dlog("bridge transfer ${dig} is left to another relay partition", ("dig", receipt_dig));
+         return;
+      }
 
-      auto receipt = action_traces[index].receipt;
-      auto receipt_dig = receipt->digest(); // this can be unique as index
-      ilog("receipt_dig: ${to}", ("to", receipt_dig));
-      ilog("index: ${to}", ("to", index));
-      ilog("receipts: ${to}", ("to", receipts));
+      // the proof path never changes, compute it once instead of on every submission attempt
+      const uint32_t block_num = at.block_num;
+      if (!receipt_tree || !receipt_tree->matches(block_num, receipts)) {
+         receipt_tree = std::make_shared<const block_receipt_tree>(block_num, receipts);
+      }
+      int j = receipt_tree->find(receipt_dig);
+      if (j < 0) {
+         ilog("This is an invalid transaction due to wrong action receipt: ${act}", ("act", at.act));
+         ilog("act_receipt_digest: ${to}", ("to", receipt_dig));
+         ilog("receipt: ${to}", ("to", *at.receipt));
+         return;
+      }
 
       auto bt = bridge_prove_action {
-         action_traces[index].block_num,
-         action_traces[index].act,
-         *action_traces[index].receipt,
-         receipts,
+         block_num,
+         at.act,
+         *at.receipt,
+         receipt_tree->proof(j),
          receipt_dig,
          incremental_merkle(),
-         std::vector<block_state>(),
          0,
-         current_trx_id
+         trx_id,
+         uint32_t(j)
       };
-      prove_action_index.insert(bt);
+      if (prove_action_index.insert(bt).second) {
+         journal.upsert(bt);
+         track_insert(bt);
+         prove_action_stages.captured(receipt_dig);
+         ilog("captured bridge transfer in block ${num}, receipt digest: ${dig}", ("num", block_num)("dig", receipt_dig));
+      }
    }
 
-   void bridge_plugin_impl::apply_action_receipt(std::tuple<const transaction_trace_ptr&, const std::vector<action_receipt>&> t) {
-      auto tt = std::get<0>(t);
-      auto acts = std::get<1>(t);
+   void bridge_plugin_impl::applied_block_action_receipts(std::tuple<uint32_t, const std::vector<transaction_trace_ptr>&, const std::vector<action_receipt>&> t) {
+      if (transfer_matcher.empty()) return;
 
-      auto action_traces = tt->action_traces;
-      auto trx_id = tt->id; // get transaction id
-      filter_action(config.bifrost_crossaccount, action_traces, acts, trx_id);
+      const auto &trx_traces = std::get<1>(t);
+      const auto &acts = std::get<2>(t);
+
+      // built lazily by the first bridge transfer of this block
+      receipt_tree.reset();
+      for (const auto &tt : trx_traces) {
+         filter_action(tt->action_traces, acts, tt->id);
+      }
+      receipt_tree.reset();
    }
 
    void bridge_plugin_impl::open_db() {
       ilog("bridge_plugin_impl::open_db()");
 
-      datadir = app().data_dir() / "bridge";
       if (!fc::is_directory(datadir))
          fc::create_directories(datadir);
 
@@ -551,16 +2334,51 @@ namespace eosio {
             fc::read_file_contents(bridge_db_dat, content);
             fc::datastream<const char *> ds(content.data(), content.size());
 
-            block_index.clear();
             change_schedule_index.clear();
             prove_action_index.clear();
+            block_window.clear();
+            queued_redeems.clear();
+            known_redeems.clear();
+            redeem_trxs.clear();
+
+            uint32_t magic = 0;
+            if (ds.remaining() >= sizeof(magic)) {
+               memcpy(&magic, ds.pos(), sizeof(magic));
+            }
+            if (magic == bridge_db_magic) {
+               ds.skip(sizeof(magic));
+               unsigned_int block_window_size;
+               fc::raw::unpack(ds, block_window_size);
+               for (uint32_t i = 0, n = block_window_size.value; i < n; ++i) {
+                  bridge_header_record rec;
+                  fc::raw::unpack(ds, rec);
+                  block_window.push_back(std::move(rec));
+               }
+            } else {
+               // older versions wrote blocks by id, then the window, both as full block_states
+               unsigned_int block_index_size;
+               fc::raw::unpack(ds, block_index_size);
+               for (uint32_t i = 0, n = block_index_size.value; i < n; ++i) {
+                  block_id_type id;
+                  block_state bls;
+                  fc::raw::unpack(ds, id);
+                  fc::raw::unpack(ds, bls);
+               }
 
-            unsigned_int block_index_size;
-            fc::raw::unpack(ds, block_index_size);
-            for (uint32_t i = 0, n = block_index_size.value; i < n; ++i) {
-               bridge_blocks bb;
-               fc::raw::unpack(ds, bb);
-               block_index.insert(bb);
+               unsigned_int block_window_size;
+               fc::raw::unpack(ds, block_window_size);
+               for (uint32_t i = 0, n = block_window_size.value; i < n; ++i) {
+                  block_state bls;
+                  fc::raw::unpack(ds, bls);
+                  block_window.push_back(make_header_record(bls));
+               }
+            }
+            if (!block_window.empty()) {
+               auto last = block_window.get(block_window.last_block_num());
+               auto previous = block_window.get(block_window.last_block_num() - 1);
+               last_blockroot_merkle = last->blockroot_merkle;
+               previous_blockroot_merkle = previous ? previous->blockroot_merkle : incremental_merkle();
+               last_block_num = last->block_num;
             }
 
             unsigned_int change_schedule_index_size;
@@ -579,45 +2397,317 @@ namespace eosio {
                prove_action_index.insert(bpa);
             }
 
+            // the redeems follow, older versions end here
+            if (ds.remaining()) {
+               fc::raw::unpack(ds, redeem_block);
+               fc::raw::unpack(ds, known_redeems);
+               std::vector<bridge_redeem> queued;
+               fc::raw::unpack(ds, queued);
+               queued_redeems.assign(queued.begin(), queued.end());
+               unsigned_int redeem_trxs_size;
+               fc::raw::unpack(ds, redeem_trxs_size);
+               for (uint32_t i = 0, n = redeem_trxs_size.value; i < n; ++i) {
+                  redeem_transaction t;
+                  auto trx = std::make_shared<packed_transaction>();
+                  fc::raw::unpack(ds, t.lib_num);
+                  fc::raw::unpack(ds, *trx);
+                  fc::raw::unpack(ds, t.redeems);
+                  t.expiration = trx->expiration();
+                  t.trx = std::move(trx);
+                  redeem_trxs[t.trx->id()] = std::move(t);
+               }
+               const auto now = fc::time_point::now();
+               for (auto &r : queued_redeems) r.requested = now;
+               for (auto &t : redeem_trxs) {
+                  for (auto &r : t.second.redeems) r.requested = now;
+               }
+            }
+
          } FC_CAPTURE_AND_RETHROW((bridge_db_dat))
+      }
 
-         fc::remove(bridge_db_dat);
+      auto bridge_journal_log = datadir / config::bridge_journal_filename;
+      if (fc::exists(bridge_journal_log)) {
+         replay_journal(bridge_journal_log);
       }
-   }
 
-   void bridge_plugin_impl::close_db() {
-      ilog("bridge_plugin_impl::close_db()");
-      auto bridge_db_dat = datadir / config::bridgedb_filename;
+      // submission was interrupted by shutdown or crash, submit it again
+      reset_submitting(prove_action_index);
+      reset_submitting(change_schedule_index);
 
-      std::ofstream out(bridge_db_dat.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc);
+      entry_bytes = 0;
+      for (const auto &e : prove_action_index) track_insert(e);
+      for (const auto &e : change_schedule_index) track_insert(e);
 
-      uint32_t block_index_size = block_index.size();
-      fc::raw::pack(out, unsigned_int{block_index_size});
-      auto block_iter = block_index.get<by_id>().begin();
-      auto blk_it = block_index.project<0>(block_iter);
-      for (; blk_it != block_index.end(); ++blk_it) {
-         fc::raw::pack(out, *blk_it);
+      spill_store.open(datadir / "spill");
+      if (!spill_store.spilled().empty()) ilog("${n} bridge entries are spilled to disk", ("n", spill_store.spilled().size()));
+
+      journal.open(bridge_journal_log);
+      if (journal.size() >= bridge_journal_max_size) write_db();
+   }
+
+   void bridge_plugin_impl::replay_journal(const fc::path &bridge_journal_log) {
+      string content;
+      fc::read_file_contents(bridge_journal_log, content);
+      fc::datastream<const char *> ds(content.data(), content.size());
+
+      uint64_t records = 0;
+      while (ds.remaining() >= sizeof(uint32_t)) {
+         uint32_t len = 0;
+         fc::raw::unpack(ds, len);
+         if (ds.remaining() < len) {
+            wlog("ignoring torn record at the end of bridge journal ${p}", ("p", bridge_journal_log));
+            break;
+         }
+         fc::datastream<const char *> record(ds.pos(), len);
+         ds.skip(len);
+         try {
+            apply_journal_record(record);
+         } catch (const fc::exception &e) {
+            wlog("stop replaying bridge journal at malformed record ${n}: ${e}", ("n", records)("e", e.to_detail_string()));
+            break;
+         }
+         ++records;
       }
+      ilog("replayed ${n} records of bridge journal", ("n", records));
+   }
 
-      uint32_t change_schedule_index_size = change_schedule_index.size();
-      fc::raw::pack(out, unsigned_int{change_schedule_index_size});
-      auto cs_iter = change_schedule_index.get<by_id>().begin();
-      auto cs_it = change_schedule_index.project<0>(cs_iter);
-      for (; cs_it != change_schedule_index.end(); ++cs_it) {
-         fc::raw::pack(out, *cs_it);
+   void bridge_plugin_impl::apply_journal_record(fc::datastream<const char *> &ds) {
+      uint8_t type = 0;
+      fc::raw::unpack(ds, type);
+      switch (type) {
+         case bridge_journal::block_record:
+         case bridge_journal::header_record: {
+            bridge_header_record rec;
+            if (type == bridge_journal::block_record) {
+               block_state bs;
+               fc::raw::unpack(ds, bs);
+               rec = make_header_record(bs);
+            } else {
+               fc::raw::unpack(ds, rec);
+            }
+            if (!block_window.empty() && rec.block_num <= block_window.last_block_num()) break; // already in bridge_db.dat
+            const uint32_t block_num = rec.block_num;
+            append_block(std::move(rec));
+            prune_block_window(block_num);
+            break;
+         }
+         case bridge_journal::prove_action_record: {
+            bridge_prove_action bpa;
+            fc::raw::unpack(ds, bpa);
+            auto itr = prove_action_index.find(bpa.act_receipt_digest);
+            if (itr == prove_action_index.end()) prove_action_index.insert(bpa);
+            else prove_action_index.replace(itr, bpa);
+            break;
+         }
+         case bridge_journal::prove_action_status_record: {
+            block_id_type key;
+            uint8_t status = 0;
+            fc::raw::unpack(ds, key);
+            fc::raw::unpack(ds, status);
+            auto itr = prove_action_index.find(key);
+            if (itr != prove_action_index.end()) prove_action_index.modify(itr, [&](auto &entry) { entry.status = status; });
+            break;
+         }
+         case bridge_journal::erase_prove_action_record: {
+            block_id_type key;
+            fc::raw::unpack(ds, key);
+            prove_action_index.erase(key);
+            break;
+         }
+         case bridge_journal::change_schedule_record: {
+            bridge_change_schedule bcs;
+            fc::raw::unpack(ds, bcs);
+            auto itr = change_schedule_index.find(bcs.block_num);
+            if (itr == change_schedule_index.end()) change_schedule_index.insert(bcs);
+            else change_schedule_index.replace(itr, bcs);
+            break;
+         }
+         case bridge_journal::change_schedule_status_record: {
+            uint32_t key = 0;
+            uint8_t status = 0;
+            fc::raw::unpack(ds, key);
+            fc::raw::unpack(ds, status);
+            auto itr = change_schedule_index.find(key);
+            if (itr != change_schedule_index.end()) change_schedule_index.modify(itr, [&](auto &entry) { entry.status = status; });
+            break;
+         }
+         case bridge_journal::erase_change_schedule_record: {
+            uint32_t key = 0;
+            fc::raw::unpack(ds, key);
+            change_schedule_index.erase(key);
+            break;
+         }
+         case bridge_journal::redeem_record: {
+            bridge_redeem r;
+            fc::raw::unpack(ds, r);
+            r.requested = fc::time_point::now();
+            if (known_redeems.emplace(r.id, r.bifrost_block).second) queued_redeems.push_back(std::move(r));
+            break;
+         }
+         case bridge_journal::redeem_trx_record: {
+            redeem_transaction t;
+            auto trx = std::make_shared<packed_transaction>();
+            fc::raw::unpack(ds, t.lib_num);
+            fc::raw::unpack(ds, *trx);
+            fc::raw::unpack(ds, t.redeems);
+            std::set<uint64_t> ids;
+            for (auto &r : t.redeems) {
+               r.requested = fc::time_point::now();
+               ids.insert(r.id);
+            }
+            queued_redeems.erase(std::remove_if(queued_redeems.begin(), queued_redeems.end(),
+                                                [&](const auto &r) { return ids.count(r.id); }), queued_redeems.end());
+            t.expiration = trx->expiration();
+            t.trx = std::move(trx);
+            redeem_trxs[t.trx->id()] = std::move(t);
+            break;
+         }
+         case bridge_journal::requeue_redeem_trx_record:
+         case bridge_journal::redeem_trx_done_record: {
+            transaction_id_type id;
+            fc::raw::unpack(ds, id);
+            auto itr = redeem_trxs.find(id);
+            if (itr == redeem_trxs.end()) break;
+            if (type == bridge_journal::requeue_redeem_trx_record) {
+               for (auto &r : itr->second.redeems) queued_redeems.push_front(std::move(r));
+            }
+            redeem_trxs.erase(itr);
+            break;
+         }
+         case bridge_journal::redeem_block_record: {
+            uint32_t bifrost_block = 0;
+            fc::raw::unpack(ds, bifrost_block);
+            redeem_block = std::max(redeem_block, bifrost_block);
+            break;
+         }
+         default:
+            EOS_THROW( plugin_exception, "unknown bridge journal record type ${t}", ("t", type) );
       }
+   }
+
+   // write the whole state to bridge_db.dat and start a new journal
+   void bridge_plugin_impl::write_db() {
+      auto bridge_db_dat = datadir / config::bridgedb_filename;
+      auto bridge_db_tmp = datadir / (std::string(config::bridgedb_filename) + ".tmp");
+
+      {
+         std::ofstream out(bridge_db_tmp.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc);
+
+         fc::raw::pack(out, bridge_db_magic);
+
+         uint32_t block_window_size = block_window.size();
+         fc::raw::pack(out, unsigned_int{block_window_size});
+         for (const auto &rec : block_window) {
+            fc::raw::pack(out, rec);
+         }
+
+         uint32_t change_schedule_index_size = change_schedule_index.size();
+         fc::raw::pack(out, unsigned_int{change_schedule_index_size});
+         auto cs_iter = change_schedule_index.get<by_id>().begin();
+         auto cs_it = change_schedule_index.project<0>(cs_iter);
+         for (; cs_it != change_schedule_index.end(); ++cs_it) {
+            fc::raw::pack(out, *cs_it);
+         }
+
+         uint32_t prove_action_index_size = prove_action_index.size();
+         fc::raw::pack(out, unsigned_int{prove_action_index_size});
+         auto pa_iter = prove_action_index.get<by_id>().begin();
+         auto pa_it = prove_action_index.project<0>(pa_iter);
+         for (; pa_it != prove_action_index.end(); ++pa_it) {
+            fc::raw::pack(out, *pa_it);
+         }
 
-      uint32_t prove_action_index_size = prove_action_index.size();
-      fc::raw::pack(out, unsigned_int{prove_action_index_size});
-      auto pa_iter = prove_action_index.get<by_id>().begin();
-      auto pa_it = prove_action_index.project<0>(pa_iter);
-      for (; pa_it != prove_action_index.end(); ++pa_it) {
-         fc::raw::pack(out, *pa_it);
+         fc::raw::pack(out, redeem_block);
+         fc::raw::pack(out, known_redeems);
+         fc::raw::pack(out, std::vector<bridge_redeem>(queued_redeems.begin(), queued_redeems.end()));
+         uint32_t redeem_trxs_size = redeem_trxs.size();
+         fc::raw::pack(out, unsigned_int{redeem_trxs_size});
+         for (const auto &t : redeem_trxs) {
+            fc::raw::pack(out, t.second.lib_num);
+            fc::raw::pack(out, *t.second.trx);
+            fc::raw::pack(out, t.second.redeems);
+         }
       }
 
-      block_index.clear();
+      // a crash before the rename keeps the old bridge_db.dat and the full journal
+      fc::rename(bridge_db_tmp, bridge_db_dat);
+      journal.truncate();
+   }
+
+   // every change is already in the journal, nothing to write on shutdown
+   void bridge_plugin_impl::close_db() {
+      ilog("bridge_plugin_impl::close_db()");
+      journal.close();
+
+      block_window.clear();
+      speculative_window.clear();
+      detached_proofs.clear();
       change_schedule_index.clear();
       prove_action_index.clear();
+      queued_redeems.clear();
+      known_redeems.clear();
+      redeem_trxs.clear();
+   }
+
+   bridge_metrics bridge_plugin_impl::get_metrics() const {
+      bridge_metrics m;
+      m.prove_actions = count_statuses(prove_action_index);
+      m.change_schedules = count_statuses(change_schedule_index);
+      m.prove_action_latencies = prove_action_stages.get_latencies();
+      m.change_schedule_latencies = change_schedule_stages.get_latencies();
+      m.ffi_call_latency = ffi_call_latency;
+      m.prove_action_failures = prove_action_retries.total_failures();
+      m.change_schedule_failures = change_schedule_retries.total_failures();
+      m.prove_action_backoffs = prove_action_retries.pending();
+      m.change_schedule_backoffs = change_schedule_retries.pending();
+      m.in_flight = in_flight;
+      m.spilled_prove_actions = spill_store.spilled().size();
+      m.entry_bytes = entry_bytes;
+      m.window_blocks = block_window.size();
+      for (const auto &rec : block_window) m.window_bytes += fc::raw::pack_size(rec);
+      m.speculative_window_blocks = speculative_window.size();
+      m.detached_proofs = detached_proofs.size();
+      m.preflight_failures = preflight_failures;
+      m.rpc_endpoints = rpc_pool_status;
+      m.queued_redeems = queued_redeems.size();
+      m.redeem_transactions = redeem_trxs.size();
+      m.completed_redeems = completed_redeems;
+      m.redeem_failures = redeem_retries.total_failures();
+      m.redeem_latency = redeem_latency;
+      return m;
+   }
+
+   bridge_get_proofs_results bridge_plugin_impl::get_proofs(const bridge_get_proofs_params &params) {
+      EOS_ASSERT( params.trx_id.valid() != params.act_receipt_digest.valid(), invalid_http_request,
+                  "either trx_id or act_receipt_digest is required" );
+
+      bridge_get_proofs_results results;
+      auto add = [&](const bridge_prove_action &entry) {
+         if (entry.status == bridge_status::collecting) return;
+         auto tuple = collect_blocks(entry.block_num);
+         if (!std::get<2>(tuple)) return;
+         results.proofs.push_back(bridge_proof{entry, std::move(std::get<0>(tuple)), std::move(std::get<1>(tuple))});
+      };
+
+      if (params.act_receipt_digest) {
+         auto itr = prove_action_index.find(*params.act_receipt_digest);
+         if (itr != prove_action_index.end()) {
+            add(*itr);
+         } else if (auto spilled = spill_store.get(*params.act_receipt_digest)) {
+            results.proofs.push_back(std::move(*spilled));
+         }
+      } else {
+         // spilled entries are found by their receipt digest only
+         auto range = prove_action_index.get<by_trx>().equal_range(*params.trx_id);
+         for (auto itr = range.first; itr != range.second; ++itr) add(*itr);
+      }
+
+      if (params.binary) {
+         results.packed_proofs = fc::raw::pack(results.proofs);
+         results.proofs.clear();
+      }
+      return results;
    }
 
    bridge_plugin::bridge_plugin() : my(new bridge_plugin_impl()) {}
@@ -627,13 +2717,104 @@ namespace eosio {
    void bridge_plugin::set_program_options(options_description &, options_description &cfg) {
       cfg.add_options()
               ("bifrost-node", bpo::value<string>()->default_value("ws://127.0.0.1:9944"),
-               "This is sopposed to be a bifrost node address like: ws://127.0.0.1:9944");
+               "This is sopposed to be a bifrost node address like: ws://127.0.0.1:9944, several comma separated addresses are used for failover, the fastest healthy one is preferred");
       cfg.add_options()
               ("bifrost-crossaccount", bpo::value<string>()->default_value("bifrostcross"),
                "This is sopposed to be a bifrost crossaccount like: bifrostcross");
+      cfg.add_options()
+              ("bridge-watch-account", bpo::value<vector<string>>()->composing()->multitoken(),
+               "Additional account whose token transfers are proved to bifrost, besides bifrost-crossaccount (may specify multiple times)");
+      cfg.add_options()
+              ("bridge-token-contract", bpo::value<vector<string>>()->composing()->multitoken()->default_value({"eosio.token"}, "eosio.token"),
+               "Token contract whose transfer actions are watched (may specify multiple times)");
+      cfg.add_options()
+              ("bridge-watch", bpo::value<vector<string>>()->composing()->multitoken(),
+               "Additional contract:action:account tuple, e.g. bifrost.tkn:transfer:bifrostcross2, whose actions from or to account are proved to bifrost. The action data must start with the from and to names like transfer does (may specify multiple times)");
       cfg.add_options()
               ("bifrost-signer", bpo::value<string>()->default_value("//Alice"),
                "This is sopposed to be a bifrost crossaccount like: alice or bob");
+      cfg.add_options()
+              ("bridge-extra-signer", bpo::value<vector<string>>()->composing()->multitoken(),
+               "Additional bifrost signer used round-robin with bifrost-signer for submitting proofs (may specify multiple times)");
+      cfg.add_options()
+              ("bridge-submit-threads", bpo::value<uint16_t>()->default_value(2),
+               "Number of worker threads of the rpc runtime submitting extrinsics to bifrost, submissions awaiting finalization don't hold a thread");
+      cfg.add_options()
+              ("bridge-batch-size", bpo::value<uint32_t>()->default_value(1),
+               "Maximum number of action proofs of the same block sent in one batched extrinsic, 1 disables batching");
+      cfg.add_options()
+              ("bridge-max-in-flight", bpo::value<uint32_t>()->default_value(64),
+               "Maximum number of extrinsics submitted to bifrost and awaiting finalization at the same time");
+      cfg.add_options()
+              ("bridge-retry-backoff-ms", bpo::value<uint32_t>()->default_value(1000),
+               "Initial delay before a failed submission is retried, doubled with every further failure");
+      cfg.add_options()
+              ("bridge-retry-max-backoff-ms", bpo::value<uint32_t>()->default_value(60000),
+               "Maximum delay before a failed submission is retried");
+      cfg.add_options()
+              ("bridge-max-entries", bpo::value<uint32_t>()->default_value(65536),
+               "Maximum number of bridge entries kept in memory, finalized ones are evicted first, then failing ones are spilled to disk");
+      cfg.add_options()
+              ("bridge-max-entry-bytes", bpo::value<uint64_t>()->default_value(256 * 1024 * 1024),
+               "Maximum packed size in bytes of the bridge entries kept in memory");
+      cfg.add_options()
+              ("bridge-retain-finalized-blocks", bpo::value<uint32_t>()->default_value(7200),
+               "Number of blocks a finalized bridge entry is kept before it is dropped");
+      cfg.add_options()
+              ("bridge-spill-after-failures", bpo::value<uint32_t>()->default_value(8),
+               "Number of failed submissions after which an action proof waits for its next retry on disk");
+      cfg.add_options()
+              ("bridge-round-stride", bpo::value<uint32_t>()->default_value(config::producer_repetitions),
+               "Distance in blocks between two headers of a finality proof, the number of blocks produced in a row by one producer");
+      cfg.add_options()
+              ("bridge-max-headers", bpo::value<uint32_t>()->default_value(15),
+               "Maximum number of headers of a finality proof, fewer are sent once 2/3+1 of the active producers signed one");
+      cfg.add_options()
+              ("bridge-max-ids-per-gap", bpo::value<uint32_t>()->default_value(10),
+               "Maximum number of block ids the verifier accepts in between two headers of a finality proof, "
+               "a proof carries bridge-round-stride - 2 of them");
+      cfg.add_options()
+              ("bridge-backfill", bpo::bool_switch()->default_value(false),
+               "On startup scan the irreversible blocks missed while the relay was offline, rebuilding their header windows from block_log and capturing their transfers from the state history trace log");
+      cfg.add_options()
+              ("bridge-backfill-from", bpo::value<uint32_t>()->default_value(0),
+               "First block scanned by bridge-backfill, 0 continues after the last block of the relay history or starts at the first block of the trace log");
+      cfg.add_options()
+              ("bridge-backfill-trace-dir", bpo::value<bfs::path>()->default_value("state-history"),
+               "Directory holding trace_history.log of state_history_plugin (relative paths are relative to the application data dir)");
+      cfg.add_options()
+              ("bridge-backfill-threads", bpo::value<uint16_t>()->default_value(2),
+               "Number of worker threads decoding traces for bridge-backfill");
+      cfg.add_options()
+              ("bridge-async-irreversible-block", bpo::bool_switch()->default_value(false),
+               "Queue the irreversible_block handler to the application thread instead of running it while the controller applies blocks");
+      cfg.add_options()
+              ("bridge-partition", bpo::value<string>()->default_value("0/1"),
+               "Share of the transfers proved by this relay as index/count, e.g. 1/3, for running count relays with distinct signers side by side. Transfers are assigned by their receipt digest, only the relay of index 0 proves schedule changes");
+      cfg.add_options()
+              ("bridge-speculative-proofs", bpo::value<bool>()->default_value(true),
+               "Take the blocks following an irreversible block from the reversible blocks of the current fork, so its proof is ready when it becomes irreversible instead of once its whole range is irreversible");
+      cfg.add_options()
+              ("bridge-redeem", bpo::bool_switch()->default_value(false),
+               "Issue the redeems requested on bifrost as token transfers from bifrost-crossaccount, on the relay of bridge-partition 0 only");
+      cfg.add_options()
+              ("bridge-redeem-private-key", bpo::value<string>(),
+               "Private key of the bridge-redeem-permission of bifrost-crossaccount, signing the redeem transfers");
+      cfg.add_options()
+              ("bridge-redeem-permission", bpo::value<string>()->default_value("active"),
+               "Permission of bifrost-crossaccount authorizing the redeem transfers");
+      cfg.add_options()
+              ("bridge-redeem-token-contract", bpo::value<string>()->default_value("eosio.token"),
+               "Token contract of the redeem transfers");
+      cfg.add_options()
+              ("bridge-redeem-batch-size", bpo::value<uint32_t>()->default_value(10),
+               "Max number of redeem transfers in one transaction");
+      cfg.add_options()
+              ("bridge-redeem-max-pending", bpo::value<uint32_t>()->default_value(4),
+               "Max number of redeem transactions awaiting their irreversible receipt");
+      cfg.add_options()
+              ("bridge-verify-proofs", bpo::value<bool>()->default_value(true),
+               "Check every proof the way bifrost does before submitting it: header linkage, producer signatures against the schedule, the action merkle path and the incremental merkle. Proofs failing a check are not submitted and wait for their retry");
       cfg.add_options()
               ("delete-relay-history", bpo::bool_switch()->default_value(false),
                "This is sopposed to delete all realy data history");
@@ -641,6 +2822,10 @@ namespace eosio {
    }
 
    void bridge_plugin::plugin_initialize(const variables_map &options) {
+      plugin_initialize(options, app().find_plugin<chain_plugin>()->chain());
+   }
+
+   void bridge_plugin::plugin_initialize(const variables_map &options, chain::controller &cc) {
       ilog("bridge_plugin::plugin_initialize.");
 
       try {
@@ -661,6 +2846,113 @@ namespace eosio {
             my->config.bifrost_signer = "//Alice";
          }
 
+         if (options.count("bridge-extra-signer")) {
+            my->config.extra_signers = options.at("bridge-extra-signer").as<vector<string>>();
+         }
+
+         // every token contract's transfer to or from every cross account, plus the explicit watches
+         vector<string> cross_accounts{my->config.bifrost_crossaccount};
+         if (options.count("bridge-watch-account")) {
+            for (const auto &a : options.at("bridge-watch-account").as<vector<string>>()) cross_accounts.push_back(a);
+         }
+         for (const auto &c : options.at("bridge-token-contract").as<vector<string>>()) {
+            for (const auto &a : cross_accounts) my->transfer_matcher.add_watch(account_name(c), N(transfer), account_name(a));
+         }
+         if (options.count("bridge-watch")) {
+            for (const auto &w : options.at("bridge-watch").as<vector<string>>()) {
+               vector<string> parts;
+               boost::split(parts, w, boost::is_any_of(":"));
+               EOS_ASSERT( parts.size() == 3, plugin_config_exception,
+                           "bridge-watch ${w} must be given as contract:action:account", ("w", w) );
+               my->transfer_matcher.add_watch(account_name(parts[0]), action_name(parts[1]), account_name(parts[2]));
+            }
+         }
+         ilog("bridge watches ${n} (contract, action, account) tuples", ("n", my->transfer_matcher.size()));
+
+         my->rpc_runtime_threads = options.at("bridge-submit-threads").as<uint16_t>();
+         EOS_ASSERT( my->rpc_runtime_threads > 0, plugin_config_exception,
+                     "bridge-submit-threads ${num} must be greater than 0", ("num", my->rpc_runtime_threads) );
+
+         my->max_batch_size = options.at("bridge-batch-size").as<uint32_t>();
+         EOS_ASSERT( my->max_batch_size > 0, plugin_config_exception,
+                     "bridge-batch-size ${num} must be greater than 0", ("num", my->max_batch_size) );
+
+         my->max_in_flight = options.at("bridge-max-in-flight").as<uint32_t>();
+         EOS_ASSERT( my->max_in_flight > 0, plugin_config_exception,
+                     "bridge-max-in-flight ${num} must be greater than 0", ("num", my->max_in_flight) );
+         const auto backoff = std::chrono::milliseconds(options.at("bridge-retry-backoff-ms").as<uint32_t>());
+         const auto max_backoff = std::chrono::milliseconds(options.at("bridge-retry-max-backoff-ms").as<uint32_t>());
+         my->prove_action_retries.set_backoff(backoff, max_backoff);
+         my->change_schedule_retries.set_backoff(backoff, max_backoff);
+
+         my->retention.max_entries = options.at("bridge-max-entries").as<uint32_t>();
+         my->retention.max_bytes = options.at("bridge-max-entry-bytes").as<uint64_t>();
+         my->retention.finalized_retain_blocks = options.at("bridge-retain-finalized-blocks").as<uint32_t>();
+         my->retention.spill_after_failures = std::max<uint32_t>(1, options.at("bridge-spill-after-failures").as<uint32_t>());
+
+         my->window_geometry.round_stride = options.at("bridge-round-stride").as<uint32_t>();
+         my->window_geometry.max_headers = options.at("bridge-max-headers").as<uint32_t>();
+         my->window_geometry.max_ids_per_gap = options.at("bridge-max-ids-per-gap").as<uint32_t>();
+         EOS_ASSERT( my->window_geometry.round_stride >= 2, plugin_config_exception,
+                     "bridge-round-stride ${num} must be at least 2", ("num", my->window_geometry.round_stride) );
+         EOS_ASSERT( my->window_geometry.ids_per_gap() <= my->window_geometry.max_ids_per_gap, plugin_config_exception,
+                     "bridge-round-stride ${num} needs ${ids} block ids in between two headers, more than bridge-max-ids-per-gap ${max}",
+                     ("num", my->window_geometry.round_stride)("ids", my->window_geometry.ids_per_gap())
+                     ("max", my->window_geometry.max_ids_per_gap) );
+         EOS_ASSERT( my->window_geometry.max_headers > 0, plugin_config_exception,
+                     "bridge-max-headers ${num} must be greater than 0", ("num", my->window_geometry.max_headers) );
+
+         const auto partition = options.at("bridge-partition").as<string>();
+         const auto slash = partition.find('/');
+         EOS_ASSERT( slash != string::npos, plugin_config_exception,
+                     "bridge-partition ${p} must be given as index/count", ("p", partition) );
+         try {
+            my->partition.index = std::stoul(partition.substr(0, slash));
+            my->partition.count = std::stoul(partition.substr(slash + 1));
+         } catch (const std::logic_error &) {
+            EOS_THROW( plugin_config_exception, "bridge-partition ${p} must be given as index/count", ("p", partition) );
+         }
+         EOS_ASSERT( my->partition.count > 0 && my->partition.index < my->partition.count, plugin_config_exception,
+                     "bridge-partition ${p} needs an index below a count greater than 0", ("p", partition) );
+         if (my->partition.count > 1) {
+            ilog("bridge partition ${i} of ${n}${l}", ("i", my->partition.index)("n", my->partition.count)
+                 ("l", my->partition.leader() ? ", proving schedule changes" : ""));
+         }
+
+         my->backfill_enabled = options.at("bridge-backfill").as<bool>();
+         my->backfill_from = options.at("bridge-backfill-from").as<uint32_t>();
+         auto trace_dir = options.at("bridge-backfill-trace-dir").as<bfs::path>();
+         my->backfill_trace_dir = trace_dir.is_relative() ? app().data_dir() / trace_dir : trace_dir;
+         my->backfill_threads = options.at("bridge-backfill-threads").as<uint16_t>();
+         my->async_irreversible_block = options.at("bridge-async-irreversible-block").as<bool>();
+         my->speculative_proofs = options.at("bridge-speculative-proofs").as<bool>();
+         my->verify_proofs = options.at("bridge-verify-proofs").as<bool>();
+
+         my->redeem_enabled = options.at("bridge-redeem").as<bool>() && my->partition.leader();
+         if (my->redeem_enabled) {
+            EOS_ASSERT( options.count("bridge-redeem-private-key"), plugin_config_exception,
+                        "bridge-redeem requires bridge-redeem-private-key" );
+            try {
+               my->redeem_key = fc::crypto::private_key(options.at("bridge-redeem-private-key").as<string>());
+            } catch (const fc::exception &) {
+               EOS_THROW( plugin_config_exception, "bridge-redeem-private-key is not a valid private key" );
+            }
+            my->redeem_permission = permission_name(options.at("bridge-redeem-permission").as<string>());
+            my->redeem_token_contract = account_name(options.at("bridge-redeem-token-contract").as<string>());
+            my->redeem_batch_size = options.at("bridge-redeem-batch-size").as<uint32_t>();
+            my->redeem_max_pending = options.at("bridge-redeem-max-pending").as<uint32_t>();
+            EOS_ASSERT( my->redeem_batch_size > 0, plugin_config_exception,
+                        "bridge-redeem-batch-size ${num} must be greater than 0", ("num", my->redeem_batch_size) );
+            EOS_ASSERT( my->redeem_max_pending > 0, plugin_config_exception,
+                        "bridge-redeem-max-pending ${num} must be greater than 0", ("num", my->redeem_max_pending) );
+            my->redeem_retries.set_backoff(backoff, max_backoff);
+         } else if (options.at("bridge-redeem").as<bool>()) {
+            ilog("bifrost redeems are issued by the relay of bridge-partition 0");
+         }
+         EOS_ASSERT( my->backfill_threads > 0, plugin_config_exception,
+                     "bridge-backfill-threads ${num} must be greater than 0", ("num", my->backfill_threads) );
+
+         my->datadir = app().data_dir() / "bridge";
          if (options.at("delete-relay-history").as<bool>()) {
             // Todo, delete relay data
             ilog("delete relay data history. ${h}", ("h", my->datadir));
@@ -669,26 +2961,67 @@ namespace eosio {
 
          my->open_db();
 
-         my->chain_plug = app().find_plugin<chain_plugin>();
-         chain::controller &cc = my->chain_plug->chain();
-         cc.irreversible_block.connect(boost::bind(&bridge_plugin_impl::irreversible_block, my.get(), _1));
-         cc.apply_action_receipt.connect(boost::bind(&bridge_plugin_impl::apply_action_receipt, my.get(), _1));
+         my->chain_control = &cc;
+         auto on_irreversible = chain::timed_slot("irreversible_block", "bridge_plugin",
+               [my = my.get()](const chain::block_state_ptr &b) { my->irreversible_block(b); });
+         if (my->async_irreversible_block) {
+            // the receipts of a block are captured when it is applied, always before it becomes irreversible
+            cc.irreversible_block.connect(chain::async_slot(
+                  [](auto &&f) { app().post(priority::medium, std::move(f)); }, std::move(on_irreversible)));
+         } else {
+            cc.irreversible_block.connect(std::move(on_irreversible));
+         }
+         if (my->speculative_proofs) {
+            cc.accepted_block.connect(chain::timed_slot("accepted_block", "bridge_plugin",
+                  [my = my.get()](const chain::block_state_ptr &b) { my->accepted_block(b); }));
+         }
+         cc.applied_block_action_receipts.connect(chain::timed_slot("applied_block_action_receipts", "bridge_plugin",
+               boost::bind(&bridge_plugin_impl::applied_block_action_receipts, my.get(), _1)));
 
          // init timer tick
          my->change_schedule_timer = std::make_unique<boost::asio::steady_timer>(app().get_io_service());
          my->prove_action_timer = std::make_unique<boost::asio::steady_timer>(app().get_io_service());
+         my->health_check_timer = std::make_unique<boost::asio::steady_timer>(app().get_io_service());
+         my->redeem_timer = std::make_unique<boost::asio::steady_timer>(app().get_io_service());
 
       }
       FC_LOG_AND_RETHROW()
    }
 
+   bridge_metrics bridge_plugin::get_metrics() const {
+      return my->get_metrics();
+   }
+
+   bridge_get_proofs_results bridge_plugin::get_proofs(const bridge_get_proofs_params &params) {
+      return my->get_proofs(params);
+   }
+
    void bridge_plugin::plugin_startup() {
       // Make the magic happen
       ilog("bridge_plugin::plugin_startup.");
 
+      // before the timers start, so the backfilled entries are submitted with the live ones
+      if (my->backfill_enabled) my->backfill();
+
+      rpc_result *started = start_rpc_runtime(my->rpc_runtime_threads);
+      const bool runtime_started = started && started->success;
+      const string msg = (started && started->msg) ? string(started->msg) : string("null result from bifrost rpc");
+      free_rpc_result(started);
+      EOS_ASSERT( runtime_started, plugin_exception, "failed to start bifrost rpc runtime: ${m}", ("m", msg) );
+      my->health_check_thread.emplace( "bridgehc", 1 );
+
+      // connect to every bifrost endpoint once, later calls reuse these connections
+      my->check_rpc_pool(true);
+
+      if (my->redeem_enabled) {
+         my->recover_redeems();
+         my->subscribe_redeems();
+      }
+
       // start timer tick
       my->change_schedule_timer_tick();
       my->prove_action_timer_tick();
+      if (my->redeem_enabled) my->redeem_timer_tick();
    }
 
    void bridge_plugin::plugin_shutdown() {
@@ -697,6 +3030,14 @@ namespace eosio {
 
       my->in_shutdown = true;
 
+      if (my->change_schedule_timer) my->change_schedule_timer->cancel();
+      if (my->prove_action_timer) my->prove_action_timer->cancel();
+      if (my->health_check_timer) my->health_check_timer->cancel();
+      if (my->redeem_timer) my->redeem_timer->cancel();
+      // in flight submissions are dropped, entries still marked submitting will be submitted again after restart
+      stop_rpc_runtime();
+      if (my->health_check_thread) my->health_check_thread->stop();
+
       my->close_db();
    }
 }
@@ -9,6 +9,10 @@ namespace eosio {
 using namespace appbase;
 using namespace chain;
 
+struct bridge_metrics;
+struct bridge_get_proofs_params;
+struct bridge_get_proofs_results;
+
 class bridge_plugin : public appbase::plugin<bridge_plugin> {
 public:
    bridge_plugin();
@@ -18,29 +22,29 @@ public:
    virtual void set_program_options(options_description&, options_description& cfg) override;
 
    void plugin_initialize(const variables_map& options);
+   // relays the blocks of the given controller instead of the one of chain_plugin, used by the relay benchmark
+   void plugin_initialize(const variables_map& options, chain::controller& cc);
    void plugin_startup();
    void plugin_shutdown();
 
+   bridge_metrics get_metrics() const;
+   bridge_get_proofs_results get_proofs(const bridge_get_proofs_params& params);
+
 private:
    std::unique_ptr<class bridge_plugin_impl> my;
 };
 
-enum Status {
-   FailureOnVerification,
-   SuccessOnVerification,
-   UnderVerification,
-   AwaitVerification,
-};
-
-struct bridge_blocks {
-   block_id_type                             id;
-   block_state                               bls;
+// life cycle of a pending bridge_prove_action / bridge_change_schedule entry
+enum bridge_status : uint8_t {
+   collecting = 0, // still collecting the following blocks
+   ready      = 1, // all blocks are collected, waiting for submission
+   sent       = 2, // finalized, the extrinsic got finalized on bifrost
+   submitting = 3, // submitted, in flight on a submission thread awaiting finalization
 };
 
 struct bridge_change_schedule {
    uint32_t                                 block_num = 0; // the block has new producer schedule
    incremental_merkle                       imcre_merkle;
-   std::vector<block_state>                 bs;
    uint8_t                                  status = 0;
    digest_type                              legacy_schedule_hash;
    producer_authority_schedule              schedule;
@@ -50,12 +54,93 @@ struct bridge_prove_action {
    uint32_t                                 block_num = 0; // the block has transfer action
    action                                   act;
    action_receipt                           receipt;
-   std::vector<action_receipt>              act_receipts;
+   std::vector<block_id_type>               action_merkle_paths; // proof of receipt in the block's action_mroot
    block_id_type                            act_receipt_digest;
    incremental_merkle                       imcre_merkle;
-   std::vector<block_state>                 bs;
    uint8_t                                  status = 0;
    transaction_id_type                      trx_id;
+   uint32_t                                 receipt_index = 0; // leaf position of receipt in the block's action_mroot
+};
+
+// what the bridge keeps of an irreversible block: enough to prove it and the blocks before it, without the
+// transactions and schedules of its block_state
+struct bridge_header_record {
+   uint32_t                                 block_num = 0;
+   block_id_type                            id;
+   signed_block_header                      header;
+   incremental_merkle                       blockroot_merkle;
+   uint32_t                                 producer_count = 0; // of the schedule active for the block
+};
+
+// a prove action with the headers proving it, served by get_proofs and spilled to disk while it waits for a long retry
+struct bridge_proof {
+   bridge_prove_action                      entry;
+   std::vector<signed_block_header>         block_headers;
+   std::vector<std::vector<block_id_type>>  block_id_lists;
+};
+
+// latencies in buckets of exponentially growing width
+struct bridge_latency_histogram {
+   std::vector<uint64_t>                    bounds_ms; // upper bound of each bucket, counts has one more unbounded bucket
+   std::vector<uint64_t>                    counts;
+   uint64_t                                 count = 0;
+   uint64_t                                 sum_ms = 0;
+
+   bridge_latency_histogram();
+   void add(fc::microseconds latency);
+};
+
+struct bridge_status_counts {
+   uint32_t                                 collecting = 0;
+   uint32_t                                 ready = 0;
+   uint32_t                                 submitting = 0;
+   uint32_t                                 sent = 0;
+};
+
+// time spent by entries in each stage, recorded when they leave it
+struct bridge_stage_latencies {
+   bridge_latency_histogram                 capture_to_ready;
+   bridge_latency_histogram                 ready_to_submitted;
+   bridge_latency_histogram                 submitted_to_finalized; // until bifrost finalized the block including the extrinsic
+};
+
+struct bridge_metrics {
+   bridge_status_counts                     prove_actions;
+   bridge_status_counts                     change_schedules;
+   bridge_stage_latencies                   prove_action_latencies;
+   bridge_stage_latencies                   change_schedule_latencies;
+   bridge_latency_histogram                 ffi_call_latency; // duration of prove_action/change_schedule calls
+   uint64_t                                 prove_action_failures = 0;
+   uint64_t                                 change_schedule_failures = 0;
+   uint64_t                                 preflight_failures = 0; // proofs not submitted as they failed local verification
+   uint32_t                                 prove_action_backoffs = 0; // entries waiting for their retry
+   uint32_t                                 change_schedule_backoffs = 0;
+   uint32_t                                 in_flight = 0;
+   uint32_t                                 spilled_prove_actions = 0;
+   uint64_t                                 entry_bytes = 0; // packed size of the entries in memory
+   uint32_t                                 window_blocks = 0;
+   uint64_t                                 window_bytes = 0; // packed size of the blocks in the window
+   uint32_t                                 speculative_window_blocks = 0; // reversible blocks held for speculative proofs
+   uint32_t                                 detached_proofs = 0; // proofs of ready entries kept apart from the window
+   string                                   rpc_endpoints; // json status of the bifrost endpoints
+   uint32_t                                 queued_redeems = 0; // bifrost redeems waiting for their transaction
+   uint32_t                                 redeem_transactions = 0; // pushed, awaiting their irreversible receipt
+   uint64_t                                 completed_redeems = 0;
+   uint64_t                                 redeem_failures = 0;
+   bridge_latency_histogram                 redeem_latency; // from the redeem event to the irreversible receipt
+};
+
+// exactly one of trx_id and act_receipt_digest selects the entries
+struct bridge_get_proofs_params {
+   fc::optional<transaction_id_type>        trx_id;
+   fc::optional<digest_type>                act_receipt_digest;
+   bool                                     binary = false; // return the proofs packed in packed_proofs
+};
+
+// proofs of the entries whose headers are collected, entries still collecting or pruned from the window are left out
+struct bridge_get_proofs_results {
+   std::vector<bridge_proof>                proofs;
+   fc::optional<bytes>                      packed_proofs;
 };
 
 struct action_transfer {
@@ -67,7 +152,18 @@ struct action_transfer {
 
 }
 
-FC_REFLECT( eosio::bridge_blocks, (id)(bls) )
 FC_REFLECT( eosio::action_transfer, (from)(to)(quantity)(memo) )
-FC_REFLECT( eosio::bridge_change_schedule, (block_num)(bs)(status) )
-FC_REFLECT( eosio::bridge_prove_action, (block_num)(act)(receipt)(act_receipts)(act_receipt_digest)(imcre_merkle)(bs)(status) )
+FC_REFLECT( eosio::bridge_header_record, (block_num)(id)(header)(blockroot_merkle)(producer_count) )
+FC_REFLECT( eosio::bridge_proof, (entry)(block_headers)(block_id_lists) )
+FC_REFLECT( eosio::bridge_latency_histogram, (bounds_ms)(counts)(count)(sum_ms) )
+FC_REFLECT( eosio::bridge_status_counts, (collecting)(ready)(submitting)(sent) )
+FC_REFLECT( eosio::bridge_stage_latencies, (capture_to_ready)(ready_to_submitted)(submitted_to_finalized) )
+FC_REFLECT( eosio::bridge_metrics, (prove_actions)(change_schedules)(prove_action_latencies)(change_schedule_latencies)
+            (ffi_call_latency)(prove_action_failures)(change_schedule_failures)(preflight_failures)(prove_action_backoffs)
+            (change_schedule_backoffs)(in_flight)(spilled_prove_actions)(entry_bytes)(window_blocks)(window_bytes)
+            (speculative_window_blocks)(detached_proofs)(rpc_endpoints)(queued_redeems)(redeem_transactions)
+            (completed_redeems)(redeem_failures)(redeem_latency) )
+FC_REFLECT( eosio::bridge_get_proofs_params, (trx_id)(act_receipt_digest)(binary) )
+FC_REFLECT( eosio::bridge_get_proofs_results, (proofs)(packed_proofs) )
+FC_REFLECT( eosio::bridge_change_schedule, (block_num)(imcre_merkle)(status)(legacy_schedule_hash)(schedule) )
+FC_REFLECT( eosio::bridge_prove_action, (block_num)(act)(receipt)(action_merkle_paths)(act_receipt_digest)(imcre_merkle)(status)(trx_id)(receipt_index) )
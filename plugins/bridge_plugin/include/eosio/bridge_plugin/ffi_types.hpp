@@ -4,6 +4,12 @@
 #include <eosio/chain/producer_schedule.hpp>
 #include <eosio/chain/types.hpp>
 
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
 namespace eosio {
 
 using namespace appbase;
@@ -32,16 +38,87 @@ struct action_ffi {
 
 };
 
-struct block_id_type_list {
-   const block_id_type        *id;
-   size_t                     ids_size;
-   block_id_type_list() {
-      id = nullptr;
-      ids_size = 0;
+/**
+ * Owns the scratch memory of the ffi arguments of one submission, so they are freed together.
+ * Memory is handed out of chunks which are kept by reset(), an arena reused across submissions
+ * stops allocating once it has grown to the size of the largest submission.
+ * Destructors never run, so only trivially destructible types can be allocated.
+ */
+class ffi_arena {
+public:
+   explicit ffi_arena(size_t chunk_size = 64 * 1024) : chunk_size(chunk_size) {}
+   ffi_arena(const ffi_arena&) = delete;
+   ffi_arena& operator=(const ffi_arena&) = delete;
+
+   template<typename T>
+   T *alloc(size_t n = 1) {
+      static_assert(std::is_trivially_destructible<T>::value, "ffi_arena never runs destructors");
+      if (n == 0) return nullptr;
+      T *p = reinterpret_cast<T *>(allocate(sizeof(T) * n, alignof(T)));
+      for (size_t i = 0; i < n; ++i) new (p + i) T();
+      return p;
+   }
+
+   template<typename T, typename... Args>
+   T *emplace(Args&&... args) {
+      static_assert(std::is_trivially_destructible<T>::value, "ffi_arena never runs destructors");
+      return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+   }
+
+   const char *copy(const std::string &str) {
+      char *p = alloc<char>(str.size() + 1);
+      memcpy(p, str.data(), str.size());
+      p[str.size()] = '\0';
+      return p;
+   }
+
+   // release everything allocated so far but keep the chunks
+   void reset() {
+      current = 0;
+      offset = 0;
+   }
+
+   size_t capacity() const {
+      size_t total = 0;
+      for (const auto &c : chunks) total += c.size;
+      return total;
    }
+
+private:
+   struct chunk {
+      std::unique_ptr<char[]> data;
+      size_t                  size = 0;
+   };
+
+   void *allocate(size_t size, size_t align) {
+      while (true) {
+         if (current < chunks.size()) {
+            size_t aligned = (offset + align - 1) & ~(align - 1);
+            if (aligned + size <= chunks[current].size) {
+               offset = aligned + size;
+               return chunks[current].data.get() + aligned;
+            }
+            ++current;
+            offset = 0;
+            continue;
+         }
+         size_t n = std::max(chunk_size, size + align);
+         chunks.push_back(chunk{ std::unique_ptr<char[]>(new char[n]), n });
+      }
+   }
+
+   std::vector<chunk> chunks;
+   size_t             current = 0;
+   size_t             offset = 0;
+   size_t             chunk_size;
 };
 
-block_id_type_list convert_ffi(const std::vector<block_id_type> &ids) {
+struct block_id_type_list {
+   const block_id_type        *id = nullptr;
+   size_t                     ids_size = 0;
+};
+
+inline block_id_type_list convert_ffi(const std::vector<block_id_type> &ids) {
    block_id_type_list ids_ffi;
    ids_ffi.id = ids.data();
    ids_ffi.ids_size = ids.size();
@@ -49,13 +126,21 @@ block_id_type_list convert_ffi(const std::vector<block_id_type> &ids) {
    return ids_ffi;
 }
 
+inline block_id_type_list *convert_ffi(const std::vector<std::vector<block_id_type>> &id_lists, ffi_arena &arena) {
+   auto ids_ffi = arena.alloc<block_id_type_list>(id_lists.size());
+   for (size_t i = 0; i < id_lists.size(); ++i) {
+      ids_ffi[i] = convert_ffi(id_lists[i]);
+   }
+   return ids_ffi;
+}
+
 struct incremental_merkle_ffi {
    uint64_t                         _node_count;
    const block_id_type              *_active_nodes;
    size_t                           _active_nodes_size;
 };
 
-incremental_merkle_ffi convert_ffi(const incremental_merkle &im) {
+inline incremental_merkle_ffi convert_ffi(const incremental_merkle &im) {
    incremental_merkle_ffi im_ffi;
    im_ffi._node_count = im._node_count;
    im_ffi._active_nodes = im._active_nodes.data();
@@ -87,232 +172,159 @@ struct action_receipt_ffi {
    }
 };
 
+// one proof of a batched prove_action_batch call
+struct prove_action_item_ffi {
+   const action_ffi                *act;
+   const action_receipt_ffi        *act_receipt;
+   block_id_type_list              action_merkle_paths;
+   transaction_id_type             trx_id;
+};
+
 struct extension {
-   uint16_t                        _type;
-   const char                      *data;
-   size_t                          data_size;
+   uint16_t                        _type = 0;
+   const char                      *data = nullptr;
+   size_t                          data_size = 0;
 };
 
 struct extensions_type_ffi {
-   extension                       *extensions;
-   size_t                          extensions_size;
-   extensions_type_ffi() {
-      extensions_size = 0;
-      extensions = nullptr;
-   }
-   extensions_type_ffi(const extensions_type &exts) {
-      auto len = exts.size();
-      extensions_size = len;
-      if (len == 0) {
-         extensions = nullptr;
-      } else {
-         extensions = new extension[len];
-         for (size_t i = 0; i < len; ++i) {
-            auto e = std::get<1>(exts[i]);
-            auto t = std::get<0>(exts[i]);
-            auto ext = new extension { t, e.data(), e.size() };
-            extensions[i] = *ext;
-         }
-      }
-   }
-   ~extensions_type_ffi() {
-      if (extensions) delete []extensions;
-   }
+   const extension                 *extensions = nullptr;
+   size_t                          extensions_size = 0;
 };
 
-struct producer_key_ffi {
-   account_name                    producer_name;
-   const char                      *block_signing_key;
-   producer_key_ffi() {
-      block_signing_key = nullptr;
-      producer_name = account_name((uint64_t)0);
-   }
-   producer_key_ffi(const legacy::producer_key &pk) {
-      producer_name = pk.producer_name;
+// returns nullptr for no extensions
+inline extensions_type_ffi *convert_ffi(const extensions_type &exts, ffi_arena &arena) {
+   if (exts.empty()) return nullptr;
 
-      std::string sig = pk.block_signing_key.to_string();
-      block_signing_key = sig.c_str();
+   auto ext_ffi = arena.alloc<extension>(exts.size());
+   for (size_t i = 0; i < exts.size(); ++i) {
+      ext_ffi[i]._type = std::get<0>(exts[i]);
+      ext_ffi[i].data = std::get<1>(exts[i]).data();
+      ext_ffi[i].data_size = std::get<1>(exts[i]).size();
    }
+
+   auto exts_ffi = arena.alloc<extensions_type_ffi>();
+   exts_ffi->extensions = ext_ffi;
+   exts_ffi->extensions_size = exts.size();
+   return exts_ffi;
+}
+
+struct producer_key_ffi {
+   account_name                    producer_name;
+   const char                      *block_signing_key = nullptr;
 };
 
 struct producer_schedule_type_ffi {
    uint32_t                        version = 0;
-   producer_key_ffi                *producers;
+   const producer_key_ffi          *producers = nullptr;
    size_t                          producers_size = 0;
-   producer_schedule_type_ffi(const legacy::producer_schedule_type &ps) {
-      version = ps.version;
-      producers_size = ps.producers.size();
-      if (producers_size == 0) {
-         producers = nullptr;
-      } else {
-         producers = new producer_key_ffi[producers_size];
-         for (size_t i = 0; i < producers_size; ++i) {
-            producer_key_ffi p = producer_key_ffi(ps.producers[i]);
-            memcpy(&producers[i], &p, sizeof(p));
-         }
-      }
-   }
-   ~producer_schedule_type_ffi() {
-      if (producers) delete []producers;
-   }
 };
 
+inline producer_schedule_type_ffi *convert_ffi(const legacy::producer_schedule_type &ps, ffi_arena &arena) {
+   auto producers = arena.alloc<producer_key_ffi>(ps.producers.size());
+   for (size_t i = 0; i < ps.producers.size(); ++i) {
+      producers[i].producer_name = ps.producers[i].producer_name;
+      producers[i].block_signing_key = arena.copy(ps.producers[i].block_signing_key.to_string());
+   }
+
+   auto ps_ffi = arena.alloc<producer_schedule_type_ffi>();
+   ps_ffi->version = ps.version;
+   ps_ffi->producers = producers;
+   ps_ffi->producers_size = ps.producers.size();
+   return ps_ffi;
+}
+
 struct block_header_ffi {
    block_timestamp_type             timestamp;
    account_name                     producer;
    uint16_t                         confirmed = 1;
-   const char                       *previous;
-   const char                       *transaction_mroot;
-   const char                       *action_mroot;
+   const char                       *previous = nullptr;
+   const char                       *transaction_mroot = nullptr;
+   const char                       *action_mroot = nullptr;
    uint32_t                         schedule_version = 0;
-   producer_schedule_type_ffi       *new_producers;
-   extensions_type_ffi              *header_extensions;
-   ~block_header_ffi() {
-      if (new_producers) delete new_producers;
-      if (header_extensions) delete []header_extensions;
-   }
+   const producer_schedule_type_ffi *new_producers = nullptr;
+   const extensions_type_ffi        *header_extensions = nullptr;
 };
 
 struct signed_block_header_ffi {
-   block_header_ffi                 *block_header;
-   char                             *producer_signature;
-   signed_block_header_ffi() {
-      block_header = nullptr;
-      producer_signature = nullptr;
-   }
-   signed_block_header_ffi(const signed_block_header &header) {
-      block_header_ffi header_ffi;
-      header_ffi.timestamp = header.timestamp;
-      header_ffi.producer = header.producer;
-      header_ffi.confirmed = header.confirmed;
-      header_ffi.previous = header.previous.data();
-      header_ffi.transaction_mroot = header.transaction_mroot.data();
-      header_ffi.action_mroot = header.action_mroot.data();
-      header_ffi.schedule_version = header.schedule_version;
-
-      if (header.new_producers) {
-         auto h = producer_schedule_type_ffi(*(header.new_producers));
-         header_ffi.new_producers->version = h.version;
-         header_ffi.new_producers->producers = h.producers;
-         header_ffi.new_producers->producers_size = h.producers_size;
-      } else {
-         header_ffi.new_producers = nullptr;
-      }
-
-      auto e = extensions_type_ffi(header.header_extensions);
-      if (e.extensions_size == 0) {
-         header_ffi.header_extensions = nullptr;
-      } else {
-         header_ffi.header_extensions = new extensions_type_ffi[e.extensions_size];
-         header_ffi.header_extensions->extensions = e.extensions;
-         header_ffi.header_extensions->extensions_size = e.extensions_size;
-      }
+   const block_header_ffi           *block_header = nullptr;
+   const char                       *producer_signature = nullptr;
+};
 
-      std::string sig = header.producer_signature.to_string();
-      producer_signature = new char[sig.size() + 1];
-      strcpy(producer_signature, sig.c_str());
+// the result points into header, which has to outlive it
+inline void convert_ffi(const signed_block_header &header, signed_block_header_ffi &header_ffi, ffi_arena &arena) {
+   auto bh = arena.alloc<block_header_ffi>();
+   bh->timestamp = header.timestamp;
+   bh->producer = header.producer;
+   bh->confirmed = header.confirmed;
+   bh->previous = header.previous.data();
+   bh->transaction_mroot = header.transaction_mroot.data();
+   bh->action_mroot = header.action_mroot.data();
+   bh->schedule_version = header.schedule_version;
+   bh->new_producers = header.new_producers ? convert_ffi(*header.new_producers, arena) : nullptr;
+   bh->header_extensions = convert_ffi(header.header_extensions, arena);
+
+   header_ffi.block_header = bh;
+   header_ffi.producer_signature = arena.copy(header.producer_signature.to_string());
+}
 
-      block_header = new block_header_ffi();
-      memcpy(block_header, &header_ffi, sizeof(header_ffi));
-   }
-   ~signed_block_header_ffi() {
-      if (block_header) delete block_header;
-      if (producer_signature) delete []producer_signature;
+inline signed_block_header_ffi *convert_ffi(const std::vector<signed_block_header> &headers, ffi_arena &arena) {
+   auto headers_ffi = arena.alloc<signed_block_header_ffi>(headers.size());
+   for (size_t i = 0; i < headers.size(); ++i) {
+      convert_ffi(headers[i], headers_ffi[i], arena);
    }
-};
+   return headers_ffi;
+}
 
 struct key_weight_ffi {
-   char                            *key;
-   uint16_t                        weight;
-   key_weight_ffi() {
-      weight = 0;
-      key = nullptr;
-   }
-   key_weight_ffi(const key_weight &kw) {
-      weight = kw.weight;
-      std::string sig = kw.key.to_string();
-      key = new char[sig.size() + 1];
-      strcpy(key, sig.c_str());
-   }
-   ~key_weight_ffi() {
-      if (key) delete []key;
-   }
+   const char                      *key = nullptr;
+   uint16_t                        weight = 0;
 };
 
 struct block_signing_authority_v0_ffi {
-   uint32_t threshold;
-   key_weight_ffi *keys;
-   size_t keys_size;
-
-   block_signing_authority_v0_ffi() {
-      threshold = 0;
-      keys = nullptr;
-      keys_size = 0;
-   }
-
-   block_signing_authority_v0_ffi(const block_signing_authority_v0 &v0) {
-      threshold = v0.threshold;
-      keys_size = v0.keys.size();
-      keys = new key_weight_ffi[keys_size];
-      for (size_t i = 0; i < keys_size; ++i) {
-         key_weight_ffi ffi = key_weight_ffi(v0.keys[i]);
-         memcpy(&keys[i], &ffi, sizeof(ffi));
-      }
-   }
-
-   ~block_signing_authority_v0_ffi() {
-      if (keys) delete []keys;
-   }
+   uint32_t                        threshold = 0;
+   const key_weight_ffi            *keys = nullptr;
+   size_t                          keys_size = 0;
 };
 
 struct producer_authority_ffi {
-   account_name producer_name;
-   int tag;
-   block_signing_authority_v0_ffi *v0_ffi;
-
-   producer_authority_ffi() {
-      producer_name = account_name((uint64_t)0);
-      tag = 0;
-      v0_ffi = nullptr;
-   }
-
-   producer_authority_ffi(producer_authority authority) {
-      producer_name = authority.producer_name;
-
-      tag = authority.authority.which();
-      auto v0 = authority.authority.get<block_signing_authority_v0>();
-      v0_ffi = new block_signing_authority_v0_ffi(v0);
-   }
-
-   ~producer_authority_ffi() {
-      if (v0_ffi) delete v0_ffi;
-   }
+   account_name                    producer_name;
+   int                             tag = 0;
+   const block_signing_authority_v0_ffi *v0_ffi = nullptr;
 };
 
 struct producer_authority_schedule_ffi {
-   int version;
-   producer_authority_ffi *producers_ffi;
-   size_t producers_size;
-
-   producer_authority_schedule_ffi() {
-      version = 0;
-      producers_size = 0;
-      producers_ffi = nullptr;
-   }
+   int                             version = 0;
+   const producer_authority_ffi    *producers_ffi = nullptr;
+   size_t                          producers_size = 0;
+};
+
+inline producer_authority_schedule_ffi *convert_ffi(const producer_authority_schedule &schedule, ffi_arena &arena) {
+   auto producers = arena.alloc<producer_authority_ffi>(schedule.producers.size());
+   for (size_t i = 0; i < schedule.producers.size(); ++i) {
+      const auto &authority = schedule.producers[i];
+      const auto &v0 = authority.authority.get<block_signing_authority_v0>();
 
-   producer_authority_schedule_ffi(const producer_authority_schedule &schedule) {
-      version = schedule.version;
-      producers_size = schedule.producers.size();
-      producers_ffi = new producer_authority_ffi[producers_size];
-      for (size_t i = 0; i < producers_size; ++i) {
-         auto ffi = producer_authority_ffi(schedule.producers[i]);
-         memcpy(&producers_ffi[i], &ffi, sizeof(ffi));
+      auto keys = arena.alloc<key_weight_ffi>(v0.keys.size());
+      for (size_t k = 0; k < v0.keys.size(); ++k) {
+         keys[k].key = arena.copy(v0.keys[k].key.to_string());
+         keys[k].weight = v0.keys[k].weight;
       }
-   }
 
-   ~producer_authority_schedule_ffi() {
-      if (producers_ffi) delete []producers_ffi;
+      auto v0_ffi = arena.alloc<block_signing_authority_v0_ffi>();
+      v0_ffi->threshold = v0.threshold;
+      v0_ffi->keys = keys;
+      v0_ffi->keys_size = v0.keys.size();
+
+      producers[i].producer_name = authority.producer_name;
+      producers[i].tag = authority.authority.which();
+      producers[i].v0_ffi = v0_ffi;
    }
-};
+
+   auto schedule_ffi = arena.alloc<producer_authority_schedule_ffi>();
+   schedule_ffi->version = schedule.version;
+   schedule_ffi->producers_ffi = producers;
+   schedule_ffi->producers_size = schedule.producers.size();
+   return schedule_ffi;
+}
 
 }
@@ -1,7 +1,13 @@
 #include <eosio/chain_api_plugin/chain_api_plugin.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/json_parser.hpp>
+#include <eosio/chain/thread_utils.hpp>
 
 #include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/io/raw_variant.hpp>
+
+#include <shared_mutex>
 
 namespace eosio {
 
@@ -15,14 +21,28 @@ public:
       : db(db) {}
 
    controller& db;
+   // runs the calls that only read the chain state off the main thread, while holding the state lock shared
+   fc::optional<eosio::chain::named_thread_pool> read_only_api_thread_pool;
 };
 
 
 chain_api_plugin::chain_api_plugin(){}
 chain_api_plugin::~chain_api_plugin(){}
 
-void chain_api_plugin::set_program_options(options_description&, options_description&) {}
-void chain_api_plugin::plugin_initialize(const variables_map&) {}
+void chain_api_plugin::set_program_options(options_description&, options_description& cfg) {
+   cfg.add_options()
+         ("read-only-api-threads", bpo::value<uint16_t>()->default_value(0),
+          "Number of worker threads executing the chain API calls that only read the contract and account state (get_table_rows, get_account, ...). "
+          "These calls then no longer run on the main thread and only block it while it changes the state. 0 runs them on the main thread.")
+         ;
+}
+
+void chain_api_plugin::plugin_initialize(const variables_map& options) {
+   my.reset(new chain_api_plugin_impl(app().get_plugin<chain_plugin>().chain()));
+   auto threads = options.at( "read-only-api-threads" ).as<uint16_t>();
+   if( threads > 0 )
+      my->read_only_api_thread_pool.emplace( "roapi", threads );
+}
 
 struct async_result_visitor : public fc::visitor<fc::variant> {
    template<typename T>
@@ -40,22 +60,46 @@ namespace {
 
       try {
         try {
-           return fc::json::from_string(body).as<T>();
+           return chain::json_parser::from_string(body).as<T>();
         } catch (const chain::chain_exception& e) { // EOS_RETHROW_EXCEPTIONS does not re-type these so, re-code it
           throw fc::exception(e);
         }
       } EOS_RETHROW_EXCEPTIONS(chain::invalid_http_request, "Unable to parse valid input from POST body");
    }
+
+   // packed straight into the response body
+   template<typename T>
+   std::string pack_response(const T& result) {
+      std::string packed( fc::raw::pack_size( result ), '\0' );
+      fc::datastream<char*> ds( &packed[0], packed.size() );
+      fc::raw::pack( ds, result );
+      return packed;
+   }
+
+   template<typename T>
+   std::string pack_response(const std::shared_ptr<T>& result) {
+      return pack_response( *result );
+   }
 }
 
+// the result is converted to a variant on an http thread, only the call itself runs on the main thread
+#define RESPOND_ON_HTTP_THREAD(api_name, call_name, http_response_code, result) \
+   http.post_http_thread_pool( [cb, body=std::move(body), result=std::move(result)]() mutable { \
+      try { \
+         cb(http_response_code, fc::variant( std::move(result) )); \
+      } catch (...) { \
+         http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+      } \
+   })
+
 #define CALL(api_name, api_handle, api_namespace, call_name, http_response_code) \
 {std::string("/v1/" #api_name "/" #call_name), \
-   [api_handle](string, string body, url_response_callback cb) mutable { \
+   [api_handle, &http=_http_plugin](string, string body, url_response_callback cb) mutable { \
           api_handle.validate(); \
           try { \
              if (body.empty()) body = "{}"; \
-             fc::variant result( api_handle.call_name(fc::json::from_string(body).as<api_namespace::call_name ## _params>()) ); \
-             cb(http_response_code, std::move(result)); \
+             auto result = api_handle.call_name(chain::json_parser::from_string(body).as<api_namespace::call_name ## _params>()); \
+             RESPOND_ON_HTTP_THREAD(api_name, call_name, http_response_code, result); \
           } catch (...) { \
              http_plugin::handle_exception(#api_name, #call_name, body, cb); \
           } \
@@ -63,12 +107,12 @@ namespace {
 
 #define CALL_WITH_400(api_name, api_handle, api_namespace, call_name, http_response_code) \
 {std::string("/v1/" #api_name "/" #call_name), \
-   [api_handle](string, string body, url_response_callback cb) mutable { \
+   [api_handle, &http=_http_plugin](string, string body, url_response_callback cb) mutable { \
           api_handle.validate(); \
           try { \
              auto params = parse_params<api_namespace::call_name ## _params>(body);\
-             fc::variant result( api_handle.call_name( std::move(params) ) ); \
-             cb(http_response_code, std::move(result)); \
+             auto result = api_handle.call_name( std::move(params) ); \
+             RESPOND_ON_HTTP_THREAD(api_name, call_name, http_response_code, result); \
           } catch (...) { \
              http_plugin::handle_exception(#api_name, #call_name, body, cb); \
           } \
@@ -79,7 +123,7 @@ namespace {
    [api_handle](string, string body, url_response_callback cb) mutable { \
       if (body.empty()) body = "{}"; \
       api_handle.validate(); \
-      api_handle.call_name(fc::json::from_string(body).as<api_namespace::call_name ## _params>(),\
+      api_handle.call_name(chain::json_parser::from_string(body).as<api_namespace::call_name ## _params>(),\
          [cb, body](const fc::static_variant<fc::exception_ptr, call_result>& result){\
             if (result.contains<fc::exception_ptr>()) {\
                try {\
@@ -94,16 +138,135 @@ namespace {
    }\
 }
 
+// executes the call on the read-only api thread pool, holding the state lock shared for the duration of the call
+#define CALL_ON_READ_ONLY_THREAD(api_name, api_handle, api_namespace, call_name, http_response_code) \
+{std::string("/v1/" #api_name "/" #call_name), \
+   [api_handle, &pool=*my->read_only_api_thread_pool, &state_lock=my->db.get_state_lock()](string, string body, url_response_callback cb) mutable { \
+      boost::asio::post( pool.get_executor(), [api_handle, &state_lock, body{std::move(body)}, cb{std::move(cb)}]() mutable { \
+          try { \
+             api_handle.validate(); \
+             if (body.empty()) body = "{}"; \
+             auto params = chain::json_parser::from_string(body).as<api_namespace::call_name ## _params>(); \
+             std::shared_lock<eosio::chain::shared_state_lock> g( state_lock ); \
+             auto result = api_handle.call_name( std::move(params) ); \
+             g.unlock(); \
+             cb(http_response_code, fc::variant( std::move(result) )); \
+          } catch (...) { \
+             http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+          } \
+      }); \
+   }}
+
+// for requests accepting application/octet-stream, the result of method is packed with fc::raw on an http thread
+#define BINARY_CALL(api_name, api_handle, api_namespace, call_name, method, http_response_code) \
+{std::string("/v1/" #api_name "/" #call_name), \
+   [api_handle, &http=_http_plugin](string, string body, url_response_callback cb, url_binary_response_callback binary_cb) mutable { \
+          api_handle.validate(); \
+          try { \
+             if (body.empty()) body = "{}"; \
+             auto result = api_handle.method(chain::json_parser::from_string(body).as<api_namespace::call_name ## _params>()); \
+             http.post_http_thread_pool( [cb, binary_cb, body=std::move(body), result=std::move(result)]() mutable { \
+                try { \
+                   binary_cb(http_response_code, pack_response( result )); \
+                } catch (...) { \
+                   http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+                } \
+             }); \
+          } catch (...) { \
+             http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+          } \
+       }}
+
+#define BINARY_CALL_ON_READ_ONLY_THREAD(api_name, api_handle, api_namespace, call_name, http_response_code) \
+{std::string("/v1/" #api_name "/" #call_name), \
+   [api_handle, &pool=*my->read_only_api_thread_pool, &state_lock=my->db.get_state_lock()](string, string body, url_response_callback cb, url_binary_response_callback binary_cb) mutable { \
+      boost::asio::post( pool.get_executor(), [api_handle, &state_lock, body{std::move(body)}, cb{std::move(cb)}, binary_cb{std::move(binary_cb)}]() mutable { \
+          try { \
+             api_handle.validate(); \
+             if (body.empty()) body = "{}"; \
+             auto params = chain::json_parser::from_string(body).as<api_namespace::call_name ## _params>(); \
+             std::shared_lock<eosio::chain::shared_state_lock> g( state_lock ); \
+             auto result = api_handle.call_name( std::move(params) ); \
+             g.unlock(); \
+             binary_cb(http_response_code, pack_response( result )); \
+          } catch (...) { \
+             http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+          } \
+      }); \
+   }}
+
+// binary packed transactions are unpacked on the http thread, the main thread only hands them to the producer
+#define PUSH_PACKED_CALL(call_name, batch) \
+{std::string("/v1/chain/" #call_name), \
+   [rw_api](string, string body, url_response_callback cb) mutable { \
+      try { \
+         auto trxs = chain_apis::read_write::unpack_packed_transactions( body, batch ); \
+         app().post( appbase::priority::medium_low, [rw_api, trxs{std::move(trxs)}, cb{std::move(cb)}]() mutable { \
+            try { \
+               rw_api.validate(); \
+               rw_api.push_packed_transactions( std::move(trxs), \
+                  [cb](const fc::static_variant<fc::exception_ptr, chain_apis::read_write::push_packed_transactions_results>& result) { \
+                     if (result.contains<fc::exception_ptr>()) { \
+                        try { \
+                           result.get<fc::exception_ptr>()->dynamic_rethrow_exception(); \
+                        } catch (...) { \
+                           http_plugin::handle_exception("chain", #call_name, "", cb); \
+                        } \
+                     } else if (batch) { \
+                        cb(202, fc::variant(result.get<chain_apis::read_write::push_packed_transactions_results>())); \
+                     } else { \
+                        cb(202, fc::variant(result.get<chain_apis::read_write::push_packed_transactions_results>().at(0))); \
+                     } \
+                  }); \
+            } catch (...) { \
+               http_plugin::handle_exception("chain", #call_name, "", cb); \
+            } \
+         }); \
+      } catch (...) { \
+         http_plugin::handle_exception("chain", #call_name, "", cb); \
+      } \
+   }}
+
 #define CHAIN_RO_CALL(call_name, http_response_code) CALL(chain, ro_api, chain_apis::read_only, call_name, http_response_code)
 #define CHAIN_RW_CALL(call_name, http_response_code) CALL(chain, rw_api, chain_apis::read_write, call_name, http_response_code)
 #define CHAIN_RO_CALL_ASYNC(call_name, call_result, http_response_code) CALL_ASYNC(chain, ro_api, chain_apis::read_only, call_name, call_result, http_response_code)
 #define CHAIN_RW_CALL_ASYNC(call_name, call_result, http_response_code) CALL_ASYNC(chain, rw_api, chain_apis::read_write, call_name, call_result, http_response_code)
 
 #define CHAIN_RO_CALL_WITH_400(call_name, http_response_code) CALL_WITH_400(chain, ro_api, chain_apis::read_only, call_name, http_response_code)
+#define CHAIN_RO_CALL_ON_READ_ONLY_THREAD(call_name, http_response_code) CALL_ON_READ_ONLY_THREAD(chain, ro_api, chain_apis::read_only, call_name, http_response_code)
+
+#define CHAIN_RO_BINARY_CALL(call_name, http_response_code) BINARY_CALL(chain, ro_api, chain_apis::read_only, call_name, call_name, http_response_code)
+#define CHAIN_RO_BINARY_CALL_ON_READ_ONLY_THREAD(call_name, http_response_code) BINARY_CALL_ON_READ_ONLY_THREAD(chain, ro_api, chain_apis::read_only, call_name, http_response_code)
+
+// calls that read nothing but the chain state, get_block & co. read the block log which is not safe for concurrent use
+#define CHAIN_STATE_CALLS(CALL_MACRO) \
+      CALL_MACRO(get_account, 200), \
+      CALL_MACRO(get_code, 200), \
+      CALL_MACRO(get_code_hash, 200), \
+      CALL_MACRO(get_abi, 200), \
+      CALL_MACRO(get_raw_code_and_abi, 200), \
+      CALL_MACRO(get_raw_abi, 200), \
+      CALL_MACRO(get_table_rows, 200), \
+      CALL_MACRO(get_table_rows_batch, 200), \
+      CALL_MACRO(get_table_by_scope, 200), \
+      CALL_MACRO(get_currency_balance, 200), \
+      CALL_MACRO(get_currency_stats, 200), \
+      CALL_MACRO(get_producers, 200), \
+      CALL_MACRO(get_producer_schedule, 200), \
+      CALL_MACRO(get_scheduled_transactions, 200), \
+      CALL_MACRO(abi_json_to_bin, 200), \
+      CALL_MACRO(abi_bin_to_json, 200), \
+      CALL_MACRO(get_required_keys, 200)
+
+// the state calls which also answer requests accepting application/octet-stream
+#define CHAIN_STATE_BINARY_CALLS(CALL_MACRO) \
+      CALL_MACRO(get_account, 200), \
+      CALL_MACRO(get_table_rows, 200), \
+      CALL_MACRO(get_table_rows_batch, 200), \
+      CALL_MACRO(get_currency_balance, 200)
 
 void chain_api_plugin::plugin_startup() {
    ilog( "starting chain_api_plugin" );
-   my.reset(new chain_api_plugin_impl(app().get_plugin<chain_plugin>().chain()));
    auto& chain = app().get_plugin<chain_plugin>();
    auto ro_api = chain.get_read_only_api();
    auto rw_api = chain.get_read_write_api();
@@ -117,36 +280,60 @@ void chain_api_plugin::plugin_startup() {
       CHAIN_RO_CALL(get_activated_protocol_features, 200),
       CHAIN_RO_CALL(get_block, 200),
       CHAIN_RO_CALL(get_block_header_state, 200),
-      CHAIN_RO_CALL(get_account, 200),
-      CHAIN_RO_CALL(get_code, 200),
-      CHAIN_RO_CALL(get_code_hash, 200),
-      CHAIN_RO_CALL(get_abi, 200),
-      CHAIN_RO_CALL(get_raw_code_and_abi, 200),
-      CHAIN_RO_CALL(get_raw_abi, 200),
-      CHAIN_RO_CALL(get_table_rows, 200),
-      CHAIN_RO_CALL(get_table_by_scope, 200),
-      CHAIN_RO_CALL(get_currency_balance, 200),
-      CHAIN_RO_CALL(get_currency_stats, 200),
-      CHAIN_RO_CALL(get_producers, 200),
-      CHAIN_RO_CALL(get_producer_schedule, 200),
-      CHAIN_RO_CALL(get_scheduled_transactions, 200),
-      CHAIN_RO_CALL(abi_json_to_bin, 200),
-      CHAIN_RO_CALL(abi_bin_to_json, 200),
-      CHAIN_RO_CALL(get_required_keys, 200),
       CHAIN_RO_CALL(get_transaction_id, 200),
+      CHAIN_RO_CALL(get_eosvmoc_metrics, 200),
       CHAIN_RW_CALL_ASYNC(push_block, chain_apis::read_write::push_block_results, 202),
       CHAIN_RW_CALL_ASYNC(push_transaction, chain_apis::read_write::push_transaction_results, 202),
       CHAIN_RW_CALL_ASYNC(push_transactions, chain_apis::read_write::push_transactions_results, 202),
-      CHAIN_RW_CALL_ASYNC(send_transaction, chain_apis::read_write::send_transaction_results, 202)
+      CHAIN_RW_CALL_ASYNC(send_transaction, chain_apis::read_write::send_transaction_results, 202),
+      CHAIN_RW_CALL_ASYNC(dry_run_transaction, chain_apis::read_write::dry_run_transaction_results, 202)
+   });
+
+   _http_plugin.add_binary_api({
+      CHAIN_RO_BINARY_CALL(get_info, 200)}, appbase::priority::medium_high);
+   _http_plugin.add_binary_api({
+      // the block as stored, not decoded with the ABIs
+      BINARY_CALL(chain, ro_api, chain_apis::read_only, get_block, get_raw_block, 200)
+   });
+
+   _http_plugin.add_async_api({
+      PUSH_PACKED_CALL(push_packed_transaction, false),
+      PUSH_PACKED_CALL(push_packed_transactions, true)
    });
 
+   if( my->read_only_api_thread_pool ) {
+      _http_plugin.add_async_api({
+         CHAIN_STATE_CALLS(CHAIN_RO_CALL_ON_READ_ONLY_THREAD)
+      });
+      _http_plugin.add_async_binary_api({
+         CHAIN_STATE_BINARY_CALLS(CHAIN_RO_BINARY_CALL_ON_READ_ONLY_THREAD)
+      });
+   } else {
+      _http_plugin.add_api({
+         CHAIN_STATE_CALLS(CHAIN_RO_CALL)
+      });
+      _http_plugin.add_binary_api({
+         CHAIN_STATE_BINARY_CALLS(CHAIN_RO_BINARY_CALL)
+      });
+   }
+
    if (chain.account_queries_enabled()) {
       _http_plugin.add_async_api({
          CHAIN_RO_CALL_WITH_400(get_accounts_by_authorizers, 200),
       });
    }
+
+   // the index is not thread safe, served on the main thread
+   if (chain.account_tokens_enabled()) {
+      _http_plugin.add_api({
+         CHAIN_RO_CALL(get_account_tokens, 200)
+      });
+   }
 }
 
-void chain_api_plugin::plugin_shutdown() {}
+void chain_api_plugin::plugin_shutdown() {
+   if( my && my->read_only_api_thread_pool )
+      my->read_only_api_thread_pool->stop();
+}
 
 }
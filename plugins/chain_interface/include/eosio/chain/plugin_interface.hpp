@@ -46,6 +46,8 @@ namespace eosio { namespace chain { namespace plugin_interface {
          // synchronously push a block/trx to a single provider
          using block_sync            = method_decl<chain_plugin_interface, bool(const signed_block_ptr&, const std::optional<block_id_type>&), first_provider_policy>;
          using transaction_async     = method_decl<chain_plugin_interface, void(const packed_transaction_ptr&, bool, next_function<transaction_trace_ptr>), first_provider_policy>;
+         // deadline of a transaction executed now in the pending block, within max-transaction-time and the block deadline
+         using transaction_deadline  = method_decl<chain_plugin_interface, fc::time_point(), first_provider_policy>;
       }
    }
 
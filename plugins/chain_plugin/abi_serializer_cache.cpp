@@ -0,0 +1,65 @@
+#include <eosio/chain_plugin/abi_serializer_cache.hpp>
+
+#include <eosio/chain/account_object.hpp>
+#include <eosio/chain/controller.hpp>
+
+namespace eosio::chain_apis {
+
+cached_abi::cached_abi( chain::abi_def abi, bool has_abi, const chain::abi_version& version )
+: abi( std::move(abi) ), has_abi( has_abi ), version( version ) {}
+
+const chain::abi_serializer& cached_abi::get_serializer( const chain::abi_serializer::yield_function_t& yield ) const {
+   std::call_once( _serializer_once, [&]() {
+      _serializer.emplace( abi, yield );
+   } );
+   return *_serializer;
+}
+
+abi_serializer_cache::abi_serializer_cache( size_t max_size )
+: _max_size( max_size ) {}
+
+cached_abi_ptr abi_serializer_cache::get( const chain::controller& db, chain::account_name account ) {
+   const auto& d = db.db();
+   const auto* accnt = d.find<chain::account_object, chain::by_name>( account );
+   if( accnt == nullptr )
+      return cached_abi_ptr();
+   const auto& metadata = d.get<chain::account_metadata_object, chain::by_name>( account );
+   const auto abi_hash = fc::sha256::hash( accnt->abi.data(), accnt->abi.size() );
+
+   {
+      std::lock_guard<std::mutex> g( _mtx );
+      auto itr = _by_account.find( account );
+      if( itr != _by_account.end() ) {
+         if( itr->second->abi_sequence == metadata.abi_sequence && itr->second->abi_hash == abi_hash ) {
+            _lru.splice( _lru.begin(), _lru, itr->second );
+            return itr->second->abi;
+         }
+         _lru.erase( itr->second );
+         _by_account.erase( itr );
+      }
+   }
+
+   chain::abi_def abi;
+   bool has_abi = chain::abi_serializer::to_abi( accnt->abi, abi );
+   auto result = std::make_shared<const cached_abi>( std::move(abi), has_abi, chain::abi_version{ metadata.abi_sequence, abi_hash } );
+   if( _max_size == 0 )
+      return result;
+
+   std::lock_guard<std::mutex> g( _mtx );
+   if( _by_account.count( account ) == 0 ) { // another thread may have added it meanwhile
+      _lru.push_front( entry{ account, metadata.abi_sequence, abi_hash, result } );
+      _by_account.emplace( account, _lru.begin() );
+      if( _lru.size() > _max_size ) {
+         _by_account.erase( _lru.back().account );
+         _lru.pop_back();
+      }
+   }
+   return result;
+}
+
+size_t abi_serializer_cache::size() const {
+   std::lock_guard<std::mutex> g( _mtx );
+   return _lru.size();
+}
+
+} // namespace eosio::chain_apis
@@ -128,6 +128,8 @@ namespace eosio::chain_apis {
     * Implementation details of the account query DB
     */
    struct account_query_db_impl {
+      using key_id_t = uint32_t; ///< index of an interned key
+
       account_query_db_impl(const chain::controller& controller)
       :controller(controller)
       {}
@@ -164,8 +166,39 @@ namespace eosio::chain_apis {
 
          // for each key, add this permission info's non-owning reference to the bimap for keys
          for (const auto& k: po.auth.keys) {
-            chain::public_key_type key = k.key;
-            key_bimap.insert(key_bimap_t::value_type {{std::move(key), k.weight}, pi});
+            key_bimap.insert(key_bimap_t::value_type {{intern_key(k.key), k.weight}, pi});
+         }
+      }
+
+      /**
+       * Id of a key, shared by all permissions using that key
+       */
+      key_id_t intern_key( const chain::public_key_type& key ) {
+         auto itr = key_ids.find(key);
+         if (itr != key_ids.end()) {
+            ++key_refs[itr->second];
+            return itr->second;
+         }
+
+         key_id_t id;
+         if (!free_key_ids.empty()) {
+            id = free_key_ids.back();
+            free_key_ids.pop_back();
+         } else {
+            id = interned_keys.size();
+            interned_keys.emplace_back();
+            key_refs.push_back(0);
+         }
+         interned_keys[id] = key_ids.emplace(key, id).first;
+         key_refs[id] = 1;
+         return id;
+      }
+
+      void release_key( key_id_t id ) {
+         if (--key_refs[id] == 0) {
+            key_ids.erase(interned_keys[id]);
+            interned_keys[id] = key_ids.end();
+            free_key_ids.push_back(id);
          }
       }
 
@@ -180,6 +213,9 @@ namespace eosio::chain_apis {
 
          // remove all entries from the key bimap that refer to this permission_info's reference
          const auto key_range = key_bimap.right.equal_range(pi);
+         for (auto itr = key_range.first; itr != key_range.second; ++itr) {
+            release_key(itr->second.value);
+         }
          key_bimap.right.erase(key_range.first, key_range.second);
       }
 
@@ -378,12 +414,11 @@ namespace eosio::chain_apis {
          const auto key_set = std::set<chain::public_key_type>(args.keys.begin(), args.keys.end());
 
          /**
-          * Add a range of results
+          * Add a range of results, all authorized by authorizer
           */
-         auto push_results = [&result](const auto& begin, const auto& end) {
+         auto push_results = [&result](const auto& begin, const auto& end, const auto& authorizer) {
             for (auto itr = begin; itr != end; ++itr) {
                const auto& pi = itr->second.get();
-               const auto& authorizer = itr->first.value;
                auto weight = itr->first.weight;
 
                result.accounts.emplace_back(result_t::account_result{
@@ -406,21 +441,32 @@ namespace eosio::chain_apis {
                const auto begin = name_bimap.left.lower_bound(weighted<chain::permission_level>::lower_bound_for({a.actor, a.permission}));
                const auto next_account_name = chain::name(a.actor.to_uint64_t() + 1);
                const auto end = name_bimap.left.lower_bound(weighted<chain::permission_level>::lower_bound_for({next_account_name, a.permission}));
-               push_results(begin, end);
+               for (auto itr = begin; itr != end;) {
+                  // one range per permission of the account
+                  const auto authorizer = itr->first.value;
+                  const auto next = name_bimap.left.upper_bound(weighted<chain::permission_level>::upper_bound_for(authorizer));
+                  push_results(itr, next, authorizer);
+                  itr = next;
+               }
             } else {
                // construct a range of all possible weights for an account/permission pair
                const auto p = chain::permission_level{a.actor, a.permission};
                const auto begin = name_bimap.left.lower_bound(weighted<chain::permission_level>::lower_bound_for(p));
                const auto end = name_bimap.left.upper_bound(weighted<chain::permission_level>::upper_bound_for(p));
-               push_results(begin, end);
+               push_results(begin, end, p);
             }
          }
 
          for (const auto& k: key_set) {
+            const auto id_itr = key_ids.find(k);
+            if (id_itr == key_ids.end()) {
+               continue;
+            }
+
             // construct a range of all possible weights for a key
-            const auto begin = key_bimap.left.lower_bound(weighted<chain::public_key_type>::lower_bound_for(k));
-            const auto end = key_bimap.left.upper_bound(weighted<chain::public_key_type>::upper_bound_for(k));
-            push_results(begin, end);
+            const auto begin = key_bimap.left.lower_bound(weighted<key_id_t>::lower_bound_for(id_itr->second));
+            const auto end = key_bimap.left.upper_bound(weighted<key_id_t>::upper_bound_for(id_itr->second));
+            push_results(begin, end, k);
          }
 
          return result;
@@ -438,7 +484,7 @@ namespace eosio::chain_apis {
 
 
       using name_bimap_t = bimap<multiset_of<weighted<chain::permission_level>>, multiset_of<permission_info::cref>>;
-      using key_bimap_t = bimap<multiset_of<weighted<chain::public_key_type>>, multiset_of<permission_info::cref>>;
+      using key_bimap_t = bimap<multiset_of<weighted<key_id_t>>, multiset_of<permission_info::cref>>;
 
       /*
        * The structures below are shared between the writing thread and the reading thread(s) and must be protected
@@ -446,7 +492,16 @@ namespace eosio::chain_apis {
        */
       permission_info_index_t    permission_info_index;    ///< multi-index that holds ephemeral indices
       name_bimap_t               name_bimap;               ///< many:many bimap of names:permission_infos
-      key_bimap_t                key_bimap;                ///< many:many bimap of keys:permission_infos
+      key_bimap_t                key_bimap;                ///< many:many bimap of interned keys:permission_infos
+
+      /*
+       * Keys are interned, most are used by several permissions (owner and active at least) and webauthn keys are large
+       */
+      using key_id_map_t = std::map<chain::public_key_type, key_id_t>;
+      key_id_map_t                                key_ids;        ///< key to its id, the only copy of the key
+      std::vector<key_id_map_t::iterator>         interned_keys;  ///< id to its key_ids entry
+      std::vector<uint32_t>                       key_refs;       ///< id to the number of key_bimap entries using it
+      std::vector<key_id_t>                       free_key_ids;   ///< ids without references, reused first
 
       mutable std::shared_mutex  rw_mutex;                 ///< mutex for read/write locking on the Multi-index and bimaps
    };
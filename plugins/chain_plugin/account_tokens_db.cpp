@@ -0,0 +1,152 @@
+#include <eosio/chain_plugin/account_tokens_db.hpp>
+
+#include <eosio/chain/controller.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/member.hpp>
+
+using namespace eosio;
+using namespace boost::multi_index;
+
+namespace {
+   /**
+    * An `accounts` table of code scoped by account, which the state may no longer hold while changed is set
+    */
+   struct token_table {
+      // indexed data
+      chain::name account;
+      chain::name code;
+      uint32_t    changed = 0; ///< block number of the last creation or removal not yet irreversible, 0 if none
+   };
+
+   struct by_account_code;
+   struct by_changed;
+
+   using token_table_index_t = multi_index_container<
+      token_table,
+      indexed_by<
+         ordered_unique<
+            tag<by_account_code>,
+            composite_key<token_table,
+               member<token_table, chain::name, &token_table::account>,
+               member<token_table, chain::name, &token_table::code>
+            >
+         >,
+         ordered_non_unique<
+            tag<by_changed>,
+            member<token_table, uint32_t, &token_table::changed>
+         >
+      >
+   >;
+
+   const chain::name accounts_table = N(accounts);
+}
+
+namespace eosio::chain_apis {
+   /**
+    * Implementation details of the account tokens DB
+    */
+   struct account_tokens_db_impl {
+      account_tokens_db_impl(const chain::controller& controller)
+      :controller(controller)
+      {}
+
+      /**
+       * Build the initial index from the `accounts` tables in the state at the current HEAD
+       */
+      void build() {
+         ilog("Building account tokens DB");
+         auto start = fc::time_point::now();
+         const auto& index = controller.db().get_index<chain::table_id_multi_index>().indices().get<chain::by_code_scope_table>();
+
+         for( const auto& t : index ) {
+            if( t.table == accounts_table ) {
+               token_tables.emplace( token_table{ t.scope, t.code } );
+            }
+         }
+         auto duration = fc::time_point::now() - start;
+         ilog("Finished building account tokens DB with ${n} tables in ${sec}",
+              ("n", token_tables.size())("sec", (duration.count() / 1'000'000.0 )));
+      }
+
+      void table_changed( const chain::table_id_object& tid ) {
+         if( tid.table != accounts_table )
+            return;
+
+         // the change belongs to the pending block and is undone with it, keep the entry until it is irreversible
+         const uint32_t block_num = controller.head_block_num() + 1;
+         auto itr = token_tables.find( boost::make_tuple( tid.scope, tid.code ) );
+         if( itr == token_tables.end() ) {
+            token_tables.emplace( token_table{ tid.scope, tid.code, block_num } );
+         } else {
+            token_tables.modify( itr, [&]( token_table& t ) { t.changed = block_num; } );
+         }
+      }
+
+      void commit_irreversible( uint32_t lib ) {
+         auto& index = token_tables.get<by_changed>();
+         auto itr = index.upper_bound( 0 );
+         while( itr != index.end() && itr->changed <= lib ) {
+            auto cur = itr++;
+            if( find_table( cur->account, cur->code ) ) {
+               index.modify( cur, []( token_table& t ) { t.changed = 0; } );
+            } else {
+               index.erase( cur );
+            }
+         }
+      }
+
+      const chain::table_id_object* find_table( chain::name account, chain::name code ) const {
+         return controller.db().find<chain::table_id_object, chain::by_code_scope_table>( boost::make_tuple( code, account, accounts_table ) );
+      }
+
+      void for_each_token( chain::name account, chain::name lower_bound,
+                           const std::function<bool(chain::name, const chain::table_id_object&)>& f ) const {
+         const auto& index = token_tables.get<by_account_code>();
+         auto itr = index.lower_bound( boost::make_tuple( account, lower_bound ) );
+         auto end = index.upper_bound( account );
+         for( ; itr != end; ++itr ) {
+            const auto* tid = find_table( account, itr->code );
+            if( tid && !f( itr->code, *tid ) )
+               break;
+         }
+      }
+
+      const chain::controller& controller;
+      token_table_index_t      token_tables;
+   };
+
+   account_tokens_db::account_tokens_db( const chain::controller& controller )
+   :_impl(std::make_unique<account_tokens_db_impl>(controller))
+   {
+      _impl->build();
+   }
+
+   account_tokens_db::~account_tokens_db() = default;
+   account_tokens_db::account_tokens_db(account_tokens_db &&) = default;
+   account_tokens_db & account_tokens_db::operator=(account_tokens_db &&) = default;
+
+   void account_tokens_db::table_changed( const chain::table_id_object& tid ) {
+      try {
+         _impl->table_changed(tid);
+      } FC_LOG_AND_DROP(("ACCOUNT TOKENS DB table_changed ERROR"));
+   }
+
+   void account_tokens_db::commit_irreversible( uint32_t lib ) {
+      try {
+         _impl->commit_irreversible(lib);
+      } FC_LOG_AND_DROP(("ACCOUNT TOKENS DB commit_irreversible ERROR"));
+   }
+
+   void account_tokens_db::for_each_token( chain::name account, chain::name lower_bound,
+                                           const std::function<bool(chain::name, const chain::table_id_object&)>& f ) const {
+      _impl->for_each_token(account, lower_bound, f);
+   }
+
+   size_t account_tokens_db::size() const {
+      return _impl->token_tables.size();
+   }
+
+}
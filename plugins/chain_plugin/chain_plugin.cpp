@@ -12,6 +12,7 @@
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/snapshot.hpp>
+#include <eosio/chain/thread_utils.hpp>
 
 #include <eosio/chain/eosio_contract.hpp>
 
@@ -21,10 +22,17 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include <fc/crypto/hex.hpp>
 #include <fc/io/json.hpp>
 #include <fc/variant.hpp>
 #include <signal.h>
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 #include <cstdlib>
+#include <cstring>
 
 // reflect chainbase::environment for --print-build-info option
 FC_REFLECT_ENUM( chainbase::environment::os_t,
@@ -143,6 +151,7 @@ public:
    bool                             accept_transactions = false;
    bool                             api_accept_transactions = true;
    bool                             account_queries_enabled = false;
+   bool                             account_tokens_enabled = false;
 
 
    fc::optional<fork_database>      fork_db;
@@ -154,6 +163,11 @@ public:
    fc::optional<vm_type>            wasm_runtime;
    fc::microseconds                 abi_serializer_max_time_us;
    fc::optional<bfs::path>          snapshot_path;
+   fc::optional<bfs::path>          snapshot_base_path; ///< when snapshot_path is a diff snapshot
+   bool                             fresh_state = false; ///< neither state nor blocks.log existed, see set_startup_snapshot
+   fc::optional<chain_apis::abi_serializer_cache> abi_cache;
+   fc::optional<chain_apis::response_cache>       resp_cache;
+   fc::optional<chain_apis::head_block_response_cache> head_cache;
 
 
    // retained references to channels for easy publication
@@ -185,6 +199,12 @@ public:
 
 
    fc::optional<chain_apis::account_query_db>                        _account_query_db;
+   fc::optional<chain_apis::account_tokens_db>                       _account_tokens_db;
+
+   /// startup profile, logged at the end of plugin_startup
+   fc::microseconds                                                  open_duration;          ///< state, reversible, fork and code cache databases
+   fc::microseconds                                                  chain_startup_duration; ///< including the replay
+   fc::microseconds                                                  account_query_duration;
 };
 
 chain_plugin::chain_plugin()
@@ -229,6 +249,21 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
    cfg.add_options()
          ("blocks-dir", bpo::value<bfs::path>()->default_value("blocks"),
           "the location of the blocks directory (absolute path or relative to application data dir)")
+         ("blocks-log-stride", bpo::value<uint32_t>()->default_value(0),
+          "Split the block log into files of this many blocks, the completed ones are named blocks-<first>-<last>.log and can be "
+          "archived or served on their own. 0 keeps all blocks in blocks.log.")
+         ("max-retained-block-files", bpo::value<uint32_t>()->default_value(std::numeric_limits<uint32_t>::max()),
+          "Number of completed block log files of blocks-log-stride blocks to keep, the oldest beyond it is deleted.")
+         ("block-log-retain-blocks", bpo::value<uint32_t>(),
+          "Keep at least this many of the newest blocks in the block log and delete older ones while running. Without blocks-log-stride "
+          "the log is split into files of this many blocks, so at most twice as many are kept.")
+         ("block-log-queue-size", bpo::value<uint32_t>()->default_value(0),
+          "Irreversible blocks that may wait for the block log writer thread, the main thread waits when there are this many. "
+          "0 writes the blocks on the main thread.")
+         ("block-log-flush-interval", bpo::value<uint32_t>()->default_value(1),
+          "Blocks the block log writer thread writes before it flushes them, it also flushes whenever it is out of blocks.")
+         ("block-log-fsync", bpo::bool_switch()->default_value(false),
+          "fsync the block log with every flush, otherwise the OS decides when the flushed blocks get to disk.")
          ("protocol-features-dir", bpo::value<bfs::path>()->default_value("protocol_features"),
           "the location of the protocol_features directory (absolute path or relative to application config dir)")
          ("checkpoint", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
@@ -244,6 +279,14 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
          )
          ("abi-serializer-max-time-ms", bpo::value<uint32_t>()->default_value(config::default_abi_serializer_max_time_us / 1000),
           "Override default maximum ABI serialization time allowed in ms")
+         ("abi-serializer-cache-size", bpo::value<uint32_t>()->default_value(1000),
+          "Number of contract ABIs the chain API keeps parsed, reused until the contract sets a new ABI. 0 parses the ABI on every call.")
+         ("api-response-cache-size", bpo::value<uint32_t>()->default_value(100),
+          "Number of get_block responses for irreversible blocks the chain API keeps decoded, reused until a contract of the block sets a new ABI. 0 to disable.")
+         ("api-head-block-cache-size", bpo::value<uint32_t>()->default_value(1000),
+          "Number of get_producers and get_account results the chain API keeps until the head block changes, the same call within a block is answered from them. 0 to disable.")
+         ("decoded-action-cache-size", bpo::value<uint32_t>()->default_value(decoded_action_cache::default_max_size),
+          "Number of ABI decoded action payloads kept for the chain API, history and trace plugins together, so an action is decoded once for all of them. 0 to disable.")
          ("chain-state-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_state_size / (1024  * 1024)), "Maximum size (in MiB) of the chain state database")
          ("chain-state-db-guard-size-mb", bpo::value<uint64_t>()->default_value(config::default_state_guard_size / (1024  * 1024)), "Safely shut down node when free space remaining in the chain state database drops below this size (in MiB).")
          ("reversible-blocks-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_reversible_cache_size / (1024  * 1024)), "Maximum size (in MiB) of the reversible blocks database")
@@ -254,6 +297,8 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
           "Number of worker threads in controller thread pool")
          ("contracts-console", bpo::bool_switch()->default_value(false),
           "print contract's output to console")
+         ("trace-spans", bpo::bool_switch()->default_value(false),
+          "record block life cycle tracing spans from startup, they can also be switched on at runtime with producer/set_trace_spans")
          ("actor-whitelist", boost::program_options::value<vector<string>>()->composing()->multitoken(),
           "Account added to actor whitelist (may specify multiple times)")
          ("actor-blacklist", boost::program_options::value<vector<string>>()->composing()->multitoken(),
@@ -297,6 +342,13 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
          )
 #ifdef __linux__
          ("database-hugepage-path", bpo::value<vector<string>>()->composing(), "Optional path for database hugepages when in \"locked\" mode (may specify multiple times)")
+         ("database-numa-policy", bpo::value<string>()->default_value("default"),
+          "NUMA memory policy for the state database (\"default\", \"interleave\" or \"bind\").\n"
+          "It is the policy of the main thread, which loads the database into memory in \"heap\" and \"locked\" mode, "
+          "so it also applies to the other memory the main thread allocates.\n"
+          "\"interleave\" spreads the pages over the database-numa-node nodes, \"bind\" allocates them only on those nodes.")
+         ("database-numa-node", bpo::value<vector<uint32_t>>()->composing(),
+          "NUMA node of the database-numa-policy (may specify multiple times), all online nodes when not specified")
 #endif
 
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
@@ -308,8 +360,37 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
                }
          }), "Number of threads to use for EOS VM OC tier-up")
          ("eos-vm-oc-enable", bpo::bool_switch(), "Enable EOS VM OC tier-up runtime")
+         ("eos-vm-oc-warmup-blocks", bpo::value<uint32_t>()->default_value(0),
+          "At startup, queue EOS VM OC compiles of the contracts called in this many of the last blocks of the block log. 0 disables the warmup")
+         ("eos-vm-oc-admission-executions", bpo::value<uint32_t>()->default_value(eosvmoc::config().admission_executions),
+          "Compile a contract with EOS VM OC only once it was executed this many times while not compiled. Keeps one-off contracts from evicting frequently executed ones")
+         ("eos-vm-oc-admission-window", bpo::value<uint32_t>()->default_value(eosvmoc::config().admission_window),
+          "Number of EOS VM OC cache misses after which the execution counts of contracts not yet compiled are halved")
+         ("eos-vm-oc-pinned-account", bpo::value<vector<string>>()->composing()->multitoken(),
+          "Account whose contract is compiled by EOS VM OC on first use and never evicted from the code cache (may specify multiple times). eosio and eosio.token are always pinned")
+         ("eos-vm-oc-profile-dir", bpo::value<bfs::path>(),
+          "Sample the contracts executed by EOS VM OC and write a profile of each code, in folded stack format, to this directory. "
+          "If a relative path is specified, it is relative to the data directory. Profiling is disabled if not set")
+         ("eos-vm-oc-profile-interval-us", bpo::value<uint32_t>()->default_value(eosvmoc::config().profile_interval_us),
+          "Main thread cpu time, in microseconds, between two EOS VM OC profile samples")
+         ("eos-vm-oc-shared-cache-dir", bpo::value<bfs::path>(),
+          "Directory of an EOS VM OC code cache shared by the nodeos processes on this host. Contracts compiled in to it are executed from it, "
+          "so the compiled code is in memory once for all processes. If a relative path is specified, it is relative to the data directory")
+         ("eos-vm-oc-shared-cache-writer", bpo::bool_switch()->default_value(false),
+          "Compile in to the shared EOS VM OC code cache instead of a private one. Exactly one nodeos per shared cache must be the writer and "
+          "must be started first; it never evicts from the shared cache, so size it with eos-vm-oc-cache-size-mb to hold all contracts of interest")
+         ("eos-vm-oc-deadline-poll-interval", bpo::value<uint32_t>()->default_value(0),
+          "Function calls and loop iterations of EOS VM OC compiled contracts between two checks of the clock against the transaction deadline, "
+          "stopping a contract at its deadline even when the checktime timer fires late. 0 relies on the timer alone and compiles no checks in to the contracts. "
+          "Switching between 0 and another value recompiles the cached contracts")
+         ("eos-vm-oc-hot-code-mb", bpo::value<uint64_t>()->default_value(0),
+          "Size (in MiB, rounded up to 2 MiB) of a region backed by huge pages the EOS VM OC compiled contracts are copied in to and executed from, "
+          "one after the other in the order they are first executed, reducing instruction TLB misses. Reserved huge pages are used if there are "
+          "enough of them, transparent huge pages otherwise. One region per code cache executed from, 0 executes from the code cache")
 #endif
          ("enable-account-queries", bpo::value<bool>()->default_value(false), "enable queries to find accounts by various metadata.")
+         ("enable-account-tokens-index", bpo::value<bool>()->default_value(false),
+          "enable get_account_tokens, backed by an in memory index from accounts to the contracts of their `accounts` tables")
          ("max-nonprivileged-inline-action-size", bpo::value<uint32_t>()->default_value(config::default_max_nonprivileged_inline_action_size), "maximum allowed size (in bytes) of an inline action for a nonprivileged account")
          ;
 
@@ -340,8 +421,14 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
           "do not skip any checks that can be skipped while replaying irreversible blocks")
          ("disable-replay-opts", bpo::bool_switch()->default_value(false),
           "disable optimizations that specifically target replay")
+         ("replay-checkpoint-interval", bpo::value<uint32_t>()->default_value(0),
+          "while replaying irreversible blocks, write a snapshot of the state every this many blocks to the replay-checkpoints "
+          "directory of the data directory, which --resume-replay-blockchain restarts an interrupted replay from (0 disables)")
          ("replay-blockchain", bpo::bool_switch()->default_value(false),
           "clear chain state database and replay all blocks")
+         ("resume-replay-blockchain", bpo::bool_switch()->default_value(false),
+          "clear chain state database, load the latest valid replay checkpoint and replay the blocks after it; "
+          "replays all blocks when there is no valid checkpoint")
          ("hard-replay-blockchain", bpo::bool_switch()->default_value(false),
           "clear chain state database, recover as many blocks as possible from the block log, and then replay those blocks")
          ("delete-all-blocks", bpo::bool_switch()->default_value(false),
@@ -353,6 +440,8 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
          ("export-reversible-blocks", bpo::value<bfs::path>(),
            "export reversible block database in portable format into specified file and then exit")
          ("snapshot", bpo::value<bfs::path>(), "File to read Snapshot State from")
+         ("snapshot-base", bpo::value<bfs::path>(),
+          "Snapshot the --snapshot diff snapshot was written against, the state is read from both")
          ;
 
 }
@@ -404,6 +493,103 @@ void clear_chainbase_files( const fc::path& p ) {
    fc::remove( p / "shared_memory.meta" );
 }
 
+/// newest readable replay-<block num>.bin of the directory, older checkpoints are tried when the newest one is damaged
+optional<bfs::path> latest_replay_checkpoint( const fc::path& p ) {
+   using boost::filesystem::directory_iterator;
+
+   if( !fc::is_directory( p ) )
+      return {};
+
+   std::map<uint32_t, bfs::path, std::greater<uint32_t>> checkpoints;
+   for( directory_iterator enditr, itr{p}; itr != enditr; ++itr ) {
+      uint32_t num = 0;
+      char extra = 0;
+      if( sscanf( itr->path().filename().generic_string().c_str(), "replay-%u.bin%c", &num, &extra ) == 1 )
+         checkpoints[num] = itr->path();
+   }
+
+   for( const auto& [num, checkpoint] : checkpoints ) {
+      try {
+         auto infile = std::ifstream( checkpoint.generic_string(), (std::ios::in | std::ios::binary) );
+         istream_snapshot_reader reader( infile );
+         reader.validate();
+         return checkpoint;
+      } catch( const fc::exception& e ) {
+         wlog( "skipping invalid replay checkpoint '${path}': ${details}",
+               ("path", checkpoint.generic_string())("details", e.to_detail_string()) );
+      } catch( const std::exception& e ) {
+         wlog( "skipping invalid replay checkpoint '${path}': ${details}",
+               ("path", checkpoint.generic_string())("details", e.what()) );
+      }
+   }
+   return {};
+}
+
+/// calls f with a reader of the snapshot, of the diff snapshot applied to its base when there is one
+template<typename F>
+void read_snapshot( const bfs::path& snapshot_path, const optional<bfs::path>& base_path, F&& f ) {
+   auto infile = std::ifstream(snapshot_path.generic_string(), (std::ios::in | std::ios::binary));
+   if( base_path ) {
+      auto base_infile = std::ifstream(base_path->generic_string(), (std::ios::in | std::ios::binary));
+      f( std::make_shared<diff_istream_snapshot_reader>(base_infile, infile) );
+   } else {
+      f( std::make_shared<istream_snapshot_reader>(infile) );
+   }
+}
+
+#ifdef __linux__
+vector<uint32_t> online_numa_nodes() {
+   vector<uint32_t> nodes;
+   std::ifstream online( "/sys/devices/system/node/online" );
+   string ranges;
+   if( !std::getline( online, ranges ) )
+      return nodes;
+
+   vector<string> parts;
+   boost::split( parts, ranges, boost::is_any_of( "," ) );
+   for( const auto& part : parts ) {
+      uint32_t first = 0, last = 0;
+      int n = sscanf( part.c_str(), "%u-%u", &first, &last );
+      if( n < 1 )
+         continue;
+      if( n == 1 )
+         last = first;
+      for( uint32_t node = first; node <= last; ++node )
+         nodes.push_back( node );
+   }
+   return nodes;
+}
+
+/// memory policy of the calling thread, and of the threads it creates afterwards
+void set_numa_policy( const string& policy, vector<uint32_t> nodes ) {
+   if( policy == "default" )
+      return;
+
+   int mode = 0;
+   if( policy == "interleave" )
+      mode = MPOL_INTERLEAVE;
+   else if( policy == "bind" )
+      mode = MPOL_BIND;
+   else
+      EOS_THROW( plugin_config_exception, "unknown database-numa-policy \"${p}\"", ("p", policy) );
+
+   if( nodes.empty() )
+      nodes = online_numa_nodes();
+   EOS_ASSERT( !nodes.empty(), plugin_config_exception, "database-numa-policy requires NUMA nodes, none are online" );
+
+   constexpr uint32_t bits = 8 * sizeof(unsigned long);
+   vector<unsigned long> mask;
+   for( auto node : nodes ) {
+      if( mask.size() <= node / bits )
+         mask.resize( node / bits + 1 );
+      mask[node / bits] |= 1ul << (node % bits);
+   }
+   EOS_ASSERT( syscall( SYS_set_mempolicy, mode, mask.data(), mask.size() * bits + 1 ) == 0, plugin_config_exception,
+               "failed to set database-numa-policy ${p}: ${e}", ("p", policy)("e", strerror( errno )) );
+   ilog( "Using NUMA policy ${p} on nodes ${n} for the state database", ("p", policy)("n", nodes) );
+}
+#endif
+
 optional<builtin_protocol_feature> read_builtin_protocol_feature( const fc::path& p  ) {
    try {
       return fc::json::from_file<builtin_protocol_feature>( p );
@@ -731,8 +917,27 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
 
       if(options.count("abi-serializer-max-time-ms"))
          my->abi_serializer_max_time_us = fc::microseconds(options.at("abi-serializer-max-time-ms").as<uint32_t>() * 1000);
+      my->abi_cache.emplace( options.at("abi-serializer-cache-size").as<uint32_t>() );
+      my->resp_cache.emplace( options.at("api-response-cache-size").as<uint32_t>(), *my->abi_cache );
+      my->head_cache.emplace( options.at("api-head-block-cache-size").as<uint32_t>() );
+      decoded_action_cache::instance().set_max_size( options.at("decoded-action-cache-size").as<uint32_t>() );
 
       my->chain_config->blocks_dir = my->blocks_dir;
+      my->chain_config->blocks_log_stride = options.at( "blocks-log-stride" ).as<uint32_t>();
+      my->chain_config->max_retained_block_files = options.at( "max-retained-block-files" ).as<uint32_t>();
+      if( options.count( "block-log-retain-blocks" )) {
+         const auto retain_blocks = options.at( "block-log-retain-blocks" ).as<uint32_t>();
+         EOS_ASSERT( retain_blocks > 0, plugin_config_exception, "block-log-retain-blocks must be greater than 0" );
+         auto& stride = my->chain_config->blocks_log_stride;
+         if( stride == 0 )
+            stride = retain_blocks;
+         // blocks.log holds the blocks after the newest completed file, enough files to reach retain_blocks without it
+         const uint32_t files = retain_blocks / stride + (retain_blocks % stride != 0);
+         my->chain_config->max_retained_block_files = std::min( my->chain_config->max_retained_block_files, files );
+      }
+      my->chain_config->blocks_log_queue_size = options.at( "block-log-queue-size" ).as<uint32_t>();
+      my->chain_config->blocks_log_flush_interval = options.at( "block-log-flush-interval" ).as<uint32_t>();
+      my->chain_config->blocks_log_fsync = options.at( "block-log-fsync" ).as<bool>();
       my->chain_config->state_dir = app().data_dir() / config::default_state_dir_name;
       my->chain_config->read_only = my->readonly;
 
@@ -768,7 +973,10 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
 
       my->chain_config->force_all_checks = options.at( "force-all-checks" ).as<bool>();
       my->chain_config->disable_replay_opts = options.at( "disable-replay-opts" ).as<bool>();
+      my->chain_config->replay_checkpoint_interval = options.at( "replay-checkpoint-interval" ).as<uint32_t>();
+      my->chain_config->replay_checkpoint_dir = app().data_dir() / "replay-checkpoints";
       my->chain_config->contracts_console = options.at( "contracts-console" ).as<bool>();
+      my->chain_config->trace_spans = options.at( "trace-spans" ).as<bool>();
       my->chain_config->allow_ram_billing_in_notify = options.at( "disable-ram-billing-notify-checks" ).as<bool>();
       my->chain_config->maximum_variable_signature_length = options.at( "maximum-variable-signature-length" ).as<uint32_t>();
 
@@ -834,11 +1042,20 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          clear_directory_contents( my->blocks_dir );
       } else if( options.at( "hard-replay-blockchain" ).as<bool>()) {
          do_hard_replay(options);
-      } else if( options.at( "replay-blockchain" ).as<bool>()) {
+      } else if( options.at( "replay-blockchain" ).as<bool>() || options.at( "resume-replay-blockchain" ).as<bool>()) {
          ilog( "Replay requested: deleting state database" );
          if( options.at( "truncate-at-block" ).as<uint32_t>() > 0 )
             wlog( "The --truncate-at-block option does not work for a regular replay of the blockchain." );
          clear_chainbase_files( my->chain_config->state_dir );
+         if( !options.at( "replay-blockchain" ).as<bool>() ) {
+            EOS_ASSERT( options.count( "snapshot" ) == 0, plugin_config_exception,
+                        "--resume-replay-blockchain is incompatible with --snapshot" );
+            my->snapshot_path = latest_replay_checkpoint( my->chain_config->replay_checkpoint_dir );
+            if( my->snapshot_path )
+               ilog( "Resuming replay from checkpoint ${p}", ("p", my->snapshot_path->generic_string()) );
+            else
+               ilog( "No valid replay checkpoint, replaying all blocks" );
+         }
          if( options.at( "fix-reversible-blocks" ).as<bool>()) {
             if( !recover_reversible_blocks( my->chain_config->blocks_dir / config::reversible_blocks_dir_name,
                                             my->chain_config->reversible_cache_size )) {
@@ -873,18 +1090,25 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
       }
 
       fc::optional<chain_id_type> chain_id;
-      if (options.count( "snapshot" )) {
+      if (options.count( "snapshot" ))
          my->snapshot_path = options.at( "snapshot" ).as<bfs::path>();
+      if (options.count( "snapshot-base" )) {
+         EOS_ASSERT( options.count( "snapshot" ), plugin_config_exception,
+                     "--snapshot-base requires the diff snapshot written against it as --snapshot" );
+         my->snapshot_base_path = options.at( "snapshot-base" ).as<bfs::path>();
+         EOS_ASSERT( fc::exists(*my->snapshot_base_path), plugin_config_exception,
+                     "Cannot load snapshot, ${name} does not exist", ("name", my->snapshot_base_path->generic_string()) );
+      }
+      if (my->snapshot_path) {
          EOS_ASSERT( fc::exists(*my->snapshot_path), plugin_config_exception,
                      "Cannot load snapshot, ${name} does not exist", ("name", my->snapshot_path->generic_string()) );
 
          // recover genesis information from the snapshot
          // used for validation code below
-         auto infile = std::ifstream(my->snapshot_path->generic_string(), (std::ios::in | std::ios::binary));
-         istream_snapshot_reader reader(infile);
-         reader.validate();
-         chain_id = controller::extract_chain_id(reader);
-         infile.close();
+         read_snapshot(*my->snapshot_path, my->snapshot_base_path, [&chain_id]( const snapshot_reader_ptr& reader ) {
+            reader->validate();
+            chain_id = controller::extract_chain_id(*reader);
+         });
 
          EOS_ASSERT( options.count( "genesis-timestamp" ) == 0,
                  plugin_config_exception,
@@ -1056,6 +1280,9 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
 #ifdef __linux__
       if( options.count("database-hugepage-path") )
          my->chain_config->db_hugepage_paths = options.at("database-hugepage-path").as<std::vector<std::string>>();
+      // before the controller opens the state database, so that its pages are placed by the policy
+      set_numa_policy( options.at("database-numa-policy").as<string>(),
+                       options.count("database-numa-node") ? options.at("database-numa-node").as<vector<uint32_t>>() : vector<uint32_t>() );
 #endif
 
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
@@ -1065,11 +1292,46 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          my->chain_config->eosvmoc_config.threads = options.at("eos-vm-oc-compile-threads").as<uint64_t>();
       if( options["eos-vm-oc-enable"].as<bool>() )
          my->chain_config->eosvmoc_tierup = true;
+      my->chain_config->eosvmoc_config.warmup_blocks = options.at("eos-vm-oc-warmup-blocks").as<uint32_t>();
+      my->chain_config->eosvmoc_config.admission_executions = options.at("eos-vm-oc-admission-executions").as<uint32_t>();
+      my->chain_config->eosvmoc_config.admission_window = options.at("eos-vm-oc-admission-window").as<uint32_t>();
+      my->chain_config->eosvmoc_config.pinned_accounts.insert( config::system_account_name );
+      my->chain_config->eosvmoc_config.pinned_accounts.insert( N(eosio.token) );
+      if( options.count("eos-vm-oc-pinned-account") ) {
+         for( const auto& a : options.at("eos-vm-oc-pinned-account").as<vector<string>>() )
+            my->chain_config->eosvmoc_config.pinned_accounts.insert( name( a ) );
+      }
+      if( options.count("eos-vm-oc-profile-dir") ) {
+         auto pd = options.at("eos-vm-oc-profile-dir").as<bfs::path>();
+         if( pd.is_relative() )
+            pd = app().data_dir() / pd;
+         my->chain_config->eosvmoc_config.profile_dir = pd;
+      }
+      my->chain_config->eosvmoc_config.profile_interval_us = options.at("eos-vm-oc-profile-interval-us").as<uint32_t>();
+      EOS_ASSERT( my->chain_config->eosvmoc_config.profile_interval_us > 0, plugin_config_exception,
+                  "eos-vm-oc-profile-interval-us must be positive" );
+      if( options.count("eos-vm-oc-shared-cache-dir") ) {
+         auto sd = options.at("eos-vm-oc-shared-cache-dir").as<bfs::path>();
+         if( sd.is_relative() )
+            sd = app().data_dir() / sd;
+         my->chain_config->eosvmoc_config.shared_cache_dir = sd;
+      }
+      my->chain_config->eosvmoc_config.shared_cache_writer = options.at("eos-vm-oc-shared-cache-writer").as<bool>();
+      my->chain_config->eosvmoc_config.deadline_poll_interval = options.at("eos-vm-oc-deadline-poll-interval").as<uint32_t>();
+      my->chain_config->eosvmoc_config.hot_code_size = options.at("eos-vm-oc-hot-code-mb").as<uint64_t>() * 1024u * 1024u;
+      EOS_ASSERT( !my->chain_config->eosvmoc_config.shared_cache_writer || !my->chain_config->eosvmoc_config.shared_cache_dir.empty(),
+                  plugin_config_exception, "eos-vm-oc-shared-cache-writer requires eos-vm-oc-shared-cache-dir" );
 #endif
 
       my->account_queries_enabled = options.at("enable-account-queries").as<bool>();
+      my->account_tokens_enabled = options.at("enable-account-tokens-index").as<bool>();
 
+      my->fresh_state = !my->snapshot_path && !fc::is_regular_file( my->chain_config->state_dir / "shared_memory.bin" )
+                        && !fc::is_regular_file( my->blocks_dir / "blocks.log" );
+
+      auto open_start = fc::time_point::now();
       my->chain.emplace( *my->chain_config, std::move(pfs), *chain_id );
+      my->open_duration = fc::time_point::now() - open_start;
 
       // set up method providers
       my->get_block_by_number_provider = app().get_method<methods::get_block_by_number>().register_provider(
@@ -1118,6 +1380,9 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
       } );
 
       my->irreversible_block_connection = my->chain->irreversible_block.connect( [this]( const block_state_ptr& blk ) {
+         if (my->_account_tokens_db) {
+            my->_account_tokens_db->commit_irreversible(blk->block_num);
+         }
          my->irreversible_block_channel.publish( priority::low, blk );
       } );
 
@@ -1143,13 +1408,13 @@ void chain_plugin::plugin_startup()
 { try {
    EOS_ASSERT( my->chain_config->read_mode != db_read_mode::IRREVERSIBLE || !accept_transactions(), plugin_config_exception,
                "read-mode = irreversible. transactions should not be enabled by enable_accept_transactions" );
+   auto chain_startup_start = fc::time_point::now();
    try {
       auto shutdown = [](){ return app().is_quiting(); };
       if (my->snapshot_path) {
-         auto infile = std::ifstream(my->snapshot_path->generic_string(), (std::ios::in | std::ios::binary));
-         auto reader = std::make_shared<istream_snapshot_reader>(infile);
-         my->chain->startup(shutdown, reader);
-         infile.close();
+         read_snapshot(*my->snapshot_path, my->snapshot_base_path, [this, &shutdown]( const snapshot_reader_ptr& reader ) {
+            my->chain->startup(shutdown, reader);
+         });
       } else if( my->genesis ) {
          my->chain->startup(shutdown, *my->genesis);
       } else {
@@ -1162,6 +1427,8 @@ void chain_plugin::plugin_startup()
       throw;
    }
 
+   my->chain_startup_duration = fc::time_point::now() - chain_startup_start;
+
    if(!my->readonly) {
       ilog("starting chain in read/write mode");
    }
@@ -1178,12 +1445,28 @@ void chain_plugin::plugin_startup()
 
    if (my->account_queries_enabled) {
       my->account_queries_enabled = false;
+      auto account_query_start = fc::time_point::now();
       try {
          my->_account_query_db.emplace(*my->chain);
          my->account_queries_enabled = true;
       } FC_LOG_AND_DROP(("Unable to enable account queries"));
+      my->account_query_duration = fc::time_point::now() - account_query_start;
    }
 
+   if (my->account_tokens_enabled) {
+      my->account_tokens_enabled = false;
+      try {
+         my->_account_tokens_db.emplace(*my->chain);
+         my->chain->set_table_lifecycle_callback([this](const table_id_object& t, bool) {
+            my->_account_tokens_db->table_changed(t);
+         });
+         my->account_tokens_enabled = true;
+      } FC_LOG_AND_DROP(("Unable to enable account tokens index"));
+   }
+
+   ilog("chain_plugin startup profile: open databases ${o} ms, chain startup ${s} ms, account query index ${a} ms",
+        ("o", my->open_duration.count() / 1000)("s", my->chain_startup_duration.count() / 1000)
+        ("a", my->account_query_duration.count() / 1000));
 
 } FC_CAPTURE_AND_RETHROW() }
 
@@ -1194,15 +1477,19 @@ void chain_plugin::plugin_shutdown() {
    my->irreversible_block_connection.reset();
    my->accepted_transaction_connection.reset();
    my->applied_transaction_connection.reset();
+   if(my->_account_tokens_db)
+      my->chain->set_table_lifecycle_callback(nullptr);
    if(app().is_quiting())
       my->chain->get_wasm_interface().indicate_shutting_down();
    my->chain.reset();
 }
 
-chain_apis::read_write::read_write(controller& db, const fc::microseconds& abi_serializer_max_time, bool api_accept_transactions)
+chain_apis::read_write::read_write(controller& db, const fc::microseconds& abi_serializer_max_time, bool api_accept_transactions,
+                                   abi_serializer_cache* abi_cache)
 : db(db)
 , abi_serializer_max_time(abi_serializer_max_time)
 , api_accept_transactions(api_accept_transactions)
+, abi_cache(abi_cache)
 {
 }
 
@@ -1212,7 +1499,13 @@ void chain_apis::read_write::validate() const {
 }
 
 chain_apis::read_only chain_plugin::get_read_only_api() const {
-   return chain_apis::read_only(chain(), my->_account_query_db, get_abi_serializer_max_time());
+   return chain_apis::read_only(chain(), my->_account_query_db, get_abi_serializer_max_time(), my->abi_cache ? &*my->abi_cache : nullptr,
+                                my->resp_cache ? &*my->resp_cache : nullptr, my->head_cache ? &*my->head_cache : nullptr,
+                                my->_account_tokens_db ? &*my->_account_tokens_db : nullptr);
+}
+
+chain_apis::read_write chain_plugin::get_read_write_api() {
+   return chain_apis::read_write(chain(), get_abi_serializer_max_time(), api_accept_transactions(), my->abi_cache ? &*my->abi_cache : nullptr);
 }
 
 
@@ -1445,6 +1738,32 @@ chain::chain_id_type chain_plugin::get_chain_id()const {
    return my->chain->get_chain_id();
 }
 
+bool chain_plugin::fresh_state() const {
+   return my->fresh_state && !my->snapshot_path;
+}
+
+void chain_plugin::set_startup_snapshot( const fc::path& p ) {
+   EOS_ASSERT( fresh_state(), plugin_config_exception, "Snapshot can only be used to initialize an empty database." );
+   EOS_ASSERT( get_state() == abstract_plugin::initialized, plugin_config_exception,
+               "The startup snapshot can only be set between initialization and startup of the chain" );
+
+   auto infile = std::ifstream(p.generic_string(), (std::ios::in | std::ios::binary));
+   istream_snapshot_reader reader(infile);
+   reader.validate();
+   const auto snapshot_chain_id = controller::extract_chain_id(reader);
+   infile.close();
+
+   // the controller was opened with the chain ID of the genesis state the chain would otherwise start from
+   EOS_ASSERT( snapshot_chain_id == get_chain_id(), plugin_config_exception,
+               "snapshot chain ID (${snapshot_chain_id}) does not match the chain ID (${chain_id}) of the genesis state, "
+               "provide the genesis state of the chain with --genesis-json",
+               ("snapshot_chain_id", snapshot_chain_id)("chain_id", get_chain_id()) );
+
+   ilog( "Starting from snapshot ${p}", ("p", p.generic_string()) );
+   my->snapshot_path = p;
+   my->genesis.reset();
+}
+
 fc::microseconds chain_plugin::get_abi_serializer_max_time() const {
    return my->abi_serializer_max_time_us;
 }
@@ -1498,6 +1817,10 @@ bool chain_plugin::account_queries_enabled() const {
    return my->account_queries_enabled;
 }
 
+bool chain_plugin::account_tokens_enabled() const {
+   return my->account_tokens_enabled;
+}
+
 
 namespace chain_apis {
 
@@ -1738,6 +2061,19 @@ abi_def get_abi( const controller& db, const name& account ) {
    return abi;
 }
 
+// ABI of account from the cache if there is one
+cached_abi_ptr get_cached_abi( abi_serializer_cache* abi_cache, const controller& db, const name& account ) {
+   if( abi_cache )
+      return abi_cache->get( db, account );
+   return abi_serializer_cache( 0 ).get( db, account );
+}
+
+cached_abi_ptr read_only::get_cached_abi( const name& account )const {
+   auto abi = eosio::chain_apis::get_cached_abi( abi_cache, db, account );
+   EOS_ASSERT(abi != nullptr, chain::account_query_exception, "Fail to retrieve account for ${account}", ("account", account) );
+   return abi;
+}
+
 string get_table_type( const abi_def& abi, const name& table_name ) {
    for( const auto& t : abi.tables ) {
       if( t.name == table_name ){
@@ -1747,8 +2083,25 @@ string get_table_type( const abi_def& abi, const name& table_name ) {
    EOS_ASSERT( false, chain::contract_table_query_exception, "Table ${table} is not specified in the ABI", ("table",table_name) );
 }
 
+string read_only::encode_table_rows_cursor( const table_rows_cursor& c ) {
+   return fc::to_hex( fc::raw::pack( c ) );
+}
+
+read_only::table_rows_cursor read_only::decode_table_rows_cursor( const read_only::get_table_rows_params& p, name scope, name index_table ) {
+   table_rows_cursor c;
+   try {
+      vector<char> packed( p.cursor.size() / 2 );
+      EOS_ASSERT( fc::from_hex( p.cursor, packed.data(), packed.size() ) == packed.size(), chain::contract_table_query_exception, "Invalid cursor" );
+      c = fc::raw::unpack<table_rows_cursor>( packed );
+   } EOS_RETHROW_EXCEPTIONS( chain::contract_table_query_exception, "Invalid cursor ${c}", ("c", p.cursor) )
+   EOS_ASSERT( c.code == p.code && c.scope == scope && c.index_table == index_table && c.reverse == (p.reverse && *p.reverse),
+               chain::contract_table_query_exception, "Cursor was not returned for this code, scope, table, index and direction" );
+   return c;
+}
+
 read_only::get_table_rows_result read_only::get_table_rows( const read_only::get_table_rows_params& p )const {
-   const abi_def abi = eosio::chain_apis::get_abi( db, p.code );
+   const auto code_abi = get_cached_abi( p.code );
+   const abi_def& abi = code_abi->abi;
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wstrict-aliasing"
    bool primary = false;
@@ -1757,43 +2110,43 @@ read_only::get_table_rows_result read_only::get_table_rows( const read_only::get
       EOS_ASSERT( p.table == table_with_index, chain::contract_table_query_exception, "Invalid table name ${t}", ( "t", p.table ));
       auto table_type = get_table_type( abi, p.table );
       if( table_type == KEYi64 || p.key_type == "i64" || p.key_type == "name" ) {
-         return get_table_rows_ex<key_value_index>(p,abi);
+         return get_table_rows_ex<key_value_index>(p, *code_abi);
       }
       EOS_ASSERT( false, chain::contract_table_query_exception,  "Invalid table type ${type}", ("type",table_type)("abi",abi));
    } else {
       EOS_ASSERT( !p.key_type.empty(), chain::contract_table_query_exception, "key type required for non-primary index" );
 
       if (p.key_type == chain_apis::i64 || p.key_type == "name") {
-         return get_table_rows_by_seckey<index64_index, uint64_t>(p, abi, [](uint64_t v)->uint64_t {
+         return get_table_rows_by_seckey<index64_index, uint64_t>(p, *code_abi, [](uint64_t v)->uint64_t {
             return v;
          });
       }
       else if (p.key_type == chain_apis::i128) {
-         return get_table_rows_by_seckey<index128_index, uint128_t>(p, abi, [](uint128_t v)->uint128_t {
+         return get_table_rows_by_seckey<index128_index, uint128_t>(p, *code_abi, [](uint128_t v)->uint128_t {
             return v;
          });
       }
       else if (p.key_type == chain_apis::i256) {
          if ( p.encode_type == chain_apis::hex) {
             using  conv = keytype_converter<chain_apis::sha256,chain_apis::hex>;
-            return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+            return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, *code_abi, conv::function());
          }
          using  conv = keytype_converter<chain_apis::i256>;
-         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, *code_abi, conv::function());
       }
       else if (p.key_type == chain_apis::float64) {
-         return get_table_rows_by_seckey<index_double_index, double>(p, abi, [](double v)->float64_t {
+         return get_table_rows_by_seckey<index_double_index, double>(p, *code_abi, [](double v)->float64_t {
             float64_t f = *(float64_t *)&v;
             return f;
          });
       }
       else if (p.key_type == chain_apis::float128) {
          if ( p.encode_type == chain_apis::hex) {
-            return get_table_rows_by_seckey<index_long_double_index, uint128_t>(p, abi, [](uint128_t v)->float128_t{
+            return get_table_rows_by_seckey<index_long_double_index, uint128_t>(p, *code_abi, [](uint128_t v)->float128_t{
                return *reinterpret_cast<float128_t *>(&v);
             });
          }
-         return get_table_rows_by_seckey<index_long_double_index, double>(p, abi, [](double v)->float128_t{
+         return get_table_rows_by_seckey<index_long_double_index, double>(p, *code_abi, [](double v)->float128_t{
             float64_t f = *(float64_t *)&v;
             float128_t f128;
             f64_to_f128M(f, &f128);
@@ -1802,17 +2155,42 @@ read_only::get_table_rows_result read_only::get_table_rows( const read_only::get
       }
       else if (p.key_type == chain_apis::sha256) {
          using  conv = keytype_converter<chain_apis::sha256,chain_apis::hex>;
-         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, *code_abi, conv::function());
       }
       else if(p.key_type == chain_apis::ripemd160) {
          using  conv = keytype_converter<chain_apis::ripemd160,chain_apis::hex>;
-         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, *code_abi, conv::function());
       }
       EOS_ASSERT(false, chain::contract_table_query_exception,  "Unsupported secondary index type: ${t}", ("t", p.key_type));
    }
 #pragma GCC diagnostic pop
 }
 
+read_only::get_table_rows_batch_result read_only::get_table_rows_batch( const read_only::get_table_rows_batch_params& p )const {
+   EOS_ASSERT( p.queries.size() <= max_table_rows_batch_size, chain::contract_table_query_exception,
+               "Batch of ${n} queries exceeds the maximum of ${m}", ("n", p.queries.size())("m", max_table_rows_batch_size) );
+
+   read_only::get_table_rows_batch_result result;
+   result.results.reserve( p.queries.size() );
+
+   // queries of one contract share its cached abi and serializer, each query is still bounded by its own 10ms walk
+   const auto end_time = fc::time_point::now() + fc::microseconds(1000 * 100); /// 100ms max time
+   for( const auto& q : p.queries ) {
+      if( !result.results.empty() && fc::time_point::now() > end_time ) {
+         result.more = true;
+         break;
+      }
+      read_only::get_table_rows_batch_entry entry;
+      try {
+         entry.result = get_table_rows( q );
+      } catch( const fc::exception& e ) {
+         entry.error = e.to_string();
+      }
+      result.results.emplace_back( std::move(entry) );
+   }
+   return result;
+}
+
 read_only::get_table_by_scope_result read_only::get_table_by_scope( const read_only::get_table_by_scope_params& p )const {
    read_only::get_table_by_scope_result result;
    const auto& d = db.db();
@@ -1863,8 +2241,7 @@ read_only::get_table_by_scope_result read_only::get_table_by_scope( const read_o
 
 vector<asset> read_only::get_currency_balance( const read_only::get_currency_balance_params& p )const {
 
-   const abi_def abi = eosio::chain_apis::get_abi( db, p.code );
-   (void)get_table_type( abi, name("accounts") );
+   (void)get_table_type( get_cached_abi( p.code )->abi, name("accounts") );
 
    vector<asset> results;
    walk_key_value_table(p.code, p.account, N(accounts), [&](const key_value_object& obj){
@@ -1890,8 +2267,7 @@ vector<asset> read_only::get_currency_balance( const read_only::get_currency_bal
 fc::variant read_only::get_currency_stats( const read_only::get_currency_stats_params& p )const {
    fc::mutable_variant_object results;
 
-   const abi_def abi = eosio::chain_apis::get_abi( db, p.code );
-   (void)get_table_type( abi, name("stat") );
+   (void)get_table_type( get_cached_abi( p.code )->abi, name("stat") );
 
    uint64_t scope = ( eosio::chain::string_to_symbol( 0, boost::algorithm::to_upper_copy(p.symbol).c_str() ) >> 8 );
 
@@ -1928,10 +2304,30 @@ fc::variant get_global_row( const database& db, const abi_def& abi, const abi_se
    return abis.binary_to_variant(abis.get_table_type(N(global)), data, abi_serializer::create_yield_function( abi_serializer_max_time_us ), shorten_abi_errors );
 }
 
-read_only::get_producers_result read_only::get_producers( const read_only::get_producers_params& p ) const try {
-   const abi_def abi = eosio::chain_apis::get_abi(db, config::system_account_name);
+template<typename Result, typename Params, typename F>
+Result read_only::head_block_cached( const char* call_name, const Params& params, F&& f ) const {
+   if( !head_cache )
+      return f();
+
+   // the head is read along with the state, under the same state lock as the call
+   const auto head_id = db.head_block_id();
+   const string key = string( call_name ) + ":" + fc::json::to_string( params, fc::time_point::maximum() );
+   if( auto cached = head_cache->get<Result>( head_id, key ) )
+      return *cached;
+   Result result = f();
+   head_cache->put( head_id, key, result );
+   return result;
+}
+
+read_only::get_producers_result read_only::get_producers( const read_only::get_producers_params& p ) const {
+   return head_block_cached<get_producers_result>( "get_producers", p, [&]() { return get_producers_uncached( p ); } );
+}
+
+read_only::get_producers_result read_only::get_producers_uncached( const read_only::get_producers_params& p ) const try {
+   const auto system_abi = get_cached_abi( config::system_account_name );
+   const abi_def& abi = system_abi->abi;
    const auto table_type = get_table_type(abi, N(producers));
-   const abi_serializer abis{ abi, abi_serializer::create_yield_function( abi_serializer_max_time ) };
+   const abi_serializer& abis = system_abi->get_serializer( abi_serializer::create_yield_function( abi_serializer_max_time ) );
    EOS_ASSERT(table_type == KEYi64, chain::contract_table_query_exception, "Invalid table type ${type} for table producers", ("type",table_type));
 
    const auto& d = db.db();
@@ -2015,16 +2411,14 @@ read_only::get_producer_schedule_result read_only::get_producer_schedule( const
 template<typename Api>
 struct resolver_factory {
    static auto make(const Api* api, abi_serializer::yield_function_t yield) {
-      return [api, yield{std::move(yield)}](const account_name &name) -> optional<abi_serializer> {
-         const auto* accnt = api->db.db().template find<account_object, by_name>(name);
-         if (accnt != nullptr) {
-            abi_def abi;
-            if (abi_serializer::to_abi(accnt->abi, abi)) {
-               return abi_serializer(abi, yield);
-            }
+      return [api, yield{std::move(yield)}](const account_name &name) -> cached_abi_serializer {
+         auto abi = get_cached_abi(api->abi_cache, api->db, name);
+         if (abi && abi->has_abi) {
+            const abi_serializer& abis = abi->get_serializer(yield);
+            return cached_abi_serializer(std::move(abi), &abis);
          }
 
-         return optional<abi_serializer>();
+         return cached_abi_serializer();
       };
    }
 };
@@ -2108,18 +2502,24 @@ read_only::get_scheduled_transactions( const read_only::get_scheduled_transactio
    return result;
 }
 
-fc::variant read_only::get_block(const read_only::get_block_params& params) const {
-   signed_block_ptr block;
-   optional<uint64_t> block_num;
+namespace {
+   optional<uint64_t> parse_block_num( const read_only::get_block_params& params ) {
+      EOS_ASSERT( !params.block_num_or_id.empty() && params.block_num_or_id.size() <= 64,
+                  chain::block_id_type_exception,
+                  "Invalid Block number or ID, must be greater than 0 and less than 64 characters"
+      );
 
-   EOS_ASSERT( !params.block_num_or_id.empty() && params.block_num_or_id.size() <= 64,
-               chain::block_id_type_exception,
-               "Invalid Block number or ID, must be greater than 0 and less than 64 characters"
-   );
+      optional<uint64_t> block_num;
+      try {
+         block_num = fc::to_uint64(params.block_num_or_id);
+      } catch( ... ) {}
+      return block_num;
+   }
+}
 
-   try {
-      block_num = fc::to_uint64(params.block_num_or_id);
-   } catch( ... ) {}
+signed_block_ptr read_only::get_raw_block(const read_only::get_block_params& params) const {
+   signed_block_ptr block;
+   optional<uint64_t> block_num = parse_block_num( params );
 
    if( block_num.valid() ) {
       block = db.fetch_block_by_number( *block_num );
@@ -2130,17 +2530,46 @@ fc::variant read_only::get_block(const read_only::get_block_params& params) cons
    }
 
    EOS_ASSERT( block, unknown_block_exception, "Could not find block: ${block}", ("block", params.block_num_or_id));
+   return block;
+}
+
+fc::variant read_only::get_block(const read_only::get_block_params& params) const {
+   optional<uint64_t> block_num = parse_block_num( params );
+
+   // irreversible blocks never change, only the ABIs their actions are decoded with might
+   string cache_key;
+   if( resp_cache ) {
+      cache_key = "get_block:" + (block_num.valid() ? std::to_string(*block_num) : params.block_num_or_id);
+      auto cached = resp_cache->get( db, cache_key );
+      if( !cached.is_null() )
+         return cached;
+   }
+
+   signed_block_ptr block = get_raw_block( params );
+
+   response_cache::abi_dependencies abis;
+   auto yield = abi_serializer::create_yield_function( abi_serializer_max_time );
+   auto resolver = [this, &abis, &yield]( const account_name& name ) -> cached_abi_serializer {
+      auto abi = eosio::chain_apis::get_cached_abi( abi_cache, db, name );
+      abis.emplace( name, abi );
+      if( abi && abi->has_abi )
+         return cached_abi_serializer( abi, &abi->get_serializer( yield ) );
+      return cached_abi_serializer();
+   };
 
    fc::variant pretty_output;
-   abi_serializer::to_variant(*block, pretty_output, make_resolver(this, abi_serializer::create_yield_function( abi_serializer_max_time )),
-                              abi_serializer::create_yield_function( abi_serializer_max_time ));
+   abi_serializer::to_variant(*block, pretty_output, resolver, yield);
 
    uint32_t ref_block_prefix = block->id()._hash[1];
 
-   return fc::mutable_variant_object(pretty_output.get_object())
+   fc::variant result = fc::mutable_variant_object(pretty_output.get_object())
            ("id", block->id())
            ("block_num",block->block_num())
            ("ref_block_prefix", ref_block_prefix);
+
+   if( resp_cache && block->block_num() <= db.last_irreversible_block_num() )
+      resp_cache->put( cache_key, result, std::move(abis) );
+   return result;
 }
 
 fc::variant read_only::get_block_header_state(const get_block_header_state_params& params) const {
@@ -2195,7 +2624,8 @@ void read_write::push_transaction(const read_write::push_transaction_params& par
             try {
                fc::variant output;
                try {
-                  output = db.to_variant_with_abi( *trx_trace_ptr, abi_serializer::create_yield_function( abi_serializer_max_time ) );
+                  auto yield = abi_serializer::create_yield_function( abi_serializer_max_time );
+                  abi_serializer::to_variant( *trx_trace_ptr, output, make_resolver(this, yield), yield );
 
                   // Create map of (closest_unnotified_ancestor_action_ordinal, global_sequence) with action trace
                   std::map< std::pair<uint32_t, uint64_t>, fc::mutable_variant_object > act_traces_map;
@@ -2295,6 +2725,71 @@ void read_write::push_transactions(const read_write::push_transactions_params& p
    } CATCH_AND_CALL(next);
 }
 
+vector<packed_transaction_ptr> read_write::unpack_packed_transactions( const std::string& body, bool batch ) {
+   EOS_ASSERT( !body.empty(), chain::invalid_http_request, "A Request body is required" );
+   vector<packed_transaction_ptr> trxs;
+   auto unpack = [&trxs]( const char* data, size_t size ) {
+      auto ptrx = std::make_shared<packed_transaction>();
+      try {
+         fc::datastream<const char*> ds( data, size );
+         fc::raw::unpack( ds, *ptrx );
+         EOS_ASSERT( ds.remaining() == 0, packed_transaction_type_exception, "trailing bytes after packed transaction" );
+      } EOS_RETHROW_EXCEPTIONS( chain::packed_transaction_type_exception, "Invalid packed transaction" )
+      trxs.emplace_back( std::move( ptrx ) );
+   };
+
+   if( !batch ) {
+      unpack( body.data(), body.size() );
+      return trxs;
+   }
+   size_t pos = 0;
+   while( pos < body.size() ) {
+      EOS_ASSERT( body.size() - pos >= sizeof(uint32_t), chain::invalid_http_request, "truncated transaction size" );
+      uint32_t size = 0;
+      for( size_t i = 0; i < sizeof(uint32_t); ++i )
+         size |= uint32_t( uint8_t( body[pos + i] ) ) << ( 8 * i );
+      pos += sizeof(uint32_t);
+      EOS_ASSERT( body.size() - pos >= size, chain::invalid_http_request, "truncated transaction of ${s} bytes", ("s", size) );
+      EOS_ASSERT( trxs.size() < 1000, too_many_tx_at_once, "Attempt to push too many transactions at once" );
+      unpack( body.data() + pos, size );
+      pos += size;
+   }
+   return trxs;
+}
+
+void read_write::push_packed_transactions( vector<packed_transaction_ptr> trxs, next_function<push_packed_transactions_results> next ) {
+   try {
+      // every transaction goes to the producer right away, its keys are recovered on the producer thread pool
+      // while the transactions ahead of it execute
+      auto results = std::make_shared<push_packed_transactions_results>( trxs.size() );
+      auto pending = std::make_shared<size_t>( trxs.size() );
+      if( trxs.empty() ) {
+         next( *results );
+         return;
+      }
+      for( size_t i = 0; i < trxs.size(); ++i ) {
+         (*results)[i].transaction_id = trxs[i]->id();
+         app().get_method<incoming::methods::transaction_async>()( trxs[i], true,
+               [results, pending, i, next]( const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result ) {
+            auto& r = (*results)[i];
+            if( result.contains<fc::exception_ptr>() ) {
+               r.error = result.get<fc::exception_ptr>()->to_detail_string();
+            } else {
+               const auto& trace = result.get<transaction_trace_ptr>();
+               r.block_num = trace->block_num;
+               if( trace->receipt ) r.receipt = *trace->receipt;
+               if( trace->except ) r.error = trace->except->to_detail_string();
+            }
+            if( --*pending == 0 ) next( *results );
+         });
+      }
+   } catch ( boost::interprocess::bad_alloc& ) {
+      chain_plugin::handle_db_exhaustion();
+   } catch ( const std::bad_alloc& ) {
+      chain_plugin::handle_bad_alloc();
+   } CATCH_AND_CALL(next);
+}
+
 void read_write::send_transaction(const read_write::send_transaction_params& params, next_function<read_write::send_transaction_results> next) {
 
    try {
@@ -2314,7 +2809,8 @@ void read_write::send_transaction(const read_write::send_transaction_params& par
             try {
                fc::variant output;
                try {
-                  output = db.to_variant_with_abi( *trx_trace_ptr, abi_serializer::create_yield_function( abi_serializer_max_time ) );
+                  auto yield = abi_serializer::create_yield_function( abi_serializer_max_time );
+                  abi_serializer::to_variant( *trx_trace_ptr, output, make_resolver(this, yield), yield );
                } catch( chain::abi_exception& ) {
                   output = *trx_trace_ptr;
                }
@@ -2331,15 +2827,69 @@ void read_write::send_transaction(const read_write::send_transaction_params& par
    } CATCH_AND_CALL(next);
 }
 
+void read_write::dry_run_transaction(const read_write::dry_run_transaction_params& params, next_function<read_write::dry_run_transaction_results> next) {
+
+   try {
+      auto pretty_input = std::make_shared<packed_transaction>();
+      auto resolver = make_resolver(this, abi_serializer::create_yield_function( abi_serializer_max_time ));
+      try {
+         abi_serializer::from_variant(params, *pretty_input, resolver, abi_serializer::create_yield_function( abi_serializer_max_time ));
+      } EOS_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transaction")
+
+      const fc::microseconds max_trx_cpu_usage( db.get_global_properties().configuration.max_transaction_cpu_usage );
+      auto future = transaction_metadata::start_recover_keys( pretty_input, db.get_thread_pool(), db.get_chain_id(), max_trx_cpu_usage,
+                                                              db.configured_subjective_signature_length_limit(),
+                                                              transaction_metadata::trx_type::dry_run );
+
+      // keys are recovered on the thread pool, only the execution itself takes the main thread
+      boost::asio::post( db.get_thread_pool(), [this, future{std::move(future)}, next, max_trx_cpu_usage]() mutable {
+         future.wait();
+         app().post( priority::low, [this, future{std::move(future)}, next, max_trx_cpu_usage]() mutable {
+            try {
+               auto trx = future.get();
+               EOS_ASSERT( db.is_building_block(), block_validate_exception, "no pending block to dry run the transaction in" );
+
+               // bounded like the incoming transactions by max-transaction-time and the pending block deadline, the
+               // main thread is not held any longer for a transaction which never gets into a block
+               fc::time_point deadline = fc::time_point::now() + max_trx_cpu_usage;
+               try {
+                  deadline = std::min( deadline, app().get_method<incoming::methods::transaction_deadline>()() );
+               } catch( const std::exception& ) {
+                  // no producer_plugin provides it, the chain limit is the only bound
+               }
+               auto trx_trace_ptr = db.push_transaction( trx, deadline, 0, false );
+               fc::variant output;
+               try {
+                  auto yield = abi_serializer::create_yield_function( abi_serializer_max_time );
+                  abi_serializer::to_variant( *trx_trace_ptr, output, make_resolver(this, yield), yield );
+               } catch( chain::abi_exception& ) {
+                  output = *trx_trace_ptr;
+               }
+
+               next(read_write::dry_run_transaction_results{trx_trace_ptr->id, output});
+            } catch ( boost::interprocess::bad_alloc& ) {
+               chain_plugin::handle_db_exhaustion();
+            } catch ( const std::bad_alloc& ) {
+               chain_plugin::handle_bad_alloc();
+            } CATCH_AND_CALL(next);
+         });
+      });
+   } catch ( boost::interprocess::bad_alloc& ) {
+      chain_plugin::handle_db_exhaustion();
+   } catch ( const std::bad_alloc& ) {
+      chain_plugin::handle_bad_alloc();
+   } CATCH_AND_CALL(next);
+}
+
 read_only::get_abi_results read_only::get_abi( const get_abi_params& params )const {
    get_abi_results result;
    result.account_name = params.account_name;
    const auto& d = db.db();
-   const auto& accnt  = d.get<account_object,by_name>( params.account_name );
+   d.get<account_object,by_name>( params.account_name ); // asserts the account exists
 
-   abi_def abi;
-   if( abi_serializer::to_abi(accnt.abi, abi) ) {
-      result.abi = std::move(abi);
+   const auto abi = get_cached_abi( params.account_name );
+   if( abi->has_abi ) {
+      result.abi = abi->abi;
    }
 
    return result;
@@ -2413,6 +2963,10 @@ read_only::get_raw_abi_results read_only::get_raw_abi( const get_raw_abi_params&
 }
 
 read_only::get_account_results read_only::get_account( const get_account_params& params )const {
+   return head_block_cached<get_account_results>( "get_account", params, [&]() { return get_account_uncached( params ); } );
+}
+
+read_only::get_account_results read_only::get_account_uncached( const get_account_params& params )const {
    get_account_results result;
    result.account_name = params.account_name;
 
@@ -2455,11 +3009,9 @@ read_only::get_account_results read_only::get_account( const get_account_params&
       ++perm;
    }
 
-   const auto& code_account = db.db().get<account_object,by_name>( config::system_account_name );
-
-   abi_def abi;
-   if( abi_serializer::to_abi(code_account.abi, abi) ) {
-      abi_serializer abis( abi, abi_serializer::create_yield_function( abi_serializer_max_time ) );
+   const auto system_abi = get_cached_abi( config::system_account_name );
+   if( system_abi->has_abi ) {
+      const abi_serializer& abis = system_abi->get_serializer( abi_serializer::create_yield_function( abi_serializer_max_time ) );
 
       const auto token_code = N(eosio.token);
 
@@ -2554,9 +3106,10 @@ read_only::abi_json_to_bin_result read_only::abi_json_to_bin( const read_only::a
    const auto code_account = db.db().find<account_object,by_name>( params.code );
    EOS_ASSERT(code_account != nullptr, contract_query_exception, "Contract can't be found ${contract}", ("contract", params.code));
 
-   abi_def abi;
-   if( abi_serializer::to_abi(code_account->abi, abi) ) {
-      abi_serializer abis( abi, abi_serializer::create_yield_function( abi_serializer_max_time ) );
+   const auto code_abi = get_cached_abi( params.code );
+   if( code_abi->has_abi ) {
+      const abi_def& abi = code_abi->abi;
+      const abi_serializer& abis = code_abi->get_serializer( abi_serializer::create_yield_function( abi_serializer_max_time ) );
       auto action_type = abis.get_action_type(params.action);
       EOS_ASSERT(!action_type.empty(), action_validate_exception, "Unknown action ${action} in contract ${contract}", ("action", params.action)("contract", params.code));
       try {
@@ -2573,10 +3126,9 @@ read_only::abi_json_to_bin_result read_only::abi_json_to_bin( const read_only::a
 
 read_only::abi_bin_to_json_result read_only::abi_bin_to_json( const read_only::abi_bin_to_json_params& params )const {
    abi_bin_to_json_result result;
-   const auto& code_account = db.db().get<account_object,by_name>( params.code );
-   abi_def abi;
-   if( abi_serializer::to_abi(code_account.abi, abi) ) {
-      abi_serializer abis( abi, abi_serializer::create_yield_function( abi_serializer_max_time ) );
+   const auto code_abi = get_cached_abi( params.code );
+   if( code_abi->has_abi ) {
+      const abi_serializer& abis = code_abi->get_serializer( abi_serializer::create_yield_function( abi_serializer_max_time ) );
       result.args = abis.binary_to_variant( abis.get_action_type( params.action ), params.binargs, abi_serializer::create_yield_function( abi_serializer_max_time ), shorten_abi_errors );
    } else {
       EOS_ASSERT(false, abi_not_found_exception, "No ABI found for ${contract}", ("contract", params.code));
@@ -2601,12 +3153,55 @@ read_only::get_transaction_id_result read_only::get_transaction_id( const read_o
    return params.id();
 }
 
+read_only::get_eosvmoc_metrics_results read_only::get_eosvmoc_metrics( const read_only::get_eosvmoc_metrics_params& )const {
+   get_eosvmoc_metrics_results results;
+   results.enabled = db.get_wasm_interface().get_eosvmoc_metrics( results.metrics );
+   return results;
+}
+
 account_query_db::get_accounts_by_authorizers_result read_only::get_accounts_by_authorizers( const account_query_db::get_accounts_by_authorizers_params& args) const
 {
    EOS_ASSERT(aqdb.valid(), plugin_config_exception, "Account Queries being accessed when not enabled");
    return aqdb->get_accounts_by_authorizers(args);
 }
 
+read_only::get_account_tokens_result read_only::get_account_tokens( const read_only::get_account_tokens_params& p )const {
+   EOS_ASSERT(atdb != nullptr, plugin_config_exception, "Account tokens index being accessed when not enabled");
+
+   get_account_tokens_result result;
+   const auto& d = db.db();
+   const auto& idx = d.get_index<chain::key_value_index, chain::by_scope_primary>();
+   const auto deadline = fc::time_point::now() + fc::milliseconds(10);
+   const uint32_t limit = std::max<uint32_t>( p.limit, 1 );
+   uint32_t count = 0;
+
+   atdb->for_each_token( p.account, p.lower_bound, [&]( name code, const table_id_object& t_id ) {
+      if( count == limit || fc::time_point::now() > deadline ) {
+         result.more = code;
+         return false;
+      }
+      ++count;
+
+      // rows of contracts that do not store an asset first are not token balances, skipped like those of other symbols
+      decltype(t_id.id) next_tid(t_id.id._id + 1);
+      auto upper = idx.lower_bound(boost::make_tuple(next_tid));
+      for( auto itr = idx.lower_bound(boost::make_tuple(t_id.id)); itr != upper; ++itr ) {
+         if( itr->value.size() < sizeof(asset) )
+            continue;
+         asset balance;
+         fc::datastream<const char *> ds(itr->value.data(), itr->value.size());
+         fc::raw::unpack(ds, balance);
+         if( !balance.get_symbol().valid() )
+            continue;
+         if( !p.symbol || boost::iequals(balance.symbol_name(), *p.symbol) )
+            result.tokens.push_back( { code, balance } );
+      }
+      return true;
+   });
+
+   return result;
+}
+
 namespace detail {
    struct ram_market_exchange_state_t {
       asset  ignore1;
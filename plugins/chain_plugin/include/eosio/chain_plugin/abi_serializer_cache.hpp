@@ -0,0 +1,90 @@
+#pragma once
+#include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/types.hpp>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace eosio { namespace chain { class controller; } }
+
+namespace eosio::chain_apis {
+   /**
+    * The ABI of an account, parsed once, and its abi_serializer built on first use.
+    * Immutable apart from the lazily built serializer, safe to share between threads.
+    */
+   class cached_abi {
+   public:
+      cached_abi( chain::abi_def abi, bool has_abi, const chain::abi_version& version );
+
+      const chain::abi_def      abi;
+      const bool                has_abi; // false if the account has no ABI set, abi is empty then
+      const chain::abi_version  version;
+
+      /**
+       * Builds the serializer on the first call, yield bounds that construction. Requires has_abi.
+       * A construction that throws is retried by the next call.
+       */
+      const chain::abi_serializer& get_serializer( const chain::abi_serializer::yield_function_t& yield ) const;
+
+   private:
+      mutable std::once_flag                        _serializer_once;
+      mutable fc::optional<chain::abi_serializer>   _serializer;
+   };
+   using cached_abi_ptr = std::shared_ptr<const cached_abi>;
+
+   /**
+    * What an abi_serializer resolver returns for a cached ABI, an account without ABI is not valid().
+    * The data of actions resolved through it is shared by chain::decoded_action_cache.
+    */
+   class cached_abi_serializer {
+   public:
+      cached_abi_serializer() = default;
+      cached_abi_serializer( cached_abi_ptr abi, const chain::abi_serializer* serializer )
+      : _abi( std::move(abi) ), _serializer( serializer ) {}
+
+      bool valid() const { return _serializer != nullptr; }
+      const chain::abi_serializer* operator->() const { return _serializer; }
+      const chain::abi_serializer& operator*() const { return *_serializer; }
+
+      const chain::abi_version& decoded_action_key() const { return _abi->version; }
+
+   private:
+      cached_abi_ptr                _abi; // keeps _serializer alive after eviction
+      const chain::abi_serializer*  _serializer = nullptr;
+   };
+
+   /**
+    * Bounded LRU cache of account ABIs shared by the chain API calls, so an ABI is not re-parsed and its serializer
+    * not rebuilt by every call. An entry is reused as long as the abi_sequence of the account and the hash of its ABI
+    * are unchanged, the hash catches a setabi rolled back with the pending block or a fork and redone differently.
+    * Thread safe.
+    */
+   class abi_serializer_cache {
+   public:
+      explicit abi_serializer_cache( size_t max_size );
+
+      /**
+       * @return ABI of account, empty abi_def if the account has no ABI, nullptr if the account does not exist
+       */
+      cached_abi_ptr get( const chain::controller& db, chain::account_name account );
+
+      size_t size() const;
+
+   private:
+      struct entry {
+         chain::account_name  account;
+         uint64_t             abi_sequence = 0;
+         fc::sha256           abi_hash;
+         cached_abi_ptr       abi;
+      };
+      using lru_list = std::list<entry>;
+
+      const size_t                                       _max_size;
+      mutable std::mutex                                 _mtx;
+      lru_list                                           _lru; // most recently used first
+      std::map<chain::account_name, lru_list::iterator>  _by_account;
+   };
+
+} // namespace eosio::chain_apis
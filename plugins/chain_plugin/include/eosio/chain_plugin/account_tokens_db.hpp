@@ -0,0 +1,57 @@
+#pragma once
+#include <eosio/chain/types.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
+
+#include <functional>
+#include <memory>
+
+namespace eosio::chain {
+   class controller;
+}
+
+namespace eosio::chain_apis {
+   /**
+    * Ephemeral reverse index from an account to the token contracts it holds a balance table with, i.e. the codes
+    * of the `accounts` tables scoped by the account. It provides the `get_account_tokens` RPC call with one range
+    * scan instead of a probe of every known token contract.
+    *
+    * There is no persistence, the index is recreated from the state at the current HEAD when the class is
+    * instantiated and kept up to date through the table lifecycle callback of the controller. Tables created or
+    * removed in reversible blocks stay indexed until their block is irreversible, so the index is a superset of the
+    * state and every lookup is confirmed against the state.
+    *
+    * Not thread safe, to be used on the main thread only.
+    */
+   class account_tokens_db {
+   public:
+      /**
+       * The caller is expected to manage lifetimes such that this controller reference does not go stale
+       * for the life of the account tokens DB
+       * @param chain - controller to read data from
+       */
+      account_tokens_db( const chain::controller& chain );
+      ~account_tokens_db();
+
+      account_tokens_db(account_tokens_db&&);
+      account_tokens_db& operator=(account_tokens_db&&);
+
+      /// a contract table was created or is about to be removed, from the controller's table lifecycle callback
+      void table_changed( const chain::table_id_object& tid );
+
+      /// drops the tables no longer in the state whose last change is irreversible
+      void commit_irreversible( uint32_t lib );
+
+      /**
+       * Calls f with the code and table of the token balances of account in ascending code order starting at
+       * lower_bound, until f returns false.
+       */
+      void for_each_token( chain::name account, chain::name lower_bound,
+                           const std::function<bool(chain::name code, const chain::table_id_object& tid)>& f ) const;
+
+      size_t size() const;
+
+   private:
+      std::unique_ptr<struct account_tokens_db_impl> _impl;
+   };
+
+}
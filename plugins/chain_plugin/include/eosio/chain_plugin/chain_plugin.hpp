@@ -17,6 +17,9 @@
 #include <boost/multiprecision/cpp_int.hpp>
 
 #include <eosio/chain_plugin/account_query_db.hpp>
+#include <eosio/chain_plugin/account_tokens_db.hpp>
+#include <eosio/chain_plugin/abi_serializer_cache.hpp>
+#include <eosio/chain_plugin/response_cache.hpp>
 
 #include <fc/static_variant.hpp>
 
@@ -83,12 +86,19 @@ class read_only {
    const fc::optional<account_query_db>& aqdb;
    const fc::microseconds abi_serializer_max_time;
    bool  shorten_abi_errors = true;
+   abi_serializer_cache* abi_cache = nullptr; // ABIs are parsed by every call without
+   response_cache* resp_cache = nullptr; // responses for irreversible blocks are decoded by every call without
+   head_block_response_cache* head_cache = nullptr; // polls are answered from the state by every call without
+   const account_tokens_db* atdb = nullptr; // get_account_tokens is disabled without
 
 public:
    static const string KEYi64;
 
-   read_only(const controller& db, const fc::optional<account_query_db>& aqdb, const fc::microseconds& abi_serializer_max_time)
-      : db(db), aqdb(aqdb), abi_serializer_max_time(abi_serializer_max_time) {}
+   read_only(const controller& db, const fc::optional<account_query_db>& aqdb, const fc::microseconds& abi_serializer_max_time,
+             abi_serializer_cache* abi_cache = nullptr, response_cache* resp_cache = nullptr,
+             head_block_response_cache* head_cache = nullptr, const account_tokens_db* atdb = nullptr)
+      : db(db), aqdb(aqdb), abi_serializer_max_time(abi_serializer_max_time), abi_cache(abi_cache), resp_cache(resp_cache),
+        head_cache(head_cache), atdb(atdb) {}
 
    void validate() const {}
 
@@ -277,11 +287,22 @@ public:
 
    get_transaction_id_result get_transaction_id( const get_transaction_id_params& params)const;
 
+   using get_eosvmoc_metrics_params = empty;
+   struct get_eosvmoc_metrics_results {
+      bool                               enabled = false; ///< false unless eos-vm-oc-enable is set
+      chain::eosvmoc::code_cache_metrics metrics;
+   };
+
+   /// must be called on the main thread
+   get_eosvmoc_metrics_results get_eosvmoc_metrics( const get_eosvmoc_metrics_params& )const;
+
    struct get_block_params {
       string block_num_or_id;
    };
 
    fc::variant get_block(const get_block_params& params) const;
+   /// the block as stored, for responses packed with fc::raw instead of decoded with the ABIs
+   chain::signed_block_ptr get_raw_block(const get_block_params& params) const;
 
    struct get_block_header_state_params {
       string block_num_or_id;
@@ -303,16 +324,46 @@ public:
       string      encode_type{"dec"}; //dec, hex , default=dec
       optional<bool>  reverse;
       optional<bool>  show_payer; // show RAM pyer
+      string      cursor; // next_cursor of the previous page, the page starts exactly there within lower_bound and upper_bound
     };
 
    struct get_table_rows_result {
       vector<fc::variant> rows; ///< one row per item, either encoded as hex String or JSON object
       bool                more = false; ///< true if last element in data is not the end and sizeof data() < limit
       string              next_key; ///< fill lower_bound with this value to fetch more rows
+      string              next_cursor; ///< fill cursor with this value to fetch more rows, unlike next_key exact for secondary keys with duplicates
+   };
+
+   /// position of the next row in a table index, next_cursor/cursor of get_table_rows are this packed and hex encoded
+   struct table_rows_cursor {
+      name         code;
+      name         scope;
+      name         index_table;   // table name of the index
+      bool         reverse = false;
+      uint64_t     primary_key = 0;
+      vector<char> secondary_key; // bytes of the secondary key, empty for the primary index
    };
 
    get_table_rows_result get_table_rows( const get_table_rows_params& params )const;
 
+   static constexpr uint32_t max_table_rows_batch_size = 1000;
+
+   struct get_table_rows_batch_params {
+      vector<get_table_rows_params> queries; // at most max_table_rows_batch_size, e.g. one per scope of a token contract
+   };
+
+   struct get_table_rows_batch_entry {
+      optional<get_table_rows_result> result;
+      optional<string>                error; ///< the query failed, the other queries of the batch are answered anyway
+   };
+
+   struct get_table_rows_batch_result {
+      vector<get_table_rows_batch_entry> results; ///< one per query in the same order
+      bool                               more = false; ///< the batch ran out of time, send the queries past the end of results again
+   };
+
+   get_table_rows_batch_result get_table_rows_batch( const get_table_rows_batch_params& params )const;
+
    struct get_table_by_scope_params {
       name        code; // mandatory
       name        table; // optional, act as filter
@@ -343,6 +394,26 @@ public:
 
    vector<asset> get_currency_balance( const get_currency_balance_params& params )const;
 
+   struct get_account_tokens_params {
+      name             account;
+      name             lower_bound; ///< first token contract
+      uint32_t         limit = 100; ///< token contracts
+      optional<string> symbol;
+   };
+
+   struct account_token {
+      name  code;
+      asset balance;
+   };
+
+   struct get_account_tokens_result {
+      vector<account_token> tokens;
+      optional<name>        more; ///< fill lower_bound with this value to fetch more tokens
+   };
+
+   /// balances of account in the `accounts` tables of all contracts, requires enable-account-tokens-index
+   get_account_tokens_result get_account_tokens( const get_account_tokens_params& params )const;
+
    struct get_currency_stats_params {
       name           code;
       string         symbol;
@@ -421,15 +492,35 @@ public:
 
    static uint64_t get_table_index_name(const read_only::get_table_rows_params& p, bool& primary);
 
+   static string encode_table_rows_cursor( const table_rows_cursor& c );
+   /// decodes p.cursor, which must have been returned for the same table, scope, index and direction
+   static table_rows_cursor decode_table_rows_cursor( const read_only::get_table_rows_params& p, name scope, name index_table );
+
+   template<typename SecondaryKey>
+   static vector<char> secondary_key_bytes( const SecondaryKey& k ) {
+      static_assert( std::is_trivially_copyable<SecondaryKey>::value, "secondary key must be trivially copyable" );
+      vector<char> bytes( sizeof(k) );
+      memcpy( bytes.data(), &k, sizeof(k) );
+      return bytes;
+   }
+
+   template<typename SecondaryKey>
+   static SecondaryKey secondary_key_from_bytes( const vector<char>& bytes ) {
+      static_assert( std::is_trivially_copyable<SecondaryKey>::value, "secondary key must be trivially copyable" );
+      EOS_ASSERT( bytes.size() == sizeof(SecondaryKey), chain::contract_table_query_exception, "Invalid cursor for this index" );
+      SecondaryKey k;
+      memcpy( &k, bytes.data(), sizeof(k) );
+      return k;
+   }
+
    template <typename IndexType, typename SecKeyType, typename ConvFn>
-   read_only::get_table_rows_result get_table_rows_by_seckey( const read_only::get_table_rows_params& p, const abi_def& abi, ConvFn conv )const {
+   read_only::get_table_rows_result get_table_rows_by_seckey( const read_only::get_table_rows_params& p, const cached_abi& abi, ConvFn conv )const {
       read_only::get_table_rows_result result;
       const auto& d = db.db();
 
       name scope{ convert_to_type<uint64_t>(p.scope, "scope") };
 
-      abi_serializer abis;
-      abis.set_abi(abi, abi_serializer::create_yield_function( abi_serializer_max_time ) );
+      const abi_serializer& abis = abi.get_serializer( abi_serializer::create_yield_function( abi_serializer_max_time ) );
       bool primary = false;
       const uint64_t table_with_index = get_table_index_name(p, primary);
       const auto* t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple(p.code, scope, p.table));
@@ -468,6 +559,14 @@ public:
             }
          }
 
+         const bool reverse = p.reverse && *p.reverse;
+         if( !p.cursor.empty() ) {
+            auto c = decode_table_rows_cursor( p, scope, name(table_with_index) );
+            auto& bound = reverse ? upper_bound_lookup_tuple : lower_bound_lookup_tuple;
+            std::get<1>(bound) = secondary_key_from_bytes<secondary_key_type>( c.secondary_key );
+            std::get<2>(bound) = c.primary_key;
+         }
+
          if( upper_bound_lookup_tuple < lower_bound_lookup_tuple )
             return result;
 
@@ -498,12 +597,14 @@ public:
             if( itr != end_itr ) {
                result.more = true;
                result.next_key = convert_to_string(itr->secondary_key, p.key_type, p.encode_type, "next_key - next lower bound");
+               result.next_cursor = encode_table_rows_cursor( { p.code, scope, name(table_with_index), reverse,
+                                                                itr->primary_key, secondary_key_bytes( itr->secondary_key ) } );
             }
          };
 
          auto lower = secidx.lower_bound( lower_bound_lookup_tuple );
          auto upper = secidx.upper_bound( upper_bound_lookup_tuple );
-         if( p.reverse && *p.reverse ) {
+         if( reverse ) {
             walk_table_row_range( boost::make_reverse_iterator(upper), boost::make_reverse_iterator(lower) );
          } else {
             walk_table_row_range( lower, upper );
@@ -513,14 +614,13 @@ public:
    }
 
    template <typename IndexType>
-   read_only::get_table_rows_result get_table_rows_ex( const read_only::get_table_rows_params& p, const abi_def& abi )const {
+   read_only::get_table_rows_result get_table_rows_ex( const read_only::get_table_rows_params& p, const cached_abi& abi )const {
       read_only::get_table_rows_result result;
       const auto& d = db.db();
 
       uint64_t scope = convert_to_type<uint64_t>(p.scope, "scope");
 
-      abi_serializer abis;
-      abis.set_abi(abi, abi_serializer::create_yield_function( abi_serializer_max_time ));
+      const abi_serializer& abis = abi.get_serializer( abi_serializer::create_yield_function( abi_serializer_max_time ) );
       const auto* t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple(p.code, name(scope), p.table));
       if( t_id != nullptr ) {
          const auto& idx = d.get_index<IndexType, chain::by_scope_primary>();
@@ -547,6 +647,13 @@ public:
             }
          }
 
+         const bool reverse = p.reverse && *p.reverse;
+         if( !p.cursor.empty() ) {
+            auto c = decode_table_rows_cursor( p, name(scope), p.table );
+            EOS_ASSERT( c.secondary_key.empty(), chain::contract_table_query_exception, "Invalid cursor for this index" );
+            std::get<1>(reverse ? upper_bound_lookup_tuple : lower_bound_lookup_tuple) = c.primary_key;
+         }
+
          if( upper_bound_lookup_tuple < lower_bound_lookup_tuple  )
             return result;
 
@@ -573,12 +680,13 @@ public:
             if( itr != end_itr ) {
                result.more = true;
                result.next_key = convert_to_string(itr->primary_key, p.key_type, p.encode_type, "next_key - next lower bound");
+               result.next_cursor = encode_table_rows_cursor( { p.code, name(scope), p.table, reverse, itr->primary_key, {} } );
             }
          };
 
          auto lower = idx.lower_bound( lower_bound_lookup_tuple );
          auto upper = idx.upper_bound( upper_bound_lookup_tuple );
-         if( p.reverse && *p.reverse ) {
+         if( reverse ) {
             walk_table_row_range( boost::make_reverse_iterator(upper), boost::make_reverse_iterator(lower) );
          } else {
             walk_table_row_range( lower, upper );
@@ -593,15 +701,28 @@ public:
 
    chain::symbol extract_core_symbol()const;
 
+   /// ABI of account, throws if the account does not exist
+   cached_abi_ptr get_cached_abi( const name& account )const;
+
    friend struct resolver_factory<read_only>;
+
+private:
+   /// the result of f, or of an identical call at the same head block
+   template<typename Result, typename Params, typename F>
+   Result head_block_cached( const char* call_name, const Params& params, F&& f )const;
+
+   get_producers_result get_producers_uncached( const get_producers_params& params )const;
+   get_account_results get_account_uncached( const get_account_params& params )const;
 };
 
 class read_write {
    controller& db;
    const fc::microseconds abi_serializer_max_time;
    const bool api_accept_transactions;
+   abi_serializer_cache* abi_cache = nullptr;
 public:
-   read_write(controller& db, const fc::microseconds& abi_serializer_max_time, bool api_accept_transactions);
+   read_write(controller& db, const fc::microseconds& abi_serializer_max_time, bool api_accept_transactions,
+              abi_serializer_cache* abi_cache = nullptr);
    void validate() const;
 
    using push_block_params = chain::signed_block;
@@ -624,6 +745,26 @@ public:
    using send_transaction_results = push_transaction_results;
    void send_transaction(const send_transaction_params& params, chain::plugin_interface::next_function<send_transaction_results> next);
 
+   /// body of push_packed_transaction(s): the fc::raw packed_transaction, or with batch a sequence of packed_transactions
+   /// each preceded by its size as a little endian uint32. Does not touch the chain state, may be called on any thread.
+   static vector<chain::packed_transaction_ptr> unpack_packed_transactions( const std::string& body, bool batch );
+
+   struct push_packed_transaction_results {
+      chain::transaction_id_type                      transaction_id;
+      uint32_t                                        block_num = 0;
+      fc::optional<chain::transaction_receipt_header> receipt;
+      fc::optional<string>                            error;
+   };
+   using push_packed_transactions_results = vector<push_packed_transaction_results>;
+   /// pushes binary transactions without any ABI conversion of the transactions or of their traces
+   void push_packed_transactions( vector<chain::packed_transaction_ptr> trxs,
+                                  chain::plugin_interface::next_function<push_packed_transactions_results> next );
+
+   /// executes the transaction in the pending block and returns its trace, its changes are always reverted
+   using dry_run_transaction_params = push_transaction_params;
+   using dry_run_transaction_results = push_transaction_results;
+   void dry_run_transaction(const dry_run_transaction_params& params, chain::plugin_interface::next_function<dry_run_transaction_results> next);
+
    friend resolver_factory<read_write>;
 };
 
@@ -711,7 +852,7 @@ public:
    void plugin_startup();
    void plugin_shutdown();
 
-   chain_apis::read_write get_read_write_api() { return chain_apis::read_write(chain(), get_abi_serializer_max_time(), api_accept_transactions()); }
+   chain_apis::read_write get_read_write_api();
    chain_apis::read_only get_read_only_api() const;
 
    bool accept_block( const chain::signed_block_ptr& block, const chain::block_id_type& id );
@@ -740,6 +881,10 @@ public:
    const controller& chain() const;
 
    chain::chain_id_type get_chain_id() const;
+   /// neither a state database nor a blocks.log existed and no snapshot was given, the chain starts from its genesis state
+   bool fresh_state() const;
+   /// start the chain of a fresh_state from the snapshot at p instead, only between plugin_initialize() and plugin_startup()
+   void set_startup_snapshot( const fc::path& p );
    fc::microseconds get_abi_serializer_max_time() const;
    bool api_accept_transactions() const;
    // set true by other plugins if any plugin allows transactions
@@ -753,6 +898,7 @@ public:
    static void handle_bad_alloc();
 
    bool account_queries_enabled() const;
+   bool account_tokens_enabled() const;
 private:
    static void log_guard_exception(const chain::guard_exception& e);
 
@@ -774,15 +920,23 @@ FC_REFLECT(eosio::chain_apis::read_only::get_block_params, (block_num_or_id))
 FC_REFLECT(eosio::chain_apis::read_only::get_block_header_state_params, (block_num_or_id))
 
 FC_REFLECT( eosio::chain_apis::read_write::push_transaction_results, (transaction_id)(processed) )
+FC_REFLECT( eosio::chain_apis::read_write::push_packed_transaction_results, (transaction_id)(block_num)(receipt)(error) )
 
-FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_params, (json)(code)(scope)(table)(table_key)(lower_bound)(upper_bound)(limit)(key_type)(index_position)(encode_type)(reverse)(show_payer) )
-FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_result, (rows)(more)(next_key) );
+FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_params, (json)(code)(scope)(table)(table_key)(lower_bound)(upper_bound)(limit)(key_type)(index_position)(encode_type)(reverse)(show_payer)(cursor) )
+FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_result, (rows)(more)(next_key)(next_cursor) );
+FC_REFLECT( eosio::chain_apis::read_only::table_rows_cursor, (code)(scope)(index_table)(reverse)(primary_key)(secondary_key) )
 
+FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_batch_params, (queries) )
+FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_batch_entry, (result)(error) )
+FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_batch_result, (results)(more) )
 FC_REFLECT( eosio::chain_apis::read_only::get_table_by_scope_params, (code)(table)(lower_bound)(upper_bound)(limit)(reverse) )
 FC_REFLECT( eosio::chain_apis::read_only::get_table_by_scope_result_row, (code)(scope)(table)(payer)(count));
 FC_REFLECT( eosio::chain_apis::read_only::get_table_by_scope_result, (rows)(more) );
 
 FC_REFLECT( eosio::chain_apis::read_only::get_currency_balance_params, (code)(account)(symbol));
+FC_REFLECT( eosio::chain_apis::read_only::get_account_tokens_params, (account)(lower_bound)(limit)(symbol));
+FC_REFLECT( eosio::chain_apis::read_only::account_token, (code)(balance));
+FC_REFLECT( eosio::chain_apis::read_only::get_account_tokens_result, (tokens)(more));
 FC_REFLECT( eosio::chain_apis::read_only::get_currency_stats_params, (code)(symbol));
 FC_REFLECT( eosio::chain_apis::read_only::get_currency_stats_result, (supply)(max_supply)(issuer));
 
@@ -818,4 +972,5 @@ FC_REFLECT( eosio::chain_apis::read_only::abi_bin_to_json_params, (code)(action)
 FC_REFLECT( eosio::chain_apis::read_only::abi_bin_to_json_result, (args) )
 FC_REFLECT( eosio::chain_apis::read_only::get_required_keys_params, (transaction)(available_keys) )
 FC_REFLECT( eosio::chain_apis::read_only::get_required_keys_result, (required_keys) )
+FC_REFLECT( eosio::chain_apis::read_only::get_eosvmoc_metrics_results, (enabled)(metrics) )
 
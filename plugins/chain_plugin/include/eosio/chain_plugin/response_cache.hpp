@@ -0,0 +1,83 @@
+#pragma once
+#include <eosio/chain_plugin/abi_serializer_cache.hpp>
+
+#include <fc/variant.hpp>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace eosio::chain_apis {
+   /**
+    * Bounded LRU cache of chain API responses for immutable data, e.g. the JSON of an irreversible block.
+    * Such a response still depends on the ABIs it was decoded with, so an entry records the ABIs of the accounts
+    * it used and is only returned while the ABI cache hands out the same ABIs, a setabi of any of them drops it.
+    * Thread safe.
+    */
+   class response_cache {
+   public:
+      using abi_dependencies = std::map<chain::account_name, cached_abi_ptr>;
+
+      response_cache( size_t max_size, abi_serializer_cache& abi_cache );
+
+      /**
+       * @return the response stored for key, null if there is none or an ABI it was decoded with has changed
+       */
+      fc::variant get( const chain::controller& db, const std::string& key );
+      void put( const std::string& key, fc::variant response, abi_dependencies abis );
+
+      size_t size() const;
+
+   private:
+      struct entry {
+         std::string       key;
+         fc::variant       response;
+         abi_dependencies  abis;
+      };
+      using lru_list = std::list<entry>;
+
+      const size_t                                         _max_size;
+      abi_serializer_cache&                                _abi_cache;
+      mutable std::mutex                                   _mtx;
+      lru_list                                             _lru; // most recently used first
+      std::unordered_map<std::string, lru_list::iterator>  _by_key;
+   };
+
+   /**
+    * Results of chain API calls on the current state, e.g. get_producers, keyed by call and params. All entries are
+    * dropped once the head block changes, so the same poll within a block is a lookup. Results may miss changes made
+    * by the transactions of the pending block since the first call. Thread safe.
+    */
+   class head_block_response_cache {
+   public:
+      explicit head_block_response_cache( size_t max_size );
+
+      /**
+       * @return the result stored for key at head_id, null if there is none; T must be the type key was put with
+       */
+      template<typename T>
+      std::shared_ptr<const T> get( const chain::block_id_type& head_id, const std::string& key ) {
+         return std::static_pointer_cast<const T>( get_entry( head_id, key ) );
+      }
+
+      template<typename T>
+      void put( const chain::block_id_type& head_id, const std::string& key, T result ) {
+         put_entry( head_id, key, std::make_shared<const T>( std::move( result ) ) );
+      }
+
+      size_t size() const;
+
+   private:
+      std::shared_ptr<const void> get_entry( const chain::block_id_type& head_id, const std::string& key );
+      void put_entry( const chain::block_id_type& head_id, const std::string& key, std::shared_ptr<const void> result );
+
+      const size_t                                                  _max_size;
+      mutable std::mutex                                            _mtx;
+      chain::block_id_type                                          _head_id;
+      std::unordered_map<std::string, std::shared_ptr<const void>>  _entries; // all for _head_id
+   };
+
+} // namespace eosio::chain_apis
@@ -0,0 +1,89 @@
+#include <eosio/chain_plugin/response_cache.hpp>
+
+namespace eosio::chain_apis {
+
+response_cache::response_cache( size_t max_size, abi_serializer_cache& abi_cache )
+: _max_size( max_size ), _abi_cache( abi_cache ) {}
+
+fc::variant response_cache::get( const chain::controller& db, const std::string& key ) {
+   fc::variant response;
+   abi_dependencies abis;
+   {
+      std::lock_guard<std::mutex> g( _mtx );
+      auto itr = _by_key.find( key );
+      if( itr == _by_key.end() )
+         return fc::variant();
+      _lru.splice( _lru.begin(), _lru, itr->second );
+      response = itr->second->response;
+      abis = itr->second->abis;
+   }
+
+   // the ABI cache holds the current ABIs outside of the lock, an entry evicted there counts as changed
+   for( const auto& a : abis ) {
+      if( _abi_cache.get( db, a.first ) != a.second ) {
+         std::lock_guard<std::mutex> g( _mtx );
+         auto itr = _by_key.find( key );
+         if( itr != _by_key.end() && itr->second->abis == abis ) {
+            _lru.erase( itr->second );
+            _by_key.erase( itr );
+         }
+         return fc::variant();
+      }
+   }
+   return response;
+}
+
+void response_cache::put( const std::string& key, fc::variant response, abi_dependencies abis ) {
+   if( _max_size == 0 )
+      return;
+
+   std::lock_guard<std::mutex> g( _mtx );
+   auto itr = _by_key.find( key );
+   if( itr != _by_key.end() ) {
+      _lru.erase( itr->second );
+      _by_key.erase( itr );
+   }
+   _lru.push_front( entry{ key, std::move(response), std::move(abis) } );
+   _by_key.emplace( key, _lru.begin() );
+   if( _lru.size() > _max_size ) {
+      _by_key.erase( _lru.back().key );
+      _lru.pop_back();
+   }
+}
+
+size_t response_cache::size() const {
+   std::lock_guard<std::mutex> g( _mtx );
+   return _lru.size();
+}
+
+head_block_response_cache::head_block_response_cache( size_t max_size )
+: _max_size( max_size ) {}
+
+std::shared_ptr<const void> head_block_response_cache::get_entry( const chain::block_id_type& head_id, const std::string& key ) {
+   std::lock_guard<std::mutex> g( _mtx );
+   if( head_id != _head_id )
+      return {};
+   auto itr = _entries.find( key );
+   return itr != _entries.end() ? itr->second : std::shared_ptr<const void>();
+}
+
+void head_block_response_cache::put_entry( const chain::block_id_type& head_id, const std::string& key, std::shared_ptr<const void> result ) {
+   if( _max_size == 0 )
+      return;
+
+   std::lock_guard<std::mutex> g( _mtx );
+   if( head_id != _head_id ) {
+      _entries.clear();
+      _head_id = head_id;
+   }
+   // the entries are gone with the next block anyway, the ones past the limit are just not kept
+   if( _entries.size() < _max_size )
+      _entries[key] = std::move( result );
+}
+
+size_t head_block_response_cache::size() const {
+   std::lock_guard<std::mutex> g( _mtx );
+   return _entries.size();
+}
+
+} // namespace eosio::chain_apis
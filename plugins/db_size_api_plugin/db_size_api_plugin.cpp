@@ -1,12 +1,228 @@
 #include <fc/variant.hpp>
 #include <fc/io/json.hpp>
 #include <eosio/db_size_api_plugin/db_size_api_plugin.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/account_object.hpp>
+#include <eosio/chain/permission_object.hpp>
+#include <eosio/chain/resource_limits_private.hpp>
+
+#include <boost/core/demangle.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <tuple>
 
 namespace eosio {
 
 static appbase::abstract_plugin& _db_size_api_plugin = app().register_plugin<db_size_api_plugin>();
 
 using namespace eosio;
+using namespace eosio::chain;
+
+/**
+ * Keeps the sizes of every contract table as of its last scan, summed per contract, table and index. The controller
+ * reports the tables whose rows change; as the change may still be undone without another report, a table is
+ * scanned again by every get_contracts until the block of its last change is irreversible.
+ */
+class db_size_api_plugin_impl {
+public:
+   explicit db_size_api_plugin_impl(controller& c) : chain(c), startup_head(c.head_block_num()) {}
+
+   enum index_kind : uint8_t { primary, idx64, idx128, idx256, idx_double, idx_long_double, index_kinds };
+
+   struct scanned_table {
+      account_name code;
+      name         table;
+      index_kind   kind = primary;
+      uint64_t     rows = 0;
+      uint64_t     payload_bytes = 0;
+   };
+
+   struct aggregate {
+      uint64_t scopes = 0;
+      uint64_t rows = 0;
+      uint64_t payload_bytes = 0;
+   };
+
+   using aggregate_key = std::tuple<account_name, name, index_kind>;
+
+   controller&                               chain;
+   const uint32_t                            startup_head; ///< reversible blocks below are not covered by touches
+   bool                                      scanned = false;
+   std::map<table_id, scanned_table>         tables;
+   std::map<aggregate_key, aggregate>        aggregates;
+   std::map<table_id, uint32_t>              volatile_tables; ///< touched => block of the last touch
+   std::set<table_id>                        dirty_tables;    ///< touched in blocks now irreversible, scanned once more
+   block_id_type                             last_accepted;
+
+   fc::optional<boost::signals2::scoped_connection> accepted_block_connection;
+   fc::optional<boost::signals2::scoped_connection> irreversible_block_connection;
+
+   static const char* kind_name(index_kind k) {
+      static const char* names[index_kinds] = {"primary", "idx64", "idx128", "idx256", "idx_double", "idx_long_double"};
+      return names[k];
+   }
+
+   static uint64_t row_overhead(index_kind k) {
+      static const uint64_t sizes[index_kinds] = {
+         config::billable_size_v<key_value_object>, config::billable_size_v<index64_object>,
+         config::billable_size_v<index128_object>, config::billable_size_v<index256_object>,
+         config::billable_size_v<index_double_object>, config::billable_size_v<index_long_double_object>
+      };
+      return sizes[k];
+   }
+
+   void touched(const table_id_object& t) {
+      auto& block_num = volatile_tables[t.id];
+      block_num = std::max(block_num, chain.head_block_num() + 1);
+   }
+
+   void on_accepted_block(const block_state_ptr& bs) {
+      // a fork switch popping blocks applied before startup undoes changes never reported
+      if(last_accepted != block_id_type() && bs->header.previous != last_accepted && bs->block_num <= startup_head)
+         scanned = false;
+      last_accepted = bs->id;
+   }
+
+   void on_irreversible_block(const block_state_ptr& bs) {
+      for(auto itr = volatile_tables.begin(); itr != volatile_tables.end();) {
+         if(itr->second <= bs->block_num) {
+            if(scanned)
+               dirty_tables.insert(itr->first);
+            itr = volatile_tables.erase(itr);
+         } else {
+            ++itr;
+         }
+      }
+      // scanning everything again is cheaper than a long backlog
+      if(dirty_tables.size() > tables.size()) {
+         dirty_tables.clear();
+         scanned = false;
+      }
+   }
+
+   template<typename Index>
+   static bool has_rows(const database& db, const table_id& id) {
+      const auto& idx = db.get_index<Index, by_primary>();
+      auto itr = idx.lower_bound(boost::make_tuple(id));
+      return itr != idx.end() && itr->t_id == id;
+   }
+
+   void add(const table_id& id, scanned_table&& t) {
+      auto& a = aggregates[aggregate_key{t.code, t.table, t.kind}];
+      ++a.scopes;
+      a.rows += t.rows;
+      a.payload_bytes += t.payload_bytes;
+      tables[id] = std::move(t);
+   }
+
+   void remove(const table_id& id) {
+      auto itr = tables.find(id);
+      if(itr == tables.end())
+         return;
+      const auto& t = itr->second;
+      auto a = aggregates.find(aggregate_key{t.code, t.table, t.kind});
+      if(a != aggregates.end()) {
+         --a->second.scopes;
+         a->second.rows -= t.rows;
+         a->second.payload_bytes -= t.payload_bytes;
+         if(a->second.scopes == 0)
+            aggregates.erase(a);
+      }
+      tables.erase(itr);
+   }
+
+   void scan(const table_id_object& tid) {
+      const database& db = chain.db();
+      scanned_table t{tid.code, tid.table};
+      t.rows = tid.count;
+
+      const auto& kv = db.get_index<key_value_index, by_scope_primary>();
+      auto itr = kv.lower_bound(boost::make_tuple(tid.id));
+      if(itr != kv.end() && itr->t_id == tid.id) {
+         for(; itr != kv.end() && itr->t_id == tid.id; ++itr)
+            t.payload_bytes += itr->value.size();
+      } else if(has_rows<index64_index>(db, tid.id)) {
+         t.kind = idx64;
+      } else if(has_rows<index128_index>(db, tid.id)) {
+         t.kind = idx128;
+      } else if(has_rows<index256_index>(db, tid.id)) {
+         t.kind = idx256;
+      } else if(has_rows<index_double_index>(db, tid.id)) {
+         t.kind = idx_double;
+      } else if(has_rows<index_long_double_index>(db, tid.id)) {
+         t.kind = idx_long_double;
+      }
+      add(tid.id, std::move(t));
+   }
+
+   void rescan(const table_id& id) {
+      remove(id);
+      if(const auto* tid = chain.db().find<table_id_object>(id))
+         scan(*tid);
+   }
+
+   uint32_t refresh() {
+      uint32_t rescanned = 0;
+      if(!scanned) {
+         tables.clear();
+         aggregates.clear();
+         dirty_tables.clear();
+         for(const auto& tid : chain.db().get_index<table_id_multi_index>().indices()) {
+            scan(tid);
+            ++rescanned;
+         }
+         scanned = true;
+         return rescanned;
+      }
+      for(const auto& id : dirty_tables) {
+         if(!volatile_tables.count(id)) {
+            rescan(id);
+            ++rescanned;
+         }
+      }
+      dirty_tables.clear();
+      for(const auto& v : volatile_tables) {
+         rescan(v.first);
+         ++rescanned;
+      }
+      return rescanned;
+   }
+
+   db_size_contracts get_contracts(const db_size_contracts_params& params) {
+      db_size_contracts ret;
+      ret.rescanned_tables = refresh();
+
+      auto begin = aggregates.begin(), end = aggregates.end();
+      if(params.code) {
+         begin = aggregates.lower_bound(aggregate_key{*params.code, name(), primary});
+         end = aggregates.upper_bound(aggregate_key{*params.code, name(std::numeric_limits<uint64_t>::max()), idx_long_double});
+      }
+      for(auto itr = begin; itr != end; ++itr) {
+         const auto& [code, table, kind] = itr->first;
+         const auto& a = itr->second;
+         if(ret.contracts.empty() || ret.contracts.back().code != code)
+            ret.contracts.emplace_back(db_size_contract{code});
+         auto& c = ret.contracts.back();
+
+         db_size_table t{table, kind_name(kind), a.scopes, a.rows, a.payload_bytes};
+         t.overhead_bytes = a.rows * row_overhead(kind) + a.scopes * config::billable_size_v<table_id_object>;
+         c.row_count += t.row_count;
+         c.payload_bytes += t.payload_bytes;
+         c.overhead_bytes += t.overhead_bytes;
+         c.tables.push_back(std::move(t));
+      }
+
+      auto total = [](const auto& v) { return v.payload_bytes + v.overhead_bytes; };
+      for(auto& c : ret.contracts)
+         std::sort(c.tables.begin(), c.tables.end(), [&](const auto& l, const auto& r) { return total(l) > total(r); });
+      std::sort(ret.contracts.begin(), ret.contracts.end(), [&](const auto& l, const auto& r) { return total(l) > total(r); });
+      if(ret.contracts.size() > params.limit)
+         ret.contracts.resize(params.limit);
+      return ret;
+   }
+};
 
 #define CALL(api_name, api_handle, call_name, INVOKE, http_response_code) \
 {std::string("/v1/" #api_name "/" #call_name), \
@@ -20,17 +236,49 @@ using namespace eosio;
           } \
        }}
 
+#define INVOKE_R_R(api_handle, call_name, in_param) \
+     auto result = api_handle->call_name(fc::json::from_string(body).as<in_param>());
+
 #define INVOKE_R_V(api_handle, call_name) \
      auto result = api_handle->call_name();
 
 
 void db_size_api_plugin::plugin_startup() {
+   auto& chain = app().get_plugin<chain_plugin>().chain();
+   my = std::make_shared<db_size_api_plugin_impl>(chain);
+   chain.set_table_touched_callback([my = my.get()](const table_id_object& t) { my->touched(t); });
+   my->accepted_block_connection.emplace(chain.accepted_block.connect([my = my.get()](const block_state_ptr& bs) {
+      my->on_accepted_block(bs);
+   }));
+   my->irreversible_block_connection.emplace(chain.irreversible_block.connect([my = my.get()](const block_state_ptr& bs) {
+      my->on_irreversible_block(bs);
+   }));
+
    app().get_plugin<http_plugin>().add_api({
        CALL(db_size, this, get,
             INVOKE_R_V(this, get), 200),
+       CALL(db_size, this, get_contracts,
+            INVOKE_R_R(this, get_contracts, db_size_contracts_params), 200),
    });
 }
 
+void db_size_api_plugin::plugin_shutdown() {
+   if(my) {
+      app().get_plugin<chain_plugin>().chain().set_table_touched_callback(nullptr);
+      my->accepted_block_connection.reset();
+      my->irreversible_block_connection.reset();
+   }
+}
+
+template<typename Index>
+static db_size_object_pool object_pool(const chainbase::database& db) {
+   using object_type = typename Index::value_type;
+   db_size_object_pool p{boost::core::demangle(typeid(object_type).name()), sizeof(object_type)};
+   p.row_count = db.get_index<Index>().indices().size();
+   p.bytes = p.object_size * p.row_count;
+   return p;
+}
+
 db_size_stats db_size_api_plugin::get() {
    const chainbase::database& db = app().get_plugin<chain_plugin>().chain().db();
    db_size_stats ret;
@@ -43,10 +291,29 @@ db_size_stats db_size_api_plugin::get() {
    for(const auto& i : indices)
       ret.indices.emplace_back(db_size_index_count{i.second, i.first});
 
+   // the object types created and removed by most transactions
+   ret.object_pools = {
+      object_pool<key_value_index>(db),
+      object_pool<index64_index>(db),
+      object_pool<index128_index>(db),
+      object_pool<index256_index>(db),
+      object_pool<index_double_index>(db),
+      object_pool<index_long_double_index>(db),
+      object_pool<table_id_multi_index>(db),
+      object_pool<account_metadata_index>(db),
+      object_pool<permission_usage_index>(db),
+      object_pool<resource_limits::resource_usage_index>(db),
+   };
+
    return ret;
 }
 
+db_size_contracts db_size_api_plugin::get_contracts(const db_size_contracts_params& params) {
+   return my->get_contracts(params);
+}
+
 #undef INVOKE_R_V
+#undef INVOKE_R_R
 #undef CALL
 
 }
@@ -14,13 +14,51 @@ struct db_size_index_count {
    uint64_t row_count;
 };
 
+/// the fixed size objects of one of the hot object types, each allocated from the per type free list of its index
+struct db_size_object_pool {
+   string   index;
+   uint64_t object_size = 0; ///< bytes of one object, not counting the index nodes or dynamically sized members
+   uint64_t row_count = 0;
+   uint64_t bytes = 0;       ///< object_size * row_count
+};
+
 struct db_size_stats {
    uint64_t                    free_bytes;
    uint64_t                    used_bytes;
    uint64_t                    size;
    vector<db_size_index_count> indices;
+   vector<db_size_object_pool> object_pools;
+};
+
+struct db_size_contracts_params {
+   fc::optional<chain::name> code;   ///< only this contract
+   uint32_t                  limit = 100;
+};
+
+struct db_size_table {
+   chain::name table;          ///< secondary index tables have the index number in the low 4 bits
+   string      index;          ///< "primary" or the type of the secondary index
+   uint64_t    scopes = 0;
+   uint64_t    row_count = 0;
+   uint64_t    payload_bytes = 0;  ///< of the row values
+   uint64_t    overhead_bytes = 0; ///< billable size of the row and table objects
 };
 
+struct db_size_contract {
+   chain::name           code;
+   uint64_t              row_count = 0;
+   uint64_t              payload_bytes = 0;
+   uint64_t              overhead_bytes = 0;
+   vector<db_size_table> tables;
+};
+
+struct db_size_contracts {
+   vector<db_size_contract> contracts;        ///< largest first
+   uint32_t                 rescanned_tables = 0; ///< by this call
+};
+
+typedef std::shared_ptr<class db_size_api_plugin_impl> db_size_api_ptr;
+
 class db_size_api_plugin : public plugin<db_size_api_plugin> {
 public:
    APPBASE_PLUGIN_REQUIRES((http_plugin) (chain_plugin))
@@ -35,14 +73,24 @@ public:
    virtual void set_program_options(options_description& cli, options_description& cfg) override {}
    void plugin_initialize(const variables_map& vm) {}
    void plugin_startup();
-   void plugin_shutdown() {}
+   void plugin_shutdown();
 
    db_size_stats get();
 
+   /// Row counts and bytes of the contract tables, per contract and table summed over the scopes. The first call
+   /// scans every table, later calls only the tables changed in blocks that were reversible since the previous call.
+   db_size_contracts get_contracts(const db_size_contracts_params& params);
+
 private:
+   db_size_api_ptr my;
 };
 
 }
 
 FC_REFLECT( eosio::db_size_index_count, (index)(row_count) )
-FC_REFLECT( eosio::db_size_stats, (free_bytes)(used_bytes)(size)(indices) )
\ No newline at end of file
+FC_REFLECT( eosio::db_size_object_pool, (index)(object_size)(row_count)(bytes) )
+FC_REFLECT( eosio::db_size_stats, (free_bytes)(used_bytes)(size)(indices)(object_pools) )
+FC_REFLECT( eosio::db_size_contracts_params, (code)(limit) )
+FC_REFLECT( eosio::db_size_table, (table)(index)(scopes)(row_count)(payload_bytes)(overhead_bytes) )
+FC_REFLECT( eosio::db_size_contract, (code)(row_count)(payload_bytes)(overhead_bytes)(tables) )
+FC_REFLECT( eosio::db_size_contracts, (contracts)(rescanned_tables) )
\ No newline at end of file
@@ -0,0 +1,368 @@
+#include <eosio/event_export_plugin/event_export_plugin.hpp>
+#include <eosio/chain/block_state.hpp>
+#include <eosio/chain/signal_stats.hpp>
+#include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/trace.hpp>
+
+#include <fc/io/cfile.hpp>
+#include <fc/io/raw.hpp>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/signals2/connection.hpp>
+
+#include <future>
+#include <map>
+
+namespace eosio {
+   using namespace chain;
+   using boost::signals2::scoped_connection;
+   using boost::asio::ip::tcp;
+
+   static appbase::abstract_plugin& _event_export_plugin = app().register_plugin<event_export_plugin>();
+
+namespace {
+
+   /// transaction_trace without its exception objects, the exception is exported as its string
+   template<typename Stream>
+   void pack_trace( Stream& ds, const transaction_trace& t ) {
+      fc::raw::pack( ds, t.id );
+      fc::raw::pack( ds, t.block_num );
+      fc::raw::pack( ds, t.block_time );
+      fc::raw::pack( ds, t.producer_block_id );
+      fc::raw::pack( ds, t.receipt );
+      fc::raw::pack( ds, t.elapsed );
+      fc::raw::pack( ds, t.net_usage );
+      fc::raw::pack( ds, t.scheduled );
+      fc::raw::pack( ds, t.action_traces );
+      fc::raw::pack( ds, t.account_ram_delta );
+      fc::raw::pack( ds, t.error_code );
+      fc::raw::pack( ds, t.except ? t.except->to_string() : std::string() );
+      fc::raw::pack( ds, static_cast<bool>( t.failed_dtrx_trace ) );
+      if( t.failed_dtrx_trace )
+         pack_trace( ds, *t.failed_dtrx_trace );
+   }
+
+   template<typename F>
+   std::vector<char> make_frame( export_event_type type, uint64_t sequence, uint32_t block_num, F&& pack_payload ) {
+      auto pack_event = [&]( auto& ds ) {
+         fc::raw::pack( ds, static_cast<uint8_t>( type ) );
+         fc::raw::pack( ds, sequence );
+         fc::raw::pack( ds, block_num );
+         pack_payload( ds );
+      };
+      fc::datastream<size_t> ps;
+      pack_event( ps );
+      const uint32_t length = ps.tellp();
+
+      std::vector<char> frame( sizeof( length ) + length );
+      fc::datastream<char*> ds( frame.data(), frame.size() );
+      fc::raw::pack( ds, length );
+      pack_event( ds );
+      return frame;
+   }
+
+   class file_sink : public export_sink {
+   public:
+      explicit file_sink( const fc::path& path ) {
+         _file.set_file_path( path );
+         _file.open( fc::cfile::create_or_update_rw_mode );
+         _file.seek_end( 0 );
+      }
+
+      std::string name() const override { return "file " + _file.get_file_path().generic_string(); }
+
+      void write( const std::vector<char>& frames, uint32_t ) override {
+         _file.write( frames.data(), frames.size() );
+         _file.flush();
+      }
+
+   private:
+      fc::cfile _file;
+   };
+
+   /// writes on the export thread; batches are dropped while the peer is unreachable, reconnecting at most once a second
+   class tcp_sink : public export_sink {
+   public:
+      tcp_sink( std::string host, std::string port )
+      : _host( std::move( host ) ), _port( std::move( port ) ) {}
+
+      std::string name() const override { return "tcp " + _host + ":" + _port; }
+
+      void write( const std::vector<char>& frames, uint32_t event_count ) override {
+         if( !_socket && !connect() ) {
+            drop( event_count );
+            return;
+         }
+         boost::system::error_code ec;
+         boost::asio::write( *_socket, boost::asio::buffer( frames ), ec );
+         if( ec ) {
+            wlog( "event export to ${n} failed: ${e}", ("n", name())("e", ec.message()) );
+            _socket.reset();
+            drop( event_count );
+         }
+      }
+
+   private:
+      bool connect() {
+         const auto now = fc::time_point::now();
+         if( now < _next_connect ) return false;
+         _next_connect = now + fc::seconds( 1 );
+
+         boost::system::error_code ec;
+         tcp::resolver resolver( _ioc );
+         auto endpoints = resolver.resolve( _host, _port, ec );
+         if( !ec ) {
+            _socket.emplace( _ioc );
+            boost::asio::connect( *_socket, endpoints, ec );
+         }
+         if( ec ) {
+            _socket.reset();
+            return false;
+         }
+         _socket->set_option( tcp::no_delay( true ), ec );
+         ilog( "event export connected to ${n}, ${d} events dropped while disconnected", ("n", name())("d", _dropped) );
+         _dropped = 0;
+         return true;
+      }
+
+      void drop( uint32_t event_count ) {
+         if( _dropped == 0 )
+            wlog( "event export to ${n} is not connected, dropping events", ("n", name()) );
+         _dropped += event_count;
+      }
+
+      std::string                 _host;
+      std::string                 _port;
+      boost::asio::io_context     _ioc;
+      fc::optional<tcp::socket>   _socket;
+      fc::time_point              _next_connect;
+      uint64_t                    _dropped = 0;
+   };
+
+} // anonymous namespace
+
+   class event_export_plugin_impl {
+   public:
+      std::vector<shared_ptr<export_sink>>  sinks;
+      uint32_t                              serialize_threads = 0;
+      uint32_t                              batch_size = 0;
+      fc::microseconds                      flush_interval;
+
+      fc::optional<named_thread_pool>       serialize_pool;
+      fc::optional<named_thread_pool>       sink_pool; ///< a single thread ordering, batching and writing the events
+      fc::optional<boost::asio::steady_timer> flush_timer;
+
+      uint64_t                              next_sequence = 0; ///< main thread
+      std::atomic<uint64_t>                 pending{0};        ///< assigned a sequence, not delivered yet
+
+      // sink thread
+      uint64_t                              next_delivery = 0;
+      std::map<uint64_t, std::vector<char>> serialized;        ///< finished out of order, waiting for earlier ones
+      std::vector<char>                     batch;
+      uint32_t                              batch_events = 0;
+      bool                                  flush_timer_armed = false;
+      bool                                  started = false;
+
+      fc::optional<scoped_connection>       accepted_block_connection;
+      fc::optional<scoped_connection>       applied_transaction_connection;
+      fc::optional<scoped_connection>       irreversible_block_connection;
+
+      /// main thread, serialize is called on the pool with the sequence of the event
+      template<typename F>
+      void export_event( F&& serialize ) {
+         const auto sequence = next_sequence++;
+         ++pending;
+         boost::asio::post( serialize_pool->get_executor(), [this, sequence, serialize = std::forward<F>( serialize )]() {
+            std::vector<char> frame;
+            try {
+               frame = serialize( sequence );
+            } FC_LOG_AND_DROP()
+            boost::asio::post( sink_pool->get_executor(), [this, sequence, frame = std::move( frame )]() mutable {
+               deliver( sequence, std::move( frame ) );
+            } );
+         } );
+      }
+
+      /// sink thread
+      void deliver( uint64_t sequence, std::vector<char>&& frame ) {
+         serialized.emplace( sequence, std::move( frame ) );
+         for( auto itr = serialized.begin(); itr != serialized.end() && itr->first == next_delivery; itr = serialized.erase( itr ) ) {
+            // a frame that failed to serialize is empty, its sequence is skipped
+            if( !itr->second.empty() ) {
+               batch.insert( batch.end(), itr->second.begin(), itr->second.end() );
+               ++batch_events;
+            }
+            ++next_delivery;
+            --pending;
+         }
+
+         if( batch_events >= batch_size ) {
+            flush();
+         } else if( batch_events > 0 && !flush_timer_armed ) {
+            flush_timer_armed = true;
+            flush_timer->expires_after( std::chrono::microseconds( flush_interval.count() ) );
+            flush_timer->async_wait( [this]( const boost::system::error_code& ec ) {
+               flush_timer_armed = false;
+               if( !ec && batch_events > 0 )
+                  flush();
+            } );
+         }
+      }
+
+      /// sink thread
+      void flush() {
+         for( const auto& sink : sinks ) {
+            try {
+               sink->write( batch, batch_events );
+            } catch( const fc::exception& e ) {
+               elog( "event export to ${n} failed: ${e}", ("n", sink->name())("e", e.to_detail_string()) );
+            } catch( const std::exception& e ) {
+               elog( "event export to ${n} failed: ${e}", ("n", sink->name())("e", e.what()) );
+            }
+         }
+         batch.clear();
+         batch_events = 0;
+      }
+
+      void on_accepted_block( const block_state_ptr& bsp ) {
+         export_event( [bsp]( uint64_t sequence ) {
+            return make_frame( export_event_type::accepted_block, sequence, bsp->block_num,
+                               [&]( auto& ds ) { fc::raw::pack( ds, *bsp->block ); } );
+         } );
+      }
+
+      void on_applied_transaction( const transaction_trace_ptr& trace ) {
+         export_event( [trace]( uint64_t sequence ) {
+            return make_frame( export_event_type::applied_transaction, sequence, trace->block_num,
+                               [&]( auto& ds ) { pack_trace( ds, *trace ); } );
+         } );
+      }
+
+      void on_irreversible_block( const block_state_ptr& bsp ) {
+         export_event( [block_num = bsp->block_num, id = bsp->id]( uint64_t sequence ) {
+            return make_frame( export_event_type::irreversible_block, sequence, block_num,
+                               [&]( auto& ds ) { fc::raw::pack( ds, id ); } );
+         } );
+      }
+
+      void shutdown() {
+         accepted_block_connection.reset();
+         applied_transaction_connection.reset();
+         irreversible_block_connection.reset();
+         if( !sink_pool ) return;
+
+         const auto deadline = fc::time_point::now() + fc::seconds( 10 );
+         while( pending > 0 && fc::time_point::now() < deadline )
+            std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+         if( pending > 0 )
+            wlog( "event export shutting down with ${p} events not exported", ("p", pending.load()) );
+
+         std::promise<void> flushed;
+         boost::asio::post( sink_pool->get_executor(), [this, &flushed]() {
+            flush_timer->cancel();
+            if( batch_events > 0 )
+               flush();
+            flushed.set_value();
+         } );
+         flushed.get_future().wait();
+
+         serialize_pool.reset();
+         sink_pool->stop();
+         flush_timer.reset();
+         sink_pool.reset();
+      }
+   };
+
+   event_export_plugin::event_export_plugin()
+   :my(std::make_shared<event_export_plugin_impl>()) {
+   }
+
+   event_export_plugin::~event_export_plugin() {
+   }
+
+   void event_export_plugin::set_program_options(options_description& cli, options_description& cfg) {
+      cfg.add_options()
+            ("export-file", bpo::value<bfs::path>(),
+             "Append the exported events to this file. A relative path is relative to the data dir.")
+            ("export-tcp-endpoint", bpo::value<string>(),
+             "Send the exported events to this host:port.")
+            ("export-threads", bpo::value<uint32_t>()->default_value(2),
+             "Number of threads serializing exported events.")
+            ("export-batch-size", bpo::value<uint32_t>()->default_value(256),
+             "Maximum number of events handed to the sinks at once.")
+            ("export-flush-interval-ms", bpo::value<uint32_t>()->default_value(500),
+             "Longest time an exported event waits for its batch to fill up.")
+            ;
+   }
+
+   void event_export_plugin::plugin_initialize(const variables_map& options) {
+      try {
+         my->serialize_threads = options.at( "export-threads" ).as<uint32_t>();
+         EOS_ASSERT( my->serialize_threads > 0, chain::plugin_config_exception, "export-threads > 0 required" );
+         my->batch_size = options.at( "export-batch-size" ).as<uint32_t>();
+         EOS_ASSERT( my->batch_size > 0, chain::plugin_config_exception, "export-batch-size > 0 required" );
+         my->flush_interval = fc::milliseconds( options.at( "export-flush-interval-ms" ).as<uint32_t>() );
+
+         if( options.count( "export-file" ) ) {
+            auto path = options.at( "export-file" ).as<bfs::path>();
+            if( path.is_relative() )
+               path = app().data_dir() / path;
+            my->sinks.emplace_back( std::make_shared<file_sink>( path ) );
+         }
+         if( options.count( "export-tcp-endpoint" ) ) {
+            const auto& endpoint = options.at( "export-tcp-endpoint" ).as<string>();
+            const auto colon = endpoint.rfind( ':' );
+            EOS_ASSERT( colon != string::npos && colon > 0 && colon + 1 < endpoint.size(), chain::plugin_config_exception,
+                        "Invalid value ${e} for export-tcp-endpoint, host:port expected", ("e", endpoint) );
+            my->sinks.emplace_back( std::make_shared<tcp_sink>( endpoint.substr( 0, colon ), endpoint.substr( colon + 1 ) ) );
+         }
+
+         // connected here rather than at startup so the blocks chain_plugin replays on startup are exported as well
+         my->serialize_pool.emplace( "export", my->serialize_threads );
+         my->sink_pool.emplace( "exports", 1 );
+         my->flush_timer.emplace( my->sink_pool->get_executor() );
+
+         auto& chain = app().get_plugin<chain_plugin>().chain();
+         my->accepted_block_connection.emplace(
+               chain.accepted_block.connect( chain::timed_slot( "accepted_block", "event_export_plugin",
+                     [&]( const block_state_ptr& bsp ) {
+                  my->on_accepted_block( bsp );
+               } )));
+         my->applied_transaction_connection.emplace(
+               chain.applied_transaction.connect( chain::timed_slot( "applied_transaction", "event_export_plugin",
+                     [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> t ) {
+                  my->on_applied_transaction( std::get<0>(t) );
+               } )));
+         my->irreversible_block_connection.emplace(
+               chain.irreversible_block.connect( chain::timed_slot( "irreversible_block", "event_export_plugin",
+                     [&]( const block_state_ptr& bsp ) {
+                  my->on_irreversible_block( bsp );
+               } )));
+      } FC_LOG_AND_RETHROW()
+   }
+
+   void event_export_plugin::register_sink( shared_ptr<export_sink> sink ) {
+      // the sinks are read on the export thread once events flow
+      EOS_ASSERT( !my->started, chain::plugin_exception, "export sink ${n} registered after startup", ("n", sink->name()) );
+      my->sinks.emplace_back( std::move( sink ) );
+   }
+
+   void event_export_plugin::plugin_startup() {
+      my->started = true;
+      if( my->sinks.empty() ) {
+         wlog( "event_export_plugin has no sinks, events are not exported" );
+         my->shutdown();
+         return;
+      }
+      for( const auto& sink : my->sinks )
+         ilog( "exporting events to ${n}", ("n", sink->name()) );
+   }
+
+   void event_export_plugin::plugin_shutdown() {
+      my->shutdown();
+   }
+
+} // namespace eosio
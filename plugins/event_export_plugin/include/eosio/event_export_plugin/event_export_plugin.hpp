@@ -0,0 +1,61 @@
+#pragma once
+#include <appbase/application.hpp>
+
+#include <eosio/chain_plugin/chain_plugin.hpp>
+
+namespace eosio {
+
+using std::shared_ptr;
+
+typedef shared_ptr<class event_export_plugin_impl> event_export_ptr;
+
+enum class export_event_type : uint8_t {
+   accepted_block      = 0, ///< payload: signed_block
+   applied_transaction = 1, ///< payload: transaction trace, see event_export_plugin.cpp pack_trace
+   irreversible_block  = 2  ///< payload: block_id_type
+};
+
+/**
+ * Receives the exported events in batches. Each batch is a sequence of frames:
+ *    uint32_t length           little endian, of the rest of the frame
+ *    uint8_t  export_event_type
+ *    uint64_t sequence         consecutive over all events, in signal order
+ *    uint32_t block_num
+ *    payload                   fc::raw packed
+ * Frames are delivered in sequence order, on the export thread only, so a sink does not need to be thread safe.
+ * A sink that throws is logged and keeps receiving the following batches.
+ */
+class export_sink {
+public:
+   virtual ~export_sink() = default;
+
+   virtual std::string name() const = 0;
+   virtual void write( const std::vector<char>& frames, uint32_t event_count ) = 0;
+};
+
+/**
+ *  Subscribes to accepted_block, applied_transaction and irreversible_block once, serializes the events on a thread
+ *  pool and fans them out in batches to the configured sinks: a file, a TCP connection, and any sink other plugins
+ *  register. The main thread only hands the signal arguments to the pool.
+ */
+class event_export_plugin : public plugin<event_export_plugin> {
+public:
+   APPBASE_PLUGIN_REQUIRES((chain_plugin))
+
+   event_export_plugin();
+   virtual ~event_export_plugin();
+
+   virtual void set_program_options(options_description& cli, options_description& cfg) override;
+
+   void plugin_initialize(const variables_map& options);
+   void plugin_startup();
+   void plugin_shutdown();
+
+   /// must be called before plugin_startup, typically from the plugin_initialize of a plugin requiring this one
+   void register_sink( shared_ptr<export_sink> sink );
+
+private:
+   event_export_ptr my;
+};
+
+} // namespace eosio
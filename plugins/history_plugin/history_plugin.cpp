@@ -3,13 +3,19 @@
 #include <eosio/history_plugin/public_key_history_object.hpp>
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/trace.hpp>
+#include <eosio/chain/signal_stats.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <eosio/chain_plugin/chain_plugin.hpp>
 
 #include <fc/io/json.hpp>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/core/demangle.hpp>
 #include <boost/signals2/connection.hpp>
 
+#include <atomic>
+#include <future>
+
 namespace eosio {
    using namespace chain;
    using boost::signals2::scoped_connection;
@@ -30,11 +36,15 @@ namespace eosio {
 
       OBJECT_CTOR( action_history_object, (packed_action_trace) );
 
+      /// trx_index of the actions of a transaction without a receipt in its block, e.g. onblock
+      static constexpr uint32_t no_trx_index = std::numeric_limits<uint32_t>::max();
+
       id_type      id;
       uint64_t     action_sequence_num; ///< the sequence number of the relevant action
 
       shared_string        packed_action_trace;
       uint32_t             block_num;
+      uint32_t             trx_index = no_trx_index; ///< position of the transaction receipt in the block
       block_timestamp_type block_time;
       transaction_id_type  trx_id;
    };
@@ -69,6 +79,12 @@ namespace eosio {
                member<account_history_object, account_name, &account_history_object::account >,
                member<account_history_object, int32_t, &account_history_object::account_sequence_num >
             >
+         >,
+         ordered_unique<tag<by_action_sequence_num>,
+            composite_key< account_history_object,
+               member<account_history_object, uint64_t, &account_history_object::action_sequence_num >,
+               member<account_history_object, account_history_object::id_type, &account_history_object::id >
+            >
          >
       >
    >;
@@ -80,6 +96,30 @@ CHAINBASE_SET_INDEX_TYPE(eosio::action_history_object, eosio::action_history_ind
 
 namespace eosio {
 
+   /**
+    * Version of the layout of the history indexes, kept in the state next to them. chainbase reopens an index by the
+    * name of its object whatever its layout, so indexes of another layout have to be detected before add_index.
+    * Version 2 added the by_action_sequence_num index of account_history_index and action_history_object::trx_index,
+    * the state written by earlier versions has no version at all.
+    */
+   static constexpr uint32_t history_layout_version = 2;
+   static constexpr const char* history_layout_version_name = "eosio::history_plugin_layout_version";
+
+   static void check_history_layout( chainbase::database& db ) {
+      auto* segment = db.get_segment_manager();
+      const auto name = boost::core::demangle( typeid(account_history_object).name() );
+      const bool existing = segment->find<account_history_index>( name.c_str() ).first != nullptr;
+      const auto* version = segment->find<uint32_t>( history_layout_version_name ).first;
+      if( existing ) {
+         EOS_ASSERT( version && *version == history_layout_version, plugin_config_exception,
+                     "The history_plugin state was written with index layout version ${v}, this version needs ${n}. "
+                     "Replay the blockchain with --replay-blockchain, or --hard-replay-blockchain, to rebuild it.",
+                     ("v", version ? *version : 1)("n", history_layout_version) );
+      } else if( !version ) {
+         segment->construct<uint32_t>( history_layout_version_name )( history_layout_version );
+      }
+   }
+
    template<typename MultiIndex, typename LookupType>
    static void remove(chainbase::database& db, const account_name& account_name, const permission_name& permission)
    {
@@ -140,8 +180,16 @@ namespace eosio {
          bool bypass_filter = false;
          std::set<filter_entry> filter_on;
          std::set<filter_entry> filter_out;
+         uint32_t               retain_blocks = 0; ///< 0 keeps all blocks
+         fc::microseconds       retain_time;       ///< 0 keeps all blocks
          chain_plugin*          chain_plug = nullptr;
+         size_t                 read_threads = 0;
+         mutable fc::optional<named_thread_pool> read_pool; ///< converts get_actions results, none when history-read-threads is 0
          fc::optional<scoped_connection> applied_transaction_connection;
+         fc::optional<scoped_connection> irreversible_block_connection;
+
+         /// bounds the work done per irreversible block, a large backlog is pruned over several blocks
+         static constexpr uint32_t max_pruned_actions_per_block = 10000;
 
           bool filter(const action_trace& act) {
             bool pass_on = false;
@@ -250,7 +298,7 @@ namespace eosio {
             }
          }
 
-         void on_action_trace( const action_trace& at ) {
+         void on_action_trace( const action_trace& at, uint32_t trx_index ) {
             if( filter( at ) ) {
                //idump((fc::json::to_pretty_string(at)));
                auto& chain = chain_plug->chain();
@@ -263,6 +311,7 @@ namespace eosio {
                   fc::raw::pack( ds, at );
                   aho.action_sequence_num = at.receipt->global_sequence;
                   aho.block_num = chain.head_block_num() + 1;
+                  aho.trx_index = trx_index;
                   aho.block_time = chain.pending_block_time();
                   aho.trx_id     = at.trx_id;
                });
@@ -276,13 +325,133 @@ namespace eosio {
                on_system_action( at );
          }
 
+         bool retention_enabled() const {
+            return retain_blocks > 0 || retain_time.count() > 0;
+         }
+
+         bool expired( const action_history_object& a, uint32_t lib_num, fc::time_point lib_time ) const {
+            if( retain_blocks > 0 && a.block_num + retain_blocks <= lib_num )
+               return true;
+            if( retain_time.count() > 0 && a.block_time.to_time_point() + retain_time < lib_time )
+               return true;
+            return false;
+         }
+
+         /**
+          * Removes the irreversible actions older than the retention window along with the account history
+          * rows referencing them. The newest row of each account is kept, even when its action is gone, so
+          * account sequence numbers keep counting up from where they were.
+          */
+         void prune( const block_state_ptr& lib ) {
+            auto& chain = chain_plug->chain();
+            chainbase::database& db = const_cast<chainbase::database&>( chain.db() ); // Override read-only access to state DB (highly unrecommended practice!)
+
+            const auto& action_idx = db.get_index<action_history_index, by_action_sequence_num>();
+            const auto& account_seq_idx = db.get_index<account_history_index, by_action_sequence_num>();
+            const auto& account_idx = db.get_index<account_history_index, by_account_action_seq>();
+            const auto lib_time = lib->header.timestamp.to_time_point();
+
+            uint32_t pruned = 0;
+            auto itr = action_idx.begin();
+            while( itr != action_idx.end() && pruned < max_pruned_actions_per_block && expired( *itr, lib->block_num, lib_time ) ) {
+               const auto seq = itr->action_sequence_num;
+               auto account_itr = account_seq_idx.lower_bound( boost::make_tuple( seq ) );
+               while( account_itr != account_seq_idx.end() && account_itr->action_sequence_num == seq ) {
+                  const auto& row = *account_itr;
+                  ++account_itr;
+                  auto next = account_idx.iterator_to( row );
+                  ++next;
+                  if( next == account_idx.end() || next->account != row.account )
+                     continue;
+                  db.remove( row );
+               }
+               const auto& a = *itr;
+               ++itr;
+               db.remove( a );
+               ++pruned;
+            }
+         }
+
          void on_applied_transaction( const transaction_trace_ptr& trace ) {
             if( !trace->receipt || (trace->receipt->status != transaction_receipt_header::executed &&
                   trace->receipt->status != transaction_receipt_header::soft_fail) )
                return;
+            // the receipt is pushed to the pending block before the transaction is reported
+            uint32_t trx_index = action_history_object::no_trx_index;
+            const auto& receipts = chain_plug->chain().get_pending_trx_receipts();
+            if( !receipts.empty() && receipt_trx_id( receipts.back() ) == trace->id )
+               trx_index = receipts.size() - 1;
             for( const auto& atrace : trace->action_traces ) {
                if( !atrace.receipt ) continue;
-               on_action_trace( atrace );
+               on_action_trace( atrace, trx_index );
+            }
+         }
+
+         static const transaction_id_type& receipt_trx_id( const transaction_receipt& r ) {
+            return r.trx.contains<packed_transaction>() ? r.trx.get<packed_transaction>().id() : r.trx.get<transaction_id_type>();
+         }
+
+         /**
+          * The receipt at trx_index of block block_num if it is the one of transaction id. A block of the block log
+          * is read serialized and only that receipt is unpacked, the receipts before it are skipped without
+          * decompressing or hashing their transactions.
+          */
+         fc::optional<transaction_receipt> find_receipt( uint32_t block_num, uint32_t trx_index, const transaction_id_type& id ) const {
+            if( trx_index == action_history_object::no_trx_index )
+               return {};
+            const auto& chain = chain_plug->chain();
+            const vector<transaction_receipt>* receipts = nullptr;
+            auto bsp = chain.fetch_block_state_by_number( block_num );
+            if( bsp ) {
+               receipts = &bsp->block->transactions;
+            } else if( chain.is_building_block() && block_num == chain.head_block_num() + 1 ) {
+               receipts = &chain.get_pending_trx_receipts();
+            }
+            if( receipts ) {
+               if( trx_index < receipts->size() && receipt_trx_id( (*receipts)[trx_index] ) == id )
+                  return (*receipts)[trx_index];
+               return {};
+            }
+
+            auto data = chain.fetch_serialized_block_by_number( block_num );
+            if( data.empty() )
+               return {};
+            fc::datastream<const char*> ds( data.data(), data.size() );
+            signed_block_header header;
+            fc::raw::unpack( ds, header );
+            fc::unsigned_int count;
+            fc::raw::unpack( ds, count );
+            if( trx_index >= count.value )
+               return {};
+            for( uint32_t i = 0; i < trx_index; ++i )
+               skip_receipt( ds );
+            transaction_receipt receipt;
+            fc::raw::unpack( ds, receipt );
+            if( receipt_trx_id( receipt ) != id )
+               return {};
+            return receipt;
+         }
+
+         static void skip_bytes( fc::datastream<const char*>& ds ) {
+            fc::unsigned_int size;
+            fc::raw::unpack( ds, size );
+            ds.skip( size.value );
+         }
+
+         /// a packed_transaction is skipped field by field, unpacking it would unpack its transaction
+         static void skip_receipt( fc::datastream<const char*>& ds ) {
+            transaction_receipt_header header;
+            fc::raw::unpack( ds, header );
+            fc::unsigned_int which;
+            fc::raw::unpack( ds, which );
+            if( which.value == 0 ) {
+               ds.skip( sizeof(transaction_id_type) );
+            } else {
+               vector<signature_type> signatures;
+               fc::raw::unpack( ds, signatures );
+               ds.skip( sizeof(uint8_t) ); // compression
+               skip_bytes( ds );           // packed_context_free_data
+               skip_bytes( ds );           // packed_trx
             }
          }
    };
@@ -305,6 +474,14 @@ namespace eosio {
             ("filter-out,F", bpo::value<vector<string>>()->composing(),
              "Do not track actions which match receiver:action:actor. Action and Actor both blank excludes all from Reciever. Actor blank excludes all from reciever:action. Receiver may not be blank.")
             ;
+      cfg.add_options()
+            ("history-retain-blocks", bpo::value<uint32_t>()->default_value(0),
+             "Number of blocks before the last irreversible block whose actions are kept in history. Older actions are removed. 0 keeps all blocks.")
+            ("history-retain-days", bpo::value<uint32_t>()->default_value(0),
+             "Number of days before the last irreversible block whose actions are kept in history. Older actions are removed. 0 keeps all blocks.")
+            ("history-read-threads", bpo::value<uint32_t>()->default_value(2),
+             "Number of threads, besides the main thread, converting the actions of a get_actions response. 0 converts them on the main thread only.")
+            ;
    }
 
    void history_plugin::plugin_initialize(const variables_map& options) {
@@ -339,21 +516,36 @@ namespace eosio {
             }
          }
 
+         my->retain_blocks = options.at( "history-retain-blocks" ).as<uint32_t>();
+         my->retain_time = fc::days( options.at( "history-retain-days" ).as<uint32_t>() );
+         my->read_threads = options.at( "history-read-threads" ).as<uint32_t>();
+         if( my->read_threads > 0 )
+            my->read_pool.emplace( "hist", my->read_threads );
+
          my->chain_plug = app().find_plugin<chain_plugin>();
          EOS_ASSERT( my->chain_plug, chain::missing_chain_plugin_exception, ""  );
          auto& chain = my->chain_plug->chain();
 
          chainbase::database& db = const_cast<chainbase::database&>( chain.db() ); // Override read-only access to state DB (highly unrecommended practice!)
          // TODO: Use separate chainbase database for managing the state of the history_plugin (or remove deprecated history_plugin entirely)
+         check_history_layout( db );
          db.add_index<account_history_index>();
          db.add_index<action_history_index>();
          db.add_index<account_control_history_multi_index>();
          db.add_index<public_key_history_multi_index>();
 
          my->applied_transaction_connection.emplace(
-               chain.applied_transaction.connect( [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> t ) {
+               chain.applied_transaction.connect( chain::timed_slot( "applied_transaction", "history_plugin",
+                     [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> t ) {
                   my->on_applied_transaction( std::get<0>(t) );
-               } ));
+               } )));
+         if( my->retention_enabled() ) {
+            my->irreversible_block_connection.emplace(
+                  chain.irreversible_block.connect( chain::timed_slot( "irreversible_block", "history_plugin",
+                        [&]( const block_state_ptr& bsp ) {
+                     my->prune( bsp );
+                  } )));
+         }
       } FC_LOG_AND_RETHROW()
    }
 
@@ -362,6 +554,8 @@ namespace eosio {
 
    void history_plugin::plugin_shutdown() {
       my->applied_transaction_connection.reset();
+      my->irreversible_block_connection.reset();
+      my->read_pool.reset();
    }
 
 
@@ -369,7 +563,6 @@ namespace eosio {
 
    namespace history_apis {
       read_only::get_actions_result read_only::get_actions( const read_only::get_actions_params& params )const {
-         edump((params));
         auto& chain = history->chain_plug->chain();
         const auto& db = chain.db();
         const auto abi_serializer_max_time = history->chain_plug->get_abi_serializer_max_time();
@@ -381,16 +574,14 @@ namespace eosio {
         int32_t end = 0;
         int32_t offset = params.offset ? *params.offset : -20;
         auto n = params.account_name;
-        idump((pos));
         if( pos == -1 ) {
-            auto itr = idx.lower_bound( boost::make_tuple( name(n.to_uint64_t()+1), 0 ) );
-            if( itr == idx.begin() ) {
+            // the rows of an account are contiguous and ordered by account sequence, its newest row is right before the next account
+            auto itr = idx.upper_bound( boost::make_tuple( n ) );
+            if( itr != idx.begin() ) {
+               --itr;
                if( itr->account == n )
-                  pos = itr->account_sequence_num+1;
-            } else if( itr != idx.begin() ) --itr;
-
-            if( itr->account == n )
-               pos = itr->account_sequence_num + 1;
+                  pos = itr->account_sequence_num + 1;
+            }
         }
 
         if( pos== -1 ) pos = 0xfffffff;
@@ -405,35 +596,75 @@ namespace eosio {
         }
         EOS_ASSERT( end >= start, chain::plugin_exception, "end position is earlier than start position" );
 
-        idump((start)(end));
-
         auto start_itr = idx.lower_bound( boost::make_tuple( n, start ) );
         auto end_itr = idx.upper_bound( boost::make_tuple( n, end) );
 
-        auto start_time = fc::time_point::now();
-        auto end_time = start_time;
-
         get_actions_result result;
         result.last_irreversible_block = chain.last_irreversible_block_num();
-        while( start_itr != end_itr ) {
-           const auto& a = db.get<action_history_object, by_action_sequence_num>( start_itr->action_sequence_num );
-           fc::datastream<const char*> ds( a.packed_action_trace.data(), a.packed_action_trace.size() );
-           action_trace t;
-           fc::raw::unpack( ds, t );
+
+        std::vector<std::pair<const account_history_object*, const action_history_object*>> rows;
+        for( ; start_itr != end_itr; ++start_itr ) {
+           const auto* ap = db.find<action_history_object, by_action_sequence_num>( start_itr->action_sequence_num );
+           if( !ap ) // pruned, only the newest row of the account is left behind
+              continue;
+           rows.emplace_back( &*start_itr, ap );
+        }
+
+        // unpacking and abi conversion dominate, spread them over the read threads while this thread waits on them.
+        // The caller runs on the main thread, so nothing modifies the state database in the meantime.
+        const auto deadline = fc::time_point::now() + fc::microseconds(100000);
+        std::vector<fc::optional<fc::variant>> traces( rows.size() );
+        std::atomic<size_t> next{0};
+        std::atomic<bool> stop{false};
+        auto convert = [&]() {
+           try {
+              for( size_t i = next++; i < rows.size() && !stop; i = next++ ) {
+                 const auto& a = *rows[i].second;
+                 fc::datastream<const char*> ds( a.packed_action_trace.data(), a.packed_action_trace.size() );
+                 action_trace t;
+                 fc::raw::unpack( ds, t );
+                 traces[i] = chain.to_variant_with_abi(t, abi_serializer::create_yield_function( abi_serializer_max_time ));
+                 if( fc::time_point::now() > deadline )
+                    stop = true;
+              }
+           } catch( ... ) {
+              stop = true;
+              throw;
+           }
+        };
+
+        std::vector<std::future<void>> tasks;
+        if( history->read_pool ) {
+           const auto workers = std::min( history->read_threads, rows.size() > 0 ? rows.size() - 1 : 0 );
+           for( size_t w = 0; w < workers; ++w ) {
+              auto task = std::make_shared<std::packaged_task<void()>>( convert );
+              tasks.emplace_back( task->get_future() );
+              boost::asio::post( history->read_pool->get_executor(), [task]() { (*task)(); } );
+           }
+        }
+        std::exception_ptr error;
+        try {
+           convert();
+        } catch( ... ) {
+           error = std::current_exception();
+        }
+        // the tasks reference this frame, all of them have to finish before an error unwinds it
+        for( auto& t : tasks ) t.wait();
+        if( error ) std::rethrow_exception( error );
+        for( auto& t : tasks ) t.get();
+
+        // a contiguous prefix of the range is returned when the time limit cut the conversion short
+        for( size_t i = 0; i < rows.size() && traces[i]; ++i ) {
+           const auto& a = *rows[i].second;
            result.actions.emplace_back( ordered_action_result{
-                                 start_itr->action_sequence_num,
-                                 start_itr->account_sequence_num,
+                                 rows[i].first->action_sequence_num,
+                                 rows[i].first->account_sequence_num,
                                  a.block_num, a.block_time,
-                                 chain.to_variant_with_abi(t, abi_serializer::create_yield_function( abi_serializer_max_time ))
+                                 std::move( *traces[i] )
                                  });
-
-           end_time = fc::time_point::now();
-           if( end_time - start_time > fc::microseconds(100000) ) {
-              result.time_limit_exceeded_error = true;
-              break;
-           }
-           ++start_itr;
         }
+        if( result.actions.size() < rows.size() )
+           result.time_limit_exceeded_error = true;
         return result;
       }
 
@@ -478,6 +709,7 @@ namespace eosio {
             result.last_irreversible_block = chain.last_irreversible_block_num();
             result.block_num  = itr->block_num;
             result.block_time = itr->block_time;
+            const uint32_t trx_index = itr->trx_index;
 
             while( itr != idx.end() && itr->trx_id == result.id ) {
 
@@ -489,27 +721,14 @@ namespace eosio {
               ++itr;
             }
 
-            auto blk = chain.fetch_block_by_number( result.block_num );
-            if( blk || chain.is_building_block() ) {
-               const vector<transaction_receipt>& receipts = blk ? blk->transactions : chain.get_pending_trx_receipts();
-               for (const auto &receipt: receipts) {
-                    if (receipt.trx.contains<packed_transaction>()) {
-                        auto &pt = receipt.trx.get<packed_transaction>();
-                        if (pt.id() == result.id) {
-                            fc::mutable_variant_object r("receipt", receipt);
-                            r("trx", chain.to_variant_with_abi(pt.get_signed_transaction(), abi_serializer::create_yield_function( abi_serializer_max_time )));
-                            result.trx = move(r);
-                            break;
-                        }
-                    } else {
-                        auto &id = receipt.trx.get<transaction_id_type>();
-                        if (id == result.id) {
-                            fc::mutable_variant_object r("receipt", receipt);
-                            result.trx = move(r);
-                            break;
-                        }
-                    }
+            auto receipt = history->find_receipt( result.block_num, trx_index, result.id );
+            if( receipt ) {
+               fc::mutable_variant_object r("receipt", *receipt);
+               if( receipt->trx.contains<packed_transaction>() ) {
+                  const auto& pt = receipt->trx.get<packed_transaction>();
+                  r("trx", chain.to_variant_with_abi(pt.get_signed_transaction(), abi_serializer::create_yield_function( abi_serializer_max_time )));
                }
+               result.trx = move(r);
             }
          } else {
             auto blk = chain.fetch_block_by_number(*p.block_num_hint);
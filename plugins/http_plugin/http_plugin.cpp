@@ -4,6 +4,7 @@
 #endif
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/post_lanes.hpp>
 
 #include <fc/network/ip.hpp>
 #include <fc/log/logger_config.hpp>
@@ -24,7 +25,9 @@
 
 #include <thread>
 #include <memory>
+#include <mutex>
 #include <regex>
+#include <unordered_map>
 
 const fc::string logger_name("http_plugin");
 fc::logger logger;
@@ -134,6 +137,9 @@ namespace eosio {
          virtual ~abstract_conn() {}
          virtual bool verify_max_bytes_in_flight() = 0;
          virtual void handle_exception() = 0;
+         virtual void send_json_response(int code, std::string json) = 0;
+         virtual void send_binary_response(int code, std::string packed) = 0;
+         virtual void send_too_many_requests(std::string what) = 0;
       };
 
       using abstract_conn_ptr = std::shared_ptr<abstract_conn>;
@@ -168,6 +174,119 @@ namespace eosio {
          } catch(...) {}
          return 0;
       }
+
+      /**
+       * token bucket refilled with rate tokens per second up to burst tokens
+       */
+      struct token_bucket {
+         double           rate = 0;
+         double           burst = 0;
+         double           tokens = 0;
+         fc::time_point   last;
+
+         void refill( const fc::time_point& now ) {
+            if( now > last ) {
+               tokens = std::min( burst, tokens + rate * (now - last).count() / 1000000.0 );
+               last = now;
+            }
+         }
+         bool full()const { return tokens >= burst; }
+      };
+
+      /**
+       * admission control of requests before they are queued for the main thread: every endpoint
+       * can have a limit of its own, and every client ip has a limit in cost units across all endpoints
+       */
+      class rate_limiter {
+      public:
+         struct endpoint_limit {
+            double rate = 0;
+            double burst = 0;
+         };
+
+         void set_endpoint_limit( const string& url, endpoint_limit l ) {
+            token_bucket& b = endpoint_buckets[url];
+            b.rate = l.rate;
+            b.burst = b.tokens = l.burst;
+         }
+         void set_endpoint_cost( const string& url, double cost ) {
+            endpoint_costs[url] = cost;
+         }
+         void set_client_limit( double rate ) {
+            client_rate = rate;
+         }
+
+         bool enabled()const { return client_rate > 0 || !endpoint_buckets.empty(); }
+
+         /// @return false if the request has to be shed, the tokens are only taken if it is admitted
+         bool admit( const string& url, const string& client ) {
+            const auto now = fc::time_point::now();
+            std::lock_guard<std::mutex> g( mtx );
+
+            token_bucket* endpoint = nullptr;
+            auto eitr = endpoint_buckets.find( url );
+            if( eitr != endpoint_buckets.end() ) {
+               endpoint = &eitr->second;
+               endpoint->refill( now );
+               if( endpoint->tokens < 1 ) return false;
+            }
+
+            if( client_rate > 0 ) {
+               auto citr = endpoint_costs.find( url );
+               const double cost = citr != endpoint_costs.end() ? citr->second : 1;
+               if( client_buckets.size() >= max_tracked_clients ) prune( now );
+               auto res = client_buckets.emplace( client, token_bucket{client_rate, client_rate * client_burst_sec, client_rate * client_burst_sec, now} );
+               token_bucket& c = res.first->second;
+               c.refill( now );
+               if( c.tokens < cost ) return false;
+               c.tokens -= cost;
+            }
+
+            if( endpoint ) endpoint->tokens -= 1;
+            return true;
+         }
+
+      private:
+         // clients with a full bucket are no different from new ones
+         void prune( const fc::time_point& now ) {
+            for( auto itr = client_buckets.begin(); itr != client_buckets.end(); ) {
+               itr->second.refill( now );
+               if( itr->second.full() ) itr = client_buckets.erase( itr );
+               else ++itr;
+            }
+         }
+
+         static constexpr size_t   max_tracked_clients = 10000;
+         static constexpr double   client_burst_sec = 2;
+
+         std::mutex                                   mtx;
+         std::map<string, token_bucket>               endpoint_buckets;
+         std::map<string, double>                     endpoint_costs;
+         double                                       client_rate = 0;
+         std::unordered_map<string, token_bucket>     client_buckets;
+      };
+
+      /**
+       * "url=value" of the rate limit options
+       */
+      static std::pair<string, string> parse_url_option( const string& option, const char* name ) {
+         auto pos = option.find( '=' );
+         EOS_ASSERT( pos != string::npos && pos > 0 && pos + 1 < option.size(), chain::plugin_config_exception,
+                     "${name} ${o} is not of the form url=value", ("name", name)("o", option) );
+         return { option.substr( 0, pos ), option.substr( pos + 1 ) };
+      }
+
+      /**
+       * client ip of a connection without the port, 1.2.3.4:5678 or [::1]:5678
+       */
+      template<typename T>
+      static string client_address( const T& con ) {
+         string ep = con->get_remote_endpoint();
+         auto pos = ep.rfind( ':' );
+         if( pos != string::npos && pos > 0 && (ep.front() == '[' ? ep[pos - 1] == ']' : ep.find( ':' ) == pos) )
+            ep.resize( pos );
+         return ep;
+      }
    }
 
    using websocket_server_type = websocketpp::server<detail::asio_with_stub_log<websocketpp::transport::asio::basic_socket::endpoint>>;
@@ -183,6 +302,8 @@ namespace eosio {
       public:
          // key -> priority, url_handler
          map<string,detail::internal_url_handler>  url_handlers;
+         // answer instead of url_handlers when the request accepts application/octet-stream
+         map<string,detail::internal_url_handler>  binary_url_handlers;
          optional<tcp::endpoint>  listen_endpoint;
          string                   access_control_allow_origin;
          string                   access_control_allow_headers;
@@ -197,6 +318,8 @@ namespace eosio {
          std::atomic<size_t>                         bytes_in_flight{0};
          size_t                                      max_bytes_in_flight = 0;
          fc::microseconds                            max_response_time{30*1000};
+         detail::rate_limiter                        rate_limiter;
+         size_t                                      api_lane = 0; ///< of eosio::chain::post_lanes
 
          optional<tcp::endpoint>  https_listen_endpoint;
          string                   https_cert_chain;
@@ -308,6 +431,12 @@ namespace eosio {
             con->send_http_response();
          }
 
+         /// only an explicit Accept of application/octet-stream, the JSON handlers answer wildcards
+         template<class Request>
+         static bool accepts_binary( const Request& req ) {
+            return req.get_header( "Accept" ).find( "application/octet-stream" ) != string::npos;
+         }
+
          template<class T>
          bool allow_host(const typename T::request_type& req, detail::connection_ptr<T> con) {
             bool is_secure = con->get_uri()->get_secure();
@@ -322,19 +451,36 @@ namespace eosio {
             return true;
          }
 
+         template<typename T>
+         static void send_too_many_requests( const T& con, string what ) {
+            error_results::error_info ei;
+            ei.code = websocketpp::http::status_code::too_many_requests;
+            ei.name = "Busy";
+            ei.what = std::move( what );
+            error_results results{websocketpp::http::status_code::too_many_requests, "Busy", ei};
+            con->set_body( fc::json::to_string( results, fc::time_point::maximum() ));
+            con->set_status( websocketpp::http::status_code::too_many_requests );
+            con->send_http_response();
+         }
+
          template<typename T>
          bool verify_max_bytes_in_flight( const T& con ) {
             auto bytes_in_flight_size = bytes_in_flight.load();
             if( bytes_in_flight_size > max_bytes_in_flight ) {
                fc_dlog( logger, "429 - too many bytes in flight: ${bytes}", ("bytes", bytes_in_flight_size) );
-               error_results::error_info ei;
-               ei.code = websocketpp::http::status_code::too_many_requests;
-               ei.name = "Busy";
-               ei.what = "Too many bytes in flight: " + std::to_string( bytes_in_flight_size );
-               error_results results{websocketpp::http::status_code::too_many_requests, "Busy", ei};
-               con->set_body( fc::json::to_string( results, fc::time_point::maximum() ));
-               con->set_status( websocketpp::http::status_code::too_many_requests );
-               con->send_http_response();
+               send_too_many_requests( con, "Too many bytes in flight: " + std::to_string( bytes_in_flight_size ) );
+               return false;
+            }
+            return true;
+         }
+
+         template<typename T>
+         bool verify_rate_limit( const T& con, const string& resource ) {
+            if( !rate_limiter.enabled() ) return true;
+            auto client = detail::client_address( con );
+            if( !rate_limiter.admit( resource, client ) ) {
+               fc_dlog( logger, "429 - rate limit of ${ep} exceeded by ${c}", ("ep", resource)("c", client) );
+               send_too_many_requests( con, "Rate limit exceeded for " + resource );
                return false;
             }
             return true;
@@ -365,6 +511,18 @@ namespace eosio {
                http_plugin_impl::handle_exception<T>(_conn);
             }
 
+            void send_json_response(int code, std::string json) override {
+               _impl.send_json_response<T>(_conn, code, std::move(json));
+            }
+
+            void send_binary_response(int code, std::string packed) override {
+               _impl.send_binary_response<T>(_conn, code, std::move(packed));
+            }
+
+            void send_too_many_requests(std::string what) override {
+               http_plugin_impl::send_too_many_requests(_conn, std::move(what));
+            }
+
             detail::connection_ptr<T> _conn;
             http_plugin_impl &_impl;
          };
@@ -453,7 +611,8 @@ namespace eosio {
 
          /**
           * Make an internal_url_handler that will run the url_handler on the app() thread and then
-          * return to the http thread pool for response processing
+          * return to the http thread pool for response processing. Handlers at or below medium_low go through
+          * the api lane, a full lane gets a 429 response.
           *
           * @pre b.size() has been added to bytes_in_flight by caller
           * @param priority - priority to post to the app thread at
@@ -461,7 +620,27 @@ namespace eosio {
           * @return the constructed internal_url_handler
           */
          detail::internal_url_handler make_app_thread_url_handler( int priority, url_handler next ) {
-            auto next_ptr = std::make_shared<url_handler>(std::move(next));
+            return make_app_thread_handler( priority, [next=std::move(next)]( detail::abstract_conn_ptr, string r, string b, url_response_callback then ) {
+               next( std::move( r ), std::move( b ), std::move( then ) );
+            } );
+         }
+
+         /**
+          * Make an internal_url_handler that will run the binary_url_handler on the app() thread, like
+          * make_app_thread_url_handler
+          */
+         detail::internal_url_handler make_app_thread_binary_url_handler( int priority, binary_url_handler next ) {
+            return make_app_thread_handler( priority, [next=std::move(next)]( detail::abstract_conn_ptr conn, string r, string b, url_response_callback then ) {
+               auto then_binary = [conn]( int code, std::string packed ) {
+                  conn->send_binary_response( code, std::move( packed ) );
+               };
+               next( std::move( r ), std::move( b ), std::move( then ), std::move( then_binary ) );
+            } );
+         }
+
+         template<typename Call>
+         detail::internal_url_handler make_app_thread_handler( int priority, Call call ) {
+            auto next_ptr = std::make_shared<Call>(std::move(call));
             return [this, priority, next_ptr=std::move(next_ptr)]( detail::abstract_conn_ptr conn, string r, string b, url_response_callback then ) mutable {
                auto tracked_b = make_in_flight(std::move(b), *this);
                if (!conn->verify_max_bytes_in_flight()) {
@@ -470,14 +649,60 @@ namespace eosio {
 
                // post to the app thread taking shared ownership of next (via std::shared_ptr),
                // sole ownership of the tracked body and the passed in parameters
-               app().post( priority, [next_ptr, conn=std::move(conn), r=std::move(r), tracked_b=std::move(tracked_b), then=std::move(then)]() mutable {
+               auto task = [next_ptr, conn, r=std::move(r), tracked_b=std::move(tracked_b), then=std::move(then)]() mutable {
                   try {
-                     // call the `next` url_handler and wrap the response handler
-                     (*next_ptr)( std::move( r ), std::move( *tracked_b ), std::move(then)) ;
+                     // call the `next` handler and wrap the response handler
+                     (*next_ptr)( conn, std::move( r ), std::move( *tracked_b ), std::move(then)) ;
                   } catch( ... ) {
                      conn->handle_exception();
                   }
-               } );
+               };
+               if( priority > appbase::priority::medium_low ) {
+                  app().post( priority, std::move( task ) );
+               } else if( !chain::post_lanes::instance().post( api_lane, std::move( task ) ) ) {
+                  fc_dlog( logger, "429 - api lane full" );
+                  conn->send_too_many_requests( "Too many requests queued" );
+               }
+            };
+         }
+
+         /**
+          * Make an internal_url_handler that will run the json_url_handler directly
+          *
+          * @pre b.size() has been added to bytes_in_flight by caller
+          * @param next - the next handler for responses
+          * @return the constructed internal_url_handler
+          */
+         detail::internal_url_handler make_http_thread_json_url_handler(json_url_handler next) {
+            return [next=std::move(next)]( detail::abstract_conn_ptr conn, string r, string b, url_response_callback then ) {
+               try {
+                  auto then_json = [conn]( int code, std::string json ) {
+                     conn->send_json_response( code, std::move( json ) );
+                  };
+                  next(std::move(r), std::move(b), std::move(then), std::move(then_json));
+               } catch( ... ) {
+                  conn->handle_exception();
+               }
+            };
+         }
+
+         /**
+          * Make an internal_url_handler that will run the binary_url_handler directly
+          *
+          * @pre b.size() has been added to bytes_in_flight by caller
+          * @param next - the next handler for responses
+          * @return the constructed internal_url_handler
+          */
+         detail::internal_url_handler make_http_thread_binary_url_handler(binary_url_handler next) {
+            return [next=std::move(next)]( detail::abstract_conn_ptr conn, string r, string b, url_response_callback then ) {
+               try {
+                  auto then_binary = [conn]( int code, std::string packed ) {
+                     conn->send_binary_response( code, std::move( packed ) );
+                  };
+                  next(std::move(r), std::move(b), std::move(then), std::move(then_binary));
+               } catch( ... ) {
+                  conn->handle_exception();
+               }
             };
          }
 
@@ -528,6 +753,52 @@ namespace eosio {
             };
          }
 
+         /**
+          * Send a response body which is already JSON encoded
+          *
+          * @param con - pointer for the connection this response should be sent to
+          * @param code - the HTTP status code
+          * @param json - the JSON encoded body
+          */
+         template<typename T>
+         void send_json_response( detail::connection_ptr<T> con, int code, std::string json ) {
+            send_encoded_response<T>( std::move( con ), code, std::move( json ), false );
+         }
+
+         /**
+          * Send a response body which is already fc::raw packed, as application/octet-stream
+          *
+          * @param con - pointer for the connection this response should be sent to
+          * @param code - the HTTP status code
+          * @param packed - the packed body
+          */
+         template<typename T>
+         void send_binary_response( detail::connection_ptr<T> con, int code, std::string packed ) {
+            send_encoded_response<T>( std::move( con ), code, std::move( packed ), true );
+         }
+
+         template<typename T>
+         void send_encoded_response( detail::connection_ptr<T> con, int code, std::string body, bool binary ) {
+            auto tracked_body = make_in_flight(std::move(body), *this);
+            if (!verify_max_bytes_in_flight(con)) {
+               return;
+            }
+
+            // post back to an HTTP thread to allow the response handler to be called from any thread
+            boost::asio::post( thread_pool->get_executor(), [con, code, binary, tracked_body=std::move(tracked_body)]() mutable {
+               try {
+                  if( binary ) {
+                     con->replace_header( "Content-type", "application/octet-stream" );
+                  }
+                  con->set_body( std::move( *tracked_body ) );
+                  con->set_status( websocketpp::http::status_code::value( code ) );
+                  con->send_http_response();
+               } catch( ... ) {
+                  handle_exception<T>( con );
+               }
+            });
+         }
+
          template<class T>
          void handle_http_request(detail::connection_ptr<T> con) {
             try {
@@ -560,10 +831,19 @@ namespace eosio {
                if( !verify_max_bytes_in_flight( con ) ) return;
 
                std::string resource = con->get_uri()->get_resource();
-               auto handler_itr = url_handlers.find( resource );
-               if( handler_itr != url_handlers.end()) {
+               const detail::internal_url_handler* handler = nullptr;
+               if( accepts_binary( req ) ) {
+                  auto binary_itr = binary_url_handlers.find( resource );
+                  if( binary_itr != binary_url_handlers.end() ) handler = &binary_itr->second;
+               }
+               if( !handler ) {
+                  auto handler_itr = url_handlers.find( resource );
+                  if( handler_itr != url_handlers.end() ) handler = &handler_itr->second;
+               }
+               if( handler ) {
+                  if( !verify_rate_limit( con, resource ) ) return;
                   std::string body = con->get_request_body();
-                  handler_itr->second( make_abstract_conn_ptr<T>(con, *this), std::move( resource ), std::move( body ), make_http_response_handler<T>(con) );
+                  (*handler)( make_abstract_conn_ptr<T>(con, *this), std::move( resource ), std::move( body ), make_http_response_handler<T>(con) );
                } else {
                   fc_dlog( logger, "404 - not found: ${ep}", ("ep", resource) );
                   error_results results{websocketpp::http::status_code::not_found,
@@ -693,6 +973,18 @@ namespace eosio {
              "Additionaly acceptable values for the \"Host\" header of incoming HTTP requests, can be specified multiple times.  Includes http/s_server_address by default.")
             ("http-threads", bpo::value<uint16_t>()->default_value( my->thread_pool_size ),
              "Number of worker threads in http thread pool")
+            ("http-rate-limit", bpo::value<vector<string>>()->composing(),
+             "Limit of an endpoint across all clients as url=requests_per_second[,burst], e.g. /v1/chain/get_table_rows=100,200. "
+             "Requests over the limit get a 429 response before they are queued. Can be specified multiple times.")
+            ("http-client-rate-limit", bpo::value<uint32_t>()->default_value(0),
+             "Cost units per second a single client IP may use across all endpoints, bursts of up to two seconds worth are allowed; 0 to disable.")
+            ("http-request-cost", bpo::value<vector<string>>()->composing(),
+             "Cost of one request to an endpoint against http-client-rate-limit as url=cost, e.g. /v1/chain/get_table_rows=10. "
+             "Endpoints not listed cost 1. Can be specified multiple times.")
+            ("http-lane-capacity", bpo::value<uint32_t>()->default_value(1000),
+             "Requests to app thread endpoints queued at once, more get a 429 response. Requests of a higher priority than medium_low are not limited.")
+            ("http-lane-weight", bpo::value<uint32_t>()->default_value(1),
+             "Queued requests handed to the app thread in a row while other lanes, e.g. p2p transactions, wait.")
             ;
    }
 
@@ -776,6 +1068,44 @@ namespace eosio {
          my->max_bytes_in_flight = options.at( "http-max-bytes-in-flight-mb" ).as<uint32_t>() * 1024 * 1024;
          my->max_response_time = fc::microseconds( options.at("http-max-response-time-ms").as<uint32_t>() * 1000 );
 
+         if( options.count( "http-rate-limit" )) {
+            for( const auto& o : options.at( "http-rate-limit" ).as<vector<string>>() ) {
+               auto url_value = detail::parse_url_option( o, "http-rate-limit" );
+               auto comma = url_value.second.find( ',' );
+               detail::rate_limiter::endpoint_limit l;
+               try {
+                  l.rate = std::stod( url_value.second.substr( 0, comma ) );
+                  l.burst = comma == string::npos ? l.rate : std::stod( url_value.second.substr( comma + 1 ) );
+               } catch( const std::exception& ) {
+                  EOS_THROW( chain::plugin_config_exception, "http-rate-limit ${o} is not of the form url=rate[,burst]", ("o", o) );
+               }
+               EOS_ASSERT( l.rate > 0 && l.burst >= 1, chain::plugin_config_exception,
+                           "http-rate-limit ${o} needs a positive rate and a burst of at least 1", ("o", o) );
+               my->rate_limiter.set_endpoint_limit( url_value.first, l );
+            }
+         }
+         my->rate_limiter.set_client_limit( options.at( "http-client-rate-limit" ).as<uint32_t>() );
+         if( options.count( "http-request-cost" )) {
+            for( const auto& o : options.at( "http-request-cost" ).as<vector<string>>() ) {
+               auto url_value = detail::parse_url_option( o, "http-request-cost" );
+               double cost = 0;
+               try {
+                  cost = std::stod( url_value.second );
+               } catch( const std::exception& ) {}
+               EOS_ASSERT( cost > 0, chain::plugin_config_exception, "http-request-cost ${o} needs a positive cost", ("o", o) );
+               my->rate_limiter.set_endpoint_cost( url_value.first, cost );
+            }
+         }
+
+         EOS_ASSERT( options.at( "http-lane-capacity" ).as<uint32_t>() > 0, chain::plugin_config_exception,
+                     "http-lane-capacity must be greater than 0" );
+         chain::post_lanes::instance().set_post_function( []( int priority, std::function<void()> f ) {
+            app().post( priority, std::move( f ) );
+         } );
+         my->api_lane = chain::post_lanes::instance().add_lane( { "api", appbase::priority::medium_low,
+                                                                  options.at( "http-lane-weight" ).as<uint32_t>(),
+                                                                  options.at( "http-lane-capacity" ).as<uint32_t>() } );
+
          //watch out for the returns above when adding new code here
       } FC_LOG_AND_RETHROW()
    }
@@ -887,6 +1217,7 @@ namespace eosio {
       if( my->thread_pool ) {
          my->thread_pool->stop();
       }
+      chain::post_lanes::instance().clear( my->api_lane );
 
       app().post( 0, [me = my](){} ); // keep my pointer alive until queue is drained
    }
@@ -901,6 +1232,29 @@ namespace eosio {
       my->url_handlers[url] = my->make_http_thread_url_handler(handler);
    }
 
+   void http_plugin::add_async_json_handler(const string& url, const json_url_handler& handler) {
+      fc_ilog( logger, "add api url: ${c}", ("c", url) );
+      my->url_handlers[url] = my->make_http_thread_json_url_handler(handler);
+   }
+
+   void http_plugin::add_binary_handler(const string& url, const binary_url_handler& handler, int priority) {
+      fc_ilog( logger, "add binary api url: ${c}", ("c", url) );
+      my->binary_url_handlers[url] = my->make_app_thread_binary_url_handler(priority, handler);
+   }
+
+   void http_plugin::add_async_binary_handler(const string& url, const binary_url_handler& handler) {
+      fc_ilog( logger, "add binary api url: ${c}", ("c", url) );
+      my->binary_url_handlers[url] = my->make_http_thread_binary_url_handler(handler);
+   }
+
+   void http_plugin::post_http_thread_pool( std::function<void()> f ) {
+      if( my->thread_pool ) {
+         boost::asio::post( my->thread_pool->get_executor(), std::move(f) );
+      } else {
+         f();
+      }
+   }
+
    void http_plugin::handle_exception( const char *api_name, const char *call_name, const string& body, url_response_callback cb ) {
       try {
          try {
@@ -27,6 +27,42 @@ namespace eosio {
     **/
    using url_handler = std::function<void(string,string,url_response_callback)>;
 
+   /**
+    * @brief A callback function provided to a JSON URL handler to
+    * respond with a body which is already JSON encoded
+    *
+    * Arguments: response_code, json_response_body
+    */
+   using url_json_response_callback = std::function<void(int,std::string)>;
+
+   /**
+    * @brief Callback type for a URL handler which encodes its own JSON responses
+    *
+    * The handler must gaurantee that one of the callbacks is called, errors are usually
+    * reported through url_response_callback, e.g. by handle_exception
+    *
+    * Arguments: url, request_body, response_callback, json_response_callback
+    **/
+   using json_url_handler = std::function<void(string,string,url_response_callback,url_json_response_callback)>;
+
+   /**
+    * @brief A callback function provided to a binary URL handler to
+    * respond with an fc::raw packed body, sent as application/octet-stream
+    *
+    * Arguments: response_code, packed_response_body
+    */
+   using url_binary_response_callback = std::function<void(int,std::string)>;
+
+   /**
+    * @brief Callback type for a URL handler answering requests which accept application/octet-stream
+    *
+    * The handler must gaurantee that one of the callbacks is called, errors are reported as JSON
+    * through url_response_callback, e.g. by handle_exception
+    *
+    * Arguments: url, request_body, response_callback, binary_response_callback
+    **/
+   using binary_url_handler = std::function<void(string,string,url_response_callback,url_binary_response_callback)>;
+
    /**
     * @brief An API, containing URLs and handlers
     *
@@ -36,6 +72,11 @@ namespace eosio {
     */
    using api_description = std::map<string, url_handler>;
 
+   /**
+    * @brief Binary handlers of URLs which also have a JSON handler in an api_description
+    */
+   using binary_api_description = std::map<string, binary_url_handler>;
+
    struct http_plugin_defaults {
       //If empty, unix socket support will be completely disabled. If not empty,
       // unix socket support is enabled with the given default path (treated relative
@@ -89,6 +130,25 @@ namespace eosio {
               add_handler(call.first, call.second);
         }
 
+        /// like add_async_handler, for a handler writing large responses as JSON without building a variant first
+        void add_async_json_handler(const string& url, const json_url_handler& handler);
+
+        /// answers the requests of url which accept application/octet-stream, the others still go to its url_handler
+        void add_binary_handler(const string& url, const binary_url_handler& handler, int priority = appbase::priority::medium_low);
+        void add_binary_api(const binary_api_description& api, int priority = appbase::priority::medium_low) {
+           for (const auto& call : api)
+              add_binary_handler(call.first, call.second, priority);
+        }
+
+        void add_async_binary_handler(const string& url, const binary_url_handler& handler);
+        void add_async_binary_api(const binary_api_description& api) {
+           for (const auto& call : api)
+              add_async_binary_handler(call.first, call.second);
+        }
+
+        /// run f on the http thread pool, e.g. to convert a large api result to a variant off the main thread
+        void post_http_thread_pool( std::function<void()> f );
+
         // standard exception handling for api handlers
         static void handle_exception( const char *api_name, const char *call_name, const string& body, url_response_callback cb );
 
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <fc/reflect/reflect.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace eosio {
+
+/// what a producer does when the ring of a handoff_queue is full
+enum class queue_full_policy {
+   block, ///< wait for the writer to make room
+   drop,  ///< discard the entry
+   spill  ///< append to an unbounded overflow list, the ring is used again once the writer emptied it
+};
+
+struct handoff_queue_metrics {
+   std::string name;
+   uint64_t    depth = 0;       ///< entries in the ring
+   uint64_t    spill_depth = 0; ///< entries in the overflow list
+   uint64_t    capacity = 0;
+   uint64_t    pushed = 0;
+   uint64_t    dropped = 0;
+   uint64_t    spilled = 0;
+   uint64_t    blocked_us = 0;  ///< time producers waited for room
+};
+
+/**
+ * Bounded lock-free ring buffer handing entries from producer threads to a single consumer thread, see
+ * http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ * Entries the ring can not take are handled according to the queue_full_policy. Spilled entries keep their order:
+ * while the overflow list is not empty every push goes to it, and the consumer takes it only once the ring is empty.
+ * Waking the consumer is left to the caller.
+ */
+template<typename T>
+class handoff_queue {
+public:
+   handoff_queue() = default;
+   handoff_queue( const handoff_queue& ) = delete;
+   handoff_queue& operator=( const handoff_queue& ) = delete;
+
+   /// must be called before the queue is used, capacity is rounded up to a power of 2
+   void init( std::string name, size_t capacity, queue_full_policy policy ) {
+      size_t size = 2;
+      while( size < capacity ) size <<= 1;
+      _cells.reset( new cell[size] );
+      for( size_t i = 0; i < size; ++i )
+         _cells[i].seq.store( i, std::memory_order_relaxed );
+      _mask = size - 1;
+      _name = std::move( name );
+      _policy = policy;
+   }
+
+   /// @return false if the entry was dropped
+   bool push( T v ) {
+      if( _spill_size.load() == 0 && try_push( v ) ) {
+         ++_pushed;
+         return true;
+      }
+      switch( _policy ) {
+         case queue_full_policy::drop:
+            ++_dropped;
+            return false;
+         case queue_full_policy::spill: {
+            std::lock_guard<std::mutex> g( _spill_mtx );
+            if( _spill_size.load() == 0 && try_push( v ) ) {
+               ++_pushed;
+               return true;
+            }
+            _spill.emplace_back( std::move( v ) );
+            ++_spill_size;
+            ++_spilled;
+            ++_pushed;
+            return true;
+         }
+         case queue_full_policy::block: {
+            const auto start = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> g( _space_mtx );
+            while( !try_push( v ) ) {
+               _producer_waiting = true;
+               _space_cv.wait_for( g, std::chrono::milliseconds( 10 ) );
+            }
+            _producer_waiting = false;
+            _blocked_us += std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - start ).count();
+            ++_pushed;
+            return true;
+         }
+      }
+      return false;
+   }
+
+   /// consumer only, moves all available entries to the back of out
+   template<typename Container>
+   size_t pop_all( Container& out ) {
+      size_t n = 0;
+      T v;
+      while( true ) {
+         while( try_pop( v ) ) {
+            out.emplace_back( std::move( v ) );
+            ++n;
+         }
+         if( _spill_size.load() == 0 )
+            break;
+         std::lock_guard<std::mutex> g( _spill_mtx );
+         if( !ring_empty() )
+            continue; // filled before the first spill, older than the overflow list
+         for( auto& e : _spill )
+            out.emplace_back( std::move( e ) );
+         n += _spill.size();
+         _spill.clear();
+         _spill_size = 0;
+         break;
+      }
+      if( n > 0 && _producer_waiting )
+         _space_cv.notify_all();
+      return n;
+   }
+
+   /// consumer only
+   bool empty() const {
+      return ring_empty() && _spill_size.load() == 0;
+   }
+
+   handoff_queue_metrics metrics() const {
+      handoff_queue_metrics m;
+      m.name = _name;
+      const auto head = _head.load( std::memory_order_relaxed );
+      const auto tail = _tail.load( std::memory_order_relaxed );
+      m.depth = head > tail ? head - tail : 0;
+      m.spill_depth = _spill_size;
+      m.capacity = _mask + 1;
+      m.pushed = _pushed;
+      m.dropped = _dropped;
+      m.spilled = _spilled;
+      m.blocked_us = _blocked_us;
+      return m;
+   }
+
+private:
+   struct cell {
+      std::atomic<size_t> seq;
+      T                   value;
+   };
+
+   bool try_push( T& v ) {
+      auto pos = _head.load( std::memory_order_relaxed );
+      cell* c = nullptr;
+      while( true ) {
+         c = &_cells[pos & _mask];
+         const auto seq = c->seq.load( std::memory_order_acquire );
+         const auto dif = static_cast<intptr_t>( seq ) - static_cast<intptr_t>( pos );
+         if( dif == 0 ) {
+            if( _head.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+               break;
+         } else if( dif < 0 ) {
+            return false;
+         } else {
+            pos = _head.load( std::memory_order_relaxed );
+         }
+      }
+      c->value = std::move( v );
+      c->seq.store( pos + 1, std::memory_order_release );
+      return true;
+   }
+
+   bool try_pop( T& v ) {
+      const auto pos = _tail.load( std::memory_order_relaxed );
+      cell& c = _cells[pos & _mask];
+      if( c.seq.load( std::memory_order_acquire ) != pos + 1 )
+         return false;
+      _tail.store( pos + 1, std::memory_order_relaxed );
+      v = std::move( c.value );
+      c.seq.store( pos + _mask + 1, std::memory_order_release );
+      return true;
+   }
+
+   bool ring_empty() const {
+      const auto pos = _tail.load( std::memory_order_relaxed );
+      return _cells[pos & _mask].seq.load( std::memory_order_acquire ) != pos + 1;
+   }
+
+   std::unique_ptr<cell[]> _cells;
+   size_t                  _mask = 0;
+   alignas(64) std::atomic<size_t> _head{0}; ///< next push
+   alignas(64) std::atomic<size_t> _tail{0}; ///< next pop
+
+   std::string             _name;
+   queue_full_policy       _policy = queue_full_policy::block;
+
+   std::mutex              _spill_mtx;
+   std::deque<T>           _spill;
+   std::atomic<size_t>     _spill_size{0};
+
+   std::mutex              _space_mtx;
+   std::condition_variable _space_cv;
+   std::atomic_bool        _producer_waiting{false};
+
+   std::atomic<uint64_t>   _pushed{0};
+   std::atomic<uint64_t>   _dropped{0};
+   std::atomic<uint64_t>   _spilled{0};
+   std::atomic<uint64_t>   _blocked_us{0};
+};
+
+} // namespace eosio
+
+FC_REFLECT( eosio::handoff_queue_metrics, (name)(depth)(spill_depth)(capacity)(pushed)(dropped)(spilled)(blocked_us) )
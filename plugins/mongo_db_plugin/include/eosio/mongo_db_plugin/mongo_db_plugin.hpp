@@ -1,6 +1,7 @@
 #pragma once
 
 #include <eosio/chain_plugin/chain_plugin.hpp>
+#include <eosio/mongo_db_plugin/handoff_queue.hpp>
 #include <appbase/application.hpp>
 #include <memory>
 
@@ -36,6 +37,9 @@ public:
    void plugin_startup();
    void plugin_shutdown();
 
+   /// depth and overflow counters of the queues feeding the writer threads, empty if the plugin is not configured
+   vector<handoff_queue_metrics> get_queue_metrics() const;
+
 private:
    mongo_db_plugin_impl_ptr my;
 };
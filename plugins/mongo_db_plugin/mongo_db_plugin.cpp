@@ -1,8 +1,11 @@
 #include <eosio/mongo_db_plugin/mongo_db_plugin.hpp>
 #include <eosio/mongo_db_plugin/bson.hpp>
+#include <eosio/mongo_db_plugin/handoff_queue.hpp>
 #include <eosio/chain/eosio_contract.hpp>
 #include <eosio/chain/config.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/signal_stats.hpp>
+#include <eosio/chain/trace_spans.hpp>
 #include <eosio/chain/transaction.hpp>
 #include <eosio/chain/types.hpp>
 
@@ -70,23 +73,35 @@ public:
    fc::optional<boost::signals2::scoped_connection> accepted_transaction_connection;
    fc::optional<boost::signals2::scoped_connection> applied_transaction_connection;
 
+   /// bulk writes of the trace writer, collected over several transaction traces
+   struct trace_bulk_writes {
+      fc::optional<mongocxx::bulk_write> action_traces;
+      fc::optional<mongocxx::bulk_write> trans_traces;
+      size_t                             action_trace_count = 0;
+      size_t                             trans_trace_count = 0;
+   };
+
+   void consume_traces();
    void consume_blocks();
 
    void accepted_block( const chain::block_state_ptr& );
    void applied_irreversible_block(const chain::block_state_ptr&);
    void accepted_transaction(const chain::transaction_metadata_ptr&);
    void applied_transaction(const chain::transaction_trace_ptr&);
-   void process_accepted_transaction(const chain::transaction_metadata_ptr&);
-   void _process_accepted_transaction(const chain::transaction_metadata_ptr&);
-   void process_applied_transaction(const chain::transaction_trace_ptr&);
-   void _process_applied_transaction(const chain::transaction_trace_ptr&);
+   void process_accepted_transaction(const chain::transaction_metadata_ptr&, fc::optional<mongocxx::bulk_write>& bulk_trans, size_t& trans_count);
+   void _process_accepted_transaction(const chain::transaction_metadata_ptr&, fc::optional<mongocxx::bulk_write>& bulk_trans, size_t& trans_count);
+   void process_applied_transaction(const chain::transaction_trace_ptr&, trace_bulk_writes& bulk);
+   void _process_applied_transaction(const chain::transaction_trace_ptr&, trace_bulk_writes& bulk);
+   void write_trace_bulk( trace_bulk_writes& bulk );
+   void write_trans_bulk( fc::optional<mongocxx::bulk_write>& bulk_trans, size_t& trans_count );
    void process_accepted_block( const chain::block_state_ptr& );
    void _process_accepted_block( const chain::block_state_ptr& );
    void process_irreversible_block(const chain::block_state_ptr&);
    void _process_irreversible_block(const chain::block_state_ptr&);
 
-   optional<abi_serializer> get_abi_serializer( account_name n );
-   template<typename T> fc::variant to_variant_with_abi( const T& obj );
+   /// accounts is the accounts collection of the calling writer thread
+   optional<abi_serializer> get_abi_serializer( mongocxx::collection& accounts, account_name n );
+   template<typename T> fc::variant to_variant_with_abi( mongocxx::collection& accounts, const T& obj );
 
    void purge_abi_cache();
 
@@ -114,7 +129,17 @@ public:
    void wipe_database();
    void create_expiration_index(mongocxx::collection& collection, uint32_t expire_after_seconds);
 
-   template<typename Queue, typename Entry> void queue(Queue& queue, const Entry& e);
+   /// wakes a writer thread sleeping on its queues
+   struct writer_signal {
+      std::condition_variable cv;
+      std::atomic_bool        sleeping{false};
+   };
+
+   /// @return false if the queue dropped e
+   template<typename Entry> bool queue(writer_signal& writer, handoff_queue<Entry>& queue, const Entry& e);
+   template<typename Predicate> void wait_for_entries(writer_signal& writer, Predicate has_entries);
+   vector<handoff_queue_metrics> get_queue_metrics() const;
+   void log_queue_backlog();
 
    bool configured{false};
    bool wipe_database_on_startup{false};
@@ -137,29 +162,40 @@ public:
    mongocxx::instance mongo_inst;
    fc::optional<mongocxx::pool> mongo_pool;
 
-   // consum thread
+   // trace writer thread
    mongocxx::collection _accounts;
-   mongocxx::collection _trans;
    mongocxx::collection _trans_traces;
    mongocxx::collection _action_traces;
-   mongocxx::collection _block_states;
-   mongocxx::collection _blocks;
    mongocxx::collection _pub_keys;
    mongocxx::collection _account_controls;
 
+   // block writer thread, reads abis through its own handle of the accounts collection
+   mongocxx::collection _block_writer_accounts;
+   mongocxx::collection _trans;
+   mongocxx::collection _block_states;
+   mongocxx::collection _blocks;
+
    size_t max_queue_size = 0;
-   int queue_sleep_time = 0;
+   queue_full_policy queue_policy = queue_full_policy::spill;
+   size_t bulk_write_size = 1000;
    size_t abi_cache_size = 0;
-   std::deque<chain::transaction_metadata_ptr> transaction_metadata_queue;
+   handoff_queue<chain::transaction_metadata_ptr> transaction_metadata_queue;
    std::deque<chain::transaction_metadata_ptr> transaction_metadata_process_queue;
-   std::deque<chain::transaction_trace_ptr> transaction_trace_queue;
+   handoff_queue<chain::transaction_trace_ptr> transaction_trace_queue;
    std::deque<chain::transaction_trace_ptr> transaction_trace_process_queue;
-   std::deque<chain::block_state_ptr> block_state_queue;
+   handoff_queue<chain::block_state_ptr> block_state_queue;
    std::deque<chain::block_state_ptr> block_state_process_queue;
-   std::deque<chain::block_state_ptr> irreversible_block_state_queue;
+   handoff_queue<chain::block_state_ptr> irreversible_block_state_queue;
    std::deque<chain::block_state_ptr> irreversible_block_state_process_queue;
+   fc::time_point last_backlog_log;
    std::mutex mtx;
-   std::condition_variable condition;
+   writer_signal trace_writer;
+   writer_signal block_writer;
+   std::condition_variable trace_progress; ///< traces_processed advanced or the trace writer exited
+   std::atomic<uint64_t> traces_queued{0};
+   std::atomic<uint64_t> traces_processed{0};
+   std::atomic_bool trace_writer_exited{false};
+   std::thread trace_thread;
    std::thread consume_thread;
    std::atomic_bool done{false};
    std::atomic_bool startup{true};
@@ -183,6 +219,8 @@ public:
    > abi_cache_index_t;
 
    abi_cache_index_t abi_cache_index;
+   std::mutex abi_cache_mtx;         ///< both writers decode with the abi cache
+   uint64_t abi_cache_generation = 0; ///< bumped by every setabi, an abi read before that is not cached
 
    static const action_name newaccount;
    static const action_name setabi;
@@ -284,31 +322,53 @@ bool mongo_db_plugin_impl::filter_include( const transaction& trx ) const
 }
 
 
-template<typename Queue, typename Entry>
-void mongo_db_plugin_impl::queue( Queue& queue, const Entry& e ) {
+template<typename Entry>
+bool mongo_db_plugin_impl::queue( writer_signal& writer, handoff_queue<Entry>& queue, const Entry& e ) {
+   if( !queue.push( e ) ) {
+      const auto m = queue.metrics();
+      if( m.dropped % 1000 == 1 )
+         wlog( "mongo_db_plugin ${q} queue full, ${d} entries dropped", ("q", m.name)("d", m.dropped) );
+      return false;
+   }
+   // pairs with the fence in wait_for_entries, either the writer sees the entry or this sees the writer sleeping
+   std::atomic_thread_fence( std::memory_order_seq_cst );
+   if( writer.sleeping ) {
+      { std::lock_guard<std::mutex> g( mtx ); }
+      writer.cv.notify_one();
+   }
+   return true;
+}
+
+template<typename Predicate>
+void mongo_db_plugin_impl::wait_for_entries( writer_signal& writer, Predicate has_entries ) {
    std::unique_lock<std::mutex> lock( mtx );
-   auto queue_size = queue.size();
-   if( queue_size > max_queue_size ) {
-      lock.unlock();
-      condition.notify_one();
-      queue_sleep_time += 10;
-      if( queue_sleep_time > 1000 )
-         wlog("queue size: ${q}", ("q", queue_size));
-      std::this_thread::sleep_for( std::chrono::milliseconds( queue_sleep_time ));
-      lock.lock();
-   } else {
-      queue_sleep_time -= 10;
-      if( queue_sleep_time < 0 ) queue_sleep_time = 0;
+   writer.sleeping = true;
+   std::atomic_thread_fence( std::memory_order_seq_cst );
+   writer.cv.wait( lock, [&]() { return has_entries() || done; } );
+   writer.sleeping = false;
+}
+
+vector<handoff_queue_metrics> mongo_db_plugin_impl::get_queue_metrics() const {
+   return { transaction_trace_queue.metrics(), transaction_metadata_queue.metrics(),
+            block_state_queue.metrics(), irreversible_block_state_queue.metrics() };
+}
+
+void mongo_db_plugin_impl::log_queue_backlog() {
+   const auto now = fc::time_point::now();
+   if( now - last_backlog_log < fc::seconds(60) ) return;
+   for( const auto& m : get_queue_metrics() ) {
+      if( m.spill_depth > 0 || m.depth > m.capacity / 2 ) {
+         ilog( "mongo_db_plugin ${q} queue backlog, ring ${d}/${c}, spilled ${s}, dropped ${x}",
+               ("q", m.name)("d", m.depth)("c", m.capacity)("s", m.spill_depth)("x", m.dropped) );
+         last_backlog_log = now;
+      }
    }
-   queue.emplace_back( e );
-   lock.unlock();
-   condition.notify_one();
 }
 
 void mongo_db_plugin_impl::accepted_transaction( const chain::transaction_metadata_ptr& t ) {
    try {
       if( store_transactions ) {
-         queue( transaction_metadata_queue, t );
+         queue( block_writer, transaction_metadata_queue, t );
       }
    } catch (fc::exception& e) {
       elog("FC Exception while accepted_transaction ${e}", ("e", e.to_string()));
@@ -344,7 +404,9 @@ void mongo_db_plugin_impl::applied_transaction( const chain::transaction_trace_p
       if( !is_producer && !t->producer_block_id.valid() )
          return;
       // always queue since account information always gathered
-      queue( transaction_trace_queue, t );
+      // the block writer waits for the traces counted here, a dropped one is not
+      if( queue( trace_writer, transaction_trace_queue, t ) )
+         ++traces_queued;
    } catch (fc::exception& e) {
       elog("FC Exception while applied_transaction ${e}", ("e", e.to_string()));
    } catch (std::exception& e) {
@@ -357,7 +419,7 @@ void mongo_db_plugin_impl::applied_transaction( const chain::transaction_trace_p
 void mongo_db_plugin_impl::applied_irreversible_block( const chain::block_state_ptr& bs ) {
    try {
       if( store_blocks || store_block_states || store_transactions ) {
-         queue( irreversible_block_state_queue, bs );
+         queue( block_writer, irreversible_block_state_queue, bs );
       }
    } catch (fc::exception& e) {
       elog("FC Exception while applied_irreversible_block ${e}", ("e", e.to_string()));
@@ -369,6 +431,7 @@ void mongo_db_plugin_impl::applied_irreversible_block( const chain::block_state_
 }
 
 void mongo_db_plugin_impl::accepted_block( const chain::block_state_ptr& bs ) {
+   chain::scoped_span span( "accepted_block", "mongo_db_plugin", bs->block_num );
    try {
       if( !start_block_reached ) {
          if( bs->block_num >= start_block_num ) {
@@ -376,7 +439,7 @@ void mongo_db_plugin_impl::accepted_block( const chain::block_state_ptr& bs ) {
          }
       }
       if( store_blocks || store_block_states ) {
-         queue( block_state_queue, bs );
+         queue( block_writer, block_state_queue, bs );
       }
    } catch (fc::exception& e) {
       elog("FC Exception while accepted_block ${e}", ("e", e.to_string()));
@@ -387,80 +450,113 @@ void mongo_db_plugin_impl::accepted_block( const chain::block_state_ptr& bs ) {
    }
 }
 
-void mongo_db_plugin_impl::consume_blocks() {
+void mongo_db_plugin_impl::consume_traces() {
    try {
       auto mongo_client = mongo_pool->acquire();
       auto& mongo_conn = *mongo_client;
 
       _accounts = mongo_conn[db_name][accounts_col];
-      _trans = mongo_conn[db_name][trans_col];
       _trans_traces = mongo_conn[db_name][trans_traces_col];
       _action_traces = mongo_conn[db_name][action_traces_col];
-      _blocks = mongo_conn[db_name][blocks_col];
-      _block_states = mongo_conn[db_name][block_states_col];
       _pub_keys = mongo_conn[db_name][pub_keys_col];
       _account_controls = mongo_conn[db_name][account_controls_col];
 
       while (true) {
-         std::unique_lock<std::mutex> lock(mtx);
-         while ( transaction_metadata_queue.empty() &&
-                 transaction_trace_queue.empty() &&
-                 block_state_queue.empty() &&
-                 irreversible_block_state_queue.empty() &&
-                 !done ) {
-            condition.wait(lock);
-         }
+         wait_for_entries( trace_writer, [&]() { return !transaction_trace_queue.empty(); } );
 
          // capture for processing
-         size_t transaction_metadata_size = transaction_metadata_queue.size();
-         if (transaction_metadata_size > 0) {
-            transaction_metadata_process_queue = move(transaction_metadata_queue);
-            transaction_metadata_queue.clear();
-         }
-         size_t transaction_trace_size = transaction_trace_queue.size();
-         if (transaction_trace_size > 0) {
-            transaction_trace_process_queue = move(transaction_trace_queue);
-            transaction_trace_queue.clear();
-         }
-         size_t block_state_size = block_state_queue.size();
-         if (block_state_size > 0) {
-            block_state_process_queue = move(block_state_queue);
-            block_state_queue.clear();
-         }
-         size_t irreversible_block_size = irreversible_block_state_queue.size();
-         if (irreversible_block_size > 0) {
-            irreversible_block_state_process_queue = move(irreversible_block_state_queue);
-            irreversible_block_state_queue.clear();
-         }
-
-         lock.unlock();
+         size_t transaction_trace_size = transaction_trace_queue.pop_all( transaction_trace_process_queue );
 
          if (done) {
-            ilog("draining queue, size: ${q}", ("q", transaction_metadata_size + transaction_trace_size + block_state_size + irreversible_block_size));
+            ilog("draining trace queue, size: ${q}", ("q", transaction_trace_size));
          }
 
-         // process transactions
+         // process transactions, their action and transaction traces go out in unordered bulk writes
          auto start_time = fc::time_point::now();
          auto size = transaction_trace_process_queue.size();
+         trace_bulk_writes bulk;
          while (!transaction_trace_process_queue.empty()) {
             const auto& t = transaction_trace_process_queue.front();
-            process_applied_transaction(t);
+            process_applied_transaction(t, bulk);
             transaction_trace_process_queue.pop_front();
+            ++traces_processed;
+            if( bulk.action_trace_count >= bulk_write_size || bulk.trans_trace_count >= bulk_write_size )
+               write_trace_bulk( bulk );
          }
+         write_trace_bulk( bulk );
+         { std::lock_guard<std::mutex> g( mtx ); }
+         trace_progress.notify_all();
          auto time = fc::time_point::now() - start_time;
          auto per = size > 0 ? time.count()/size : 0;
          if( time > fc::microseconds(500000) ) // reduce logging, .5 secs
             ilog( "process_applied_transaction,  time per: ${p}, size: ${s}, time: ${t}", ("s", size)("t", time)("p", per) );
 
-         start_time = fc::time_point::now();
-         size = transaction_metadata_process_queue.size();
+         if( transaction_trace_size == 0 &&
+             done ) {
+            break;
+         }
+      }
+      ilog("mongo_db_plugin trace thread shutdown gracefully");
+   } catch (fc::exception& e) {
+      elog("FC Exception while consuming transaction trace ${e}", ("e", e.to_string()));
+   } catch (std::exception& e) {
+      elog("STD Exception while consuming transaction trace ${e}", ("e", e.what()));
+   } catch (...) {
+      elog("Unknown exception while consuming transaction trace");
+   }
+   trace_writer_exited = true;
+   { std::lock_guard<std::mutex> g( mtx ); }
+   trace_progress.notify_all();
+}
+
+void mongo_db_plugin_impl::consume_blocks() {
+   try {
+      auto mongo_client = mongo_pool->acquire();
+      auto& mongo_conn = *mongo_client;
+
+      _block_writer_accounts = mongo_conn[db_name][accounts_col];
+      _trans = mongo_conn[db_name][trans_col];
+      _blocks = mongo_conn[db_name][blocks_col];
+      _block_states = mongo_conn[db_name][block_states_col];
+
+      while (true) {
+         wait_for_entries( block_writer, [&]() {
+            return !transaction_metadata_queue.empty() || !block_state_queue.empty() || !irreversible_block_state_queue.empty();
+         } );
+         log_queue_backlog();
+
+         // capture for processing
+         size_t transaction_metadata_size = transaction_metadata_queue.pop_all( transaction_metadata_process_queue );
+         size_t block_state_size = block_state_queue.pop_all( block_state_process_queue );
+         size_t irreversible_block_size = irreversible_block_state_queue.pop_all( irreversible_block_state_process_queue );
+
+         // the trace writer keeps the account abis, decode only once it has processed the traces queued before this batch
+         const uint64_t traces_required = traces_queued;
+         {
+            std::unique_lock<std::mutex> lock( mtx );
+            trace_progress.wait( lock, [&]() { return traces_processed >= traces_required || trace_writer_exited; } );
+         }
+
+         if (done) {
+            ilog("draining block queue, size: ${q}", ("q", transaction_metadata_size + block_state_size + irreversible_block_size));
+         }
+
+         // process transactions
+         auto start_time = fc::time_point::now();
+         auto size = transaction_metadata_process_queue.size();
+         fc::optional<mongocxx::bulk_write> bulk_trans;
+         size_t trans_count = 0;
          while (!transaction_metadata_process_queue.empty()) {
             const auto& t = transaction_metadata_process_queue.front();
-            process_accepted_transaction(t);
+            process_accepted_transaction(t, bulk_trans, trans_count);
             transaction_metadata_process_queue.pop_front();
+            if( trans_count >= bulk_write_size )
+               write_trans_bulk( bulk_trans, trans_count );
          }
-         time = fc::time_point::now() - start_time;
-         per = size > 0 ? time.count()/size : 0;
+         // irreversible blocks update the transactions written here
+         write_trans_bulk( bulk_trans, trans_count );
+         auto time = fc::time_point::now() - start_time;
+         auto per = size > 0 ? time.count()/size : 0;
          if( time > fc::microseconds(500000) ) // reduce logging, .5 secs
             ilog( "process_accepted_transaction, time per: ${p}, size: ${s}, time: ${t}", ("s", size)( "t", time )( "p", per ));
 
@@ -491,7 +587,6 @@ void mongo_db_plugin_impl::consume_blocks() {
             ilog( "process_irreversible_block,   time per: ${p}, size: ${s}, time: ${t}", ("s", size)("t", time)("p", per) );
 
          if( transaction_metadata_size == 0 &&
-             transaction_trace_size == 0 &&
              block_state_size == 0 &&
              irreversible_block_size == 0 &&
              done ) {
@@ -588,22 +683,27 @@ void mongo_db_plugin_impl::purge_abi_cache() {
    }
 }
 
-optional<abi_serializer> mongo_db_plugin_impl::get_abi_serializer( account_name n ) {
+optional<abi_serializer> mongo_db_plugin_impl::get_abi_serializer( mongocxx::collection& accounts, account_name n ) {
    using bsoncxx::builder::basic::kvp;
    using bsoncxx::builder::basic::make_document;
    if( n.good()) {
       try {
 
-         auto itr = abi_cache_index.find( n );
-         if( itr != abi_cache_index.end() ) {
-            abi_cache_index.modify( itr, []( auto& entry ) {
-               entry.last_accessed = fc::time_point::now();
-            });
+         uint64_t generation = 0;
+         {
+            std::lock_guard<std::mutex> g( abi_cache_mtx );
+            auto itr = abi_cache_index.find( n );
+            if( itr != abi_cache_index.end() ) {
+               abi_cache_index.modify( itr, []( auto& entry ) {
+                  entry.last_accessed = fc::time_point::now();
+               });
 
-            return itr->serializer;
+               return itr->serializer;
+            }
+            generation = abi_cache_generation;
          }
 
-         auto account = _accounts.find_one( make_document( kvp("name", n.to_string())) );
+         auto account = accounts.find_one( make_document( kvp("name", n.to_string())) );
          if(account) {
             auto view = account->view();
             abi_def abi;
@@ -615,7 +715,6 @@ optional<abi_serializer> mongo_db_plugin_impl::get_abi_serializer( account_name
                   return optional<abi_serializer>();
                }
 
-               purge_abi_cache(); // make room if necessary
                abi_cache entry;
                entry.account = n;
                entry.last_accessed = fc::time_point::now();
@@ -662,7 +761,14 @@ optional<abi_serializer> mongo_db_plugin_impl::get_abi_serializer( account_name
                }
                abis.set_abi( abi, abi_serializer::create_yield_function( abi_serializer_max_time ) );
                entry.serializer.emplace( std::move( abis ) );
-               abi_cache_index.insert( entry );
+               {
+                  std::lock_guard<std::mutex> g( abi_cache_mtx );
+                  // a setabi written after the read above would leave a stale abi in the cache
+                  if( generation == abi_cache_generation ) {
+                     purge_abi_cache(); // make room if necessary
+                     abi_cache_index.insert( entry );
+                  }
+               }
                return entry.serializer;
             }
          }
@@ -672,18 +778,19 @@ optional<abi_serializer> mongo_db_plugin_impl::get_abi_serializer( account_name
 }
 
 template<typename T>
-fc::variant mongo_db_plugin_impl::to_variant_with_abi( const T& obj ) {
+fc::variant mongo_db_plugin_impl::to_variant_with_abi( mongocxx::collection& accounts, const T& obj ) {
    fc::variant pretty_output;
    abi_serializer::to_variant( obj, pretty_output,
-                               [&]( account_name n ) { return get_abi_serializer( n ); },
+                               [&]( account_name n ) { return get_abi_serializer( accounts, n ); },
                                abi_serializer::create_yield_function( abi_serializer_max_time ) );
    return pretty_output;
 }
 
-void mongo_db_plugin_impl::process_accepted_transaction( const chain::transaction_metadata_ptr& t ) {
+void mongo_db_plugin_impl::process_accepted_transaction( const chain::transaction_metadata_ptr& t,
+                                                         fc::optional<mongocxx::bulk_write>& bulk_trans, size_t& trans_count ) {
    try {
       if( start_block_reached ) {
-         _process_accepted_transaction( t );
+         _process_accepted_transaction( t, bulk_trans, trans_count );
       }
    } catch (fc::exception& e) {
       elog("FC Exception while processing accepted transaction metadata: ${e}", ("e", e.to_detail_string()));
@@ -694,10 +801,10 @@ void mongo_db_plugin_impl::process_accepted_transaction( const chain::transactio
    }
 }
 
-void mongo_db_plugin_impl::process_applied_transaction( const chain::transaction_trace_ptr& t ) {
+void mongo_db_plugin_impl::process_applied_transaction( const chain::transaction_trace_ptr& t, trace_bulk_writes& bulk ) {
    try {
       // always call since we need to capture setabi on accounts even if not storing transaction traces
-      _process_applied_transaction( t );
+      _process_applied_transaction( t, bulk );
    } catch (fc::exception& e) {
       elog("FC Exception while processing applied transaction trace: ${e}", ("e", e.to_detail_string()));
    } catch (std::exception& e) {
@@ -735,7 +842,8 @@ void mongo_db_plugin_impl::process_accepted_block( const chain::block_state_ptr&
    }
 }
 
-void mongo_db_plugin_impl::_process_accepted_transaction( const chain::transaction_metadata_ptr& t ) {
+void mongo_db_plugin_impl::_process_accepted_transaction( const chain::transaction_metadata_ptr& t,
+                                                          fc::optional<mongocxx::bulk_write>& bulk_trans, size_t& trans_count ) {
    using namespace bsoncxx::types;
    using bsoncxx::builder::basic::kvp;
    using bsoncxx::builder::basic::make_document;
@@ -756,7 +864,7 @@ void mongo_db_plugin_impl::_process_accepted_transaction( const chain::transacti
 
    trans_doc.append( kvp( "trx_id", trx_id_str ) );
 
-   auto v = to_variant_with_abi( trx );
+   auto v = to_variant_with_abi( _block_writer_accounts, trx );
 
    try {
       const auto& trx_value = to_bson( v );
@@ -800,18 +908,62 @@ void mongo_db_plugin_impl::_process_accepted_transaction( const chain::transacti
    trans_doc.append( kvp( "createdAt", b_date{now} ) );
 
    try {
-      mongocxx::options::update update_opts{};
-      update_opts.upsert( true );
-      if( !_trans.update_one( make_document( kvp( "trx_id", trx_id_str ) ),
-                              make_document( kvp( "$set", trans_doc.view() ) ), update_opts ) ) {
-         EOS_ASSERT( false, chain::mongo_db_insert_fail, "Failed to insert trans ${id}", ("id", trx_id) );
+      if( !bulk_trans ) {
+         // ordered, a transaction accepted twice in one batch is upserted twice
+         mongocxx::options::bulk_write bulk_opts;
+         bulk_opts.ordered( true );
+         bulk_trans.emplace( _trans.create_bulk_write( bulk_opts ) );
       }
+      mongocxx::model::update_one update_op{make_document( kvp( "trx_id", trx_id_str ) ),
+                                            make_document( kvp( "$set", trans_doc.view() ) )};
+      update_op.upsert( true );
+      bulk_trans->append( update_op );
+      ++trans_count;
    } catch( ... ) {
       handle_mongo_exception( "trans insert", __LINE__ );
    }
 
 }
 
+void mongo_db_plugin_impl::write_trans_bulk( fc::optional<mongocxx::bulk_write>& bulk_trans, size_t& trans_count ) {
+   if( trans_count > 0 ) {
+      try {
+         if( !bulk_trans->execute() ) {
+            EOS_ASSERT( false, chain::mongo_db_insert_fail, "Bulk transactions insert failed" );
+         }
+      } catch( ... ) {
+         handle_mongo_exception( "bulk trans insert", __LINE__ );
+      }
+   }
+   bulk_trans.reset();
+   trans_count = 0;
+}
+
+void mongo_db_plugin_impl::write_trace_bulk( trace_bulk_writes& bulk ) {
+   if( bulk.trans_trace_count > 0 ) {
+      try {
+         if( !bulk.trans_traces->execute() ) {
+            EOS_ASSERT( false, chain::mongo_db_insert_fail, "Bulk transaction traces insert failed" );
+         }
+      } catch( ... ) {
+         handle_mongo_exception( "trans_traces insert", __LINE__ );
+      }
+   }
+   if( bulk.action_trace_count > 0 ) {
+      try {
+         if( !bulk.action_traces->execute() ) {
+            EOS_ASSERT( false, chain::mongo_db_insert_fail, "Bulk action traces insert failed" );
+         }
+      } catch( ... ) {
+         handle_mongo_exception( "action traces insert", __LINE__ );
+      }
+   }
+   bulk.action_traces.reset();
+   bulk.trans_traces.reset();
+   bulk.action_trace_count = 0;
+   bulk.trans_trace_count = 0;
+}
+
 bool
 mongo_db_plugin_impl::add_action_trace( mongocxx::bulk_write& bulk_action_traces, const chain::action_trace& atrace,
                                         const chain::transaction_trace_ptr& t,
@@ -834,7 +986,7 @@ mongo_db_plugin_impl::add_action_trace( mongocxx::bulk_write& bulk_action_traces
       // improve data distributivity when using mongodb sharding
       action_traces_doc.append( kvp( "_id", make_custom_oid() ) );
 
-      auto v = to_variant_with_abi( atrace );
+      auto v = to_variant_with_abi( _accounts, atrace );
       try {
          action_traces_doc.append( bsoncxx::builder::concatenate_doc{to_bson( v )} );
       } catch( bsoncxx::exception& e ) {
@@ -857,7 +1009,7 @@ mongo_db_plugin_impl::add_action_trace( mongocxx::bulk_write& bulk_action_traces
 }
 
 
-void mongo_db_plugin_impl::_process_applied_transaction( const chain::transaction_trace_ptr& t ) {
+void mongo_db_plugin_impl::_process_applied_transaction( const chain::transaction_trace_ptr& t, trace_bulk_writes& bulk ) {
    using namespace bsoncxx::types;
    using bsoncxx::builder::basic::kvp;
 
@@ -868,14 +1020,16 @@ void mongo_db_plugin_impl::_process_applied_transaction( const chain::transactio
 
    mongocxx::options::bulk_write bulk_opts;
    bulk_opts.ordered(false);
-   mongocxx::bulk_write bulk_action_traces = _action_traces.create_bulk_write(bulk_opts);
-   bool write_atraces = false;
+   if( !bulk.action_traces ) {
+      bulk.action_traces.emplace( _action_traces.create_bulk_write(bulk_opts) );
+   }
    bool write_ttrace = false; // filters apply to transaction_traces as well
    bool executed = t->receipt.valid() && t->receipt->status == chain::transaction_receipt_header::executed;
 
    for( const auto& atrace : t->action_traces ) {
       try {
-         write_atraces |= add_action_trace( bulk_action_traces, atrace, t, executed, now, write_ttrace );
+         if( add_action_trace( *bulk.action_traces, atrace, t, executed, now, write_ttrace ) )
+            ++bulk.action_trace_count;
       } catch(...) {
          handle_mongo_exception("add action traces", __LINE__);
       }
@@ -887,7 +1041,7 @@ void mongo_db_plugin_impl::_process_applied_transaction( const chain::transactio
 
    if( store_transaction_traces && write_ttrace ) {
       try {
-         auto v = to_variant_with_abi( *t );
+         auto v = to_variant_with_abi( _accounts, *t );
          try {
             trans_traces_doc.append( bsoncxx::builder::concatenate_doc{to_bson( v )} );
          } catch( bsoncxx::exception& e ) {
@@ -898,30 +1052,16 @@ void mongo_db_plugin_impl::_process_applied_transaction( const chain::transactio
          }
          trans_traces_doc.append( kvp( "createdAt", b_date{now} ) );
 
-         try {
-            if( !_trans_traces.insert_one( trans_traces_doc.view() ) ) {
-               EOS_ASSERT( false, chain::mongo_db_insert_fail, "Failed to insert trans ${id}", ("id", t->id) );
-            }
-         } catch( ... ) {
-            handle_mongo_exception( "trans_traces insert: " + t->id.str(), __LINE__ );
+         if( !bulk.trans_traces ) {
+            bulk.trans_traces.emplace( _trans_traces.create_bulk_write(bulk_opts) );
          }
+         mongocxx::model::insert_one insert_op{trans_traces_doc.view()};
+         bulk.trans_traces->append( insert_op );
+         ++bulk.trans_trace_count;
       } catch( ... ) {
          handle_mongo_exception( "trans_traces serialization: " + t->id.str(), __LINE__ );
       }
    }
-
-   // insert action_traces
-   if( write_atraces ) {
-      try {
-         if( !bulk_action_traces.execute() ) {
-            EOS_ASSERT( false, chain::mongo_db_insert_fail,
-                        "Bulk action traces insert failed for transaction trace: ${id}", ("id", t->id) );
-         }
-      } catch( ... ) {
-         handle_mongo_exception( "action traces insert", __LINE__ );
-      }
-   }
-
 }
 
 void mongo_db_plugin_impl::_process_accepted_block( const chain::block_state_ptr& bs ) {
@@ -982,7 +1122,7 @@ void mongo_db_plugin_impl::_process_accepted_block( const chain::block_state_ptr
       block_doc.append( kvp( "block_num", b_int32{static_cast<int32_t>(block_num)} ),
                         kvp( "block_id", block_id_str ) );
 
-      auto v = to_variant_with_abi( *bs->block );
+      auto v = to_variant_with_abi( _block_writer_accounts, *bs->block );
       try {
          block_doc.append( kvp( "block", to_bson( v ) ) );
       } catch( bsoncxx::exception& e ) {
@@ -1273,8 +1413,6 @@ void mongo_db_plugin_impl::update_account(const chain::action& act)
                std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()} );
          auto setabi = act.data_as<chain::setabi>();
 
-         abi_cache_index.erase( setabi.account );
-
          auto account = find_account( _accounts, setabi.account );
          if( !account ) {
             create_account( _accounts, setabi.account, now );
@@ -1304,6 +1442,11 @@ void mongo_db_plugin_impl::update_account(const chain::action& act)
                } catch(...) {}
             }
          }
+
+         // only after the update, the block writer may have read the previous abi in the meantime
+         std::lock_guard<std::mutex> g( abi_cache_mtx );
+         abi_cache_index.erase( setabi.account );
+         ++abi_cache_generation;
       }
    } catch( fc::exception& e ) {
       // if unable to unpack native type, skip account creation
@@ -1318,9 +1461,14 @@ mongo_db_plugin_impl::~mongo_db_plugin_impl() {
    if (!startup) {
       try {
          ilog( "mongo_db_plugin shutdown in process please be patient this can take a few minutes" );
-         done = true;
-         condition.notify_one();
+         {
+            std::lock_guard<std::mutex> g( mtx );
+            done = true;
+         }
+         trace_writer.cv.notify_one();
+         block_writer.cv.notify_one();
 
+         trace_thread.join();
          consume_thread.join();
 
          mongo_pool.reset();
@@ -1485,6 +1633,10 @@ void mongo_db_plugin_impl::init() {
 
    ilog("starting db plugin thread");
 
+   trace_thread = std::thread( [this] {
+      fc::set_os_thread_name( "mongodb-tr" );
+      consume_traces();
+   } );
    consume_thread = std::thread( [this] {
       fc::set_os_thread_name( "mongodb" );
       consume_blocks();
@@ -1510,7 +1662,12 @@ void mongo_db_plugin::set_program_options(options_description& cli, options_desc
 {
    cfg.add_options()
          ("mongodb-queue-size,q", bpo::value<uint32_t>()->default_value(1024),
-         "The target queue size between nodeos and MongoDB plugin thread.")
+         "The capacity of each queue between nodeos and the MongoDB plugin threads, rounded up to a power of 2.")
+         ("mongodb-queue-full-policy", bpo::value<std::string>()->default_value("spill"),
+          "What happens to a block, transaction or trace when its queue is full: 'block' waits for room, which slows down"
+          " the chain, 'drop' discards it, which leaves stale abis if a setabi is dropped, 'spill' queues it in memory without bound.")
+         ("mongodb-bulk-write-size", bpo::value<uint32_t>()->default_value(1000),
+          "The maximum number of documents per bulk write of transactions, transaction traces or action traces.")
          ("mongodb-abi-cache-size", bpo::value<uint32_t>()->default_value(2048),
           "The maximum size of the abi cache for serializing data.")
          ("mongodb-wipe", bpo::bool_switch()->default_value(false),
@@ -1568,6 +1725,26 @@ void mongo_db_plugin::plugin_initialize(const variables_map& options)
          if( options.count( "mongodb-queue-size" )) {
             my->max_queue_size = options.at( "mongodb-queue-size" ).as<uint32_t>();
          }
+         if( options.count( "mongodb-queue-full-policy" )) {
+            const auto& policy = options.at( "mongodb-queue-full-policy" ).as<std::string>();
+            if( policy == "block" ) {
+               my->queue_policy = queue_full_policy::block;
+            } else if( policy == "drop" ) {
+               my->queue_policy = queue_full_policy::drop;
+            } else if( policy == "spill" ) {
+               my->queue_policy = queue_full_policy::spill;
+            } else {
+               EOS_ASSERT( false, chain::plugin_config_exception, "Invalid value ${p} for mongodb-queue-full-policy", ("p", policy) );
+            }
+         }
+         my->transaction_trace_queue.init( "transaction_traces", my->max_queue_size, my->queue_policy );
+         my->transaction_metadata_queue.init( "transactions", my->max_queue_size, my->queue_policy );
+         my->block_state_queue.init( "blocks", my->max_queue_size, my->queue_policy );
+         my->irreversible_block_state_queue.init( "irreversible_blocks", my->max_queue_size, my->queue_policy );
+         if( options.count( "mongodb-bulk-write-size" )) {
+            my->bulk_write_size = options.at( "mongodb-bulk-write-size" ).as<uint32_t>();
+            EOS_ASSERT( my->bulk_write_size > 0, chain::plugin_config_exception, "mongodb-bulk-write-size > 0 required" );
+         }
          if( options.count( "mongodb-abi-cache-size" )) {
             my->abi_cache_size = options.at( "mongodb-abi-cache-size" ).as<uint32_t>();
             EOS_ASSERT( my->abi_cache_size > 0, chain::plugin_config_exception, "mongodb-abi-cache-size > 0 required" );
@@ -1646,21 +1823,25 @@ void mongo_db_plugin::plugin_initialize(const variables_map& options)
          auto& chain = chain_plug->chain();
          my->chain_id.emplace( chain.get_chain_id());
 
-         my->accepted_block_connection.emplace( chain.accepted_block.connect( [&]( const chain::block_state_ptr& bs ) {
+         my->accepted_block_connection.emplace( chain.accepted_block.connect( chain::timed_slot( "accepted_block", "mongo_db_plugin",
+               [&]( const chain::block_state_ptr& bs ) {
             my->accepted_block( bs );
-         } ));
+         } )));
          my->irreversible_block_connection.emplace(
-               chain.irreversible_block.connect( [&]( const chain::block_state_ptr& bs ) {
+               chain.irreversible_block.connect( chain::timed_slot( "irreversible_block", "mongo_db_plugin",
+                     [&]( const chain::block_state_ptr& bs ) {
                   my->applied_irreversible_block( bs );
-               } ));
+               } )));
          my->accepted_transaction_connection.emplace(
-               chain.accepted_transaction.connect( [&]( const chain::transaction_metadata_ptr& t ) {
+               chain.accepted_transaction.connect( chain::timed_slot( "accepted_transaction", "mongo_db_plugin",
+                     [&]( const chain::transaction_metadata_ptr& t ) {
                   my->accepted_transaction( t );
-               } ));
+               } )));
          my->applied_transaction_connection.emplace(
-               chain.applied_transaction.connect( [&]( std::tuple<const chain::transaction_trace_ptr&, const chain::signed_transaction&> t ) {
+               chain.applied_transaction.connect( chain::timed_slot( "applied_transaction", "mongo_db_plugin",
+                     [&]( std::tuple<const chain::transaction_trace_ptr&, const chain::signed_transaction&> t ) {
                   my->applied_transaction( std::get<0>(t) );
-               } ));
+               } )));
 
          if( my->wipe_database_on_startup ) {
             my->wipe_database();
@@ -1677,6 +1858,12 @@ void mongo_db_plugin::plugin_startup()
 {
 }
 
+vector<handoff_queue_metrics> mongo_db_plugin::get_queue_metrics() const
+{
+   if( !my || !my->configured ) return {};
+   return my->get_queue_metrics();
+}
+
 void mongo_db_plugin::plugin_shutdown()
 {
    my->accepted_block_connection.reset();
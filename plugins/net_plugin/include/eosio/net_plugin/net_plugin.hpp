@@ -13,6 +13,30 @@ namespace eosio {
       handshake_message last_handshake;
    };
 
+   struct connection_metrics {
+      string                      peer;
+      uint64_t                    bytes_received = 0;
+      uint64_t                    bytes_sent = 0;
+      std::map<string, uint64_t>  messages_received; ///< by net_message type
+      uint32_t                    write_queue_bytes = 0;
+      uint64_t                    dropped_duplicate_blocks = 0;
+      uint64_t                    dropped_duplicate_trxs = 0;
+      int64_t                     rtt_us = 0;            ///< 0 if not measured yet
+      int64_t                     sync_us_per_block = 0; ///< average over completed sync chunks, 0 if none
+      uint16_t                    sync_failures = 0;
+      uint64_t                    compact_blocks_rebuilt = 0;
+      uint64_t                    compact_block_fallbacks = 0; ///< compact blocks that could not be rebuilt, fetched in full
+   };
+
+   struct net_metrics {
+      vector<connection_metrics>  connections;
+      uint64_t                    tracked_block_states = 0; ///< dispatch_manager peer block entries
+      uint64_t                    tracked_trx_states = 0;   ///< dispatch_manager peer transaction entries
+      uint64_t                    announced_trxs = 0;
+      uint64_t                    received_trxs = 0;        ///< transaction bodies kept for rebuilding compact blocks
+      uint64_t                    lock_wait_us = 0;         ///< time spent waiting for dispatch_manager locks
+   };
+
    class net_plugin : public appbase::plugin<net_plugin>
    {
       public:
@@ -31,6 +55,7 @@ namespace eosio {
         string                       disconnect( const string& endpoint );
         optional<connection_status>  status( const string& endpoint )const;
         vector<connection_status>    connections()const;
+        net_metrics                  metrics()const;
 
       private:
         std::shared_ptr<class net_plugin_impl> my;
@@ -39,3 +64,7 @@ namespace eosio {
 }
 
 FC_REFLECT( eosio::connection_status, (peer)(connecting)(syncing)(last_handshake) )
+FC_REFLECT( eosio::connection_metrics, (peer)(bytes_received)(bytes_sent)(messages_received)(write_queue_bytes)
+            (dropped_duplicate_blocks)(dropped_duplicate_trxs)(rtt_us)(sync_us_per_block)(sync_failures)
+            (compact_blocks_rebuilt)(compact_block_fallbacks) )
+FC_REFLECT( eosio::net_metrics, (connections)(tracked_block_states)(tracked_trx_states)(announced_trxs)(received_trxs)(lock_wait_us) )
@@ -135,6 +135,75 @@ namespace eosio {
       uint32_t end_block{0};
    };
 
+   /// zlib compressed fc::raw pack of a signed_block, only sent to peers with a protocol version supporting it
+   struct compressed_signed_block {
+      vector<char> data;
+   };
+
+   /// a transaction of a compact_block_message the receiver is expected to hold, see short_trx_id
+   struct compact_block_trx {
+      transaction_receipt_header receipt;
+      uint64_t                   short_id = 0; ///< last 8 bytes of the transaction id
+   };
+
+   /**
+    * A block relayed as its header and the short ids of its transactions, only sent to peers with a protocol
+    * version supporting it. The receiver rebuilds the block from the transactions it already received and checks
+    * it against transaction_mroot. Receipts of transactions the peer is not known to hold, and of deferred
+    * transactions which are only referred to by id anyway, are sent in full.
+    */
+   struct compact_block_message {
+      signed_block_header                              header;
+      extensions_type                                  block_extensions;
+      vector<compact_block_trx>                        trxs;      ///< the transactions not in prefilled, in block order
+      vector<std::pair<uint32_t, transaction_receipt>> prefilled; ///< position in the block and receipt, by position
+   };
+
+   /// positions of the transactions of a compact_block_message the receiver does not hold
+   struct get_block_trxs_message {
+      block_id_type    block_id;
+      vector<uint32_t> indexes;
+   };
+
+   /// reply to get_block_trxs_message, the transactions in the order they were asked for
+   struct block_trxs_message {
+      block_id_type              block_id;
+      vector<packed_transaction> trxs;
+   };
+
+   /// a snapshot file a peer serves, hash is the sha256 of the whole file
+   struct snapshot_entry {
+      block_id_type block_id;
+      uint64_t      size = 0;
+      fc::sha256    hash;
+   };
+
+   /// asks for the snapshots a peer serves of blocks from min_block_num, only sent to peers with a protocol version supporting it
+   struct get_snapshots_message {
+      uint32_t min_block_num = 0;
+   };
+
+   /// reply to get_snapshots_message, empty when the peer serves none
+   struct snapshots_message {
+      vector<snapshot_entry> snapshots;
+   };
+
+   /// asks for size bytes of the snapshot of block_id from offset
+   struct get_snapshot_chunk_message {
+      block_id_type block_id;
+      uint64_t      offset = 0;
+      uint32_t      size = 0;
+   };
+
+   /// reply to get_snapshot_chunk_message, data is empty when the peer no longer serves the snapshot
+   struct snapshot_chunk_message {
+      block_id_type block_id;
+      uint64_t      offset = 0;
+      vector<char>  data;
+   };
+
+   // the alternatives after packed_transaction are this fork's and are only exchanged with peers that
+   // negotiated its protocol versions, upstream assigns the same indexes to other messages
    using net_message = static_variant<handshake_message,
                                       chain_size_message,
                                       go_away_message,
@@ -143,7 +212,15 @@ namespace eosio {
                                       request_message,
                                       sync_request_message,
                                       signed_block,         // which = 7
-                                      packed_transaction>;  // which = 8
+                                      packed_transaction,   // which = 8
+                                      compressed_signed_block, // which = 9
+                                      compact_block_message,   // which = 10
+                                      get_block_trxs_message,
+                                      block_trxs_message,
+                                      get_snapshots_message,
+                                      snapshots_message,
+                                      get_snapshot_chunk_message,
+                                      snapshot_chunk_message>;
 
 } // namespace eosio
 
@@ -162,6 +239,16 @@ FC_REFLECT( eosio::time_message, (org)(rec)(xmt)(dst) )
 FC_REFLECT( eosio::notice_message, (known_trx)(known_blocks) )
 FC_REFLECT( eosio::request_message, (req_trx)(req_blocks) )
 FC_REFLECT( eosio::sync_request_message, (start_block)(end_block) )
+FC_REFLECT( eosio::compressed_signed_block, (data) )
+FC_REFLECT( eosio::compact_block_trx, (receipt)(short_id) )
+FC_REFLECT( eosio::compact_block_message, (header)(block_extensions)(trxs)(prefilled) )
+FC_REFLECT( eosio::get_block_trxs_message, (block_id)(indexes) )
+FC_REFLECT( eosio::block_trxs_message, (block_id)(trxs) )
+FC_REFLECT( eosio::snapshot_entry, (block_id)(size)(hash) )
+FC_REFLECT( eosio::get_snapshots_message, (min_block_num) )
+FC_REFLECT( eosio::snapshots_message, (snapshots) )
+FC_REFLECT( eosio::get_snapshot_chunk_message, (block_id)(offset)(size) )
+FC_REFLECT( eosio::snapshot_chunk_message, (block_id)(offset)(data) )
 
 /**
  *
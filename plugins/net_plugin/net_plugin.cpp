@@ -5,8 +5,13 @@
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/block.hpp>
+#include <eosio/chain/merkle.hpp>
+#include <eosio/chain/pack_buffer.hpp>
 #include <eosio/chain/plugin_interface.hpp>
+#include <eosio/chain/post_lanes.hpp>
+#include <eosio/chain/signal_stats.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/trace_spans.hpp>
 #include <eosio/producer_plugin/producer_plugin.hpp>
 #include <eosio/chain/contract_types.hpp>
 
@@ -23,9 +28,23 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ip/host_name.hpp>
 #include <boost/asio/steady_timer.hpp>
-
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <list>
+#include <map>
+#include <set>
 #include <shared_mutex>
+#include <thread>
 
 using namespace eosio::chain::plugin_interface;
 
@@ -38,6 +57,7 @@ namespace eosio {
    using boost::asio::ip::address_v4;
    using boost::asio::ip::host_name;
    using boost::multi_index_container;
+   namespace bfs = boost::filesystem;
 
    using fc::time_point;
    using fc::time_point_sec;
@@ -90,6 +110,59 @@ namespace eosio {
       >
    node_transaction_index;
 
+   /// body of a transaction announced by id, kept for the peers that request it
+   struct announced_trx_state {
+      transaction_id_type                id;
+      time_point_sec                     expires;
+      std::shared_ptr<std::vector<char>> send_buffer;
+   };
+
+   typedef multi_index_container<
+      announced_trx_state,
+      indexed_by<
+         ordered_unique<
+            tag<by_id>,
+            member<announced_trx_state, transaction_id_type, &announced_trx_state::id>,
+            sha256_less
+         >,
+         ordered_non_unique<
+            tag< by_expiry >,
+            member< announced_trx_state, fc::time_point_sec, &announced_trx_state::expires > >
+         >
+      >
+   announced_trx_index;
+
+   /// compact blocks refer to transactions by the last word of their id, which is hash output like all of it
+   inline uint64_t short_trx_id( const transaction_id_type& id ) { return id._hash[3]; }
+
+   struct by_short_id;
+
+   /// body of a transaction received from a peer, kept for rebuilding the compact blocks that include it
+   struct received_trx_state {
+      transaction_id_type    id;
+      uint64_t               short_id = 0;
+      time_point_sec         expires;
+      packed_transaction_ptr trx;
+   };
+
+   typedef multi_index_container<
+      received_trx_state,
+      indexed_by<
+         ordered_unique<
+            tag<by_id>,
+            member<received_trx_state, transaction_id_type, &received_trx_state::id>,
+            sha256_less
+         >,
+         ordered_non_unique<
+            tag<by_short_id>,
+            member<received_trx_state, uint64_t, &received_trx_state::short_id> >,
+         ordered_non_unique<
+            tag< by_expiry >,
+            member< received_trx_state, fc::time_point_sec, &received_trx_state::expires > >
+         >
+      >
+   received_trx_index;
+
    struct peer_block_state {
       block_id_type id;
       uint32_t      block_num = 0;
@@ -121,6 +194,156 @@ namespace eosio {
       > peer_block_state_index;
 
 
+   /// a container split by id into shards with a mutex each, so threads touching different ids do not contend
+   /// std::mutex that accumulates the time spent waiting for it
+   class wait_timed_mutex {
+   public:
+      void lock() {
+         if( mtx.try_lock() ) return;
+         const auto start = std::chrono::steady_clock::now();
+         mtx.lock();
+         wait_ns += std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start ).count();
+      }
+      bool try_lock() { return mtx.try_lock(); }
+      void unlock() { mtx.unlock(); }
+
+      uint64_t wait_time_ns() const { return wait_ns; }
+
+   private:
+      std::mutex            mtx;
+      std::atomic<uint64_t> wait_ns{0};
+   };
+
+   template<typename Index>
+   class sharded_index {
+   public:
+      static constexpr size_t num_shards = 16;
+
+      struct shard {
+         mutable wait_timed_mutex mtx;
+         Index                    index;
+      };
+
+      // the first word of a block id starts with the block number, the last one is hash output for any id
+      shard&       for_id( const fc::sha256& id )       { return shards[id._hash[3] % num_shards]; }
+      const shard& for_id( const fc::sha256& id ) const { return shards[id._hash[3] % num_shards]; }
+      /// the shard of the ids whose short_trx_id is short_id
+      const shard& for_short_id( uint64_t short_id ) const { return shards[short_id % num_shards]; }
+
+      template<typename F>
+      void for_each_shard( F&& f ) {
+         for( auto& s : shards ) {
+            std::lock_guard<wait_timed_mutex> g( s.mtx );
+            f( s.index );
+         }
+      }
+
+      size_t size() const {
+         size_t n = 0;
+         for( const auto& s : shards ) {
+            std::lock_guard<wait_timed_mutex> g( s.mtx );
+            n += s.index.size();
+         }
+         return n;
+      }
+
+      uint64_t lock_wait_ns() const {
+         uint64_t ns = 0;
+         for( const auto& s : shards ) ns += s.mtx.wait_time_ns();
+         return ns;
+      }
+
+   private:
+      std::array<shard, num_shards> shards;
+   };
+
+   /// packed block messages by block id, so a block sent to many peers is serialized once
+   class block_buffer_cache {
+   public:
+      using buffer_ptr = std::shared_ptr<std::vector<char>>;
+
+      static constexpr size_t default_max_bytes = 64*1024*1024; // several sync-fetch-span chunks of large blocks
+
+      explicit block_buffer_cache( size_t max_bytes = default_max_bytes ) : max_bytes( max_bytes ) {}
+
+      /// the cached message of id, create packs it on a miss, outside of the lock
+      template<typename F>
+      buffer_ptr get( const block_id_type& id, bool compressed, F&& create ) {
+         const key_type key{ id, compressed };
+         {
+            std::lock_guard<std::mutex> g( mtx );
+            auto itr = buffers.find( key );
+            if( itr != buffers.end() ) {
+               lru.splice( lru.begin(), lru, itr->second.second );
+               return itr->second.first;
+            }
+         }
+
+         buffer_ptr buffer = create();
+
+         std::lock_guard<std::mutex> g( mtx );
+         auto inserted = buffers.emplace( key, std::make_pair( buffer, lru.end() ) );
+         if( !inserted.second ) return inserted.first->second.first; // packed by another thread meanwhile
+         lru.push_front( key );
+         inserted.first->second.second = lru.begin();
+         cached_bytes += buffer->size();
+         while( cached_bytes > max_bytes && lru.size() > 1 ) {
+            auto oldest = buffers.find( lru.back() );
+            cached_bytes -= oldest->second.first->size();
+            buffers.erase( oldest );
+            lru.pop_back();
+         }
+         return buffer;
+      }
+
+   private:
+      using key_type = std::pair<block_id_type, bool>;
+
+      std::mutex                   mtx;
+      const size_t                 max_bytes;
+      size_t                       cached_bytes = 0;
+      std::list<key_type>          lru; // most recently used first
+      std::map<key_type, std::pair<buffer_ptr, std::list<key_type>::iterator>> buffers;
+   };
+
+   /**
+    * The snapshot-<block id>.bin files of producer_plugin's snapshots dir, served to peers bootstrapping from a
+    * snapshot. The sha256 of a file is computed on the hashing thread of the catalog once the file is listed, and kept
+    * while its size and write time do not change, peers check the file they download against it. A file is only
+    * listed once hashed, so no net thread ever reads a whole snapshot.
+    */
+   class snapshot_catalog {
+   public:
+      /// starts the hashing thread, snapshots of d are served from then on
+      void start( const bfs::path& d );
+      void stop();
+      bool enabled() const { return !dir.empty(); }
+
+      /// the hashed snapshots of blocks from min_block_num, newest first. Files not hashed yet are queued for hashing
+      vector<snapshot_entry> list( uint32_t min_block_num );
+      /// up to size bytes of the snapshot of block_id from offset, empty if it is not served or offset is past its end
+      vector<char> read( const block_id_type& block_id, uint64_t offset, uint32_t size ) const;
+
+      static bfs::path file_name( const block_id_type& block_id ) {
+         return bfs::path( "snapshot-" + block_id.str() + ".bin" );
+      }
+      static fc::sha256 hash_file( const bfs::path& p );
+
+   private:
+      struct hashed_file {
+         std::time_t    write_time = 0;
+         snapshot_entry entry;
+      };
+
+      void hash( const bfs::path& p, const block_id_type& id, uint64_t size, std::time_t write_time );
+
+      bfs::path                                 dir; ///< set before the net threads start
+      optional<eosio::chain::named_thread_pool> hasher; ///< one thread, reads whole snapshots
+      std::mutex                                mtx;
+      std::map<bfs::path, hashed_file>          hashed;
+      std::set<bfs::path>                       queued; ///< posted to the hasher and not hashed yet
+   };
+
    struct update_block_num {
       uint32_t new_bnum;
       update_block_num(uint32_t bnum) : new_bnum(bnum) {}
@@ -137,40 +360,65 @@ namespace eosio {
          in_sync
       };
 
+      /// range requested from one peer while syncing from several peers, start advances as blocks arrive
+      struct sync_chunk {
+         uint32_t       start = 0;
+         uint32_t       end = 0;
+         connection_ptr source; // empty until a peer is found for the chunk
+      };
+
       mutable std::mutex sync_mtx;
       uint32_t       sync_known_lib_num{0};
       uint32_t       sync_last_requested_num{0};
       uint32_t       sync_next_expected_num{0};
       uint32_t       sync_req_span{0};
+      uint32_t       sync_peer_count{1};
       connection_ptr sync_source;
       std::atomic<stages> sync_state{in_sync};
 
+      // only used when syncing from several peers
+      std::deque<sync_chunk> sync_chunks;      // outstanding chunks in block order
+      uint32_t               sync_next_post_num{0}; // next block to hand to the controller
+      /// blocks that arrived ahead of sync_next_post_num, bounded by sync_peer_count chunks, a null block
+      /// marks one already known which is not posted again
+      std::map<uint32_t, std::tuple<connection_ptr, block_id_type, signed_block_ptr>> sync_ahead;
+
    private:
       constexpr static auto stage_str( stages s );
       void set_state( stages s );
       bool is_sync_required( uint32_t fork_head_block_num );
       void request_next_chunk( std::unique_lock<std::mutex> g_sync, const connection_ptr& conn = connection_ptr() );
+      bool multi_peer()const { return sync_peer_count > 1; }
+      void request_chunks( std::unique_lock<std::mutex> g_sync );
+      bool sync_chunk_received( const connection_ptr& c, uint32_t blk_num );
+      void release_chunks( const connection_ptr& c );
+      void reset_chunks();
       void start_sync( const connection_ptr& c, uint32_t target );
       bool verify_catchup( const connection_ptr& c, uint32_t num, const block_id_type& id );
 
    public:
-      explicit sync_manager( uint32_t span );
+      sync_manager( uint32_t span, uint32_t peer_count );
       static void send_handshakes();
       bool syncing_with_peer() const { return sync_state == lib_catchup; }
       void sync_reset_lib_num( const connection_ptr& conn );
       void sync_reassign_fetch( const connection_ptr& c, go_away_reason reason );
       void rejected_block( const connection_ptr& c, uint32_t blk_num );
       void sync_recv_block( const connection_ptr& c, const block_id_type& blk_id, uint32_t blk_num, bool blk_applied );
+      bool sync_reorder_block( const connection_ptr& c, const block_id_type& blk_id, signed_block_ptr& msg );
+      void post_ahead_blocks();
       void sync_update_expected( const connection_ptr& c, const block_id_type& blk_id, uint32_t blk_num, bool blk_applied );
       void recv_handshake( const connection_ptr& c, const handshake_message& msg );
       void sync_recv_notice( const connection_ptr& c, const notice_message& msg );
    };
 
    class dispatch_manager {
-      mutable std::mutex      blk_state_mtx;
-      peer_block_state_index  blk_state;
-      mutable std::mutex      local_txns_mtx;
-      node_transaction_index  local_txns;
+      sharded_index<peer_block_state_index>  blk_state;
+      sharded_index<node_transaction_index>  local_txns;
+      sharded_index<announced_trx_index>     announced_trxs;
+      sharded_index<received_trx_index>      received_trxs;
+
+      mutable std::mutex                             trx_requests_mtx;
+      std::map<transaction_id_type, fc::time_point>  trx_requests; // announced ids asked for, one peer at a time
 
    public:
       boost::asio::io_context::strand  strand;
@@ -178,7 +426,7 @@ namespace eosio {
       explicit dispatch_manager(boost::asio::io_context& io_context)
       : strand( io_context ) {}
 
-      void bcast_transaction(const packed_transaction& trx);
+      void bcast_transaction(const packed_transaction_ptr& trx);
       void rejected_transaction(const packed_transaction_ptr& trx, uint32_t head_blk_num);
       void bcast_block( const signed_block_ptr& b, const block_id_type& id );
       void bcast_notice( const block_id_type& id );
@@ -187,6 +435,14 @@ namespace eosio {
       void recv_block(const connection_ptr& conn, const block_id_type& msg, uint32_t bnum);
       void expire_blocks( uint32_t bnum );
       void recv_notice(const connection_ptr& conn, const notice_message& msg, bool generated);
+      void recv_trx_notice(const connection_ptr& conn, const vector<transaction_id_type>& ids);
+      std::shared_ptr<std::vector<char>> announced_trx( const transaction_id_type& id ) const;
+
+      void add_received_trx( const packed_transaction_ptr& trx );
+      /// the received transaction with the short id, empty if there is none or several
+      packed_transaction_ptr find_received_trx( uint64_t short_id ) const;
+      /// b as a compact block for the peer, the transactions it is not known to hold are sent in full
+      compact_block_message make_compact_block( const signed_block& b, uint32_t connection_id ) const;
 
       void retry_fetch(const connection_ptr& conn);
 
@@ -200,6 +456,8 @@ namespace eosio {
       bool peer_has_txn( const transaction_id_type& tid, uint32_t connection_id ) const;
       bool have_txn( const transaction_id_type& tid ) const;
       void expire_txns( uint32_t lib_num );
+
+      void fill_metrics( net_metrics& m ) const;
    };
 
    class net_plugin_impl : public std::enable_shared_from_this<net_plugin_impl> {
@@ -238,6 +496,15 @@ namespace eosio {
       uint32_t                              max_client_count = 0;
       uint32_t                              max_nodes_per_host = 1;
       bool                                  p2p_accept_transactions = true;
+      bool                                  p2p_compress_sync_blocks = false;
+      bool                                  p2p_announce_transactions = false;
+      bool                                  p2p_compact_blocks = false;
+      bool                                  p2p_early_block_relay = false;
+      bool                                  serve_snapshots = false;
+      size_t                                trx_lane = 0; ///< of eosio::chain::post_lanes
+      uint32_t                              write_size_target = 0; ///< bytes per socket write, 0 for no limit
+      block_buffer_cache                    block_buffers;
+      snapshot_catalog                      snapshots; ///< enabled by p2p-serve-snapshots
 
       /// Peer clock may be no more than 1 second skewed from our clock, including network latency.
       const std::chrono::system_clock::duration peer_authentication_interval{std::chrono::seconds{1}};
@@ -264,6 +531,9 @@ namespace eosio {
       std::mutex                            keepalive_timer_mtx;
       unique_ptr<boost::asio::steady_timer> keepalive_timer;
 
+      std::mutex                            trx_announce_timer_mtx;
+      unique_ptr<boost::asio::steady_timer> trx_announce_timer;
+
       std::atomic<bool>                     in_shutdown{false};
 
       compat::channels::transaction_ack::channel_type::handle  incoming_transaction_ack_subscription;
@@ -288,12 +558,14 @@ namespace eosio {
       void start_listen_loop();
 
       void on_accepted_block( const block_state_ptr& bs );
+      void on_accepted_block_header( const block_state_ptr& bs );
       void on_pre_accepted_block( const signed_block_ptr& bs );
       void transaction_ack(const std::pair<fc::exception_ptr, transaction_metadata_ptr>&);
       void on_irreversible_block( const block_state_ptr& blk );
 
       void start_conn_timer(boost::asio::steady_timer::duration du, std::weak_ptr<connection> from_connection);
       void start_expire_timer();
+      void start_trx_announce_timer();
       void start_monitors();
 
       void expire();
@@ -331,6 +603,7 @@ namespace eosio {
       chain::signature_type sign_compact(const chain::public_key_type& signer, const fc::sha256& digest) const;
 
       constexpr uint16_t to_protocol_version(uint16_t v);
+      constexpr uint16_t to_network_version(uint16_t v);
 
       connection_ptr find_connection(const string& host)const; // must call with held mutex
    };
@@ -379,19 +652,44 @@ namespace eosio {
    constexpr auto     def_send_buffer_size_mb = 4;
    constexpr auto     def_send_buffer_size = 1024*1024*def_send_buffer_size_mb;
    constexpr auto     def_max_write_queue_size = def_send_buffer_size*10;
+   constexpr auto     def_write_size_target_kb = 1024;
    constexpr auto     def_max_trx_in_progress_size = 100*1024*1024; // 100 MB
+   constexpr auto     def_trx_lane_capacity = 10000;
    constexpr auto     def_max_consecutive_rejected_blocks = 13; // num of rejected blocks before disconnect
    constexpr auto     def_max_consecutive_immediate_connection_close = 9; // back off if client keeps closing
    constexpr auto     def_max_clients = 25; // 0 for unlimited clients
    constexpr auto     def_max_nodes_per_host = 1;
    constexpr auto     def_conn_retry_wait = 30;
    constexpr auto     def_txn_expire_wait = std::chrono::seconds(3);
+   constexpr auto     def_trx_announce_interval = std::chrono::milliseconds(50);
+   constexpr auto     trx_announce_retention_sec = 3; // announced bodies only wait for the requests of the peers they went to
+   constexpr auto     trx_request_retry_ms = 1000; // ask another announcing peer if the body did not arrive
+   constexpr auto     received_trx_retention_sec = 30; // received bodies only wait for the block that includes them
+   constexpr size_t   max_trx_ids_per_message = 1024;
    constexpr auto     def_resp_expected_wait = std::chrono::seconds(5);
    constexpr auto     def_sync_fetch_span = 100;
+   constexpr auto     def_sync_peers = 1;
+   constexpr int64_t  sync_failure_penalty_us = 1000*1000; // least cost added per stalled chunk, also for peers never measured
 
    constexpr auto     message_header_size = 4;
    constexpr uint32_t signed_block_which = 7;        // see protocol net_message
    constexpr uint32_t packed_transaction_which = 8;  // see protocol net_message
+   constexpr uint32_t compressed_signed_block_which = 9; // see protocol net_message
+   constexpr uint32_t compact_block_message_which = 10; // see protocol net_message
+   constexpr uint32_t block_trxs_message_which = 12; // see protocol net_message
+   constexpr uint32_t snapshot_chunk_message_which = 16; // see protocol net_message
+   constexpr uint32_t net_message_types = snapshot_chunk_message_which + 1;
+   /// names of the net_message types, in which order
+   constexpr const char* net_message_names[net_message_types] = {
+      "handshake_message", "chain_size_message", "go_away_message", "time_message", "notice_message",
+      "request_message", "sync_request_message", "signed_block", "packed_transaction", "compressed_signed_block",
+      "compact_block_message", "get_block_trxs_message", "block_trxs_message", "get_snapshots_message",
+      "snapshots_message", "get_snapshot_chunk_message", "snapshot_chunk_message"
+   };
+   /// bound on an inflated compressed_signed_block, far above any block the chain accepts
+   constexpr size_t   max_uncompressed_block_size = 64*1024*1024;
+   constexpr uint32_t max_snapshot_chunk_size = 1024*1024;
+   constexpr auto     snapshot_fetch_timeout = std::chrono::seconds(30);
 
    /**
     *  For a while, network version was a 16 bit value equal to the second set of 16 bits
@@ -414,8 +712,23 @@ namespace eosio {
    constexpr uint16_t proto_base = 0;
    constexpr uint16_t proto_explicit_sync = 1;
    constexpr uint16_t block_id_notify = 2; // reserved. feature was removed. next net_version should be 3
+   // versions from 3 up to net_version_range belong to upstream, where they mean other messages
+
+   /**
+    *  The features of this fork are negotiated in a version range of their own. It is advertised at
+    *  net_version_base + net_version_fork_offset, far enough above net_version_range that an upstream
+    *  peer maps it to proto_base and never sends us its own messages, nor expects ours. Internally the
+    *  fork versions start at proto_fork_base so they compare above every upstream version, and every
+    *  fork version implies proto_explicit_sync.
+    */
+   constexpr uint16_t net_version_fork_offset = 0x1000;
+   constexpr uint16_t proto_fork_base = 0x100;
+   constexpr uint16_t proto_compressed_blocks = proto_fork_base + 1; // understands compressed_signed_block
+   constexpr uint16_t proto_trx_announce = proto_fork_base + 2;      // transaction ids in notice_message and request_message
+   constexpr uint16_t proto_compact_blocks = proto_fork_base + 3;    // understands compact_block_message and the messages filling it
+   constexpr uint16_t proto_snapshot_transfer = proto_fork_base + 4; // understands get_snapshots_message and get_snapshot_chunk_message
 
-   constexpr uint16_t net_version = proto_explicit_sync;
+   constexpr uint16_t net_version = proto_snapshot_transfer;
 
    /**
     * Index by start_block_num
@@ -481,14 +794,16 @@ namespace eosio {
          return true;
       }
 
-      void fill_out_buffer( std::vector<boost::asio::const_buffer>& bufs ) {
+      // @param write_size_target stop adding messages once this many bytes are queued for the write, 0 for no limit
+      void fill_out_buffer( std::vector<boost::asio::const_buffer>& bufs, size_t write_size_target ) {
          std::lock_guard<std::mutex> g( _mtx );
          if( _sync_write_queue.size() > 0 ) { // always send msgs from sync_write_queue first
-            fill_out_buffer( bufs, _sync_write_queue );
+            fill_out_buffer( bufs, _sync_write_queue, write_size_target );
          } else { // postpone real_time write_queue if sync queue is not empty
-            fill_out_buffer( bufs, _write_queue );
-            EOS_ASSERT( _write_queue_size == 0, plugin_exception, "write queue size expected to be zero" );
+            fill_out_buffer( bufs, _write_queue, write_size_target );
          }
+         EOS_ASSERT( _write_queue_size == 0 || !_write_queue.empty() || !_sync_write_queue.empty(), plugin_exception,
+                     "write queue size expected to be zero" );
       }
 
       void out_callback( boost::system::error_code ec, std::size_t w ) {
@@ -500,15 +815,46 @@ namespace eosio {
 
    private:
       struct queued_write;
+      // runs of small messages (transactions, notices) are copied into one slab, so they take one
+      // entry of the gather list instead of one each
       void fill_out_buffer( std::vector<boost::asio::const_buffer>& bufs,
-                            deque<queued_write>& w_queue ) {
-         while ( w_queue.size() > 0 ) {
+                            deque<queued_write>& w_queue, size_t write_size_target ) {
+         // the slab of the previous write is reused unless that write still references it
+         if( !_slab || _slab.use_count() > 1 ) {
+            _slab = std::make_shared<vector<char>>();
+         }
+         _slab->clear();
+         _slab_runs.clear();
+         bool in_run = false;
+         size_t out_size = 0;
+         while ( w_queue.size() > 0 && (write_size_target == 0 || out_size < write_size_target) ) {
             auto& m = w_queue.front();
-            bufs.push_back( boost::asio::buffer( *m.buff ));
-            _write_queue_size -= m.buff->size();
+            const size_t size = m.buff->size();
+            if( size <= max_coalesced_message_size ) {
+               if( !in_run ) {
+                  _slab_runs.emplace_back( bufs.size(), _slab->size() );
+                  bufs.emplace_back(); // set once the slab stops growing
+                  in_run = true;
+               }
+               _slab->insert( _slab->end(), m.buff->begin(), m.buff->end() );
+            } else {
+               bufs.push_back( boost::asio::buffer( *m.buff ));
+               in_run = false;
+            }
+            out_size += size;
+            _write_queue_size -= size;
             _out_queue.emplace_back( m );
             w_queue.pop_front();
          }
+         for( size_t i = 0; i < _slab_runs.size(); ++i ) {
+            const size_t begin = _slab_runs[i].second;
+            const size_t end = i + 1 < _slab_runs.size() ? _slab_runs[i + 1].second : _slab->size();
+            bufs[_slab_runs[i].first] = boost::asio::buffer( _slab->data() + begin, end - begin );
+         }
+         if( !_slab_runs.empty() ) {
+            // keeps the slab alive until the write completes
+            _out_queue.push_back( {_slab, []( boost::system::error_code, std::size_t ) {}} );
+         }
       }
 
    private:
@@ -523,6 +869,10 @@ namespace eosio {
       deque<queued_write> _sync_write_queue; // sync_write_queue will be sent first
       deque<queued_write> _out_queue;
 
+      static constexpr size_t max_coalesced_message_size = 4*1024;
+      std::shared_ptr<vector<char>>          _slab;
+      std::vector<std::pair<size_t, size_t>> _slab_runs; // index in the gather list, offset in _slab
+
    }; // queued_buffer
 
 
@@ -548,6 +898,16 @@ namespace eosio {
       void update_endpoints();
 
       optional<peer_sync_state>    peer_requested;  // this peer is requesting info from us
+      std::vector<transaction_id_type> trx_announce_queue; // ids not yet announced to this peer, only accessed through strand
+
+      /// compact block from this peer waiting for the transactions asked for by get_block_trxs_message
+      struct pending_compact_block {
+         block_id_type                 id;
+         std::shared_ptr<signed_block> block;
+         vector<uint32_t>              missing;   // positions of the transactions asked for
+         vector<uint64_t>              short_ids; // of the missing transactions
+      };
+      optional<pending_compact_block> pending_compact; // only accessed through strand
 
       std::atomic<bool>                         socket_open{false};
 
@@ -576,6 +936,22 @@ namespace eosio {
       std::atomic<bool>       syncing{false};
       uint16_t                protocol_version = 0;
       uint16_t                consecutive_rejected_blocks = 0;
+
+      // sync peer score, see sync_cost
+      std::atomic<int64_t>    rtt_us{0};               // round trip of the last time_message exchange, 0 if unknown
+      std::atomic<int64_t>    sync_us_per_block{0};    // moving average over completed sync chunks, 0 if unknown
+      std::atomic<int64_t>    sync_request_time_us{0}; // when the chunk in flight was requested, 0 if none
+      std::atomic<uint32_t>   sync_request_blocks{0};
+      std::atomic<uint16_t>   sync_failures{0};        // stalled chunks, decays with each completed one
+
+      // see net_plugin::metrics
+      std::atomic<uint64_t>   bytes_received{0};
+      std::atomic<uint64_t>   bytes_sent{0};
+      std::array<std::atomic<uint64_t>, net_message_types> messages_received{};
+      std::atomic<uint64_t>   dropped_duplicate_blocks{0};
+      std::atomic<uint64_t>   dropped_duplicate_trxs{0};
+      std::atomic<uint64_t>   compact_blocks_rebuilt{0};
+      std::atomic<uint64_t>   compact_block_fallbacks{0};
       std::atomic<uint16_t>   consecutive_immediate_connection_close = 0;
 
       std::mutex                            response_expected_timer_mtx;
@@ -597,6 +973,7 @@ namespace eosio {
       string                      local_endpoint_port;
 
       connection_status get_status()const;
+      connection_metrics get_metrics()const;
 
       /** \name Peer Timestamps
        *  Time message handling
@@ -621,6 +998,14 @@ namespace eosio {
 
       bool populate_handshake( handshake_message& hello, bool force );
 
+      /// thread safe, the chunk last requested from this peer arrived completely
+      void sync_chunk_completed();
+      /// thread safe, the chunk last requested from this peer stalled
+      void sync_chunk_failed();
+      /// thread safe, expected microseconds to receive a chunk of span blocks, peers never measured cost 0 so they are tried,
+      /// each stalled chunk adds at least sync_failure_penalty_us
+      int64_t sync_cost( uint32_t span ) const;
+
       bool resolve_and_connect();
       void connect( const std::shared_ptr<tcp::resolver>& resolver, tcp::resolver::results_type endpoints );
       void start_read_message();
@@ -667,6 +1052,11 @@ namespace eosio {
 
       void enqueue( const net_message &msg );
       void enqueue_block( const signed_block_ptr& sb, bool to_sync_queue = false);
+      void announce_trx( const transaction_id_type& id );
+      /// send the ids queued by announce_trx in one notice_message per max_trx_ids_per_message
+      void flush_trx_announces();
+      /// sync block read packed from the block log, framed without unpacking it
+      void enqueue_serialized_block( const std::shared_ptr<std::vector<char>>& packed_block );
       void enqueue_buffer( const std::shared_ptr<std::vector<char>>& send_buffer,
                            go_away_reason close_after_send,
                            bool to_sync_queue = false);
@@ -713,8 +1103,18 @@ namespace eosio {
       void handle_message( const block_id_type& id, signed_block_ptr msg );
       void handle_message( const packed_transaction& msg ) = delete; // packed_transaction_ptr overload used instead
       void handle_message( packed_transaction_ptr msg );
+      void handle_message( const compact_block_message& msg );
+      void handle_message( const get_block_trxs_message& msg );
+      void handle_message( const block_trxs_message& msg );
+      void handle_message( const get_snapshots_message& msg );
+      void handle_message( const get_snapshot_chunk_message& msg );
+
+      /// hands a rebuilt compact block on like a received signed_block, or fetches it in full if it doesn't match its header
+      void finish_compact_block( const block_id_type& id, std::shared_ptr<signed_block> block );
 
       void process_signed_block( const block_id_type& id, signed_block_ptr msg );
+      bool process_next_block_message( uint32_t which, uint32_t message_length );
+      void post_signed_block( const block_id_type& id, signed_block_ptr msg, int priority );
 
       fc::variant_object get_logger_variant()  {
          fc::mutable_variant_object mvo;
@@ -783,6 +1183,45 @@ namespace eosio {
          fc_dlog( logger, "handle sync_request_message" );
          c->handle_message( msg );
       }
+
+      void operator()( const compact_block_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle compact_block_message" );
+         c->handle_message( msg );
+      }
+
+      void operator()( const get_block_trxs_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle get_block_trxs_message" );
+         c->handle_message( msg );
+      }
+
+      void operator()( const block_trxs_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle block_trxs_message" );
+         c->handle_message( msg );
+      }
+
+      void operator()( const get_snapshots_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle get_snapshots_message" );
+         c->handle_message( msg );
+      }
+
+      void operator()( const get_snapshot_chunk_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle get_snapshot_chunk_message" );
+         c->handle_message( msg );
+      }
+
+      void operator()( const snapshots_message& ) const {
+         // only asked for by snapshot_fetcher, before the chain starts
+         fc_dlog( logger, "ignoring snapshots_message" );
+      }
+
+      void operator()( const snapshot_chunk_message& ) const {
+         fc_dlog( logger, "ignoring snapshot_chunk_message" );
+      }
    };
 
    template<typename Function>
@@ -875,6 +1314,25 @@ namespace eosio {
       return stat;
    }
 
+   connection_metrics connection::get_metrics()const {
+      connection_metrics m;
+      m.peer = peer_addr;
+      m.bytes_received = bytes_received;
+      m.bytes_sent = bytes_sent;
+      for( uint32_t i = 0; i < net_message_types; ++i ) {
+         if( messages_received[i] > 0 ) m.messages_received[net_message_names[i]] = messages_received[i];
+      }
+      m.write_queue_bytes = buffer_queue.write_queue_size();
+      m.dropped_duplicate_blocks = dropped_duplicate_blocks;
+      m.dropped_duplicate_trxs = dropped_duplicate_trxs;
+      m.rtt_us = rtt_us;
+      m.sync_us_per_block = sync_us_per_block;
+      m.sync_failures = sync_failures;
+      m.compact_blocks_rebuilt = compact_blocks_rebuilt;
+      m.compact_block_fallbacks = compact_block_fallbacks;
+      return m;
+   }
+
    bool connection::start_session() {
       verify_strand_in_this_thread( strand, __func__, __LINE__ );
 
@@ -1108,7 +1566,7 @@ namespace eosio {
       connection_ptr c(shared_from_this());
 
       std::vector<boost::asio::const_buffer> bufs;
-      buffer_queue.fill_out_buffer( bufs );
+      buffer_queue.fill_out_buffer( bufs, my_impl->write_size_target );
 
       strand.post( [c{std::move(c)}, bufs{std::move(bufs)}]() {
          boost::asio::async_write( *c->socket, bufs,
@@ -1133,6 +1591,7 @@ namespace eosio {
                   return;
                }
 
+               c->bytes_sent += w;
                c->buffer_queue.out_callback( ec, w );
 
                c->enqueue_sync_block();
@@ -1182,11 +1641,20 @@ namespace eosio {
          connection_ptr c = weak.lock();
          if( !c ) return;
          controller& cc = my_impl->chain_plug->chain();
+         std::shared_ptr<std::vector<char>> packed_block;
          signed_block_ptr sb;
          try {
-            sb = cc.fetch_block_by_number( num );
+            // irreversible blocks are sent as stored in the block log, reversible ones from the fork database
+            packed_block = std::make_shared<std::vector<char>>( cc.fetch_serialized_block_by_number( num ) );
+            if( packed_block->empty() ) {
+               sb = cc.fetch_block_by_number( num );
+            }
          } FC_LOG_AND_DROP();
-         if( sb ) {
+         if( packed_block && !packed_block->empty() ) {
+            c->strand.post( [c, packed_block{std::move(packed_block)}]() {
+               c->enqueue_serialized_block( packed_block );
+            });
+         } else if( sb ) {
             c->strand.post( [c, sb{std::move(sb)}]() {
                c->enqueue_block( sb, true );
             });
@@ -1201,6 +1669,22 @@ namespace eosio {
       return true;
    }
 
+   /// header, then whatever pack writes, packed in a single pass into the reusable buffer of the thread
+   template<typename Pack>
+   static std::shared_ptr<std::vector<char>> pack_send_buffer( Pack&& pack ) {
+      thread_local pack_buffer buffer;
+      buffer.clear();
+      uint32_t payload_size = 0; // avoid variable size encoding of uint32_t
+      constexpr size_t header_size = sizeof( payload_size );
+      static_assert( header_size == message_header_size, "invalid message_header_size" );
+      buffer.write( reinterpret_cast<const char*>(&payload_size), header_size );
+      pack( buffer );
+      payload_size = buffer.size() - header_size;
+      memcpy( buffer.data(), &payload_size, header_size );
+
+      return std::make_shared<vector<char>>( buffer.data(), buffer.data() + buffer.size() );
+   }
+
    void connection::enqueue( const net_message& m ) {
       verify_strand_in_this_thread( strand, __func__, __LINE__ );
       go_away_reason close_after_send = no_reason;
@@ -1208,26 +1692,24 @@ namespace eosio {
          close_after_send = m.get<go_away_message>().reason;
       }
 
-      const uint32_t payload_size = fc::raw::pack_size( m );
-
-      const char* const header = reinterpret_cast<const char* const>(&payload_size); // avoid variable size encoding of uint32_t
-      constexpr size_t header_size = sizeof(payload_size);
-      static_assert( header_size == message_header_size, "invalid message_header_size" );
-      const size_t buffer_size = header_size + payload_size;
-
-      auto send_buffer = std::make_shared<vector<char>>(buffer_size);
-      fc::datastream<char*> ds( send_buffer->data(), buffer_size);
-      ds.write( header, header_size );
-      fc::raw::pack( ds, m );
-
+      auto send_buffer = pack_send_buffer( [&m]( pack_buffer& buffer ) { fc::raw::pack( buffer, m ); } );
       enqueue_buffer( send_buffer, close_after_send );
    }
 
    template< typename T>
    static std::shared_ptr<std::vector<char>> create_send_buffer( uint32_t which, const T& v ) {
       // match net_message static_variant pack
-      const uint32_t which_size = fc::raw::pack_size( unsigned_int( which ) );
-      const uint32_t payload_size = which_size + fc::raw::pack_size( v );
+      return pack_send_buffer( [which, &v]( pack_buffer& buffer ) {
+         fc::raw::pack( buffer, unsigned_int( which ) );
+         fc::raw::pack( buffer, v );
+      } );
+   }
+
+   static std::shared_ptr<std::vector<char>> create_serialized_send_buffer( uint32_t block_num, const std::vector<char>& packed_block ) {
+      // same bytes as create_send_buffer( signed_block_which, sb ), the block is already packed
+      fc_dlog( logger, "sending serialized block ${bn}", ("bn", block_num) );
+      const uint32_t which_size = fc::raw::pack_size( unsigned_int( signed_block_which ) );
+      const uint32_t payload_size = which_size + packed_block.size();
 
       const char* const header = reinterpret_cast<const char* const>(&payload_size); // avoid variable size encoding of uint32_t
       constexpr size_t header_size = sizeof( payload_size );
@@ -1237,17 +1719,52 @@ namespace eosio {
       auto send_buffer = std::make_shared<vector<char>>( buffer_size );
       fc::datastream<char*> ds( send_buffer->data(), buffer_size );
       ds.write( header, header_size );
-      fc::raw::pack( ds, unsigned_int( which ) );
-      fc::raw::pack( ds, v );
+      fc::raw::pack( ds, unsigned_int( signed_block_which ) );
+      ds.write( packed_block.data(), packed_block.size() );
 
       return send_buffer;
    }
 
+   static std::shared_ptr<std::vector<char>> create_compressed_send_buffer( uint32_t block_num, const std::vector<char>& packed_block ) {
+      namespace bio = boost::iostreams;
+      compressed_signed_block cb;
+      {
+         bio::filtering_ostream comp;
+         comp.push( bio::zlib_compressor( bio::zlib::default_compression ) );
+         comp.push( bio::back_inserter( cb.data ) );
+         comp.write( packed_block.data(), packed_block.size() );
+         bio::close( comp );
+      }
+      fc_dlog( logger, "sending compressed serialized block ${bn}, ${c} of ${s} bytes",
+               ("bn", block_num)("c", cb.data.size())("s", packed_block.size()) );
+      return create_send_buffer( compressed_signed_block_which, cb );
+   }
+
    static std::shared_ptr<std::vector<char>> create_send_buffer( const signed_block_ptr& sb ) {
       // this implementation is to avoid copy of signed_block to net_message
-      // matches which of net_message for signed_block
+      // the block is packed once for all peers, the block log and state history
       fc_dlog( logger, "sending block ${bn}", ("bn", sb->block_num()) );
-      return create_send_buffer( signed_block_which, *sb );
+      return create_serialized_send_buffer( sb->block_num(), *sb->packed() );
+   }
+
+   static std::shared_ptr<std::vector<char>> create_compressed_send_buffer( const signed_block_ptr& sb ) {
+      return create_compressed_send_buffer( sb->block_num(), *sb->packed() );
+   }
+
+   static std::vector<char> decompress_block( const compressed_signed_block& cb ) {
+      namespace bio = boost::iostreams;
+      std::vector<char> out;
+      bio::filtering_istream decomp;
+      decomp.push( bio::zlib_decompressor() );
+      decomp.push( bio::array_source( cb.data.data(), cb.data.size() ) );
+      char buf[64*1024];
+      while( decomp ) {
+         decomp.read( buf, sizeof(buf) );
+         out.insert( out.end(), buf, buf + decomp.gcount() );
+         EOS_ASSERT( out.size() <= max_uncompressed_block_size, plugin_exception,
+                     "compressed block inflates beyond ${m} bytes", ("m", max_uncompressed_block_size) );
+      }
+      return out;
    }
 
    static std::shared_ptr<std::vector<char>> create_send_buffer( const packed_transaction& trx ) {
@@ -1259,7 +1776,52 @@ namespace eosio {
    void connection::enqueue_block( const signed_block_ptr& sb, bool to_sync_queue) {
       fc_dlog( logger, "enqueue block ${num}", ("num", sb->block_num()) );
       verify_strand_in_this_thread( strand, __func__, __LINE__ );
-      enqueue_buffer( create_send_buffer( sb ), no_reason, to_sync_queue);
+      // only sync blocks, they are sent in bulk and bandwidth bound, live blocks are latency bound
+      const bool compress = to_sync_queue && my_impl->p2p_compress_sync_blocks && protocol_version >= proto_compressed_blocks;
+      // peers syncing at the same time mostly ask for the same blocks
+      auto send_buffer = my_impl->block_buffers.get( sb->calculate_id(), compress, [&sb, compress]() {
+         return compress ? create_compressed_send_buffer( sb ) : create_send_buffer( sb );
+      } );
+      enqueue_buffer( send_buffer, no_reason, to_sync_queue );
+   }
+
+   void connection::enqueue_serialized_block( const std::shared_ptr<std::vector<char>>& packed_block ) {
+      verify_strand_in_this_thread( strand, __func__, __LINE__ );
+      // only the header is unpacked, for the id the buffer is cached by
+      signed_block_header header;
+      fc::datastream<const char*> ds( packed_block->data(), packed_block->size() );
+      fc::raw::unpack( ds, header );
+      const block_id_type id = header.calculate_id();
+      const uint32_t block_num = header.block_num();
+      fc_dlog( logger, "enqueue serialized block ${num}", ("num", block_num) );
+
+      const bool compress = my_impl->p2p_compress_sync_blocks && protocol_version >= proto_compressed_blocks;
+      auto send_buffer = my_impl->block_buffers.get( id, compress, [&packed_block, block_num, compress]() {
+         return compress ? create_compressed_send_buffer( block_num, *packed_block )
+                         : create_serialized_send_buffer( block_num, *packed_block );
+      } );
+      enqueue_buffer( send_buffer, no_reason, true );
+   }
+
+   void connection::announce_trx( const transaction_id_type& id ) {
+      verify_strand_in_this_thread( strand, __func__, __LINE__ );
+      trx_announce_queue.push_back( id );
+   }
+
+   void connection::flush_trx_announces() {
+      verify_strand_in_this_thread( strand, __func__, __LINE__ );
+      auto begin = trx_announce_queue.begin();
+      while( begin != trx_announce_queue.end() ) {
+         auto end = begin + std::min<size_t>( trx_announce_queue.end() - begin, max_trx_ids_per_message );
+         notice_message note;
+         note.known_trx.mode = normal;
+         note.known_trx.pending = end - begin;
+         note.known_trx.ids.assign( begin, end );
+         fc_dlog( logger, "announce ${n} trxs to ${p}", ("n", note.known_trx.pending)("p", peer_name()) );
+         enqueue( note );
+         begin = end;
+      }
+      trx_announce_queue.clear();
    }
 
    void connection::enqueue_buffer( const std::shared_ptr<std::vector<char>>& send_buffer,
@@ -1346,18 +1908,41 @@ namespace eosio {
    }
 
    void connection::request_sync_blocks(uint32_t start, uint32_t end) {
+      sync_request_time_us = fc::time_point::now().time_since_epoch().count();
+      sync_request_blocks = end - start + 1;
       sync_request_message srm = {start,end};
       enqueue( net_message(srm) );
       sync_wait();
    }
 
+   void connection::sync_chunk_completed() {
+      const int64_t start = sync_request_time_us.exchange( 0 );
+      const uint32_t blocks = sync_request_blocks;
+      if( start == 0 || blocks == 0 ) return;
+      const int64_t per_block = std::max<int64_t>( 1, (fc::time_point::now().time_since_epoch().count() - start) / blocks );
+      const int64_t avg = sync_us_per_block;
+      sync_us_per_block = avg == 0 ? per_block : (avg * 3 + per_block) / 4;
+      if( sync_failures > 0 ) --sync_failures;
+   }
+
+   void connection::sync_chunk_failed() {
+      sync_request_time_us = 0;
+      ++sync_failures;
+   }
+
+   int64_t connection::sync_cost( uint32_t span ) const {
+      const int64_t expected = rtt_us + sync_us_per_block * span;
+      return expected + std::max( expected, sync_failure_penalty_us ) * sync_failures;
+   }
+
    //-----------------------------------------------------------
 
-    sync_manager::sync_manager( uint32_t req_span )
+    sync_manager::sync_manager( uint32_t req_span, uint32_t peer_count )
       :sync_known_lib_num( 0 )
       ,sync_last_requested_num( 0 )
       ,sync_next_expected_num( 1 )
       ,sync_req_span( req_span )
+      ,sync_peer_count( std::max<uint32_t>( peer_count, 1 ) )
       ,sync_source()
       ,sync_state(in_sync)
    {
@@ -1391,6 +1976,9 @@ namespace eosio {
          if( c->last_handshake_recv.last_irreversible_block_num > sync_known_lib_num ) {
             sync_known_lib_num = c->last_handshake_recv.last_irreversible_block_num;
          }
+      } else if( multi_peer() ) {
+         release_chunks( c );
+         if( sync_state == lib_catchup ) request_chunks( std::move(g) );
       } else if( c == sync_source ) {
          sync_last_requested_num = 0;
          request_next_chunk( std::move(g) );
@@ -1399,6 +1987,11 @@ namespace eosio {
 
    // call with g_sync locked
    void sync_manager::request_next_chunk( std::unique_lock<std::mutex> g_sync, const connection_ptr& conn ) {
+      if( multi_peer() ) {
+         request_chunks( std::move( g_sync ) );
+         return;
+      }
+
       uint32_t fork_head_block_num = 0;
       uint32_t lib_block_num = 0;
       std::tie( lib_block_num, std::ignore, fork_head_block_num,
@@ -1416,54 +2009,27 @@ namespace eosio {
       /* ----------
        * next chunk provider selection criteria
        * a provider is supplied and able to be used, use it.
-       * otherwise select the next available from the list, round-robin style.
+       * otherwise the peer expected to deliver the chunk fastest, see connection::sync_cost.
        */
 
       if (conn && conn->current() ) {
          sync_source = conn;
       } else {
-         std::shared_lock<std::shared_mutex> g( my_impl->connections_mtx );
-         if( my_impl->connections.size() == 0 ) {
-            sync_source.reset();
-         } else if( my_impl->connections.size() == 1 ) {
-            if (!sync_source) {
-               sync_source = *my_impl->connections.begin();
-            }
-         } else {
-            // init to a linear array search
-            auto cptr = my_impl->connections.begin();
-            auto cend = my_impl->connections.end();
-            // do we remember the previous source?
-            if (sync_source) {
-               //try to find it in the list
-               cptr = my_impl->connections.find( sync_source );
-               cend = cptr;
-               if( cptr == my_impl->connections.end() ) {
-                  //not there - must have been closed! cend is now connections.end, so just flatten the ring.
-                  sync_source.reset();
-                  cptr = my_impl->connections.begin();
-               } else {
-                  //was found - advance the start to the next. cend is the old source.
-                  if( ++cptr == my_impl->connections.end() && cend != my_impl->connections.end() ) {
-                     cptr = my_impl->connections.begin();
-                  }
+         connection_ptr best;
+         int64_t best_cost = 0;
+         for_each_block_connection( [&best, &best_cost, span = sync_req_span]( const connection_ptr& c ) {
+            if( c->current() ) {
+               const int64_t cost = c->sync_cost( span );
+               if( !best || cost < best_cost ) {
+                  best = c;
+                  best_cost = cost;
                }
             }
-
-            //scan the list of peers looking for another able to provide sync blocks.
-            if( cptr != my_impl->connections.end() ) {
-               auto cstart_it = cptr;
-               do {
-                  //select the first one which is current and break out.
-                  if( !(*cptr)->is_transactions_only_connection() && (*cptr)->current() ) {
-                     sync_source = *cptr;
-                     break;
-                  }
-                  if( ++cptr == my_impl->connections.end() )
-                     cptr = my_impl->connections.begin();
-               } while( cptr != cstart_it );
-            }
-            // no need to check the result, either source advanced or the whole list was checked and the old source is reused.
+            return true;
+         } );
+         // no need to check the result, if none is available the old source is reused and verified below
+         if( best ) {
+            sync_source = std::move( best );
          }
       }
 
@@ -1500,6 +2066,160 @@ namespace eosio {
       }
    }
 
+   // call with g_sync locked, hands chunks to peers not serving one, at most sync_peer_count chunks ahead of the controller
+   void sync_manager::request_chunks( std::unique_lock<std::mutex> g_sync ) {
+      uint32_t lib_block_num = 0;
+      std::tie( lib_block_num, std::ignore, std::ignore,
+                std::ignore, std::ignore, std::ignore ) = my_impl->get_chain_info();
+
+      if( sync_chunks.empty() && sync_ahead.empty() && sync_last_requested_num <= lib_block_num ) {
+         // nothing in flight, start right after our lib
+         sync_next_post_num = lib_block_num + 1;
+         sync_last_requested_num = lib_block_num;
+      }
+
+      const uint32_t window = sync_peer_count * sync_req_span;
+      auto can_add_chunk = [&]() {
+         return sync_chunks.size() < sync_peer_count && sync_last_requested_num < sync_known_lib_num &&
+                sync_last_requested_num < sync_next_post_num + window;
+      };
+      bool unassigned = std::any_of( sync_chunks.begin(), sync_chunks.end(), []( const auto& ch ) { return !ch.source; } );
+      if( !unassigned && !can_add_chunk() ) return;
+
+      // peers able to serve a chunk, their lib and cost, a peer serves the blocks up to its lib
+      std::vector<std::tuple<connection_ptr, uint32_t, int64_t>> idle;
+      for_each_block_connection( [&]( const connection_ptr& c ) {
+         if( !c->current() ) return true;
+         for( const auto& ch : sync_chunks ) {
+            if( ch.source == c ) return true;
+         }
+         std::lock_guard<std::mutex> g_conn( c->conn_mtx );
+         idle.emplace_back( c, c->last_handshake_recv.last_irreversible_block_num, c->sync_cost( sync_req_span ) );
+         return true;
+      } );
+      // fastest peers first, so the chunks go to the best sync_peer_count of them
+      std::stable_sort( idle.begin(), idle.end(), []( const auto& a, const auto& b ) { return std::get<2>( a ) < std::get<2>( b ); } );
+
+      auto take_peer = [&idle]( uint32_t end ) {
+         connection_ptr c;
+         auto itr = std::find_if( idle.begin(), idle.end(), [end]( const auto& p ) { return std::get<1>( p ) >= end; } );
+         if( itr != idle.end() ) {
+            c = std::get<0>( *itr );
+            idle.erase( itr );
+         }
+         return c;
+      };
+
+      std::vector<std::tuple<connection_ptr, uint32_t, uint32_t>> requests;
+      for( auto& ch : sync_chunks ) {
+         if( !ch.source && (ch.source = take_peer( ch.end )) ) {
+            requests.emplace_back( ch.source, ch.start, ch.end );
+         }
+      }
+      // the lib check picks the fastest peer that has the whole chunk
+      while( can_add_chunk() && !idle.empty() ) {
+         sync_chunk ch;
+         ch.start = sync_last_requested_num + 1;
+         ch.end = std::min( ch.start + sync_req_span - 1, sync_known_lib_num );
+         ch.source = take_peer( ch.end );
+         if( !ch.source ) break;
+         sync_last_requested_num = ch.end;
+         requests.emplace_back( ch.source, ch.start, ch.end );
+         sync_chunks.push_back( std::move( ch ) );
+      }
+
+      if( sync_chunks.empty() ) {
+         fc_elog( logger, "Unable to continue syncing at this time");
+         sync_known_lib_num = lib_block_num;
+         sync_last_requested_num = 0;
+         reset_chunks();
+         set_state( in_sync ); // probably not, but we can't do anything else
+         return;
+      }
+      g_sync.unlock();
+
+      for( auto& r : requests ) {
+         connection_ptr c = std::get<0>( r );
+         c->strand.post( [c, start = std::get<1>( r ), end = std::get<2>( r )]() {
+            fc_ilog( logger, "requesting range ${s} to ${e}, from ${n}", ("n", c->peer_name())( "s", start )( "e", end ) );
+            c->request_sync_blocks( start, end );
+         } );
+      }
+   }
+
+   // call with g_sync locked, returns true if blk_num completed the chunk of c
+   bool sync_manager::sync_chunk_received( const connection_ptr& c, uint32_t blk_num ) {
+      for( auto itr = sync_chunks.begin(); itr != sync_chunks.end(); ++itr ) {
+         if( itr->source != c || blk_num < itr->start || blk_num > itr->end ) continue;
+         itr->start = blk_num + 1;
+         if( itr->start <= itr->end ) {
+            c->sync_wait();
+            return false;
+         }
+         sync_chunks.erase( itr );
+         c->cancel_wait();
+         c->sync_chunk_completed();
+         return true;
+      }
+      return false;
+   }
+
+   // call with g_sync locked, the rest of the chunks of c go to the next peer available
+   void sync_manager::release_chunks( const connection_ptr& c ) {
+      for( auto& ch : sync_chunks ) {
+         if( ch.source == c ) {
+            ch.source.reset();
+            // blocks already received ahead of the controller need not be requested again
+            while( ch.start <= ch.end && sync_ahead.count( ch.start ) ) ++ch.start;
+         }
+      }
+      sync_chunks.erase( std::remove_if( sync_chunks.begin(), sync_chunks.end(),
+                                         []( const auto& ch ) { return ch.start > ch.end; } ),
+                         sync_chunks.end() );
+   }
+
+   // call with g_sync locked
+   void sync_manager::reset_chunks() {
+      sync_chunks.clear();
+      sync_ahead.clear();
+      sync_next_post_num = 0;
+   }
+
+   // called from connection strand, takes msg if it belongs to a chunk, posting it once all blocks before it are posted
+   bool sync_manager::sync_reorder_block( const connection_ptr& c, const block_id_type& blk_id, signed_block_ptr& msg ) {
+      std::unique_lock<std::mutex> g_sync( sync_mtx );
+      const uint32_t blk_num = msg->block_num();
+      if( !multi_peer() || sync_state != lib_catchup ||
+          blk_num < sync_next_post_num || blk_num > sync_last_requested_num ) {
+         return false;
+      }
+
+      const bool chunk_done = sync_chunk_received( c, blk_num );
+      if( blk_num > sync_next_post_num ) {
+         sync_ahead.emplace( blk_num, std::make_tuple( c, blk_id, std::move( msg ) ) );
+      } else {
+         c->post_signed_block( blk_id, std::move( msg ), priority::medium );
+         ++sync_next_post_num;
+         post_ahead_blocks();
+      }
+
+      if( chunk_done || sync_chunks.size() < sync_peer_count ) {
+         request_chunks( std::move( g_sync ) );
+      }
+      return true;
+   }
+
+   // call with g_sync locked, posts the blocks received ahead which now follow sync_next_post_num
+   void sync_manager::post_ahead_blocks() {
+      for( auto itr = sync_ahead.begin(); itr != sync_ahead.end() && itr->first <= sync_next_post_num; itr = sync_ahead.erase( itr ) ) {
+         if( itr->first < sync_next_post_num ) continue;
+         auto& ahead = itr->second;
+         if( std::get<2>( ahead ) )
+            std::get<0>( ahead )->post_signed_block( std::get<1>( ahead ), std::move( std::get<2>( ahead ) ), priority::medium );
+         ++sync_next_post_num;
+      }
+   }
+
    // static, thread safe
    void sync_manager::send_handshakes() {
       for_each_connection( []( auto& ci ) {
@@ -1553,7 +2273,15 @@ namespace eosio {
       fc_ilog( logger, "reassign_fetch, our last req is ${cc}, next expected is ${ne} peer ${p}",
                ("cc", sync_last_requested_num)( "ne", sync_next_expected_num )( "p", c->peer_name() ) );
 
-      if( c == sync_source ) {
+      if( multi_peer() ) {
+         if( std::any_of( sync_chunks.begin(), sync_chunks.end(), [&c]( const auto& ch ) { return ch.source == c; } ) ) {
+            c->sync_chunk_failed();
+            c->cancel_sync(reason);
+            release_chunks( c );
+            request_chunks( std::move(g) );
+         }
+      } else if( c == sync_source ) {
+         c->sync_chunk_failed();
          c->cancel_sync(reason);
          sync_last_requested_num = 0;
          request_next_chunk( std::move(g) );
@@ -1747,6 +2475,8 @@ namespace eosio {
          fc_wlog( logger, "block ${bn} not accepted from ${p}, closing connection", ("bn", blk_num)("p", c->peer_name()) );
          sync_last_requested_num = 0;
          sync_source.reset();
+         // blocks after the rejected one will not link either
+         reset_chunks();
          g.unlock();
          c->close();
       } else {
@@ -1816,10 +2546,25 @@ namespace eosio {
       } else if( state == lib_catchup ) {
          if( blk_num == sync_known_lib_num ) {
             fc_dlog( logger, "All caught up with last known last irreversible block resending handshake" );
+            reset_chunks();
             set_state( in_sync );
             g_sync.unlock();
             send_handshakes();
+         } else if( multi_peer() ) {
+            // a block dropped before reaching sync_reorder_block because we already had it is not posted again,
+            // the blocks after it must not wait for it
+            if( !blk_applied && blk_num == sync_next_post_num ) {
+               ++sync_next_post_num;
+               post_ahead_blocks();
+            } else if( !blk_applied && blk_num > sync_next_post_num && blk_num <= sync_last_requested_num ) {
+               sync_ahead.emplace( blk_num, std::make_tuple( c, blk_id, signed_block_ptr() ) );
+            }
+            // also covers the chunks of blocks dropped because we already had them
+            if( sync_chunk_received( c, blk_num ) || sync_chunks.size() < sync_peer_count ) {
+               request_chunks( std::move( g_sync ) );
+            }
          } else if( blk_num == sync_last_requested_num ) {
+            if( c == sync_source ) c->sync_chunk_completed();
             request_next_chunk( std::move( g_sync) );
          } else {
             g_sync.unlock();
@@ -1833,13 +2578,14 @@ namespace eosio {
 
    // thread safe
    bool dispatch_manager::add_peer_block( const block_id_type& blkid, uint32_t connection_id) {
-      std::lock_guard<std::mutex> g( blk_state_mtx );
-      auto bptr = blk_state.get<by_id>().find( std::make_tuple( connection_id, std::ref( blkid )));
-      bool added = (bptr == blk_state.end());
+      auto& s = blk_state.for_id( blkid );
+      std::lock_guard<wait_timed_mutex> g( s.mtx );
+      auto bptr = s.index.get<by_id>().find( std::make_tuple( connection_id, std::ref( blkid )));
+      bool added = (bptr == s.index.end());
       if( added ) {
-         blk_state.insert( {blkid, block_header::num_from_id( blkid ), connection_id, true} );
+         s.index.insert( {blkid, block_header::num_from_id( blkid ), connection_id, true} );
       } else if( !bptr->have_block ) {
-         blk_state.modify( bptr, []( auto& pb ) {
+         s.index.modify( bptr, []( auto& pb ) {
             pb.have_block = true;
          });
       }
@@ -1847,15 +2593,17 @@ namespace eosio {
    }
 
    bool dispatch_manager::peer_has_block( const block_id_type& blkid, uint32_t connection_id ) const {
-      std::lock_guard<std::mutex> g(blk_state_mtx);
-      const auto blk_itr = blk_state.get<by_id>().find( std::make_tuple( connection_id, std::ref( blkid )));
-      return blk_itr != blk_state.end();
+      const auto& s = blk_state.for_id( blkid );
+      std::lock_guard<wait_timed_mutex> g( s.mtx );
+      const auto blk_itr = s.index.get<by_id>().find( std::make_tuple( connection_id, std::ref( blkid )));
+      return blk_itr != s.index.end();
    }
 
    bool dispatch_manager::have_block( const block_id_type& blkid ) const {
-      std::lock_guard<std::mutex> g(blk_state_mtx);
+      const auto& s = blk_state.for_id( blkid );
+      std::lock_guard<wait_timed_mutex> g( s.mtx );
       // by_block_id sorts have_block by greater so have_block == true will be the first one found
-      const auto& index = blk_state.get<by_block_id>();
+      const auto& index = s.index.get<by_block_id>();
       auto blk_itr = index.find( blkid );
       if( blk_itr != index.end() ) {
          return blk_itr->have_block;
@@ -1864,75 +2612,104 @@ namespace eosio {
    }
 
    bool dispatch_manager::add_peer_txn( const node_transaction_state& nts ) {
-      std::lock_guard<std::mutex> g( local_txns_mtx );
-      auto tptr = local_txns.get<by_id>().find( std::make_tuple( std::ref( nts.id ), nts.connection_id ) );
-      bool added = (tptr == local_txns.end());
+      auto& s = local_txns.for_id( nts.id );
+      std::lock_guard<wait_timed_mutex> g( s.mtx );
+      auto tptr = s.index.get<by_id>().find( std::make_tuple( std::ref( nts.id ), nts.connection_id ) );
+      bool added = (tptr == s.index.end());
       if( added ) {
-         local_txns.insert( nts );
+         s.index.insert( nts );
       }
       return added;
    }
 
    // thread safe
    void dispatch_manager::update_txns_block_num( const signed_block_ptr& sb ) {
-      update_block_num ubn( sb->block_num() );
-      std::lock_guard<std::mutex> g( local_txns_mtx );
+      const uint32_t blk_num = sb->block_num();
       for( const auto& recpt : sb->transactions ) {
          const transaction_id_type& id = (recpt.trx.which() == 0) ? recpt.trx.get<transaction_id_type>()
                                                                   : recpt.trx.get<packed_transaction>().id();
-         auto range = local_txns.get<by_id>().equal_range( id );
-         for( auto itr = range.first; itr != range.second; ++itr ) {
-            local_txns.modify( itr, ubn );
-         }
+         update_txns_block_num( id, blk_num );
       }
    }
 
    // thread safe
    void dispatch_manager::update_txns_block_num( const transaction_id_type& id, uint32_t blk_num ) {
       update_block_num ubn( blk_num );
-      std::lock_guard<std::mutex> g( local_txns_mtx );
-      auto range = local_txns.get<by_id>().equal_range( id );
+      auto& s = local_txns.for_id( id );
+      std::lock_guard<wait_timed_mutex> g( s.mtx );
+      auto range = s.index.get<by_id>().equal_range( id );
       for( auto itr = range.first; itr != range.second; ++itr ) {
-         local_txns.modify( itr, ubn );
+         s.index.modify( itr, ubn );
       }
    }
 
    bool dispatch_manager::peer_has_txn( const transaction_id_type& tid, uint32_t connection_id ) const {
-      std::lock_guard<std::mutex> g( local_txns_mtx );
-      const auto tptr = local_txns.get<by_id>().find( std::make_tuple( std::ref( tid ), connection_id ) );
-      return tptr != local_txns.end();
+      const auto& s = local_txns.for_id( tid );
+      std::lock_guard<wait_timed_mutex> g( s.mtx );
+      const auto tptr = s.index.get<by_id>().find( std::make_tuple( std::ref( tid ), connection_id ) );
+      return tptr != s.index.end();
    }
 
    bool dispatch_manager::have_txn( const transaction_id_type& tid ) const {
-      std::lock_guard<std::mutex> g( local_txns_mtx );
-      const auto tptr = local_txns.get<by_id>().find( tid );
-      return tptr != local_txns.end();
+      const auto& s = local_txns.for_id( tid );
+      std::lock_guard<wait_timed_mutex> g( s.mtx );
+      const auto tptr = s.index.get<by_id>().find( tid );
+      return tptr != s.index.end();
    }
 
    void dispatch_manager::expire_txns( uint32_t lib_num ) {
       size_t start_size = 0, end_size = 0;
+      const auto now = time_point::now();
+
+      // one shard is locked at a time, the others stay available to the net threads
+      local_txns.for_each_shard( [&]( node_transaction_index& index ) {
+         start_size += index.size();
+         auto& old = index.get<by_expiry>();
+         auto ex_lo = old.lower_bound( fc::time_point_sec( 0 ) );
+         auto ex_up = old.upper_bound( now );
+         old.erase( ex_lo, ex_up );
+
+         auto& stale = index.get<by_block_num>();
+         stale.erase( stale.lower_bound( 1 ), stale.upper_bound( lib_num ) );
+         end_size += index.size();
+      } );
 
-      std::unique_lock<std::mutex> g( local_txns_mtx );
-      start_size = local_txns.size();
-      auto& old = local_txns.get<by_expiry>();
-      auto ex_lo = old.lower_bound( fc::time_point_sec( 0 ) );
-      auto ex_up = old.upper_bound( time_point::now() );
-      old.erase( ex_lo, ex_up );
-      g.unlock(); // allow other threads opportunity to use local_txns
-
-      g.lock();
-      auto& stale = local_txns.get<by_block_num>();
-      stale.erase( stale.lower_bound( 1 ), stale.upper_bound( lib_num ) );
-      end_size = local_txns.size();
-      g.unlock();
+      announced_trxs.for_each_shard( [&now]( announced_trx_index& index ) {
+         auto& old = index.get<by_expiry>();
+         old.erase( old.lower_bound( fc::time_point_sec( 0 ) ), old.upper_bound( now ) );
+      } );
+      received_trxs.for_each_shard( [&now]( received_trx_index& index ) {
+         auto& old = index.get<by_expiry>();
+         old.erase( old.lower_bound( fc::time_point_sec( 0 ) ), old.upper_bound( now ) );
+      } );
+      {
+         std::lock_guard<std::mutex> g( trx_requests_mtx );
+         for( auto itr = trx_requests.begin(); itr != trx_requests.end(); ) {
+            if( now - itr->second >= fc::milliseconds( trx_request_retry_ms ) ) {
+               itr = trx_requests.erase( itr );
+            } else {
+               ++itr;
+            }
+         }
+      }
 
       fc_dlog( logger, "expire_local_txns size ${s} removed ${r}", ("s", start_size)( "r", start_size - end_size ) );
    }
 
-   void dispatch_manager::expire_blocks( uint32_t lib_num ) {
-      std::lock_guard<std::mutex> g(blk_state_mtx);
-      auto& stale_blk = blk_state.get<by_block_num>();
-      stale_blk.erase( stale_blk.lower_bound(1), stale_blk.upper_bound(lib_num) );
+   // thread safe
+   void dispatch_manager::fill_metrics( net_metrics& m ) const {
+      m.tracked_block_states = blk_state.size();
+      m.tracked_trx_states = local_txns.size();
+      m.announced_trxs = announced_trxs.size();
+      m.received_trxs = received_trxs.size();
+      m.lock_wait_us = (blk_state.lock_wait_ns() + local_txns.lock_wait_ns() + announced_trxs.lock_wait_ns()) / 1000;
+   }
+
+   void dispatch_manager::expire_blocks( uint32_t lib_num ) {
+      blk_state.for_each_shard( [lib_num]( peer_block_state_index& index ) {
+         auto& stale_blk = index.get<by_block_num>();
+         stale_blk.erase( stale_blk.lower_bound(1), stale_blk.upper_bound(lib_num) );
+      } );
    }
 
    // thread safe
@@ -1954,13 +2731,12 @@ namespace eosio {
       } );
 
       if( !have_connection ) return;
-      std::shared_ptr<std::vector<char>> send_buffer = create_send_buffer( b );
 
-      for_each_block_connection( [this, &id, bnum = b->block_num(), &send_buffer]( auto& cp ) {
+      for_each_block_connection( [this, &id, &b, bnum = b->block_num()]( auto& cp ) {
          if( !cp->current() ) {
             return true;
          }
-         cp->strand.post( [this, cp, id, bnum, send_buffer]() {
+         cp->strand.post( [this, cp, id, b, bnum]() {
             std::unique_lock<std::mutex> g_conn( cp->conn_mtx );
             bool has_block = cp->last_handshake_recv.last_irreversible_block_num >= bnum;
             g_conn.unlock();
@@ -1969,6 +2745,18 @@ namespace eosio {
                   fc_dlog( logger, "not bcast block ${b} to ${p}", ("b", bnum)("p", cp->peer_name()) );
                   return;
                }
+               if( my_impl->p2p_compact_blocks && cp->protocol_version >= proto_compact_blocks ) {
+                  // which transactions the peer holds differs by peer, so the message is built for each of them
+                  auto cb = make_compact_block( *b, cp->connection_id );
+                  fc_dlog( logger, "bcast compact block ${b} to ${p}, ${n} of ${t} trxs by short id",
+                           ("b", bnum)("p", cp->peer_name())("n", cb.trxs.size())("t", b->transactions.size()) );
+                  cp->enqueue( cb );
+                  return;
+               }
+               // packed once for all the peers receiving the full block
+               auto send_buffer = my_impl->block_buffers.get( id, false, [&b]() {
+                  return create_send_buffer( b );
+               } );
                fc_dlog( logger, "bcast block ${b} to ${p}", ("b", bnum)("p", cp->peer_name()) );
                cp->enqueue_buffer( send_buffer, no_reason );
             }
@@ -1998,13 +2786,17 @@ namespace eosio {
       fc_dlog( logger, "rejected block ${id}", ("id", id) );
    }
 
-   void dispatch_manager::bcast_transaction(const packed_transaction& trx) {
+   void dispatch_manager::bcast_transaction(const packed_transaction_ptr& trx_ptr) {
+      const packed_transaction& trx = *trx_ptr;
       const auto& id = trx.id();
       time_point_sec trx_expiration = trx.expiration();
+      // blocks of other producers including it may come back as compact blocks
+      add_received_trx( trx_ptr );
       node_transaction_state nts = {id, trx_expiration, 0, 0};
 
+      const bool announce = my_impl->p2p_announce_transactions;
       std::shared_ptr<std::vector<char>> send_buffer;
-      for_each_connection( [this, &trx, &nts, &send_buffer]( auto& cp ) {
+      for_each_connection( [this, &trx, &nts, &send_buffer, announce]( auto& cp ) {
          if( cp->is_blocks_only_connection() || !cp->current() ) {
             return true;
          }
@@ -2014,16 +2806,104 @@ namespace eosio {
          }
          if( !send_buffer ) {
             send_buffer = create_send_buffer( trx );
+            if( announce ) {
+               // stored before any id goes out, so every request finds it
+               const time_point_sec retention{ fc::time_point::now() + fc::seconds( trx_announce_retention_sec ) };
+               auto& s = announced_trxs.for_id( nts.id );
+               std::lock_guard<wait_timed_mutex> g( s.mtx );
+               s.index.insert( announced_trx_state{ nts.id, std::min( nts.expires, retention ), send_buffer } );
+            }
          }
 
-         cp->strand.post( [cp, send_buffer]() {
-            fc_dlog( logger, "sending trx to ${n}", ("n", cp->peer_name()) );
-            cp->enqueue_buffer( send_buffer, no_reason );
-         } );
+         if( announce && cp->protocol_version >= proto_trx_announce ) {
+            cp->strand.post( [cp, id = nts.id]() {
+               cp->announce_trx( id );
+            } );
+         } else {
+            cp->strand.post( [cp, send_buffer]() {
+               fc_dlog( logger, "sending trx to ${n}", ("n", cp->peer_name()) );
+               cp->enqueue_buffer( send_buffer, no_reason );
+            } );
+         }
          return true;
       } );
    }
 
+   // thread safe
+   std::shared_ptr<std::vector<char>> dispatch_manager::announced_trx( const transaction_id_type& id ) const {
+      const auto& s = announced_trxs.for_id( id );
+      std::lock_guard<wait_timed_mutex> g( s.mtx );
+      auto itr = s.index.get<by_id>().find( id );
+      return itr != s.index.end() ? itr->send_buffer : std::shared_ptr<std::vector<char>>();
+   }
+
+   // thread safe
+   void dispatch_manager::add_received_trx( const packed_transaction_ptr& trx ) {
+      const auto& id = trx->id();
+      const time_point_sec retention{ fc::time_point::now() + fc::seconds( received_trx_retention_sec ) };
+      auto& s = received_trxs.for_id( id );
+      std::lock_guard<wait_timed_mutex> g( s.mtx );
+      s.index.insert( received_trx_state{ id, short_trx_id( id ), std::min( trx->expiration(), retention ), trx } );
+   }
+
+   // thread safe
+   packed_transaction_ptr dispatch_manager::find_received_trx( uint64_t short_id ) const {
+      const auto& s = received_trxs.for_short_id( short_id );
+      std::lock_guard<wait_timed_mutex> g( s.mtx );
+      auto range = s.index.get<by_short_id>().equal_range( short_id );
+      if( range.first == range.second || std::next( range.first ) != range.second ) return packed_transaction_ptr();
+      return range.first->trx;
+   }
+
+   // thread safe
+   compact_block_message dispatch_manager::make_compact_block( const signed_block& b, uint32_t connection_id ) const {
+      compact_block_message cb;
+      cb.header = b;
+      cb.block_extensions = b.block_extensions;
+      cb.trxs.reserve( b.transactions.size() );
+      for( uint32_t i = 0; i < b.transactions.size(); ++i ) {
+         const auto& r = b.transactions[i];
+         if( r.trx.contains<packed_transaction>() ) {
+            const auto& id = r.trx.get<packed_transaction>().id();
+            if( peer_has_txn( id, connection_id ) ) {
+               cb.trxs.push_back( compact_block_trx{ r, short_trx_id( id ) } );
+               continue;
+            }
+         }
+         cb.prefilled.emplace_back( i, r );
+      }
+      return cb;
+   }
+
+   // called from connection strand
+   void dispatch_manager::recv_trx_notice( const connection_ptr& c, const vector<transaction_id_type>& ids ) {
+      if( ids.size() > max_trx_ids_per_message ) {
+         fc_elog( logger, "Invalid notice_message, known_trx.ids.size ${s} from ${p}", ("s", ids.size())("p", c->peer_name()) );
+         return;
+      }
+      request_message req;
+      req.req_trx.mode = normal;
+      const auto now = fc::time_point::now();
+      {
+         std::lock_guard<std::mutex> g( trx_requests_mtx );
+         for( const auto& id : ids ) {
+            if( have_txn( id ) ) continue;
+            auto r = trx_requests.emplace( id, now );
+            if( !r.second ) {
+               if( now - r.first->second < fc::milliseconds( trx_request_retry_ms ) ) continue; // already asked another peer
+               r.first->second = now;
+            }
+            req.req_trx.ids.push_back( id );
+         }
+      }
+      if( !req.req_trx.ids.empty() ) {
+         req.req_trx.pending = req.req_trx.ids.size();
+         fc_dlog( logger, "request ${n} of ${a} announced trxs from ${p}",
+                  ("n", req.req_trx.ids.size())("a", ids.size())("p", c->peer_name()) );
+         c->enqueue( req );
+      }
+   }
+
    void dispatch_manager::rejected_transaction(const packed_transaction_ptr& trx, uint32_t head_blk_num) {
       fc_dlog( logger, "not sending rejected transaction ${tid}", ("tid", trx->id()) );
       // keep rejected transaction around for awhile so we don't broadcast it
@@ -2036,6 +2916,9 @@ namespace eosio {
    // called from connection strand
    void dispatch_manager::recv_notice(const connection_ptr& c, const notice_message& msg, bool generated) {
       if (msg.known_trx.mode == normal) {
+         if( !msg.known_trx.ids.empty() ) {
+            recv_trx_notice( c, msg.known_trx.ids );
+         }
       } else if (msg.known_trx.mode != none) {
          fc_elog( logger, "passed a notice_message with something other than a normal on none known_trx" );
          return;
@@ -2327,6 +3210,7 @@ namespace eosio {
                            if (bytes_in_buffer >= total_message_bytes) {
                               conn->pending_message_buffer.advance_read_ptr(message_header_size);
                               conn->consecutive_immediate_connection_close = 0;
+                              conn->bytes_received += total_message_bytes;
                               if (!conn->process_next_message(message_length)) {
                                  return;
                               }
@@ -2377,77 +3261,153 @@ namespace eosio {
    }
 
    // called from connection strand
-   bool connection::process_next_message( uint32_t message_length ) {
-      try {
-         // if next message is a block we already have, exit early
-         auto peek_ds = pending_message_buffer.create_peek_datastream();
-         unsigned_int which{};
-         fc::raw::unpack( peek_ds, which );
-         if( which == signed_block_which ) {
-            block_header bh;
-            fc::raw::unpack( peek_ds, bh );
-
-            const block_id_type blk_id = bh.id();
-            const uint32_t blk_num = bh.block_num();
-            if( my_impl->dispatcher->have_block( blk_id ) ) {
-               fc_dlog( logger, "canceling wait on ${p}, already received block ${num}, id ${id}...",
-                        ("p", peer_name())("num", blk_num)("id", blk_id.str().substr(8,16)) );
-               my_impl->sync_master->sync_recv_block( shared_from_this(), blk_id, blk_num, false );
-               cancel_wait();
+   bool connection::process_next_block_message( uint32_t which, uint32_t message_length ) {
+      auto peek_ds = pending_message_buffer.create_peek_datastream();
+      unsigned_int w{};
+      fc::raw::unpack( peek_ds, w ); // throw away
+
+      // the block is inflated up front, it is small next to the chain work of the block
+      std::vector<char> uncompressed;
+      block_header bh;
+      if( which == compressed_signed_block_which ) {
+         compressed_signed_block cb;
+         fc::raw::unpack( peek_ds, cb );
+         uncompressed = decompress_block( cb );
+         fc::datastream<const char*> ds( uncompressed.data(), uncompressed.size() );
+         fc::raw::unpack( ds, bh );
+      } else {
+         fc::raw::unpack( peek_ds, bh );
+      }
 
-               pending_message_buffer.advance_read_ptr( message_length );
-               return true;
-            }
-            fc_dlog( logger, "${p} received block ${num}, id ${id}..., latency: ${latency}",
-                     ("p", peer_name())("num", bh.block_num())("id", blk_id.str().substr(8,16))
-                     ("latency", (fc::time_point::now() - bh.timestamp).count()/1000) );
-            if( !my_impl->sync_master->syncing_with_peer() ) { // guard against peer thinking it needs to send us old blocks
-               uint32_t lib = 0;
-               std::tie( lib, std::ignore, std::ignore, std::ignore, std::ignore, std::ignore ) = my_impl->get_chain_info();
-               if( blk_num < lib ) {
-                  std::unique_lock<std::mutex> g( conn_mtx );
-                  const auto last_sent_lib = last_handshake_sent.last_irreversible_block_num;
-                  g.unlock();
-                  if( blk_num < last_sent_lib ) {
-                     fc_ilog( logger, "received block ${n} less than sent lib ${lib}", ("n", blk_num)("lib", last_sent_lib) );
-                     close();
-                  } else {
-                     fc_ilog( logger, "received block ${n} less than lib ${lib}", ("n", blk_num)("lib", lib) );
-                     enqueue( (sync_request_message) {0, 0} );
-                     send_handshake();
-                     cancel_wait();
-                  }
+      const block_id_type blk_id = bh.id();
+      const uint32_t blk_num = bh.block_num();
+      if( my_impl->dispatcher->have_block( blk_id ) ) {
+         ++dropped_duplicate_blocks;
+         fc_dlog( logger, "canceling wait on ${p}, already received block ${num}, id ${id}...",
+                  ("p", peer_name())("num", blk_num)("id", blk_id.str().substr(8,16)) );
+         my_impl->sync_master->sync_recv_block( shared_from_this(), blk_id, blk_num, false );
+         cancel_wait();
 
-                  pending_message_buffer.advance_read_ptr( message_length );
-                  return true;
-               }
+         pending_message_buffer.advance_read_ptr( message_length );
+         return true;
+      }
+      fc_dlog( logger, "${p} received block ${num}, id ${id}..., latency: ${latency}",
+               ("p", peer_name())("num", bh.block_num())("id", blk_id.str().substr(8,16))
+               ("latency", (fc::time_point::now() - bh.timestamp).count()/1000) );
+      if( !my_impl->sync_master->syncing_with_peer() ) { // guard against peer thinking it needs to send us old blocks
+         uint32_t lib = 0;
+         std::tie( lib, std::ignore, std::ignore, std::ignore, std::ignore, std::ignore ) = my_impl->get_chain_info();
+         if( blk_num < lib ) {
+            std::unique_lock<std::mutex> g( conn_mtx );
+            const auto last_sent_lib = last_handshake_sent.last_irreversible_block_num;
+            g.unlock();
+            if( blk_num < last_sent_lib ) {
+               fc_ilog( logger, "received block ${n} less than sent lib ${lib}", ("n", blk_num)("lib", last_sent_lib) );
+               close();
+            } else {
+               fc_ilog( logger, "received block ${n} less than lib ${lib}", ("n", blk_num)("lib", lib) );
+               enqueue( (sync_request_message) {0, 0} );
+               send_handshake();
+               cancel_wait();
             }
 
-            auto ds = pending_message_buffer.create_datastream();
-            fc::raw::unpack( ds, which ); // throw away
-            shared_ptr<signed_block> ptr = std::make_shared<signed_block>();
-            fc::raw::unpack( ds, *ptr );
+            pending_message_buffer.advance_read_ptr( message_length );
+            return true;
+         }
+      }
 
-            auto is_webauthn_sig = []( const fc::crypto::signature& s ) {
-               return s.which() == fc::crypto::signature::storage_type::position<fc::crypto::webauthn::signature>();
-            };
-            bool has_webauthn_sig = is_webauthn_sig( ptr->producer_signature );
+      shared_ptr<signed_block> ptr = std::make_shared<signed_block>();
+      if( which == compressed_signed_block_which ) {
+         fc::datastream<const char*> ds( uncompressed.data(), uncompressed.size() );
+         fc::raw::unpack( ds, *ptr );
+         pending_message_buffer.advance_read_ptr( message_length );
+      } else {
+         auto ds = pending_message_buffer.create_datastream();
+         fc::raw::unpack( ds, w ); // throw away
+         fc::raw::unpack( ds, *ptr );
+      }
 
-            constexpr auto additional_sigs_eid = additional_block_signatures_extension::extension_id();
-            auto exts = ptr->validate_and_extract_extensions();
-            if( exts.count( additional_sigs_eid ) ) {
-               const auto &additional_sigs = exts.lower_bound( additional_sigs_eid )->second.get<additional_block_signatures_extension>().signatures;
-               has_webauthn_sig |= std::any_of( additional_sigs.begin(), additional_sigs.end(), is_webauthn_sig );
-            }
+      auto is_webauthn_sig = []( const fc::crypto::signature& s ) {
+         return s.which() == fc::crypto::signature::storage_type::position<fc::crypto::webauthn::signature>();
+      };
+      bool has_webauthn_sig = is_webauthn_sig( ptr->producer_signature );
 
-            if( has_webauthn_sig ) {
-               fc_dlog( logger, "WebAuthn signed block received from ${p}, closing connection", ("p", peer_name()));
-               close();
-               return false;
-            }
+      constexpr auto additional_sigs_eid = additional_block_signatures_extension::extension_id();
+      auto exts = ptr->validate_and_extract_extensions();
+      if( exts.count( additional_sigs_eid ) ) {
+         const auto &additional_sigs = exts.lower_bound( additional_sigs_eid )->second.get<additional_block_signatures_extension>().signatures;
+         has_webauthn_sig |= std::any_of( additional_sigs.begin(), additional_sigs.end(), is_webauthn_sig );
+      }
+
+      if( has_webauthn_sig ) {
+         fc_dlog( logger, "WebAuthn signed block received from ${p}, closing connection", ("p", peer_name()));
+         close();
+         return false;
+      }
 
-            handle_message( blk_id, std::move( ptr ) );
+      handle_message( blk_id, std::move( ptr ) );
+      return true;
+   }
 
+   // called from connection strand
+   // id and expiration of a packed_transaction read from ds without unpacking it, false if the transaction is
+   // compressed. The id of a transaction is the digest of its packed form, which is what packed_trx holds.
+   template<typename Stream>
+   static bool peek_trx_id( Stream& ds, transaction_id_type& id, time_point_sec& expires ) {
+      unsigned_int num_sigs;
+      fc::raw::unpack( ds, num_sigs );
+      signature_type sig;
+      for( uint32_t i = 0; i < num_sigs.value; ++i ) {
+         fc::raw::unpack( ds, sig );
+      }
+      uint8_t compression = 0;
+      fc::raw::unpack( ds, compression );
+      if( compression != static_cast<uint8_t>( packed_transaction::compression_type::none ) ) {
+         return false;
+      }
+      unsigned_int cfd_size;
+      fc::raw::unpack( ds, cfd_size );
+      ds.skip( cfd_size.value );
+
+      unsigned_int trx_size;
+      fc::raw::unpack( ds, trx_size );
+      if( trx_size.value < sizeof(uint32_t) ) {
+         return false;
+      }
+      digest_type::encoder enc;
+      char buf[4*1024];
+      for( uint32_t left = trx_size.value; left > 0; ) {
+         const uint32_t n = std::min<uint32_t>( left, sizeof(buf) );
+         ds.read( buf, n );
+         if( left == trx_size.value ) {
+            // transaction_header starts with expiration
+            uint32_t sec;
+            memcpy( &sec, buf, sizeof(sec) );
+            expires = time_point_sec( sec );
+         }
+         enc.write( buf, n );
+         left -= n;
+      }
+      id = enc.result();
+      return true;
+   }
+
+   bool connection::process_next_message( uint32_t message_length ) {
+      try {
+         // if next message is a block we already have, exit early
+         auto peek_ds = pending_message_buffer.create_peek_datastream();
+         unsigned_int which{};
+         fc::raw::unpack( peek_ds, which );
+         if( which.value < net_message_types ) ++messages_received[which.value];
+         // the messages past packed_transaction are this fork's, the same indexes mean other messages upstream
+         if( which.value > packed_transaction_which && protocol_version < proto_fork_base ) {
+            fc_elog( logger, "Peer ${p} sent ${w} without negotiating it, closing connection",
+                     ("p", peer_name())("w", which.value < net_message_types ? net_message_names[which.value] : "unknown message") );
+            close();
+            return false;
+         }
+         if( which == signed_block_which || which == compressed_signed_block_which ) {
+            return process_next_block_message( which, message_length );
          } else if( which == packed_transaction_which ) {
             if( !my_impl->p2p_accept_transactions ) {
                fc_dlog( logger, "p2p-accept-transaction=false - dropping txn" );
@@ -2455,6 +3415,20 @@ namespace eosio {
                return true;
             }
 
+            // most transactions arrive from several peers, drop the copies before allocating and unpacking them
+            transaction_id_type tid;
+            time_point_sec expires;
+            if( peek_trx_id( peek_ds, tid, expires ) ) {
+               bool have_trx = my_impl->dispatcher->have_txn( tid );
+               if( have_trx ) {
+                  ++dropped_duplicate_trxs;
+                  my_impl->dispatcher->add_peer_txn( node_transaction_state{tid, expires, 0, connection_id} );
+                  fc_dlog( logger, "got a duplicate transaction - dropping ${id}", ("id", tid) );
+                  pending_message_buffer.advance_read_ptr( message_length );
+                  return true;
+               }
+            }
+
             auto ds = pending_message_buffer.create_datastream();
             fc::raw::unpack( ds, which ); // throw away
             shared_ptr<packed_transaction> ptr = std::make_shared<packed_transaction>();
@@ -2709,6 +3683,10 @@ namespace eosio {
          return;  // We don't have enough data to perform the calculation yet.
       }
 
+      // tstamp is in ns, the time the peer held the message is not part of the round trip
+      const tstamp round_trip = (dst - org) - (msg.xmt - rec);
+      if( round_trip > 0 ) rtt_us = round_trip / 1000;
+
       double offset = (double(rec - org) + double(msg.xmt - dst)) / 2;
       double NsecPerUsec{1000};
 
@@ -2816,14 +3794,29 @@ namespace eosio {
          if( msg.req_blocks.mode == none ) {
             stop_send();
          }
-         // no break
-      case normal :
          if( !msg.req_trx.ids.empty() ) {
             fc_elog( logger, "Invalid request_message, req_trx.ids.size ${s}", ("s", msg.req_trx.ids.size()) );
             close();
             return;
          }
          break;
+      case normal :
+         if( !msg.req_trx.ids.empty() ) {
+            // transactions we announced by id
+            if( protocol_version < proto_trx_announce || msg.req_trx.ids.size() > max_trx_ids_per_message ) {
+               fc_elog( logger, "Invalid request_message, req_trx.ids.size ${s}", ("s", msg.req_trx.ids.size()) );
+               close();
+               return;
+            }
+            peer_dlog( this, "received request_message for ${n} trxs", ("n", msg.req_trx.ids.size()) );
+            for( const auto& id : msg.req_trx.ids ) {
+               auto send_buffer = my_impl->dispatcher->announced_trx( id );
+               if( send_buffer ) {
+                  enqueue_buffer( send_buffer, no_reason );
+               }
+            }
+         }
+         break;
       default:;
       }
    }
@@ -2863,12 +3856,16 @@ namespace eosio {
       my_impl->dispatcher->add_peer_txn( nts );
 
       if( have_trx ) {
+         ++dropped_duplicate_trxs;
          fc_dlog( logger, "got a duplicate transaction - dropping ${id}", ("id", tid) );
          return;
       }
 
-      trx_in_progress_size += calc_trx_size( trx );
-      app().post( priority::low, [trx{std::move(trx)}, weak = weak_from_this()]() {
+      my_impl->dispatcher->add_received_trx( trx );
+      const auto trx_size = calc_trx_size( trx );
+      trx_in_progress_size += trx_size;
+      // through the transaction lane, a flood of transactions is bounded there and never delays blocks
+      bool queued = chain::post_lanes::instance().post( my_impl->trx_lane, [trx, weak = weak_from_this()]() {
          my_impl->chain_plug->accept_transaction( trx,
             [weak, trx](const static_variant<fc::exception_ptr, transaction_trace_ptr>& result) mutable {
          // next (this lambda) called from application thread
@@ -2888,12 +3885,276 @@ namespace eosio {
          }
         });
       });
+      if( !queued ) {
+         trx_in_progress_size -= trx_size;
+         my_impl->producer_plug->log_failed_transaction( tid, "Dropping trx, transaction lane full" );
+      }
    }
 
    // called from connection strand
    void connection::handle_message( const block_id_type& id, signed_block_ptr ptr ) {
       peer_dlog( this, "received signed_block ${id}", ("id", ptr->block_num() ) );
-      auto priority = my_impl->sync_master->syncing_with_peer() ? priority::medium : priority::high;
+      const bool syncing = my_impl->sync_master->syncing_with_peer();
+      // blocks queue up while syncing, recover their keys while the blocks ahead of them execute
+      if( syncing ) my_impl->chain_plug->chain().start_recover_block_keys( ptr );
+      // chunks from several peers arrive out of order, the sync manager posts them in block order
+      if( syncing && my_impl->sync_master->sync_reorder_block( shared_from_this(), id, ptr ) ) return;
+      post_signed_block( id, std::move( ptr ), syncing ? priority::medium : priority::high );
+   }
+
+   // called from connection strand
+   void connection::handle_message( const compact_block_message& msg ) {
+      const block_id_type blk_id = msg.header.calculate_id();
+      const uint32_t blk_num = msg.header.block_num();
+      if( my_impl->dispatcher->have_block( blk_id ) ) {
+         ++dropped_duplicate_blocks;
+         fc_dlog( logger, "canceling wait on ${p}, already received compact block ${num}, id ${id}...",
+                  ("p", peer_name())("num", blk_num)("id", blk_id.str().substr(8,16)) );
+         my_impl->sync_master->sync_recv_block( shared_from_this(), blk_id, blk_num, false );
+         cancel_wait();
+         return;
+      }
+
+      const size_t total = msg.trxs.size() + msg.prefilled.size();
+      for( size_t i = 0; i < msg.prefilled.size(); ++i ) {
+         if( msg.prefilled[i].first >= total || (i > 0 && msg.prefilled[i].first <= msg.prefilled[i - 1].first) ) {
+            fc_elog( logger, "Invalid compact_block_message, prefilled positions out of order, closing ${p}", ("p", peer_name()) );
+            close();
+            return;
+         }
+      }
+
+      auto block = std::make_shared<signed_block>( msg.header );
+      block->block_extensions = msg.block_extensions;
+      block->transactions.resize( total );
+      pending_compact_block pending{ blk_id, block };
+      auto prefilled = msg.prefilled.begin();
+      auto compact = msg.trxs.begin();
+      for( uint32_t i = 0; i < total; ++i ) {
+         auto& r = block->transactions[i];
+         if( prefilled != msg.prefilled.end() && prefilled->first == i ) {
+            r = (prefilled++)->second;
+            continue;
+         }
+         const auto& t = *compact++;
+         static_cast<transaction_receipt_header&>( r ) = t.receipt;
+         auto trx = my_impl->dispatcher->find_received_trx( t.short_id );
+         if( trx ) {
+            r.trx = *trx;
+         } else {
+            pending.missing.push_back( i );
+            pending.short_ids.push_back( t.short_id );
+         }
+      }
+      peer_dlog( this, "received compact block ${num}, ${t} trxs, ${p} prefilled, ${m} missing",
+                 ("num", blk_num)("t", total)("p", msg.prefilled.size())("m", pending.missing.size()) );
+
+      if( pending.missing.empty() ) {
+         pending_compact.reset();
+         finish_compact_block( blk_id, std::move( block ) );
+         return;
+      }
+      enqueue( get_block_trxs_message{ blk_id, pending.missing } );
+      pending_compact = std::move( pending );
+   }
+
+   // called from connection strand
+   void connection::handle_message( const get_block_trxs_message& msg ) {
+      peer_dlog( this, "received get_block_trxs_message for ${n} trxs", ("n", msg.indexes.size()) );
+      connection_wptr weak = shared_from_this();
+      app().post( priority::high, [msg, weak{std::move(weak)}]() {
+         connection_ptr c = weak.lock();
+         if( !c ) return;
+         signed_block_ptr b;
+         try {
+            b = my_impl->chain_plug->chain().fetch_block_by_id( msg.block_id );
+         } catch( ... ) {
+            fc_elog( logger, "caught exception fetching block id ${id} for ${p}", ("id", msg.block_id)( "p", c->peer_address() ) );
+         }
+         if( !b ) {
+            fc_ilog( logger, "fetch block by id returned null, id ${id} for ${p}", ("id", msg.block_id)( "p", c->peer_address() ) );
+            return;
+         }
+         c->strand.post( [c, b{std::move(b)}, msg]() {
+            block_trxs_message reply;
+            reply.block_id = msg.block_id;
+            reply.trxs.reserve( msg.indexes.size() );
+            for( auto i : msg.indexes ) {
+               if( i >= b->transactions.size() || !b->transactions[i].trx.contains<packed_transaction>() ) {
+                  fc_elog( logger, "Invalid get_block_trxs_message, position ${i}, closing ${p}", ("i", i)("p", c->peer_name()) );
+                  c->close();
+                  return;
+               }
+               reply.trxs.push_back( b->transactions[i].trx.get<packed_transaction>() );
+            }
+            c->enqueue( reply );
+         } );
+      } );
+   }
+
+   // called from connection strand
+   void connection::handle_message( const block_trxs_message& msg ) {
+      if( !pending_compact || pending_compact->id != msg.block_id ) {
+         peer_dlog( this, "received block_trxs_message of a block no longer pending" );
+         return;
+      }
+      auto pending = std::move( *pending_compact );
+      pending_compact.reset();
+      if( my_impl->dispatcher->have_block( pending.id ) ) return;
+
+      bool complete = msg.trxs.size() == pending.missing.size();
+      for( size_t i = 0; complete && i < msg.trxs.size(); ++i ) {
+         complete = short_trx_id( msg.trxs[i].id() ) == pending.short_ids[i];
+         pending.block->transactions[pending.missing[i]].trx = msg.trxs[i];
+      }
+      if( !complete ) {
+         peer_wlog( this, "block_trxs_message does not match the missing transactions of block ${n}", ("n", pending.block->block_num()) );
+         ++compact_block_fallbacks;
+         request_message req;
+         req.req_blocks.mode = normal;
+         req.req_blocks.ids.push_back( pending.id );
+         enqueue( req );
+         return;
+      }
+      finish_compact_block( pending.id, std::move( pending.block ) );
+   }
+
+   // called from connection strand
+   void connection::finish_compact_block( const block_id_type& id, std::shared_ptr<signed_block> block ) {
+      // a short id may have matched another transaction, then the block is taken in full
+      vector<digest_type> trx_digests;
+      trx_digests.reserve( block->transactions.size() );
+      for( const auto& r : block->transactions ) trx_digests.emplace_back( r.digest() );
+      if( merkle( std::move( trx_digests ) ) != block->transaction_mroot ) {
+         peer_dlog( this, "rebuilt compact block ${n} does not match its transaction_mroot, requesting it in full", ("n", block->block_num()) );
+         ++compact_block_fallbacks;
+         request_message req;
+         req.req_blocks.mode = normal;
+         req.req_blocks.ids.push_back( id );
+         enqueue( req );
+         return;
+      }
+      ++compact_blocks_rebuilt;
+      handle_message( id, std::move( block ) );
+   }
+
+   // called from connection strand
+   void connection::handle_message( const get_snapshots_message& msg ) {
+      peer_dlog( this, "received get_snapshots_message" );
+      snapshots_message reply;
+      // hashing a new snapshot holds this strand, it is done once per snapshot file
+      if( my_impl->snapshots.enabled() ) reply.snapshots = my_impl->snapshots.list( msg.min_block_num );
+      enqueue( reply );
+   }
+
+   // called from connection strand
+   void connection::handle_message( const get_snapshot_chunk_message& msg ) {
+      if( msg.size == 0 || msg.size > max_snapshot_chunk_size ) {
+         fc_elog( logger, "Invalid get_snapshot_chunk_message, size ${s}, closing ${p}", ("s", msg.size)("p", peer_name()) );
+         close();
+         return;
+      }
+      snapshot_chunk_message reply;
+      reply.block_id = msg.block_id;
+      reply.offset = msg.offset;
+      if( my_impl->snapshots.enabled() ) reply.data = my_impl->snapshots.read( msg.block_id, msg.offset, msg.size );
+      enqueue( reply );
+   }
+
+   void snapshot_catalog::start( const bfs::path& d ) {
+      dir = d;
+      hasher.emplace( "snphsh", 1 );
+   }
+
+   void snapshot_catalog::stop() {
+      if( hasher ) hasher->stop();
+   }
+
+   vector<snapshot_entry> snapshot_catalog::list( uint32_t min_block_num ) {
+      vector<snapshot_entry> result;
+      boost::system::error_code ec;
+      if( !bfs::is_directory( dir, ec ) ) return result;
+      std::lock_guard<std::mutex> g( mtx );
+      for( const auto& f : bfs::directory_iterator( dir, ec ) ) {
+         const auto name = f.path().filename().string();
+         // snapshot-<64 hex digits>.bin, pending, incomplete and diff snapshots are named otherwise and not served
+         if( name.size() != 9 + 64 + 4 || name.compare( 0, 9, "snapshot-" ) != 0 || !bfs::is_regular_file( f.path(), ec ) )
+            continue;
+         block_id_type id;
+         try {
+            id = block_id_type( name.substr( 9, 64 ) );
+         } catch( ... ) {
+            continue;
+         }
+         if( file_name( id ) != f.path().filename() || block_header::num_from_id( id ) < min_block_num ) continue;
+         try {
+            const uint64_t size = bfs::file_size( f.path() );
+            const std::time_t write_time = bfs::last_write_time( f.path() );
+            auto h = hashed.find( f.path() );
+            if( h != hashed.end() && h->second.entry.block_id == id && h->second.entry.size == size
+                && h->second.write_time == write_time ) {
+               result.push_back( h->second.entry );
+            } else if( hasher && queued.insert( f.path() ).second ) {
+               boost::asio::post( hasher->get_executor(), [this, p = f.path(), id, size, write_time]() {
+                  hash( p, id, size, write_time );
+               } );
+            }
+         } catch( const std::exception& e ) {
+            // removed by the snapshot pruning of producer_plugin meanwhile
+            fc_dlog( logger, "skipping snapshot ${f}: ${e}", ("f", name)("e", e.what()) );
+            hashed.erase( f.path() );
+         }
+      }
+      std::sort( result.begin(), result.end(), []( const snapshot_entry& a, const snapshot_entry& b ) {
+         return block_header::num_from_id( a.block_id ) > block_header::num_from_id( b.block_id );
+      } );
+      return result;
+   }
+
+   // called from the hashing thread, the file is read without holding mtx
+   void snapshot_catalog::hash( const bfs::path& p, const block_id_type& id, uint64_t size, std::time_t write_time ) {
+      optional<fc::sha256> digest;
+      try {
+         digest = hash_file( p );
+      } catch( const fc::exception& e ) {
+         fc_dlog( logger, "skipping snapshot ${f}: ${e}", ("f", p.generic_string())("e", e.to_detail_string()) );
+      } catch( const std::exception& e ) {
+         fc_dlog( logger, "skipping snapshot ${f}: ${e}", ("f", p.generic_string())("e", e.what()) );
+      }
+      std::lock_guard<std::mutex> g( mtx );
+      queued.erase( p );
+      // a file written meanwhile does not match size or write time on the next list and is hashed again
+      if( digest ) hashed[p] = hashed_file{ write_time, snapshot_entry{ id, size, *digest } };
+   }
+
+   vector<char> snapshot_catalog::read( const block_id_type& block_id, uint64_t offset, uint32_t size ) const {
+      vector<char> data;
+      std::ifstream in( ( dir / file_name( block_id ) ).generic_string(), std::ios::in | std::ios::binary );
+      if( !in ) return data;
+      in.seekg( 0, std::ios::end );
+      const uint64_t file_size = in.tellg();
+      if( offset >= file_size ) return data;
+      data.resize( std::min<uint64_t>( size, file_size - offset ) );
+      in.seekg( offset );
+      if( !in.read( data.data(), data.size() ) ) data.clear();
+      return data;
+   }
+
+   fc::sha256 snapshot_catalog::hash_file( const bfs::path& p ) {
+      std::ifstream in( p.generic_string(), std::ios::in | std::ios::binary );
+      EOS_ASSERT( in, snapshot_exception, "unable to open ${p}", ("p", p.generic_string()) );
+      fc::sha256::encoder enc;
+      vector<char> buf( max_snapshot_chunk_size );
+      while( in ) {
+         in.read( buf.data(), buf.size() );
+         if( in.gcount() > 0 ) enc.write( buf.data(), in.gcount() );
+      }
+      EOS_ASSERT( in.eof(), snapshot_exception, "unable to read ${p}", ("p", p.generic_string()) );
+      return enc.result();
+   }
+
+   // thread safe
+   void connection::post_signed_block( const block_id_type& id, signed_block_ptr ptr, int priority ) {
       app().post(priority, [ptr{std::move(ptr)}, id, c = shared_from_this()]() mutable {
          c->process_signed_block( id, std::move( ptr ) );
       });
@@ -2903,6 +4164,7 @@ namespace eosio {
    void connection::process_signed_block( const block_id_type& blk_id, signed_block_ptr msg ) {
       controller& cc = my_impl->chain_plug->chain();
       uint32_t blk_num = msg->block_num();
+      chain::scoped_span span( "net_receive_block", "net_plugin", blk_num );
       // use c in this method instead of this to highlight that all methods called on c-> must be thread safe
       connection_ptr c = shared_from_this();
 
@@ -2928,6 +4190,11 @@ namespace eosio {
       peer_dlog( c, "received signed_block : #${n} block age in secs = ${age}",
                  ("n", blk_num)( "age", age.to_seconds() ) );
 
+      if( my_impl->p2p_early_block_relay ) {
+         // the block may be relayed before accept_block returns, not back to where it came from
+         my_impl->dispatcher->add_peer_block( blk_id, c->connection_id );
+      }
+
       go_away_reason reason = fatal_other;
       try {
          bool accepted = my_impl->chain_plug->accept_block(msg, blk_id);
@@ -3004,6 +4271,28 @@ namespace eosio {
       } );
    }
 
+   // thread safe
+   void net_plugin_impl::start_trx_announce_timer() {
+      if( in_shutdown ) return;
+      std::lock_guard<std::mutex> g( trx_announce_timer_mtx );
+      trx_announce_timer->expires_from_now( def_trx_announce_interval );
+      trx_announce_timer->async_wait( [my = shared_from_this()]( boost::system::error_code ec ) {
+         if( my->in_shutdown ) return;
+         if( ec ) {
+            fc_wlog( logger, "Transaction announce timer ticked sooner than expected: ${m}", ("m", ec.message()) );
+         }
+         for_each_connection( []( auto& c ) {
+            if( c->socket_is_open() ) {
+               c->strand.post( [c]() {
+                  c->flush_trx_announces();
+               } );
+            }
+            return true;
+         } );
+         my->start_trx_announce_timer();
+      } );
+   }
+
    // thread safe
    void net_plugin_impl::ticker() {
       if( in_shutdown ) return;
@@ -3105,6 +4394,15 @@ namespace eosio {
       });
    }
 
+   // called from application thread, the header and the producer signature of the block are validated, it is
+   // applied after this
+   void net_plugin_impl::on_accepted_block_header(const block_state_ptr& bs) {
+      dispatcher->strand.post( [this, bs]() {
+         fc_dlog( logger, "signaled accepted_block_header, relaying blk num = ${num}, id = ${id}", ("num", bs->block_num)("id", bs->id) );
+         dispatcher->bcast_block( bs->block, bs->id );
+      });
+   }
+
    // called from application thread
    void net_plugin_impl::on_pre_accepted_block(const signed_block_ptr& block) {
       update_chain_info();
@@ -3136,7 +4434,7 @@ namespace eosio {
             dispatcher->rejected_transaction(results.second->packed_trx(), head_blk_num);
          } else {
             fc_dlog( logger, "signaled ACK, trx-id = ${id}", ("id", id) );
-            dispatcher->bcast_transaction(*results.second->packed_trx());
+            dispatcher->bcast_transaction(results.second->packed_trx());
          }
       });
    }
@@ -3216,10 +4514,22 @@ namespace eosio {
    }
 
    // call from connection strand
+   static const char* os_name() {
+#if defined( __APPLE__ )
+      return "osx";
+#elif defined( __linux__ )
+      return "linux";
+#elif defined( _WIN32 )
+      return "win32";
+#else
+      return "other";
+#endif
+   }
+
    bool connection::populate_handshake( handshake_message& hello, bool force ) {
       namespace sc = std::chrono;
       bool send = force;
-      hello.network_version = net_version_base + net_version;
+      hello.network_version = my_impl->to_network_version(net_version);
       const auto prev_head_id = hello.head_id;
       uint32_t lib, head;
       std::tie( lib, std::ignore, head,
@@ -3244,20 +4554,299 @@ namespace eosio {
       if( is_transactions_only_connection() ) hello.p2p_address += ":trx";
       if( is_blocks_only_connection() ) hello.p2p_address += ":blk";
       hello.p2p_address += " - " + hello.node_id.str().substr(0,7);
-#if defined( __APPLE__ )
-      hello.os = "osx";
-#elif defined( __linux__ )
-      hello.os = "linux";
-#elif defined( _WIN32 )
-      hello.os = "win32";
-#else
-      hello.os = "other";
-#endif
+      hello.os = os_name();
       hello.agent = my_impl->user_agent_name;
 
       return true;
    }
 
+   /// connection to a peer of snapshot_fetcher, blocking calls each bounded by snapshot_fetch_timeout
+   class snapshot_peer {
+   public:
+      explicit snapshot_peer( string address ) : address( std::move( address ) ) {}
+
+      const string& peer_address() const { return address; }
+
+      /// connects and sends the handshake the peer expects before any other message
+      void connect();
+      void send( const net_message& m );
+      /// the next message of type T, skipping the handshake, time and sync messages the peer sends
+      template<typename T>
+      T receive();
+
+   private:
+      net_message receive_message();
+      void read( char* data, size_t size );
+      /// runs the operation started on ctx, closes the socket if it does not complete in time
+      void run( const char* what );
+
+      string                    address;
+      boost::asio::io_context   ctx;
+      tcp::socket               socket{ ctx };
+   };
+
+   /**
+    * Downloads the newest snapshot the p2p-peer-address peers serve, before the chain starts, for a node with a fresh
+    * state to start from it instead of syncing from genesis. Every peer is asked for its snapshots. A snapshot is only
+    * chosen if at least quorum peers serve the same block id, size and hash, or if it matches the block id or hash the
+    * operator pinned, so a single peer cannot hand out a state of its own. The newest such snapshot is then fetched in
+    * chunks of max_snapshot_chunk_size, each peer serving it fetching chunks on a thread of its own, a chunk failing on
+    * a peer being fetched from another one. The file is checked against the hash before it is handed to chain_plugin,
+    * which checks its chain ID.
+    */
+   class snapshot_fetcher {
+   public:
+      snapshot_fetcher( vector<string> peers, bfs::path dir, uint32_t quorum,
+                        fc::optional<block_id_type> pinned_block_id, fc::optional<fc::sha256> pinned_hash )
+      : peers( std::move( peers ) ), dir( std::move( dir ) ), quorum( quorum )
+      , pinned_block_id( std::move( pinned_block_id ) ), pinned_hash( std::move( pinned_hash ) ) {}
+
+      /// path of the verified snapshot, nothing if no snapshot is served by a quorum of peers or matches the pin
+      fc::optional<bfs::path> fetch();
+
+   private:
+      /// fetches chunks from peer until there are none left or the peer fails
+      void fetch_chunks( snapshot_peer& peer, const snapshot_entry& snapshot, const bfs::path& p );
+
+      const vector<string>  peers;
+      const bfs::path       dir;
+      const uint32_t                      quorum;          ///< peers agreeing on a snapshot without a pin
+      const fc::optional<block_id_type>   pinned_block_id;
+      const fc::optional<fc::sha256>      pinned_hash;
+
+      std::mutex                mtx; // protects the chunk state below
+      std::condition_variable   chunk_done;
+      std::deque<uint64_t>      pending_chunks;
+      uint32_t                  chunks_in_flight = 0;
+   };
+
+   void snapshot_peer::run( const char* what ) {
+      ctx.restart();
+      ctx.run_for( snapshot_fetch_timeout );
+      if( !ctx.stopped() ) {
+         boost::system::error_code ec;
+         socket.close( ec );
+         ctx.run();
+         EOS_THROW( snapshot_exception, "${w} timed out on ${p}", ("w", what)("p", address) );
+      }
+   }
+
+   void snapshot_peer::connect() {
+      // host:port, optionally followed by :trx or :blk
+      const auto colon = address.find( ':' );
+      EOS_ASSERT( colon != string::npos, plugin_config_exception, "Invalid peer address ${p}", ("p", address) );
+      const auto host = address.substr( 0, colon );
+      const auto port = address.substr( colon + 1, address.find( ':', colon + 1 ) - colon - 1 );
+
+      boost::system::error_code ec;
+      tcp::resolver resolver( ctx );
+      resolver.async_resolve( tcp::v4(), host, port, [this, &ec]( const boost::system::error_code& err, tcp::resolver::results_type endpoints ) {
+         if( err ) {
+            ec = err;
+            return;
+         }
+         boost::asio::async_connect( socket, endpoints, [&ec]( const boost::system::error_code& err, const tcp::endpoint& ) {
+            ec = err;
+         } );
+      } );
+      run( "connect" );
+      EOS_ASSERT( !ec, snapshot_exception, "unable to connect to ${p}: ${m}", ("p", address)("m", ec.message()) );
+
+      namespace sc = std::chrono;
+      handshake_message hello;
+      hello.network_version = my_impl->to_network_version(net_version);
+      hello.chain_id = my_impl->chain_id;
+      hello.node_id = my_impl->node_id;
+      hello.key = my_impl->get_authentication_key();
+      hello.time = sc::duration_cast<sc::nanoseconds>(sc::system_clock::now().time_since_epoch()).count();
+      hello.token = fc::sha256::hash(hello.time);
+      hello.sig = my_impl->sign_compact(hello.key, hello.token);
+      if(hello.sig == chain::signature_type())
+         hello.token = sha256();
+      hello.p2p_address = ( my_impl->p2p_address.empty() ? string( "snapshot" ) : my_impl->p2p_address )
+                          + " - " + hello.node_id.str().substr(0,7);
+      hello.os = os_name();
+      hello.agent = my_impl->user_agent_name;
+      hello.generation = 1;
+      send( hello );
+   }
+
+   void snapshot_peer::send( const net_message& m ) {
+      const uint32_t payload_size = fc::raw::pack_size( m );
+      vector<char> buf( message_header_size + payload_size );
+      fc::datastream<char*> ds( buf.data(), buf.size() );
+      ds.write( reinterpret_cast<const char*>( &payload_size ), message_header_size );
+      fc::raw::pack( ds, m );
+
+      boost::system::error_code ec;
+      boost::asio::async_write( socket, boost::asio::buffer( buf ), [&ec]( const boost::system::error_code& err, std::size_t ) {
+         ec = err;
+      } );
+      run( "write" );
+      EOS_ASSERT( !ec, snapshot_exception, "write to ${p} failed: ${m}", ("p", address)("m", ec.message()) );
+   }
+
+   void snapshot_peer::read( char* data, size_t size ) {
+      boost::system::error_code ec;
+      boost::asio::async_read( socket, boost::asio::buffer( data, size ), [&ec]( const boost::system::error_code& err, std::size_t ) {
+         ec = err;
+      } );
+      run( "read" );
+      EOS_ASSERT( !ec, snapshot_exception, "read from ${p} failed: ${m}", ("p", address)("m", ec.message()) );
+   }
+
+   net_message snapshot_peer::receive_message() {
+      uint32_t payload_size = 0;
+      read( reinterpret_cast<char*>( &payload_size ), message_header_size );
+      EOS_ASSERT( payload_size > 0 && payload_size <= def_send_buffer_size*2, snapshot_exception,
+                  "invalid message size ${s} from ${p}", ("s", payload_size)("p", address) );
+      vector<char> buf( payload_size );
+      read( buf.data(), buf.size() );
+      fc::datastream<const char*> ds( buf.data(), buf.size() );
+      net_message m;
+      fc::raw::unpack( ds, m );
+      return m;
+   }
+
+   template<typename T>
+   T snapshot_peer::receive() {
+      const auto deadline = std::chrono::steady_clock::now() + snapshot_fetch_timeout;
+      while( true ) {
+         net_message m = receive_message();
+         if( m.contains<T>() ) return std::move( m.get<T>() );
+         EOS_ASSERT( !m.contains<go_away_message>(), snapshot_exception, "${p} sent go away: ${r}",
+                     ("p", address)("r", reason_str( m.get<go_away_message>().reason )) );
+         EOS_ASSERT( std::chrono::steady_clock::now() < deadline, snapshot_exception, "no reply from ${p}", ("p", address) );
+      }
+   }
+
+   fc::optional<bfs::path> snapshot_fetcher::fetch() {
+      // the peers serving each snapshot, by block id, size and hash
+      using snapshot_key = std::tuple<block_id_type, uint64_t, fc::sha256>;
+      std::vector<std::unique_ptr<snapshot_peer>> links;
+      std::map<snapshot_key, vector<snapshot_peer*>> servers;
+      for( const auto& address : peers ) {
+         auto link = std::make_unique<snapshot_peer>( address );
+         try {
+            link->connect();
+            link->send( get_snapshots_message{} );
+            for( const auto& s : link->receive<snapshots_message>().snapshots ) {
+               // a peer listing a snapshot twice counts once towards the quorum
+               auto& serving = servers[snapshot_key{ s.block_id, s.size, s.hash }];
+               if( serving.empty() || serving.back() != link.get() ) serving.push_back( link.get() );
+            }
+            links.push_back( std::move( link ) );
+         } catch( const fc::exception& e ) {
+            fc_wlog( logger, "unable to list the snapshots of ${p}: ${e}", ("p", address)("e", e.to_string()) );
+         } catch( const std::exception& e ) {
+            fc_wlog( logger, "unable to list the snapshots of ${p}: ${e}", ("p", address)("e", e.what()) );
+         }
+      }
+
+      const bool pinned = pinned_block_id || pinned_hash;
+      auto best = servers.end();
+      for( auto itr = servers.begin(); itr != servers.end(); ++itr ) {
+         if( pinned_block_id && std::get<0>( itr->first ) != *pinned_block_id ) continue;
+         if( pinned_hash && std::get<2>( itr->first ) != *pinned_hash ) continue;
+         if( !pinned && itr->second.size() < quorum ) {
+            fc_dlog( logger, "snapshot of block ${n} served by ${c} peers only, quorum is ${q}",
+                     ("n", block_header::num_from_id( std::get<0>( itr->first ) ))("c", itr->second.size())("q", quorum) );
+            continue;
+         }
+         if( best == servers.end() ) {
+            best = itr;
+            continue;
+         }
+         const uint32_t num = block_header::num_from_id( std::get<0>( itr->first ) );
+         const uint32_t best_num = block_header::num_from_id( std::get<0>( best->first ) );
+         if( num > best_num || ( num == best_num && itr->second.size() > best->second.size() ) ) best = itr;
+      }
+      if( best == servers.end() ) {
+         if( pinned )
+            EOS_THROW( snapshot_exception, "no peer serves the pinned snapshot" );
+         return {};
+      }
+
+      snapshot_entry snapshot{ std::get<0>( best->first ), std::get<1>( best->first ), std::get<2>( best->first ) };
+      const bfs::path final_path = dir / snapshot_catalog::file_name( snapshot.block_id );
+      if( bfs::is_regular_file( final_path ) && bfs::file_size( final_path ) == snapshot.size
+          && snapshot_catalog::hash_file( final_path ) == snapshot.hash ) {
+         fc_ilog( logger, "snapshot of block ${n} already fetched", ("n", block_header::num_from_id( snapshot.block_id )) );
+         return final_path;
+      }
+
+      fc_ilog( logger, "fetching snapshot of block ${n}, ${s} bytes, from ${c} peers",
+               ("n", block_header::num_from_id( snapshot.block_id ))("s", snapshot.size)("c", best->second.size()) );
+      bfs::create_directories( dir );
+      const bfs::path temp_path = dir / ( ".incomplete-" + snapshot_catalog::file_name( snapshot.block_id ).string() );
+      {
+         std::ofstream create( temp_path.generic_string(), std::ios::out | std::ios::binary | std::ios::trunc );
+         EOS_ASSERT( create, snapshot_exception, "unable to create ${p}", ("p", temp_path.generic_string()) );
+      }
+      bfs::resize_file( temp_path, snapshot.size );
+
+      const auto start = fc::time_point::now();
+      for( uint64_t offset = 0; offset < snapshot.size; offset += max_snapshot_chunk_size ) pending_chunks.push_back( offset );
+      std::vector<std::thread> fetchers;
+      for( snapshot_peer* peer : best->second ) {
+         fetchers.emplace_back( [this, peer, &snapshot, &temp_path]() { fetch_chunks( *peer, snapshot, temp_path ); } );
+      }
+      for( auto& t : fetchers ) t.join();
+      links.clear();
+
+      if( !pending_chunks.empty() ) {
+         bfs::remove( temp_path );
+         EOS_THROW( snapshot_exception, "unable to fetch the snapshot of block ${n}, ${c} chunks missing",
+                    ("n", block_header::num_from_id( snapshot.block_id ))("c", pending_chunks.size()) );
+      }
+      if( snapshot_catalog::hash_file( temp_path ) != snapshot.hash ) {
+         bfs::remove( temp_path );
+         EOS_THROW( snapshot_exception, "fetched snapshot of block ${n} does not match its hash ${h}",
+                    ("n", block_header::num_from_id( snapshot.block_id ))("h", snapshot.hash) );
+      }
+      bfs::rename( temp_path, final_path );
+      fc_ilog( logger, "fetched snapshot ${p} in ${t} ms",
+               ("p", final_path.generic_string())("t", (fc::time_point::now() - start).count() / 1000) );
+      return final_path;
+   }
+
+   void snapshot_fetcher::fetch_chunks( snapshot_peer& peer, const snapshot_entry& snapshot, const bfs::path& p ) {
+      std::fstream out( p.generic_string(), std::ios::in | std::ios::out | std::ios::binary );
+      while( true ) {
+         std::unique_lock<std::mutex> g( mtx );
+         // a chunk in flight on another peer may come back if that peer fails
+         chunk_done.wait( g, [this]() { return !pending_chunks.empty() || chunks_in_flight == 0; } );
+         if( pending_chunks.empty() ) return;
+         const uint64_t offset = pending_chunks.front();
+         pending_chunks.pop_front();
+         ++chunks_in_flight;
+         g.unlock();
+
+         const uint32_t size = std::min<uint64_t>( max_snapshot_chunk_size, snapshot.size - offset );
+         try {
+            EOS_ASSERT( out, snapshot_exception, "unable to open ${p}", ("p", p.generic_string()) );
+            peer.send( get_snapshot_chunk_message{ snapshot.block_id, offset, size } );
+            const auto chunk = peer.receive<snapshot_chunk_message>();
+            EOS_ASSERT( chunk.block_id == snapshot.block_id && chunk.offset == offset && chunk.data.size() == size,
+                        snapshot_exception, "${p} sent an invalid chunk of the snapshot", ("p", peer.peer_address()) );
+            out.seekp( offset );
+            out.write( chunk.data.data(), chunk.data.size() );
+            EOS_ASSERT( out, snapshot_exception, "unable to write ${p}", ("p", p.generic_string()) );
+         } catch( const fc::exception& e ) {
+            fc_wlog( logger, "dropping ${p} from the snapshot fetch: ${e}", ("p", peer.peer_address())("e", e.to_string()) );
+            g.lock();
+            pending_chunks.push_back( offset );
+            --chunks_in_flight;
+            chunk_done.notify_all();
+            return;
+         }
+
+         g.lock();
+         --chunks_in_flight;
+         chunk_done.notify_all();
+      }
+   }
+
    net_plugin::net_plugin()
       :my( new net_plugin_impl ) {
       my_impl = my.get();
@@ -3281,6 +4870,33 @@ namespace eosio {
            "    p2p.blk.eos.io:9876:blk\n")
          ( "p2p-max-nodes-per-host", bpo::value<int>()->default_value(def_max_nodes_per_host), "Maximum number of client nodes from any single IP address")
          ( "p2p-accept-transactions", bpo::value<bool>()->default_value(true), "Allow transactions received over p2p network to be evaluated and relayed if valid.")
+         ( "p2p-compress-sync-blocks", bpo::value<bool>()->default_value(false),
+           "Compress blocks sent to syncing peers that support it, trading CPU for bandwidth.")
+         ( "p2p-compact-blocks", bpo::value<bool>()->default_value(false),
+           "Relay new blocks to peers that support it as their header and the short ids of their transactions, peers rebuild them from the transactions they already received and ask for the missing ones.")
+         ( "p2p-serve-snapshots", bpo::value<bool>()->default_value(false),
+           "Serve the snapshots in the snapshots-dir of the producer plugin to peers bootstrapping from a snapshot, requires the producer plugin.")
+         ( "p2p-snapshot-bootstrap", bpo::value<bool>()->default_value(false),
+           "When neither a state database nor a blocks.log exists, fetch the newest snapshot served by the p2p-peer-address peers into the snapshots directory of the data dir and start from it. "
+           "The genesis state of the chain is required to check the chain ID of the snapshot. Without p2p-snapshot-block-id or p2p-snapshot-hash, only a snapshot "
+           "served identically by p2p-snapshot-quorum peers is fetched.")
+         ( "p2p-snapshot-quorum", bpo::value<uint32_t>()->default_value(2),
+           "Number of p2p-peer-address peers that must serve a snapshot with the same block id and hash before p2p-snapshot-bootstrap fetches it.")
+         ( "p2p-snapshot-block-id", bpo::value<string>(),
+           "Block id of the snapshot p2p-snapshot-bootstrap fetches, a single peer serving it is enough.")
+         ( "p2p-snapshot-hash", bpo::value<string>(),
+           "SHA-256 hash of the snapshot file p2p-snapshot-bootstrap fetches, a single peer serving it is enough.")
+         ( "p2p-trx-lane-capacity", bpo::value<uint32_t>()->default_value(def_trx_lane_capacity),
+           "Transactions received from peers queued for the app thread at once, more are dropped.")
+         ( "p2p-trx-lane-weight", bpo::value<uint32_t>()->default_value(1),
+           "Queued transactions handed to the app thread in a row while other lanes, e.g. API requests, wait.")
+         ( "p2p-write-size-target-kb", bpo::value<uint32_t>()->default_value(def_write_size_target_kb),
+           "Queued messages to a peer are sent in socket writes of about this many KiB, 0 sends the whole queue in one write.")
+         ( "p2p-announce-transactions", bpo::value<bool>()->default_value(false),
+           "Send peers that support it batches of transaction ids instead of transactions, they request the ones they do not have.")
+         ( "p2p-early-block-relay", bpo::value<bool>()->default_value(false),
+           "Relay a block received from a peer once its header and producer signature are validated, before it is applied. Saves the execution time of the block on every hop, "
+           "a block failing to apply afterwards has been relayed already and is rejected by the peers applying it.")
          ( "agent-name", bpo::value<string>()->default_value("\"EOS Test Agent\""), "The name supplied to identify this node amongst the peers.")
          ( "allowed-connection", bpo::value<vector<string>>()->multitoken()->default_value({"any"}, "any"), "Can be 'any' or 'producers' or 'specified' or 'none'. If 'specified', peer-key must be specified at least once. If only 'producers', peer-key is not required. 'producers' and 'specified' may be combined.")
          ( "peer-key", bpo::value<vector<string>>()->composing()->multitoken(), "Optional public key of peer allowed to connect.  May be used multiple times.")
@@ -3292,6 +4908,9 @@ namespace eosio {
          ( "net-threads", bpo::value<uint16_t>()->default_value(my->thread_pool_size),
            "Number of worker threads in net_plugin thread pool" )
          ( "sync-fetch-span", bpo::value<uint32_t>()->default_value(def_sync_fetch_span), "number of blocks to retrieve in a chunk from any individual peer during synchronization")
+         ( "sync-peers", bpo::value<uint32_t>()->default_value(def_sync_peers),
+           "number of peers to retrieve chunks from at the same time while catching up to the last irreversible block, "
+           "1 retrieves one chunk at a time from a single peer")
          ( "use-socket-read-watermark", bpo::value<bool>()->default_value(false), "Enable experimental socket read watermark optimization")
          ( "peer-log-format", bpo::value<string>()->default_value( "[\"${_name}\" ${_ip}:${_port}]" ),
            "The string used to format peers when logging messages about them.  Variables are escaped with ${<variable name>}.\n"
@@ -3316,7 +4935,8 @@ namespace eosio {
       try {
          peer_log_format = options.at( "peer-log-format" ).as<string>();
 
-         my->sync_master.reset( new sync_manager( options.at( "sync-fetch-span" ).as<uint32_t>()));
+         my->sync_master.reset( new sync_manager( options.at( "sync-fetch-span" ).as<uint32_t>(),
+                                                  options.at( "sync-peers" ).as<uint32_t>() ) );
 
          my->connector_period = std::chrono::seconds( options.at( "connection-cleanup-period" ).as<int>());
          my->max_cleanup_time_ms = options.at("max-cleanup-time-msec").as<int>();
@@ -3325,6 +4945,19 @@ namespace eosio {
          my->max_client_count = options.at( "max-clients" ).as<int>();
          my->max_nodes_per_host = options.at( "p2p-max-nodes-per-host" ).as<int>();
          my->p2p_accept_transactions = options.at( "p2p-accept-transactions" ).as<bool>();
+         my->p2p_compress_sync_blocks = options.at( "p2p-compress-sync-blocks" ).as<bool>();
+         my->p2p_compact_blocks = options.at( "p2p-compact-blocks" ).as<bool>();
+         my->p2p_early_block_relay = options.at( "p2p-early-block-relay" ).as<bool>();
+         EOS_ASSERT( options.at( "p2p-trx-lane-capacity" ).as<uint32_t>() > 0, chain::plugin_config_exception,
+                     "p2p-trx-lane-capacity must be greater than 0" );
+         chain::post_lanes::instance().set_post_function( []( int priority, std::function<void()> f ) {
+            app().post( priority, std::move( f ) );
+         } );
+         my->trx_lane = chain::post_lanes::instance().add_lane( { "p2p_transactions", priority::low,
+                                                                  options.at( "p2p-trx-lane-weight" ).as<uint32_t>(),
+                                                                  options.at( "p2p-trx-lane-capacity" ).as<uint32_t>() } );
+         my->p2p_announce_transactions = options.at( "p2p-announce-transactions" ).as<bool>();
+         my->write_size_target = options.at( "p2p-write-size-target-kb" ).as<uint32_t>() * 1024;
 
          my->use_socket_read_watermark = options.at( "use-socket-read-watermark" ).as<bool>();
 
@@ -3391,6 +5024,31 @@ namespace eosio {
          EOS_ASSERT( my->chain_plug, chain::missing_chain_plugin_exception, ""  );
          my->chain_id = my->chain_plug->get_chain_id();
          fc::rand_pseudo_bytes( my->node_id.data(), my->node_id.data_size());
+
+         my->serve_snapshots = options.at( "p2p-serve-snapshots" ).as<bool>();
+         if( options.at( "p2p-snapshot-bootstrap" ).as<bool>() && my->chain_plug->fresh_state() ) {
+            EOS_ASSERT( !my->supplied_peers.empty(), chain::plugin_config_exception,
+                        "p2p-snapshot-bootstrap requires at least one p2p-peer-address" );
+            fc::optional<block_id_type> pinned_block_id;
+            fc::optional<fc::sha256> pinned_hash;
+            if( options.count( "p2p-snapshot-block-id" ) )
+               pinned_block_id = block_id_type( options.at( "p2p-snapshot-block-id" ).as<string>() );
+            if( options.count( "p2p-snapshot-hash" ) )
+               pinned_hash = fc::sha256( options.at( "p2p-snapshot-hash" ).as<string>() );
+            const uint32_t quorum = options.at( "p2p-snapshot-quorum" ).as<uint32_t>();
+            EOS_ASSERT( quorum > 0, chain::plugin_config_exception, "p2p-snapshot-quorum must be greater than 0" );
+            EOS_ASSERT( pinned_block_id || pinned_hash || quorum <= my->supplied_peers.size(), chain::plugin_config_exception,
+                        "p2p-snapshot-quorum ${q} is more than the ${c} p2p-peer-address peers, pin the snapshot with "
+                        "p2p-snapshot-block-id or p2p-snapshot-hash instead", ("q", quorum)("c", my->supplied_peers.size()) );
+            // before chain_plugin starts the chain, from the genesis state unless a snapshot is fetched
+            snapshot_fetcher fetcher( my->supplied_peers, app().data_dir() / "snapshots", quorum,
+                                      std::move( pinned_block_id ), std::move( pinned_hash ) );
+            if( auto p = fetcher.fetch() ) {
+               my->chain_plug->set_startup_snapshot( *p );
+            } else {
+               fc_wlog( logger, "No snapshot is served by ${q} peers, starting from the genesis state", ("q", quorum) );
+            }
+         }
          const controller& cc = my->chain_plug->chain();
 
          if( cc.get_read_mode() == db_read_mode::IRREVERSIBLE || cc.get_read_mode() == db_read_mode::READ_ONLY ) {
@@ -3415,6 +5073,14 @@ namespace eosio {
 
       my->producer_plug = app().find_plugin<producer_plugin>();
 
+      if( my->serve_snapshots ) {
+         EOS_ASSERT( my->producer_plug && my->producer_plug->get_state() != abstract_plugin::registered, plugin_config_exception,
+                     "p2p-serve-snapshots requires the producer plugin" );
+         my->snapshots.start( my->producer_plug->get_snapshots_dir() );
+         // queue the snapshots already there for hashing before a peer asks for them
+         my->snapshots.list( 0 );
+      }
+
       my->thread_pool.emplace( "net", my->thread_pool_size );
 
       my->dispatcher.reset( new dispatch_manager( my_impl->thread_pool->get_executor() ) );
@@ -3472,15 +5138,20 @@ namespace eosio {
       }
       {
          chain::controller& cc = my->chain_plug->chain();
-         cc.accepted_block.connect( [my = my]( const block_state_ptr& s ) {
+         cc.accepted_block.connect( chain::timed_slot( "accepted_block", "net_plugin", [my = my]( const block_state_ptr& s ) {
             my->on_accepted_block( s );
-         } );
-         cc.pre_accepted_block.connect( [my = my]( const signed_block_ptr& s ) {
+         } ) );
+         cc.pre_accepted_block.connect( chain::timed_slot( "pre_accepted_block", "net_plugin", [my = my]( const signed_block_ptr& s ) {
             my->on_pre_accepted_block( s );
-         } );
-         cc.irreversible_block.connect( [my = my]( const block_state_ptr& s ) {
+         } ) );
+         if( my->p2p_early_block_relay ) {
+            cc.accepted_block_header.connect( chain::timed_slot( "accepted_block_header", "net_plugin", [my = my]( const block_state_ptr& s ) {
+               my->on_accepted_block_header( s );
+            } ) );
+         }
+         cc.irreversible_block.connect( chain::timed_slot( "irreversible_block", "net_plugin", [my = my]( const block_state_ptr& s ) {
             my->on_irreversible_block( s );
-         } );
+         } ) );
       }
 
       {
@@ -3489,6 +5160,14 @@ namespace eosio {
       }
       my->ticker();
 
+      if( my->p2p_announce_transactions ) {
+         {
+            std::lock_guard<std::mutex> g( my->trx_announce_timer_mtx );
+            my->trx_announce_timer.reset( new boost::asio::steady_timer( my->thread_pool->get_executor() ) );
+         }
+         my->start_trx_announce_timer();
+      }
+
       my->incoming_transaction_ack_subscription = app().get_channel<compat::channels::transaction_ack>().subscribe(
             std::bind(&net_plugin_impl::transaction_ack, my.get(), std::placeholders::_1));
 
@@ -3527,6 +5206,10 @@ namespace eosio {
             std::lock_guard<std::mutex> g( my->keepalive_timer_mtx );
             if( my->keepalive_timer )
                my->keepalive_timer->cancel();
+         }{
+            std::lock_guard<std::mutex> g( my->trx_announce_timer_mtx );
+            if( my->trx_announce_timer )
+               my->trx_announce_timer->cancel();
          }
 
          {
@@ -3542,6 +5225,8 @@ namespace eosio {
          if( my->thread_pool ) {
             my->thread_pool->stop();
          }
+         my->snapshots.stop();
+         chain::post_lanes::instance().clear( my->trx_lane );
 
          if( my->acceptor ) {
             boost::system::error_code ec;
@@ -3593,6 +5278,19 @@ namespace eosio {
       return optional<connection_status>();
    }
 
+   net_metrics net_plugin::metrics()const {
+      net_metrics result;
+      {
+         std::shared_lock<std::shared_mutex> g( my->connections_mtx );
+         result.connections.reserve( my->connections.size() );
+         for( const auto& c : my->connections ) {
+            result.connections.push_back( c->get_metrics() );
+         }
+      }
+      my->dispatcher->fill_metrics( result );
+      return result;
+   }
+
    vector<connection_status> net_plugin::connections()const {
       vector<connection_status> result;
       std::shared_lock<std::shared_mutex> g( my->connections_mtx );
@@ -3611,6 +5309,10 @@ namespace eosio {
    }
 
    constexpr uint16_t net_plugin_impl::to_protocol_version(uint16_t v) {
+      if (v >= net_version_base + net_version_fork_offset) {
+         v -= net_version_base + net_version_fork_offset;
+         return (v > net_version_range) ? 0 : proto_fork_base + v;
+      }
       if (v >= net_version_base) {
          v -= net_version_base;
          return (v > net_version_range) ? 0 : v;
@@ -3618,4 +5320,11 @@ namespace eosio {
       return 0;
    }
 
+   constexpr uint16_t net_plugin_impl::to_network_version(uint16_t v) {
+      if (v >= proto_fork_base) {
+         return net_version_base + net_version_fork_offset + (v - proto_fork_base);
+      }
+      return net_version_base + v;
+   }
+
 }
@@ -124,6 +124,16 @@ void producer_api_plugin::plugin_startup() {
                                  producer_plugin::get_supported_protocol_features_params), 201),
        CALL(producer, producer, get_account_ram_corrections,
             INVOKE_R_R(producer, get_account_ram_corrections, producer_plugin::get_account_ram_corrections_params), 201),
+       CALL(producer, producer, get_perf_stats,
+            INVOKE_R_V(producer, get_perf_stats), 201),
+       CALL(producer, producer, get_signal_stats,
+            INVOKE_R_V(producer, get_signal_stats), 201),
+       CALL(producer, producer, get_lane_stats,
+            INVOKE_R_V(producer, get_lane_stats), 201),
+       CALL(producer, producer, set_trace_spans,
+            INVOKE_V_R(producer, set_trace_spans, producer_plugin::set_trace_spans_params), 201),
+       CALL(producer, producer, get_trace_spans,
+            INVOKE_R_R(producer, get_trace_spans, producer_plugin::get_trace_spans_params), 201),
    }, appbase::priority::medium_high);
 }
 
@@ -40,6 +40,7 @@ public:
    struct integrity_hash_information {
       chain::block_id_type head_block_id;
       chain::digest_type   integrity_hash;
+      uint32_t             version = 1;
    };
 
    struct snapshot_information {
@@ -68,6 +69,54 @@ public:
       optional<account_name>   more;
    };
 
+   struct perf_histogram {
+      uint64_t              samples = 0;
+      int64_t               total_us = 0;
+      int64_t               max_us = 0;
+      std::vector<uint64_t> buckets; ///< samples per perf_stats::bucket_upper_bounds_us, the last bucket is unbounded
+   };
+
+   struct contract_perf_stats {
+      account_name   contract;
+      perf_histogram action_elapsed;
+   };
+
+   struct perf_stats {
+      uint32_t                         sample_rate = 0; ///< one in sample_rate applied transactions is sampled, 0 when disabled
+      std::vector<int64_t>             bucket_upper_bounds_us;
+      perf_histogram                   transaction_elapsed;
+      std::vector<contract_perf_stats> contracts;    ///< elapsed time of the actions executed by each receiver
+   };
+
+   struct signal_slot_stats {
+      std::string    signal;
+      std::string    slot;    ///< "all" for the whole emit of the signal
+      perf_histogram elapsed;
+   };
+
+   struct signal_stats {
+      std::vector<int64_t>           bucket_upper_bounds_us;
+      std::vector<signal_slot_stats> slots;
+   };
+
+   struct lane_stats {
+      std::string name;
+      uint64_t    depth = 0;
+      uint64_t    max_depth = 0;
+      uint64_t    executed = 0;
+      uint64_t    rejected = 0;
+      int64_t     total_wait_us = 0;
+      int64_t     max_wait_us = 0;
+   };
+
+   struct set_trace_spans_params {
+      bool enabled = false;
+   };
+
+   struct get_trace_spans_params {
+      std::string format = "chrome"; ///< "chrome" for the Chrome trace event format or "otlp" for OTLP/JSON
+   };
+
    template<typename T>
    using next_function = std::function<void(const fc::static_variant<fc::exception_ptr, T>&)>;
 
@@ -102,6 +151,8 @@ public:
 
    integrity_hash_information get_integrity_hash() const;
    void create_snapshot(next_function<snapshot_information> next);
+   /// directory the snapshots are written to as snapshot-<block id>.bin, only after plugin_initialize()
+   fc::path get_snapshots_dir() const;
 
    scheduled_protocol_feature_activations get_scheduled_protocol_feature_activations() const;
    void schedule_protocol_feature_activations(const scheduled_protocol_feature_activations& schedule);
@@ -110,6 +161,17 @@ public:
 
    get_account_ram_corrections_result  get_account_ram_corrections( const get_account_ram_corrections_params& params ) const;
 
+   perf_stats get_perf_stats() const;
+
+   signal_stats get_signal_stats() const;
+
+   /// queues of the app thread work posted through eosio::chain::post_lanes
+   std::vector<lane_stats> get_lane_stats() const;
+
+   void set_trace_spans( const set_trace_spans_params& params );
+   /// drains the block life cycle spans recorded since the previous call
+   fc::variant get_trace_spans( const get_trace_spans_params& params ) const;
+
    void log_failed_transaction(const transaction_id_type& trx_id, const char* reason) const;
 
  private:
@@ -121,9 +183,17 @@ public:
 FC_REFLECT(eosio::producer_plugin::runtime_options, (max_transaction_time)(max_irreversible_block_age)(produce_time_offset_us)(last_block_time_offset_us)(max_scheduled_transaction_time_per_block_ms)(subjective_cpu_leeway_us)(incoming_defer_ratio)(greylist_limit));
 FC_REFLECT(eosio::producer_plugin::greylist_params, (accounts));
 FC_REFLECT(eosio::producer_plugin::whitelist_blacklist, (actor_whitelist)(actor_blacklist)(contract_whitelist)(contract_blacklist)(action_blacklist)(key_blacklist) )
-FC_REFLECT(eosio::producer_plugin::integrity_hash_information, (head_block_id)(integrity_hash))
+FC_REFLECT(eosio::producer_plugin::integrity_hash_information, (head_block_id)(integrity_hash)(version))
 FC_REFLECT(eosio::producer_plugin::snapshot_information, (head_block_id)(snapshot_name))
 FC_REFLECT(eosio::producer_plugin::scheduled_protocol_feature_activations, (protocol_features_to_activate))
 FC_REFLECT(eosio::producer_plugin::get_supported_protocol_features_params, (exclude_disabled)(exclude_unactivatable))
 FC_REFLECT(eosio::producer_plugin::get_account_ram_corrections_params, (lower_bound)(upper_bound)(limit)(reverse))
 FC_REFLECT(eosio::producer_plugin::get_account_ram_corrections_result, (rows)(more))
+FC_REFLECT(eosio::producer_plugin::perf_histogram, (samples)(total_us)(max_us)(buckets))
+FC_REFLECT(eosio::producer_plugin::contract_perf_stats, (contract)(action_elapsed))
+FC_REFLECT(eosio::producer_plugin::perf_stats, (sample_rate)(bucket_upper_bounds_us)(transaction_elapsed)(contracts))
+FC_REFLECT(eosio::producer_plugin::signal_slot_stats, (signal)(slot)(elapsed))
+FC_REFLECT(eosio::producer_plugin::signal_stats, (bucket_upper_bounds_us)(slots))
+FC_REFLECT(eosio::producer_plugin::lane_stats, (name)(depth)(max_depth)(executed)(rejected)(total_wait_us)(max_wait_us))
+FC_REFLECT(eosio::producer_plugin::set_trace_spans_params, (enabled))
+FC_REFLECT(eosio::producer_plugin::get_trace_spans_params, (format))
@@ -4,7 +4,10 @@
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/snapshot.hpp>
 #include <eosio/chain/transaction_object.hpp>
+#include <eosio/chain/signal_stats.hpp>
+#include <eosio/chain/post_lanes.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/trace_spans.hpp>
 #include <eosio/chain/unapplied_transaction_queue.hpp>
 
 #include <fc/io/json.hpp>
@@ -26,6 +29,13 @@
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/signals2/connection.hpp>
 
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstring>
+#include <cmath>
+#include <future>
+#include <thread>
+
 namespace bmi = boost::multi_index;
 using bmi::indexed_by;
 using bmi::ordered_non_unique;
@@ -87,6 +97,14 @@ namespace {
              (code == block_net_usage_exceeded::code_value) ||
              (code == deadline_exception::code_value && deadline_is_subjective);
    }
+
+   // failures which burned the transaction's full cpu allowance
+   bool exception_is_cpu_failure(const fc::exception& e) {
+      auto code = e.code();
+      return (code == deadline_exception::code_value) ||
+             (code == tx_cpu_usage_exceeded::code_value) ||
+             (code == leeway_deadline_exception::code_value);
+   }
 }
 
 struct transaction_id_with_expiry {
@@ -122,16 +140,41 @@ public:
       return block_header::num_from_id(block_id);
    }
 
-   static bfs::path get_final_path(const block_id_type& block_id, const bfs::path& snapshots_dir) {
-      return snapshots_dir / fc::format_string("snapshot-${id}.bin", fc::mutable_variant_object()("id", block_id));
+   /// a diff snapshot is named after its base too, so it is never taken for a full snapshot
+   static std::string get_suffix(const fc::optional<block_id_type>& diff_base) {
+      return diff_base ? "-diff-" + diff_base->str() + ".bin" : std::string(".bin");
+   }
+
+   static bfs::path get_final_path(const block_id_type& block_id, const bfs::path& snapshots_dir, const fc::optional<block_id_type>& diff_base) {
+      return snapshots_dir / ("snapshot-" + block_id.str() + get_suffix(diff_base));
+   }
+
+   static bfs::path get_pending_path(const block_id_type& block_id, const bfs::path& snapshots_dir, const fc::optional<block_id_type>& diff_base) {
+      return snapshots_dir / (".pending-snapshot-" + block_id.str() + get_suffix(diff_base));
+   }
+
+   static bfs::path get_temp_path(const block_id_type& block_id, const bfs::path& snapshots_dir, const fc::optional<block_id_type>& diff_base) {
+      return snapshots_dir / (".incomplete-snapshot-" + block_id.str() + get_suffix(diff_base));
+   }
+
+   /// the row index written next to a snapshot which may be the base of diff snapshots
+   static bfs::path get_row_index_path(const bfs::path& snapshot_path) {
+      return snapshot_path.generic_string() + ".index";
    }
 
-   static bfs::path get_pending_path(const block_id_type& block_id, const bfs::path& snapshots_dir) {
-      return snapshots_dir / fc::format_string(".pending-snapshot-${id}.bin", fc::mutable_variant_object()("id", block_id));
+   /// renames a snapshot along with its row index
+   static void rename(const bfs::path& from, const bfs::path& to, boost::system::error_code& ec) {
+      bfs::rename(from, to, ec);
+      boost::system::error_code index_ec;
+      if (!ec && bfs::exists(get_row_index_path(from), index_ec))
+         bfs::rename(get_row_index_path(from), get_row_index_path(to), ec);
    }
 
-   static bfs::path get_temp_path(const block_id_type& block_id, const bfs::path& snapshots_dir) {
-      return snapshots_dir / fc::format_string(".incomplete-snapshot-${id}.bin", fc::mutable_variant_object()("id", block_id));
+   /// removes a snapshot along with its row index
+   static void remove(const bfs::path& p, boost::system::error_code& ec) {
+      bfs::remove(p, ec);
+      boost::system::error_code index_ec;
+      bfs::remove(get_row_index_path(p), index_ec);
    }
 
    producer_plugin::snapshot_information finalize( const chain::controller& chain ) const {
@@ -139,13 +182,13 @@ public:
       boost::system::error_code ec;
 
       if (!in_chain) {
-         bfs::remove(bfs::path(pending_path), ec);
+         remove(bfs::path(pending_path), ec);
          EOS_THROW(snapshot_finalization_exception,
                    "Snapshotted block was forked out of the chain.  ID: ${block_id}",
                    ("block_id", block_id));
       }
 
-      bfs::rename(bfs::path(pending_path), bfs::path(final_path), ec);
+      rename(bfs::path(pending_path), bfs::path(final_path), ec);
       EOS_ASSERT(!ec, snapshot_finalization_exception,
                  "Unable to finalize valid snapshot of block number ${bn}: [code: ${ec}] ${message}",
                  ("bn", get_height())
@@ -212,11 +255,22 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
       fc::microseconds                                          _max_irreversible_block_age_us;
       int32_t                                                   _produce_time_offset_us = 0;
       int32_t                                                   _last_block_time_offset_us = 0;
+      // move the deadline of non last blocks later than _produce_time_offset_us when finalize and commit are fast
+      bool                                                      _adaptive_block_deadline = false;
+      int32_t                                                   _adaptive_block_deadline_margin_us = 0;
+      // time taken by finalize_block and commit_block of the produced blocks
+      int64_t                                                   _commit_latency_avg_us = 0;
+      int64_t                                                   _commit_latency_last_us = 0;
+      bool                                                      _commit_latency_measured = false;
       uint32_t                                                  _max_block_cpu_usage_threshold_us = 0;
       uint32_t                                                  _max_block_net_usage_threshold_bytes = 0;
       int32_t                                                   _max_scheduled_transaction_time_per_block_ms = 0;
+      uint32_t                                                  _max_scheduled_transactions_inspected_per_block = 0; ///< 0 for no limit
+      /// (delay_until, id) of the scheduled transaction the previous pass stopped at
+      fc::optional<std::pair<fc::time_point, generated_transaction_object::id_type>> _scheduled_trx_resume;
       fc::time_point                                            _irreversible_block_time;
       fc::microseconds                                          _keosd_provider_timeout_us;
+      std::mutex                                                _keosd_mtx; // the http client is not thread safe, the providers sign concurrently
 
       std::vector<chain::digest_type>                           _protocol_features_to_activate;
       bool                                                      _protocol_features_signaled = false; // to mark whether it has been signaled in start_block
@@ -230,6 +284,7 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
 
       incoming::methods::block_sync::method_type::handle        _incoming_block_sync_provider;
       incoming::methods::transaction_async::method_type::handle _incoming_transaction_async_provider;
+      incoming::methods::transaction_deadline::method_type::handle _incoming_transaction_deadline_provider;
 
       transaction_id_with_expiry_index                         _blacklisted_transactions;
       pending_snapshot_index                                   _pending_snapshot_index;
@@ -256,6 +311,36 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
       // path to write the snapshots to
       bfs::path _snapshots_dir;
 
+      // threads serializing the snapshot sections, 1 writes them on the calling thread
+      uint16_t _snapshot_threads = 1;
+      uint32_t _integrity_hash_version = 1;
+
+      // also write the row index of each snapshot, for it to be the base of diff snapshots
+      bool _snapshot_row_index = false;
+      // write diff snapshots against this snapshot, with its row index next to it
+      fc::optional<bfs::path> _snapshot_diff_base;
+      // head block of _snapshot_diff_base, the diffs are named after it
+      fc::optional<block_id_type> _snapshot_diff_base_id;
+
+      // write snapshots from a forked child, see write_snapshot_in_background
+      bool _background_snapshots = false;
+      // snapshots being written in the background by head block id, with the requests waiting for them
+      std::map<block_id_type, producer_plugin::next_function<producer_plugin::snapshot_information>> _background_snapshots_in_flight;
+
+      void write_snapshot_in_background( const bfs::path& p, std::function<void()> done,
+                                         producer_plugin::next_function<producer_plugin::snapshot_information> next );
+
+      // returns false if the snapshot file could not be written completely
+      bool write_snapshot_file( const bfs::path& p );
+
+      // create a snapshot every n blocks, 0 disables the schedule
+      uint32_t _snapshot_every_n_blocks = 0;
+      // number of most recent snapshots kept in the snapshots dir by the schedule, 0 keeps all of them
+      uint32_t _snapshot_retention = 0;
+
+      void schedule_snapshot( uint32_t block_num );
+      void prune_snapshots();
+
       void consider_new_watermark( account_name producer, uint32_t block_num, block_timestamp_type timestamp) {
          auto itr = _producer_watermarks.find( producer );
          if( itr != _producer_watermarks.end() ) {
@@ -276,6 +361,12 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
 
       void on_block( const block_state_ptr& bsp ) {
          _unapplied_transactions.clear_applied( bsp );
+
+         prune_subjective_failures();
+
+         if( _snapshot_every_n_blocks > 0 && bsp->block_num % _snapshot_every_n_blocks == 0 ) {
+            schedule_snapshot( bsp->block_num );
+         }
       }
 
       void on_block_header( const block_state_ptr& bsp ) {
@@ -413,10 +504,15 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
          return true;
       }
 
+      // FIFO per priority, transactions of a higher priority are popped first
       class incoming_transaction_queue {
+         using incoming_trx = std::tuple<transaction_metadata_ptr, bool, next_function<transaction_trace_ptr>>;
+
          uint64_t max_incoming_transaction_queue_size = 0;
          uint64_t size_in_bytes = 0;
-         std::deque<std::tuple<transaction_metadata_ptr, bool, next_function<transaction_trace_ptr>>> _incoming_transactions;
+         size_t   num_transactions = 0;
+         unapplied_transaction_queue::priority_func priority_of;
+         std::map<uint64_t, std::deque<incoming_trx>, std::greater<uint64_t>> _incoming_transactions;
 
       private:
          static uint64_t calc_size( const transaction_metadata_ptr& trx ) {
@@ -429,65 +525,238 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
             size_in_bytes += size;
          }
 
+         std::deque<incoming_trx>& queue_of( const transaction_metadata_ptr& trx ) {
+            return _incoming_transactions[priority_of ? priority_of( *trx ) : 0];
+         }
+
       public:
          void set_max_incoming_transaction_queue_size( uint64_t v ) { max_incoming_transaction_queue_size = v; }
+         void set_priority_function( unapplied_transaction_queue::priority_func f ) { priority_of = std::move( f ); }
 
          void add( const transaction_metadata_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next ) {
             add_size( trx );
-            _incoming_transactions.emplace_back( trx, persist_until_expired, std::move( next ) );
+            queue_of( trx ).emplace_back( trx, persist_until_expired, std::move( next ) );
+            ++num_transactions;
          }
 
          void add_front( const transaction_metadata_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next ) {
             add_size( trx );
-            _incoming_transactions.emplace_front( trx, persist_until_expired, std::move( next ) );
+            queue_of( trx ).emplace_front( trx, persist_until_expired, std::move( next ) );
+            ++num_transactions;
          }
 
          auto pop_front() {
             EOS_ASSERT( !_incoming_transactions.empty(), producer_exception, "logic error, front() called on empty incoming_transactions" );
-            auto intrx = _incoming_transactions.front();
-            _incoming_transactions.pop_front();
+            auto highest = _incoming_transactions.begin();
+            auto intrx = std::move( highest->second.front() );
+            highest->second.pop_front();
+            if( highest->second.empty() ) _incoming_transactions.erase( highest );
+            --num_transactions;
             const transaction_metadata_ptr& trx = std::get<0>( intrx );
             size_in_bytes -= calc_size( trx );
             return intrx;
          }
 
          bool empty()const { return _incoming_transactions.empty(); }
-         size_t size()const { return _incoming_transactions.size(); }
+         size_t size()const { return num_transactions; }
       };
 
       incoming_transaction_queue _pending_incoming_transactions;
 
+      // priorities of transaction-priority accounts, a transaction gets the highest one of its authorizers
+      std::map<account_name, uint64_t> _priority_accounts;
+
+      uint64_t transaction_priority( const transaction_metadata& trx ) const {
+         uint64_t priority = 0;
+         for( const auto& act : trx.packed_trx()->get_transaction().actions ) {
+            for( const auto& auth : act.authorization ) {
+               auto itr = _priority_accounts.find( auth.actor );
+               if( itr != _priority_accounts.end() ) priority = std::max( priority, itr->second );
+            }
+         }
+         return priority;
+      }
+
+      // decaying count of recent cpu failures of the transactions of an account, see record_subjective_failure
+      struct subjective_failures {
+         double         score = 0;
+         fc::time_point last_update;
+      };
+      std::map<account_name, subjective_failures> _subjective_failures;
+      // score at which incoming transactions of an account are rejected, 0 disables the tracking
+      uint32_t         _subjective_failure_threshold = 0;
+      fc::microseconds _subjective_failure_window = fc::seconds( 60 );
+
+      // failures are charged to the first authorizer, who pays for the cpu
+      static account_name first_authorizer( const transaction_metadata& trx ) {
+         for( const auto& act : trx.packed_trx()->get_transaction().actions ) {
+            if( !act.authorization.empty() ) return act.authorization.front().actor;
+         }
+         return {};
+      }
+
+      double decay( subjective_failures& f, const fc::time_point& now ) const {
+         f.score *= std::exp( -double( (now - f.last_update).count() ) / _subjective_failure_window.count() );
+         f.last_update = now;
+         return f.score;
+      }
+
+      void record_subjective_failure( const transaction_metadata& trx ) {
+         if( _subjective_failure_threshold == 0 ) return;
+         auto& f = _subjective_failures[first_authorizer( trx )];
+         decay( f, fc::time_point::now() );
+         f.score += 1;
+      }
+
+      bool is_subjectively_failing( const transaction_metadata& trx ) {
+         if( _subjective_failure_threshold == 0 || _subjective_failures.empty() ) return false;
+         auto itr = _subjective_failures.find( first_authorizer( trx ) );
+         if( itr == _subjective_failures.end() ) return false;
+         return decay( itr->second, fc::time_point::now() ) >= _subjective_failure_threshold;
+      }
+
+      // drop the accounts whose failures decayed away
+      void prune_subjective_failures() {
+         const auto now = fc::time_point::now();
+         for( auto itr = _subjective_failures.begin(); itr != _subjective_failures.end(); ) {
+            if( decay( itr->second, now ) < 0.5 ) {
+               itr = _subjective_failures.erase( itr );
+            } else {
+               ++itr;
+            }
+         }
+      }
+
+      // execution time histograms of one in _perf_sample_rate applied transactions, 0 disables the sampling
+      uint32_t                                                _perf_sample_rate = 0;
+      uint64_t                                                _perf_applied_count = 0;
+      producer_plugin::perf_histogram                         _perf_trx_elapsed;
+      std::map<account_name, producer_plugin::perf_histogram> _perf_contract_elapsed;
+      fc::optional<scoped_connection>                         _applied_transaction_connection;
+
+      static const std::vector<int64_t>& perf_bucket_bounds_us() {
+         static const std::vector<int64_t> bounds{ 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000 };
+         return bounds;
+      }
+
+      static void add_perf_sample( producer_plugin::perf_histogram& h, int64_t us ) {
+         const auto& bounds = perf_bucket_bounds_us();
+         if( h.buckets.empty() ) h.buckets.resize( bounds.size() + 1 );
+         ++h.buckets[std::lower_bound( bounds.begin(), bounds.end(), us ) - bounds.begin()];
+         ++h.samples;
+         h.total_us += us;
+         h.max_us = std::max( h.max_us, us );
+      }
+
+      void on_applied_transaction( const transaction_trace_ptr& trace ) {
+         if( _perf_applied_count++ % _perf_sample_rate != 0 ) return;
+         add_perf_sample( _perf_trx_elapsed, trace->elapsed.count() );
+         for( const auto& at : trace->action_traces ) {
+            add_perf_sample( _perf_contract_elapsed[at.receiver], at.elapsed.count() );
+         }
+      }
+
+      // copy of the controller's white/blacklists, read by the thread pool
+      std::shared_ptr<const producer_plugin::whitelist_blacklist> _prevalidation_lists;
+
+      // Checks of a transaction which need no chain state, run on the thread pool while its keys are recovered.
+      // The white/blacklists are only passed when producing, the only time the controller enforces them.
+      static fc::exception_ptr prevalidate_transaction( const packed_transaction& ptrx,
+                                                        const std::shared_ptr<const producer_plugin::whitelist_blacklist>& lists ) {
+         try {
+            const auto& trx = ptrx.get_transaction();
+            EOS_ASSERT( !trx.actions.empty(), tx_no_action, "transaction must have at least one action" );
+
+            // the pending block time is only known on the main thread, allow one block interval of difference
+            const auto now = fc::time_point::now();
+            EOS_ASSERT( fc::time_point( trx.expiration ) + fc::milliseconds( config::block_interval_ms ) >= now, expired_tx_exception,
+                        "expired transaction ${id}, expiration ${e}, now ${now}", ("id", ptrx.id())("e", trx.expiration)("now", now) );
+
+            flat_set<account_name> actors;
+            for( const auto& act : trx.actions ) {
+               for( const auto& auth : act.authorization ) {
+                  actors.insert( auth.actor );
+               }
+            }
+            EOS_ASSERT( !actors.empty(), tx_no_auths, "transaction must have at least one authorization" );
+
+            if( !lists ) return {};
+            for( const auto& actor : actors ) {
+               if( !lists->actor_whitelist->empty() ) {
+                  EOS_ASSERT( lists->actor_whitelist->count( actor ), actor_whitelist_exception,
+                              "authorizing actor '${a}' in transaction is not on the actor whitelist", ("a", actor) );
+               } else {
+                  EOS_ASSERT( !lists->actor_blacklist->count( actor ), actor_blacklist_exception,
+                              "authorizing actor '${a}' in transaction is on the actor blacklist", ("a", actor) );
+               }
+            }
+            for( const auto& act : trx.actions ) {
+               if( !lists->contract_whitelist->empty() ) {
+                  EOS_ASSERT( lists->contract_whitelist->count( act.account ), contract_whitelist_exception,
+                              "account '${code}' is not on the contract whitelist", ("code", act.account) );
+               } else {
+                  EOS_ASSERT( !lists->contract_blacklist->count( act.account ), contract_blacklist_exception,
+                              "account '${code}' is on the contract blacklist", ("code", act.account) );
+               }
+               EOS_ASSERT( !lists->action_blacklist->count( std::make_pair( act.account, act.name ) ), action_blacklist_exception,
+                           "action '${code}::${action}' is on the action blacklist", ("code", act.account)("action", act.name) );
+            }
+         } catch( const fc::exception& e ) {
+            return e.dynamic_copy_exception();
+         }
+         return {};
+      }
+
       void on_incoming_transaction_async(const packed_transaction_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next) {
          chain::controller& chain = chain_plug->chain();
          const auto max_trx_time_ms = _max_transaction_time_ms.load();
          fc::microseconds max_trx_cpu_usage = max_trx_time_ms < 0 ? fc::microseconds::maximum() : fc::milliseconds( max_trx_time_ms );
 
-         auto future = transaction_metadata::start_recover_keys( trx, _thread_pool->get_executor(),
-                chain.get_chain_id(), fc::microseconds( max_trx_cpu_usage ), chain.configured_subjective_signature_length_limit() );
-
          auto trx_id = trx->id();
-         boost::asio::post(_thread_pool->get_executor(), [self = this, future{std::move(future)}, persist_until_expired,
-                                                          next{std::move(next)}, trx_id]() mutable {
-            if( future.valid() ) {
-               future.wait();
-               app().post( priority::low, [self, future{std::move(future)}, persist_until_expired, next{std::move( next )}, trx_id]() mutable {
-                  auto exception_handler = [&next, trx_id](fc::exception_ptr ex) {
-                     fc_dlog(_trx_successful_trace_log, "[TRX_TRACE] Speculative execution is REJECTING tx: ${txid} : ${why} ",
-                            ("txid", trx_id)("why",ex->what()));
-                     fc_dlog(_trx_failed_trace_log, "[TRX_TRACE] Speculative execution is REJECTING tx: ${txid} : ${why} ",
-                            ("txid", trx_id)("why",ex->what()));
-                     next(ex);
-                  };
-                  try {
-                     auto result = future.get();
-                     if( !self->process_incoming_transaction_async( result, persist_until_expired, next ) ) {
-                        if( self->_pending_block_mode == pending_block_mode::producing ) {
-                           self->schedule_maybe_produce_block( true );
-                        }
-                     }
-                  } CATCH_AND_CALL(exception_handler);
+         auto exception_handler = [trx_id](next_function<transaction_trace_ptr>& next, fc::exception_ptr ex) {
+            fc_dlog(_trx_successful_trace_log, "[TRX_TRACE] Speculative execution is REJECTING tx: ${txid} : ${why} ",
+                   ("txid", trx_id)("why",ex->what()));
+            fc_dlog(_trx_failed_trace_log, "[TRX_TRACE] Speculative execution is REJECTING tx: ${txid} : ${why} ",
+                   ("txid", trx_id)("why",ex->what()));
+            next(ex);
+         };
+
+         // a cheap lookup, before spending the thread pool on recovering its keys
+         if( chain.is_known_unexpired_transaction( trx_id ) ) {
+            exception_handler( next, std::static_pointer_cast<fc::exception>( std::make_shared<tx_duplicate>(
+                  FC_LOG_MESSAGE( error, "duplicate transaction ${id}", ("id", trx_id) ) ) ) );
+            return;
+         }
+
+         auto lists = _pending_block_mode == pending_block_mode::producing ? _prevalidation_lists : nullptr;
+         boost::asio::post(_thread_pool->get_executor(), [self = this, trx, lists{std::move(lists)}, chain_id = chain.get_chain_id(),
+                                                          time_limit = fc::microseconds( max_trx_cpu_usage ),
+                                                          sig_limit = chain.configured_subjective_signature_length_limit(),
+                                                          persist_until_expired, next{std::move(next)}, exception_handler]() mutable {
+            auto rejected = prevalidate_transaction( *trx, lists );
+            if( rejected ) {
+               app().post( priority::low, [rejected{std::move(rejected)}, next{std::move( next )}, exception_handler]() mutable {
+                  exception_handler( next, rejected );
                } );
+               return;
             }
+            // keys are recovered on this task, a prevalidation reject never pays for them and no task waits on another
+            std::packaged_task<transaction_metadata_ptr()> recover( [&trx, &chain_id, time_limit, sig_limit]() {
+               return transaction_metadata::recover_keys( trx, chain_id, time_limit, sig_limit );
+            } );
+            auto future = recover.get_future();
+            recover();
+            app().post( priority::low, [self, future{std::move(future)}, persist_until_expired, next{std::move( next )}, exception_handler]() mutable {
+               auto reject = [&next, &exception_handler](fc::exception_ptr ex) { exception_handler( next, ex ); };
+               try {
+                  auto result = future.get();
+                  if( !self->process_incoming_transaction_async( result, persist_until_expired, next ) ) {
+                     if( self->_pending_block_mode == pending_block_mode::producing ) {
+                        self->schedule_maybe_produce_block( true );
+                     }
+                  }
+               } CATCH_AND_CALL(reject);
+            } );
          });
       }
 
@@ -550,19 +819,20 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
                return true;
             }
 
+            if( is_subjectively_failing( *trx ) ) {
+               send_response( std::static_pointer_cast<fc::exception>( std::make_shared<tx_resource_exhaustion>(
+                     FC_LOG_MESSAGE( error, "recent transactions of ${a} keep exceeding their cpu time, transaction ${id} rejected",
+                                     ("a", first_authorizer( *trx ))("id", id)))) );
+               return true;
+            }
+
             if( !chain.is_building_block()) {
                _pending_incoming_transactions.add( trx, persist_until_expired, next );
                return true;
             }
 
-            auto deadline = fc::time_point::now() + fc::milliseconds( _max_transaction_time_ms );
             bool deadline_is_subjective = false;
-            const auto block_deadline = calculate_block_deadline( chain.pending_block_time() );
-            if( _max_transaction_time_ms < 0 ||
-                (_pending_block_mode == pending_block_mode::producing && block_deadline < deadline)) {
-               deadline_is_subjective = true;
-               deadline = block_deadline;
-            }
+            const auto deadline = incoming_transaction_deadline( deadline_is_subjective );
 
             auto trace = chain.push_transaction( trx, deadline, trx->billed_cpu_time_us, false );
             if( trace->except ) {
@@ -580,6 +850,8 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
                   if( !exhausted )
                      exhausted = block_is_exhausted();
                } else {
+                  if( exception_is_cpu_failure( *trace->except ) )
+                     record_subjective_failure( *trx );
                   auto e_ptr = trace->except->dynamic_copy_exception();
                   send_response( e_ptr );
                }
@@ -638,6 +910,19 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
 
       fc::time_point calculate_pending_block_time() const;
       fc::time_point calculate_block_deadline( const fc::time_point& ) const;
+
+      /// deadline of an incoming transaction executed now in the pending block, subjective when it is the block's
+      fc::time_point incoming_transaction_deadline( bool& deadline_is_subjective ) const {
+         auto deadline = fc::time_point::now() + fc::milliseconds( _max_transaction_time_ms );
+         deadline_is_subjective = false;
+         const auto block_deadline = calculate_block_deadline( chain_plug->chain().pending_block_time() );
+         if( _max_transaction_time_ms < 0 ||
+             (_pending_block_mode == pending_block_mode::producing && block_deadline < deadline)) {
+            deadline_is_subjective = true;
+            deadline = block_deadline;
+         }
+         return deadline;
+      }
       void schedule_delayed_production_loop(const std::weak_ptr<producer_plugin_impl>& weak_this, optional<fc::time_point> wake_up_time);
       optional<fc::time_point> calculate_producer_wake_up_time( const block_timestamp_type& ref_block_time ) const;
 
@@ -705,12 +990,27 @@ void producer_plugin::set_program_options(
           "Limits the maximum time (in milliseconds) that is allowed for sending blocks to a keosd provider for signing")
          ("greylist-account", boost::program_options::value<vector<string>>()->composing()->multitoken(),
           "account that can not access to extended CPU/NET virtual resources")
+         ("subjective-failure-threshold", boost::program_options::value<uint32_t>()->default_value(0),
+          "reject incoming transactions of an account once this many of its recent transactions failed by exceeding their cpu time, "
+          "failures are charged to the first authorizer and decay over subjective-failure-window-ms. 0 disables the tracking")
+         ("subjective-failure-window-ms", boost::program_options::value<uint32_t>()->default_value(60000),
+          "time constant (in milliseconds) of the exponential decay of subjective cpu failures")
+         ("perf-stats-sample-rate", boost::program_options::value<uint32_t>()->default_value(0),
+          "sample the execution time of one in this many applied transactions for producer/get_perf_stats, 0 disables the sampling")
+         ("transaction-priority", boost::program_options::value<vector<string>>()->composing()->multitoken(),
+          "<account>=<priority> transactions authorized by account are applied before those of lower priority (may specify multiple times), "
+          "transactions of unlisted accounts have priority 0")
          ("greylist-limit", boost::program_options::value<uint32_t>()->default_value(1000),
           "Limit (between 1 and 1000) on the multiple that CPU/NET virtual resources can extend during low usage (only enforced subjectively; use 1000 to not enforce any limit)")
          ("produce-time-offset-us", boost::program_options::value<int32_t>()->default_value(0),
           "Offset of non last block producing time in microseconds. Valid range 0 .. -block_time_interval.")
          ("last-block-time-offset-us", boost::program_options::value<int32_t>()->default_value(-200000),
           "Offset of last block producing time in microseconds. Valid range 0 .. -block_time_interval.")
+         ("adaptive-block-deadline", bpo::bool_switch()->default_value(false),
+          "Stop applying transactions to non last blocks just early enough to finalize and commit them, based on the measured time of the previous blocks. "
+          "The deadline is never earlier than the one given by produce-time-offset-us and cpu-effort-percent")
+         ("adaptive-block-deadline-margin-us", bpo::value<int32_t>()->default_value(10000),
+          "Time in microseconds reserved besides the measured finalize and commit time when adaptive-block-deadline is enabled")
          ("cpu-effort-percent", bpo::value<uint32_t>()->default_value(config::default_block_cpu_effort_pct / config::percent_1),
           "Percentage of cpu block production time used to produce block. Whole number percentages, e.g. 80 for 80%")
          ("last-block-cpu-effort-percent", bpo::value<uint32_t>()->default_value(config::default_block_cpu_effort_pct / config::percent_1),
@@ -721,6 +1021,8 @@ void producer_plugin::set_program_options(
           "Threshold of NET block production to consider block full; when within threshold of max-block-net-usage block can be produced immediately")
          ("max-scheduled-transaction-time-per-block-ms", boost::program_options::value<int32_t>()->default_value(100),
           "Maximum wall-clock time, in milliseconds, spent retiring scheduled transactions in any block before returning to normal transaction processing.")
+         ("max-scheduled-transactions-inspected-per-block", bpo::value<uint32_t>()->default_value(5000),
+          "Maximum number of due scheduled transactions looked at in any block, the next block continues after the last one looked at. 0 for no limit.")
          ("subjective-cpu-leeway-us", boost::program_options::value<int32_t>()->default_value( config::default_subjective_cpu_leeway_us ),
           "Time in microseconds allowed for a transaction that starts with insufficient CPU quota to complete and cover its CPU usage.")
          ("incoming-defer-ratio", bpo::value<double>()->default_value(1.0),
@@ -731,6 +1033,26 @@ void producer_plugin::set_program_options(
           "Number of worker threads in producer thread pool")
          ("snapshots-dir", bpo::value<bfs::path>()->default_value("snapshots"),
           "the location of the snapshots directory (absolute path or relative to application data dir)")
+         ("snapshot-threads", bpo::value<uint16_t>()->default_value(1),
+          "Number of threads serializing snapshot sections concurrently, 1 serializes them on the main thread. "
+          "Diff snapshots and snapshots with a row index are always written on the main thread, it can't be combined "
+          "with snapshot-diff-base or snapshot-row-index")
+         ("integrity-hash-version", bpo::value<uint32_t>()->default_value(1),
+          "Integrity hash returned by get_integrity_hash: 1 hashes all rows in order on the main thread, "
+          "2 hashes a tree of row chunks on snapshot-threads threads. The two versions are not comparable.")
+         ("snapshot-every-n-blocks", bpo::value<uint32_t>()->default_value(0),
+          "create a snapshot whenever the number of an applied block is a multiple of this value, 0 disables scheduled snapshots")
+         ("snapshot-retention", bpo::value<uint32_t>()->default_value(0),
+          "number of most recent snapshots kept in snapshots-dir after a scheduled snapshot completes, 0 keeps all of them")
+         ("snapshot-row-index", bpo::bool_switch()->default_value(false),
+          "write the row index of each snapshot next to it as <snapshot>.index, needed for the snapshot to be the base of diff snapshots")
+         ("snapshot-diff-base", bpo::value<bfs::path>(),
+          "write snapshots as diff snapshots storing only the rows which are not in this snapshot, whose row index has to be next to it. "
+          "Diff snapshots are named snapshot-<block id>-diff-<base block id>.bin, are not served to peers and the base is never pruned. "
+          "A diff snapshot is loaded with its base through --snapshot-base")
+         ("background-snapshots", bpo::bool_switch()->default_value(false),
+          "write snapshots from a forked process, block production and API service continue meanwhile. "
+          "Requires database-map-mode heap or locked, where the forked process keeps a copy-on-write view of the state")
          ;
    config_file_options.add(producer_options);
 }
@@ -792,6 +1114,7 @@ make_keosd_signature_provider(const std::shared_ptr<producer_plugin_impl>& impl,
       if (impl) {
          fc::variant params;
          fc::to_variant(std::make_pair(digest, pubkey), params);
+         std::lock_guard<std::mutex> g(impl->_keosd_mtx);
          auto deadline = impl->_keosd_provider_timeout_us.count() >= 0 ? fc::time_point::now() + impl->_keosd_provider_timeout_us : fc::time_point::maximum();
          return app().get_plugin<http_client_plugin>().get_client().post_sync(keosd_url, params, deadline).as<chain::signature_type>();
       } else {
@@ -885,6 +1208,11 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
    my->_produce_time_offset_us = std::min( my->_produce_time_offset_us, cpu_effort_offset_us );
    my->_last_block_time_offset_us = std::min( my->_last_block_time_offset_us, last_block_cpu_effort_offset_us );
 
+   my->_adaptive_block_deadline = options.at( "adaptive-block-deadline" ).as<bool>();
+   my->_adaptive_block_deadline_margin_us = options.at( "adaptive-block-deadline-margin-us" ).as<int32_t>();
+   EOS_ASSERT( my->_adaptive_block_deadline_margin_us >= 0 && my->_adaptive_block_deadline_margin_us <= config::block_interval_us, plugin_config_exception,
+               "adaptive-block-deadline-margin-us ${m} must be 0 .. ${bi}", ("bi", config::block_interval_us)("m", my->_adaptive_block_deadline_margin_us) );
+
    my->_max_block_cpu_usage_threshold_us = options.at( "max-block-cpu-usage-threshold-us" ).as<uint32_t>();
    EOS_ASSERT( my->_max_block_cpu_usage_threshold_us < config::block_interval_us, plugin_config_exception,
                "max-block-cpu-usage-threshold-us ${t} must be 0 .. ${bi}", ("bi", config::block_interval_us)("t", my->_max_block_cpu_usage_threshold_us) );
@@ -892,6 +1220,7 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
    my->_max_block_net_usage_threshold_bytes = options.at( "max-block-net-usage-threshold-bytes" ).as<uint32_t>();
 
    my->_max_scheduled_transaction_time_per_block_ms = options.at("max-scheduled-transaction-time-per-block-ms").as<int32_t>();
+   my->_max_scheduled_transactions_inspected_per_block = options.at("max-scheduled-transactions-inspected-per-block").as<uint32_t>();
 
    if( options.at( "subjective-cpu-leeway-us" ).as<int32_t>() != config::default_subjective_cpu_leeway_us ) {
       chain.set_subjective_cpu_leeway( fc::microseconds( options.at( "subjective-cpu-leeway-us" ).as<int32_t>() ) );
@@ -930,6 +1259,44 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
                   "No such directory '${dir}'", ("dir", my->_snapshots_dir.generic_string()) );
    }
 
+   my->_snapshot_threads = options.at( "snapshot-threads" ).as<uint16_t>();
+   EOS_ASSERT( my->_snapshot_threads > 0, plugin_config_exception,
+               "snapshot-threads ${num} must be greater than 0", ("num", my->_snapshot_threads));
+
+   my->_integrity_hash_version = options.at( "integrity-hash-version" ).as<uint32_t>();
+   EOS_ASSERT( my->_integrity_hash_version == 1 || my->_integrity_hash_version == tree_integrity_hash_snapshot_writer::version,
+               plugin_config_exception, "integrity-hash-version ${v} must be 1 or 2", ("v", my->_integrity_hash_version));
+
+   my->_snapshot_every_n_blocks = options.at( "snapshot-every-n-blocks" ).as<uint32_t>();
+   my->_snapshot_retention = options.at( "snapshot-retention" ).as<uint32_t>();
+
+   my->_snapshot_row_index = options.at( "snapshot-row-index" ).as<bool>();
+   // the row index is written in the same pass as the snapshot, from the row bytes the main thread writes
+   EOS_ASSERT( !my->_snapshot_row_index || my->_snapshot_threads == 1, plugin_config_exception,
+               "snapshot-threads ${num} can't be combined with snapshot-row-index, snapshots with a row index are written on the main thread",
+               ("num", my->_snapshot_threads) );
+   if( options.count( "snapshot-diff-base" )) {
+      my->_snapshot_diff_base = options.at( "snapshot-diff-base" ).as<bfs::path>();
+      EOS_ASSERT( fc::is_regular_file( *my->_snapshot_diff_base ) &&
+                  fc::is_regular_file( pending_snapshot::get_row_index_path( *my->_snapshot_diff_base ) ),
+                  plugin_config_exception, "snapshot-diff-base ${p} does not exist or has no row index next to it",
+                  ("p", my->_snapshot_diff_base->generic_string()) );
+      // a diff can't be the base of another diff, its rows are not laid out as the row index says
+      EOS_ASSERT( !my->_snapshot_row_index, plugin_config_exception, "snapshot-row-index can't be combined with snapshot-diff-base" );
+      EOS_ASSERT( my->_snapshot_threads == 1, plugin_config_exception,
+                  "snapshot-threads ${num} can't be combined with snapshot-diff-base, diff snapshots are written on the main thread",
+                  ("num", my->_snapshot_threads) );
+      auto index_in = std::ifstream( pending_snapshot::get_row_index_path( *my->_snapshot_diff_base ).generic_string(), (std::ios::in | std::ios::binary) );
+      my->_snapshot_diff_base_id = snapshot_row_index_writer::read_block_id( index_in );
+   }
+
+   my->_background_snapshots = options.at( "background-snapshots" ).as<bool>();
+   if( my->_background_snapshots ) {
+      // a mapped database is shared with the forked process, which would see the blocks applied meanwhile
+      EOS_ASSERT( options.at( "database-map-mode" ).as<chainbase::pinnable_mapped_file::map_mode>() != chainbase::pinnable_mapped_file::map_mode::mapped,
+                  plugin_config_exception, "background-snapshots requires database-map-mode heap or locked" );
+   }
+
    my->_incoming_block_subscription = app().get_channel<incoming::channels::block>().subscribe(
          [this](const signed_block_ptr& block) {
       try {
@@ -954,6 +1321,32 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
       return my->on_incoming_transaction_async(trx, persist_until_expired, next );
    });
 
+   my->_incoming_transaction_deadline_provider = app().get_method<incoming::methods::transaction_deadline>().register_provider(
+         [this]() -> fc::time_point {
+      bool deadline_is_subjective = false;
+      return my->incoming_transaction_deadline( deadline_is_subjective );
+   });
+
+   my->_subjective_failure_threshold = options.at( "subjective-failure-threshold" ).as<uint32_t>();
+   my->_subjective_failure_window = fc::milliseconds( options.at( "subjective-failure-window-ms" ).as<uint32_t>() );
+   EOS_ASSERT( my->_subjective_failure_window.count() > 0, plugin_config_exception,
+               "subjective-failure-window-ms must be greater than 0" );
+
+   my->_perf_sample_rate = options.at( "perf-stats-sample-rate" ).as<uint32_t>();
+
+   if( options.count("transaction-priority") ) {
+      for( const auto& spec : options["transaction-priority"].as<std::vector<std::string>>() ) {
+         auto delim = spec.find("=");
+         EOS_ASSERT( delim != std::string::npos, plugin_config_exception, "Missing \"=\" in transaction-priority ${s}", ("s", spec) );
+         my->_priority_accounts[account_name( spec.substr( 0, delim ) )] = std::stoull( spec.substr( delim + 1 ) );
+      }
+   }
+   if( !my->_priority_accounts.empty() ) {
+      auto priority_of = [my = my.get()]( const transaction_metadata& trx ) { return my->transaction_priority( trx ); };
+      my->_unapplied_transactions.set_priority_function( priority_of );
+      my->_pending_incoming_transactions.set_priority_function( priority_of );
+   }
+
    if (options.count("greylist-account")) {
       std::vector<std::string> greylist = options["greylist-account"].as<std::vector<std::string>>();
       greylist_params param;
@@ -987,9 +1380,19 @@ void producer_plugin::plugin_startup()
    EOS_ASSERT( my->_producers.empty() || my->chain_plug->accept_transactions(), plugin_config_exception,
               "node cannot have any producer-name configured because no block production is possible with no [api|p2p]-accepted-transactions" );
 
-   my->_accepted_block_connection.emplace(chain.accepted_block.connect( [this]( const auto& bsp ){ my->on_block( bsp ); } ));
-   my->_accepted_block_header_connection.emplace(chain.accepted_block_header.connect( [this]( const auto& bsp ){ my->on_block_header( bsp ); } ));
-   my->_irreversible_block_connection.emplace(chain.irreversible_block.connect( [this]( const auto& bsp ){ my->on_irreversible_block( bsp->block ); } ));
+   my->_prevalidation_lists = std::make_shared<const whitelist_blacklist>( get_whitelist_blacklist() );
+
+   if( my->_perf_sample_rate > 0 ) {
+      my->_applied_transaction_connection.emplace(chain.applied_transaction.connect(
+            [this]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> t ){ my->on_applied_transaction( std::get<0>(t) ); } ));
+   }
+
+   my->_accepted_block_connection.emplace(chain.accepted_block.connect( chain::timed_slot( "accepted_block", "producer_plugin",
+         [this]( const block_state_ptr& bsp ){ my->on_block( bsp ); } ) ));
+   my->_accepted_block_header_connection.emplace(chain.accepted_block_header.connect( chain::timed_slot( "accepted_block_header", "producer_plugin",
+         [this]( const block_state_ptr& bsp ){ my->on_block_header( bsp ); } ) ));
+   my->_irreversible_block_connection.emplace(chain.irreversible_block.connect( chain::timed_slot( "irreversible_block", "producer_plugin",
+         [this]( const block_state_ptr& bsp ){ my->on_irreversible_block( bsp->block ); } ) ));
 
    const auto lib_num = chain.last_irreversible_block_num();
    const auto lib = chain.fetch_block_by_number(lib_num);
@@ -1166,6 +1569,7 @@ void producer_plugin::set_whitelist_blacklist(const producer_plugin::whitelist_b
    if(params.contract_blacklist.valid()) chain.set_contract_blacklist(*params.contract_blacklist);
    if(params.action_blacklist.valid()) chain.set_action_blacklist(*params.action_blacklist);
    if(params.key_blacklist.valid()) chain.set_key_blacklist(*params.key_blacklist);
+   my->_prevalidation_lists = std::make_shared<const whitelist_blacklist>( get_whitelist_blacklist() );
 }
 
 producer_plugin::integrity_hash_information producer_plugin::get_integrity_hash() const {
@@ -1182,15 +1586,22 @@ producer_plugin::integrity_hash_information producer_plugin::get_integrity_hash(
       reschedule.cancel();
    }
 
-   return {chain.head_block_id(), chain.calculate_integrity_hash()};
+   if( my->_integrity_hash_version == tree_integrity_hash_snapshot_writer::version ) {
+      return {chain.head_block_id(), chain.calculate_tree_integrity_hash( my->_snapshot_threads ), my->_integrity_hash_version};
+   }
+   return {chain.head_block_id(), chain.calculate_integrity_hash(), my->_integrity_hash_version};
+}
+
+fc::path producer_plugin::get_snapshots_dir() const {
+   return my->_snapshots_dir;
 }
 
 void producer_plugin::create_snapshot(producer_plugin::next_function<producer_plugin::snapshot_information> next) {
    chain::controller& chain = my->chain_plug->chain();
 
    auto head_id = chain.head_block_id();
-   const auto& snapshot_path = pending_snapshot::get_final_path(head_id, my->_snapshots_dir);
-   const auto& temp_path     = pending_snapshot::get_temp_path(head_id, my->_snapshots_dir);
+   const auto& snapshot_path = pending_snapshot::get_final_path(head_id, my->_snapshots_dir, my->_snapshot_diff_base_id);
+   const auto& temp_path     = pending_snapshot::get_temp_path(head_id, my->_snapshots_dir, my->_snapshot_diff_base_id);
 
    // maintain legacy exception if the snapshot exists
    if( fc::is_regular_file(snapshot_path) ) {
@@ -1199,7 +1610,8 @@ void producer_plugin::create_snapshot(producer_plugin::next_function<producer_pl
       return;
    }
 
-   auto write_snapshot = [&]( const bfs::path& p ) -> void {
+   // calls done once the snapshot is written to p, right away unless it is written in the background
+   auto write_snapshot = [&]( const bfs::path& p, std::function<void()> done ) -> void {
       auto reschedule = fc::make_scoped_exit([this](){
          my->schedule_production_loop();
       });
@@ -1213,29 +1625,55 @@ void producer_plugin::create_snapshot(producer_plugin::next_function<producer_pl
 
       bfs::create_directory( p.parent_path() );
 
+      if( my->_background_snapshots ) {
+         auto in_flight = my->_background_snapshots_in_flight.find( head_id );
+         if( in_flight != my->_background_snapshots_in_flight.end() ) {
+            // attach this request to the snapshot already being written at this block
+            in_flight->second = [prev = in_flight->second, next](const fc::static_variant<fc::exception_ptr, producer_plugin::snapshot_information>& res){
+               prev(res);
+               next(res);
+            };
+            return;
+         }
+         my->_background_snapshots_in_flight.emplace( head_id, next );
+         my->write_snapshot_in_background( p, std::move( done ), [this, head_id]( const auto& res ) {
+            auto in_flight = my->_background_snapshots_in_flight.find( head_id );
+            if( in_flight == my->_background_snapshots_in_flight.end() ) return;
+            auto n = std::move( in_flight->second );
+            my->_background_snapshots_in_flight.erase( in_flight );
+            n( res );
+         } );
+         return;
+      }
+
       // create the snapshot
-      auto snap_out = std::ofstream(p.generic_string(), (std::ios::out | std::ios::binary));
-      auto writer = std::make_shared<ostream_snapshot_writer>(snap_out);
-      chain.write_snapshot(writer);
-      writer->finalize();
-      snap_out.flush();
-      snap_out.close();
+      my->write_snapshot_file( p );
+      done();
    };
 
    // If in irreversible mode, create snapshot and return path to snapshot immediately.
    if( chain.get_read_mode() == db_read_mode::IRREVERSIBLE ) {
       try {
-         write_snapshot( temp_path );
-
-         boost::system::error_code ec;
-         bfs::rename(temp_path, snapshot_path, ec);
-         EOS_ASSERT(!ec, snapshot_finalization_exception,
-               "Unable to finalize valid snapshot of block number ${bn}: [code: ${ec}] ${message}",
-               ("bn", chain.head_block_num())
-               ("ec", ec.value())
-               ("message", ec.message()));
-
-         next( producer_plugin::snapshot_information{head_id, snapshot_path.generic_string()} );
+         write_snapshot( temp_path, [this, head_id, temp_path, snapshot_path]() {
+            // called on the main thread, when in the background the requests wait in _background_snapshots_in_flight
+            boost::system::error_code ec;
+            pending_snapshot::rename(temp_path, snapshot_path, ec);
+            EOS_ASSERT(!ec, snapshot_finalization_exception,
+                  "Unable to finalize valid snapshot of block number ${bn}: [code: ${ec}] ${message}",
+                  ("bn", block_header::num_from_id(head_id))
+                  ("ec", ec.value())
+                  ("message", ec.message()));
+
+            auto in_flight = my->_background_snapshots_in_flight.find( head_id );
+            if( in_flight != my->_background_snapshots_in_flight.end() ) {
+               auto n = std::move( in_flight->second );
+               my->_background_snapshots_in_flight.erase( in_flight );
+               n( producer_plugin::snapshot_information{head_id, snapshot_path.generic_string()} );
+            }
+         } );
+         if( !my->_background_snapshots ) {
+            next( producer_plugin::snapshot_information{head_id, snapshot_path.generic_string()} );
+         }
       } CATCH_AND_CALL (next);
       return;
    }
@@ -1254,24 +1692,149 @@ void producer_plugin::create_snapshot(producer_plugin::next_function<producer_pl
          };
       });
    } else {
-      const auto& pending_path = pending_snapshot::get_pending_path(head_id, my->_snapshots_dir);
+      const auto& pending_path = pending_snapshot::get_pending_path(head_id, my->_snapshots_dir, my->_snapshot_diff_base_id);
 
       try {
-         write_snapshot( temp_path ); // create a new pending snapshot
+         // create a new pending snapshot
+         write_snapshot( temp_path, [this, head_id, temp_path, pending_path, snapshot_path, next]() {
+            boost::system::error_code ec;
+            pending_snapshot::rename(temp_path, pending_path, ec);
+            EOS_ASSERT(!ec, snapshot_finalization_exception,
+                  "Unable to promote temp snapshot to pending for block number ${bn}: [code: ${ec}] ${message}",
+                  ("bn", block_header::num_from_id(head_id))
+                  ("ec", ec.value())
+                  ("message", ec.message()));
+
+            auto n = next;
+            auto in_flight = my->_background_snapshots_in_flight.find( head_id );
+            if( in_flight != my->_background_snapshots_in_flight.end() ) {
+               // the requests that arrived while it was written in the background
+               n = std::move( in_flight->second );
+               my->_background_snapshots_in_flight.erase( in_flight );
+            }
+            my->_pending_snapshot_index.emplace(head_id, n, pending_path.generic_string(), snapshot_path.generic_string());
+         } );
+      } CATCH_AND_CALL (next);
+   }
+}
 
-         boost::system::error_code ec;
-         bfs::rename(temp_path, pending_path, ec);
-         EOS_ASSERT(!ec, snapshot_finalization_exception,
-               "Unable to promote temp snapshot to pending for block number ${bn}: [code: ${ec}] ${message}",
-               ("bn", chain.head_block_num())
-               ("ec", ec.value())
-               ("message", ec.message()));
+bool producer_plugin_impl::write_snapshot_file( const bfs::path& p ) {
+   chain::controller& chain = chain_plug->chain();
+   auto snap_out = std::ofstream(p.generic_string(), (std::ios::out | std::ios::binary));
+   if( _snapshot_diff_base ) {
+      auto base_in = std::ifstream(_snapshot_diff_base->generic_string(), (std::ios::in | std::ios::binary));
+      auto base_index_in = std::ifstream(pending_snapshot::get_row_index_path(*_snapshot_diff_base).generic_string(), (std::ios::in | std::ios::binary));
+      auto writer = std::make_shared<diff_ostream_snapshot_writer>(snap_out, base_in, base_index_in, chain.head_block_id());
+      chain.write_snapshot(writer);
+      writer->finalize();
+   } else if( _snapshot_row_index ) {
+      auto index_out = std::ofstream(pending_snapshot::get_row_index_path(p).generic_string(), (std::ios::out | std::ios::binary));
+      auto writer = std::make_shared<indexed_ostream_snapshot_writer>(snap_out, index_out, chain.head_block_id());
+      chain.write_snapshot(writer);
+      writer->finalize();
+      index_out.flush();
+      index_out.close();
+      if( !index_out ) return false;
+   } else if( _snapshot_threads > 1 ) {
+      auto writer = std::make_shared<threaded_ostream_snapshot_writer>(snap_out, _snapshot_threads);
+      chain.write_snapshot(writer);
+      writer->finalize();
+   } else {
+      auto writer = std::make_shared<ostream_snapshot_writer>(snap_out);
+      chain.write_snapshot(writer);
+      writer->finalize();
+   }
+   snap_out.flush();
+   snap_out.close();
+   return static_cast<bool>(snap_out);
+}
 
-         my->_pending_snapshot_index.emplace(head_id, next, pending_path.generic_string(), snapshot_path.generic_string());
-      } CATCH_AND_CALL (next);
+// Called from accepted_block, the snapshot is taken once the block is committed. By then a later block may
+// already be applied, the snapshot is taken at the head block then.
+void producer_plugin_impl::schedule_snapshot( uint32_t block_num ) {
+   app().post( priority::low, [self = this, block_num]() {
+      try {
+         app().get_plugin<producer_plugin>().create_snapshot( [self, block_num]( const auto& res ) {
+            if( res.template contains<fc::exception_ptr>() ) {
+               elog( "scheduled snapshot for block ${bn} failed: ${e}",
+                     ("bn", block_num)("e", res.template get<fc::exception_ptr>()->to_detail_string()) );
+               return;
+            }
+            const auto& info = res.template get<producer_plugin::snapshot_information>();
+            ilog( "scheduled snapshot ${p} created", ("p", info.snapshot_name) );
+            self->prune_snapshots();
+         } );
+      } FC_LOG_AND_DROP();
+   } );
+}
+
+// removes the oldest snapshots named by pending_snapshot::get_final_path beyond _snapshot_retention, full snapshots
+// and diffs alike, except the base of the diffs
+void producer_plugin_impl::prune_snapshots() {
+   if( _snapshot_retention == 0 ) return;
+
+   static const std::string prefix = "snapshot-";
+   static const std::string diff_infix = "-diff-";
+   static const std::string suffix = ".bin";
+   std::vector<std::pair<uint32_t, bfs::path>> snapshots;
+   boost::system::error_code ec;
+   for( bfs::directory_iterator itr( _snapshots_dir, ec ), end; !ec && itr != end; itr.increment( ec ) ) {
+      const auto name = itr->path().filename().generic_string();
+      const bool full = name.size() == prefix.size() + 64 + suffix.size();
+      const bool diff = name.size() == prefix.size() + 64 + diff_infix.size() + 64 + suffix.size() &&
+                        name.compare( prefix.size() + 64, diff_infix.size(), diff_infix ) == 0;
+      if( !(full || diff) || name.compare( 0, prefix.size(), prefix ) != 0 ||
+          name.compare( name.size() - suffix.size(), suffix.size(), suffix ) != 0 || !bfs::is_regular_file( itr->path() ) )
+         continue;
+      boost::system::error_code eq_ec;
+      if( _snapshot_diff_base && bfs::equivalent( itr->path(), *_snapshot_diff_base, eq_ec ) )
+         continue;
+      try {
+         const block_id_type id( name.substr( prefix.size(), 64 ) );
+         snapshots.emplace_back( block_header::num_from_id( id ), itr->path() );
+      } FC_LOG_AND_DROP();
+   }
+   if( snapshots.size() <= _snapshot_retention ) return;
+
+   std::sort( snapshots.begin(), snapshots.end() );
+   for( size_t i = 0; i < snapshots.size() - _snapshot_retention; ++i ) {
+      pending_snapshot::remove( snapshots[i].second, ec );
+      if( ec ) {
+         wlog( "unable to remove snapshot ${p}: ${m}", ("p", snapshots[i].second.generic_string())("m", ec.message()) );
+      } else {
+         ilog( "removed snapshot ${p}", ("p", snapshots[i].second.generic_string()) );
+      }
    }
 }
 
+// The forked child only has the calling thread, it writes the snapshot and exits without running any destructors.
+// A thread of the parent waits for it and posts the result to the main thread.
+void producer_plugin_impl::write_snapshot_in_background( const bfs::path& p, std::function<void()> done,
+                                                         producer_plugin::next_function<producer_plugin::snapshot_information> next ) {
+   const pid_t pid = fork();
+   EOS_ASSERT( pid >= 0, snapshot_finalization_exception, "Unable to fork for background snapshot: ${e}", ("e", strerror(errno)) );
+   if( pid == 0 ) {
+      int status = 1;
+      try {
+         if( write_snapshot_file( p ) ) status = 0;
+      } catch( ... ) {}
+      _exit( status );
+   }
+
+   ilog( "writing snapshot ${p} in background process ${pid}", ("p", p.generic_string())("pid", pid) );
+   std::thread( [pid, p, done{std::move(done)}, next{std::move(next)}]() mutable {
+      int status = 0;
+      while( waitpid( pid, &status, 0 ) < 0 && errno == EINTR ) {}
+      const bool ok = WIFEXITED( status ) && WEXITSTATUS( status ) == 0;
+      app().post( priority::medium, [ok, p, done{std::move(done)}, next{std::move(next)}]() {
+         try {
+            EOS_ASSERT( ok, snapshot_finalization_exception, "Background snapshot ${p} failed", ("p", p.generic_string()) );
+            done();
+         } CATCH_AND_CALL( next );
+      } );
+   } ).detach();
+}
+
 producer_plugin::scheduled_protocol_feature_activations
 producer_plugin::get_scheduled_protocol_feature_activations()const {
    return {my->_protocol_features_to_activate};
@@ -1380,7 +1943,7 @@ producer_plugin::get_account_ram_corrections( const get_account_ram_corrections_
 optional<fc::time_point> producer_plugin_impl::calculate_next_block_time(const account_name& producer_name, const block_timestamp_type& current_block_time) const {
    chain::controller& chain = chain_plug->chain();
    const auto& hbs = chain.head_block_state();
-   const auto& active_schedule = hbs->active_schedule.producers;
+   const auto& active_schedule = hbs->active_schedule->producers;
 
    // determine if this producer is in the active schedule and if so, where
    auto itr = std::find_if(active_schedule.begin(), active_schedule.end(), [&](const auto& asp){ return asp.producer_name == producer_name; });
@@ -1448,7 +2011,15 @@ fc::time_point producer_plugin_impl::calculate_pending_block_time() const {
 
 fc::time_point producer_plugin_impl::calculate_block_deadline( const fc::time_point& block_time ) const {
    bool last_block = ((block_timestamp_type(block_time).slot % config::producer_repetitions) == config::producer_repetitions - 1);
-   return block_time + fc::microseconds(last_block ? _last_block_time_offset_us : _produce_time_offset_us);
+   if( last_block ) return block_time + fc::microseconds(_last_block_time_offset_us);
+
+   int64_t offset_us = _produce_time_offset_us;
+   if( _adaptive_block_deadline && _commit_latency_measured ) {
+      // the last sample reacts to a sudden slow down the average would hide
+      const int64_t latency_us = std::max( _commit_latency_avg_us, _commit_latency_last_us );
+      offset_us = std::max( offset_us, std::min<int64_t>( 0, -(latency_us + _adaptive_block_deadline_margin_us) ) );
+   }
+   return block_time + fc::microseconds(offset_us);
 }
 
 producer_plugin_impl::start_block_result producer_plugin_impl::start_block() {
@@ -1739,6 +2310,10 @@ bool producer_plugin_impl::remove_expired_blacklisted_trxs( const fc::time_point
    return !exhausted;
 }
 
+// Every aborted or persisted transaction is executed again in full. Its result can't be reused even when the new head
+// block touched none of its tables: each execution reads the global action sequence, the account sequences, the
+// resource limits and the block time, all of which change with the head, and chainbase keeps no replayable form of a
+// transaction's writes, only its undo state.
 bool producer_plugin_impl::process_unapplied_trxs( const fc::time_point& deadline )
 {
    bool exhausted = false;
@@ -1802,6 +2377,7 @@ void producer_plugin_impl::process_scheduled_and_incoming_trxs( const fc::time_p
    int num_applied = 0;
    int num_failed = 0;
    int num_processed = 0;
+   uint32_t num_inspected = 0;
    bool exhausted = false;
    double incoming_trx_weight = 0.0;
 
@@ -1810,13 +2386,37 @@ void producer_plugin_impl::process_scheduled_and_incoming_trxs( const fc::time_p
    time_point pending_block_time = chain.pending_block_time();
    const auto& sch_idx = chain.db().get_index<generated_transaction_multi_index,by_delay>();
    const auto scheduled_trxs_size = sch_idx.size();
-   auto sch_itr = sch_idx.begin();
-   while( sch_itr != sch_idx.end() ) {
-      if( sch_itr->delay_until > pending_block_time) break;    // not scheduled yet
+
+   // by_delay yields the due transactions first. A pass that stopped early resumes in the next block where it
+   // stopped and wraps around to the earlier due ones, so a backlog of due transactions that are skipped or keep
+   // failing is not looked at again every block before the ones after it get their turn.
+   const auto resume = _scheduled_trx_resume;
+   _scheduled_trx_resume.reset();
+   auto sch_itr = resume ? sch_idx.lower_bound( boost::make_tuple( resume->first, resume->second ) ) : sch_idx.begin();
+   bool wrapped = !resume;
+   const auto stop_at = [&]( decltype(sch_itr) itr ) {
+      _scheduled_trx_resume.emplace( itr->delay_until, itr->id );
+   };
+   while( true ) {
+      if( sch_itr == sch_idx.end() || sch_itr->delay_until > pending_block_time ) { // not scheduled yet
+         if( wrapped ) break;
+         wrapped = true;
+         sch_itr = sch_idx.begin();
+         continue;
+      }
+      if( wrapped && resume && std::tie( sch_itr->delay_until, sch_itr->id ) >= std::tie( resume->first, resume->second ) ) {
+         break; // back where the pass started
+      }
       if( exhausted || deadline <= fc::time_point::now() ) {
          exhausted = true;
+         stop_at( sch_itr );
          break;
       }
+      if( _max_scheduled_transactions_inspected_per_block && num_inspected >= _max_scheduled_transactions_inspected_per_block ) {
+         stop_at( sch_itr );
+         break;
+      }
+      ++num_inspected;
       if( sch_itr->published >= pending_block_time ) {
          ++sch_itr;
          continue; // do not allow schedule and execute in same block
@@ -1829,6 +2429,8 @@ void producer_plugin_impl::process_scheduled_and_incoming_trxs( const fc::time_p
 
       const transaction_id_type trx_id = sch_itr->trx_id; // make copy since reference could be invalidated
       const auto sch_expiration = sch_itr->expiration;
+      const auto delay_until = sch_itr->delay_until;
+      const auto id = sch_itr->id;
       auto sch_itr_next = sch_itr; // save off next since sch_itr may be invalidated by loop
       ++sch_itr_next;
       const auto next_delay_until = sch_itr_next != sch_idx.end() ? sch_itr_next->delay_until : sch_itr->delay_until;
@@ -1854,6 +2456,7 @@ void producer_plugin_impl::process_scheduled_and_incoming_trxs( const fc::time_p
 
       if (exhausted || deadline <= fc::time_point::now()) {
          exhausted = true;
+         _scheduled_trx_resume.emplace( delay_until, id );
          break;
       }
 
@@ -1870,6 +2473,7 @@ void producer_plugin_impl::process_scheduled_and_incoming_trxs( const fc::time_p
             if (exception_is_exhausted(*trace->except, deadline_is_subjective)) {
                if( block_is_exhausted() ) {
                   exhausted = true;
+                  _scheduled_trx_resume.emplace( delay_until, id );
                   break;
                }
             } else {
@@ -1885,14 +2489,13 @@ void producer_plugin_impl::process_scheduled_and_incoming_trxs( const fc::time_p
       incoming_trx_weight += _incoming_defer_ratio;
       if (!pending_incoming_process_limit) incoming_trx_weight = 0.0;
 
-      if( sch_itr_next == sch_idx.end() ) break;
-      sch_itr = sch_idx.lower_bound( boost::make_tuple( next_delay_until, next_id ) );
+      sch_itr = sch_itr_next == sch_idx.end() ? sch_idx.end() : sch_idx.lower_bound( boost::make_tuple( next_delay_until, next_id ) );
    }
 
    if( scheduled_trxs_size > 0 ) {
       fc_dlog( _log,
-               "Processed ${m} of ${n} scheduled transactions, Applied ${applied}, Failed/Dropped ${failed}",
-               ( "m", num_processed )( "n", scheduled_trxs_size )( "applied", num_applied )( "failed", num_failed ) );
+               "Processed ${m} of ${n} scheduled transactions, Inspected ${i}, Applied ${applied}, Failed/Dropped ${failed}",
+               ( "m", num_processed )( "n", scheduled_trxs_size )( "i", num_inspected )( "applied", num_applied )( "failed", num_failed ) );
    }
 }
 
@@ -2112,22 +2715,42 @@ void producer_plugin_impl::produce_block() {
    }
 
    //idump( (fc::time_point::now() - chain.pending_block_time()) );
+   const fc::time_point block_time = chain.pending_block_time();
+   const fc::time_point finalize_start = fc::time_point::now();
    chain.finalize_block( [&]( const digest_type& d ) {
       auto debug_logger = maybe_make_debug_time_logger();
       vector<signature_type> sigs;
       sigs.reserve(relevant_providers.size());
 
-      // sign with all relevant public keys
-      for (const auto& p : relevant_providers) {
-         sigs.emplace_back(p.get()(d));
+      // sign with all relevant public keys, the round trips of remote providers overlap instead of adding up
+      vector<std::future<signature_type>> pending_sigs;
+      pending_sigs.reserve(relevant_providers.size() - 1);
+      for (size_t i = 1; i < relevant_providers.size(); ++i) {
+         pending_sigs.emplace_back( async_thread_pool( _thread_pool->get_executor(), [&p = relevant_providers[i].get(), d]() {
+            return p(d);
+         } ) );
+      }
+      sigs.emplace_back(relevant_providers.front().get()(d));
+      for (auto& f : pending_sigs) {
+         sigs.emplace_back(f.get());
       }
       return sigs;
    } );
 
    chain.commit_block();
 
+   _commit_latency_last_us = (fc::time_point::now() - finalize_start).count();
+   _commit_latency_avg_us = _commit_latency_measured ? (_commit_latency_avg_us * 7 + _commit_latency_last_us) / 8 : _commit_latency_last_us;
+   _commit_latency_measured = true;
+
    block_state_ptr new_bs = chain.head_block_state();
 
+   const fc::time_point window_start = block_time - fc::microseconds(config::block_interval_us);
+   fc_dlog(_log, "Block #${n} applied transactions for ${u}% of its window, deadline offset ${o}us, finalize and commit took ${c}us (average ${a}us)",
+           ("n", new_bs->block_num)("u", (finalize_start - window_start).count() * 100 / config::block_interval_us)
+           ("o", (calculate_block_deadline(block_time) - block_time).count())
+           ("c", _commit_latency_last_us)("a", _commit_latency_avg_us));
+
    ilog("Produced block ${id}... #${n} @ ${t} signed by ${p} [trxs: ${count}, lib: ${lib}, confirmed: ${confs}]",
         ("p",new_bs->header.producer)("id",new_bs->id.str().substr(8,16))
         ("n",new_bs->block_num)("t",new_bs->header.timestamp)
@@ -2135,6 +2758,47 @@ void producer_plugin_impl::produce_block() {
 
 }
 
+producer_plugin::perf_stats producer_plugin::get_perf_stats() const {
+   perf_stats result;
+   result.sample_rate = my->_perf_sample_rate;
+   result.bucket_upper_bounds_us = my->perf_bucket_bounds_us();
+   result.transaction_elapsed = my->_perf_trx_elapsed;
+   result.contracts.reserve( my->_perf_contract_elapsed.size() );
+   for( const auto& c : my->_perf_contract_elapsed ) {
+      result.contracts.push_back( { c.first, c.second } );
+   }
+   return result;
+}
+
+producer_plugin::signal_stats producer_plugin::get_signal_stats() const {
+   signal_stats result;
+   result.bucket_upper_bounds_us = chain::signal_stats::bucket_upper_bounds_us();
+   for( auto& s : chain::signal_stats::get() ) {
+      result.slots.push_back( { std::move( s.signal ), std::move( s.slot ),
+                                { s.elapsed.calls, s.elapsed.total_us, s.elapsed.max_us, std::move( s.elapsed.buckets ) } } );
+   }
+   return result;
+}
+
+std::vector<producer_plugin::lane_stats> producer_plugin::get_lane_stats() const {
+   std::vector<lane_stats> result;
+   for( auto& l : chain::post_lanes::instance().get_stats() ) {
+      result.push_back( { std::move( l.name ), l.depth, l.max_depth, l.executed, l.rejected, l.total_wait_us, l.max_wait_us } );
+   }
+   return result;
+}
+
+void producer_plugin::set_trace_spans( const set_trace_spans_params& params ) {
+   chain::span_tracer::set_enabled( params.enabled );
+}
+
+fc::variant producer_plugin::get_trace_spans( const get_trace_spans_params& params ) const {
+   EOS_ASSERT( params.format == "chrome" || params.format == "otlp", chain::invalid_http_request,
+               "unknown trace format ${f}, expected chrome or otlp", ("f", params.format) );
+   auto spans = chain::span_tracer::drain();
+   return params.format == "otlp" ? chain::span_tracer::to_otlp( spans ) : chain::span_tracer::to_chrome_trace( spans );
+}
+
 void producer_plugin::log_failed_transaction(const transaction_id_type& trx_id, const char* reason) const {
    fc_dlog(_trx_failed_trace_log, "[TRX_TRACE] Speculative execution is REJECTING tx: ${txid} : ${why}",
            ("trxid", trx_id)("reason", reason));
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <eosio/chain/block_state.hpp>
+#include <eosio/chain/controller.hpp>
+#include <eosio/state_history_plugin/state_history_plugin.hpp>
+
+namespace eosio {
+
+/*
+ * Writes the table deltas of a block, as state_history_plugin serializes them, to the chain state of a node following
+ * a trusted one, instead of executing the block. Rows are matched by their natural key, e.g. the owner and name of a
+ * permission, since the ids of the trusted node are not part of the deltas.
+ *
+ * State the deltas do not carry is kept as close as it can be: the row count of a contract table follows its rows,
+ * a generated transaction is scheduled from the block time and its delay, a new permission gets its usage object.
+ * The action sequences of accounts, the preactivated protocol features and the dynamic global properties are not
+ * followed, the node can serve reads but can not produce or validate blocks from the resulting state.
+ */
+void apply_state_history_deltas(chain::controller& chain, const chain::block_state& block,
+                                const std::vector<table_delta>& deltas);
+
+} // namespace eosio
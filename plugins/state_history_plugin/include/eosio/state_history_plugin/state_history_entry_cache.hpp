@@ -0,0 +1,64 @@
+#pragma once
+
+#include <eosio/chain/types.hpp>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace eosio {
+
+/*
+ * Bounded LRU cache of decompressed state history entries shared by the sessions, consumers catching up over the same
+ * range decompress each entry once. An entry is only returned for the block id it was stored with, so the entry of a
+ * block replaced by a fork is never handed out. Thread safe.
+ */
+class state_history_entry_cache {
+ public:
+   using entry_ptr = std::shared_ptr<const chain::bytes>;
+
+   explicit state_history_entry_cache(size_t max_size)
+       : max_size(max_size) {}
+
+   entry_ptr get(uint32_t block_num, const chain::block_id_type& block_id) {
+      std::lock_guard<std::mutex> g(mtx);
+      auto                        it = by_block_num.find(block_num);
+      if (it == by_block_num.end() || it->second->block_id != block_id)
+         return {};
+      lru.splice(lru.begin(), lru, it->second);
+      return it->second->data;
+   }
+
+   void put(uint32_t block_num, const chain::block_id_type& block_id, entry_ptr data) {
+      if (!max_size)
+         return;
+      std::lock_guard<std::mutex> g(mtx);
+      auto                        it = by_block_num.find(block_num);
+      if (it != by_block_num.end()) {
+         lru.erase(it->second);
+         by_block_num.erase(it);
+      }
+      lru.push_front(entry{block_num, block_id, std::move(data)});
+      by_block_num.emplace(block_num, lru.begin());
+      if (lru.size() > max_size) {
+         by_block_num.erase(lru.back().block_num);
+         lru.pop_back();
+      }
+   }
+
+ private:
+   struct entry {
+      uint32_t             block_num;
+      chain::block_id_type block_id;
+      entry_ptr            data;
+   };
+   using lru_list = std::list<entry>;
+
+   const size_t                                     max_size;
+   std::mutex                                       mtx;
+   lru_list                                         lru; // most recently used first
+   std::unordered_map<uint32_t, lru_list::iterator> by_block_num;
+};
+
+} // namespace eosio
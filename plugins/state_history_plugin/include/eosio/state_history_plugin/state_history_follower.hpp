@@ -0,0 +1,73 @@
+#pragma once
+
+#include <eosio/chain/thread_utils.hpp>
+#include <eosio/state_history_plugin/state_history_plugin.hpp>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/signals2/connection.hpp>
+
+#include <atomic>
+#include <map>
+#include <memory>
+
+namespace eosio {
+
+/*
+ * Follows the chain of a trusted node through its state history endpoint instead of executing the blocks: the blocks
+ * are requested with their table deltas, handed to the chain like blocks received from a peer, and the chain has
+ * them applied by apply_state_history_deltas, see controller::set_block_deltas_applier. Headers and producer
+ * signatures are validated as for any block, forks are switched like for any block, the deltas of a block being kept
+ * until it is irreversible. A failed connection is reopened after retry_delay, resuming from the head block.
+ *
+ * The socket is only used on the follower thread, the chain only on the main thread.
+ */
+class state_history_follower : public std::enable_shared_from_this<state_history_follower> {
+ public:
+   static constexpr uint32_t max_messages_in_flight = 8;
+   static constexpr auto     retry_delay            = std::chrono::seconds(5);
+
+   state_history_follower(chain_plugin& chain_plug, std::string host, std::string port);
+
+   // on the main thread, once the chain has started
+   void start();
+   void stop();
+
+ private:
+   using tcp       = boost::asio::ip::tcp;
+   using ws_stream = boost::beast::websocket::stream<tcp::socket>;
+
+   // on the follower thread
+   void connect();
+   void request_blocks(const get_blocks_request_v0& req);
+   void read();
+   void on_result(get_blocks_result_v0&& result);
+   void ack();
+   void write_acks();
+   void retry(const std::string& what);
+
+   // on the main thread
+   get_blocks_request_v0 blocks_request() const;
+   bool                  accept(const chain::signed_block_ptr& block, std::vector<table_delta>&& deltas);
+   bool                  apply(const chain::block_state_ptr& bsp);
+
+   chain_plugin&                                           chain_plug;
+   const std::string                                       host;
+   const std::string                                       port;
+   chain::named_thread_pool                                thread_pool{"shipf", 1};
+   tcp::resolver                                           resolver{thread_pool.get_executor()};
+   boost::asio::steady_timer                               retry_timer{thread_pool.get_executor()};
+   std::unique_ptr<ws_stream>                              stream;
+   boost::beast::flat_buffer                               buffer;
+   uint32_t                                                generation  = 0; // handlers of a closed connection are ignored
+   uint32_t                                                unacked     = 0;
+   bool                                                    writing_ack = false;
+   std::atomic<bool>                                       stopping{false};
+
+   std::map<chain::block_id_type, std::vector<table_delta>> block_deltas; // until irreversible, main thread
+   fc::optional<boost::signals2::scoped_connection>         irreversible_block_connection;
+};
+
+} // namespace eosio
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <boost/filesystem.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <fstream>
 #include <stdint.h>
 
@@ -26,13 +31,62 @@ namespace eosio {
  * each entry:
  *    state_history_log_header
  *    payload
+ *
+ * payload of version 0 entries:
+ *    uint32_t size, zlib compressed data of size bytes
+ * payload of version 1 entries:
+ *    uint8_t state_history_compression, uint32_t size, data of size bytes compressed as given
  */
 
 inline uint64_t       ship_magic(uint32_t version) { return N(ship).to_uint64_t() | version; }
 inline bool           is_ship(uint64_t magic) { return (magic & 0xffff'ffff'0000'0000) == N(ship).to_uint64_t(); }
 inline uint32_t       get_ship_version(uint64_t magic) { return magic; }
-inline bool           is_ship_supported_version(uint64_t magic) { return get_ship_version(magic) == 0; }
-static const uint32_t ship_current_version = 0;
+inline bool           is_ship_supported_version(uint64_t magic) { return get_ship_version(magic) <= 1; }
+static const uint32_t ship_current_version = 1;
+
+enum class state_history_compression : uint8_t {
+   none = 0, ///< larger entries, no decompression when they are sent to the consumers
+   zlib = 1,
+};
+
+namespace state_history {
+
+inline chain::bytes zlib_compress(const chain::bytes& in, int level = boost::iostreams::zlib::default_compression) {
+   namespace bio = boost::iostreams;
+   chain::bytes           out;
+   bio::filtering_ostream comp;
+   comp.push(bio::zlib_compressor(level));
+   comp.push(bio::back_inserter(out));
+   bio::write(comp, in.data(), in.size());
+   bio::close(comp);
+   return out;
+}
+
+inline chain::bytes zlib_decompress(const chain::bytes& in) {
+   namespace bio = boost::iostreams;
+   chain::bytes           out;
+   bio::filtering_ostream decomp;
+   decomp.push(bio::zlib_decompressor());
+   decomp.push(bio::back_inserter(out));
+   bio::write(decomp, in.data(), in.size());
+   bio::close(decomp);
+   return out;
+}
+
+// payload of a current version entry holding data
+inline chain::bytes pack_payload(const chain::bytes& data, state_history_compression compression, int zlib_level) {
+   chain::bytes compressed = compression == state_history_compression::zlib ? zlib_compress(data, zlib_level) : data;
+   EOS_ASSERT(compressed.size() == (uint32_t)compressed.size(), chain::plugin_exception, "state history entry is too big");
+   chain::bytes payload(sizeof(uint8_t) + sizeof(uint32_t) + compressed.size());
+   uint32_t     s = compressed.size();
+   payload[0]     = static_cast<char>(compression);
+   memcpy(payload.data() + sizeof(uint8_t), &s, sizeof(s));
+   if (s)
+      memcpy(payload.data() + sizeof(uint8_t) + sizeof(s), compressed.data(), s);
+   return payload;
+}
+
+} // namespace state_history
 
 struct state_history_log_header {
    uint64_t             magic        = ship_magic(ship_current_version);
@@ -43,6 +97,85 @@ static const int state_history_log_header_serial_size = sizeof(state_history_log
                                                         sizeof(state_history_log_header::block_id) +
                                                         sizeof(state_history_log_header::payload_size);
 
+namespace state_history {
+
+struct payload {
+   state_history_compression compression = state_history_compression::zlib;
+   chain::bytes              data;
+
+   chain::bytes uncompressed() const {
+      return compression == state_history_compression::zlib ? zlib_decompress(data) : data;
+   }
+};
+
+// payload of the entry whose payload stream is positioned at, still compressed
+template <typename Stream>
+payload read_payload(Stream& stream, const state_history_log_header& header) {
+   payload result;
+   if (get_ship_version(header.magic) >= 1) {
+      uint8_t c;
+      stream.read((char*)&c, sizeof(c));
+      EOS_ASSERT(c <= static_cast<uint8_t>(state_history_compression::zlib), chain::plugin_exception,
+                 "unknown state history compression ${c}", ("c", c));
+      result.compression = static_cast<state_history_compression>(c);
+   }
+   uint32_t s;
+   stream.read((char*)&s, sizeof(s));
+   result.data.resize(s);
+   if (s)
+      stream.read(result.data.data(), s);
+   return result;
+}
+
+// data of the entry whose payload stream is positioned at
+template <typename Stream>
+chain::bytes unpack_payload(Stream& stream, const state_history_log_header& header) {
+   return read_payload(stream, header).uncompressed();
+}
+
+/**
+ * Read only memory map of a file of a state_history_log. The file is only appended to between truncations, the
+ * mapping reaches past its end by up to a chunk so that appends become readable without mapping the file again.
+ */
+class mapped_log_file {
+ public:
+   static constexpr uint64_t chunk_size = 64 * 1024 * 1024;
+
+   /**
+    * Address of the bytes pos to pos + size of filename, nullptr if the file is shorter. file is flushed before
+    * bytes past the known end of the file are looked for.
+    */
+   const char* get(fc::cfile& file, const std::string& filename, uint64_t pos, uint64_t size) {
+      if (pos + size > file_size) {
+         file.flush();
+         file_size = boost::filesystem::file_size(filename);
+         if (pos + size > file_size)
+            return nullptr;
+         if (file_size > region.get_size()) {
+            region  = boost::interprocess::mapped_region();
+            mapping = boost::interprocess::file_mapping(filename.c_str(), boost::interprocess::read_only);
+            region  = boost::interprocess::mapped_region(mapping, boost::interprocess::read_only, 0,
+                                                         (file_size + chunk_size - 1) / chunk_size * chunk_size);
+         }
+      }
+      return static_cast<const char*>(region.get_address()) + pos;
+   }
+
+   /// before the file shrinks, the pages past its new end can not be read anymore
+   void unmap() {
+      region    = boost::interprocess::mapped_region();
+      mapping   = boost::interprocess::file_mapping();
+      file_size = 0;
+   }
+
+ private:
+   boost::interprocess::file_mapping  mapping;
+   boost::interprocess::mapped_region region;
+   uint64_t                           file_size = 0; ///< readable bytes of the mapping
+};
+
+} // namespace state_history
+
 class state_history_log {
  private:
    const char* const    name = "";
@@ -53,12 +186,19 @@ class state_history_log {
    uint32_t             _begin_block = 0;
    uint32_t             _end_block   = 0;
    chain::block_id_type last_block_id;
+   const bool           map_log = false;
+   state_history::mapped_log_file log_map;   // only if map_log
+   state_history::mapped_log_file index_map; // positions are looked up without seeking and reading the index
 
  public:
-   state_history_log(const char* const name, std::string log_filename, std::string index_filename)
+   /**
+    * @param map_log : memory map the log, entries are then read without system calls once their block is mapped
+    */
+   state_history_log(const char* const name, std::string log_filename, std::string index_filename, bool map_log = false)
        : name(name)
        , log_filename(std::move(log_filename))
-       , index_filename(std::move(index_filename)) {
+       , index_filename(std::move(index_filename))
+       , map_log(map_log) {
       open_log();
       open_index();
    }
@@ -69,7 +209,11 @@ class state_history_log {
    void read_header(state_history_log_header& header, bool assert_version = true) {
       char bytes[state_history_log_header_serial_size];
       log.read(bytes, sizeof(bytes));
-      fc::datastream<const char*> ds(bytes, sizeof(bytes));
+      unpack_header(bytes, header, assert_version);
+   }
+
+   void unpack_header(const char* bytes, state_history_log_header& header, bool assert_version = true) {
+      fc::datastream<const char*> ds(bytes, state_history_log_header_serial_size);
       fc::raw::unpack(ds, header);
       EOS_ASSERT(!ds.remaining(), chain::plugin_exception, "state_history_log_header_serial_size mismatch");
       if (assert_version)
@@ -131,9 +275,37 @@ class state_history_log {
       return log;
    }
 
+   // header of block_num, from the mapping of the log if there is one
+   void get_entry_header(uint32_t block_num, state_history_log_header& header) {
+      EOS_ASSERT(block_num >= _begin_block && block_num < _end_block, chain::plugin_exception,
+                 "read non-existing block in ${name}.log", ("name", name));
+      const uint64_t pos = get_pos(block_num);
+      if (const char* p = map_log ? log_map.get(log, log_filename, pos, state_history_log_header_serial_size) : nullptr) {
+         unpack_header(p, header);
+      } else {
+         log.seek(pos);
+         read_header(header);
+      }
+   }
+
+   // still compressed payload of block_num with the header from get_entry_header, read from the mapping of the log
+   // if there is one, in a single read otherwise
+   state_history::payload get_entry_payload(uint32_t block_num, const state_history_log_header& header) {
+      const uint64_t pos = get_pos(block_num) + state_history_log_header_serial_size;
+      if (const char* p = map_log ? log_map.get(log, log_filename, pos, header.payload_size) : nullptr) {
+         fc::datastream<const char*> ds(p, header.payload_size);
+         return state_history::read_payload(ds, header);
+      }
+      chain::bytes bytes(header.payload_size);
+      log.seek(pos);
+      log.read(bytes.data(), bytes.size());
+      fc::datastream<const char*> ds(bytes.data(), bytes.size());
+      return state_history::read_payload(ds, header);
+   }
+
    chain::block_id_type get_block_id(uint32_t block_num) {
       state_history_log_header header;
-      get_entry(block_num, header);
+      get_entry_header(block_num, header);
       return header.block_id;
    }
 
@@ -260,9 +432,14 @@ class state_history_log {
    }
 
    uint64_t get_pos(uint32_t block_num) {
-      uint64_t pos;
-      index.seek((block_num - _begin_block) * sizeof(pos));
-      index.read((char*)&pos, sizeof(pos));
+      uint64_t       pos;
+      const uint64_t offset = uint64_t(block_num - _begin_block) * sizeof(pos);
+      if (const char* p = index_map.get(index, index_filename, offset, sizeof(pos))) {
+         memcpy(&pos, p, sizeof(pos));
+      } else {
+         index.seek(offset);
+         index.read((char*)&pos, sizeof(pos));
+      }
       return pos;
    }
 
@@ -286,6 +463,8 @@ class state_history_log {
          boost::filesystem::resize_file(index_filename, (block_num - _begin_block) * sizeof(uint64_t));
          _end_block = block_num;
       }
+      log_map.unmap();
+      index_map.unmap();
       log.flush();
       index.flush();
       ilog("fork or replay: removed ${n} blocks from ${name}.log", ("n", num_removed)("name", name));
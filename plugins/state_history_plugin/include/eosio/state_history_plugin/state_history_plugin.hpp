@@ -98,6 +98,12 @@ struct get_blocks_request_v0 {
    bool                        fetch_deltas           = false;
 };
 
+struct get_blocks_request_v1 : get_blocks_request_v0 {
+   std::vector<eosio::name> filter_contracts = {}; ///< traces of transactions with actions for these receivers and rows of their tables, empty sends everything
+   std::vector<eosio::name> filter_tables    = {}; ///< only the rows of these tables of filter_contracts, empty for all tables
+   std::vector<eosio::name> filter_actions   = {}; ///< only the actions of these names for filter_contracts, empty for all actions
+};
+
 struct get_blocks_ack_request_v0 {
    uint32_t num_messages = 0;
 };
@@ -112,7 +118,7 @@ struct get_blocks_result_v0 {
    fc::optional<bytes>          deltas;
 };
 
-using state_request = fc::static_variant<get_status_request_v0, get_blocks_request_v0, get_blocks_ack_request_v0>;
+using state_request = fc::static_variant<get_status_request_v0, get_blocks_request_v0, get_blocks_ack_request_v0, get_blocks_request_v1>;
 using state_result  = fc::static_variant<get_status_result_v0, get_blocks_result_v0>;
 
 class state_history_plugin : public plugin<state_history_plugin> {
@@ -140,5 +146,6 @@ FC_REFLECT(eosio::block_position, (block_num)(block_id));
 FC_REFLECT_EMPTY(eosio::get_status_request_v0);
 FC_REFLECT(eosio::get_status_result_v0, (head)(last_irreversible)(trace_begin_block)(trace_end_block)(chain_state_begin_block)(chain_state_end_block));
 FC_REFLECT(eosio::get_blocks_request_v0, (start_block_num)(end_block_num)(max_messages_in_flight)(have_positions)(irreversible_only)(fetch_block)(fetch_traces)(fetch_deltas));
+FC_REFLECT_DERIVED(eosio::get_blocks_request_v1, (eosio::get_blocks_request_v0), (filter_contracts)(filter_tables)(filter_actions));
 FC_REFLECT(eosio::get_blocks_ack_request_v0, (num_messages));
 // clang-format on
@@ -85,6 +85,17 @@ datastream<ST>& operator<<(datastream<ST>& ds, const history_serial_big_vector_w
    return ds;
 }
 
+template <typename ST, typename T>
+datastream<ST>& operator>>(datastream<ST>& ds, history_serial_big_vector_wrapper<T>& obj) {
+   unsigned_int size;
+   fc::raw::unpack(ds, size);
+   FC_ASSERT(size.value <= 1024 * 1024 * 1024);
+   obj.obj.resize(size.value);
+   for (auto& x : obj.obj)
+      fc::raw::unpack(ds, x);
+   return ds;
+}
+
 template <typename ST>
 inline void history_pack_varuint64(datastream<ST>& ds, uint64_t val) {
    do {
@@ -109,6 +120,34 @@ void history_pack_big_bytes(datastream<ST>& ds, const fc::optional<eosio::chain:
       history_pack_big_bytes(ds, *v);
 }
 
+template <typename ST>
+void history_unpack_big_bytes(datastream<ST>& ds, eosio::chain::bytes& v) {
+   uint64_t size  = 0;
+   uint8_t  b     = 0;
+   int      shift = 0;
+   do {
+      FC_ASSERT(shift < 64, "invalid varuint64");
+      fc::raw::unpack(ds, b);
+      size |= uint64_t(b & 0x7f) << shift;
+      shift += 7;
+   } while (b & 0x80);
+   FC_ASSERT(size <= ds.remaining());
+   v.resize(size);
+   if (size)
+      ds.read(v.data(), size);
+}
+
+template <typename ST>
+void history_unpack_big_bytes(datastream<ST>& ds, fc::optional<eosio::chain::bytes>& v) {
+   bool valid = false;
+   fc::raw::unpack(ds, valid);
+   v.reset();
+   if (valid) {
+      v.emplace();
+      history_unpack_big_bytes(ds, *v);
+   }
+}
+
 template <typename ST, typename T>
 datastream<ST>& operator<<(datastream<ST>& ds, const history_serial_wrapper<std::vector<T>>& obj) {
    return history_serialize_container(ds, obj.db, obj.obj);
@@ -692,4 +731,16 @@ datastream<ST>& operator<<(datastream<ST>& ds, const eosio::get_blocks_result_v0
    return ds;
 }
 
+template <typename ST>
+datastream<ST>& operator>>(datastream<ST>& ds, eosio::get_blocks_result_v0& obj) {
+   fc::raw::unpack(ds, obj.head);
+   fc::raw::unpack(ds, obj.last_irreversible);
+   fc::raw::unpack(ds, obj.this_block);
+   fc::raw::unpack(ds, obj.prev_block);
+   history_unpack_big_bytes(ds, obj.block);
+   history_unpack_big_bytes(ds, obj.traces);
+   history_unpack_big_bytes(ds, obj.deltas);
+   return ds;
+}
+
 } // namespace fc
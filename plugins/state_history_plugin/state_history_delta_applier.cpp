@@ -0,0 +1,572 @@
+#include <eosio/state_history_plugin/state_history_delta_applier.hpp>
+
+#include <eosio/chain/account_object.hpp>
+#include <eosio/chain/code_object.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/generated_transaction_object.hpp>
+#include <eosio/chain/global_property_object.hpp>
+#include <eosio/chain/permission_link_object.hpp>
+#include <eosio/chain/permission_object.hpp>
+#include <eosio/chain/protocol_state_object.hpp>
+#include <eosio/chain/resource_limits_private.hpp>
+
+#include <algorithm>
+#include <set>
+
+namespace eosio {
+using namespace chain;
+
+namespace {
+
+using row_stream = fc::datastream<const char*>;
+
+template <typename T>
+T read(row_stream& ds) {
+   T v;
+   fc::raw::unpack(ds, v);
+   return v;
+}
+
+name read_name(row_stream& ds) { return name(read<uint64_t>(ds)); }
+
+void read_version(row_stream& ds, const char* what, uint32_t version = 0) {
+   auto v = read<fc::unsigned_int>(ds).value;
+   EOS_ASSERT(v == version, plugin_exception, "unsupported ${w} version ${v}", ("w", what)("v", v));
+}
+
+// a shared_string or bytes of the row, not copied
+struct blob {
+   const char* data = nullptr;
+   size_t      size = 0;
+};
+
+blob read_blob(row_stream& ds) {
+   auto size = read<fc::unsigned_int>(ds).value;
+   EOS_ASSERT(size <= ds.remaining(), plugin_exception, "truncated state history row");
+   blob b{ds.pos(), size};
+   ds.skip(size);
+   return b;
+}
+
+resource_limits::usage_accumulator read_usage_accumulator(row_stream& ds) {
+   read_version(ds, "usage_accumulator");
+   resource_limits::usage_accumulator a;
+   a.last_ordinal = read<uint32_t>(ds);
+   a.value_ex     = read<uint64_t>(ds);
+   a.consumed     = read<uint64_t>(ds);
+   return a;
+}
+
+resource_limits::ratio read_ratio(row_stream& ds) {
+   read_version(ds, "ratio");
+   resource_limits::ratio r;
+   r.numerator   = read<uint64_t>(ds);
+   r.denominator = read<uint64_t>(ds);
+   return r;
+}
+
+resource_limits::elastic_limit_parameters read_elastic_limit_parameters(row_stream& ds) {
+   read_version(ds, "elastic_limit_parameters");
+   resource_limits::elastic_limit_parameters p;
+   p.target         = read<uint64_t>(ds);
+   p.max            = read<uint64_t>(ds);
+   p.periods        = read<uint32_t>(ds);
+   p.max_multiplier = read<uint32_t>(ds);
+   p.contract_rate  = read_ratio(ds);
+   p.expand_rate    = read_ratio(ds);
+   return p;
+}
+
+template <typename T>
+T read_secondary_key(row_stream& ds) {
+   return read<T>(ds);
+}
+
+template <>
+float64_t read_secondary_key<float64_t>(row_stream& ds) {
+   auto      i = read<uint64_t>(ds);
+   float64_t f;
+   memcpy(&f, &i, sizeof(f));
+   return f;
+}
+
+template <>
+float128_t read_secondary_key<float128_t>(row_stream& ds) {
+   auto       i = read<__uint128_t>(ds);
+   float128_t f;
+   memcpy(&f, &i, sizeof(f));
+   return f;
+}
+
+template <>
+key256_t read_secondary_key<key256_t>(row_stream& ds) {
+   auto rev = [](__uint128_t x) {
+      char* ch = reinterpret_cast<char*>(&x);
+      std::reverse(ch, ch + sizeof(x));
+      return x;
+   };
+   key256_t k;
+   k[0] = rev(read<__uint128_t>(ds));
+   k[1] = rev(read<__uint128_t>(ds));
+   return k;
+}
+
+class delta_applier {
+ public:
+   delta_applier(controller& chain, const block_state& block)
+       : chain(chain)
+       , db(chain.mutable_db())
+       , block_num(block.block_num)
+       , block_time(block.header.timestamp.to_time_point()) {}
+
+   void apply(const table_delta& delta) {
+      EOS_ASSERT(delta.struct_version.value == 0, plugin_exception, "unsupported table_delta version ${v}",
+                 ("v", delta.struct_version.value));
+      auto apply_rows = [&](auto f) {
+         for (auto& row : delta.rows.obj) {
+            row_stream ds(row.second.data(), row.second.size());
+            f(row.first, ds);
+         }
+      };
+      const auto& n = delta.name;
+      if (n == "account")
+         apply_rows([&](bool present, row_stream& ds) { apply_account(present, ds); });
+      else if (n == "account_metadata")
+         apply_rows([&](bool present, row_stream& ds) { apply_account_metadata(present, ds); });
+      else if (n == "code")
+         apply_rows([&](bool present, row_stream& ds) { apply_code(present, ds); });
+      else if (n == "contract_table")
+         apply_rows([&](bool present, row_stream& ds) { apply_contract_table(present, ds); });
+      else if (n == "contract_row")
+         apply_rows([&](bool present, row_stream& ds) { apply_contract_row(present, ds); });
+      else if (n == "contract_index64")
+         apply_rows([&](bool present, row_stream& ds) { apply_secondary_index<index64_object>(present, ds); });
+      else if (n == "contract_index128")
+         apply_rows([&](bool present, row_stream& ds) { apply_secondary_index<index128_object>(present, ds); });
+      else if (n == "contract_index256")
+         apply_rows([&](bool present, row_stream& ds) { apply_secondary_index<index256_object>(present, ds); });
+      else if (n == "contract_index_double")
+         apply_rows([&](bool present, row_stream& ds) { apply_secondary_index<index_double_object>(present, ds); });
+      else if (n == "contract_index_long_double")
+         apply_rows(
+             [&](bool present, row_stream& ds) { apply_secondary_index<index_long_double_object>(present, ds); });
+      else if (n == "global_property")
+         apply_rows([&](bool present, row_stream& ds) { apply_global_property(present, ds); });
+      else if (n == "generated_transaction")
+         apply_rows([&](bool present, row_stream& ds) { apply_generated_transaction(present, ds); });
+      else if (n == "protocol_state")
+         apply_rows([&](bool present, row_stream& ds) { apply_protocol_state(present, ds); });
+      else if (n == "permission")
+         apply_rows([&](bool present, row_stream& ds) { apply_permission(present, ds); });
+      else if (n == "permission_link")
+         apply_rows([&](bool present, row_stream& ds) { apply_permission_link(present, ds); });
+      else if (n == "resource_limits")
+         apply_rows([&](bool present, row_stream& ds) { apply_resource_limits(present, ds); });
+      else if (n == "resource_usage")
+         apply_rows([&](bool present, row_stream& ds) { apply_resource_usage(present, ds); });
+      else if (n == "resource_limits_state")
+         apply_rows([&](bool present, row_stream& ds) { apply_resource_limits_state(present, ds); });
+      else if (n == "resource_limits_config")
+         apply_rows([&](bool present, row_stream& ds) { apply_resource_limits_config(present, ds); });
+      else
+         EOS_THROW(plugin_exception, "unknown state history table ${n}", ("n", n));
+   }
+
+   // contract tables come before their rows, a removed table is only removed once its rows are
+   void remove_emptied_tables() {
+      for (auto& key : removed_tables) {
+         auto* tid = find_table(key);
+         if (tid && tid->count == 0) {
+            chain.table_removed(*tid);
+            db.remove(*tid);
+         }
+      }
+      removed_tables.clear();
+   }
+
+ private:
+   using table_key = std::tuple<name, name, name>;
+
+   template <typename Object, typename Index, typename Key, typename Modify>
+   void upsert(const Key& key, Modify&& modify) {
+      if (auto* obj = db.find<Object, Index>(key))
+         db.modify(*obj, modify);
+      else
+         db.create<Object>(modify);
+   }
+
+   template <typename Object, typename Index, typename Key>
+   void remove(const Key& key) {
+      if (auto* obj = db.find<Object, Index>(key))
+         db.remove(*obj);
+   }
+
+   void apply_account(bool present, row_stream& ds) {
+      read_version(ds, "account");
+      auto n = read_name(ds);
+      if (!present)
+         return remove<account_object, by_name>(n);
+      auto creation_date = read<block_timestamp_type>(ds);
+      auto abi           = read_blob(ds);
+      upsert<account_object, by_name>(n, [&](account_object& a) {
+         a.name          = n;
+         a.creation_date = creation_date;
+         a.abi.assign(abi.data, abi.size);
+      });
+   }
+
+   void apply_account_metadata(bool present, row_stream& ds) {
+      read_version(ds, "account_metadata");
+      auto n = read_name(ds);
+      if (!present)
+         return remove<account_metadata_object, by_name>(n);
+      auto privileged       = read<bool>(ds);
+      auto last_code_update = read<time_point>(ds);
+      uint8_t     vm_type = 0, vm_version = 0;
+      digest_type code_hash;
+      if (read<bool>(ds)) {
+         vm_type    = read<uint8_t>(ds);
+         vm_version = read<uint8_t>(ds);
+         code_hash  = read<digest_type>(ds);
+      }
+      upsert<account_metadata_object, by_name>(n, [&](account_metadata_object& a) {
+         a.name = n;
+         a.set_privileged(privileged);
+         a.last_code_update = last_code_update;
+         a.code_hash        = code_hash;
+         a.vm_type          = vm_type;
+         a.vm_version       = vm_version;
+      });
+   }
+
+   void apply_code(bool present, row_stream& ds) {
+      read_version(ds, "code");
+      auto vm_type    = read<uint8_t>(ds);
+      auto vm_version = read<uint8_t>(ds);
+      auto code_hash  = read<digest_type>(ds);
+      auto key        = boost::make_tuple(code_hash, vm_type, vm_version);
+      if (!present)
+         return remove<code_object, by_code_hash>(key);
+      // a code object only changes its reference count, which the deltas leave out
+      if (db.find<code_object, by_code_hash>(key))
+         return;
+      auto code = read_blob(ds);
+      db.create<code_object>([&](code_object& c) {
+         c.code_hash = code_hash;
+         c.code.assign(code.data, code.size);
+         c.code_ref_count   = 1;
+         c.first_block_used = block_num;
+         c.vm_type          = vm_type;
+         c.vm_version       = vm_version;
+      });
+   }
+
+   table_key read_table_key(row_stream& ds) {
+      auto code  = read_name(ds);
+      auto scope = read_name(ds);
+      auto table = read_name(ds);
+      return {code, scope, table};
+   }
+
+   const table_id_object* find_table(const table_key& key) {
+      return db.find<table_id_object, by_code_scope_table>(
+          boost::make_tuple(std::get<0>(key), std::get<1>(key), std::get<2>(key)));
+   }
+
+   const table_id_object& get_table(const table_key& key) {
+      auto* tid = find_table(key);
+      EOS_ASSERT(tid, plugin_exception, "no contract table ${c} ${s} ${t} for its row",
+                 ("c", std::get<0>(key))("s", std::get<1>(key))("t", std::get<2>(key)));
+      return *tid;
+   }
+
+   void apply_contract_table(bool present, row_stream& ds) {
+      read_version(ds, "contract_table");
+      auto key   = read_table_key(ds);
+      auto payer = read_name(ds);
+      if (!present) {
+         removed_tables.insert(key);
+         return;
+      }
+      if (auto* tid = find_table(key)) {
+         db.modify(*tid, [&](table_id_object& t) { t.payer = payer; });
+         return;
+      }
+      const auto& tid = db.create<table_id_object>([&](table_id_object& t) {
+         t.code  = std::get<0>(key);
+         t.scope = std::get<1>(key);
+         t.table = std::get<2>(key);
+         t.payer = payer;
+      });
+      chain.table_created(tid);
+   }
+
+   // a row is added to or removed from its table, counting the rows of its secondary indices as well
+   void count_row(const table_id_object& tid, int delta) {
+      chain.table_touched(tid);
+      db.modify(tid, [&](table_id_object& t) { t.count += delta; });
+   }
+
+   void apply_contract_row(bool present, row_stream& ds) {
+      read_version(ds, "contract_row");
+      const auto& tid         = get_table(read_table_key(ds));
+      auto        primary_key = read<uint64_t>(ds);
+      auto        key         = boost::make_tuple(tid.id, primary_key);
+      auto*       row         = db.find<key_value_object, by_scope_primary>(key);
+      if (!present) {
+         if (row) {
+            count_row(tid, -1);
+            db.remove(*row);
+         }
+         return;
+      }
+      auto payer = read_name(ds);
+      auto value = read_blob(ds);
+      auto set   = [&](key_value_object& o) {
+         o.t_id        = tid.id;
+         o.primary_key = primary_key;
+         o.payer       = payer;
+         o.value.assign(value.data, value.size);
+      };
+      if (row) {
+         chain.table_touched(tid);
+         db.modify(*row, set);
+      } else {
+         count_row(tid, 1);
+         db.create<key_value_object>(set);
+      }
+   }
+
+   template <typename Object>
+   void apply_secondary_index(bool present, row_stream& ds) {
+      read_version(ds, "contract_index");
+      const auto& tid         = get_table(read_table_key(ds));
+      auto        primary_key = read<uint64_t>(ds);
+      auto        key         = boost::make_tuple(tid.id, primary_key);
+      auto*       row         = db.find<Object, by_primary>(key);
+      if (!present) {
+         if (row) {
+            count_row(tid, -1);
+            db.remove(*row);
+         }
+         return;
+      }
+      auto payer         = read_name(ds);
+      auto secondary_key = read_secondary_key<typename Object::secondary_key_type>(ds);
+      auto set           = [&](Object& o) {
+         o.t_id          = tid.id;
+         o.primary_key   = primary_key;
+         o.payer         = payer;
+         o.secondary_key = secondary_key;
+      };
+      if (row) {
+         db.modify(*row, set);
+      } else {
+         count_row(tid, 1);
+         db.create<Object>(set);
+      }
+   }
+
+   void apply_global_property(bool present, row_stream& ds) {
+      EOS_ASSERT(present, plugin_exception, "the global properties can not be removed");
+      read_version(ds, "global_property", 1);
+      auto proposed_schedule_block_num = read<optional<block_num_type>>(ds);
+      auto proposed_schedule           = read<producer_authority_schedule>(ds);
+      read_version(ds, "chain_config");
+      auto configuration = read<chain_config>(ds);
+      auto chain_id      = read<chain_id_type>(ds);
+      db.modify(db.get<global_property_object>(), [&](global_property_object& gp) {
+         gp.proposed_schedule_block_num = proposed_schedule_block_num;
+         gp.proposed_schedule           = proposed_schedule.to_shared(gp.proposed_schedule.producers.get_allocator());
+         gp.configuration               = configuration;
+         gp.chain_id                    = chain_id;
+      });
+   }
+
+   void apply_generated_transaction(bool present, row_stream& ds) {
+      read_version(ds, "generated_transaction");
+      auto sender    = read_name(ds);
+      auto sender_id = read<__uint128_t>(ds);
+      auto payer     = read_name(ds);
+      auto trx_id    = read<transaction_id_type>(ds);
+      if (!present)
+         return remove<generated_transaction_object, by_trx_id>(trx_id);
+      auto packed_trx = read_blob(ds);
+      // a transaction is scheduled in the block it first shows up in, a row seen again has not changed
+      if (db.find<generated_transaction_object, by_trx_id>(trx_id))
+         return;
+      transaction trx;
+      row_stream  trx_ds(packed_trx.data, packed_trx.size);
+      fc::raw::unpack(trx_ds, trx);
+      const auto& cfg = db.get<global_property_object>().configuration;
+      db.create<generated_transaction_object>([&](generated_transaction_object& gto) {
+         gto.trx_id      = trx_id;
+         gto.sender      = sender;
+         gto.sender_id   = sender_id;
+         gto.payer       = payer;
+         gto.published   = block_time;
+         gto.delay_until = block_time + fc::seconds(trx.delay_sec.value);
+         gto.expiration  = gto.delay_until + fc::seconds(cfg.deferred_trx_expiration_window);
+         gto.packed_trx.assign(packed_trx.data, packed_trx.size);
+      });
+   }
+
+   void apply_protocol_state(bool present, row_stream& ds) {
+      EOS_ASSERT(present, plugin_exception, "the protocol state can not be removed");
+      read_version(ds, "protocol_state");
+      std::vector<protocol_state_object::activated_protocol_feature> features(read<fc::unsigned_int>(ds).value);
+      for (auto& f : features) {
+         read_version(ds, "activated_protocol_feature");
+         f.feature_digest       = read<digest_type>(ds);
+         f.activation_block_num = read<uint32_t>(ds);
+      }
+      db.modify(db.get<protocol_state_object>(), [&](protocol_state_object& ps) {
+         ps.activated_protocol_features.clear();
+         for (auto& f : features)
+            ps.activated_protocol_features.emplace_back(f.feature_digest, f.activation_block_num);
+      });
+   }
+
+   void apply_permission(bool present, row_stream& ds) {
+      read_version(ds, "permission");
+      auto  owner = read_name(ds);
+      auto  n     = read_name(ds);
+      auto* perm  = db.find<permission_object, by_owner>(boost::make_tuple(owner, n));
+      if (!present) {
+         if (perm) {
+            db.get_mutable_index<permission_usage_index>().remove_object(perm->usage_id._id);
+            db.remove(*perm);
+         }
+         return;
+      }
+      auto                       parent_name  = read_name(ds);
+      auto                       last_updated = read<time_point>(ds);
+      auto                       auth         = read<authority>(ds);
+      permission_object::id_type parent       = 0;
+      if (parent_name != name()) {
+         auto* p = db.find<permission_object, by_owner>(boost::make_tuple(owner, parent_name));
+         EOS_ASSERT(p, plugin_exception, "no parent ${p} of permission ${o}@${n}",
+                    ("p", parent_name)("o", owner)("n", n));
+         parent = p->id;
+      }
+      auto set = [&](permission_object& po) {
+         po.parent       = parent;
+         po.owner        = owner;
+         po.name         = n;
+         po.last_updated = last_updated;
+         po.auth         = auth;
+      };
+      if (perm) {
+         db.modify(*perm, set);
+         return;
+      }
+      const auto& usage = db.create<permission_usage_object>([&](permission_usage_object& p) {
+         p.last_used = block_time;
+      });
+      db.create<permission_object>([&](permission_object& po) {
+         po.usage_id = usage.id;
+         set(po);
+      });
+   }
+
+   void apply_permission_link(bool present, row_stream& ds) {
+      read_version(ds, "permission_link");
+      auto account      = read_name(ds);
+      auto code         = read_name(ds);
+      auto message_type = read_name(ds);
+      auto key          = boost::make_tuple(account, code, message_type);
+      if (!present)
+         return remove<permission_link_object, by_action_name>(key);
+      auto required_permission = read_name(ds);
+      upsert<permission_link_object, by_action_name>(key, [&](permission_link_object& l) {
+         l.account             = account;
+         l.code                = code;
+         l.message_type        = message_type;
+         l.required_permission = required_permission;
+      });
+   }
+
+   void apply_resource_limits(bool present, row_stream& ds) {
+      read_version(ds, "resource_limits");
+      auto owner = read_name(ds);
+      auto key   = boost::make_tuple(false, owner);
+      if (!present)
+         return remove<resource_limits::resource_limits_object, resource_limits::by_owner>(key);
+      auto net_weight = read<int64_t>(ds);
+      auto cpu_weight = read<int64_t>(ds);
+      auto ram_bytes  = read<int64_t>(ds);
+      upsert<resource_limits::resource_limits_object, resource_limits::by_owner>(
+          key, [&](resource_limits::resource_limits_object& l) {
+             l.owner      = owner;
+             l.net_weight = net_weight;
+             l.cpu_weight = cpu_weight;
+             l.ram_bytes  = ram_bytes;
+          });
+   }
+
+   void apply_resource_usage(bool present, row_stream& ds) {
+      read_version(ds, "resource_usage");
+      auto owner = read_name(ds);
+      if (!present)
+         return remove<resource_limits::resource_usage_object, resource_limits::by_owner>(owner);
+      auto net_usage = read_usage_accumulator(ds);
+      auto cpu_usage = read_usage_accumulator(ds);
+      auto ram_usage = read<uint64_t>(ds);
+      upsert<resource_limits::resource_usage_object, resource_limits::by_owner>(
+          owner, [&](resource_limits::resource_usage_object& u) {
+             u.owner     = owner;
+             u.net_usage = net_usage;
+             u.cpu_usage = cpu_usage;
+             u.ram_usage = ram_usage;
+          });
+   }
+
+   void apply_resource_limits_state(bool present, row_stream& ds) {
+      EOS_ASSERT(present, plugin_exception, "the resource limits state can not be removed");
+      read_version(ds, "resource_limits_state");
+      auto average_block_net_usage = read_usage_accumulator(ds);
+      auto average_block_cpu_usage = read_usage_accumulator(ds);
+      const auto& state = db.get<resource_limits::resource_limits_state_object>();
+      db.modify(state, [&](resource_limits::resource_limits_state_object& s) {
+         s.average_block_net_usage = average_block_net_usage;
+         s.average_block_cpu_usage = average_block_cpu_usage;
+         s.total_net_weight        = read<uint64_t>(ds);
+         s.total_cpu_weight        = read<uint64_t>(ds);
+         s.total_ram_bytes         = read<uint64_t>(ds);
+         s.virtual_net_limit       = read<uint64_t>(ds);
+         s.virtual_cpu_limit       = read<uint64_t>(ds);
+      });
+   }
+
+   void apply_resource_limits_config(bool present, row_stream& ds) {
+      EOS_ASSERT(present, plugin_exception, "the resource limits config can not be removed");
+      read_version(ds, "resource_limits_config");
+      auto cpu_limit_parameters = read_elastic_limit_parameters(ds);
+      auto net_limit_parameters = read_elastic_limit_parameters(ds);
+      const auto& config = db.get<resource_limits::resource_limits_config_object>();
+      db.modify(config, [&](resource_limits::resource_limits_config_object& c) {
+         c.cpu_limit_parameters             = cpu_limit_parameters;
+         c.net_limit_parameters             = net_limit_parameters;
+         c.account_cpu_usage_average_window = read<uint32_t>(ds);
+         c.account_net_usage_average_window = read<uint32_t>(ds);
+      });
+   }
+
+   controller&          chain;
+   chainbase::database& db;
+   const uint32_t       block_num;
+   const time_point     block_time;
+   std::set<table_key>  removed_tables;
+};
+
+} // namespace
+
+void apply_state_history_deltas(controller& chain, const block_state& block, const std::vector<table_delta>& deltas) {
+   delta_applier applier(chain, block);
+   for (auto& delta : deltas)
+      applier.apply(delta);
+   applier.remove_emptied_tables();
+}
+
+} // namespace eosio
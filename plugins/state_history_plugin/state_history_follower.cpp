@@ -0,0 +1,237 @@
+#include <eosio/state_history_plugin/state_history_delta_applier.hpp>
+#include <eosio/state_history_plugin/state_history_follower.hpp>
+#include <eosio/state_history_plugin/state_history_serialization.hpp>
+
+#include <boost/asio/connect.hpp>
+
+namespace eosio {
+using namespace chain;
+
+state_history_follower::state_history_follower(chain_plugin& chain_plug, std::string host, std::string port)
+    : chain_plug(chain_plug)
+    , host(std::move(host))
+    , port(std::move(port)) {}
+
+void state_history_follower::start() {
+   auto& chain = chain_plug.chain();
+   chain.set_block_deltas_applier([this](const block_state_ptr& bsp) { return apply(bsp); });
+   // ids start with the block number
+   irreversible_block_connection.emplace(chain.irreversible_block.connect([this](const block_state_ptr& bsp) {
+      block_deltas.erase(block_deltas.begin(), block_deltas.upper_bound(bsp->id));
+   }));
+   ilog("following the chain of the state history endpoint ${h}:${p} from block ${n}",
+        ("h", host)("p", port)("n", chain.head_block_num() + 1));
+   boost::asio::post(thread_pool.get_executor(), [self = shared_from_this()] { self->connect(); });
+}
+
+void state_history_follower::stop() {
+   stopping = true;
+   boost::asio::post(thread_pool.get_executor(), [self = shared_from_this()] {
+      self->retry_timer.cancel();
+      if (self->stream) {
+         boost::system::error_code ec;
+         self->stream->next_layer().close(ec);
+      }
+   });
+   thread_pool.stop();
+   irreversible_block_connection.reset();
+}
+
+void state_history_follower::connect() {
+   if (stopping)
+      return;
+   auto gen = ++generation;
+   stream   = std::make_unique<ws_stream>(thread_pool.get_executor());
+   resolver.async_resolve(host, port, [this, self = shared_from_this(), gen](const boost::system::error_code& ec,
+                                                                              tcp::resolver::results_type results) {
+      if (gen != generation)
+         return;
+      if (ec)
+         return retry("resolve: " + ec.message());
+      boost::asio::async_connect(stream->next_layer(), results,
+                                 [this, self, gen](const boost::system::error_code& ec, const tcp::endpoint&) {
+         if (gen != generation)
+            return;
+         if (ec)
+            return retry("connect: " + ec.message());
+         stream->next_layer().set_option(tcp::no_delay(true));
+         stream->async_handshake(host, "/", [this, self, gen](const boost::system::error_code& ec) {
+            if (gen != generation)
+               return;
+            if (ec)
+               return retry("handshake: " + ec.message());
+            // the abi of the protocol comes first, as text
+            stream->async_read(buffer, [this, self, gen](const boost::system::error_code& ec, size_t) {
+               if (gen != generation)
+                  return;
+               if (ec)
+                  return retry("read abi: " + ec.message());
+               buffer.consume(buffer.size());
+               // the request resumes from the head block, whose id is read on the main thread
+               app().post(priority::medium, [this, self, gen] {
+                  auto req = blocks_request();
+                  boost::asio::post(thread_pool.get_executor(), [this, self, gen, req = std::move(req)] {
+                     if (gen == generation)
+                        request_blocks(req);
+                  });
+               });
+            });
+         });
+      });
+   });
+}
+
+get_blocks_request_v0 state_history_follower::blocks_request() const {
+   const auto&           chain = chain_plug.chain();
+   get_blocks_request_v0 req;
+   req.start_block_num        = chain.head_block_num() + 1;
+   req.end_block_num          = std::numeric_limits<uint32_t>::max();
+   req.max_messages_in_flight = max_messages_in_flight;
+   req.fetch_block            = true;
+   req.fetch_deltas           = true;
+   // the endpoint resumes from the first of these blocks it does not have, i.e. where it switched to another fork
+   for (auto n = chain.last_irreversible_block_num() + 1; n <= chain.head_block_num(); ++n)
+      req.have_positions.push_back({n, chain.get_block_id_for_num(n)});
+   return req;
+}
+
+void state_history_follower::request_blocks(const get_blocks_request_v0& req) {
+   auto gen     = generation;
+   auto request = std::make_shared<bytes>(fc::raw::pack(state_request{req}));
+   stream->binary(true);
+   stream->async_write(boost::asio::buffer(*request),
+                       [this, self = shared_from_this(), gen, request](const boost::system::error_code& ec, size_t) {
+                          if (gen != generation)
+                             return;
+                          if (ec)
+                             return retry("request: " + ec.message());
+                          read();
+                       });
+}
+
+void state_history_follower::read() {
+   auto gen = generation;
+   stream->async_read(buffer, [this, self = shared_from_this(), gen](const boost::system::error_code& ec, size_t) {
+      if (gen != generation)
+         return;
+      if (ec)
+         return retry("read: " + ec.message());
+      state_result result;
+      try {
+         auto data = boost::asio::buffer_cast<const char*>(boost::beast::buffers_front(buffer.data()));
+         fc::datastream<const char*> ds(data, boost::asio::buffer_size(buffer.data()));
+         fc::raw::unpack(ds, result);
+      } catch (const fc::exception& e) {
+         return retry("invalid result: " + e.to_string());
+      }
+      buffer.consume(buffer.size());
+      if (!result.contains<get_blocks_result_v0>())
+         return retry("unexpected result");
+      on_result(std::move(result.get<get_blocks_result_v0>()));
+   });
+}
+
+void state_history_follower::on_result(get_blocks_result_v0&& result) {
+   if (!result.this_block) {
+      // nothing new, the endpoint reports its head
+      ack();
+      return read();
+   }
+   if (!result.block || !result.deltas)
+      return retry("the endpoint does not keep the blocks and chain state history of block " +
+                   std::to_string(result.this_block->block_num));
+
+   auto                     block = std::make_shared<signed_block>();
+   std::vector<table_delta> deltas;
+   try {
+      fc::datastream<const char*> block_ds(result.block->data(), result.block->size());
+      fc::raw::unpack(block_ds, *block);
+      fc::datastream<const char*> deltas_ds(result.deltas->data(), result.deltas->size());
+      fc::raw::unpack(deltas_ds, deltas);
+   } catch (const fc::exception& e) {
+      return retry("invalid block " + std::to_string(result.this_block->block_num) + ": " + e.to_string());
+   }
+
+   auto gen = generation;
+   app().post(priority::medium, [this, self = shared_from_this(), gen, block, deltas = std::move(deltas)]() mutable {
+      if (stopping)
+         return;
+      bool accepted = accept(block, std::move(deltas));
+      boost::asio::post(thread_pool.get_executor(), [this, self, gen, accepted, block_num = block->block_num()] {
+         if (gen != generation)
+            return;
+         if (!accepted)
+            return retry("block " + std::to_string(block_num) + " was not accepted");
+         ack();
+         read();
+      });
+   });
+}
+
+void state_history_follower::ack() {
+   ++unacked;
+   write_acks();
+}
+
+// one write at a time, the results read in the meantime are acked together
+void state_history_follower::write_acks() {
+   if (writing_ack || !unacked)
+      return;
+   writing_ack = true;
+   auto gen    = generation;
+   auto ack    = std::make_shared<bytes>(fc::raw::pack(state_request{get_blocks_ack_request_v0{unacked}}));
+   unacked     = 0;
+   stream->async_write(boost::asio::buffer(*ack),
+                       [this, self = shared_from_this(), gen, ack](const boost::system::error_code& ec, size_t) {
+                          if (gen != generation)
+                             return;
+                          if (ec)
+                             return retry("ack: " + ec.message());
+                          writing_ack = false;
+                          write_acks();
+                       });
+}
+
+void state_history_follower::retry(const std::string& what) {
+   ++generation;
+   unacked     = 0;
+   writing_ack = false;
+   boost::system::error_code ec;
+   if (stream)
+      stream->next_layer().close(ec);
+   if (stopping)
+      return;
+   elog("state history follower, ${w}, reconnecting to ${h}:${p}", ("w", what)("h", host)("p", port));
+   retry_timer.expires_after(retry_delay);
+   retry_timer.async_wait([this, self = shared_from_this()](const boost::system::error_code& ec) {
+      if (!ec)
+         connect();
+   });
+}
+
+bool state_history_follower::accept(const signed_block_ptr& block, std::vector<table_delta>&& deltas) {
+   auto id = block->id();
+   // sent again after a reconnect
+   if (chain_plug.chain().fetch_block_by_id(id))
+      return true;
+   block_deltas[id] = std::move(deltas);
+   try {
+      if (chain_plug.accept_block(block, id))
+         return true;
+   } catch (const fc::exception& e) {
+      elog("block ${n} ${id} of the state history endpoint: ${e}",
+           ("n", block->block_num())("id", id)("e", e.to_detail_string()));
+   }
+   block_deltas.erase(id);
+   return false;
+}
+
+bool state_history_follower::apply(const block_state_ptr& bsp) {
+   auto it = block_deltas.find(bsp->id);
+   if (it == block_deltas.end())
+      return false;
+   apply_state_history_deltas(chain_plug.chain(), *bsp, it->second);
+   return true;
+}
+
+} // namespace eosio
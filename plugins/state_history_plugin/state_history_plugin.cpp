@@ -1,6 +1,13 @@
+#include <eosio/chain/abi_serializer.hpp>
 #include <eosio/chain/config.hpp>
+#include <eosio/chain/signal_stats.hpp>
+#include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/trace_spans.hpp>
+#include <eosio/state_history_plugin/state_history_entry_cache.hpp>
+#include <eosio/state_history_plugin/state_history_follower.hpp>
 #include <eosio/state_history_plugin/state_history_log.hpp>
 #include <eosio/state_history_plugin/state_history_serialization.hpp>
+#include <fc/io/json.hpp>
 
 #include <boost/asio/bind_executor.hpp>
 #include <boost/asio/ip/host_name.hpp>
@@ -8,9 +15,6 @@
 #include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/websocket.hpp>
-#include <boost/iostreams/device/back_inserter.hpp>
-#include <boost/iostreams/filter/zlib.hpp>
-#include <boost/iostreams/filtering_stream.hpp>
 #include <boost/signals2/connection.hpp>
 
 using tcp    = boost::asio::ip::tcp;
@@ -38,25 +42,6 @@ auto catch_and_log(F f) {
 }
 
 namespace bio = boost::iostreams;
-static bytes zlib_compress_bytes(bytes in) {
-   bytes                  out;
-   bio::filtering_ostream comp;
-   comp.push(bio::zlib_compressor(bio::zlib::default_compression));
-   comp.push(bio::back_inserter(out));
-   bio::write(comp, in.data(), in.size());
-   bio::close(comp);
-   return out;
-}
-
-static bytes zlib_decompress(const bytes& in) {
-   bytes                  out;
-   bio::filtering_ostream decomp;
-   decomp.push(bio::zlib_decompressor());
-   decomp.push(bio::back_inserter(out));
-   bio::write(decomp, in.data(), in.size());
-   bio::close(decomp);
-   return out;
-}
 
 template <typename T>
 bool include_delta(const T& old, const T& curr) {
@@ -110,11 +95,74 @@ bool include_delta(const eosio::chain::protocol_state_object& old, const eosio::
    return old.activated_protocol_features != curr.activated_protocol_features;
 }
 
+// filters of get_blocks_request_v1, applied to the stored entries before they are sent
+struct state_history_filter {
+   flat_set<name> contracts;
+   flat_set<name> tables;
+   flat_set<name> actions;
+
+   explicit state_history_filter(const get_blocks_request_v1& req)
+       : contracts(req.filter_contracts.begin(), req.filter_contracts.end())
+       , tables(req.filter_tables.begin(), req.filter_tables.end())
+       , actions(req.filter_actions.begin(), req.filter_actions.end()) {}
+
+   bool match_action(name receiver, name action) const {
+      return contracts.count(receiver) && (actions.empty() || actions.count(action));
+   }
+
+   // keeps the transactions with a matching action, the traces are only handled through the ship abi
+   bytes filter_traces(const bytes& traces, const abi_serializer& ship_abi, const fc::microseconds& max_time) const {
+      auto        yield = abi_serializer::create_yield_function(max_time);
+      auto        all   = ship_abi.binary_to_variant("transaction_trace[]", traces, yield);
+      fc::variants kept;
+      for (auto& trace : all.get_array()) {
+         const auto& trace_v0 = trace.get_array().at(1).get_object();
+         for (auto& at : trace_v0["action_traces"].get_array()) {
+            const auto& at_v0 = at.get_array().at(1).get_object();
+            if (match_action(at_v0["receiver"].as<name>(), at_v0["act"]["name"].as<name>())) {
+               kept.push_back(trace);
+               break;
+            }
+         }
+      }
+      return ship_abi.variant_to_binary("transaction_trace[]", fc::variant(std::move(kept)), yield);
+   }
+
+   // keeps the contract rows of the matching tables, all contract_* rows start with their code, scope and table
+   bytes filter_deltas(const bytes& packed) const {
+      std::vector<table_delta> deltas;
+      fc::raw::unpack(packed, deltas);
+      std::vector<table_delta> kept;
+      for (auto& delta : deltas) {
+         if (delta.name.compare(0, 9, "contract_") != 0)
+            continue;
+         auto& rows = delta.rows.obj;
+         rows.erase(std::remove_if(rows.begin(), rows.end(),
+                                   [&](const std::pair<bool, bytes>& row) {
+                                      uint64_t code, table;
+                                      if (row.second.size() < 1 + 3 * sizeof(uint64_t))
+                                         return true;
+                                      memcpy(&code, row.second.data() + 1, sizeof(code));
+                                      memcpy(&table, row.second.data() + 1 + 2 * sizeof(uint64_t), sizeof(table));
+                                      return !contracts.count(name(code)) || (!tables.empty() && !tables.count(name(table)));
+                                   }),
+                    rows.end());
+         if (!rows.empty())
+            kept.push_back(std::move(delta));
+      }
+      return fc::raw::pack(kept);
+   }
+};
+
 struct state_history_plugin_impl : std::enable_shared_from_this<state_history_plugin_impl> {
    chain_plugin*                                              chain_plug = nullptr;
    fc::optional<state_history_log>                            trace_log;
    fc::optional<state_history_log>                            chain_state_log;
    bool                                                       trace_debug_mode = false;
+   fc::optional<abi_serializer>                               ship_abi;        // of the filtered sessions, read only
+   fc::microseconds                                           abi_serializer_max_time;
+   state_history_compression                                  compression      = state_history_compression::zlib;
+   int                                                        zlib_level       = bio::zlib::default_compression;
    bool                                                       stopping = false;
    fc::optional<scoped_connection>                            applied_transaction_connection;
    fc::optional<scoped_connection>                            block_start_connection;
@@ -125,17 +173,44 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
    std::map<transaction_id_type, augmented_transaction_trace> cached_traces;
    fc::optional<augmented_transaction_trace>                  onblock_trace;
 
-   void get_log_entry(state_history_log& log, uint32_t block_num, fc::optional<bytes>& result) {
-      if (block_num < log.begin_block() || block_num >= log.end_block())
-         return;
-      state_history_log_header header;
-      auto&                    stream = log.get_entry(block_num, header);
-      uint32_t                 s;
-      stream.read((char*)&s, sizeof(s));
-      bytes compressed(s);
-      if (s)
-         stream.read(compressed.data(), s);
-      result = zlib_decompress(compressed);
+   // the rows are packed on the main thread, packing the entries, compressing and writing them on the writer thread
+   fc::optional<named_thread_pool>                            writer_pool;
+   std::mutex                                                 log_mtx; // of trace_log and chain_state_log
+   std::mutex                                                 queue_mtx;
+   std::condition_variable                                    queue_cv;
+   uint32_t                                                   queued_blocks     = 0;
+   static constexpr uint32_t                                  max_queued_blocks = 32;
+
+   // the sessions read and decompress the entries on the reader threads, the decompressed entries are shared
+   fc::optional<named_thread_pool>                            reader_pool;
+   fc::optional<state_history_entry_cache>                    trace_cache;
+   fc::optional<state_history_entry_cache>                    chain_state_cache;
+
+   std::shared_ptr<state_history_follower>                    follower;
+
+   void get_log_entry(state_history_log& log, fc::optional<state_history_entry_cache>& cache, uint32_t block_num,
+                      fc::optional<bytes>& result) {
+      state_history_entry_cache::entry_ptr entry;
+      state_history::payload               payload;
+      block_id_type                        block_id;
+      {
+         std::lock_guard<std::mutex> g(log_mtx);
+         if (block_num < log.begin_block() || block_num >= log.end_block())
+            return;
+         state_history_log_header header;
+         log.get_entry_header(block_num, header);
+         block_id = header.block_id;
+         if (cache)
+            entry = cache->get(block_num, block_id);
+         if (!entry)
+            payload = log.get_entry_payload(block_num, header);
+      }
+      if (!entry) {
+         entry = std::make_shared<const bytes>(payload.uncompressed());
+         if (cache)
+            cache->put(block_num, block_id, entry);
+      }
+      result = *entry;
    }
 
    void get_block(uint32_t block_num, fc::optional<bytes>& result) {
@@ -146,14 +221,32 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
          return;
       }
       if (p)
-         result = fc::raw::pack(*p);
+         result = *p->packed();
+   }
+
+   // end of the blocks whose requested entries are in the logs, the newest ones may still be queued for the writer
+   uint32_t stored_end_block(const get_blocks_request_v0& req) {
+      std::lock_guard<std::mutex> g(log_mtx);
+      uint32_t end = std::numeric_limits<uint32_t>::max();
+      if (req.fetch_traces && trace_log)
+         end = std::min(end, trace_log->end_block());
+      if (req.fetch_deltas && chain_state_log)
+         end = std::min(end, chain_state_log->end_block());
+      return end;
+   }
+
+   const abi_serializer& get_ship_abi() const {
+      EOS_ASSERT(ship_abi, plugin_exception, "state history abi is not loaded");
+      return *ship_abi;
    }
 
    fc::optional<chain::block_id_type> get_block_id(uint32_t block_num) {
+      std::unique_lock<std::mutex> g(log_mtx);
       if (trace_log && block_num >= trace_log->begin_block() && block_num < trace_log->end_block())
          return trace_log->get_block_id(block_num);
       if (chain_state_log && block_num >= chain_state_log->begin_block() && block_num < chain_state_log->end_block())
          return chain_state_log->get_block_id(block_num);
+      g.unlock();
       try {
          auto block = chain_plug->chain().fetch_block_by_number(block_num);
          if (block)
@@ -170,7 +263,9 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
       bool                                       sent_abi = false;
       std::vector<std::vector<char>>             send_queue;
       fc::optional<get_blocks_request_v0>        current_request;
+      fc::optional<state_history_filter>         filter;
       bool                                       need_to_send_update = false;
+      bool                                       fetching            = false; // entries are read on a reader thread
 
       session(std::shared_ptr<state_history_plugin_impl> plugin)
           : plugin(std::move(plugin)) {}
@@ -218,7 +313,7 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
       }
 
       void send() {
-         if (sending)
+         if (sending || fetching)
             return;
          if (send_queue.empty())
             return send_update();
@@ -242,6 +337,7 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
          get_status_result_v0 result;
          result.head              = {chain.head_block_num(), chain.head_block_id()};
          result.last_irreversible = {chain.last_irreversible_block_num(), chain.last_irreversible_block_id()};
+         std::lock_guard<std::mutex> g(plugin->log_mtx);
          if (plugin->trace_log) {
             result.trace_begin_block = plugin->trace_log->begin_block();
             result.trace_end_block   = plugin->trace_log->end_block();
@@ -254,6 +350,18 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
       }
 
       void operator()(get_blocks_request_v0& req) {
+         filter.reset();
+         start_blocks(req);
+      }
+
+      void operator()(get_blocks_request_v1& req) {
+         filter.reset();
+         if (!req.filter_contracts.empty())
+            filter.emplace(req);
+         start_blocks(req);
+      }
+
+      void start_blocks(get_blocks_request_v0& req) {
          for (auto& cp : req.have_positions) {
             if (req.start_block_num <= cp.block_num)
                continue;
@@ -275,14 +383,16 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
 
       void send_update(get_blocks_result_v0 result) {
          need_to_send_update = true;
-         if (!send_queue.empty() || !current_request || !current_request->max_messages_in_flight)
+         if (fetching || !send_queue.empty() || !current_request || !current_request->max_messages_in_flight)
             return;
          auto& chain = plugin->chain_plug->chain();
          result.last_irreversible = {chain.last_irreversible_block_num(), chain.last_irreversible_block_id()};
          uint32_t current =
                current_request->irreversible_only ? result.last_irreversible.block_num : result.head.block_num;
+         const uint32_t stored_end = plugin->stored_end_block(*current_request);
          if (current_request->start_block_num <= current &&
-             current_request->start_block_num < current_request->end_block_num) {
+             current_request->start_block_num < current_request->end_block_num &&
+             current_request->start_block_num < stored_end) {
             auto block_id = plugin->get_block_id(current_request->start_block_num);
             if (block_id) {
                result.this_block  = block_position{current_request->start_block_num, *block_id};
@@ -291,22 +401,65 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
                   result.prev_block = block_position{current_request->start_block_num - 1, *prev_block_id};
                if (current_request->fetch_block)
                   plugin->get_block(current_request->start_block_num, result.block);
-               if (current_request->fetch_traces && plugin->trace_log)
-                  plugin->get_log_entry(*plugin->trace_log, current_request->start_block_num, result.traces);
-               if (current_request->fetch_deltas && plugin->chain_state_log)
-                  plugin->get_log_entry(*plugin->chain_state_log, current_request->start_block_num, result.deltas);
+               bool fetch_traces = current_request->fetch_traces && plugin->trace_log;
+               bool fetch_deltas = current_request->fetch_deltas && plugin->chain_state_log;
+               if (fetch_traces || fetch_deltas) {
+                  fetch_entries(std::move(result), current_request->start_block_num, fetch_traces, fetch_deltas);
+                  ++current_request->start_block_num;
+                  --current_request->max_messages_in_flight;
+                  return;
+               }
             }
             ++current_request->start_block_num;
          }
          send(std::move(result));
          --current_request->max_messages_in_flight;
          need_to_send_update = current_request->start_block_num <= current &&
-                               current_request->start_block_num < current_request->end_block_num;
+                               current_request->start_block_num < current_request->end_block_num &&
+                               current_request->start_block_num < stored_end;
+      }
+
+      // reads, decompresses and filters the entries on a reader thread, the result is queued on the main thread
+      void fetch_entries(get_blocks_result_v0 result, uint32_t block_num, bool fetch_traces, bool fetch_deltas) {
+         fetching            = true;
+         need_to_send_update = true;
+         boost::asio::post(plugin->reader_pool->get_executor(), [self = shared_from_this(), result = std::move(result),
+                                                                 block_num, fetch_traces, fetch_deltas,
+                                                                 filter = filter]() mutable {
+            auto& plugin = *self->plugin;
+            bytes packed;
+            std::exception_ptr error;
+            try {
+               if (fetch_traces)
+                  plugin.get_log_entry(*plugin.trace_log, plugin.trace_cache, block_num, result.traces);
+               if (fetch_deltas)
+                  plugin.get_log_entry(*plugin.chain_state_log, plugin.chain_state_cache, block_num, result.deltas);
+               if (filter && result.traces)
+                  result.traces =
+                      filter->filter_traces(*result.traces, plugin.get_ship_abi(), plugin.abi_serializer_max_time);
+               if (filter && result.deltas)
+                  result.deltas = filter->filter_deltas(*result.deltas);
+               packed = fc::raw::pack(state_result{std::move(result)});
+            } catch (...) {
+               error = std::current_exception();
+            }
+            app().post(priority::medium, [self, packed = std::move(packed), error]() mutable {
+               if (self->plugin->stopping)
+                  return;
+               self->fetching = false;
+               self->catch_and_close([&] {
+                  if (error)
+                     std::rethrow_exception(error);
+                  self->send_queue.push_back(std::move(packed));
+                  self->send();
+               });
+            });
+         });
       }
 
       void send_update(const block_state_ptr& block_state) {
          need_to_send_update = true;
-         if (!send_queue.empty() || !current_request || !current_request->max_messages_in_flight)
+         if (fetching || !send_queue.empty() || !current_request || !current_request->max_messages_in_flight)
             return;
          get_blocks_result_v0 result;
          result.head = {block_state->block_num, block_state->id};
@@ -316,7 +469,7 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
       void send_update(bool changed = false) {
          if (changed)
             need_to_send_update = true;
-         if (!send_queue.empty() || !need_to_send_update || !current_request ||
+         if (fetching || !send_queue.empty() || !need_to_send_update || !current_request ||
              !current_request->max_messages_in_flight)
             return;
          auto& chain = plugin->chain_plug->chain();
@@ -423,8 +576,44 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
    }
 
    void on_accepted_block(const block_state_ptr& block_state) {
-      store_traces(block_state);
-      store_chain_state(block_state);
+      chain::scoped_span span("accepted_block", "state_history_plugin", block_state->block_num);
+      auto traces = get_traces(block_state);
+      auto deltas = get_deltas(block_state);
+      {
+         std::unique_lock<std::mutex> g(queue_mtx);
+         queue_cv.wait(g, [this]() { return queued_blocks < max_queued_blocks; });
+         ++queued_blocks;
+      }
+      boost::asio::post(writer_pool->get_executor(), [this, self = shared_from_this(), block_state,
+                                                      traces = std::move(traces), deltas = std::move(deltas)]() {
+         catch_and_log([&] {
+            if (traces)
+               store_traces(block_state, *traces);
+            if (deltas)
+               store_chain_state(block_state, *deltas);
+         });
+         {
+            std::lock_guard<std::mutex> g(queue_mtx);
+            --queued_blocks;
+         }
+         queue_cv.notify_one();
+         app().post(priority::medium, [self, block_state]() {
+            if (!self->stopping)
+               self->notify_sessions(block_state);
+         });
+      });
+   }
+
+   // waits for the writer thread to store the queued blocks
+   void drain_writer() {
+      if (!writer_pool)
+         return;
+      std::promise<void> done;
+      boost::asio::post(writer_pool->get_executor(), [&done]() { done.set_value(); });
+      done.get_future().wait();
+   }
+
+   void notify_sessions(const block_state_ptr& block_state) {
       for (auto& s : sessions) {
          auto& p = s.second;
          if (p) {
@@ -444,9 +633,9 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
       onblock_trace.reset();
    }
 
-   void store_traces(const block_state_ptr& block_state) {
+   fc::optional<std::vector<augmented_transaction_trace>> get_traces(const block_state_ptr& block_state) {
       if (!trace_log)
-         return;
+         return {};
       std::vector<augmented_transaction_trace> traces;
       if (onblock_trace)
          traces.push_back(*onblock_trace);
@@ -462,26 +651,32 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
          traces.push_back(it->second);
       }
       clear_caches();
+      return traces;
+   }
 
+   // on the writer thread, the serialization of traces does not read the database
+   void store_traces(const block_state_ptr& block_state, const std::vector<augmented_transaction_trace>& traces) {
       auto& db         = chain_plug->chain().db();
-      auto  traces_bin = zlib_compress_bytes(fc::raw::pack(make_history_context_wrapper(db, trace_debug_mode, traces)));
-      EOS_ASSERT(traces_bin.size() == (uint32_t)traces_bin.size(), plugin_exception, "traces is too big");
+      auto  payload    = state_history::pack_payload(
+          fc::raw::pack(make_history_context_wrapper(db, trace_debug_mode, traces)), compression, zlib_level);
 
       state_history_log_header header{.magic        = ship_magic(ship_current_version),
                                       .block_id     = block_state->block->id(),
-                                      .payload_size = sizeof(uint32_t) + traces_bin.size()};
-      trace_log->write_entry(header, block_state->block->previous, [&](auto& stream) {
-         uint32_t s = (uint32_t)traces_bin.size();
-         stream.write((char*)&s, sizeof(s));
-         if (!traces_bin.empty())
-            stream.write(traces_bin.data(), traces_bin.size());
-      });
+                                      .payload_size = payload.size()};
+      std::lock_guard<std::mutex> g(log_mtx);
+      trace_log->write_entry(header, block_state->block->previous,
+                             [&](auto& stream) { stream.write(payload.data(), payload.size()); });
    }
 
-   void store_chain_state(const block_state_ptr& block_state) {
+   fc::optional<std::vector<table_delta>> get_deltas(const block_state_ptr& block_state) {
       if (!chain_state_log)
-         return;
-      bool fresh = chain_state_log->begin_block() == chain_state_log->end_block();
+         return {};
+      bool fresh;
+      {
+         std::lock_guard<std::mutex> g(queue_mtx);
+         std::lock_guard<std::mutex> lg(log_mtx);
+         fresh = queued_blocks == 0 && chain_state_log->begin_block() == chain_state_log->end_block();
+      }
       if (fresh)
          ilog("Placing initial state in block ${n}", ("n", block_state->block->block_num()));
 
@@ -563,19 +758,19 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
       process_table("resource_usage", db.get_index<resource_limits::resource_usage_index>(), pack_row);
       process_table("resource_limits_state", db.get_index<resource_limits::resource_limits_state_index>(), pack_row);
       process_table("resource_limits_config", db.get_index<resource_limits::resource_limits_config_index>(), pack_row);
+      return deltas;
+   }
 
-      auto deltas_bin = zlib_compress_bytes(fc::raw::pack(deltas));
-      EOS_ASSERT(deltas_bin.size() == (uint32_t)deltas_bin.size(), plugin_exception, "deltas is too big");
+   // on the writer thread
+   void store_chain_state(const block_state_ptr& block_state, const std::vector<table_delta>& deltas) {
+      auto payload = state_history::pack_payload(fc::raw::pack(deltas), compression, zlib_level);
       state_history_log_header header{.magic        = ship_magic(ship_current_version),
                                       .block_id     = block_state->block->id(),
-                                      .payload_size = sizeof(uint32_t) + deltas_bin.size()};
-      chain_state_log->write_entry(header, block_state->block->previous, [&](auto& stream) {
-         uint32_t s = (uint32_t)deltas_bin.size();
-         stream.write((char*)&s, sizeof(s));
-         if (!deltas_bin.empty())
-            stream.write(deltas_bin.data(), deltas_bin.size());
-      });
-   } // store_chain_state
+                                      .payload_size = payload.size()};
+      std::lock_guard<std::mutex> g(log_mtx);
+      chain_state_log->write_entry(header, block_state->block->previous,
+                                   [&](auto& stream) { stream.write(payload.data(), payload.size()); });
+   }
 };   // state_history_plugin_impl
 
 state_history_plugin::state_history_plugin()
@@ -595,6 +790,23 @@ void state_history_plugin::set_program_options(options_description& cli, options
            "your internal network.");
    options("trace-history-debug-mode", bpo::bool_switch()->default_value(false),
            "enable debug mode for trace history");
+   options("state-history-compression", bpo::value<string>()->default_value("zlib"),
+           "compression of new state history entries: zlib or none. Uncompressed entries need more disk space but are "
+           "sent to the consumers without decompressing them. Existing entries are read as they were written.");
+   options("state-history-zlib-level", bpo::value<int>()->default_value(bio::zlib::default_compression),
+           "zlib compression level of new state history entries, 1 (fastest) to 9 (smallest)");
+   options("state-history-read-threads", bpo::value<uint16_t>()->default_value(2),
+           "number of threads reading and decompressing the entries sent to the consumers");
+   options("state-history-cache-size", bpo::value<uint32_t>()->default_value(64),
+           "number of decompressed trace and chain state entries kept for consumers reading the same blocks, 0 to "
+           "disable");
+   options("state-history-map-log", bpo::bool_switch()->default_value(false),
+           "memory map the trace and chain state logs, the entries sent to the consumers are read without system calls");
+   options("state-history-follow-endpoint", bpo::value<string>(),
+           "host:port of the state history endpoint of a trusted node, with chain-state-history enabled, to follow by "
+           "applying the state changes it sends instead of executing the blocks. For a node serving reads only: it "
+           "requires read-mode head or irreversible, executes no transactions and should have no p2p peers, the "
+           "blocks they send can not be applied. It starts from its current state, e.g. a snapshot.");
 }
 
 void state_history_plugin::plugin_initialize(const variables_map& options) {
@@ -604,13 +816,16 @@ void state_history_plugin::plugin_initialize(const variables_map& options) {
 
       my->chain_plug = app().find_plugin<chain_plugin>();
       EOS_ASSERT(my->chain_plug, chain::missing_chain_plugin_exception, "");
+      my->abi_serializer_max_time = my->chain_plug->get_abi_serializer_max_time();
       auto& chain = my->chain_plug->chain();
       my->applied_transaction_connection.emplace(
-          chain.applied_transaction.connect([&](std::tuple<const transaction_trace_ptr&, const signed_transaction&> t) {
+          chain.applied_transaction.connect(chain::timed_slot("applied_transaction", "state_history_plugin",
+                [&](std::tuple<const transaction_trace_ptr&, const signed_transaction&> t) {
              my->on_applied_transaction(std::get<0>(t), std::get<1>(t));
-          }));
+          })));
       my->accepted_block_connection.emplace(
-          chain.accepted_block.connect([&](const block_state_ptr& p) { my->on_accepted_block(p); }));
+          chain.accepted_block.connect(chain::timed_slot("accepted_block", "state_history_plugin",
+                [&](const block_state_ptr& p) { my->on_accepted_block(p); })));
       my->block_start_connection.emplace(
           chain.block_start.connect([&](uint32_t block_num) { my->on_block_start(block_num); }));
 
@@ -638,25 +853,75 @@ void state_history_plugin::plugin_initialize(const variables_map& options) {
          my->trace_debug_mode = true;
       }
 
+      const auto compression = options.at("state-history-compression").as<string>();
+      if (compression == "none")
+         my->compression = state_history_compression::none;
+      else
+         EOS_ASSERT(compression == "zlib", plugin_config_exception,
+                    "unknown state-history-compression ${c}", ("c", compression));
+      my->zlib_level = options.at("state-history-zlib-level").as<int>();
+      EOS_ASSERT(my->zlib_level == bio::zlib::default_compression || (my->zlib_level >= 1 && my->zlib_level <= 9),
+                 plugin_config_exception, "state-history-zlib-level must be 1 to 9");
+
+      const bool map_log = options.at("state-history-map-log").as<bool>();
       if (options.at("trace-history").as<bool>())
          my->trace_log.emplace("trace_history", (state_history_dir / "trace_history.log").string(),
-                               (state_history_dir / "trace_history.index").string());
+                               (state_history_dir / "trace_history.index").string(), map_log);
       if (options.at("chain-state-history").as<bool>())
          my->chain_state_log.emplace("chain_state_history", (state_history_dir / "chain_state_history.log").string(),
-                                     (state_history_dir / "chain_state_history.index").string());
+                                     (state_history_dir / "chain_state_history.index").string(), map_log);
+      // a single thread keeps the entries in block order
+      my->writer_pool.emplace("ship", 1);
+
+      const auto read_threads = options.at("state-history-read-threads").as<uint16_t>();
+      EOS_ASSERT(read_threads > 0, plugin_config_exception, "state-history-read-threads must be at least 1");
+      my->reader_pool.emplace("shipr", read_threads);
+      const auto cache_size = options.at("state-history-cache-size").as<uint32_t>();
+      my->trace_cache.emplace(cache_size);
+      my->chain_state_cache.emplace(cache_size);
+      // the reader threads share the abi, it is never modified after this
+      my->ship_abi.emplace(fc::json::from_string(state_history_plugin_abi).as<abi_def>(),
+                           abi_serializer::create_yield_function(my->abi_serializer_max_time));
+
+      if (options.count("state-history-follow-endpoint")) {
+         const auto read_mode = chain.get_read_mode();
+         EOS_ASSERT(read_mode == db_read_mode::HEAD || read_mode == db_read_mode::IRREVERSIBLE, plugin_config_exception,
+                    "state-history-follow-endpoint requires read-mode head or irreversible");
+         EOS_ASSERT(!options.at("api-accept-transactions").as<bool>() || read_mode == db_read_mode::IRREVERSIBLE,
+                    plugin_config_exception, "state-history-follow-endpoint requires api-accept-transactions = false");
+         EOS_ASSERT(!options.count("p2p-accept-transactions") || !options.at("p2p-accept-transactions").as<bool>() ||
+                        read_mode == db_read_mode::IRREVERSIBLE,
+                    plugin_config_exception, "state-history-follow-endpoint requires p2p-accept-transactions = false");
+         const auto follow = options.at("state-history-follow-endpoint").as<string>();
+         const auto colon  = follow.rfind(':');
+         EOS_ASSERT(colon != string::npos && colon > 0 && colon + 1 < follow.size(), plugin_config_exception,
+                    "invalid state-history-follow-endpoint ${e}, expected host:port", ("e", follow));
+         my->follower = std::make_shared<state_history_follower>(*my->chain_plug, follow.substr(0, colon),
+                                                                 follow.substr(colon + 1));
+      }
    }
    FC_LOG_AND_RETHROW()
 } // state_history_plugin::plugin_initialize
 
-void state_history_plugin::plugin_startup() { my->listen(); }
+void state_history_plugin::plugin_startup() {
+   my->listen();
+   // the chain has replayed its blocks log by now, the blocks it applies from here on come from the endpoint
+   if (my->follower)
+      my->follower->start();
+}
 
 void state_history_plugin::plugin_shutdown() {
+   if (my->follower)
+      my->follower->stop();
    my->applied_transaction_connection.reset();
    my->accepted_block_connection.reset();
    my->block_start_connection.reset();
+   my->drain_writer();
+   my->writer_pool.reset();
+   my->stopping = true;
+   my->reader_pool.reset();
    while (!my->sessions.empty())
       my->sessions.begin()->second->close();
-   my->stopping = true;
 }
 
 } // namespace eosio
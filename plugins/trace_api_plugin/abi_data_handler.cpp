@@ -1,17 +1,20 @@
 #include <eosio/trace_api/abi_data_handler.hpp>
 #include <eosio/chain/abi_serializer.hpp>
+#include <fc/io/raw.hpp>
 
 namespace eosio::trace_api {
 
    void abi_data_handler::add_abi( const chain::name& name, const chain::abi_def& abi ) {
       // currently abis are operator provided so no need to protect against abuse
-      abi_serializer_by_account.emplace(name,
-            std::make_shared<chain::abi_serializer>(abi, chain::abi_serializer::create_yield_function(fc::microseconds::maximum())));
+      abi_serializer_by_account.emplace(name, account_abi{
+            std::make_shared<chain::abi_serializer>(abi, chain::abi_serializer::create_yield_function(fc::microseconds::maximum())),
+            chain::abi_version{0, fc::sha256::hash(fc::raw::pack(abi))}});
    }
 
    fc::variant abi_data_handler::process_data(const action_trace_v0& action, const yield_function& yield ) {
       if (abi_serializer_by_account.count(action.account) > 0) {
-         const auto& serializer_p = abi_serializer_by_account.at(action.account);
+         const auto& account_abi = abi_serializer_by_account.at(action.account);
+         const auto& serializer_p = account_abi.serializer;
          auto type_name = serializer_p->get_action_type(action.action);
 
          if (!type_name.empty()) {
@@ -22,7 +25,11 @@ namespace eosio::trace_api {
                   EOS_ASSERT( recursion_depth < chain::abi_serializer::max_recursion_depth, chain::abi_recursion_depth_exception,
                               "exceeded max_recursion_depth ${r} ", ("r", chain::abi_serializer::max_recursion_depth) );
                };
-               return serializer_p->binary_to_variant(type_name, action.data, abi_yield);
+               auto decode = [&]() { return serializer_p->binary_to_variant(type_name, action.data, abi_yield); };
+               auto& cache = chain::decoded_action_cache::instance();
+               if (!cache.enabled())
+                  return decode();
+               return cache.get_or_decode(chain::decoded_action_cache::make_key(action.account, account_abi.version, action.action, action.data), decode);
             } catch (...) {
                except_handler(MAKE_EXCEPTION_WITH_CONTEXT(std::current_exception()));
             }
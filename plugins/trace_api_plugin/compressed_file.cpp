@@ -1,5 +1,8 @@
 #include <eosio/trace_api/compressed_file.hpp>
 
+#include <limits>
+#include <optional>
+
 #include <zlib.h>
 
 namespace {
@@ -21,7 +24,8 @@ namespace eosio::trace_api {
 
 struct compressed_file_impl {
    static constexpr size_t read_buffer_size = 4*1024;
-   static constexpr size_t compressed_buffer_size = 4*1024;
+   static constexpr size_t compressed_buffer_size = 64*1024;
+   static constexpr size_t discard_buffer_size = 64*1024;
 
    ~compressed_file_impl()
    {
@@ -117,31 +121,34 @@ struct compressed_file_impl {
 
       long remaining = loc;
 
-      // read in the seek point map
-      file.seek_end(-expected_seek_point_count_size);
-      seek_point_count_type seek_point_count = 0;
-      file.read(reinterpret_cast<char*>(&seek_point_count), sizeof(seek_point_count));
-
-      if (seek_point_count > 0) {
-         int seek_map_size = sizeof(seek_point_entry) * seek_point_count;
-         file.seek_end(-expected_seek_point_count_size - seek_map_size);
-
-         std::vector<seek_point_entry> seek_point_map(seek_point_count);
-         file.read(reinterpret_cast<char*>(seek_point_map.data()), seek_point_map.size() * sizeof(seek_point_entry));
+      // read in the seek point map once, it does not change for the life of the file
+      if (!seek_point_map) {
+         file.seek_end(-expected_seek_point_count_size);
+         seek_point_count_type seek_point_count = 0;
+         file.read(reinterpret_cast<char*>(&seek_point_count), sizeof(seek_point_count));
+
+         seek_point_map.emplace(seek_point_count);
+         if (seek_point_count > 0) {
+            int seek_map_size = sizeof(seek_point_entry) * seek_point_count;
+            file.seek_end(-expected_seek_point_count_size - seek_map_size);
+            file.read(reinterpret_cast<char*>(seek_point_map->data()), seek_point_map->size() * sizeof(seek_point_entry));
+         }
+      }
 
+      if (!seek_point_map->empty()) {
          // seek to the neareast seek point
-         auto iter = std::lower_bound(seek_point_map.begin(), seek_point_map.end(), (uint64_t)loc, []( const auto& lhs, const auto& rhs ){
+         auto iter = std::lower_bound(seek_point_map->begin(), seek_point_map->end(), (uint64_t)loc, []( const auto& lhs, const auto& rhs ){
             return std::get<0>(lhs) < rhs;
          });
 
          // special case when there is a seek point that is exact
-         if ( iter != seek_point_map.end() && std::get<0>(*iter) == loc ) {
+         if ( iter != seek_point_map->end() && std::get<0>(*iter) == loc ) {
             file.seek(std::get<1>(*iter));
             return;
          }
 
          // special case when this is before the first seek point
-         if ( iter == seek_point_map.begin() ) {
+         if ( iter == seek_point_map->begin() ) {
             file.seek(0);
          } else {
             // if lower bound wasn't exact iter will be one past the seek point we need
@@ -153,16 +160,22 @@ struct compressed_file_impl {
          file.seek(0);
       }
 
-      // read up to the expected offset
+      // read up to the expected offset, through a bounded buffer as the seek points can be megabytes apart
       if (remaining > 0) {
-         auto pre_read_buffer = std::vector<char>(remaining);
-         read(pre_read_buffer.data(), pre_read_buffer.size(), file);
+         discard_buffer.resize(std::min<size_t>(remaining, discard_buffer_size));
+         while (remaining > 0) {
+            const auto to_read = std::min<size_t>(remaining, discard_buffer.size());
+            read(discard_buffer.data(), to_read, file);
+            remaining -= to_read;
+         }
       }
    }
 
    z_stream strm;
    std::vector<uint8_t> compressed_buffer = std::vector<uint8_t>(compressed_buffer_size);
    std::vector<uint8_t> read_buffer = std::vector<uint8_t>(read_buffer_size);
+   std::vector<char> discard_buffer;
+   std::optional<std::vector<seek_point_entry>> seek_point_map;
    size_t remaining_read_buffer = 0;
    bool initialized = false;
    size_t file_size = 0;
@@ -204,6 +217,12 @@ bool compressed_file::process( const fc::path& input_path, const fc::path& outpu
       throw std::ios_base::failure(std::string("Attempting to create compressed_file from file that is empty: ") + input_path.generic_string());
    }
 
+   // the seek point count is stored in 16 bits, widen the stride of a file too large for that many seek points
+   const size_t max_seek_points = std::numeric_limits<seek_point_count_type>::max();
+   if ((input_size - 1) / seek_point_stride > max_seek_points) {
+      seek_point_stride = (input_size - 1) / max_seek_points + 1;
+   }
+
    // subtract 1 to make sure that the truncated division will only create a seek point if there is at least one byte
    // in the next stride.  So, a file size of N and a stride >= N results in 0 seek points.  N + 1 will have a seek
    // point for the last byte as will XN + 1 which will create X seek points (the last of which is for the last byte)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <eosio/chain/abi_def.hpp>
+#include <eosio/chain/decoded_action_cache.hpp>
 #include <eosio/trace_api/trace.hpp>
 #include <eosio/trace_api/common.hpp>
 
@@ -56,7 +57,12 @@ namespace eosio {
       };
 
    private:
-      std::map<chain::name, std::shared_ptr<chain::abi_serializer>> abi_serializer_by_account;
+      struct account_abi {
+         std::shared_ptr<chain::abi_serializer> serializer;
+         chain::abi_version                     version; ///< abi_sequence 0, the ABI is operator provided
+      };
+
+      std::map<chain::name, account_abi> abi_serializer_by_account;
       exception_handler except_handler;
    };
 } }
@@ -6,6 +6,7 @@
 #include <exception>
 #include <functional>
 #include <map>
+#include <vector>
 
 namespace eosio { namespace trace_api {
 
@@ -15,14 +16,20 @@ using chain::packed_transaction;
 template <typename StoreProvider>
 class chain_extraction_impl_type {
 public:
+   /// runs the tasks it is given one after the other, in the order given
+   using post_function = std::function<void(std::function<void()>)>;
+
    /**
     * Chain Extractor for capturing transaction traces, action traces, and block info.
     * @param store provider of append & append_lib
     * @param except_handler called on exceptions, logging if any is left to the user
+    * @param post runs the conversion and storage of the traces, e.g. on a thread of their own; empty to run them
+    *             within the signal handlers
     */
-   chain_extraction_impl_type( StoreProvider store, exception_handler except_handler )
+   chain_extraction_impl_type( StoreProvider store, exception_handler except_handler, post_function post = {} )
    : store(std::move(store))
    , except_handler(std::move(except_handler))
+   , post(std::move(post))
    {}
 
    /// connect to chain controller applied_transaction signal
@@ -82,12 +89,11 @@ private:
 
    void store_block_trace( const chain::block_state_ptr& block_state ) {
       try {
-         block_trace_v1 bt = create_block_trace_v1( block_state );
-
-         std::vector<transaction_trace_v1>& traces = bt.transactions_v1;
+         // only the traces of the block are picked here, they are converted and stored by run
+         std::vector<cache_trace> traces;
          traces.reserve( block_state->block->transactions.size() + 1 );
          if( onblock_trace )
-            traces.emplace_back( to_transaction_trace_v1( *onblock_trace ));
+            traces.emplace_back( std::move( *onblock_trace ));
          for( const auto& r : block_state->block->transactions ) {
             transaction_id_type id;
             if( r.trx.contains<transaction_id_type>()) {
@@ -97,12 +103,18 @@ private:
             }
             const auto it = cached_traces.find( id );
             if( it != cached_traces.end() ) {
-               traces.emplace_back( to_transaction_trace_v1( it->second ));
+               traces.emplace_back( std::move( it->second ));
             }
          }
          clear_caches();
 
-         store.append( std::move( bt ) );
+         run( [this, block_state, traces{std::move( traces )}]() {
+            block_trace_v1 bt = create_block_trace_v1( block_state );
+            bt.transactions_v1.reserve( traces.size() );
+            for( const auto& t : traces )
+               bt.transactions_v1.emplace_back( to_transaction_trace_v1( t ));
+            store.append( std::move( bt ) );
+         } );
 
       } catch( ... ) {
          except_handler( MAKE_EXCEPTION_WITH_CONTEXT( std::current_exception() ) );
@@ -110,16 +122,31 @@ private:
    }
 
    void store_lib( const chain::block_state_ptr& bsp ) {
-      try {
-         store.append_lib( bsp->block_num );
-      } catch( ... ) {
-         except_handler( MAKE_EXCEPTION_WITH_CONTEXT( std::current_exception() ) );
+      run( [this, block_num = bsp->block_num]() {
+         store.append_lib( block_num );
+      } );
+   }
+
+   /// through post when there is one, so block traces and LIB markers are stored in the order of the signals
+   void run( std::function<void()> f ) {
+      auto task = [this, f{std::move( f )}]() {
+         try {
+            f();
+         } catch( ... ) {
+            except_handler( MAKE_EXCEPTION_WITH_CONTEXT( std::current_exception() ) );
+         }
+      };
+      if( post ) {
+         post( std::move( task ) );
+      } else {
+         task();
       }
    }
 
 private:
    StoreProvider                                                store;
    exception_handler                                            except_handler;
+   post_function                                                post;
    std::map<transaction_id_type, cache_trace>                   cached_traces;
    fc::optional<cache_trace>                                    onblock_trace;
 
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace eosio::trace_api {
+
+   /**
+    * A read-only memory mapping of a whole slice file
+    */
+   class mapped_slice {
+   public:
+      explicit mapped_slice( const boost::filesystem::path& path );
+
+      const char* data() const { return static_cast<const char*>(region.get_address()); }
+      size_t size() const { return region.get_size(); }
+
+   private:
+      boost::interprocess::file_mapping  mapping;
+      boost::interprocess::mapped_region region;
+   };
+
+   /**
+    * LRU of memory mapped slice files shared by all of the threads reading the slice directory, so reading a block
+    * from an uncompressed slice does not open, seek and read the files again.
+    *
+    * Every lookup checks the size of the file, a file which was removed is dropped from the cache and a file which
+    * grew since it was mapped is mapped again.
+    */
+   class mapped_slice_cache {
+   public:
+      using mapped_slice_ptr = std::shared_ptr<const mapped_slice>;
+
+      /**
+       * @param max_size : the maximum number of mapped files, 0 disables the cache
+       */
+      explicit mapped_slice_cache( size_t max_size )
+      :max_size(max_size)
+      {}
+
+      bool enabled() const { return max_size > 0; }
+
+      /**
+       * Map a slice file or return its existing mapping
+       *
+       * @param path : path of the slice file
+       * @return the mapping of the whole file, nullptr if the file does not exist or is empty
+       */
+      mapped_slice_ptr get( const boost::filesystem::path& path );
+
+      /**
+       * Drop the mapping of a slice file, readers still holding it keep it valid
+       *
+       * @param path : path of the slice file
+       */
+      void erase( const boost::filesystem::path& path );
+
+   private:
+      struct entry {
+         std::string      path;
+         mapped_slice_ptr slice;
+      };
+      using lru_list = std::list<entry>;
+
+      void erase_locked( const std::string& path );
+
+      const size_t                                        max_size;
+      std::mutex                                          mtx;
+      lru_list                                            lru; // most recently used first
+      std::unordered_map<std::string, lru_list::iterator> by_path;
+   };
+}
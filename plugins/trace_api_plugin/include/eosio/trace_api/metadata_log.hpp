@@ -20,7 +20,19 @@ namespace eosio { namespace trace_api {
       lib_entry_v0
    >;
 
+   /**
+    * Entry of the transaction id slice, fixed size so a sorted slice can be binary searched
+    */
+   struct trx_id_entry_v0 {
+      chain::transaction_id_type id;
+      uint32_t                   block_num = 0;
+      uint64_t                   offset = 0; // of the block trace in the trace slice
+
+      static constexpr uint64_t packed_size = sizeof(chain::transaction_id_type) + sizeof(uint32_t) + sizeof(uint64_t);
+   };
+
 }}
 
 FC_REFLECT(eosio::trace_api::block_entry_v0, (id)(number)(offset));
 FC_REFLECT(eosio::trace_api::lib_entry_v0, (lib));
+FC_REFLECT(eosio::trace_api::trx_id_entry_v0, (id)(block_num)(offset));
@@ -12,6 +12,8 @@ namespace eosio::trace_api {
       class response_formatter {
       public:
          static fc::variant process_block( const data_log_entry& trace, bool irreversible, const data_handler_function& data_handler, const yield_function& yield );
+         static std::string write_block( const data_log_entry& trace, bool irreversible, const data_handler_function& data_handler, const yield_function& yield );
+         static fc::variant process_transaction( const data_log_entry& trace, const chain::transaction_id_type& trx_id, bool irreversible, const data_handler_function& data_handler, const yield_function& yield );
       };
    }
 
@@ -50,6 +52,57 @@ namespace eosio::trace_api {
          return detail::response_formatter::process_block(std::get<0>(*data), std::get<1>(*data), data_handler, yield);
       }
 
+      /**
+       * Fetch the trace for a given block height and write it as JSON directly, producing the same document as
+       * `fc::json::to_string` of `get_block_trace` without building the variants of its transactions and actions
+       *
+       * @param block_height - the height of the block whose trace is requested
+       * @param yield - a yield function to allow cooperation during long running tasks
+       * @return the JSON encoded trace for the given block height if it exists, an empty optional otherwise.
+       * @throws yield_exception if a call to `yield` throws.
+       * @throws bad_data_exception when there are issues with the underlying data preventing processing.
+       */
+      std::optional<std::string> get_block_trace_json( uint32_t block_height, const yield_function& yield = {}) {
+         auto data = logfile_provider.get_block(block_height, yield);
+         if (!data) {
+            return {};
+         }
+
+         yield();
+
+         auto data_handler = [this](const action_trace_v0& action, const yield_function& yield) -> fc::variant {
+            return data_handler_provider.process_data(action, yield);
+         };
+
+         return detail::response_formatter::write_block(std::get<0>(*data), std::get<1>(*data), data_handler, yield);
+      }
+
+      /**
+       * Fetch the trace of a given transaction and convert it to a fc::variant for conversion to a final format
+       * (eg JSON)
+       *
+       * @param trx_id - the id of the transaction whose trace is requested
+       * @param yield - a yield function to allow cooperation during long running tasks
+       * @return a properly formatted variant representing the trace of the transaction and the block including it if
+       * it exists, an empty variant otherwise.
+       * @throws yield_exception if a call to `yield` throws.
+       * @throws bad_data_exception when there are issues with the underlying data preventing processing.
+       */
+      fc::variant get_transaction_trace( const chain::transaction_id_type& trx_id, const yield_function& yield = {}) {
+         auto data = logfile_provider.get_trx_block(trx_id, yield);
+         if (!data) {
+            return {};
+         }
+
+         yield();
+
+         auto data_handler = [this](const action_trace_v0& action, const yield_function& yield) -> fc::variant {
+            return data_handler_provider.process_data(action, yield);
+         };
+
+         return detail::response_formatter::process_transaction(std::get<0>(*data), trx_id, std::get<1>(*data), data_handler, yield);
+      }
+
    private:
       LogfileProvider logfile_provider;
       DataHandlerProvider data_handler_provider;
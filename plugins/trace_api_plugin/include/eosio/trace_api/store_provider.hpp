@@ -7,10 +7,12 @@
 #include <fc/io/cfile.hpp>
 #include <boost/filesystem.hpp>
 #include <fc/variant.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <eosio/trace_api/common.hpp>
 #include <eosio/trace_api/metadata_log.hpp>
 #include <eosio/trace_api/data_log.hpp>
 #include <eosio/trace_api/compressed_file.hpp>
+#include <eosio/trace_api/mapped_slice_cache.hpp>
 
 namespace eosio::trace_api {
    using namespace boost::filesystem;
@@ -99,9 +101,24 @@ namespace eosio::trace_api {
          uint32_t version;
       };
 
+      /**
+       * Progress of the background maintenance, used to size the maintenance worker pool
+       */
+      struct maintenance_status {
+         uint32_t         best_known_lib = 0;
+         uint32_t         processed_lib = 0;     // lib of the last completed maintenance run
+         uint32_t         queued_tasks = 0;      // slice removals and compressions waiting for a worker
+         uint64_t         removed_slices = 0;
+         uint64_t         compressed_slices = 0;
+         fc::microseconds last_run_duration;
+      };
+
       enum class open_state { read /*read from front to back*/, write /*write to end of file*/ };
       slice_directory(const boost::filesystem::path& slice_dir, uint32_t width, std::optional<uint32_t> minimum_irreversible_history_blocks,
-                      std::optional<uint32_t> minimum_uncompressed_irreversible_history_blocks, size_t compression_seek_point_stride);
+                      std::optional<uint32_t> minimum_uncompressed_irreversible_history_blocks, size_t compression_seek_point_stride,
+                      size_t mapped_slice_cache_size = default_mapped_slice_cache_size);
+
+      static constexpr size_t default_mapped_slice_cache_size = 16;
 
       /**
        * Return the slice number that would include the passed in block_height
@@ -172,6 +189,68 @@ namespace eosio::trace_api {
        */
       std::optional<compressed_file> find_compressed_trace_slice(uint32_t slice_number, bool open_file = true) const;
 
+      /**
+       * Find or create the transaction id file associated with the indicated slice_number
+       *
+       * @param slice_number : slice number of the requested slice file
+       * @param state : indicate if the file is going to be written to (appended) or read
+       * @param trx_id_file : the cfile that will be set to the appropriate slice filename
+       *                      and opened to that file
+       * @return the true if file was found (i.e. already existed)
+       */
+      bool find_or_create_trx_id_slice(uint32_t slice_number, open_state state, fc::cfile& trx_id_file) const;
+
+      /**
+       * Find the transaction id file associated with the indicated slice_number, entries are in the order they were
+       * appended
+       *
+       * @param slice_number : slice number of the requested slice file
+       * @param state : indicate if the file is going to be written to (appended) or read
+       * @param trx_id_file : the cfile that will be set to the appropriate slice filename (always)
+       *                      and opened to that file (if it was found)
+       * @param open_file : indicate if the file should be opened (if found) or not
+       * @return the true if file was found (i.e. already existed)
+       */
+      bool find_trx_id_slice(uint32_t slice_number, open_state state, fc::cfile& trx_id_file, bool open_file = true) const;
+
+      /**
+       * Find the sorted transaction id file associated with the indicated slice_number, it replaces the transaction id
+       * file once the whole slice is irreversible and only holds the entries of the irreversible blocks
+       *
+       * @param slice_number : slice number of the requested slice file
+       * @param trx_id_file : the cfile that will be set to the appropriate slice filename (always)
+       *                      and opened to that file (if it was found)
+       * @param open_file : indicate if the file should be opened (if found) or not
+       * @return the true if file was found (i.e. already existed)
+       */
+      bool find_sorted_trx_id_slice(uint32_t slice_number, fc::cfile& trx_id_file, bool open_file = true) const;
+
+      /**
+       * @return the slice numbers which have a transaction id file, sorted or not, newest first
+       */
+      std::vector<uint32_t> trx_id_slice_numbers() const;
+
+      /**
+       * @return true if the readers use the shared cache of memory mapped slice files
+       */
+      bool mapped_slices_enabled() const { return _mapped_slices.enabled(); }
+
+      /**
+       * Find the index file associated with the indicated slice_number in the shared cache of memory mapped slice files
+       *
+       * @param slice_number : slice number of the requested slice file
+       * @return nullptr if the file was not found, otherwise the mapped file after verifying its header is valid
+       */
+      mapped_slice_cache::mapped_slice_ptr find_mapped_index_slice(uint32_t slice_number) const;
+
+      /**
+       * Find the trace file associated with the indicated slice_number in the shared cache of memory mapped slice files
+       *
+       * @param slice_number : slice number of the requested slice file
+       * @return nullptr if the file was not found or is empty, the mapped file otherwise
+       */
+      mapped_slice_cache::mapped_slice_ptr find_mapped_trace_slice(uint32_t slice_number) const;
+
       /**
        * Find or create a trace and index file pair
        *
@@ -190,8 +269,12 @@ namespace eosio::trace_api {
 
       /**
        * Start a thread which does background maintenance
+       *
+       * @param log : handler of the maintenance progress messages
+       * @param worker_threads : number of threads removing and compressing slices, oldest slices first, with 1 the
+       *                         maintenance thread processes the slices itself
        */
-      void start_maintenance_thread( log_handler log );
+      void start_maintenance_thread( log_handler log, size_t worker_threads = 1 );
 
       /**
        * Stop and join the thread doing background maintenance
@@ -206,6 +289,11 @@ namespace eosio::trace_api {
        */
       void run_maintenance_tasks(uint32_t lib, const log_handler& log);
 
+      /**
+       * @return the progress of the background maintenance
+       */
+      maintenance_status get_maintenance_status() const;
+
    private:
       // returns true if slice is found, slice_file will always be set to the appropriate path for
       // the slice_prefix and slice_number, but will only be opened if found
@@ -217,7 +305,13 @@ namespace eosio::trace_api {
       // take an open index slice file and verify its header is valid and prepare the file to be appended to (or read from)
       void validate_existing_index_slice_file(fc::cfile& index_file, open_state state) const;
 
-      // helper for methods that process irreversible slice files
+      // replace the transaction id file of a slice with the sorted entries of the blocks in its index file
+      void sort_trx_id_slice(uint32_t slice_number, const log_handler& log);
+
+      // the slices after lower_bound_slice whose blocks are all at least min_irreversible blocks below lib, oldest first
+      std::vector<uint32_t> irreversible_slice_range(uint32_t lib, uint32_t min_irreversible, const std::optional<uint32_t>& lower_bound_slice) const;
+
+      // helper for methods that process irreversible slice files, on the worker pool if there is one
       template<typename F>
       void process_irreversible_slice_range(uint32_t lib, uint32_t upper_bound_block, std::optional<uint32_t>& lower_bound_slice, F&& f);
 
@@ -227,13 +321,23 @@ namespace eosio::trace_api {
       std::optional<uint32_t> _last_cleaned_up_slice;
       const std::optional<uint32_t> _minimum_uncompressed_irreversible_history_blocks;
       std::optional<uint32_t> _last_compressed_slice;
+      std::optional<uint32_t> _last_sorted_trx_id_slice;
       const size_t _compression_seek_point_stride;
+      mutable mapped_slice_cache _mapped_slices;
 
       std::atomic<uint32_t> _best_known_lib{0};
       std::mutex _maintenance_mtx;
       std::condition_variable _maintenance_condition;
       std::thread _maintenance_thread;
       std::atomic_bool _maintenance_shutdown{false};
+      size_t _maintenance_threads = 1;
+      std::optional<eosio::chain::named_thread_pool> _maintenance_pool;
+
+      std::atomic<uint32_t> _processed_lib{0};
+      std::atomic<uint32_t> _queued_tasks{0};
+      std::atomic<uint64_t> _removed_slices{0};
+      std::atomic<uint64_t> _compressed_slices{0};
+      std::atomic<int64_t> _last_run_duration_us{0};
    };
 
    /**
@@ -244,7 +348,8 @@ namespace eosio::trace_api {
       using open_state = slice_directory::open_state;
 
       store_provider(const boost::filesystem::path& slice_dir, uint32_t stride_width, std::optional<uint32_t> minimum_irreversible_history_blocks,
-            std::optional<uint32_t> minimum_uncompressed_irreversible_history_blocks, size_t compression_seek_point_stride);
+            std::optional<uint32_t> minimum_uncompressed_irreversible_history_blocks, size_t compression_seek_point_stride,
+            size_t mapped_slice_cache_size = slice_directory::default_mapped_slice_cache_size);
 
       void append(const block_trace_v1& bt);
       void append_lib(uint32_t lib);
@@ -257,13 +362,25 @@ namespace eosio::trace_api {
        */
       get_block_t get_block(uint32_t block_height, const yield_function& yield= {});
 
-      void start_maintenance_thread( log_handler log ) {
-         _slice_directory.start_maintenance_thread( std::move(log) );
+      /**
+       * Read the trace of the block including a given transaction
+       * @param trx_id : the id of the transaction
+       * @return empty optional if no stored block includes the transaction OTHERWISE
+       *         optional containing a 2-tuple of the block_trace and a flag indicating irreversibility
+       */
+      get_block_t get_trx_block(const chain::transaction_id_type& trx_id, const yield_function& yield= {});
+
+      void start_maintenance_thread( log_handler log, size_t worker_threads = 1 ) {
+         _slice_directory.start_maintenance_thread( std::move(log), worker_threads );
       }
       void stop_maintenance_thread() {
          _slice_directory.stop_maintenance_thread();
       }
 
+      slice_directory::maintenance_status get_maintenance_status() const {
+         return _slice_directory.get_maintenance_status();
+      }
+
 
       protected:
       /**
@@ -279,8 +396,31 @@ namespace eosio::trace_api {
       uint64_t scan_metadata_log_from( uint32_t block_height, uint64_t offset, Fn&& fn, const yield_function& yield ) {
          // ignoring offset
          offset = 0;
-         fc::cfile index;
          const uint32_t slice_number = _slice_directory.slice_number(block_height);
+         if( _slice_directory.mapped_slices_enabled() ) {
+            const auto index = _slice_directory.find_mapped_index_slice(slice_number);
+            if( !index ) {
+               return 0;
+            }
+            fc::datastream<const char*> ds(index->data(), index->size());
+            slice_directory::index_header header;
+            fc::raw::unpack(ds, header);
+            offset = ds.tellp();
+            uint64_t last_read_offset = offset;
+            while (offset < index->size()) {
+               yield();
+               metadata_log_entry metadata;
+               fc::raw::unpack(ds, metadata);
+               if(! fn(metadata)) {
+                  break;
+               }
+               last_read_offset = offset;
+               offset = ds.tellp();
+            }
+            return last_read_offset;
+         }
+
+         fc::cfile index;
          const bool found = _slice_directory.find_index_slice(slice_number, open_state::read, index);
          if( !found ) {
             return 0;
@@ -311,6 +451,22 @@ namespace eosio::trace_api {
       std::optional<data_log_entry> read_data_log( uint32_t block_height, uint64_t offset ) {
          const uint32_t slice_number = _slice_directory.slice_number(block_height);
 
+         if( _slice_directory.mapped_slices_enabled() ) {
+            const auto trace = _slice_directory.find_mapped_trace_slice(slice_number);
+            if( trace ) {
+               if( offset >= trace->size() ) {
+                  const std::string offset_str = boost::lexical_cast<std::string>(offset);
+                  const std::string bh_str = boost::lexical_cast<std::string>(block_height);
+                  const std::string end_str = boost::lexical_cast<std::string>(trace->size());
+                  throw malformed_slice_file("Requested offset: " + offset_str + " to retrieve block number: " + bh_str + " but this trace file only goes to offset: " + end_str);
+               }
+               fc::datastream<const char*> ds(trace->data() + offset, trace->size() - offset);
+               data_log_entry entry;
+               fc::raw::unpack(ds, entry);
+               return entry;
+            }
+         }
+
          fc::cfile trace;
          if( !_slice_directory.find_trace_slice(slice_number, open_state::read, trace) ) {
             // attempt to read a compressed trace if one exists
@@ -335,6 +491,14 @@ namespace eosio::trace_api {
          return extract_store<data_log_entry>(trace);
       }
 
+      /**
+       * Binary search a sorted transaction id slice
+       * @param trx_ids : the open sorted transaction id file
+       * @param trx_id : the id of the transaction
+       * @return empty optional if the transaction is not in the slice, its entry otherwise
+       */
+      std::optional<trx_id_entry_v0> find_sorted_trx_id(fc::cfile& trx_ids, const chain::transaction_id_type& trx_id, const yield_function& yield);
+
       /**
        * Initialize a new index slice with a valid header
        * @param index : index file to open and add header to
@@ -0,0 +1,54 @@
+#include <eosio/trace_api/mapped_slice_cache.hpp>
+
+namespace eosio::trace_api {
+   namespace bip = boost::interprocess;
+
+   mapped_slice::mapped_slice( const boost::filesystem::path& path )
+   :mapping(path.generic_string().c_str(), bip::read_only)
+   ,region(mapping, bip::read_only)
+   {}
+
+   mapped_slice_cache::mapped_slice_ptr mapped_slice_cache::get( const boost::filesystem::path& path ) {
+      const std::string key = path.generic_string();
+      boost::system::error_code ec;
+      const auto size = boost::filesystem::file_size(path, ec);
+
+      std::lock_guard<std::mutex> g(mtx);
+      if (ec || size == 0) {
+         erase_locked(key);
+         return {};
+      }
+
+      auto itr = by_path.find(key);
+      if (itr != by_path.end()) {
+         if (itr->second->slice->size() >= size) {
+            lru.splice(lru.begin(), lru, itr->second);
+            return itr->second->slice;
+         }
+         // appended to since it was mapped
+         erase_locked(key);
+      }
+
+      auto slice = std::make_shared<const mapped_slice>(path);
+      lru.push_front(entry{key, slice});
+      by_path.emplace(key, lru.begin());
+      if (lru.size() > max_size) {
+         by_path.erase(lru.back().path);
+         lru.pop_back();
+      }
+      return slice;
+   }
+
+   void mapped_slice_cache::erase( const boost::filesystem::path& path ) {
+      std::lock_guard<std::mutex> g(mtx);
+      erase_locked(path.generic_string());
+   }
+
+   void mapped_slice_cache::erase_locked( const std::string& path ) {
+      auto itr = by_path.find(path);
+      if (itr != by_path.end()) {
+         lru.erase(itr->second);
+         by_path.erase(itr);
+      }
+   }
+}
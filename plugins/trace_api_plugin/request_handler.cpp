@@ -3,6 +3,7 @@
 #include <algorithm>
 
 #include <fc/variant_object.hpp>
+#include <fc/io/json.hpp>
 
 namespace {
    using namespace eosio::trace_api;
@@ -62,40 +63,204 @@ namespace {
 
    }
 
-   fc::variants process_transactions(const std::vector<transaction_trace_v0>& transactions, const data_handler_function& data_handler, const yield_function& yield ) {
+   fc::mutable_variant_object process_transaction(const transaction_trace_v0& t, const data_handler_function& data_handler, const yield_function& yield ) {
+      return fc::mutable_variant_object()
+         ("id", t.id.str())
+         ("actions", process_actions(t.actions, data_handler, yield));
+   }
+
+   fc::mutable_variant_object process_transaction(const transaction_trace_v1& t, const data_handler_function& data_handler, const yield_function& yield ) {
+      return fc::mutable_variant_object()
+         ("id", t.id.str())
+         ("actions", process_actions(t.actions, data_handler, yield))
+         ("status", t.status)
+         ("cpu_usage_us", t.cpu_usage_us)
+         ("net_usage_words", t.net_usage_words)
+         ("signatures", t.signatures)
+         ("transaction_header", t.trx_header);
+   }
+
+   template<typename TransactionTrace>
+   fc::variants process_transactions(const std::vector<TransactionTrace>& transactions, const data_handler_function& data_handler, const yield_function& yield ) {
       fc::variants result;
       result.reserve(transactions.size());
       for ( const auto& t: transactions) {
          yield();
 
-         result.emplace_back(fc::mutable_variant_object()
-            ("id", t.id.str())
-            ("actions", process_actions(t.actions, data_handler, yield))
-         );
+         result.emplace_back(process_transaction(t, data_handler, yield));
       }
 
       return result;
    }
 
-    fc::variants process_transactions(const std::vector<transaction_trace_v1>& transactions, const data_handler_function& data_handler, const yield_function& yield ) {
-        fc::variants result;
-        result.reserve(transactions.size());
-        for ( const auto& t: transactions) {
+   template<typename TransactionTrace>
+   fc::variant process_block_transaction(const block_trace_v0& block, const std::vector<TransactionTrace>& transactions, const eosio::chain::transaction_id_type& trx_id, bool irreversible, const data_handler_function& data_handler, const yield_function& yield ) {
+      for ( const auto& t: transactions) {
+         if (t.id == trx_id) {
+            return process_transaction(t, data_handler, yield)
+               ("block_num", block.number)
+               ("block_id", block.id.str())
+               ("block_time", to_iso8601_datetime(block.timestamp))
+               ("block_status", irreversible ? "irreversible" : "pending");
+         }
+      }
+
+      return {};
+   }
+
+   /**
+    * Appends the JSON encoding of the stored traces to a string the way fc::json::to_string encodes the variants built
+    * above, without building the variants of the transactions and actions.  Strings written directly never need
+    * escaping (names, hex and dates), small values of other types still go through fc::json.
+    */
+   class json_writer {
+   public:
+      explicit json_writer(std::string& out)
+      :out(out)
+      {}
+
+      json_writer& key(const char* k) {
+         separator();
+         out += '"';
+         out += k;
+         out += "\":";
+         need_comma = false;
+         return *this;
+      }
+
+      json_writer& plain_string(const std::string& s) {
+         separator();
+         out += '"';
+         out += s;
+         out += '"';
+         need_comma = true;
+         return *this;
+      }
+
+      // fc::json writes integers larger than 32 bits as strings
+      json_writer& number(uint64_t n) {
+         separator();
+         if (n > 0xffffffff) {
+            out += '"';
+            out += std::to_string(n);
+            out += '"';
+         } else {
+            out += std::to_string(n);
+         }
+         need_comma = true;
+         return *this;
+      }
+
+      json_writer& value(const fc::variant& v) {
+         separator();
+         out += fc::json::to_string(v, fc::time_point::maximum());
+         need_comma = true;
+         return *this;
+      }
+
+      json_writer& begin_object() { return begin('{'); }
+      json_writer& end_object() { return end('}'); }
+      json_writer& begin_array() { return begin('['); }
+      json_writer& end_array() { return end(']'); }
+
+   private:
+      json_writer& begin(char c) {
+         separator();
+         out += c;
+         need_comma = false;
+         return *this;
+      }
+
+      json_writer& end(char c) {
+         out += c;
+         need_comma = true;
+         return *this;
+      }
+
+      void separator() {
+         if (need_comma) {
+            out += ',';
+         }
+      }
+
+      std::string& out;
+      bool need_comma = false;
+   };
+
+   void write_actions(json_writer& w, const std::vector<action_trace_v0>& actions, const data_handler_function& data_handler, const yield_function& yield ) {
+      // same order as process_actions
+      std::vector<int> indices(actions.size());
+      std::iota(indices.begin(), indices.end(), 0);
+      std::sort(indices.begin(), indices.end(), [&actions](const int& lhs, const int& rhs) -> bool {
+         return actions.at(lhs).global_sequence < actions.at(rhs).global_sequence;
+      });
+
+      w.begin_array();
+      for ( int index : indices) {
+         yield();
+
+         const auto& a = actions.at(index);
+         w.begin_object()
+            .key("global_sequence").number(a.global_sequence)
+            .key("receiver").plain_string(a.receiver.to_string())
+            .key("account").plain_string(a.account.to_string())
+            .key("action").plain_string(a.action.to_string())
+            .key("authorization").begin_array();
+         for ( const auto& auth: a.authorization) {
             yield();
-            result.emplace_back(fc::mutable_variant_object()
-               ("id", t.id.str())
-               ("actions", process_actions(t.actions, data_handler, yield))
-               ("status", t.status)
-               ("cpu_usage_us", t.cpu_usage_us)
-               ("net_usage_words", t.net_usage_words)
-               ("signatures", t.signatures)
-               ("transaction_header", t.trx_header)
-            );
-        }
+            w.begin_object()
+               .key("account").plain_string(auth.account.to_string())
+               .key("permission").plain_string(auth.permission.to_string())
+               .end_object();
+         }
+         w.end_array()
+            .key("data").plain_string(fc::to_hex(a.data.data(), a.data.size()));
 
-        return result;
-    }
+         auto params = data_handler(a, yield);
+         if (!params.is_null()) {
+            w.key("params").value(params);
+         }
+         w.end_object();
+      }
+      w.end_array();
+   }
 
+   void write_transaction_fields(json_writer& w, const transaction_trace_v0& t, const data_handler_function& data_handler, const yield_function& yield ) {
+      w.key("id").plain_string(t.id.str())
+         .key("actions");
+      write_actions(w, t.actions, data_handler, yield);
+   }
+
+   void write_transaction_fields(json_writer& w, const transaction_trace_v1& t, const data_handler_function& data_handler, const yield_function& yield ) {
+      write_transaction_fields(w, static_cast<const transaction_trace_v0&>(t), data_handler, yield);
+      w.key("status").value(fc::variant(t.status))
+         .key("cpu_usage_us").number(t.cpu_usage_us)
+         .key("net_usage_words").value(fc::variant(t.net_usage_words))
+         .key("signatures").value(fc::variant(t.signatures))
+         .key("transaction_header").value(fc::variant(t.trx_header));
+   }
+
+   template<typename TransactionTrace>
+   void write_transactions(json_writer& w, const std::vector<TransactionTrace>& transactions, const data_handler_function& data_handler, const yield_function& yield ) {
+      w.begin_array();
+      for ( const auto& t: transactions) {
+         yield();
+
+         w.begin_object();
+         write_transaction_fields(w, t, data_handler, yield);
+         w.end_object();
+      }
+      w.end_array();
+   }
+
+   void write_block_fields(json_writer& w, const block_trace_v0& trace, bool irreversible) {
+      w.key("id").plain_string(trace.id.str())
+         .key("number").number(trace.number)
+         .key("previous_id").plain_string(trace.previous_id.str())
+         .key("status").plain_string(irreversible ? "irreversible" : "pending")
+         .key("timestamp").plain_string(to_iso8601_datetime(trace.timestamp))
+         .key("producer").plain_string(trace.producer.to_string());
+   }
 }
 
 namespace eosio::trace_api::detail {
@@ -127,4 +292,36 @@ namespace eosio::trace_api::detail {
         if (trace.contains<block_trace_v0>()) return process_block_trace(trace.get<block_trace_v0>(), irreversible, data_handler, yield);
         else return process_block_trace(trace.get<block_trace_v1>(), irreversible, data_handler, yield);
     }
+
+    std::string response_formatter::write_block( const data_log_entry& trace, bool irreversible, const data_handler_function& data_handler, const yield_function& yield ) {
+        std::string result;
+        json_writer w(result);
+        w.begin_object();
+        if (trace.contains<block_trace_v0>()) {
+            const auto& block = trace.get<block_trace_v0>();
+            write_block_fields(w, block, irreversible);
+            w.key("transactions");
+            write_transactions(w, block.transactions, data_handler, yield);
+        } else {
+            const auto& block = trace.get<block_trace_v1>();
+            write_block_fields(w, block, irreversible);
+            w.key("transaction_mroot").value(fc::variant(block.transaction_mroot))
+               .key("action_mroot").value(fc::variant(block.action_mroot))
+               .key("schedule_version").number(block.schedule_version)
+               .key("transactions");
+            write_transactions(w, block.transactions_v1, data_handler, yield);
+        }
+        w.end_object();
+        return result;
+    }
+
+    fc::variant response_formatter::process_transaction( const data_log_entry& trace, const chain::transaction_id_type& trx_id, bool irreversible, const data_handler_function& data_handler, const yield_function& yield ) {
+        if (trace.contains<block_trace_v0>()) {
+            const auto& block = trace.get<block_trace_v0>();
+            return process_block_transaction(block, block.transactions, trx_id, irreversible, data_handler, yield);
+        } else {
+            const auto& block = trace.get<block_trace_v1>();
+            return process_block_transaction(block, block.transactions_v1, trx_id, irreversible, data_handler, yield);
+        }
+    }
 }
@@ -3,12 +3,19 @@
 #include <fc/variant_object.hpp>
 #include <fc/log/logger_config.hpp>
 
+#include <algorithm>
+#include <future>
+#include <set>
+#include <unordered_map>
+
 namespace {
       static constexpr uint32_t _current_version = 1;
       static constexpr const char* _trace_prefix = "trace_";
       static constexpr const char* _trace_index_prefix = "trace_index_";
+      static constexpr const char* _trace_trx_id_prefix = "trace_trx_";
       static constexpr const char* _trace_ext = ".log";
       static constexpr const char* _compressed_trace_ext = ".clog";
+      static constexpr const char* _sorted_trx_id_ext = ".slog";
       static constexpr uint _max_filename_size = std::char_traits<char>::length(_trace_index_prefix) + 10 + 1 + 10 + std::char_traits<char>::length(_compressed_trace_ext) + 1; // "trace_index_" + 10-digits + '-' + 10-digits + ".clog" + null-char
 
       std::string make_filename(const char* slice_prefix, const char* slice_ext, uint32_t slice_number, uint32_t slice_width) {
@@ -26,12 +33,23 @@ namespace {
 
          return std::string(filename);
       }
+
+      bool block_includes_trx(const eosio::trace_api::data_log_entry& entry, const eosio::chain::transaction_id_type& trx_id) {
+         using namespace eosio::trace_api;
+         const auto matches = [&trx_id](const auto& t) { return t.id == trx_id; };
+         if (entry.contains<block_trace_v0>()) {
+            const auto& trxs = entry.get<block_trace_v0>().transactions;
+            return std::any_of(trxs.begin(), trxs.end(), matches);
+         }
+         const auto& trxs = entry.get<block_trace_v1>().transactions_v1;
+         return std::any_of(trxs.begin(), trxs.end(), matches);
+      }
 }
 
 namespace eosio::trace_api {
    namespace bfs = boost::filesystem;
-   store_provider::store_provider(const bfs::path& slice_dir, uint32_t stride_width, std::optional<uint32_t> minimum_irreversible_history_blocks, std::optional<uint32_t> minimum_uncompressed_irreversible_history_blocks, size_t compression_seek_point_stride)
-   : _slice_directory(slice_dir, stride_width, minimum_irreversible_history_blocks, minimum_uncompressed_irreversible_history_blocks, compression_seek_point_stride) {
+   store_provider::store_provider(const bfs::path& slice_dir, uint32_t stride_width, std::optional<uint32_t> minimum_irreversible_history_blocks, std::optional<uint32_t> minimum_uncompressed_irreversible_history_blocks, size_t compression_seek_point_stride, size_t mapped_slice_cache_size)
+   : _slice_directory(slice_dir, stride_width, minimum_irreversible_history_blocks, minimum_uncompressed_irreversible_history_blocks, compression_seek_point_stride, mapped_slice_cache_size) {
    }
 
    void store_provider::append(const block_trace_v1& bt) {
@@ -44,6 +62,22 @@ namespace eosio::trace_api {
 
       auto be = metadata_log_entry { block_entry_v0 { .id = bt.id, .number = bt.number, .offset = offset }};
       append_store(be, index);
+
+      if (bt.transactions_v1.empty()) {
+         return;
+      }
+      fc::cfile trx_ids;
+      _slice_directory.find_or_create_trx_id_slice(slice_number, open_state::write, trx_ids);
+      std::vector<char> data;
+      data.reserve(bt.transactions_v1.size() * trx_id_entry_v0::packed_size);
+      for (const auto& t : bt.transactions_v1) {
+         const auto entry = fc::raw::pack(trx_id_entry_v0 { .id = t.id, .block_num = bt.number, .offset = offset });
+         data.insert(data.end(), entry.begin(), entry.end());
+      }
+      // flushed for the readers but not synced, it is off the apply path: a crash can only lose the ids of the last
+      // blocks, which are then not found by get_trx_block, and a partial entry is skipped
+      trx_ids.write(data.data(), data.size());
+      trx_ids.flush();
    }
 
    void store_provider::append_lib(uint32_t lib) {
@@ -83,12 +117,73 @@ namespace eosio::trace_api {
       return std::make_tuple( entry.value(), irreversible );
    }
 
-   slice_directory::slice_directory(const bfs::path& slice_dir, uint32_t width, std::optional<uint32_t> minimum_irreversible_history_blocks, std::optional<uint32_t> minimum_uncompressed_irreversible_history_blocks, size_t compression_seek_point_stride)
+   get_block_t store_provider::get_trx_block(const chain::transaction_id_type& trx_id, const yield_function& yield) {
+      for (const uint32_t slice_number : _slice_directory.trx_id_slice_numbers()) {
+         yield();
+         fc::cfile trx_ids;
+         if (_slice_directory.find_sorted_trx_id_slice(slice_number, trx_ids)) {
+            // only holds the entries of irreversible blocks, the offset is that of the block's trace
+            const auto entry = find_sorted_trx_id(trx_ids, trx_id, yield);
+            if (!entry) {
+               continue;
+            }
+            std::optional<data_log_entry> block = read_data_log(entry->block_num, entry->offset);
+            if (!block) {
+               return get_block_t{};
+            }
+            return std::make_tuple( block.value(), true );
+         }
+
+         if (!_slice_directory.find_trx_id_slice(slice_number, open_state::read, trx_ids)) {
+            continue;
+         }
+         std::vector<uint32_t> block_nums;
+         const uint64_t end = file_size(trx_ids.get_file_path());
+         while (trx_ids.tellp() + trx_id_entry_v0::packed_size <= end) {
+            yield();
+            const auto entry = extract_store<trx_id_entry_v0>(trx_ids);
+            if (entry.id == trx_id) {
+               block_nums.push_back(entry.block_num);
+            }
+         }
+         // newest first, the blocks of older entries may have been forked out
+         for (auto itr = block_nums.rbegin(); itr != block_nums.rend(); ++itr) {
+            auto block = get_block(*itr, yield);
+            if (block && block_includes_trx(std::get<0>(*block), trx_id)) {
+               return block;
+            }
+         }
+      }
+      return get_block_t{};
+   }
+
+   std::optional<trx_id_entry_v0> store_provider::find_sorted_trx_id(fc::cfile& trx_ids, const chain::transaction_id_type& trx_id, const yield_function& yield) {
+      uint64_t low = 0;
+      uint64_t high = file_size(trx_ids.get_file_path()) / trx_id_entry_v0::packed_size;
+      while (low < high) {
+         yield();
+         const uint64_t mid = low + (high - low) / 2;
+         trx_ids.seek(mid * trx_id_entry_v0::packed_size);
+         auto entry = extract_store<trx_id_entry_v0>(trx_ids);
+         if (entry.id == trx_id) {
+            return entry;
+         }
+         if (entry.id < trx_id) {
+            low = mid + 1;
+         } else {
+            high = mid;
+         }
+      }
+      return {};
+   }
+
+   slice_directory::slice_directory(const bfs::path& slice_dir, uint32_t width, std::optional<uint32_t> minimum_irreversible_history_blocks, std::optional<uint32_t> minimum_uncompressed_irreversible_history_blocks, size_t compression_seek_point_stride, size_t mapped_slice_cache_size)
    : _slice_dir(slice_dir)
    , _width(width)
    , _minimum_irreversible_history_blocks(minimum_irreversible_history_blocks)
    , _minimum_uncompressed_irreversible_history_blocks(minimum_uncompressed_irreversible_history_blocks)
    , _compression_seek_point_stride(compression_seek_point_stride)
+   , _mapped_slices(mapped_slice_cache_size)
    , _best_known_lib(0) {
       if (!exists(_slice_dir)) {
          bfs::create_directories(slice_dir);
@@ -131,6 +226,27 @@ namespace eosio::trace_api {
       }
    }
 
+   mapped_slice_cache::mapped_slice_ptr slice_directory::find_mapped_index_slice(uint32_t slice_number) const {
+      const path slice_path = _slice_dir / make_filename(_trace_index_prefix, _trace_ext, slice_number, _width);
+      auto index = _mapped_slices.get(slice_path);
+      if (!index) {
+         return index;
+      }
+
+      fc::datastream<const char*> ds(index->data(), index->size());
+      index_header header;
+      fc::raw::unpack(ds, header);
+      if (header.version != _current_version) {
+         throw old_slice_version("Old slice file with version: " + std::to_string(header.version) +
+                                 " is in directory, only supporting version: " + std::to_string(_current_version));
+      }
+      return index;
+   }
+
+   mapped_slice_cache::mapped_slice_ptr slice_directory::find_mapped_trace_slice(uint32_t slice_number) const {
+      return _mapped_slices.get(_slice_dir / make_filename(_trace_prefix, _trace_ext, slice_number, _width));
+   }
+
    bool slice_directory::find_or_create_trace_slice(uint32_t slice_number, open_state state, fc::cfile& trace_file) const {
       const bool found = find_trace_slice(slice_number, state, trace_file);
 
@@ -174,6 +290,123 @@ namespace eosio::trace_api {
       }
    }
 
+   bool slice_directory::find_or_create_trx_id_slice(uint32_t slice_number, open_state state, fc::cfile& trx_id_file) const {
+      const bool found = find_trx_id_slice(slice_number, state, trx_id_file);
+
+      if( !found ) {
+         trx_id_file.open(fc::cfile::create_or_update_rw_mode);
+      }
+
+      return found;
+   }
+
+   bool slice_directory::find_trx_id_slice(uint32_t slice_number, open_state state, fc::cfile& trx_id_file, bool open_file) const {
+      const bool found = find_slice(_trace_trx_id_prefix, slice_number, trx_id_file, open_file);
+
+      if( !found || !open_file ) {
+         return found;
+      }
+
+      if( state == open_state::write ) {
+         trx_id_file.seek_end(0);
+      }
+      return true;
+   }
+
+   bool slice_directory::find_sorted_trx_id_slice(uint32_t slice_number, fc::cfile& trx_id_file, bool open_file) const {
+      const path slice_path = _slice_dir / make_filename(_trace_trx_id_prefix, _sorted_trx_id_ext, slice_number, _width);
+      trx_id_file.set_file_path(slice_path);
+
+      const bool file_exists = exists(slice_path);
+      if( !file_exists || !open_file ) {
+         return file_exists;
+      }
+
+      trx_id_file.open("rb");
+      return true;
+   }
+
+   std::vector<uint32_t> slice_directory::trx_id_slice_numbers() const {
+      const std::string prefix = _trace_trx_id_prefix;
+      std::set<uint32_t> slice_numbers;
+      for (bfs::directory_iterator itr(_slice_dir); itr != bfs::directory_iterator(); ++itr) {
+         const std::string filename = itr->path().filename().generic_string();
+         const std::string ext = itr->path().extension().generic_string();
+         if (filename.compare(0, prefix.size(), prefix) != 0 || (ext != _trace_ext && ext != _sorted_trx_id_ext)) {
+            continue;
+         }
+         try {
+            slice_numbers.insert(slice_number(std::stoul(filename.substr(prefix.size(), 10))));
+         } catch (const std::logic_error&) {
+            // not a slice file
+         }
+      }
+      return std::vector<uint32_t>(slice_numbers.rbegin(), slice_numbers.rend());
+   }
+
+   void slice_directory::sort_trx_id_slice(uint32_t slice_number, const log_handler& log) {
+      fc::cfile trx_ids;
+      if (!find_trx_id_slice(slice_number, open_state::read, trx_ids)) {
+         return;
+      }
+
+      // the trace offsets of the blocks which were not forked out, a block appended again replaces the earlier one
+      std::unordered_map<uint32_t, uint64_t> block_offsets;
+      fc::cfile index;
+      if (find_index_slice(slice_number, open_state::read, index)) {
+         const uint64_t end = file_size(index.get_file_path());
+         while (index.tellp() < end) {
+            const auto e = extract_store<metadata_log_entry>(index);
+            if (e.contains<block_entry_v0>()) {
+               const auto& block = e.get<block_entry_v0>();
+               block_offsets[block.number] = block.offset;
+            }
+         }
+      }
+
+      std::vector<trx_id_entry_v0> entries;
+      const uint64_t end = file_size(trx_ids.get_file_path());
+      entries.reserve(end / trx_id_entry_v0::packed_size);
+      // a partial entry left by an interrupted append is dropped
+      while (trx_ids.tellp() + trx_id_entry_v0::packed_size <= end) {
+         const auto entry = extract_store<trx_id_entry_v0>(trx_ids);
+         const auto itr = block_offsets.find(entry.block_num);
+         if (itr != block_offsets.end() && itr->second == entry.offset) {
+            entries.push_back(entry);
+         }
+      }
+      std::sort(entries.begin(), entries.end(), [](const trx_id_entry_v0& lhs, const trx_id_entry_v0& rhs) {
+         return lhs.id < rhs.id;
+      });
+
+      std::vector<char> data;
+      data.reserve(entries.size() * trx_id_entry_v0::packed_size);
+      for (const auto& entry : entries) {
+         const auto packed = fc::raw::pack(entry);
+         data.insert(data.end(), packed.begin(), packed.end());
+      }
+
+      fc::cfile sorted;
+      find_sorted_trx_id_slice(slice_number, sorted, false);
+      auto tmp_path = sorted.get_file_path();
+      tmp_path.replace_extension(".tmp");
+      log(std::string("Sorting: ") + trx_ids.get_file_path().generic_string());
+      {
+         fc::cfile tmp;
+         tmp.set_file_path(tmp_path);
+         tmp.open("wb");
+         tmp.write(data.data(), data.size());
+         tmp.flush();
+         tmp.sync();
+      }
+      bfs::rename(tmp_path, sorted.get_file_path());
+
+      // after the sorted file is complete, delete the unsorted one
+      log(std::string("Removing: ") + trx_ids.get_file_path().generic_string());
+      trx_ids.close();
+      bfs::remove(trx_ids.get_file_path());
+   }
+
    bool slice_directory::find_slice(const char* slice_prefix, uint32_t slice_number, fc::cfile& slice_file, bool open_file) const {
       auto filename = make_filename(slice_prefix, _trace_ext, slice_number, _width);
       const path slice_path = _slice_dir / filename;
@@ -207,7 +440,11 @@ namespace eosio::trace_api {
       _maintenance_condition.notify_one();
    }
 
-   void slice_directory::start_maintenance_thread(log_handler log) {
+   void slice_directory::start_maintenance_thread(log_handler log, size_t worker_threads) {
+      _maintenance_threads = std::max<size_t>(worker_threads, 1);
+      if (_maintenance_threads > 1) {
+         _maintenance_pool.emplace("trace-mxw", _maintenance_threads);
+      }
       _maintenance_thread = std::thread([this, log=std::move(log)](){
          fc::set_os_thread_name( "trace-mx" );
          uint32_t last_lib = 0;
@@ -241,26 +478,81 @@ namespace eosio::trace_api {
       _maintenance_shutdown = true;
       _maintenance_condition.notify_one();
       _maintenance_thread.join();
+      _maintenance_pool.reset();
    }
 
-   template<typename F>
-   void slice_directory::process_irreversible_slice_range(uint32_t lib, uint32_t min_irreversible, std::optional<uint32_t>& lower_bound_slice, F&& f) {
+   slice_directory::maintenance_status slice_directory::get_maintenance_status() const {
+      return maintenance_status {
+         .best_known_lib    = _best_known_lib,
+         .processed_lib     = _processed_lib,
+         .queued_tasks      = _queued_tasks,
+         .removed_slices    = _removed_slices,
+         .compressed_slices = _compressed_slices,
+         .last_run_duration = fc::microseconds(_last_run_duration_us)
+      };
+   }
+
+   std::vector<uint32_t> slice_directory::irreversible_slice_range(uint32_t lib, uint32_t min_irreversible, const std::optional<uint32_t>& lower_bound_slice) const {
+      std::vector<uint32_t> slices;
       const uint32_t lib_slice_number = slice_number( lib );
       if (lib_slice_number < 1 || (lower_bound_slice && *lower_bound_slice >= lib_slice_number - 1))
-         return;
+         return slices;
 
       const int64_t upper_bound_block_number = static_cast<int64_t>(lib) - static_cast<int64_t>(min_irreversible) - _width;
       if (upper_bound_block_number >= 0) {
          uint32_t upper_bound_slice_num = slice_number(static_cast<uint32_t>(upper_bound_block_number));
-         while (!lower_bound_slice || *lower_bound_slice < upper_bound_slice_num) {
-            const uint32_t slice_to_process = lower_bound_slice ? *lower_bound_slice + 1 : 0;
+         for (uint32_t slice = lower_bound_slice ? *lower_bound_slice + 1 : 0; slice <= upper_bound_slice_num; ++slice) {
+            slices.push_back(slice);
+         }
+      }
+      return slices;
+   }
+
+   template<typename F>
+   void slice_directory::process_irreversible_slice_range(uint32_t lib, uint32_t min_irreversible, std::optional<uint32_t>& lower_bound_slice, F&& f) {
+      const auto slices = irreversible_slice_range(lib, min_irreversible, lower_bound_slice);
+      if (!_maintenance_pool) {
+         for (const uint32_t slice_to_process : slices) {
             f(slice_to_process);
             lower_bound_slice = slice_to_process;
          }
+         return;
+      }
+
+      // posted oldest first, so the oldest slices are picked up by the workers first
+      std::vector<std::promise<void>> done(slices.size());
+      for (size_t i = 0; i < slices.size(); ++i) {
+         ++_queued_tasks;
+         boost::asio::post(_maintenance_pool->get_executor(), [this, &f, &done, i, slice_to_process = slices[i]]() {
+            --_queued_tasks;
+            try {
+               f(slice_to_process);
+               done[i].set_value();
+            } catch (...) {
+               done[i].set_exception(std::current_exception());
+            }
+         });
+      }
+      std::vector<std::future<void>> results;
+      results.reserve(done.size());
+      for (auto& d : done) {
+         results.push_back(d.get_future());
+      }
+      for (auto& r : results) {
+         r.wait();
+      }
+      // a failed slice and the ones after it are processed again for the next lib
+      for (size_t i = 0; i < results.size(); ++i) {
+         results[i].get();
+         lower_bound_slice = slices[i];
       }
    }
 
    void slice_directory::run_maintenance_tasks(uint32_t lib, const log_handler& log) {
+      const auto start = fc::time_point::now();
+      const uint64_t removed_before = _removed_slices;
+      const uint64_t compressed_before = _compressed_slices;
+
       if (_minimum_irreversible_history_blocks) {
          process_irreversible_slice_range(lib, *_minimum_irreversible_history_blocks, _last_cleaned_up_slice, [this, &log](uint32_t slice_to_clean){
             fc::cfile trace;
@@ -274,11 +566,13 @@ namespace eosio::trace_api {
             if (index_found) {
                log(std::string("Removing: ") + index.get_file_path().generic_string());
                bfs::remove(index.get_file_path());
+               _mapped_slices.erase(index.get_file_path());
             }
             const bool trace_found = find_trace_slice(slice_to_clean, open_state::read, trace, dont_open_file);
             if (trace_found) {
                log(std::string("Removing: ") + trace.get_file_path().generic_string());
                bfs::remove(trace.get_file_path());
+               _mapped_slices.erase(trace.get_file_path());
             }
 
             auto ctrace = find_compressed_trace_slice(slice_to_clean, dont_open_file);
@@ -286,9 +580,29 @@ namespace eosio::trace_api {
                log(std::string("Removing: ") + ctrace->get_file_path().generic_string());
                bfs::remove(ctrace->get_file_path());
             }
+
+            fc::cfile trx_ids;
+            if (find_trx_id_slice(slice_to_clean, open_state::read, trx_ids, dont_open_file)) {
+               log(std::string("Removing: ") + trx_ids.get_file_path().generic_string());
+               bfs::remove(trx_ids.get_file_path());
+            }
+            if (find_sorted_trx_id_slice(slice_to_clean, trx_ids, dont_open_file)) {
+               log(std::string("Removing: ") + trx_ids.get_file_path().generic_string());
+               bfs::remove(trx_ids.get_file_path());
+            }
+
+            if (index_found || trace_found || ctrace) {
+               ++_removed_slices;
+            }
          });
       }
 
+      // the transaction ids of a slice are sorted once all of its blocks are irreversible
+      process_irreversible_slice_range(lib, 0, _last_sorted_trx_id_slice, [this, &log](uint32_t slice_to_sort){
+         log(std::string("Attempting sort of transaction ids of slice: ") + std::to_string(slice_to_sort));
+         sort_trx_id_slice(slice_to_sort, log);
+      });
+
       // Only process compression if its configured AND there is a range of irreversible blocks which would not also
       // be deleted
       if (_minimum_uncompressed_irreversible_history_blocks &&
@@ -311,8 +625,19 @@ namespace eosio::trace_api {
                // after compression is complete, delete the old uncompressed file
                log(std::string("Removing: ") + trace.get_file_path().generic_string());
                bfs::remove(trace.get_file_path());
+               _mapped_slices.erase(trace.get_file_path());
+               ++_compressed_slices;
             }
          });
       }
+
+      const auto duration = fc::time_point::now() - start;
+      _last_run_duration_us = duration.count();
+      _processed_lib = lib;
+      // a lib moving far while a run is in progress means the workers fall behind
+      log(std::string("Maintenance for lib: ") + std::to_string(lib) + " removed " + std::to_string(_removed_slices - removed_before) +
+          " and compressed " + std::to_string(_compressed_slices - compressed_before) + " slices in " +
+          std::to_string(duration.count() / 1000) + " ms with " + std::to_string(_maintenance_threads) +
+          " threads, lib is " + std::to_string(_best_known_lib - std::min<uint32_t>(lib, _best_known_lib)) + " blocks ahead");
    }
 }
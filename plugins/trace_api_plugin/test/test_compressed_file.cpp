@@ -212,5 +212,64 @@ BOOST_FIXTURE_TEST_CASE_TEMPLATE(blob_access_no_seek_points, T, test_types, temp
    }
 }
 
+BOOST_FIXTURE_TEST_CASE_TEMPLATE(reseek_open_file, T, test_types, temp_file_fixture) {
+   auto data = std::vector<T>(128);
+   std::generate(data.begin(), data.end(), [offset=0ULL]() mutable {
+      auto result = offset;
+      offset+=sizeof(T);
+      return convert_to<T>(result);
+   });
+
+   auto uncompressed_filename = create_temp_file(data.data(), data.size() * sizeof(T));
+   auto compressed_filename = create_temp_file(nullptr, 0);
+
+   // few seek points, so seeks of the larger type discard more than one read buffer
+   BOOST_TEST(compressed_file::process(uncompressed_filename, compressed_filename, data.size() * sizeof(T) / 3));
+
+   // test that one open file can seek backwards and forwards repeatedly
+   auto compf = compressed_file(compressed_filename);
+   compf.open();
+   for (int i = 0; i < data.size(); i++) {
+      const int index = (i % 2) ? i : data.size() - i - 1;
+      T value;
+      compf.seek((long)index * sizeof(T));
+      compf.read(reinterpret_cast<char*>(&value), sizeof(T));
+      BOOST_TEST(value == data.at(index));
+   }
+   compf.close();
+}
+
+BOOST_FIXTURE_TEST_CASE(seek_point_count_limit, temp_file_fixture) {
+   auto data = std::vector<uint64_t>(32 * 1024);
+   std::generate(data.begin(), data.end(), [offset=0ULL]() mutable {
+      auto result = offset;
+      offset+=sizeof(uint64_t);
+      return result;
+   });
+
+   auto uncompressed_filename = create_temp_file(data.data(), data.size() * sizeof(uint64_t));
+   auto compressed_filename = create_temp_file(nullptr, 0);
+
+   // a stride of 1 byte would need more seek points than the file format can count
+   BOOST_TEST(compressed_file::process(uncompressed_filename, compressed_filename, 1));
+
+   fc::cfile compressed;
+   compressed.set_file_path(compressed_filename);
+   compressed.open("r");
+   compressed.seek(fc::file_size(compressed_filename) - 2);
+   uint16_t seek_point_count = 0;
+   compressed.read(reinterpret_cast<char*>(&seek_point_count), 2);
+   BOOST_REQUIRE_EQUAL(seek_point_count, (data.size() * sizeof(uint64_t) - 1) / 5);
+
+   auto compf = compressed_file(compressed_filename);
+   compf.open();
+   for (int i = 0; i < data.size(); i += 97) {
+      uint64_t value;
+      compf.seek((long)i * sizeof(uint64_t));
+      compf.read(reinterpret_cast<char*>(&value), sizeof(value));
+      BOOST_REQUIRE_EQUAL(value, data.at(i));
+   }
+   compf.close();
+}
 
-BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
+BOOST_AUTO_TEST_SUITE_END()
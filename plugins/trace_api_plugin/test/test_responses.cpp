@@ -2,6 +2,7 @@
 #include <boost/test/included/unit_test.hpp>
 
 #include <fc/variant_object.hpp>
+#include <fc/io/json.hpp>
 
 #include <eosio/trace_api/request_handler.hpp>
 #include <eosio/trace_api/test_common.hpp>
@@ -63,6 +64,10 @@ struct response_test_fixture {
       return response_impl.get_block_trace( block_height, yield );
    }
 
+   std::optional<std::string> get_block_trace_json( uint32_t block_height, const yield_function& yield = {} ) {
+      return response_impl.get_block_trace_json( block_height, yield );
+   }
+
    // fixture data and methods
    std::function<get_block_t(uint32_t, const yield_function&)> mock_get_block;
    std::function<fc::variant(const action_trace_v0&, const yield_function&)> mock_data_handler = default_mock_data_handler;
@@ -605,4 +610,88 @@ BOOST_AUTO_TEST_SUITE(trace_responses)
       BOOST_TEST(to_kv(expected_response) == to_kv(actual_response), boost::test_tools::per_element());
    }
 
+   BOOST_FIXTURE_TEST_CASE(json_block_response_matches_variant, response_test_fixture)
+   {
+      auto block_trace = block_trace_v1 {
+         {
+            "b000000000000000000000000000000000000000000000000000000000000001"_h,
+            1,
+            "0000000000000000000000000000000000000000000000000000000000000000"_h,
+            chain::block_timestamp_type(0),
+            "bp.one"_n
+         },
+         "0000000000000000000000000000000000000000000000000000000000000000"_h,
+         "0000000000000000000000000000000000000000000000000000000000000000"_h,
+         3,
+         {
+            {
+               {
+                  "0000000000000000000000000000000000000000000000000000000000000001"_h,
+                  {
+                     {
+                        0x100000001ULL,
+                        "receiver"_n, "contract"_n, "action"_n,
+                        {{ "alice"_n, "active"_n }, { "bob"_n, "owner"_n }},
+                        { 0x00, 0x01, 0x02, 0x03 }
+                     },
+                     {
+                        7,
+                        "receiver"_n, "contract"_n, "other"_n,
+                        {},
+                        {}
+                     }
+                  }
+               },
+               fc::enum_type<uint8_t, chain::transaction_receipt_header::status_enum>{chain::transaction_receipt_header::status_enum::executed},
+               10,
+               5,
+               std::vector<chain::signature_type>{ chain::signature_type() },
+               { chain::time_point(), 1, 0, 100, 50, 0 }
+            },
+            {
+               {
+                  "0000000000000000000000000000000000000000000000000000000000000002"_h,
+                  {}
+               },
+               fc::enum_type<uint8_t, chain::transaction_receipt_header::status_enum>{chain::transaction_receipt_header::status_enum::soft_fail},
+               0,
+               0,
+               {},
+               {}
+            }
+         }
+      };
+
+      mock_get_block = [&block_trace]( uint32_t height, const yield_function& ) -> get_block_t {
+         return std::make_tuple(data_log_entry(block_trace), true);
+      };
+      mock_data_handler = [](const action_trace_v0& a, const yield_function& y) -> fc::variant {
+         if (a.data.empty()) {
+            return {};
+         }
+         return default_mock_data_handler(a, y);
+      };
+
+      const auto expected_response = fc::json::to_string(get_block_trace( 1 ), fc::time_point::maximum());
+      const auto actual_response = get_block_trace_json( 1 );
+      BOOST_REQUIRE(actual_response);
+      BOOST_TEST(*actual_response == expected_response);
+
+      auto old_block_trace = block_trace_v0(block_trace);
+      old_block_trace.transactions.push_back(block_trace.transactions_v1.at(0));
+      mock_get_block = [&old_block_trace]( uint32_t height, const yield_function& ) -> get_block_t {
+         return std::make_tuple(data_log_entry(old_block_trace), false);
+      };
+
+      const auto expected_old_response = fc::json::to_string(get_block_trace( 1 ), fc::time_point::maximum());
+      const auto actual_old_response = get_block_trace_json( 1 );
+      BOOST_REQUIRE(actual_old_response);
+      BOOST_TEST(*actual_old_response == expected_old_response);
+
+      mock_get_block = []( uint32_t height, const yield_function& ) -> get_block_t {
+         return {};
+      };
+      BOOST_REQUIRE(!get_block_trace_json( 1 ));
+   }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -653,6 +653,44 @@ BOOST_AUTO_TEST_SUITE(slice_tests)
       }
    }
 
+   BOOST_FIXTURE_TEST_CASE(slice_dir_compress_on_workers, test_fixture)
+   {
+      fc::temp_directory tempdir;
+      const uint32_t width = 10;
+      const uint32_t min_uncompressed_blocks = 5;
+      slice_directory sd(tempdir.path(), width, std::optional<uint32_t>(), std::optional<uint32_t>(min_uncompressed_blocks), 8);
+      fc::cfile file;
+
+      std::set<bfs::path> files;
+      for (int i = 0; i < 7 ; i++) {
+         BOOST_REQUIRE(!sd.find_or_create_index_slice(i, open_state::read, file));
+         files.insert(file.get_file_path().filename());
+         BOOST_REQUIRE(create_non_empty_trace_slice(sd, i, file));
+         auto compressed_trace_name = file.get_file_path().filename();
+         compressed_trace_name.replace_extension(".clog");
+         if (i < 5) {
+            files.insert(compressed_trace_name);
+         } else {
+            files.insert(file.get_file_path().filename());
+         }
+         file.close();
+      }
+
+      // slices 0 to 4 are compressible at lib 55
+      sd.start_maintenance_thread({}, 3);
+      sd.set_lib(55);
+      for (int i = 0; i < 1000 && sd.get_maintenance_status().processed_lib != 55; ++i) {
+         std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+      sd.stop_maintenance_thread();
+
+      const auto status = sd.get_maintenance_status();
+      BOOST_REQUIRE_EQUAL(status.processed_lib, 55);
+      BOOST_REQUIRE_EQUAL(status.compressed_slices, 5);
+      BOOST_REQUIRE_EQUAL(status.queued_tasks, 0);
+      verify_directory_contents(tempdir.path(), files);
+   }
+
    BOOST_FIXTURE_TEST_CASE(slice_dir_compress_and_delete, test_fixture)
    {
       fc::temp_directory tempdir;
@@ -853,4 +891,80 @@ BOOST_AUTO_TEST_SUITE(slice_tests)
       BOOST_REQUIRE(!block2);
    }
 
+   BOOST_FIXTURE_TEST_CASE(test_get_block_mapped, test_fixture)
+   {
+      fc::temp_directory tempdir;
+      store_provider sp(tempdir.path(), 100, std::optional<uint32_t>(), std::optional<uint32_t>(), 0, 1);
+      store_provider unmapped(tempdir.path(), 100, std::optional<uint32_t>(), std::optional<uint32_t>(), 0, 0);
+      sp.append(bt);
+
+      get_block_t block1 = sp.get_block(1);
+      BOOST_REQUIRE(block1);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block1), bt);
+      BOOST_REQUIRE(!sp.get_block(5));
+
+      // the slice files grew after they were mapped
+      sp.append(bt2);
+      get_block_t block2 = sp.get_block(5);
+      BOOST_REQUIRE(block2);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block2), bt2);
+
+      // a second slice replaces the first one in the cache
+      auto bt3 = bt2;
+      bt3.number = 105;
+      sp.append(bt3);
+      get_block_t block3 = sp.get_block(105);
+      BOOST_REQUIRE(block3);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block3), bt3);
+      block1 = sp.get_block(1);
+      BOOST_REQUIRE(block1);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block1), bt);
+
+      block2 = unmapped.get_block(5);
+      BOOST_REQUIRE(block2);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block2), bt2);
+   }
+
+   BOOST_FIXTURE_TEST_CASE(test_get_trx_block, test_fixture)
+   {
+      fc::temp_directory tempdir;
+      store_provider sp(tempdir.path(), 100, std::optional<uint32_t>(), std::optional<uint32_t>(), 0);
+      sp.append(bt);
+      sp.append(bt2);
+      const auto trx_id = bt.transactions_v1[0].id;
+      const auto forked_trx_id = bt2.transactions_v1[0].id;
+
+      get_block_t block1 = sp.get_trx_block(trx_id);
+      BOOST_REQUIRE(block1);
+      BOOST_REQUIRE(!std::get<1>(*block1));
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block1), bt);
+
+      get_block_t block2 = sp.get_trx_block(forked_trx_id);
+      BOOST_REQUIRE(block2);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block2), bt2);
+
+      // replace bt2 with a block which does not include its transaction
+      auto bt2_fork = bt2;
+      bt2_fork.id = "0000000000000000000000000000000000000000000000000000000000000006"_h;
+      bt2_fork.transactions_v1.clear();
+      sp.append(bt2_fork);
+      BOOST_REQUIRE(!sp.get_trx_block(forked_trx_id));
+      BOOST_REQUIRE(!sp.get_trx_block("f000000000000000000000000000000000000000000000000000000000000009"_h));
+
+      // once the slice is irreversible its transaction ids are sorted and the forked out entry is dropped
+      sp.append_lib(250);
+      slice_directory sd(tempdir.path(), 100, std::optional<uint32_t>(), std::optional<uint32_t>(), 0);
+      sd.run_maintenance_tasks(250, {});
+      fc::cfile trx_ids;
+      BOOST_REQUIRE(!sd.find_trx_id_slice(0, open_state::read, trx_ids, false));
+      BOOST_REQUIRE(sd.find_sorted_trx_id_slice(0, trx_ids, false));
+      BOOST_REQUIRE_EQUAL(bfs::file_size(trx_ids.get_file_path()), trx_id_entry_v0::packed_size);
+
+      block1 = sp.get_trx_block(trx_id);
+      BOOST_REQUIRE(block1);
+      BOOST_REQUIRE(std::get<1>(*block1));
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block1), bt);
+      BOOST_REQUIRE(!sp.get_trx_block(forked_trx_id));
+   }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,10 @@
 
 #include <eosio/trace_api/configuration_utils.hpp>
 
+#include <eosio/chain/signal_stats.hpp>
+#include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/trace_spans.hpp>
+
 #include <boost/signals2/connection.hpp>
 
 using namespace eosio::trace_api;
@@ -84,6 +88,10 @@ namespace {
          return store->get_block(height, yield);
       }
 
+      get_block_t get_trx_block(const chain::transaction_id_type& trx_id, const yield_function& yield) {
+         return store->get_trx_block(trx_id, yield);
+      }
+
       std::shared_ptr<Store> store;
    };
 }
@@ -106,6 +114,14 @@ struct trace_api_common_impl {
       cfg_options("trace-minimum-uncompressed-irreversible-history-blocks", boost::program_options::value<int32_t>()->default_value(-1),
                   "Number of blocks to ensure are uncompressed past LIB. Compressed \"slice\" files are still accessible but may carry a performance loss on retrieval\n"
                   "A value of -1 indicates that automatic compression of \"slice\" files will be turned off.");
+      cfg_options("trace-compression-seek-point-stride", bpo::value<uint32_t>()->default_value(1024 * 1024),
+                  "Number of uncompressed bytes between the seek points of compressed \"slice\" files.\n"
+                  "Reading a block from a compressed \"slice\" decompresses half a stride on average, a smaller stride makes these reads faster but the files larger.");
+      cfg_options("trace-mapped-slice-cache-size", bpo::value<uint32_t>()->default_value(slice_directory::default_mapped_slice_cache_size),
+                  "Number of uncompressed \"slice\" files kept memory mapped for the RPC requests, 0 to read them through file handles.");
+      cfg_options("trace-maintenance-threads", bpo::value<uint16_t>()->default_value(1),
+                  "Number of threads removing and compressing \"slice\" files, the oldest \"slice\" files are processed first.\n"
+                  "The trace_api logger reports at debug level how long each maintenance run took and how far LIB moved meanwhile.");
    }
 
    void plugin_initialize(const appbase::variables_map& options) {
@@ -132,19 +148,30 @@ struct trace_api_common_impl {
          minimum_uncompressed_irreversible_history_blocks = uncompressed_blocks;
       }
 
+      compression_seek_point_stride = options.at("trace-compression-seek-point-stride").as<uint32_t>();
+      EOS_ASSERT(compression_seek_point_stride > 0, chain::plugin_config_exception,
+                 "\"trace-compression-seek-point-stride\" must be greater than 0.");
+
+      mapped_slice_cache_size = options.at("trace-mapped-slice-cache-size").as<uint32_t>();
+
+      maintenance_threads = options.at("trace-maintenance-threads").as<uint16_t>();
+      EOS_ASSERT(maintenance_threads > 0, chain::plugin_config_exception,
+                 "\"trace-maintenance-threads\" must be at least 1.");
+
       store = std::make_shared<store_provider>(
          trace_dir,
          slice_stride,
          minimum_irreversible_history_blocks,
          minimum_uncompressed_irreversible_history_blocks,
-         compression_seek_point_stride
+         compression_seek_point_stride,
+         mapped_slice_cache_size
       );
    }
 
    void plugin_startup() {
       store->start_maintenance_thread([](const std::string& msg ){
          fc_dlog( _log, msg );
-      });
+      }, maintenance_threads);
    }
 
    void plugin_shutdown() {
@@ -154,12 +181,14 @@ struct trace_api_common_impl {
    // common configuration paramters
    boost::filesystem::path trace_dir;
    uint32_t slice_stride = 0;
+   uint16_t maintenance_threads = 1;
+   uint32_t mapped_slice_cache_size = slice_directory::default_mapped_slice_cache_size;
 
    std::optional<uint32_t> minimum_irreversible_history_blocks;
    std::optional<uint32_t> minimum_uncompressed_irreversible_history_blocks;
 
    static constexpr int32_t manual_slice_file_value = -1;
-   static constexpr uint32_t compression_seek_point_stride = 6 * 1024 * 1024; // 6 MiB strides for clog seek points
+   uint32_t compression_seek_point_stride = 0;
 
    std::shared_ptr<store_provider> store;
 };
@@ -235,8 +264,9 @@ struct trace_api_rpc_plugin_impl : public std::enable_shared_from_this<trace_api
       auto& http = app().get_plugin<http_plugin>();
       fc::microseconds max_response_time = http.get_max_response_time();
 
-      http.add_async_handler("/v1/trace_api/get_block",
-            [wthis=weak_from_this(), max_response_time](std::string, std::string body, url_response_callback cb)
+      // large blocks are written as JSON directly instead of through a variant
+      http.add_async_json_handler("/v1/trace_api/get_block",
+            [wthis=weak_from_this(), max_response_time](std::string, std::string body, url_response_callback cb, url_json_response_callback json_cb)
       {
          auto that = wthis.lock();
          if (!that) {
@@ -269,17 +299,59 @@ struct trace_api_rpc_plugin_impl : public std::enable_shared_from_this<trace_api
          try {
 
             const auto deadline = that->calc_deadline( max_response_time );
-            auto resp = that->req_handler->get_block_trace(*block_number, [deadline]() { FC_CHECK_DEADLINE(deadline); });
-            if (resp.is_null()) {
+            auto resp = that->req_handler->get_block_trace_json(*block_number, [deadline]() { FC_CHECK_DEADLINE(deadline); });
+            if (!resp) {
                error_results results{404, "Block trace missing"};
                cb( 404, fc::variant( results ));
             } else {
-               cb( 200, std::move(resp) );
+               json_cb( 200, std::move(*resp) );
             }
          } catch (...) {
             http_plugin::handle_exception("trace_api", "get_block", body, cb);
          }
       });
+
+      http.add_async_handler("/v1/trace_api/get_transaction_trace",
+            [wthis=weak_from_this(), max_response_time](std::string, std::string body, url_response_callback cb)
+      {
+         auto that = wthis.lock();
+         if (!that) {
+            return;
+         }
+
+         auto trx_id = ([&body]() -> std::optional<chain::transaction_id_type> {
+            if (body.empty()) {
+               return {};
+            }
+
+            try {
+               auto input = fc::json::from_string(body);
+               return input.get_object()["id"].as<chain::transaction_id_type>();
+            } catch (...) {
+               return {};
+            }
+         })();
+
+         if (!trx_id) {
+            error_results results{400, "Bad or missing id"};
+            cb( 400, fc::variant( results ));
+            return;
+         }
+
+         try {
+
+            const auto deadline = that->calc_deadline( max_response_time );
+            auto resp = that->req_handler->get_transaction_trace(*trx_id, [deadline]() { FC_CHECK_DEADLINE(deadline); });
+            if (resp.is_null()) {
+               error_results results{404, "Transaction trace missing"};
+               cb( 404, fc::variant( results ));
+            } else {
+               cb( 200, std::move(resp) );
+            }
+         } catch (...) {
+            http_plugin::handle_exception("trace_api", "get_transaction_trace", body, cb);
+         }
+      });
    }
 
    void plugin_shutdown() {
@@ -297,6 +369,9 @@ struct trace_api_plugin_impl {
 
    static void set_program_options(appbase::options_description& cli, appbase::options_description& cfg) {
       auto cfg_options = cfg.add_options();
+      cfg_options("trace-extraction-thread", bpo::value<bool>()->default_value(true),
+                  "Convert and store the traces of a block on a thread of its own instead of the main thread.\n"
+                  "A failure to store the traces then shuts the node down after the block instead of rolling the block back.");
    }
 
    void plugin_initialize(const appbase::variables_map& options) {
@@ -305,37 +380,54 @@ struct trace_api_plugin_impl {
          app().quit();
          throw yield_exception("shutting down");
       };
-      extraction = std::make_shared<chain_extraction_t>(shared_store_provider<store_provider>(common->store), log_exceptions_and_shutdown);
+
+      chain_extraction_t::post_function post;
+      if (options.at("trace-extraction-thread").as<bool>()) {
+         // a single thread, the traces and LIB markers are stored in the order of the signals
+         extraction_thread.emplace("trace", 1);
+         post = [this](std::function<void()> task) {
+            boost::asio::post(extraction_thread->get_executor(), [task{std::move(task)}]() {
+               try {
+                  task();
+               } catch (const yield_exception&) {
+                  // already logged and quitting, there is no signal to abort on this thread
+               }
+            });
+         };
+      }
+      extraction = std::make_shared<chain_extraction_t>(shared_store_provider<store_provider>(common->store), log_exceptions_and_shutdown, std::move(post));
 
       auto& chain = app().find_plugin<chain_plugin>()->chain();
 
       applied_transaction_connection.emplace(
-         chain.applied_transaction.connect([this](std::tuple<const chain::transaction_trace_ptr&, const chain::signed_transaction&> t) {
+         chain.applied_transaction.connect(chain::timed_slot("applied_transaction", "trace_api_plugin", [this](std::tuple<const chain::transaction_trace_ptr&, const chain::signed_transaction&> t) {
             emit_killer([&](){
                extraction->signal_applied_transaction(std::get<0>(t), std::get<1>(t));
             });
-         }));
+         })));
 
       block_start_connection.emplace(
-            chain.block_start.connect([this](uint32_t block_num) {
+            chain.block_start.connect(chain::timed_slot("block_start", "trace_api_plugin", [this](uint32_t block_num) {
                emit_killer([&](){
                   extraction->signal_block_start(block_num);
                });
-            }));
+            })));
 
       accepted_block_connection.emplace(
-         chain.accepted_block.connect([this](const chain::block_state_ptr& p) {
+         chain.accepted_block.connect(chain::timed_slot("accepted_block", "trace_api_plugin", [this](const chain::block_state_ptr& p) {
+            chain::scoped_span span("accepted_block", "trace_api_plugin", p->block_num);
             emit_killer([&](){
                extraction->signal_accepted_block(p);
             });
-         }));
+         })));
 
       irreversible_block_connection.emplace(
-         chain.irreversible_block.connect([this](const chain::block_state_ptr& p) {
+         chain.irreversible_block.connect(chain::timed_slot("irreversible_block", "trace_api_plugin", [this](const chain::block_state_ptr& p) {
+            chain::scoped_span span("irreversible_block", "trace_api_plugin", p->block_num);
             emit_killer([&](){
                extraction->signal_irreversible_block(p);
             });
-         }));
+         })));
 
    }
 
@@ -344,6 +436,16 @@ struct trace_api_plugin_impl {
    }
 
    void plugin_shutdown() {
+      applied_transaction_connection.reset();
+      block_start_connection.reset();
+      accepted_block_connection.reset();
+      irreversible_block_connection.reset();
+
+      if (extraction_thread) {
+         // store what is queued before stopping, stop() drops the queued tasks
+         chain::async_thread_pool(extraction_thread->get_executor(), [](){}).wait();
+         extraction_thread->stop();
+      }
       common->plugin_shutdown();
    }
 
@@ -351,6 +453,7 @@ struct trace_api_plugin_impl {
 
    using chain_extraction_t = chain_extraction_impl_type<shared_store_provider<store_provider>>;
    std::shared_ptr<chain_extraction_t> extraction;
+   fc::optional<chain::named_thread_pool>                     extraction_thread;
 
    fc::optional<scoped_connection>                            applied_transaction_connection;
    fc::optional<scoped_connection>                            block_start_connection;
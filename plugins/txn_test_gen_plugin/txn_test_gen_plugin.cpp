@@ -11,6 +11,13 @@
 
 #include <boost/asio/high_resolution_timer.hpp>
 #include <boost/algorithm/clamp.hpp>
+#include <boost/signals2/connection.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <random>
 
 #include <Inline/BasicTypes.h>
 #include <IR/Module.h>
@@ -28,10 +35,38 @@ namespace eosio { namespace detail {
   struct txn_test_gen_status {
      string status;
   };
+  struct txn_test_gen_latency_stage {
+     uint64_t count = 0;
+     uint64_t p50_us = 0;
+     uint64_t p90_us = 0;
+     uint64_t p99_us = 0;
+     uint64_t max_us = 0;
+  };
+  /// from the creation of the generated transactions
+  struct txn_test_gen_latency {
+     txn_test_gen_latency_stage accepted;     ///< by this node
+     txn_test_gen_latency_stage in_block;     ///< first block of this node including it
+     txn_test_gen_latency_stage irreversible;
+  };
+  struct txn_test_gen_transfer {
+     eosio::chain::name  from;
+     eosio::chain::name  to;
+     eosio::chain::asset quantity;
+     string              memo;
+  };
+  struct txn_test_gen_issue {
+     eosio::chain::name  to;
+     eosio::chain::asset quantity;
+     string              memo;
+  };
 }}
 
 FC_REFLECT(eosio::detail::txn_test_gen_empty, );
 FC_REFLECT(eosio::detail::txn_test_gen_status, (status));
+FC_REFLECT(eosio::detail::txn_test_gen_latency_stage, (count)(p50_us)(p90_us)(p99_us)(max_us));
+FC_REFLECT(eosio::detail::txn_test_gen_latency, (accepted)(in_block)(irreversible));
+FC_REFLECT(eosio::detail::txn_test_gen_transfer, (from)(to)(quantity)(memo));
+FC_REFLECT(eosio::detail::txn_test_gen_issue, (to)(quantity)(memo));
 
 namespace eosio {
 
@@ -65,6 +100,9 @@ using namespace eosio::chain;
      api_handle->call_name(); \
      eosio::detail::txn_test_gen_empty result;
 
+#define INVOKE_R_V(api_handle, call_name) \
+     auto result = api_handle->call_name();
+
 #define CALL_ASYNC(api_name, api_handle, call_name, INVOKE, http_response_code) \
 {std::string("/v1/" #api_name "/" #call_name), \
    [this](string, string body, url_response_callback cb) mutable { \
@@ -91,6 +129,32 @@ using namespace eosio::chain;
    const auto& vs = fc::json::json::from_string(body).as<fc::variants>(); \
    api_handle->call_name(vs.at(0).as<in_param0>(), vs.at(1).as<in_param1>(), result_handler);
 
+/// burns the cpu of the loop iterations given as a uint32 action data, for the cpu heavy actions of the load profile
+static const char cpu_heavy_wast[] = R"=====(
+(module
+ (import "env" "read_action_data" (func $read_action_data (param i32 i32) (result i32)))
+ (memory $0 1)
+ (export "apply" (func $apply))
+ (func $apply (param $receiver i64) (param $account i64) (param $action_name i64)
+  (local $i i32) (local $n i32) (local $x i64)
+  (drop (call $read_action_data (i32.const 0) (i32.const 4)))
+  (set_local $n (i32.load (i32.const 0)))
+  (set_local $x (get_local $receiver))
+  (block $done
+   (loop $next
+    (br_if $done (i32.ge_u (get_local $i) (get_local $n)))
+    (set_local $x (i64.xor (i64.mul (get_local $x) (i64.const 6364136223846793005)) (i64.const 1442695040888963407)))
+    (set_local $i (i32.add (get_local $i) (i32.const 1)))
+    (br $next)
+   )
+  )
+  (i64.store (i32.const 8) (get_local $x))
+ )
+)
+)=====";
+
+static const symbol load_symbol( 4, "CUR" );
+
 struct txn_test_gen_plugin_impl {
 
    uint64_t _total_us = 0;
@@ -102,6 +166,116 @@ struct txn_test_gen_plugin_impl {
    name                                                 newaccountA;
    name                                                 newaccountB;
    name                                                 newaccountT;
+   name                                                 newaccountC; ///< cpu heavy contract of the load profile
+
+   /// load profile: transfers among load_accounts drawn from a Zipfian distribution instead of the a <-> b pairs
+   uint32_t                                             load_accounts = 0;
+   double                                               zipf_exponent = 0;
+   uint32_t                                             actions_per_trx = 1;
+   uint32_t                                             cpu_heavy_percent = 0;
+   uint32_t                                             cpu_heavy_iterations = 0;
+   std::vector<name>                                    load_account_names;
+   std::vector<double>                                  load_account_cdf;
+
+   struct in_flight_trx {
+      fc::time_point created;
+      fc::time_point accepted;
+      fc::time_point in_block;
+   };
+   struct latency_samples {
+      std::vector<uint64_t> accepted;
+      std::vector<uint64_t> in_block;
+      std::vector<uint64_t> irreversible;
+   };
+   std::mutex                                           latency_mtx;
+   std::map<transaction_id_type, in_flight_trx>         in_flight;  ///< generated and not irreversible yet
+   latency_samples                                      latencies;
+   uint32_t                                             irreversible_blocks = 0;
+
+   fc::optional<boost::signals2::scoped_connection>     accepted_block_connection;
+   fc::optional<boost::signals2::scoped_connection>     irreversible_block_connection;
+
+   static fc::crypto::private_key load_private_key() {
+      return fc::crypto::private_key::regenerate(fc::sha256(std::string(64, 'd')));
+   }
+
+   void record_created(const transaction_id_type& id) {
+      std::lock_guard g(latency_mtx);
+      in_flight[id].created = fc::time_point::now();
+   }
+
+   void record_accepted(const transaction_id_type& id) {
+      const auto now = fc::time_point::now();
+      std::lock_guard g(latency_mtx);
+      auto it = in_flight.find(id);
+      if(it == in_flight.end() || it->second.accepted != fc::time_point())
+         return;
+      it->second.accepted = now;
+      latencies.accepted.push_back((now - it->second.created).count());
+   }
+
+   void record_block(const chain::block_state_ptr& bsp, bool irreversible) {
+      const auto now = fc::time_point::now();
+      std::lock_guard g(latency_mtx);
+      if(in_flight.empty())
+         return;
+      for(const auto& r : bsp->block->transactions) {
+         const transaction_id_type& id = r.trx.contains<transaction_id_type>() ? r.trx.get<transaction_id_type>() : r.trx.get<packed_transaction>().id();
+         auto it = in_flight.find(id);
+         if(it == in_flight.end())
+            continue;
+         if(irreversible) {
+            latencies.irreversible.push_back((now - it->second.created).count());
+            in_flight.erase(it);
+         } else if(it->second.in_block == fc::time_point()) {
+            it->second.in_block = now;
+            latencies.in_block.push_back((now - it->second.created).count());
+         }
+      }
+      // the transactions that never made it in to a block expired long ago
+      if(irreversible && ++irreversible_blocks % 1200 == 0) {
+         for(auto it = in_flight.begin(); it != in_flight.end();) {
+            if(now - it->second.created > fc::minutes(10))
+               it = in_flight.erase(it);
+            else
+               ++it;
+         }
+      }
+   }
+
+   static eosio::detail::txn_test_gen_latency_stage summarize(std::vector<uint64_t> samples) {
+      eosio::detail::txn_test_gen_latency_stage stage;
+      stage.count = samples.size();
+      if(samples.empty())
+         return stage;
+      std::sort(samples.begin(), samples.end());
+      auto percentile = [&](size_t p) { return samples[std::min(samples.size() - 1, samples.size() * p / 100)]; };
+      stage.p50_us = percentile(50);
+      stage.p90_us = percentile(90);
+      stage.p99_us = percentile(99);
+      stage.max_us = samples.back();
+      return stage;
+   }
+
+   eosio::detail::txn_test_gen_latency get_latency() {
+      latency_samples copy;
+      {
+         std::lock_guard g(latency_mtx);
+         copy = latencies;
+      }
+      return { summarize(std::move(copy.accepted)), summarize(std::move(copy.in_block)), summarize(std::move(copy.irreversible)) };
+   }
+
+   name pick_load_account(std::mt19937_64& rng) const {
+      const double u = std::uniform_real_distribution<double>(0.0, load_account_cdf.back())(rng);
+      const size_t i = std::lower_bound(load_account_cdf.begin(), load_account_cdf.end(), u) - load_account_cdf.begin();
+      return load_account_names[std::min(i, load_account_names.size() - 1)];
+   }
+
+   action make_transfer(name from, name to, const string& memo) const {
+      return action( vector<permission_level>{{from, config::active_name}}, newaccountT, N(transfer),
+                     fc::raw::pack(eosio::detail::txn_test_gen_transfer{from, to, asset(1, load_symbol), memo}) );
+   }
 
    void push_next_transaction(const std::shared_ptr<std::vector<signed_transaction>>& trxs, const std::function<void(const fc::exception_ptr&)>& next ) {
       chain_plugin& cp = app().get_plugin<chain_plugin>();
@@ -114,6 +288,7 @@ struct txn_test_gen_plugin_impl {
                if (result.contains<transaction_trace_ptr>() && result.get<transaction_trace_ptr>()->receipt) {
                   _total_us += result.get<transaction_trace_ptr>()->receipt->cpu_usage_us;
                   ++_txcount;
+                  record_accepted(result.get<transaction_trace_ptr>()->id);
                }
             }
          });
@@ -177,6 +352,14 @@ struct txn_test_gen_plugin_impl {
 
             trx.actions.emplace_back(vector<chain::permission_level>{{creator,name("active")}}, newaccount{creator, newaccountT, owner_auth, active_auth});
             }
+            //create "C" account of the load profile
+            if (load_accounts) {
+            auto load_pub_key = load_private_key().get_public_key();
+            auto owner_auth   = eosio::chain::authority{1, {{load_pub_key, 1}}, {}};
+            auto active_auth  = eosio::chain::authority{1, {{load_pub_key, 1}}, {}};
+
+            trx.actions.emplace_back(vector<chain::permission_level>{{creator,name("active")}}, newaccount{creator, newaccountC, owner_auth, active_auth});
+            }
 
             trx.expiration = cc.head_block_time() + fc::seconds(180);
             trx.set_reference_block(cc.head_block_id());
@@ -254,6 +437,9 @@ struct txn_test_gen_plugin_impl {
             trx.sign(txn_test_receiver_C_priv_key, chainid);
             trxs.emplace_back(std::move(trx));
          }
+
+         if (load_accounts)
+            create_load_accounts(creator, creator_priv_key, txn_test_receiver_C_priv_key, trxs);
       } catch (const fc::exception& e) {
          next(e.dynamic_copy_exception());
          return;
@@ -262,6 +448,72 @@ struct txn_test_gen_plugin_impl {
       push_transactions(std::move(trxs), next);
    }
 
+   /// the accounts of the load profile, their funds, and the cpu heavy contract
+   void create_load_accounts(name creator, const fc::crypto::private_key& creator_priv_key, const fc::crypto::private_key& t_priv_key,
+                             std::vector<signed_transaction>& trxs) {
+      controller& cc = app().get_plugin<chain_plugin>().chain();
+      auto chainid = app().get_plugin<chain_plugin>().get_chain_id();
+      const auto load_priv_key = load_private_key();
+      const auto load_pub_key = load_priv_key.get_public_key();
+      const uint32_t actions_per_setup_trx = 50;
+      const int64_t funds = 1000'0000; // 1000.0000 CUR per account
+
+      auto finish = [&](signed_transaction& trx, const fc::crypto::private_key& key) {
+         trx.expiration = cc.head_block_time() + fc::seconds(180);
+         trx.set_reference_block(cc.head_block_id());
+         trx.sign(key, chainid);
+         trxs.emplace_back(std::move(trx));
+      };
+
+      for (uint32_t first = 0; first < load_accounts; first += actions_per_setup_trx) {
+         const uint32_t last = std::min(load_accounts, first + actions_per_setup_trx);
+         signed_transaction create_trx;
+         for (uint32_t i = first; i < last; ++i) {
+            auto auth = eosio::chain::authority{1, {{load_pub_key, 1}}, {}};
+            create_trx.actions.emplace_back(vector<chain::permission_level>{{creator,name("active")}}, newaccount{creator, load_account_names[i], auth, auth});
+         }
+         finish(create_trx, creator_priv_key);
+
+         signed_transaction fund_trx;
+         fund_trx.actions.emplace_back( vector<permission_level>{{newaccountT,config::active_name}}, newaccountT, N(issue),
+                                        fc::raw::pack(eosio::detail::txn_test_gen_issue{newaccountT, asset(funds * (last - first), load_symbol), ""}) );
+         for (uint32_t i = first; i < last; ++i)
+            fund_trx.actions.emplace_back( vector<permission_level>{{newaccountT,config::active_name}}, newaccountT, N(transfer),
+                                           fc::raw::pack(eosio::detail::txn_test_gen_transfer{newaccountT, load_account_names[i], asset(funds, load_symbol), ""}) );
+         fund_trx.max_net_usage_words = 5000;
+         finish(fund_trx, t_priv_key);
+      }
+
+      signed_transaction code_trx;
+      vector<uint8_t> wasm = wast_to_wasm(cpu_heavy_wast);
+      setcode handler;
+      handler.account = newaccountC;
+      handler.code.assign(wasm.begin(), wasm.end());
+      code_trx.actions.emplace_back( vector<chain::permission_level>{{newaccountC,name("active")}}, handler);
+      finish(code_trx, load_priv_key);
+   }
+
+   signed_transaction make_load_transaction(const block_id_type& reference_block_id, fc::time_point_sec expiration, const string& nonce, const string& salt) const {
+      static thread_local std::mt19937_64 rng(std::random_device{}());
+
+      signed_transaction trx;
+      const name from = pick_load_account(rng);
+      for (uint32_t a = 0; a < actions_per_trx; ++a) {
+         name to = pick_load_account(rng);
+         if (to == from)
+            to = to == load_account_names.front() ? load_account_names.back() : load_account_names.front();
+         trx.actions.push_back(make_transfer(from, to, salt));
+      }
+      if (cpu_heavy_percent && rng() % 100 < cpu_heavy_percent)
+         trx.actions.emplace_back( vector<permission_level>{{from, config::active_name}}, newaccountC, N(burn), fc::raw::pack(cpu_heavy_iterations) );
+      trx.context_free_actions.emplace_back(action({}, config::null_account_name, name("nonce"), fc::raw::pack(nonce)));
+      trx.set_reference_block(reference_block_id);
+      trx.expiration = expiration;
+      static const fc::crypto::private_key load_priv_key = load_private_key();
+      trx.sign(load_priv_key, app().get_plugin<chain_plugin>().get_chain_id());
+      return trx;
+   }
+
    string start_generation(const std::string& salt, const uint64_t& period, const uint64_t& batch_size) {
       ilog("Starting transaction test plugin");
       if(running)
@@ -270,7 +522,7 @@ struct txn_test_gen_plugin_impl {
          return "period must be between 1 and 2500";
       if(batch_size < 1 || batch_size > 250)
          return "batch_size must be between 1 and 250";
-      if(batch_size & 1)
+      if((batch_size & 1) && !load_accounts)
          return "batch_size must be even";
       ilog("Starting transaction test plugin valid");
 
@@ -297,8 +549,22 @@ struct txn_test_gen_plugin_impl {
                                                                   abi_serializer::create_yield_function( abi_serializer_max_time ));
 
       timer_timeout = period;
-      batch = batch_size/2;
+      batch = load_accounts ? batch_size : batch_size/2;
       nonce_prefix = 0;
+      load_salt = salt;
+
+      if (load_accounts) {
+         load_account_cdf.resize(load_accounts);
+         double total = 0;
+         for (uint32_t i = 0; i < load_accounts; ++i) {
+            total += 1.0 / std::pow(i + 1, zipf_exponent);
+            load_account_cdf[i] = total;
+         }
+      }
+      {
+         std::lock_guard g(latency_mtx);
+         latencies = latency_samples();
+      }
 
       thread_pool.emplace( "txntest", thread_pool_size );
       timer = std::make_shared<boost::asio::high_resolution_timer>(thread_pool->get_executor());
@@ -355,6 +621,14 @@ struct txn_test_gen_plugin_impl {
 
          block_id_type reference_block_id = cc.get_block_id_for_num(reference_block_num);
 
+         if (load_accounts) {
+            for(unsigned int i = 0; i < batch; ++i) {
+               trxs.emplace_back(make_load_transaction(reference_block_id, cc.head_block_time() + fc::seconds(30),
+                                                       std::to_string(nonce_prefix)+std::to_string(nonce++), load_salt));
+               record_created(trxs.back().id());
+            }
+         }
+         else
          for(unsigned int i = 0; i < batch; ++i) {
          {
          signed_transaction trx;
@@ -364,6 +638,7 @@ struct txn_test_gen_plugin_impl {
          trx.expiration = cc.head_block_time() + fc::seconds(30);
          trx.max_net_usage_words = 100;
          trx.sign(a_priv_key, chainid);
+         record_created(trx.id());
          trxs.emplace_back(std::move(trx));
          }
 
@@ -375,6 +650,7 @@ struct txn_test_gen_plugin_impl {
          trx.expiration = cc.head_block_time() + fc::seconds(30);
          trx.max_net_usage_words = 100;
          trx.sign(b_priv_key, chainid);
+         record_created(trx.id());
          trxs.emplace_back(std::move(trx));
          }
          }
@@ -399,6 +675,7 @@ struct txn_test_gen_plugin_impl {
          ilog("${d} transactions executed, ${t}us / transaction", ("d", _txcount)("t", _total_us / (double)_txcount));
          _txcount = _total_us = 0;
       }
+      ilog("transaction latencies: ${l}", ("l", get_latency()));
    }
 
    bool running{false};
@@ -406,6 +683,7 @@ struct txn_test_gen_plugin_impl {
    unsigned timer_timeout;
    unsigned batch;
    uint64_t nonce_prefix;
+   string   load_salt;
 
    action act_a_to_b;
    action act_b_to_a;
@@ -421,6 +699,14 @@ void txn_test_gen_plugin::set_program_options(options_description&, options_desc
       ("txn-reference-block-lag", bpo::value<int32_t>()->default_value(0), "Lag in number of blocks from the head block when selecting the reference block for transactions (-1 means Last Irreversible Block)")
       ("txn-test-gen-threads", bpo::value<uint16_t>()->default_value(2), "Number of worker threads in txn_test_gen thread pool")
       ("txn-test-gen-account-prefix", bpo::value<string>()->default_value("txn.test."), "Prefix to use for accounts generated and used by this plugin")
+      ("txn-test-gen-accounts", bpo::value<uint32_t>()->default_value(0),
+       "Number of accounts the load profile transfers among, created by create_test_accounts. 0 generates the transfers between the a and b accounts instead")
+      ("txn-test-gen-zipf-exponent", bpo::value<double>()->default_value(0.0),
+       "Exponent of the Zipfian distribution the senders and receivers of the load profile are drawn from, 0 for a uniform distribution")
+      ("txn-test-gen-actions-per-trx", bpo::value<uint32_t>()->default_value(1), "Transfers in each transaction of the load profile")
+      ("txn-test-gen-cpu-heavy-percent", bpo::value<uint32_t>()->default_value(0),
+       "Percentage of the load profile transactions that also execute a cpu heavy action of the c account")
+      ("txn-test-gen-cpu-heavy-iterations", bpo::value<uint32_t>()->default_value(10000), "Loop iterations of the cpu heavy action")
    ;
 }
 
@@ -433,6 +719,26 @@ void txn_test_gen_plugin::plugin_initialize(const variables_map& options) {
       my->newaccountA = eosio::chain::name(thread_pool_account_prefix + "a");
       my->newaccountB = eosio::chain::name(thread_pool_account_prefix + "b");
       my->newaccountT = eosio::chain::name(thread_pool_account_prefix + "t");
+      my->newaccountC = eosio::chain::name(thread_pool_account_prefix + "c");
+      my->load_accounts = options.at( "txn-test-gen-accounts" ).as<uint32_t>();
+      my->zipf_exponent = options.at( "txn-test-gen-zipf-exponent" ).as<double>();
+      my->actions_per_trx = options.at( "txn-test-gen-actions-per-trx" ).as<uint32_t>();
+      my->cpu_heavy_percent = options.at( "txn-test-gen-cpu-heavy-percent" ).as<uint32_t>();
+      my->cpu_heavy_iterations = options.at( "txn-test-gen-cpu-heavy-iterations" ).as<uint32_t>();
+      EOS_ASSERT( my->load_accounts <= 10000, chain::plugin_config_exception,
+                  "txn-test-gen-accounts ${num} must be at most 10000", ("num", my->load_accounts) );
+      EOS_ASSERT( my->load_accounts != 1, chain::plugin_config_exception, "txn-test-gen-accounts must not be 1, transfers need two accounts" );
+      EOS_ASSERT( my->zipf_exponent >= 0, chain::plugin_config_exception, "txn-test-gen-zipf-exponent must not be negative" );
+      EOS_ASSERT( my->actions_per_trx > 0 && my->actions_per_trx <= 100, chain::plugin_config_exception,
+                  "txn-test-gen-actions-per-trx ${num} must be between 1 and 100", ("num", my->actions_per_trx) );
+      EOS_ASSERT( my->cpu_heavy_percent <= 100, chain::plugin_config_exception,
+                  "txn-test-gen-cpu-heavy-percent ${num} must be at most 100", ("num", my->cpu_heavy_percent) );
+      // three character suffixes, which the one character suffixes of the other accounts can not collide with
+      static const char name_chars[] = "abcdefghijklmnopqrstuvwxyz12345";
+      for (uint32_t i = 0; i < my->load_accounts; ++i) {
+         std::string suffix{ name_chars[i / (31 * 31)], name_chars[i / 31 % 31], name_chars[i % 31] };
+         my->load_account_names.emplace_back(thread_pool_account_prefix + suffix);
+      }
       EOS_ASSERT( my->thread_pool_size > 0, chain::plugin_config_exception,
                   "txn-test-gen-threads ${num} must be greater than 0", ("num", my->thread_pool_size) );
    } FC_LOG_AND_RETHROW()
@@ -442,11 +748,22 @@ void txn_test_gen_plugin::plugin_startup() {
    app().get_plugin<http_plugin>().add_api({
       CALL_ASYNC(txn_test_gen, my, create_test_accounts, INVOKE_ASYNC_R_R(my, create_test_accounts, std::string, std::string), 200),
       CALL(txn_test_gen, my, stop_generation, INVOKE_V_V(my, stop_generation), 200),
-      CALL(txn_test_gen, my, start_generation, INVOKE_V_R_R_R(my, start_generation, std::string, uint64_t, uint64_t), 200)
+      CALL(txn_test_gen, my, start_generation, INVOKE_V_R_R_R(my, start_generation, std::string, uint64_t, uint64_t), 200),
+      CALL(txn_test_gen, my, get_latency, INVOKE_R_V(my, get_latency), 200)
    });
+
+   auto& chain = app().get_plugin<chain_plugin>().chain();
+   my->accepted_block_connection.emplace( chain.accepted_block.connect( [this]( const chain::block_state_ptr& bsp ) {
+      my->record_block( bsp, false );
+   } ) );
+   my->irreversible_block_connection.emplace( chain.irreversible_block.connect( [this]( const chain::block_state_ptr& bsp ) {
+      my->record_block( bsp, true );
+   } ) );
 }
 
 void txn_test_gen_plugin::plugin_shutdown() {
+   my->accepted_block_connection.reset();
+   my->irreversible_block_connection.reset();
    try {
       my->stop_generation();
    }
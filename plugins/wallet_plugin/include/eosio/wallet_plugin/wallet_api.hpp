@@ -98,6 +98,21 @@ class wallet_api
       /** Returns a signature given the digest and public_key, if this wallet can sign via that public key
        */
       virtual fc::optional<signature_type> try_sign_digest( const digest_type digest, const public_key_type public_key ) = 0;
+
+      /** Returns the signatures of the digests, in order, given the public_key, if this wallet can sign via that
+       * public key. Wallets talking to a device override this to keep the device busy over the whole batch.
+       */
+      virtual fc::optional<vector<signature_type>> try_sign_digests( const vector<digest_type>& digests, const public_key_type& public_key ) {
+         vector<signature_type> sigs;
+         sigs.reserve( digests.size() );
+         for( const auto& d : digests ) {
+            auto sig = try_sign_digest( d, public_key );
+            if( !sig )
+               return fc::optional<vector<signature_type>>{};
+            sigs.push_back( *sig );
+         }
+         return sigs;
+      }
 };
 
 }}
@@ -1,5 +1,6 @@
 #pragma once
 #include <eosio/chain/transaction.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <eosio/wallet_plugin/wallet_api.hpp>
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/filesystem/path.hpp>
@@ -51,6 +52,22 @@ public:
                                              const chain::chain_id_type& id);
 
 
+   /// Sign many transactions with the private keys specified via their public keys, each transaction with all keys.
+   /// Every key is looked up once per call. Keys of soft wallets are signed with on the signing thread pool, see
+   /// set_sign_threads, other wallets are handed all digests of a key at once.
+   /// @param txns the transactions to sign.
+   /// @param keys the public keys of the corresponding private keys to sign the transactions with
+   /// @param id the chain_id to sign the transactions with.
+   /// @return txns signed, in order
+   /// @throws fc::exception if corresponding private keys not found in unlocked wallets
+   std::vector<chain::signed_transaction> sign_transactions(const std::vector<chain::signed_transaction>& txns,
+                                                            const flat_set<public_key_type>& keys,
+                                                            const chain::chain_id_type& id);
+
+   /// Set the number of threads sign_transactions signs on.
+   /// @param threads 0 signs on the calling thread.
+   void set_sign_threads(uint16_t threads);
+
    /// Sign digest with the private keys specified via their public keys.
    /// @param digest the digest to sign.
    /// @param key the public key of the corresponding private key to sign the digest with
@@ -138,6 +155,7 @@ private:
    boost::filesystem::path dir = ".";
    boost::filesystem::path lock_path = dir / "wallet.lock";
    std::unique_ptr<boost::interprocess::file_lock> wallet_dir_lock;
+   std::unique_ptr<chain::named_thread_pool> sign_thread_pool;
 
    void start_lock_watch(std::shared_ptr<boost::asio::deadline_timer> t);
    void initialize_lock();
@@ -33,6 +33,7 @@ class yubihsm_wallet final : public wallet_api {
       bool remove_key(string key) override;
 
       fc::optional<signature_type> try_sign_digest(const digest_type digest, const public_key_type public_key) override;
+      fc::optional<vector<signature_type>> try_sign_digests(const vector<digest_type>& digests, const public_key_type& public_key) override;
 
    private:
       std::unique_ptr<detail::yubihsm_wallet_impl> my;
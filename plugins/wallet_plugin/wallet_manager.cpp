@@ -249,6 +249,87 @@ wallet_manager::sign_transaction(const chain::signed_transaction& txn, const fla
    return stxn;
 }
 
+std::vector<chain::signed_transaction>
+wallet_manager::sign_transactions(const std::vector<chain::signed_transaction>& txns, const flat_set<public_key_type>& keys,
+                                  const chain::chain_id_type& id) {
+   check_timeout();
+
+   struct signer {
+      public_key_type                 key;
+      wallet_api*                     wallet = nullptr;
+      fc::optional<private_key_type>  private_key; ///< soft wallets, signed with on the pool
+   };
+   std::vector<signer> signers;
+   signers.reserve(keys.size());
+   {
+      std::map<public_key_type, wallet_api*> key_wallets;
+      for (const auto& i : wallets) {
+         if (!i.second->is_locked()) {
+            for (const auto& pk : i.second->list_public_keys())
+               key_wallets.emplace(pk, i.second.get()); // first wallet wins, as in sign_transaction
+         }
+      }
+      for (const auto& pk : keys) {
+         auto it = key_wallets.find(pk);
+         if (it == key_wallets.end()) {
+            EOS_THROW(chain::wallet_missing_pub_key_exception, "Public key not found in unlocked wallets ${k}", ("k", pk));
+         }
+         signer s{pk, it->second};
+         if (dynamic_cast<soft_wallet*>(it->second))
+            s.private_key = it->second->get_private_key(pk);
+         signers.push_back(std::move(s));
+      }
+   }
+
+   std::vector<chain::signed_transaction> stxns(txns);
+   std::vector<chain::digest_type> digests(stxns.size());
+   std::vector<std::vector<signature_type>> sigs(stxns.size(), std::vector<signature_type>(signers.size()));
+
+   auto sign_soft = [&](size_t t) {
+      digests[t] = stxns[t].sig_digest(id, stxns[t].context_free_data);
+      for (size_t k = 0; k < signers.size(); ++k) {
+         if (signers[k].private_key)
+            sigs[t][k] = signers[k].private_key->sign(digests[t]);
+      }
+   };
+   if (sign_thread_pool) {
+      std::vector<std::future<void>> futures;
+      futures.reserve(stxns.size());
+      for (size_t t = 0; t < stxns.size(); ++t)
+         futures.emplace_back(chain::async_thread_pool(sign_thread_pool->get_executor(), [&sign_soft, t]() { sign_soft(t); }));
+      for (auto& f : futures)
+         f.wait(); // all tasks reference the locals above, even when one of them throws
+      for (auto& f : futures)
+         f.get();
+   } else {
+      for (size_t t = 0; t < stxns.size(); ++t)
+         sign_soft(t);
+   }
+
+   for (size_t k = 0; k < signers.size(); ++k) {
+      if (signers[k].private_key)
+         continue;
+      auto wallet_sigs = signers[k].wallet->try_sign_digests(digests, signers[k].key);
+      if (!wallet_sigs || wallet_sigs->size() != digests.size()) {
+         EOS_THROW(chain::wallet_missing_pub_key_exception, "Public key not found in unlocked wallets ${k}", ("k", signers[k].key));
+      }
+      for (size_t t = 0; t < stxns.size(); ++t)
+         sigs[t][k] = std::move((*wallet_sigs)[t]);
+   }
+
+   for (size_t t = 0; t < stxns.size(); ++t) {
+      auto& signatures = stxns[t].signatures;
+      signatures.insert(signatures.end(), std::make_move_iterator(sigs[t].begin()), std::make_move_iterator(sigs[t].end()));
+   }
+   return stxns;
+}
+
+void wallet_manager::set_sign_threads(uint16_t threads) {
+   sign_thread_pool.reset();
+   if (threads > 0)
+      sign_thread_pool = std::make_unique<chain::named_thread_pool>("sign", threads);
+}
+
 chain::signature_type
 wallet_manager::sign_digest(const chain::digest_type& digest, const public_key_type& key) {
    check_timeout();
@@ -11,6 +11,11 @@
 #include <boost/asio/posix/stream_descriptor.hpp>
 #include <boost/dll/runtime_symbol_info.hpp>
 
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+
 namespace eosio { namespace wallet {
 
 using namespace fc::crypto::r1;
@@ -138,13 +143,80 @@ struct yubihsm_wallet_impl {
       if(it == _keys.end())
          return fc::optional<signature_type>{};
 
+      return der_to_signature(sign_ecdsa(it->second, d), d, public_key);
+   }
+
+   fc::optional<vector<signature_type>> try_sign_digests(const vector<digest_type>& digests, const public_key_type& public_key) {
+      auto it = _keys.find(public_key);
+      if(it == _keys.end())
+         return fc::optional<vector<signature_type>>{};
+      const uint16_t key_id = it->second;
+
+      //the session answers one request at a time, so the conversion of each DER signature (which recovers the public
+      // key) runs on a second thread while the HSM works on the next digest
+      vector<signature_type> sigs(digests.size());
+      std::mutex mtx;
+      std::condition_variable cv;
+      std::deque<std::pair<size_t, vector<uint8_t>>> ders;
+      bool done = false;
+      auto converter = std::async(std::launch::async, [&]() {
+         std::unique_lock g(mtx);
+         for(;;) {
+            cv.wait(g, [&]() { return done || !ders.empty(); });
+            if(ders.empty())
+               return;
+            auto [i, der] = std::move(ders.front());
+            ders.pop_front();
+            g.unlock();
+            sigs[i] = der_to_signature(der, digests[i], public_key);
+            g.lock();
+         }
+      });
+      auto finish = [&]() {
+         {
+            std::lock_guard g(mtx);
+            done = true;
+         }
+         cv.notify_one();
+         converter.get();
+      };
+
+      try {
+         for(size_t i = 0; i < digests.size(); ++i) {
+            auto der = sign_ecdsa(key_id, digests[i]);
+            {
+               std::lock_guard g(mtx);
+               ders.emplace_back(i, std::move(der));
+            }
+            cv.notify_one();
+         }
+      }
+      catch(...) {
+         {
+            std::lock_guard g(mtx);
+            ders.clear();
+         }
+         finish();
+         throw;
+      }
+      finish();
+      return sigs;
+   }
+
+   vector<uint8_t> sign_ecdsa(const uint16_t key_id, const digest_type& d) {
       size_t der_sig_sz = 128;
-      uint8_t der_sig[der_sig_sz];
+      vector<uint8_t> der_sig(der_sig_sz);
       yh_rc rc;
-      if((rc = yh_util_sign_ecdsa(session, it->second, (uint8_t*)d.data(), d.data_size(), der_sig, &der_sig_sz))) {
+      if((rc = yh_util_sign_ecdsa(session, key_id, (uint8_t*)d.data(), d.data_size(), der_sig.data(), &der_sig_sz))) {
          lock();
          FC_THROW_EXCEPTION(chain::wallet_exception, "yh_util_sign_ecdsa failed: ${m}", ("m", yh_strerror(rc)));
       }
+      der_sig.resize(der_sig_sz);
+      return der_sig;
+   }
+
+   signature_type der_to_signature(const vector<uint8_t>& der, const digest_type& d, const public_key_type& public_key) {
+      const uint8_t* der_sig = der.data();
 
       ///XXX a lot of this below is similar to SE wallet; commonize it in non-junky way
       fc::ecdsa_sig sig = ECDSA_SIG_new();
@@ -155,7 +227,7 @@ struct yubihsm_wallet_impl {
 
       char pub_key_shim_data[64];
       fc::datastream<char *> eds(pub_key_shim_data, sizeof(pub_key_shim_data));
-      fc::raw::pack(eds, it->first);
+      fc::raw::pack(eds, public_key);
       public_key_data* kd = (public_key_data*)(pub_key_shim_data+1);
 
       compact_signature compact_sig;
@@ -265,4 +337,8 @@ fc::optional<signature_type> yubihsm_wallet::try_sign_digest(const digest_type d
    return my->try_sign_digest(digest, public_key);
 }
 
+fc::optional<vector<signature_type>> yubihsm_wallet::try_sign_digests(const vector<digest_type>& digests, const public_key_type& public_key) {
+   return my->try_sign_digests(digests, public_key);
+}
+
 }}
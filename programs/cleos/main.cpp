@@ -69,6 +69,9 @@ Options:
 #include <vector>
 #include <regex>
 #include <iostream>
+#include <deque>
+#include <fstream>
+#include <future>
 #include <fc/crypto/hex.hpp>
 #include <fc/variant.hpp>
 #include <fc/io/datastream.hpp>
@@ -103,6 +106,7 @@ Options:
 #include <boost/algorithm/string/split.hpp>
 #include <boost/range/algorithm/copy.hpp>
 #include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/trim.hpp>
 
 #pragma pop_macro("N")
 
@@ -309,30 +313,43 @@ void sign_transaction(signed_transaction& trx, fc::variant& required_keys, const
    trx = signed_trx.as<signed_transaction>();
 }
 
-fc::variant push_transaction( signed_transaction& trx, packed_transaction::compression_type compression = packed_transaction::compression_type::none ) {
-   auto info = get_info();
+void sign_transactions(vector<signed_transaction>& trxs, const fc::variant& required_keys, const chain_id_type& chain_id) {
+   fc::variants sign_args = {fc::variant(trxs), required_keys, fc::variant(chain_id)};
+   const auto& signed_trxs = call(wallet_url, wallet_sign_trxs, sign_args);
+   trxs = signed_trxs.as<vector<signed_transaction>>();
+}
 
-   if (trx.signatures.size() == 0) { // #5445 can't change txn content if already signed
-      trx.expiration = info.head_block_time + tx_expiration;
+// Set tapos, default to last irreversible block if it's not specified by the user
+block_id_type determine_ref_block_id( const eosio::chain_apis::read_only::get_info_results& info ) {
+   block_id_type ref_block_id = info.last_irreversible_block_id;
+   try {
+      fc::variant ref_block;
+      if (!tx_ref_block_num_or_id.empty()) {
+         ref_block = call(get_block_func, fc::mutable_variant_object("block_num_or_id", tx_ref_block_num_or_id));
+         ref_block_id = ref_block["id"].as<block_id_type>();
+      }
+   } EOS_RETHROW_EXCEPTIONS(invalid_ref_block_exception, "Invalid reference block num or id: ${block_num_or_id}", ("block_num_or_id", tx_ref_block_num_or_id));
+   return ref_block_id;
+}
 
-      // Set tapos, default to last irreversible block if it's not specified by the user
-      block_id_type ref_block_id = info.last_irreversible_block_id;
-      try {
-         fc::variant ref_block;
-         if (!tx_ref_block_num_or_id.empty()) {
-            ref_block = call(get_block_func, fc::mutable_variant_object("block_num_or_id", tx_ref_block_num_or_id));
-            ref_block_id = ref_block["id"].as<block_id_type>();
-         }
-      } EOS_RETHROW_EXCEPTIONS(invalid_ref_block_exception, "Invalid reference block num or id: ${block_num_or_id}", ("block_num_or_id", tx_ref_block_num_or_id));
-      trx.set_reference_block(ref_block_id);
+void set_transaction_headers( signed_transaction& trx, const eosio::chain_apis::read_only::get_info_results& info, const block_id_type& ref_block_id ) {
+   trx.expiration = info.head_block_time + tx_expiration;
+   trx.set_reference_block(ref_block_id);
 
-      if (tx_force_unique) {
-         trx.context_free_actions.emplace_back( generate_nonce_action() );
-      }
+   if (tx_force_unique) {
+      trx.context_free_actions.emplace_back( generate_nonce_action() );
+   }
+
+   trx.max_cpu_usage_ms = tx_max_cpu_usage;
+   trx.max_net_usage_words = (tx_max_net_usage + 7)/8;
+   trx.delay_sec = delaysec;
+}
 
-      trx.max_cpu_usage_ms = tx_max_cpu_usage;
-      trx.max_net_usage_words = (tx_max_net_usage + 7)/8;
-      trx.delay_sec = delaysec;
+fc::variant push_transaction( signed_transaction& trx, packed_transaction::compression_type compression = packed_transaction::compression_type::none ) {
+   auto info = get_info();
+
+   if (trx.signatures.size() == 0) { // #5445 can't change txn content if already signed
+      set_transaction_headers(trx, info, determine_ref_block_id(info));
    }
 
    if (!tx_skip_sign) {
@@ -565,6 +582,150 @@ void send_transaction( signed_transaction& trx, packed_transaction::compression_
    }
 }
 
+/**
+ * Pushes one transaction of one action per line of in, a JSON object {"account", "name", "data", "authorization"}
+ * where data is the action arguments or their hex and authorization defaults to --permission. Empty lines and lines
+ * starting with '#' are skipped. Each window of transactions shares one get_info for TaPoS, is signed with one keosd
+ * call per distinct authorization and pushed with one push_transactions call. Up to pipeline windows are pushed
+ * while the next one is prepared.
+ */
+void push_bulk( std::istream& in, uint32_t window, uint32_t pipeline ) {
+   EOSC_ASSERT( window > 0 && window <= 1000, "ERROR: --window must be between 1 and 1000" ); // push_transactions limit
+   EOSC_ASSERT( pipeline > 0, "ERROR: --pipeline must be positive" );
+
+   const auto default_authorization = get_account_permissions(tx_permission);
+   map<vector<permission_level>, fc::variant> required_keys; // by authorization, keys do not depend on the action
+   std::deque<std::pair<vector<uint32_t>, std::future<fc::variant>>> in_flight;
+   uint64_t pushed = 0, failed = 0;
+
+   auto print_line = [&]( uint32_t line, const transaction_id_type& id, const fc::variant& error ) {
+      if( tx_print_json ) {
+         auto o = fc::mutable_variant_object( "line", line );
+         if( error.is_null() )
+            o( "transaction_id", id );
+         else
+            o( "error", error );
+         std::cout << fc::json::to_string( o, fc::time_point::maximum() ) << std::endl;
+      } else if( error.is_null() ) {
+         std::cout << "line " << line << ": " << id.str() << std::endl;
+      } else {
+         std::cout << "line " << line << ": error " << error.as_string() << std::endl;
+      }
+   };
+
+   auto wait_front = [&]() {
+      auto lines = std::move( in_flight.front().first );
+      auto results = in_flight.front().second.get();
+      in_flight.pop_front();
+      const auto& r = results.get_array();
+      EOSC_ASSERT( r.size() == lines.size(), "ERROR: push_transactions returned ${r} results for ${t} transactions",
+                   ("r", r.size())("t", lines.size()) );
+      for( size_t i = 0; i < r.size(); ++i ) {
+         const auto& processed = r[i]["processed"];
+         fc::variant error;
+         if( processed.is_object() && processed.get_object().contains( "error" ) )
+            error = processed["error"];
+         else if( processed.is_object() && processed.get_object().contains( "except" ) && !processed["except"].is_null() )
+            error = processed["except"]["message"];
+         ++(error.is_null() ? pushed : failed);
+         print_line( lines[i], r[i]["transaction_id"].as<transaction_id_type>(), error );
+      }
+   };
+
+   auto flush = [&]( vector<uint32_t>&& lines, vector<signed_transaction>&& trxs ) {
+      const auto info = get_info();
+      const auto ref_block_id = determine_ref_block_id( info );
+      for( auto& trx : trxs )
+         set_transaction_headers( trx, info, ref_block_id );
+
+      if( !tx_skip_sign ) {
+         map<vector<permission_level>, vector<size_t>> groups;
+         for( size_t i = 0; i < trxs.size(); ++i )
+            groups[trxs[i].actions.front().authorization].push_back( i );
+         for( const auto& g : groups ) {
+            auto k = required_keys.find( g.first );
+            if( k == required_keys.end() )
+               k = required_keys.emplace( g.first, determine_required_keys( trxs[g.second.front()] ) ).first;
+            vector<signed_transaction> group_trxs;
+            group_trxs.reserve( g.second.size() );
+            for( auto i : g.second )
+               group_trxs.push_back( std::move( trxs[i] ) );
+            sign_transactions( group_trxs, k->second, info.chain_id );
+            for( size_t j = 0; j < g.second.size(); ++j )
+               trxs[g.second[j]] = std::move( group_trxs[j] );
+         }
+      }
+
+      if( tx_dont_broadcast ) {
+         for( auto& trx : trxs ) {
+            auto v = tx_return_packed ? fc::variant( packed_transaction( trx ) ) : fc::variant( trx );
+            std::cout << fc::json::to_string( v, fc::time_point::maximum() ) << std::endl;
+         }
+         return;
+      }
+
+      fc::variants params;
+      params.reserve( trxs.size() );
+      for( auto& trx : trxs )
+         params.emplace_back( fc::variant( packed_transaction( std::move( trx ) ) ) );
+      while( in_flight.size() >= pipeline )
+         wait_front();
+      in_flight.emplace_back( std::move( lines ), std::async( std::launch::async, [params = std::move( params )]() {
+         return call( push_txns_func, params );
+      } ) );
+   };
+
+   vector<uint32_t> lines;
+   vector<signed_transaction> trxs;
+   string line;
+   for( uint32_t line_num = 1; std::getline( in, line ); ++line_num ) {
+      boost::trim( line );
+      if( line.empty() || line[0] == '#' )
+         continue;
+      try {
+         const auto v = fc::json::from_string( line, fc::json::parse_type::relaxed_parser );
+         const auto account = v["account"].as<account_name>();
+         const auto act_name = v["name"].as<action_name>();
+         auto authorization = v.get_object().contains( "authorization" ) ? v["authorization"].as<vector<permission_level>>()
+                                                                        : default_authorization;
+         EOSC_ASSERT( !authorization.empty(), "ERROR: line ${l} has no authorization and no --permission is given", ("l", line_num) );
+         const auto& data = v["data"];
+         bytes bin;
+         if( data.is_string() ) {
+            const auto hex = data.as_string();
+            bin.resize( hex.size() / 2 );
+            EOSC_ASSERT( fc::from_hex( hex, bin.data(), bin.size() ) == bin.size(), "ERROR: line ${l} has invalid hex data", ("l", line_num) );
+         } else {
+            bin = variant_to_bin( account, act_name, data );
+         }
+
+         signed_transaction trx;
+         trx.actions.emplace_back( std::move( authorization ), account, act_name, std::move( bin ) );
+         trxs.push_back( std::move( trx ) );
+         lines.push_back( line_num );
+      } catch( const explained_exception& ) {
+         throw;
+      } catch( const fc::exception& e ) {
+         ++failed;
+         print_line( line_num, transaction_id_type(), fc::variant( e.top_message() ) );
+         continue;
+      }
+
+      if( trxs.size() == window ) {
+         flush( std::move( lines ), std::move( trxs ) );
+         lines.clear();
+         trxs.clear();
+      }
+   }
+   if( !trxs.empty() )
+      flush( std::move( lines ), std::move( trxs ) );
+   while( !in_flight.empty() )
+      wait_front();
+
+   if( !tx_dont_broadcast )
+      std::cerr << localized("pushed ${p} transactions, ${f} failed", ("p", pushed)("f", failed)) << std::endl;
+}
+
 chain::permission_level to_permission_level(const std::string& s) {
    auto at_pos = s.find('@');
    return permission_level { name(s.substr(0, at_pos)), name(s.substr(at_pos + 1)) };
@@ -3436,6 +3597,25 @@ int main( int argc, char** argv ) {
    });
 
 
+   // push bulk
+   string bulk_file;
+   uint32_t bulk_window = 100;
+   uint32_t bulk_pipeline = 4;
+   auto bulkSubcommand = push->add_subcommand("bulk", localized("Push one transaction per JSON action line of a file or stdin, in windows sharing TaPoS, signing and a push_transactions call"));
+   bulkSubcommand->add_option("file", bulk_file, localized("The file of JSON actions {\"account\",\"name\",\"data\",\"authorization\"}, one per line, stdin when omitted or -"));
+   bulkSubcommand->add_option("--window", bulk_window, localized("The number of transactions per window"), true);
+   bulkSubcommand->add_option("--pipeline", bulk_pipeline, localized("The number of windows pushed concurrently"), true);
+   add_standard_transaction_options(bulkSubcommand);
+   bulkSubcommand->callback([&] {
+      if( bulk_file.empty() || bulk_file == "-" ) {
+         push_bulk( std::cin, bulk_window, bulk_pipeline );
+      } else {
+         std::ifstream in( bulk_file );
+         EOSC_ASSERT( in.is_open(), "ERROR: Failed to open \"${f}\"", ("f", bulk_file) );
+         push_bulk( in, bulk_window, bulk_pipeline );
+      }
+   });
+
    // multisig subcommand
    auto msig = app.add_subcommand("multisig", localized("Multisig contract commands"));
    msig->require_subcommand();
@@ -2,8 +2,10 @@
 #include <eosio/chain/abi_serializer.hpp>
 #include <eosio/chain/block_log.hpp>
 #include <eosio/chain/config.hpp>
+#include <eosio/chain/merkle.hpp>
 #include <eosio/chain/reversible_block_object.hpp>
 
+#include <fc/io/cfile.hpp>
 #include <fc/io/json.hpp>
 #include <fc/filesystem.hpp>
 #include <fc/variant.hpp>
@@ -14,7 +16,9 @@
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/path.hpp>
 
+#include <atomic>
 #include <chrono>
+#include <thread>
 
 #ifndef _WIN32
 #define FOPEN(p, m) fopen(p, m)
@@ -35,6 +39,8 @@ struct blocklog {
    {}
 
    void read_log();
+   void extract_blocks();
+   void verify_log();
    void set_program_options(options_description& cli);
    void initialize(const variables_map& options);
 
@@ -47,9 +53,34 @@ struct blocklog {
    bool                             make_index = false;
    bool                             trim_log = false;
    bool                             smoke_test = false;
+   bool                             extract = false;
+   bool                             verify = false;
+   uint32_t                         threads = std::max(std::thread::hardware_concurrency(), 1u);
    bool                             help = false;
 };
 
+// runs f(i) for i in [0, n) on n threads, rethrows the first exception of them
+template<typename F>
+void run_workers(uint32_t n, F&& f) {
+   std::vector<std::exception_ptr> errors(n);
+   std::vector<std::thread> workers;
+   for (uint32_t i = 0; i < n; ++i) {
+      workers.emplace_back([&f, &errors, i]() {
+         try {
+            f(i);
+         } catch (...) {
+            errors[i] = std::current_exception();
+         }
+      });
+   }
+   for (auto& w : workers)
+      w.join();
+   for (auto& e : errors) {
+      if (e)
+         std::rethrow_exception(e);
+   }
+}
+
 struct report_time {
     report_time(std::string desc)
     : _start(std::chrono::high_resolution_clock::now())
@@ -118,9 +149,9 @@ void blocklog::read_log() {
       *out << "[";
    uint32_t block_num = (first_block < 1) ? 1 : first_block;
    signed_block_ptr next;
-   fc::variant pretty_output;
    const fc::microseconds deadline = fc::seconds(10);
-   auto print_block = [&](signed_block_ptr& next) {
+   auto format_block = [&](const signed_block_ptr& next) {
+      fc::variant pretty_output;
       abi_serializer::to_variant(*next,
                                  pretty_output,
                                  []( account_name n ) { return optional<abi_serializer>(); },
@@ -134,28 +165,47 @@ void blocklog::read_log() {
                  (pretty_output.get_object());
       fc::variant v(std::move(enhanced_object));
       if (no_pretty_print)
-         *out << fc::json::to_string(v, fc::time_point::maximum());
+         return fc::json::to_string(v, fc::time_point::maximum());
       else
-         *out << fc::json::to_pretty_string(v) << "\n";
+         return fc::json::to_pretty_string(v) + "\n";
    };
    bool contains_obj = false;
-   while((block_num <= last_block) && (next = block_logger.read_block_by_num( block_num ))) {
+   auto print_block = [&](const std::string& formatted) {
       if (as_json_array && contains_obj)
          *out << ",";
-      print_block(next);
-      ++block_num;
+      *out << formatted;
       contains_obj = true;
+   };
+
+   // every worker formats a chunk of consecutive blocks, the chunks are printed in order
+   constexpr uint32_t chunk_size = 256;
+   for (bool done = false; !done && block_num <= last_block;) {
+      std::vector<std::vector<std::string>> chunks(threads);
+      run_workers(threads, [&](uint32_t i) {
+         const uint64_t begin = block_num + uint64_t(i) * chunk_size;
+         for (uint64_t n = begin; n < begin + chunk_size && n <= last_block; ++n) {
+            auto b = block_logger.read_block_by_num(n);
+            if (!b)
+               break;
+            chunks[i].push_back(format_block(b));
+         }
+      });
+      for (const auto& chunk : chunks) {
+         for (const auto& formatted : chunk)
+            print_block(formatted);
+         block_num += chunk.size();
+         if (chunk.size() < chunk_size) {
+            done = true;
+            break;
+         }
+      }
    }
 
    if (reversible_blocks) {
       const reversible_block_object* obj = nullptr;
       while( (block_num <= last_block) && (obj = reversible_blocks->find<reversible_block_object,by_num>(block_num)) ) {
-         if (as_json_array && contains_obj)
-            *out << ",";
-         auto next = obj->get_block();
-         print_block(next);
+         print_block(format_block(obj->get_block()));
          ++block_num;
-         contains_obj = true;
       }
    }
 
@@ -164,6 +214,107 @@ void blocklog::read_log() {
    rt.report();
 }
 
+void blocklog::extract_blocks() {
+   report_time rt("extracting blocks");
+   EOS_ASSERT( !output_file.empty(), block_log_exception, "extract-blocks needs output-file, the directory of the new block log" );
+   EOS_ASSERT( !bfs::exists(output_file / "blocks.log"), block_log_exception, "${f} already exists", ("f", (output_file / "blocks.log").generic_string()) );
+   block_log block_logger(blocks_dir);
+   const auto head = block_logger.head();
+   EOS_ASSERT( head, block_log_exception, "No blocks found in block log" );
+   first_block = std::max(first_block, block_logger.first_block_num());
+   last_block = std::min(last_block, head->block_num());
+   EOS_ASSERT( first_block <= last_block, block_log_exception, "No blocks in the range ${first} to ${last}", ("first", first_block)("last", last_block) );
+
+   // block_log writes the header of the new log, the blocks after the first are copied as they are serialized
+   uint32_t block_num = first_block;
+   {
+      block_log out(output_file);
+      if (first_block == 1) {
+         const auto gs = block_log::extract_genesis_state(blocks_dir);
+         EOS_ASSERT( gs, block_log_exception, "Block log starting with block 1 contains no genesis state" );
+         out.reset(*gs, block_logger.read_block_by_num(block_num++));
+      } else {
+         out.reset(block_log::extract_chain_id(blocks_dir), first_block);
+      }
+   }
+
+   fc::cfile out_blocks;
+   fc::cfile out_index;
+   out_blocks.set_file_path(output_file / "blocks.log");
+   out_index.set_file_path(output_file / "blocks.index");
+   out_blocks.open("ab");
+   out_index.open("ab");
+   out_blocks.seek_end(0);
+   for (; block_num <= last_block; ++block_num) {
+      const auto data = block_logger.read_serialized_block(block_num);
+      EOS_ASSERT( !data.empty(), block_log_exception, "Block ${n} is missing in block log", ("n", block_num) );
+      const uint64_t pos = out_blocks.tellp();
+      out_blocks.write(data.data(), data.size());
+      out_blocks.write((const char*)&pos, sizeof(pos));
+      out_index.write((const char*)&pos, sizeof(pos));
+   }
+   out_blocks.close();
+   out_index.close();
+
+   // opening checks that blocks.log and blocks.index agree
+   block_log extracted(output_file);
+   EOS_ASSERT( extracted.head() && extracted.head()->id() == block_logger.read_block_id_by_num(last_block), block_log_exception,
+               "Extracted block log does not end with block ${n}", ("n", last_block) );
+   ilog( "Wrote blocks ${first} to ${last} to ${dir}", ("first", first_block)("last", last_block)("dir", output_file.generic_string()) );
+   rt.report();
+}
+
+void blocklog::verify_log() {
+   report_time rt("verifying log");
+   block_log block_logger(blocks_dir);
+   const auto head = block_logger.head();
+   EOS_ASSERT( head, block_log_exception, "No blocks found in block log" );
+   first_block = std::max(first_block, block_logger.first_block_num());
+   last_block = std::min(last_block, head->block_num());
+   EOS_ASSERT( first_block <= last_block, block_log_exception, "No blocks in the range ${first} to ${last}", ("first", first_block)("last", last_block) );
+   const auto chain_id = block_log::extract_chain_id(blocks_dir);
+
+   // every worker checks a range of blocks, including the link of its first block to the block before it
+   const uint32_t num_blocks = last_block - first_block + 1;
+   const uint32_t workers = std::min(threads, num_blocks);
+   std::atomic<uint32_t> failures{0};
+   run_workers(workers, [&](uint32_t i) {
+      const uint32_t begin = first_block + uint64_t(num_blocks) * i / workers;
+      const uint32_t end = first_block + uint64_t(num_blocks) * (i + 1) / workers;
+      block_id_type prev_id = begin > block_logger.first_block_num() ? block_logger.read_block_id_by_num(begin - 1) : block_id_type();
+      for (uint32_t n = begin; n < end; ++n) {
+         try {
+            const auto b = block_logger.read_block_by_num(n);
+            EOS_ASSERT( b, block_log_exception, "block is missing" );
+            EOS_ASSERT( prev_id == block_id_type() || b->previous == prev_id, block_log_exception,
+                        "previous ${p} is not the id ${id} of the block before it", ("p", b->previous)("id", prev_id) );
+            prev_id = b->id();
+
+            vector<digest_type> trx_digests;
+            flat_set<public_key_type> keys;
+            for (const auto& receipt : b->transactions) {
+               trx_digests.emplace_back(receipt.digest());
+               if (receipt.trx.contains<packed_transaction>()) {
+                  keys.clear();
+                  receipt.trx.get<packed_transaction>().get_signed_transaction().get_signature_keys(chain_id, fc::time_point::maximum(), keys);
+               }
+            }
+            const auto trx_mroot = merkle(std::move(trx_digests));
+            EOS_ASSERT( b->transaction_mroot == trx_mroot, block_log_exception,
+                        "transaction merkle root ${b} != ${c}", ("b", b->transaction_mroot)("c", trx_mroot) );
+         } catch (const fc::exception& e) {
+            elog( "block ${n}: ${e}", ("n", n)("e", e.to_string()) );
+            ++failures;
+            prev_id = block_logger.read_block_id_by_num(n);
+         }
+      }
+   });
+   EOS_ASSERT( failures == 0, block_log_exception, "${f} of blocks ${first} to ${last} failed verification",
+               ("f", failures.load())("first", first_block)("last", last_block) );
+   ilog( "Blocks ${first} to ${last} verified", ("first", first_block)("last", last_block) );
+   rt.report();
+}
+
 void blocklog::set_program_options(options_description& cli)
 {
    cli.add_options()
@@ -185,6 +336,12 @@ void blocklog::set_program_options(options_description& cli)
           "Trim blocks.log and blocks.index. Must give 'blocks-dir' and 'first and/or 'last'.")
          ("smoke-test", bpo::bool_switch(&smoke_test)->default_value(false),
           "Quick test that blocks.log and blocks.index are well formed and agree with each other.")
+         ("extract-blocks", bpo::bool_switch(&extract)->default_value(false),
+          "Copy the blocks 'first' to 'last' into a new block log in the directory 'output-file', which can be used on its own.")
+         ("verify", bpo::bool_switch(&verify)->default_value(false),
+          "Check the links between the blocks 'first' to 'last', their transaction merkle roots and that the transaction signatures recover.")
+         ("threads", bpo::value<uint32_t>(&threads)->default_value(threads),
+          "Number of threads formatting blocks as JSON, making the index and verifying blocks.")
          ("help,h", bpo::bool_switch(&help)->default_value(false), "Print this help message and exit.")
          ;
 }
@@ -312,13 +469,22 @@ int main(int argc, char** argv) {
          report_time rt("making index");
          const auto log_level = fc::logger::get(DEFAULT_LOGGER).get_log_level();
          fc::logger::get(DEFAULT_LOGGER).set_log_level(fc::log_level::debug);
-         block_log::construct_index(block_file.generic_string(), out_file.generic_string());
+         block_log::construct_index(block_file.generic_string(), out_file.generic_string(), blog.threads);
          fc::logger::get(DEFAULT_LOGGER).set_log_level(log_level);
          rt.report();
          return 0;
       }
-      //else print blocks.log as JSON
+      blog.threads = std::max(blog.threads, 1u);
       blog.initialize(vmap);
+      if (blog.extract) {
+         blog.extract_blocks();
+         return 0;
+      }
+      if (blog.verify) {
+         blog.verify_log();
+         return 0;
+      }
+      //else print blocks.log as JSON
       blog.read_log();
    } catch( const fc::exception& e ) {
       elog( "${e}", ("e", e.to_detail_string()));
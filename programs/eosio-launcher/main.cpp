@@ -4,7 +4,12 @@
 #include <sstream>
 #include <regex>
 
+#include <thread>
+
 #include <boost/algorithm/string.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ip/host_name.hpp>
 #include <boost/program_options.hpp>
@@ -323,6 +328,35 @@ struct last_run_def {
   vector <node_rt_info> running_nodes;
 };
 
+/// latencies of one generator, as txn_test_gen_plugin reports them
+struct load_latency_stage {
+  uint64_t count = 0;
+  uint64_t p50_us = 0;
+  uint64_t p90_us = 0;
+  uint64_t p99_us = 0;
+  uint64_t max_us = 0;
+};
+
+struct load_generator_report {
+  string             name;
+  load_latency_stage accepted;
+  load_latency_stage in_block;
+  load_latency_stage irreversible;
+};
+
+struct load_report {
+  uint32_t duration_sec = 0;
+  uint32_t first_block = 0;
+  uint32_t last_block = 0;
+  uint64_t transactions = 0;
+  double   tps = 0;
+  double   avg_block_cpu_pct = 0;   ///< of max-block-cpu-usage
+  double   max_block_cpu_pct = 0;
+  double   net_bytes_per_sec = 0;   ///< of the transactions in the blocks
+  uint32_t missed_slots = 0;        ///< block slots of the run without a block, forks and late blocks
+  vector<load_generator_report> generators;
+};
+
 enum launch_modes {
   LM_NONE,
   LM_LOCAL,
@@ -428,6 +462,10 @@ struct launcher_def {
    fc::optional<uint32_t> max_block_cpu_usage;
    fc::optional<uint32_t> max_transaction_cpu_usage;
    eosio::chain::genesis_state genesis_from_file;
+   size_t txn_generators = 0;
+   uint32_t load_period_ms = 20;
+   uint32_t load_batch = 20;
+   string load_args;
 
    void assign_name (eosd_def &node, bool is_bios);
 
@@ -473,6 +511,8 @@ struct launcher_def {
    void roll (const string& host_names);
    void start_all (string &gts, launch_modes mode);
    void ignite ();
+   int txn_generator_index (const string &name);
+   void run_load (uint32_t seconds);
 };
 
 void
@@ -506,6 +546,10 @@ launcher_def::set_options (bpo::options_description &cfg) {
     ("script",bpo::value<string>(&start_script)->default_value("bios_boot.sh"),"the generated startup script name")
     ("max-block-cpu-usage",bpo::value<uint32_t>(),"Provide the \"max-block-cpu-usage\" value to use in the genesis.json file")
     ("max-transaction-cpu-usage",bpo::value<uint32_t>(),"Provide the \"max-transaction-cpu-usage\" value to use in the genesis.json file")
+    ("txn-generators",bpo::value<size_t>(&txn_generators)->default_value(0),"number of non-producing nodes, taken from the last one, that load the txn_test_gen_plugin and generate the load of \"--load\"")
+    ("load-period",bpo::value<uint32_t>(&load_period_ms)->default_value(20),"milliseconds between the batches of transactions each generator sends")
+    ("load-batch",bpo::value<uint32_t>(&load_batch)->default_value(20),"transactions of each batch of each generator")
+    ("load-args",bpo::value<string>(&load_args),"txn_test_gen_plugin config.ini lines added to each generator, such as the load profile, separated by ';'")
         ;
 }
 
@@ -567,6 +611,11 @@ launcher_def::initialize (const variables_map &vmap) {
      max_transaction_cpu_usage = vmap["max-transaction-cpu-usage"].as<uint32_t>();
   }
 
+  if (txn_generators > 26) {
+     cerr << "ERROR: at most 26 \"--txn-generators\" are supported" << endl;
+     exit (-1);
+  }
+
   genesis = vmap["genesis"].as<string>();
   if (vmap.count("host-map")) {
      host_map_file = vmap["host-map"].as<string>();
@@ -1144,9 +1193,33 @@ launcher_def::write_config_file (tn_node_def &node) {
   cfg << "plugin = eosio::net_plugin\n";
   cfg << "plugin = eosio::chain_api_plugin\n"
       << "plugin = eosio::history_api_plugin\n";
+  const int generator = txn_generator_index(node.name);
+  if (generator >= 0) {
+    // distinct accounts, so the generators do not conflict
+    cfg << "plugin = eosio::txn_test_gen_plugin\n";
+    cfg << "txn-test-gen-account-prefix = txn.gen" << char('a' + generator) << ".\n";
+    vector<string> lines;
+    if (!load_args.empty())
+      boost::split(lines, load_args, boost::is_any_of(";"));
+    for (const auto &l : lines) {
+      cfg << boost::trim_copy(l) << "\n";
+    }
+  }
   cfg.close();
 }
 
+/// the txn_test_gen_plugin generators are the last txn_generators nodes, -1 for the others
+int
+launcher_def::txn_generator_index (const string &name) {
+  if (name == "bios" || txn_generators == 0)
+    return -1;
+  const auto it = std::find(aliases.begin(), aliases.end(), name);
+  if (it == aliases.end())
+    return -1;
+  const size_t from_end = aliases.end() - it - 1;
+  return from_end < txn_generators ? (int)from_end : -1;
+}
+
 void
 launcher_def::write_logging_config_file(tn_node_def &node) {
   bfs::path filename;
@@ -1815,6 +1888,161 @@ launcher_def::roll (const string& host_names) {
    }
 }
 
+namespace {
+
+/// minimal HTTP POST to the http_plugin of a node, returns the body of the response; throws when the node does not answer 200
+string http_post (const string &host, uint16_t port, const string &path, const string &body) {
+   boost::asio::io_context ioc;
+   tcp::resolver resolver(ioc);
+   tcp::socket socket(ioc);
+   boost::asio::connect(socket, resolver.resolve(host, boost::lexical_cast<string>(port)));
+
+   const string request = "POST " + path + " HTTP/1.0\r\n"
+                          "Host: " + host + ":" + boost::lexical_cast<string>(port) + "\r\n"
+                          "Content-Type: application/json\r\n"
+                          "Content-Length: " + boost::lexical_cast<string>(body.size()) + "\r\n"
+                          "Connection: close\r\n\r\n" + body;
+   boost::asio::write(socket, boost::asio::buffer(request));
+
+   string response;
+   boost::system::error_code ec;
+   boost::asio::read(socket, boost::asio::dynamic_buffer(response), ec);
+   if (ec && ec != boost::asio::error::eof)
+      throw std::runtime_error(host + ":" + boost::lexical_cast<string>(port) + path + " failed: " + ec.message());
+
+   const auto header_end = response.find("\r\n\r\n");
+   const auto status = response.find(' ');
+   if (header_end == string::npos || status == string::npos || response.compare(status + 1, 3, "200") != 0)
+      throw std::runtime_error(host + ":" + boost::lexical_cast<string>(port) + path + " failed: " + response.substr(0, response.find("\r\n")) +
+                               (header_end == string::npos ? string() : " " + response.substr(header_end + 4)));
+   return response.substr(header_end + 4);
+}
+
+}
+
+/**
+ * Drives open loop load from the txn_test_gen_plugin of the generators of a running testnet: creates their accounts,
+ * starts all of them at the same time, stops them after the given seconds, and reports the throughput of the blocks
+ * of the run, as the bios node has them, and the latencies each generator measured to load_report.json.
+ */
+void
+launcher_def::run_load (uint32_t seconds) {
+   vector<eosd_def*> generators;
+   for (auto &node : network.nodes) {
+      if (txn_generator_index(node.first) >= 0)
+         generators.push_back(node.second.instance);
+   }
+   if (generators.empty()) {
+      cerr << "ERROR: \"--load\" requires \"--txn-generators\"" << endl;
+      exit (-1);
+   }
+   const eosd_def &bios = *network.nodes["bios"].instance;
+   auto head_block_num = [&]() {
+      return fc::json::from_string(http_post(bios.host, bios.http_port, "/v1/chain/get_info", "{}"))["head_block_num"].as<uint32_t>();
+   };
+
+   try {
+      for (auto g : generators) {
+         cerr << "creating the accounts of " << g->name << endl;
+         http_post(g->host, g->http_port, "/v1/txn_test_gen/create_test_accounts",
+                   "[\"eosio\",\"5KQwrPbwdL6PhXujxW37FSSQZ1JiwsST4cqQzDeyXtP79zkvFD3\"]");
+      }
+      // the accounts reach every generator before any of them sends transfers
+      std::this_thread::sleep_for(std::chrono::seconds(3));
+
+      load_report report;
+      report.duration_sec = seconds;
+      report.first_block = head_block_num() + 1;
+
+      // each generator is started by its own thread at the same time, so the schedules of the generators line up
+      const auto start_at = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+      vector<std::thread> starters;
+      vector<string> errors(generators.size());
+      for (size_t i = 0; i < generators.size(); ++i) {
+         starters.emplace_back([&, i]() {
+            std::this_thread::sleep_until(start_at);
+            try {
+               http_post(generators[i]->host, generators[i]->http_port, "/v1/txn_test_gen/start_generation",
+                         "[\"" + launch_time + "\"," + boost::lexical_cast<string>(load_period_ms) + "," + boost::lexical_cast<string>(load_batch) + "]");
+            } catch (const std::exception &e) {
+               errors[i] = e.what();
+            }
+         });
+      }
+      for (auto &t : starters)
+         t.join();
+      for (const auto &e : errors) {
+         if (!e.empty())
+            cerr << "unable to start generation: " << e << endl;
+      }
+
+      std::this_thread::sleep_until(start_at + std::chrono::seconds(seconds));
+      report.last_block = head_block_num();
+      for (auto g : generators) {
+         try {
+            http_post(g->host, g->http_port, "/v1/txn_test_gen/stop_generation", "{}");
+         } catch (const std::exception &e) {
+            cerr << "unable to stop generation of " << g->name << ": " << e.what() << endl;
+         }
+      }
+
+      uint32_t max_cpu = genesis_from_file.initial_configuration.max_block_cpu_usage;
+      const bfs::path genesis_path = genesis.is_complete() ? genesis : bfs::current_path() / genesis;
+      if (max_block_cpu_usage)
+         max_cpu = *max_block_cpu_usage;
+      else if (bfs::exists(genesis_path))
+         max_cpu = fc::json::from_file(genesis_path).as<eosio::chain::genesis_state>().initial_configuration.max_block_cpu_usage;
+      uint64_t net_words = 0;
+      double cpu_pct_sum = 0;
+      for (uint32_t n = report.first_block; n <= report.last_block; ++n) {
+         const auto block = fc::json::from_string(http_post(bios.host, bios.http_port, "/v1/chain/get_block",
+                                                            "{\"block_num_or_id\":" + boost::lexical_cast<string>(n) + "}"));
+         uint64_t cpu_us = 0;
+         for (const auto &r : block["transactions"].get_array()) {
+            ++report.transactions;
+            cpu_us += r["cpu_usage_us"].as_uint64();
+            net_words += r["net_usage_words"].as_uint64();
+         }
+         const double pct = max_cpu ? 100.0 * cpu_us / max_cpu : 0;
+         cpu_pct_sum += pct;
+         report.max_block_cpu_pct = std::max(report.max_block_cpu_pct, pct);
+      }
+      const uint32_t blocks = report.last_block >= report.first_block ? report.last_block - report.first_block + 1 : 0;
+      if (blocks)
+         report.avg_block_cpu_pct = cpu_pct_sum / blocks;
+      report.tps = seconds ? (double)report.transactions / seconds : 0;
+      report.net_bytes_per_sec = seconds ? net_words * 8.0 / seconds : 0;
+      const uint32_t slots = seconds * 2; // 500ms blocks
+      report.missed_slots = slots > blocks ? slots - blocks : 0;
+
+      // the generators measure until irreversible
+      std::this_thread::sleep_for(std::chrono::seconds(5));
+      for (auto g : generators) {
+         load_generator_report gr;
+         gr.name = g->name;
+         try {
+            fc::from_variant(fc::json::from_string(http_post(g->host, g->http_port, "/v1/txn_test_gen/get_latency", "{}")), gr);
+         } catch (const std::exception &e) {
+            cerr << "unable to retrieve the latencies of " << g->name << ": " << e.what() << endl;
+         }
+         gr.name = g->name;
+         report.generators.push_back(gr);
+      }
+
+      const auto str = fc::json::to_pretty_string(report);
+      bfs::ofstream rf(bfs::current_path() / "load_report.json");
+      rf << str << endl;
+      rf.close();
+      cout << str << endl;
+   } catch (const fc::exception &e) {
+      cerr << "load failed: " << e.to_detail_string() << endl;
+      exit (-1);
+   } catch (const std::exception &e) {
+      cerr << "load failed: " << e.what() << endl;
+      exit (-1);
+   }
+}
+
 void
 launcher_def::ignite() {
    if (boot) {
@@ -1950,6 +2178,7 @@ int main (int argc, char *argv[]) {
   string bounce_nodes;
   string down_nodes;
   string roll_nodes;
+  uint32_t load_seconds = 0;
   bfs::path config_dir;
   bfs::path config_file;
 
@@ -1964,6 +2193,7 @@ int main (int argc, char *argv[]) {
     ("down", bpo::value<string>(&down_nodes),"comma-separated list of node numbers that will be taken down using the eosio-tn_down.sh script")
     ("bounce", bpo::value<string>(&bounce_nodes),"comma-separated list of node numbers that will be restarted using the eosio-tn_bounce.sh script")
     ("roll", bpo::value<string>(&roll_nodes),"comma-separated list of host names where the nodes should be rolled to a new version using the eosio-tn_roll.sh script")
+    ("load", bpo::value<uint32_t>(&load_seconds),"seconds of load the \"--txn-generators\" of the running testnet generate, the topology options must match its launch. Writes load_report.json")
     ("version,v", "print version information")
     ("help,h","print this list")
     ("config-dir", bpo::value<bfs::path>(), "Directory containing configuration files such as config.ini")
@@ -2051,6 +2281,11 @@ int main (int argc, char *argv[]) {
     else if (!roll_nodes.empty()) {
        top.roll(roll_nodes);
     }
+    else if (load_seconds) {
+       top.nogen = true;
+       top.generate();
+       top.run_load(load_seconds);
+    }
     else {
       top.generate();
       top.start_all(gts, mode);
@@ -2100,3 +2335,10 @@ FC_REFLECT( server_identities, (producer) (nonprod) (db) (default_eosio_home) (s
 FC_REFLECT( node_rt_info, (remote)(pid_file)(kill_cmd) )
 
 FC_REFLECT( last_run_def, (running_nodes) )
+
+FC_REFLECT( load_latency_stage, (count)(p50_us)(p90_us)(p99_us)(max_us) )
+
+FC_REFLECT( load_generator_report, (name)(accepted)(in_block)(irreversible) )
+
+FC_REFLECT( load_report, (duration_sec)(first_block)(last_block)(transactions)(tps)(avg_block_cpu_pct)(max_block_cpu_pct)
+            (net_bytes_per_sec)(missed_slots)(generators) )
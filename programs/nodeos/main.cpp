@@ -93,6 +93,7 @@ int main(int argc, char** argv)
          .default_unix_socket_path = "",
          .default_http_port = 8888
       });
+      auto initialize_start = fc::time_point::now();
       if(!app().initialize<chain_plugin, net_plugin, producer_plugin>(argc, argv)) {
          const auto& opts = app().get_options();
          if( opts.count("help") || opts.count("version") || opts.count("full-version") || opts.count("print-default-config") ) {
@@ -106,7 +107,12 @@ int main(int argc, char** argv)
             ("fv", app().version_string() == app().full_version_string() ? "" : app().full_version_string()) );
       ilog("${name} using configuration file ${c}", ("name", nodeos::config::node_executable_name)("c", app().full_config_file_path().string()));
       ilog("${name} data directory is ${d}", ("name", nodeos::config::node_executable_name)("d", app().data_dir().string()));
+      ilog("${name} initialized plugins in ${t} ms", ("name", nodeos::config::node_executable_name)
+           ("t", (fc::time_point::now() - initialize_start).count() / 1000));
+      auto startup_start = fc::time_point::now();
       app().startup();
+      ilog("${name} started plugins in ${t} ms", ("name", nodeos::config::node_executable_name)
+           ("t", (fc::time_point::now() - startup_start).count() / 1000));
       app().set_thread_priority_max();
       app().exec();
    } catch( const extract_genesis_state_exception& e ) {
@@ -118,7 +124,8 @@ int main(int argc, char** argv)
    } catch( const fc::exception& e ) {
       if( e.code() == fc::std_exception_code ) {
          if( e.top_message().find( "database dirty flag set" ) != std::string::npos ) {
-            elog( "database dirty flag set (likely due to unclean shutdown): replay required" );
+            elog( "database dirty flag set (likely due to unclean shutdown): replay required, "
+                  "--resume-replay-blockchain starts it from the latest replay checkpoint if any" );
             return DATABASE_DIRTY;
          }
       }
@@ -132,7 +139,8 @@ int main(int argc, char** argv)
       return OTHER_FAIL;
    } catch( const std::runtime_error& e ) {
       if( std::string(e.what()).find("database dirty flag set") != std::string::npos ) {
-         elog( "database dirty flag set (likely due to unclean shutdown): replay required" );
+         elog( "database dirty flag set (likely due to unclean shutdown): replay required, "
+               "--resume-replay-blockchain starts it from the latest replay checkpoint if any" );
          return DATABASE_DIRTY;
       } else {
          elog( "${e}", ("e",e.what()));
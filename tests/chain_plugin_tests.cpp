@@ -118,4 +118,82 @@ BOOST_FIXTURE_TEST_CASE( get_block_with_invalid_abi, TESTER ) try {
 
 } FC_LOG_AND_RETHROW() /// get_block_with_invalid_abi
 
+BOOST_FIXTURE_TEST_CASE( abi_serializer_cache_test, tester ) try {
+   produce_blocks(2);
+
+   create_accounts( {N(asserter), N(token)} );
+   produce_block();
+
+   chain_apis::abi_serializer_cache cache( 1 );
+   BOOST_TEST( cache.get( *control, N(nonexistent) ) == nullptr );
+
+   auto no_abi = cache.get( *control, N(asserter) );
+   BOOST_REQUIRE( no_abi );
+   BOOST_TEST( !no_abi->has_abi );
+
+   set_abi( N(asserter), contracts::asserter_abi().data() );
+   produce_blocks(1);
+
+   // reused until the abi changes
+   auto asserter_abi = cache.get( *control, N(asserter) );
+   BOOST_REQUIRE( asserter_abi && asserter_abi->has_abi );
+   BOOST_TEST( asserter_abi != no_abi );
+   BOOST_TEST( cache.get( *control, N(asserter) ) == asserter_abi );
+   const auto& abis = asserter_abi->get_serializer( abi_serializer::create_yield_function( abi_serializer_max_time ) );
+   BOOST_TEST( !abis.get_action_type( N(procassert) ).empty() );
+   BOOST_TEST( &asserter_abi->get_serializer( abi_serializer::create_yield_function( abi_serializer_max_time ) ) == &abis );
+
+   // a setabi in the pending block that is aborted, then redone with another abi, reuses the abi_sequence
+   set_abi( N(asserter), contracts::eosio_token_abi().data() );
+   auto pending_abi = cache.get( *control, N(asserter) );
+   BOOST_TEST( pending_abi != asserter_abi );
+   control->abort_block();
+   BOOST_TEST( cache.get( *control, N(asserter) ) != pending_abi );
+   set_abi( N(asserter), contracts::get_table_test_abi().data() );
+   auto redone_abi = cache.get( *control, N(asserter) );
+   BOOST_TEST( redone_abi != pending_abi );
+   BOOST_REQUIRE( !redone_abi->abi.tables.empty() );
+   BOOST_TEST( redone_abi->abi.tables.front().name == N(hashobjs) );
+   produce_blocks(1);
+
+   // bounded, token evicts asserter
+   set_abi( N(token), contracts::eosio_token_abi().data() );
+   produce_blocks(1);
+   BOOST_TEST( cache.get( *control, N(asserter) ) == redone_abi );
+   cache.get( *control, N(token) );
+   BOOST_TEST( cache.size() == 1u );
+   BOOST_TEST( cache.get( *control, N(asserter) ) != redone_abi );
+
+} FC_LOG_AND_RETHROW() /// abi_serializer_cache_test
+
+BOOST_FIXTURE_TEST_CASE( response_cache_test, tester ) try {
+   produce_blocks(3);
+
+   chain_apis::abi_serializer_cache abi_cache( 10 );
+   chain_apis::response_cache resp_cache( 10, abi_cache );
+   chain_apis::read_only plugin( *control, {}, fc::microseconds::maximum(), &abi_cache, &resp_cache );
+
+   // reversible blocks are not cached
+   const auto head = std::to_string( control->head_block_num() );
+   if( control->head_block_num() > control->last_irreversible_block_num() ) {
+      plugin.get_block( {head} );
+      BOOST_TEST( resp_cache.get( *control, "get_block:" + head ).is_null() );
+   }
+
+   const auto lib = std::to_string( control->last_irreversible_block_num() );
+   auto block = plugin.get_block( {lib} );
+   BOOST_TEST( resp_cache.size() == 1u );
+   BOOST_TEST( fc::json::to_string( plugin.get_block( {lib} ), fc::time_point::maximum() ) ==
+               fc::json::to_string( block, fc::time_point::maximum() ) );
+
+   // the onblock action of the block is decoded with the abi of eosio, a new one drops the response
+   BOOST_TEST( !resp_cache.get( *control, "get_block:" + lib ).is_null() );
+   set_abi( config::system_account_name, contracts::eosio_token_abi().data() );
+   produce_blocks(1);
+   BOOST_TEST( resp_cache.get( *control, "get_block:" + lib ).is_null() );
+   BOOST_TEST( plugin.get_block( {lib} )["block_num"].as_string() == lib );
+   BOOST_TEST( !resp_cache.get( *control, "get_block:" + lib ).is_null() );
+
+} FC_LOG_AND_RETHROW() /// response_cache_test
+
 BOOST_AUTO_TEST_SUITE_END()
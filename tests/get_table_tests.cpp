@@ -670,4 +670,179 @@ BOOST_FIXTURE_TEST_CASE( get_table_next_key_test, TESTER ) try {
 
 } FC_LOG_AND_RETHROW() /// get_table_next_key_test
 
+BOOST_FIXTURE_TEST_CASE( get_table_cursor_test, TESTER ) try {
+   create_account(N(test));
+
+   set_code( N(test), contracts::get_table_test_wasm() );
+   set_abi( N(test), contracts::get_table_test_abi().data() );
+   produce_block();
+
+   // rows 1, 2 and 3 share the secondary key 5, next_key alone can not page through them one by one
+   for( uint64_t input : { 2, 5, 5, 5, 7 } )
+      push_action(N(test), N(addnumobj), N(test), mutable_variant_object()("input", input));
+   produce_block();
+
+   chain_apis::read_only plugin(*(this->control), {}, fc::microseconds::maximum());
+   chain_apis::read_only::get_table_rows_params params{
+      .json=true,
+      .code=N(test),
+      .scope="test",
+      .limit=1
+   };
+   params.table = N(numobjs);
+   params.key_type = "i64";
+
+   auto page_through = [&]( const string& index_position, bool reverse ) {
+      params.index_position = index_position;
+      params.reverse = reverse;
+      params.cursor.clear();
+      vector<uint64_t> keys;
+      for( int pages = 0; pages < 10; ++pages ) {
+         auto res = plugin.get_table_rows(params);
+         for( const auto& row : res.rows )
+            keys.push_back( row["key"].as<uint64_t>() );
+         if( !res.more ) {
+            BOOST_TEST( res.next_cursor.empty() );
+            break;
+         }
+         BOOST_REQUIRE( !res.next_cursor.empty() );
+         params.cursor = res.next_cursor;
+      }
+      return keys;
+   };
+
+   BOOST_TEST( page_through( "1", false ) == (vector<uint64_t>{0, 1, 2, 3, 4}) );
+   BOOST_TEST( page_through( "1", true )  == (vector<uint64_t>{4, 3, 2, 1, 0}) );
+   BOOST_TEST( page_through( "2", false ) == (vector<uint64_t>{0, 1, 2, 3, 4}) );
+   BOOST_TEST( page_through( "2", true )  == (vector<uint64_t>{4, 3, 2, 1, 0}) );
+
+   // bounds still apply
+   params.index_position = "2";
+   params.reverse = false;
+   params.cursor.clear();
+   params.upper_bound = "5";
+   auto res = plugin.get_table_rows(params);
+   params.cursor = res.next_cursor;
+   params.limit = 10;
+   res = plugin.get_table_rows(params);
+   BOOST_TEST( res.rows.size() == 3u );
+   BOOST_TEST( !res.more );
+
+   // a cursor is only valid for the index and direction it was returned for
+   params.reverse = true;
+   BOOST_CHECK_THROW( plugin.get_table_rows(params), chain::contract_table_query_exception );
+   params.reverse = false;
+   params.index_position = "3";
+   params.key_type = "i128";
+   BOOST_CHECK_THROW( plugin.get_table_rows(params), chain::contract_table_query_exception );
+   params.cursor = "zz";
+   BOOST_CHECK_THROW( plugin.get_table_rows(params), chain::contract_table_query_exception );
+
+} FC_LOG_AND_RETHROW() /// get_table_cursor_test
+
+BOOST_FIXTURE_TEST_CASE( get_table_rows_batch_test, TESTER ) try {
+   create_account(N(test));
+
+   set_code( N(test), contracts::get_table_test_wasm() );
+   set_abi( N(test), contracts::get_table_test_abi().data() );
+   produce_block();
+
+   for( uint64_t input : { 2, 5, 7 } )
+      push_action(N(test), N(addnumobj), N(test), mutable_variant_object()("input", input));
+   produce_block();
+
+   chain_apis::read_only plugin(*(this->control), {}, fc::microseconds::maximum());
+   chain_apis::read_only::get_table_rows_params query{
+      .json=true,
+      .code=N(test),
+      .scope="test",
+      .limit=10
+   };
+   query.table = N(numobjs);
+
+   chain_apis::read_only::get_table_rows_batch_params params;
+   params.queries.push_back( query );
+   query.scope = "nobody";
+   params.queries.push_back( query );
+   query.code = N(missing);
+   params.queries.push_back( query );
+
+   auto res = plugin.get_table_rows_batch(params);
+   BOOST_TEST( !res.more );
+   BOOST_REQUIRE_EQUAL( res.results.size(), 3u );
+   BOOST_REQUIRE( res.results[0].result.valid() );
+   BOOST_TEST( res.results[0].result->rows.size() == plugin.get_table_rows(params.queries[0]).rows.size() );
+   BOOST_TEST( res.results[0].result->rows.size() == 3u );
+   BOOST_REQUIRE( res.results[1].result.valid() );
+   BOOST_TEST( res.results[1].result->rows.empty() );
+   // a failing query does not fail the batch
+   BOOST_TEST( !res.results[2].result.valid() );
+   BOOST_TEST( res.results[2].error.valid() );
+
+   params.queries.resize( chain_apis::read_only::max_table_rows_batch_size + 1, params.queries[0] );
+   BOOST_CHECK_THROW( plugin.get_table_rows_batch(params), chain::contract_table_query_exception );
+
+} FC_LOG_AND_RETHROW() /// get_table_rows_batch_test
+
+
+BOOST_FIXTURE_TEST_CASE( get_account_tokens_test, TESTER ) try {
+   produce_blocks(2);
+
+   create_accounts({ N(eosio.token), N(token.b), N(inita), N(initb) });
+   produce_block();
+
+   for (account_name code : {N(eosio.token), N(token.b)}) {
+      set_code( code, contracts::eosio_token_wasm() );
+      set_abi( code, contracts::eosio_token_abi().data() );
+   }
+   produce_blocks(1);
+
+   push_action(N(eosio.token), N(create), N(eosio.token), mutable_variant_object()
+         ("issuer", "eosio")("maximum_supply", eosio::chain::asset::from_string("1000000000.0000 SYS")) );
+   push_action(N(token.b), N(create), N(token.b), mutable_variant_object()
+         ("issuer", "eosio")("maximum_supply", eosio::chain::asset::from_string("1000000000.0000 BBB")) );
+   issue_tokens( *this, config::system_account_name, N(inita), eosio::chain::asset::from_string("10.0000 SYS") );
+   produce_blocks(1);
+
+   // built from the state, then maintained from the controller
+   eosio::chain_apis::account_tokens_db atdb(*control);
+   control->set_table_lifecycle_callback([&](const table_id_object& t, bool) { atdb.table_changed(t); });
+
+   issue_tokens( *this, config::system_account_name, N(inita), eosio::chain::asset::from_string("20.0000 BBB"), "", N(token.b) );
+   issue_tokens( *this, config::system_account_name, N(initb), eosio::chain::asset::from_string("30.0000 BBB"), "", N(token.b) );
+   produce_blocks(1);
+
+   eosio::chain_apis::read_only plugin(*(this->control), {}, fc::microseconds::maximum(), nullptr, nullptr, nullptr, &atdb);
+   eosio::chain_apis::read_only::get_account_tokens_params p;
+   p.account = N(inita);
+   auto result = plugin.get_account_tokens(p);
+   BOOST_REQUIRE_EQUAL(2u, result.tokens.size());
+   BOOST_CHECK_EQUAL(name(N(eosio.token)), result.tokens[0].code);
+   BOOST_CHECK_EQUAL(eosio::chain::asset::from_string("10.0000 SYS"), result.tokens[0].balance);
+   BOOST_CHECK_EQUAL(name(N(token.b)), result.tokens[1].code);
+   BOOST_CHECK_EQUAL(eosio::chain::asset::from_string("20.0000 BBB"), result.tokens[1].balance);
+   BOOST_CHECK(!result.more);
+
+   p.limit = 1;
+   result = plugin.get_account_tokens(p);
+   BOOST_REQUIRE_EQUAL(1u, result.tokens.size());
+   BOOST_REQUIRE(result.more);
+   BOOST_CHECK_EQUAL(name(N(token.b)), *result.more);
+
+   p.limit = 100;
+   p.symbol = "BBB";
+   p.account = N(initb);
+   result = plugin.get_account_tokens(p);
+   BOOST_REQUIRE_EQUAL(1u, result.tokens.size());
+   BOOST_CHECK_EQUAL(eosio::chain::asset::from_string("30.0000 BBB"), result.tokens[0].balance);
+
+   // eosio holds the issued tokens before transferring them, tables still in the state stay once irreversible
+   BOOST_CHECK_EQUAL(5u, atdb.size());
+   atdb.commit_irreversible(control->head_block_num());
+   BOOST_CHECK_EQUAL(5u, atdb.size());
+
+   control->set_table_lifecycle_callback(nullptr);
+
+} FC_LOG_AND_RETHROW() /// get_account_tokens_test
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,355 @@
+#include <eosio/chain/block_log.hpp>
+#include <eosio/net_plugin/protocol.hpp>
+#include <eosio/testing/tester.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <contracts.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+
+#include <time.h>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+using mvo = fc::mutable_variant_object;
+
+/*
+ * Measures controller block apply plus net_message serialization over loopback sockets, NOT net_plugin: none of its
+ * sync, relay or connection code runs, so its own regressions do not show here. net_plugin is a single instance per
+ * process, so each node is a tester which unpacks a received block with the framing of net_plugin, applies it and
+ * sends it packed again to its downstream peers. A feeder sends a recorded block range in to the first node of a
+ * topology:
+ *    sync         all blocks at once, throughput until the last node has applied the last block
+ *    propagation  one block at a time, latency until every node has applied it
+ * Every run prints one line
+ *    benchmark {"measures":"controller apply + serialization, not net_plugin","topology":...,...}
+ * for regression tracking. Built as the net_benchmark executable outside of plugin_test and not run by ctest. EOSIO_NET_BENCHMARK_NODES and EOSIO_NET_BENCHMARK_BLOCKS override the number of nodes
+ * and of recorded blocks with token transfers. EOSIO_NET_BENCHMARK_BLOCK_LOG replays the blocks of the block log in
+ * that directory instead, which has to start with its genesis.
+ */
+
+struct net_benchmark_result {
+   std::string measures = "controller apply + serialization, not net_plugin";
+   std::string topology;
+   std::string mode;
+   uint32_t    nodes = 0;
+   uint32_t    hops = 0;             ///< from the feeder to the farthest node
+   uint32_t    blocks = 0;
+   int64_t     total_us = 0;
+   double      blocks_per_second = 0;
+   int64_t     latency_p50_us = 0;   ///< propagation to every node, propagation mode only
+   int64_t     latency_p90_us = 0;
+   int64_t     latency_max_us = 0;
+   int64_t     cpu_us_per_block_hop = 0; ///< unpack, apply and relay of a block by one node
+};
+FC_REFLECT( net_benchmark_result, (measures)(topology)(mode)(nodes)(hops)(blocks)(total_us)(blocks_per_second)
+            (latency_p50_us)(latency_p90_us)(latency_max_us)(cpu_us_per_block_hop) )
+
+namespace {
+
+using boost::asio::ip::tcp;
+
+constexpr uint32_t signed_block_which = 7; ///< of signed_block in net_message
+constexpr uint32_t transfers_per_block = 20;
+
+uint32_t env_or( const char* var, uint32_t def ) {
+   if( const char* v = getenv( var ) )
+      return std::max( 1, atoi( v ) );
+   return def;
+}
+
+int64_t thread_cpu_ns() {
+   timespec ts;
+   clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts );
+   return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+struct recorded_blocks {
+   genesis_state            genesis;
+   vector<signed_block_ptr> blocks; ///< from block 2 on
+};
+
+/// token transfers produced once per run of the suite, or the blocks of EOSIO_NET_BENCHMARK_BLOCK_LOG
+const recorded_blocks& recorded() {
+   static const recorded_blocks r = []() {
+      recorded_blocks r;
+      if( const char* dir = getenv( "EOSIO_NET_BENCHMARK_BLOCK_LOG" ) ) {
+         auto genesis = block_log::extract_genesis_state( fc::path( dir ) );
+         BOOST_REQUIRE_MESSAGE( genesis, "the block log has to start with its genesis" );
+         r.genesis = *genesis;
+         block_log log{ fc::path( dir ) };
+         const uint32_t last = std::min( log.head()->block_num(), 1 + env_or( "EOSIO_NET_BENCHMARK_BLOCKS", 1000 ) );
+         for( uint32_t n = 2; n <= last; ++n )
+            r.blocks.push_back( log.read_block_by_num( n ) );
+         return r;
+      }
+
+      tester producer;
+      producer.create_accounts( {N(eosio.token), N(alice), N(bob)} );
+      producer.set_code( N(eosio.token), contracts::eosio_token_wasm() );
+      producer.set_abi( N(eosio.token), contracts::eosio_token_abi().data() );
+      producer.produce_block();
+      producer.push_action( N(eosio.token), N(create), N(eosio.token), mvo()
+         ("issuer", "alice")
+         ("maximum_supply", "1000000000.0000 TKN") );
+      producer.push_action( N(eosio.token), N(issue), N(alice), mvo()
+         ("to", "alice")
+         ("quantity", "1000000000.0000 TKN")
+         ("memo", "") );
+      producer.produce_block();
+
+      const uint32_t blocks = env_or( "EOSIO_NET_BENCHMARK_BLOCKS", 50 );
+      for( uint32_t b = 0; b < blocks; ++b ) {
+         for( uint32_t t = 0; t < transfers_per_block; ++t ) {
+            producer.push_action( N(eosio.token), N(transfer), N(alice), mvo()
+               ("from", "alice")
+               ("to", "bob")
+               ("quantity", "0.0001 TKN")
+               ("memo", std::to_string( b * transfers_per_block + t )) );
+         }
+         producer.produce_block();
+      }
+
+      r.genesis = base_tester::default_genesis();
+      for( uint32_t n = 2; n <= producer.control->head_block_num(); ++n )
+         r.blocks.push_back( producer.control->fetch_block_by_number( n ) );
+      return r;
+   }();
+   return r;
+}
+
+/// the send buffer of net_plugin for a block: payload size, then the block packed as a net_message
+std::shared_ptr<vector<char>> pack_block( const signed_block& b ) {
+   const uint32_t payload_size = fc::raw::pack_size( unsigned_int( signed_block_which ) ) + fc::raw::pack_size( b );
+   auto buffer = std::make_shared<vector<char>>( sizeof( payload_size ) + payload_size );
+   fc::datastream<char*> ds( buffer->data(), buffer->size() );
+   ds.write( reinterpret_cast<const char*>( &payload_size ), sizeof( payload_size ) );
+   fc::raw::pack( ds, unsigned_int( signed_block_which ) );
+   fc::raw::pack( ds, b );
+   return buffer;
+}
+
+struct bench_connection {
+   explicit bench_connection( boost::asio::io_context& io ) : socket( io ) {}
+
+   tcp::socket                              socket;
+   std::deque<std::shared_ptr<vector<char>>> write_queue;
+   uint32_t                                 payload_size = 0;
+   vector<char>                             payload;
+};
+using bench_connection_ptr = std::shared_ptr<bench_connection>;
+
+struct bench_node {
+   std::unique_ptr<fc::temp_directory> dir; ///< before chain, removed after the controller is closed
+   std::unique_ptr<tester>             chain; ///< none for the feeder
+   vector<bench_connection_ptr>        downstream;
+   bench_connection_ptr                upstream;
+   uint32_t                            depth = 0;
+   uint32_t                            head = 0;
+   int64_t                             cpu_ns = 0;
+};
+
+/// node 0 feeds the blocks, the others are linked to their parent in the topology
+class net_benchmark {
+public:
+   net_benchmark( std::string topology, uint32_t nodes, const std::function<uint32_t(uint32_t)>& parent_of )
+   : topology( std::move( topology ) ), nodes( nodes + 1 ) {
+      for( uint32_t i = 1; i <= nodes; ++i ) {
+         auto& n = this->nodes[i];
+         n.dir = std::make_unique<fc::temp_directory>();
+         n.chain = std::make_unique<tester>( base_tester::default_config( *n.dir ).first, recorded().genesis );
+         n.head = n.chain->control->head_block_num();
+         link( parent_of( i ), i );
+      }
+      for( const auto& n : this->nodes )
+         hops = std::max( hops, n.depth );
+   }
+
+   ~net_benchmark() {
+      boost::system::error_code ec;
+      for( auto& n : nodes ) {
+         for( auto& c : n.downstream )
+            c->socket.close( ec );
+         if( n.upstream )
+            n.upstream->socket.close( ec );
+      }
+      io.restart();
+      io.run(); // the outstanding reads complete with operation_aborted
+   }
+
+   net_benchmark_result sync() {
+      const auto& blocks = recorded().blocks;
+      const auto start = std::chrono::steady_clock::now();
+      for( const auto& b : blocks )
+         feed( b );
+      run_until( blocks.back()->block_num() );
+      return result( "sync", std::chrono::steady_clock::now() - start, {} );
+   }
+
+   net_benchmark_result propagation() {
+      const auto& blocks = recorded().blocks;
+      vector<int64_t> latencies;
+      latencies.reserve( blocks.size() );
+      const auto start = std::chrono::steady_clock::now();
+      for( const auto& b : blocks ) {
+         const auto sent = std::chrono::steady_clock::now();
+         feed( b );
+         run_until( b->block_num() );
+         latencies.push_back( std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - sent ).count() );
+      }
+      return result( "propagation", std::chrono::steady_clock::now() - start, std::move( latencies ) );
+   }
+
+private:
+   void link( uint32_t from, uint32_t to ) {
+      tcp::acceptor acceptor( io, tcp::endpoint( boost::asio::ip::address_v4::loopback(), 0 ) );
+      auto out = std::make_shared<bench_connection>( io );
+      auto in = std::make_shared<bench_connection>( io );
+      out->socket.connect( acceptor.local_endpoint() );
+      acceptor.accept( in->socket );
+      out->socket.set_option( tcp::no_delay( true ) );
+      in->socket.set_option( tcp::no_delay( true ) );
+      nodes[from].downstream.push_back( out );
+      nodes[to].upstream = in;
+      nodes[to].depth = nodes[from].depth + 1;
+      read( to );
+   }
+
+   void feed( const signed_block_ptr& b ) {
+      auto buffer = pack_block( *b );
+      for( auto& c : nodes[0].downstream )
+         write( c, buffer );
+   }
+
+   void write( const bench_connection_ptr& c, std::shared_ptr<vector<char>> buffer ) {
+      c->write_queue.push_back( std::move( buffer ) );
+      if( c->write_queue.size() == 1 )
+         write_next( c );
+   }
+
+   void write_next( const bench_connection_ptr& c ) {
+      boost::asio::async_write( c->socket, boost::asio::buffer( *c->write_queue.front() ),
+                                [this, c]( const boost::system::error_code& ec, size_t ) {
+         if( ec ) return;
+         c->write_queue.pop_front();
+         if( !c->write_queue.empty() )
+            write_next( c );
+      } );
+   }
+
+   void read( uint32_t node ) {
+      auto c = nodes[node].upstream;
+      boost::asio::async_read( c->socket, boost::asio::buffer( &c->payload_size, sizeof( c->payload_size ) ),
+                               [this, node, c]( const boost::system::error_code& ec, size_t ) {
+         if( ec ) return;
+         c->payload.resize( c->payload_size );
+         boost::asio::async_read( c->socket, boost::asio::buffer( c->payload ),
+                                  [this, node, c]( const boost::system::error_code& ec, size_t ) {
+            if( ec ) return;
+            on_block( node, c->payload );
+            read( node );
+         } );
+      } );
+   }
+
+   void on_block( uint32_t node, const vector<char>& payload ) {
+      auto& n = nodes[node];
+      const int64_t start = thread_cpu_ns();
+      fc::datastream<const char*> ds( payload.data(), payload.size() );
+      net_message msg;
+      fc::raw::unpack( ds, msg );
+      BOOST_REQUIRE( msg.contains<signed_block>() );
+      auto b = std::make_shared<signed_block>( std::move( msg.get<signed_block>() ) );
+      n.chain->push_block( b );
+      n.head = b->block_num();
+      if( !n.downstream.empty() ) {
+         auto buffer = pack_block( *b );
+         for( auto& c : n.downstream )
+            write( c, buffer );
+      }
+      n.cpu_ns += thread_cpu_ns() - start;
+   }
+
+   void run_until( uint32_t block_num ) {
+      auto done = [&]() {
+         return std::all_of( nodes.begin() + 1, nodes.end(), [&]( const bench_node& n ) { return n.head >= block_num; } );
+      };
+      while( !done() )
+         io.run_one();
+   }
+
+   net_benchmark_result result( const char* mode, std::chrono::steady_clock::duration elapsed, vector<int64_t> latencies ) {
+      net_benchmark_result r;
+      r.topology = topology;
+      r.mode = mode;
+      r.nodes = nodes.size() - 1;
+      r.hops = hops;
+      r.blocks = recorded().blocks.size();
+      r.total_us = std::chrono::duration_cast<std::chrono::microseconds>( elapsed ).count();
+      r.blocks_per_second = r.total_us ? r.blocks * 1e6 / r.total_us : 0;
+      if( !latencies.empty() ) {
+         std::sort( latencies.begin(), latencies.end() );
+         auto percentile = [&]( uint32_t p ) { return latencies[std::min<size_t>( latencies.size() - 1, latencies.size() * p / 100 )]; };
+         r.latency_p50_us = percentile( 50 );
+         r.latency_p90_us = percentile( 90 );
+         r.latency_max_us = latencies.back();
+      }
+      int64_t cpu_ns = 0;
+      for( const auto& n : nodes )
+         cpu_ns += n.cpu_ns;
+      r.cpu_us_per_block_hop = cpu_ns / 1000 / (int64_t(r.blocks) * r.nodes);
+
+      std::cout << "benchmark " << fc::json::to_string( r, fc::time_point::maximum() ) << std::endl;
+      return r;
+   }
+
+   boost::asio::io_context io; ///< before the connections, the handlers run on this thread
+   const std::string       topology;
+   vector<bench_node>      nodes;
+   uint32_t                hops = 0;
+};
+
+void run_topology( const std::string& topology, const std::function<uint32_t(uint32_t)>& parent_of ) {
+   const uint32_t nodes = env_or( "EOSIO_NET_BENCHMARK_NODES", 4 );
+   {
+      net_benchmark net( topology, nodes, parent_of );
+      net.sync();
+   }
+   {
+      net_benchmark net( topology, nodes, parent_of );
+      net.propagation();
+   }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(net_benchmark_tests)
+
+// feeder -> 1 -> 2 -> ... -> n, every block crosses n hops
+BOOST_AUTO_TEST_CASE( line_benchmark ) try {
+   run_topology( "line", []( uint32_t i ) { return i - 1; } );
+} FC_LOG_AND_RETHROW()
+
+// feeder -> 1 -> each of 2..n
+BOOST_AUTO_TEST_CASE( star_benchmark ) try {
+   run_topology( "star", []( uint32_t i ) { return i == 1 ? 0 : 1; } );
+} FC_LOG_AND_RETHROW()
+
+// feeder -> 1, then every node relays to two children
+BOOST_AUTO_TEST_CASE( tree_benchmark ) try {
+   run_topology( "tree", []( uint32_t i ) { return i / 2; } );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -175,6 +175,23 @@ BOOST_AUTO_TEST_CASE(wallet_manager_test)
    BOOST_CHECK(find(pks.cbegin(), pks.cend(), pkey1.get_public_key()) != pks.cend());
    BOOST_CHECK(find(pks.cbegin(), pks.cend(), pkey2.get_public_key()) != pks.cend());
 
+   // batch signing on the pool and on the calling thread signs like sign_transaction
+   for(uint16_t threads : {2, 0}) {
+      wm.set_sign_threads(threads);
+      std::vector<chain::signed_transaction> trxs(5);
+      for(size_t i = 0; i < trxs.size(); ++i)
+         trxs[i].ref_block_num = i;
+      auto signed_trxs = wm.sign_transactions(trxs, pubkeys, chain_id);
+      BOOST_REQUIRE_EQUAL(trxs.size(), signed_trxs.size());
+      for(size_t i = 0; i < signed_trxs.size(); ++i) {
+         BOOST_CHECK_EQUAL(i, signed_trxs[i].ref_block_num);
+         BOOST_CHECK(signed_trxs[i].signatures == wm.sign_transaction(trxs[i], pubkeys, chain_id).signatures);
+      }
+   }
+   flat_set<public_key_type> missing_keys = pubkeys;
+   missing_keys.emplace(private_key_type::generate().get_public_key());
+   BOOST_CHECK_THROW(wm.sign_transactions({trx}, missing_keys, chain_id), chain::wallet_missing_pub_key_exception);
+
    BOOST_CHECK_EQUAL(3u, wm.get_public_keys().size());
    wm.set_timeout(chrono::seconds(0));
    BOOST_CHECK_THROW(wm.get_public_keys(), wallet_locked_exception);
@@ -36,6 +36,7 @@ fc::variant verify_byte_round_trip_conversion( const abi_serializer& abis, const
    auto var2 = abis.binary_to_variant(type, bytes, abi_serializer::create_yield_function( max_serialization_time ));
 
    std::string r = fc::json::to_string(var2, fc::time_point::now() + max_serialization_time);
+   BOOST_TEST( abis.binary_to_json(type, bytes, abi_serializer::create_yield_function( max_serialization_time )) == r );
 
    auto bytes2 = abis.variant_to_binary(type, var2, abi_serializer::create_yield_function( max_serialization_time ));
 
@@ -51,6 +52,7 @@ void verify_round_trip_conversion( const abi_serializer& abis, const type_name&
    BOOST_REQUIRE_EQUAL(fc::to_hex(bytes), hex);
    auto var2 = abis.binary_to_variant(type, bytes, abi_serializer::create_yield_function( max_serialization_time ));
    BOOST_REQUIRE_EQUAL(fc::json::to_string(var2, fc::time_point::now() + max_serialization_time), expected_json);
+   BOOST_REQUIRE_EQUAL(abis.binary_to_json(type, bytes, abi_serializer::create_yield_function( max_serialization_time )), expected_json);
    auto bytes2 = abis.variant_to_binary(type, var2, abi_serializer::create_yield_function( max_serialization_time ));
    BOOST_REQUIRE_EQUAL(fc::to_hex(bytes2), hex);
 }
@@ -2084,6 +2086,44 @@ BOOST_AUTO_TEST_CASE(abi_large_array)
    } FC_LOG_AND_RETHROW()
 }
 
+// type plans refer into the serializer they were compiled for, copies and moves must not use the plans of the source
+BOOST_AUTO_TEST_CASE(abi_serializer_copy_and_move)
+{
+   try {
+      const char* abi_str = R"=====(
+      {
+        "version": "eosio::abi/1.1",
+        "types": [{"new_type_name": "account", "type": "name"}],
+        "structs": [
+           {"name": "base", "base": "", "fields": [{"name": "owner", "type": "account"}]},
+           {"name": "row", "base": "base", "fields": [{"name": "balances", "type": "asset[]"}, {"name": "memo", "type": "string?"}, {"name": "v", "type": "v"}]}
+        ],
+        "variants": [{"name": "v", "types": ["uint8", "base"]}],
+        "actions": [],
+        "tables": []
+      }
+      )=====";
+      const std::string row_json = R"=====({"owner":"alice","balances":["1.0000 SYS"],"memo":null,"v":["base",{"owner":"bob"}]})=====";
+
+      auto yield = abi_serializer::create_yield_function( max_serialization_time );
+      auto original = std::make_unique<abi_serializer>( fc::json::from_string( abi_str ).as<abi_def>(), yield );
+      auto bin = original->variant_to_binary( "row", fc::json::from_string( row_json ), yield );
+
+      abi_serializer copied( *original );
+      abi_serializer assigned;
+      assigned = *original;
+      abi_serializer moved( std::move( *original ) );
+      original.reset();
+
+      for( const abi_serializer* abis : { &copied, &assigned, &moved } ) {
+         BOOST_TEST( fc::json::to_string( abis->binary_to_variant( "row", bin, yield ), fc::time_point::maximum() ) == row_json );
+         BOOST_TEST( abis->binary_to_json( "row", bin, yield ) == row_json );
+         BOOST_TEST( fc::to_hex( abis->variant_to_binary( "row", fc::json::from_string( row_json ), yield ) ) == fc::to_hex( bin ) );
+      }
+
+   } FC_LOG_AND_RETHROW()
+}
+
 // Infinite recursion of abi_serializer is_type
 BOOST_AUTO_TEST_CASE(abi_is_type_recursion)
 {
@@ -269,6 +269,35 @@ BOOST_AUTO_TEST_CASE(link_auths) { try {
 
 } FC_LOG_AND_RETHROW() }
 
+// the minimum permission checked once per declared authorization, code and action still rejects other actions
+BOOST_AUTO_TEST_CASE(link_auths_repeated_actions) { try {
+   TESTER chain;
+
+   chain.create_account(name("alice"));
+
+   const auto spending_priv_key = chain.get_private_key(name("alice"), "spending");
+   chain.set_authority(name("alice"), name("spending"), spending_priv_key.get_public_key(), name("active"));
+   chain.link_authority(name("alice"), name("eosio"), name("spending"), name("reqauth"));
+
+   auto make_trx = [&]( const vector<action_name>& names ) {
+      signed_transaction trx;
+      for( const auto& n : names ) {
+         trx.actions.emplace_back( vector<permission_level>{{N(alice), name("spending")}}, config::system_account_name, n,
+                                   fc::raw::pack( name("alice") ) );
+      }
+      chain.set_transaction_headers( trx );
+      trx.sign( spending_priv_key, chain.control->get_chain_id() );
+      return trx;
+   };
+
+   chain.push_transaction( make_trx( vector<action_name>( 20, name("reqauth") ) ) );
+
+   auto names = vector<action_name>( 20, name("reqauth") );
+   names.push_back( name("nonce") );
+   BOOST_CHECK_THROW( chain.push_transaction( make_trx( names ) ), irrelevant_auth_exception );
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE(link_then_update_auth) { try {
    TESTER chain;
 
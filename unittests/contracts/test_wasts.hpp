@@ -775,3 +775,121 @@ static const std::vector<uint8_t> varuint_memory_flags{
   0x07, 0x09, 0x01, 0x05, 'a', 'p', 'p', 'l', 'y', 0x00, 0x00, // exports
   0x0a, 0x04, 0x01, 0x02, 0x00, 0x0b // code
 };
+
+// calls the i64 table intrinsics 4000 times on two rows of table "bench" and leaves the table empty
+static const char db_intrinsics_benchmark_wast[] = R"=====(
+(module
+ (import "env" "db_store_i64" (func $db_store_i64 (param i64 i64 i64 i64 i32 i32) (result i32)))
+ (import "env" "db_find_i64" (func $db_find_i64 (param i64 i64 i64 i64) (result i32)))
+ (import "env" "db_get_i64" (func $db_get_i64 (param i32 i32 i32) (result i32)))
+ (import "env" "db_next_i64" (func $db_next_i64 (param i32 i32) (result i32)))
+ (import "env" "db_update_i64" (func $db_update_i64 (param i32 i64 i32 i32)))
+ (import "env" "db_remove_i64" (func $db_remove_i64 (param i32)))
+ (table 0 anyfunc)
+ (memory $0 1)
+ (export "apply" (func $apply))
+ (func $apply (param $receiver i64) (param $code i64) (param $action i64)
+  (local $i i32)
+  (local $itr i32)
+  (drop (call $db_store_i64 (get_local $receiver) (i64.const 4226213184647725056) (get_local $receiver) (i64.const 0) (i32.const 0) (i32.const 8)))
+  (drop (call $db_store_i64 (get_local $receiver) (i64.const 4226213184647725056) (get_local $receiver) (i64.const 1) (i32.const 0) (i32.const 8)))
+  (block $done
+   (loop $next
+    (br_if $done (i32.ge_u (get_local $i) (i32.const 1000)))
+    (set_local $itr (call $db_find_i64 (get_local $receiver) (get_local $receiver) (i64.const 4226213184647725056) (i64.const 0)))
+    (drop (call $db_get_i64 (get_local $itr) (i32.const 16) (i32.const 8)))
+    (drop (call $db_next_i64 (get_local $itr) (i32.const 32)))
+    (call $db_update_i64 (get_local $itr) (get_local $receiver) (i32.const 16) (i32.const 8))
+    (set_local $i (i32.add (get_local $i) (i32.const 1)))
+    (br $next)
+   )
+  )
+  (call $db_remove_i64 (call $db_find_i64 (get_local $receiver) (get_local $receiver) (i64.const 4226213184647725056) (i64.const 0)))
+  (call $db_remove_i64 (call $db_find_i64 (get_local $receiver) (get_local $receiver) (i64.const 4226213184647725056) (i64.const 1)))
+ )
+)
+)=====";
+
+static const char db_scan_benchmark_wast[] = R"=====(
+(module
+ (import "env" "db_store_i64" (func $db_store_i64 (param i64 i64 i64 i64 i32 i32) (result i32)))
+ (import "env" "db_find_i64" (func $db_find_i64 (param i64 i64 i64 i64) (result i32)))
+ (import "env" "db_lowerbound_i64" (func $db_lowerbound_i64 (param i64 i64 i64 i64) (result i32)))
+ (import "env" "db_get_i64" (func $db_get_i64 (param i32 i32 i32) (result i32)))
+ (import "env" "db_next_i64" (func $db_next_i64 (param i32 i32) (result i32)))
+ (table 0 anyfunc)
+ (memory $0 1)
+ (export "apply" (func $apply))
+ (func $apply (param $receiver i64) (param $code i64) (param $action i64)
+  (local $i i64)
+  (local $itr i32)
+  (if (i32.lt_s (call $db_find_i64 (get_local $receiver) (get_local $receiver) (i64.const 4226213184647725056) (i64.const 0)) (i32.const 0)) (then
+   (block $filled
+    (loop $fill
+     (br_if $filled (i64.ge_u (get_local $i) (i64.const 200)))
+     (drop (call $db_store_i64 (get_local $receiver) (i64.const 4226213184647725056) (get_local $receiver) (get_local $i) (i32.const 0) (i32.const 8)))
+     (set_local $i (i64.add (get_local $i) (i64.const 1)))
+     (br $fill)
+    )
+   )
+  ))
+  (set_local $itr (call $db_lowerbound_i64 (get_local $receiver) (get_local $receiver) (i64.const 4226213184647725056) (i64.const 0)))
+  (block $done
+   (loop $next
+    (br_if $done (i32.lt_s (get_local $itr) (i32.const 0)))
+    (drop (call $db_get_i64 (get_local $itr) (i32.const 16) (i32.const 8)))
+    (set_local $itr (call $db_next_i64 (get_local $itr) (i32.const 32)))
+    (br $next)
+   )
+  )
+ )
+)
+)=====";
+
+static const char crypto_benchmark_wast[] = R"=====(
+(module
+ (import "env" "sha256" (func $sha256 (param i32 i32 i32)))
+ (import "env" "ripemd160" (func $ripemd160 (param i32 i32 i32)))
+ (table 0 anyfunc)
+ (memory $0 1)
+ (export "apply" (func $apply))
+ (func $apply (param $receiver i64) (param $code i64) (param $action i64)
+  (local $i i32)
+  (block $done
+   (loop $next
+    (br_if $done (i32.ge_u (get_local $i) (i32.const 100)))
+    (call $sha256 (i32.const 1024) (i32.const 4096) (i32.const 0))
+    (call $ripemd160 (i32.const 1024) (i32.const 4096) (i32.const 32))
+    (set_local $i (i32.add (get_local $i) (i32.const 1)))
+    (br $next)
+   )
+  )
+ )
+)
+)=====";
+
+static const char softfloat_benchmark_wast[] = R"=====(
+(module
+ (table 0 anyfunc)
+ (memory $0 1)
+ (export "apply" (func $apply))
+ (func $apply (param $receiver i64) (param $code i64) (param $action i64)
+  (local $i i32)
+  (local $acc f64)
+  (local $accf f32)
+  (set_local $acc (f64.const 1))
+  (block $done
+   (loop $next
+    (br_if $done (i32.ge_u (get_local $i) (i32.const 10000)))
+    (set_local $acc (f64.add (f64.mul (get_local $acc) (f64.const 1.0000001)) (f64.div (f64.convert_u/i32 (get_local $i)) (f64.const 3))))
+    (set_local $acc (f64.sqrt (get_local $acc)))
+    (set_local $accf (f32.add (get_local $accf) (f32.demote/f64 (get_local $acc))))
+    (set_local $i (i32.add (get_local $i) (i32.const 1)))
+    (br $next)
+   )
+  )
+  (f64.store (i32.const 0) (get_local $acc))
+  (f32.store (i32.const 8) (get_local $accf))
+ )
+)
+)=====";
@@ -1,3 +1,4 @@
+#include <eosio/chain/contract_table_objects.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/testing/tester.hpp>
 
@@ -81,4 +82,92 @@ BOOST_AUTO_TEST_SUITE(database_tests)
       } FC_LOG_AND_RETHROW()
    }
 
+   // The undo stack of a block writing the same rows in every transaction, as exchange and game contracts do: each
+   // transaction session is squashed into the block session, which keeps a single old copy per modified row, so the
+   // undo of the block restores the rows as they were before it whatever the number of modifications.
+   BOOST_AUTO_TEST_CASE(hot_row_undo) {
+      try {
+         TESTER test;
+
+         // Bypass read-only restriction on state DB access for this unit test which really needs to mutate the DB to properly conduct its test.
+         eosio::chain::database& db = const_cast<eosio::chain::database&>( test.control->db() );
+
+         const std::vector<name> rows = { name("hota"), name("hotb"), name("hotc"), name("hotd"), name("hote") };
+         for( auto n : rows ) {
+            db.create<account_object>([&](account_object &a) {
+               a.name = n;
+               a.creation_date = block_timestamp_type(1);
+            });
+         }
+
+         const uint32_t transactions = 2000;
+         const uint32_t updates_per_row = 4;
+         auto block_ses = db.start_undo_session(true);
+         auto start = fc::time_point::now();
+         for( uint32_t t = 0; t < transactions; ++t ) {
+            auto trx_ses = db.start_undo_session(true);
+            for( uint32_t u = 0; u < updates_per_row; ++u ) {
+               for( auto n : rows ) {
+                  db.modify( db.get<account_object, by_name>(n), [&](account_object &a) {
+                     a.creation_date = block_timestamp_type(2 + t * updates_per_row + u);
+                  });
+               }
+            }
+            trx_ses.squash();
+         }
+         auto elapsed = fc::time_point::now() - start;
+         BOOST_TEST_MESSAGE( "hot_row_undo: " << transactions * updates_per_row * rows.size() << " modifications of "
+                             << rows.size() << " rows in " << elapsed.count() << " us" );
+
+         for( auto n : rows )
+            BOOST_TEST(db.get<account_object, by_name>(n).creation_date == block_timestamp_type(1 + transactions * updates_per_row));
+
+         start = fc::time_point::now();
+         block_ses.undo();
+         BOOST_TEST_MESSAGE( "hot_row_undo: block undone in " << (fc::time_point::now() - start).count() << " us" );
+
+         for( auto n : rows )
+            BOOST_TEST(db.get<account_object, by_name>(n).creation_date == block_timestamp_type(1));
+      } FC_LOG_AND_RETHROW()
+   }
+
+   // Small row values, such as the 16 byte balances of token contracts, are stored in the key_value_object itself by
+   // the short string optimization of shared_string, only larger values take a separate allocation in the segment.
+   BOOST_AUTO_TEST_CASE(small_row_value_inline) {
+      try {
+         TESTER test;
+
+         // Bypass read-only restriction on state DB access for this unit test which really needs to mutate the DB to properly conduct its test.
+         eosio::chain::database& db = const_cast<eosio::chain::database&>( test.control->db() );
+
+         auto ses = db.start_undo_session(true);
+
+         auto inside = []( const key_value_object& o ) {
+            const char* begin = reinterpret_cast<const char*>( &o );
+            return o.value.data() >= begin && o.value.data() < begin + sizeof(o);
+         };
+
+         const std::vector<char> balance( 16, 'b' );
+         const auto& small = db.create<key_value_object>([&](key_value_object &o) {
+            o.t_id = table_id( std::numeric_limits<int64_t>::max() );
+            o.primary_key = 1;
+            o.payer = name("alice");
+            o.value.assign( balance.data(), balance.size() );
+         });
+         BOOST_TEST(inside(small));
+
+         const std::vector<char> row( 256, 'r' );
+         const auto& large = db.create<key_value_object>([&](key_value_object &o) {
+            o.t_id = table_id( std::numeric_limits<int64_t>::max() );
+            o.primary_key = 2;
+            o.payer = name("alice");
+            o.value.assign( row.data(), row.size() );
+         });
+         BOOST_TEST(!inside(large));
+         BOOST_TEST(std::equal( row.begin(), row.end(), large.value.data() ));
+
+         ses.undo();
+      } FC_LOG_AND_RETHROW()
+   }
+
 BOOST_AUTO_TEST_SUITE_END()
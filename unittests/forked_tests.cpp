@@ -7,6 +7,7 @@
 #include <Runtime/Runtime.h>
 
 #include <fc/variant_object.hpp>
+#include <fstream>
 
 #include <boost/test/unit_test.hpp>
 
@@ -567,6 +568,103 @@ BOOST_AUTO_TEST_CASE( reopen_forkdb ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_AUTO_TEST_CASE( reopen_forkdb_incomplete_journal ) try {
+   tester c;
+
+   c.create_accounts( {N(alice),N(bob),N(carol)} );
+   c.produce_block();
+   c.set_producers( {N(alice),N(bob),N(carol)} );
+   c.produce_blocks(30);
+
+   auto head_block_id = c.control->head_block_id();
+   auto lib = c.control->last_irreversible_block_num();
+   BOOST_REQUIRE( c.control->head_block_num() > lib );
+
+   c.close();
+
+   // a record cut short by a crash is dropped, everything before it survives
+   auto journal_path = c.get_config().state_dir / config::forkdb_journal_filename;
+   BOOST_REQUIRE( fc::exists( journal_path ) );
+   {
+      std::ofstream journal( journal_path.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::app );
+      const uint32_t size = 100;
+      journal.write( (const char*)&size, sizeof(size) );
+      journal.put( 1 );
+      journal.write( "xyz", 3 );
+   }
+
+   c.open();
+
+   BOOST_CHECK( c.control->fork_db_head_block_id() == head_block_id );
+   BOOST_CHECK_EQUAL( c.control->last_irreversible_block_num(), lib );
+
+   c.produce_blocks(10);
+   c.close();
+   c.open();
+   BOOST_CHECK( c.control->fork_db_head_block_id() == c.control->head_block_id() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( fork_db_branch_lookup ) try {
+   tester c;
+
+   vector<account_name> producers;
+   for( char p = 'a'; p <= 'u'; ++p ) {
+      producers.emplace_back( std::string("prod") + p );
+   }
+   c.create_accounts( producers );
+   c.produce_block();
+   c.set_producers( producers );
+   // keep a long reversible window: 21 producers need a couple of rounds before LIB moves
+   c.produce_blocks(300);
+
+   const auto& fork_db = c.control->fork_db();
+   auto head = fork_db.head();
+   auto root_num = fork_db.root()->block_num;
+   BOOST_REQUIRE( head->block_num - root_num > 100 );
+
+   // reference answers by walking the previous links
+   auto walk = [&]( uint32_t block_num ) {
+      for( auto s = fork_db.get_block( head->id ); s; s = fork_db.get_block( s->header.previous ) ) {
+         if( s->block_num == block_num ) return s;
+      }
+      return block_state_ptr();
+   };
+
+   vector<block_state_ptr> expected;
+   auto start = fc::time_point::now();
+   for( uint32_t n = root_num - 1; n <= head->block_num + 1; ++n ) {
+      expected.push_back( walk( n ) );
+   }
+   auto walk_time = fc::time_point::now() - start;
+
+   vector<block_state_ptr> found;
+   start = fc::time_point::now();
+   for( uint32_t n = root_num - 1; n <= head->block_num + 1; ++n ) {
+      found.push_back( fork_db.search_on_branch( head->id, n ) );
+   }
+   auto lookup_time = fc::time_point::now() - start;
+   BOOST_TEST_MESSAGE( "search_on_branch over " << head->block_num - root_num << " blocks: "
+                       << lookup_time.count() << "us by block number, " << walk_time.count() << "us walking the branch" );
+
+   BOOST_REQUIRE_EQUAL( found.size(), expected.size() );
+   for( size_t i = 0; i < found.size(); ++i ) {
+      BOOST_CHECK( found[i] == expected[i] );
+   }
+
+   auto branch = fork_db.fetch_branch( head->id );
+   BOOST_REQUIRE_EQUAL( branch.size(), head->block_num - root_num );
+   for( size_t i = 0; i < branch.size(); ++i ) {
+      BOOST_CHECK_EQUAL( branch[i]->block_num, head->block_num - i );
+      if( i > 0 ) BOOST_CHECK( branch[i-1]->header.previous == branch[i]->id );
+   }
+
+   auto trimmed = fork_db.fetch_branch( head->id, head->block_num - 10 );
+   BOOST_REQUIRE_EQUAL( trimmed.size(), branch.size() - 10 );
+   BOOST_CHECK( trimmed.front() == branch[10] );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_CASE( push_block_returns_forked_transactions ) try {
    tester c;
    while (c.control->head_block_num() < 3) {
@@ -1,8 +1,14 @@
 #include <eosio/chain/asset.hpp>
 #include <eosio/chain/authority.hpp>
 #include <eosio/chain/authority_checker.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/merkle.hpp>
+#include <eosio/chain/incremental_merkle.hpp>
 #include <eosio/chain/types.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/trace_spans.hpp>
+#include <eosio/chain/post_lanes.hpp>
+#include <eosio/chain/json_parser.hpp>
 #include <eosio/testing/tester.hpp>
 
 #include <fc/io/json.hpp>
@@ -888,6 +894,23 @@ BOOST_AUTO_TEST_CASE(transaction_metadata_test) { try {
       BOOST_CHECK_EQUAL(trx.id(), ptrx->id());
       BOOST_CHECK_EQUAL(trx.id(), ptrx2->id());
 
+      // memoized digests match the uncached ones and are shared with copies
+      const auto& chain_id = test.control->get_chain_id();
+      BOOST_CHECK_EQUAL(trx.sig_digest(chain_id, trx.context_free_data), pkt.sig_digest(chain_id));
+      BOOST_CHECK_EQUAL(trx.sig_digest(chain_id, trx.context_free_data), pkt2.sig_digest(chain_id));
+      BOOST_CHECK_EQUAL(pkt.sig_digest(chain_id), pkt.sig_digest(chain_id));
+      BOOST_CHECK(pkt.sig_digest(chain_id) != pkt.sig_digest(chain_id_type(fc::sha256::hash("other").str())));
+      packed_transaction pkt_copy(pkt);
+      BOOST_CHECK_EQUAL(pkt.packed_digest(), pkt_copy.packed_digest());
+      BOOST_CHECK(pkt.packed_digest() != pkt2.packed_digest());
+      // a moved from transaction keeps a valid cache of its own
+      packed_transaction pkt_moved(std::move(pkt_copy));
+      BOOST_CHECK_EQUAL(pkt.packed_digest(), pkt_moved.packed_digest());
+      BOOST_CHECK_EQUAL(pkt_copy.packed_digest(), packed_transaction().packed_digest());
+      pkt_copy = std::move(pkt_moved);
+      BOOST_CHECK_EQUAL(pkt.sig_digest(chain_id), pkt_copy.sig_digest(chain_id));
+      pkt_moved.sig_digest(chain_id);
+
       named_thread_pool thread_pool( "misc", 5 );
 
       auto fut = transaction_metadata::start_recover_keys( ptrx, thread_pool.get_executor(), test.control->get_chain_id(), fc::microseconds::maximum() );
@@ -916,6 +939,39 @@ BOOST_AUTO_TEST_CASE(transaction_metadata_test) { try {
 
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE(dry_run_transaction_test) { try {
+      tester test;
+
+      signed_transaction trx;
+      authority auth( test.get_public_key( N(dryrun), "active" ) );
+      trx.actions.emplace_back( vector<permission_level>{{config::system_account_name, config::active_name}},
+                                newaccount{ config::system_account_name, N(dryrun), auth, auth } );
+      test.set_transaction_headers( trx );
+      trx.sign( test.get_private_key( config::system_account_name, "active" ), test.control->get_chain_id() );
+      auto ptrx = std::make_shared<packed_transaction>( trx, packed_transaction::compression_type::none );
+
+      auto dry_run = transaction_metadata::start_recover_keys( ptrx, test.control->get_thread_pool(), test.control->get_chain_id(),
+                                                               fc::microseconds::maximum(), UINT32_MAX,
+                                                               transaction_metadata::trx_type::dry_run ).get();
+      BOOST_CHECK( dry_run->dry_run );
+      auto trace = test.control->push_transaction( dry_run, fc::time_point::maximum(), 0, false );
+      BOOST_REQUIRE( !trace->except );
+      BOOST_REQUIRE_EQUAL( 1u, trace->action_traces.size() );
+
+      // nothing of the dry run is left behind
+      BOOST_CHECK( test.control->db().find<account_object, by_name>( N(dryrun) ) == nullptr );
+      BOOST_CHECK( !test.control->is_known_unexpired_transaction( ptrx->id() ) );
+
+      // so the same transaction is still accepted
+      auto input = transaction_metadata::start_recover_keys( ptrx, test.control->get_thread_pool(), test.control->get_chain_id(),
+                                                             fc::microseconds::maximum() ).get();
+      trace = test.control->push_transaction( input, fc::time_point::maximum(), 0, false );
+      BOOST_REQUIRE( !trace->except );
+      BOOST_CHECK( test.control->db().find<account_object, by_name>( N(dryrun) ) != nullptr );
+      test.produce_block();
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE(reflector_init_test) {
    try {
 
@@ -1177,6 +1233,266 @@ BOOST_AUTO_TEST_CASE(bad_alloc_test) {
    BOOST_CHECK( ptr == nullptr );
 }
 
+// the integer compares of the float secondary indices order keys as the softfloat compares
+BOOST_AUTO_TEST_CASE(soft_float_less_test) { try {
+   boost::random::mt19937 gen( 129 );
+   boost::random::uniform_int_distribution<uint64_t> dist;
+   const uint64_t sign = uint64_t(1) << 63;
+
+   vector<float64_t> doubles;
+   for( uint64_t bits : { uint64_t(0), sign, uint64_t(1), sign | 1, uint64_t(0x7ff0000000000000), uint64_t(0xfff0000000000000),
+                          uint64_t(0x3ff0000000000000), uint64_t(0xbff0000000000000), uint64_t(0x000fffffffffffff) } ) {
+      doubles.push_back( float64_t{ bits } );
+   }
+   while( doubles.size() < 200 ) {
+      float64_t f{ dist( gen ) };
+      if( !f64_eq( f, f ) ) continue; // NaN
+      doubles.push_back( f );
+   }
+   for( const auto& a : doubles ) {
+      for( const auto& b : doubles ) {
+         BOOST_REQUIRE_EQUAL( f64_lt( a, b ), soft_double_less()( a, b ) );
+      }
+   }
+
+   vector<float128_t> long_doubles;
+   for( const auto& w : std::vector<std::pair<uint64_t, uint64_t>>{ {0, 0}, {sign, 0}, {0, 1}, {sign, 1},
+                                                                    {0x7fff000000000000, 0}, {0xffff000000000000, 0},
+                                                                    {0x3fff000000000000, 0}, {0xbfff000000000000, 0} } ) {
+      float128_t f;
+      f.v[1] = w.first;
+      f.v[0] = w.second;
+      long_doubles.push_back( f );
+   }
+   while( long_doubles.size() < 200 ) {
+      float128_t f;
+      f.v[1] = dist( gen );
+      f.v[0] = dist( gen );
+      if( !f128_eq( f, f ) ) continue; // NaN
+      long_doubles.push_back( f );
+   }
+   for( const auto& a : long_doubles ) {
+      for( const auto& b : long_doubles ) {
+         BOOST_REQUIRE_EQUAL( f128_lt( a, b ), soft_long_double_less()( a, b ) );
+      }
+   }
+} FC_LOG_AND_RETHROW() }
+
+// parallel merkle levels give the same root as the serial ones, odd levels included
+BOOST_AUTO_TEST_CASE(merkle_thread_pool_test) { try {
+   named_thread_pool thread_pool( "misc", 4 );
+   for( size_t n : { 0, 1, 2, 3, 2047, 4096, 5001, 20000 } ) {
+      vector<digest_type> ids;
+      ids.reserve( n );
+      for( size_t i = 0; i < n; ++i )
+         ids.emplace_back( digest_type::hash( i ) );
+      BOOST_CHECK_EQUAL( merkle( ids ), merkle( ids, thread_pool.get_executor() ) );
+   }
+   thread_pool.stop();
+} FC_LOG_AND_RETHROW() }
+
+// the direct pair hash and the batched digests match the packed ones, with and without a thread pool
+BOOST_AUTO_TEST_CASE(hash_many_test) { try {
+   const auto l = digest_type::hash( 1 ), r = digest_type::hash( 2 );
+   BOOST_CHECK_EQUAL( hash_canonical_pair( l, r ), digest_type::hash( make_canonical_pair( l, r ) ) );
+   BOOST_CHECK_EQUAL( hash_canonical_pair( r, l ), digest_type::hash( make_canonical_pair( r, l ) ) );
+
+   named_thread_pool thread_pool( "misc", 4 );
+   for( size_t n : { 0, 1, 255, 512, 1000 } ) {
+      auto digests = hash_many( n, []( size_t i ) { return digest_type::hash( i ); }, &thread_pool.get_executor() );
+      BOOST_REQUIRE_EQUAL( digests.size(), n );
+      for( size_t i = 0; i < n; ++i )
+         BOOST_CHECK_EQUAL( digests[i], digest_type::hash( i ) );
+      BOOST_CHECK( digests == hash_many( n, []( size_t i ) { return digest_type::hash( i ); } ) );
+   }
+   thread_pool.stop();
+} FC_LOG_AND_RETHROW() }
+
+// every proof of a merkle_tree leads from its leaf to merkle() of the leaves
+BOOST_AUTO_TEST_CASE(merkle_tree_test) { try {
+   for( size_t n : { 0, 1, 2, 3, 5, 8, 13, 100 } ) {
+      vector<digest_type> ids;
+      for( size_t i = 0; i < n; ++i )
+         ids.emplace_back( digest_type::hash( i ) );
+
+      const merkle_tree tree( ids );
+      BOOST_CHECK_EQUAL( tree.leaf_count(), n );
+      BOOST_CHECK_EQUAL( tree.root(), merkle( ids ) );
+      for( size_t i = 0; i < n; ++i ) {
+         auto paths = tree.proof( i );
+         BOOST_CHECK( paths == get_proof( i, ids ) );
+
+         digest_type node = ids[i];
+         for( const auto& p : paths ) {
+            node = is_canonical_left( p ) ? digest_type::hash( make_canonical_pair( p, node ) )
+                                          : digest_type::hash( make_canonical_pair( node, p ) );
+         }
+         BOOST_CHECK_EQUAL( node, tree.root() );
+      }
+   }
+} FC_LOG_AND_RETHROW() }
+
+// the inline active nodes are packed and converted like the vector they replace
+BOOST_AUTO_TEST_CASE(incremental_merkle_pack_test) { try {
+   incremental_merkle m;
+   for( uint64_t i = 0; i < 100; ++i ) {
+      m.append( digest_type::hash( i ) );
+      const vector<digest_type> nodes( m._active_nodes.begin(), m._active_nodes.end() );
+      BOOST_CHECK( fc::raw::pack( m._active_nodes ) == fc::raw::pack( nodes ) );
+
+      auto unpacked = fc::raw::unpack<incremental_merkle>( fc::raw::pack( m ) );
+      BOOST_CHECK_EQUAL( unpacked._node_count, m._node_count );
+      BOOST_CHECK_EQUAL( unpacked.get_root(), m.get_root() );
+
+      fc::variant v;
+      fc::to_variant( m, v );
+      incremental_merkle converted;
+      fc::from_variant( v, converted );
+      BOOST_CHECK_EQUAL( converted._node_count, m._node_count );
+      BOOST_CHECK_EQUAL( converted.get_root(), m.get_root() );
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(trace_spans_test) { try {
+   span_tracer::drain();
+   { scoped_span s( "disabled", "test", 1 ); }
+   BOOST_CHECK( span_tracer::drain().empty() );
+
+   span_tracer::set_enabled( true );
+   { scoped_span s( "outer", "test", 7 ); { scoped_span s2( "inner", "test", 7 ); } }
+   std::thread( []() { scoped_span s( "other_thread", "test", 8 ); } ).join();
+   // overflow of a thread's ring keeps its latest spans
+   for( size_t i = 0; i < span_tracer::ring_capacity + 10; ++i ) { scoped_span s( "filler", "test", 9 ); }
+   span_tracer::set_enabled( false );
+
+   auto spans = span_tracer::drain();
+   BOOST_CHECK( span_tracer::drain().empty() );
+   BOOST_REQUIRE_EQUAL( spans.size(), span_tracer::ring_capacity + 1 );
+   BOOST_CHECK( std::is_sorted( spans.begin(), spans.end(),
+                                []( const auto& a, const auto& b ) { return a.start_ns < b.start_ns; } ) );
+   BOOST_CHECK( std::none_of( spans.begin(), spans.end(),
+                              []( const auto& s ) { return std::string( s.name ) == "outer"; } ) );
+   BOOST_CHECK( std::any_of( spans.begin(), spans.end(),
+                             []( const auto& s ) { return std::string( s.name ) == "other_thread"; } ) );
+
+   auto chrome = span_tracer::to_chrome_trace( spans ).get_object();
+   BOOST_CHECK_EQUAL( chrome["traceEvents"].get_array().size(), spans.size() );
+   auto otlp = span_tracer::to_otlp( spans ).get_object();
+   BOOST_CHECK_EQUAL( otlp["resourceSpans"].get_array()[0]["scopeSpans"].get_array()[0]["spans"].get_array().size(), spans.size() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(post_lanes_test) { try {
+   post_lanes lanes;
+   std::deque<std::pair<int, std::function<void()>>> queue;
+   lanes.set_post_function( [&]( int priority, std::function<void()> f ) { queue.emplace_back( priority, std::move( f ) ); } );
+   const size_t a = lanes.add_lane( { "a", 1, 2, 20 } );
+   const size_t b = lanes.add_lane( { "b", 2, 1, 4 } );
+   BOOST_CHECK_EQUAL( lanes.add_lane( { "a", 1, 2, 20 } ), a );
+
+   std::string executed;
+   for( int i = 0; i < 12; ++i ) BOOST_CHECK( lanes.post( a, [&]() { executed += 'a'; } ) );
+   for( int i = 0; i < 4; ++i ) BOOST_CHECK( lanes.post( b, [&]() { executed += 'b'; } ) );
+   // move only tasks are accepted, a full lane rejects
+   auto owned = std::make_unique<int>( 1 );
+   BOOST_CHECK( !lanes.post( b, [o = std::move( owned ), &executed]() { executed += 'x'; } ) );
+
+   // only the window is in the application queue, lane b is handed over as soon as slots free up
+   BOOST_CHECK_EQUAL( queue.size(), post_lanes::default_window );
+   size_t max_queued = 0;
+   while( !queue.empty() ) {
+      max_queued = std::max( max_queued, queue.size() );
+      auto f = std::move( queue.front().second );
+      queue.pop_front();
+      f();
+   }
+   BOOST_CHECK_EQUAL( max_queued, post_lanes::default_window );
+   BOOST_CHECK_EQUAL( executed.size(), 16u );
+   BOOST_CHECK_EQUAL( std::count( executed.begin(), executed.end(), 'b' ), 4 );
+   BOOST_CHECK( executed.find( 'b' ) < executed.rfind( 'a' ) );
+
+   auto stats = lanes.get_stats();
+   BOOST_REQUIRE_EQUAL( stats.size(), 2u );
+   BOOST_CHECK_EQUAL( stats[a].name, "a" );
+   BOOST_CHECK_EQUAL( stats[a].executed, 12u );
+   BOOST_CHECK_EQUAL( stats[a].max_depth, 12u );
+   BOOST_CHECK_EQUAL( stats[b].executed, 4u );
+   BOOST_CHECK_EQUAL( stats[b].rejected, 1u );
+   BOOST_CHECK_EQUAL( stats[b].depth, 0u );
+
+   // a cleared lane leaves slots that run nothing
+   lanes.post( a, [&]() { executed += 'c'; } );
+   lanes.clear( a );
+   while( !queue.empty() ) {
+      auto f = std::move( queue.front().second );
+      queue.pop_front();
+      f();
+   }
+   BOOST_CHECK_EQUAL( executed.find( 'c' ), std::string::npos );
+} FC_LOG_AND_RETHROW() }
+
+
+BOOST_AUTO_TEST_CASE(json_parser_test) { try {
+   // same types all the way down, fc::json::to_string does not tell int64 from uint64
+   std::function<void(const fc::variant&, const fc::variant&)> check_same = [&]( const fc::variant& a, const fc::variant& b ) {
+      BOOST_REQUIRE_EQUAL( a.get_type(), b.get_type() );
+      if( a.is_object() ) {
+         const auto& ao = a.get_object();
+         const auto& bo = b.get_object();
+         BOOST_REQUIRE_EQUAL( ao.size(), bo.size() );
+         for( auto ai = ao.begin(), bi = bo.begin(); ai != ao.end(); ++ai, ++bi ) {
+            BOOST_CHECK_EQUAL( ai->key(), bi->key() );
+            check_same( ai->value(), bi->value() );
+         }
+      } else if( a.is_array() ) {
+         BOOST_REQUIRE_EQUAL( a.size(), b.size() );
+         for( size_t i = 0; i < a.size(); ++i ) check_same( a[i], b[i] );
+      } else {
+         BOOST_CHECK_EQUAL( fc::json::to_string( a, fc::time_point::maximum() ), fc::json::to_string( b, fc::time_point::maximum() ) );
+      }
+   };
+
+   const std::string hex_data( 1000, 'a' );
+   const std::vector<std::string> fast = {
+      "{}", "[]", "[ ]", "0", "-0", "-42", "123456789012345678", "true", "false", "null", "\"\"",
+      "{\"a\":1,\"a\":-2}",
+      " {\n\t\"json\" : true, \"code\": \"eosio.token\", \"scope\":\"alice\", \"limit\": 10, \"reverse\": false } ",
+      "{\"actions\":[{\"account\":\"eosio\",\"name\":\"transfer\",\"authorization\":[{\"actor\":\"alice\",\"permission\":\"active\"}],"
+            "\"data\":\"" + hex_data + "\"}],\"context_free_actions\":[],\"signatures\":[null,[[[]]]]}",
+      "[\"\\\"quoted\\\"\",\"back\\\\slash\\\\\",\"\\/\\n\\r\\t\"]",
+      "{\"" + std::string( 15, 'k' ) + "\\\"\":\"" + std::string( 14, 'v' ) + "\\\\\"}"
+   };
+   for( const auto& json : fast ) {
+      BOOST_TEST_CONTEXT( json ) {
+         auto result = json_parser::try_fast_parse( json );
+#if defined(EOSIO_SIMD_JSON_ENABLED)
+         BOOST_REQUIRE( result );
+         check_same( *result, fc::json::from_string( json ) );
+#else
+         BOOST_CHECK( !result );
+#endif
+         check_same( json_parser::from_string( json ), fc::json::from_string( json ) );
+      }
+   }
+
+   // handed to fc::json, which has its own rules for these
+   const std::vector<std::string> fallback = {
+      "1.5", "1e5", "1234567890123456789", "\"\\u0041\"", "\"\\b\"", "\"caf\xc3\xa9\"", "[\"a\tb\"]",
+      "{\"a\":1}trailing", std::string( json_parser::max_fast_depth + 1, '[' ) + std::string( json_parser::max_fast_depth + 1, ']' )
+   };
+   for( const auto& json : fallback ) {
+      BOOST_TEST_CONTEXT( json ) {
+         BOOST_CHECK( !json_parser::try_fast_parse( json ) );
+         check_same( json_parser::from_string( json ), fc::json::from_string( json ) );
+      }
+   }
+
+   for( const std::string json : { "", "-", "unquoted", "[1,]", "{\"a\":", "[1 2]", "\"unterminated" } ) {
+      BOOST_TEST_CONTEXT( json ) {
+         BOOST_CHECK( !json_parser::try_fast_parse( json ) );
+      }
+   }
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace eosio
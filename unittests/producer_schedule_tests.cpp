@@ -37,7 +37,7 @@ BOOST_AUTO_TEST_SUITE(producer_schedule_tests)
    // However, it won't be applied until the effective block num is deemed irreversible
    uint64_t calc_block_num_of_next_round_first_block(const controller& control){
       auto res = control.head_block_num() + 1;
-      const auto blocks_per_round = control.head_block_state()->active_schedule.producers.size() * config::producer_repetitions;
+      const auto blocks_per_round = control.head_block_state()->active_schedule->producers.size() * config::producer_repetitions;
       while((res % blocks_per_round) != 0) {
          res++;
       }
@@ -50,7 +50,7 @@ BOOST_AUTO_TEST_SUITE(producer_schedule_tests)
       const auto& confirm_schedule_correctness = [&](const vector<producer_key>& new_prod_schd, const uint64_t eff_new_prod_schd_block_num)  {
          const uint32_t check_duration = 1000; // number of blocks
          for (uint32_t i = 0; i < check_duration; ++i) {
-            const auto current_schedule = control->head_block_state()->active_schedule.producers;
+            const auto current_schedule = control->head_block_state()->active_schedule->producers;
             const auto& current_absolute_slot = control->get_global_properties().proposed_schedule_block_num;
             // Determine expected producer
             const auto& expected_producer = get_expected_producer(current_schedule, *current_absolute_slot + 1);
@@ -665,4 +665,27 @@ BOOST_AUTO_TEST_CASE( large_authority_overflow_test ) try {
    BOOST_REQUIRE_EQUAL(res.second, provided_keys.size());
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( shared_producer_schedule_test, TESTER ) try {
+   create_accounts( {"alice"_n,"bob"_n} );
+   set_producers( {"alice"_n,"bob"_n} );
+   produce_blocks( 200 );
+   BOOST_REQUIRE_EQUAL( control->head_block_state()->active_schedule->version, 1u );
+
+   // block states share the schedule, the copies of the whole fork database hold one instance of it
+   auto head = control->head_block_state();
+   auto prev = control->fetch_block_state_by_number( head->block_num - 1 );
+   BOOST_REQUIRE( prev );
+   BOOST_CHECK_EQUAL( &*head->active_schedule, &*prev->active_schedule );
+   producer_authority_schedule copy = head->active_schedule;
+   producer_authority_schedule_ptr interned = copy;
+   BOOST_CHECK_EQUAL( &*interned, &*head->active_schedule );
+
+   // serialized as the schedule itself, unpacked schedules are interned as well
+   BOOST_CHECK( fc::raw::pack( head->active_schedule ) == fc::raw::pack( copy ) );
+   auto unpacked = fc::raw::unpack<block_header_state>( fc::raw::pack( static_cast<const block_header_state&>( *head ) ) );
+   BOOST_CHECK_EQUAL( &*unpacked.active_schedule, &*head->active_schedule );
+   BOOST_CHECK_EQUAL( fc::json::to_string( head->active_schedule, fc::time_point::maximum() ),
+                      fc::json::to_string( copy, fc::time_point::maximum() ) );
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
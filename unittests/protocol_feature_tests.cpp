@@ -1587,7 +1587,7 @@ BOOST_AUTO_TEST_CASE( producer_schedule_change_extension_test ) { try {
       emplace_extension(
               bad_block->header_extensions,
               producer_schedule_change_extension::extension_id(),
-              fc::raw::pack(std::make_pair(hbs->active_schedule.version + 1, std::vector<char>{}))
+              fc::raw::pack(std::make_pair(hbs->active_schedule->version + 1, std::vector<char>{}))
       );
 
       // re-sign the bad block
@@ -1607,7 +1607,7 @@ BOOST_AUTO_TEST_CASE( producer_schedule_change_extension_test ) { try {
 
       // create a bad block that has the producer schedule change extension before the feature upgrade
       auto bad_block = std::make_shared<signed_block>(last_legacy_block->clone());
-      bad_block->new_producers = legacy::producer_schedule_type{hbs->active_schedule.version + 1, {}};
+      bad_block->new_producers = legacy::producer_schedule_type{hbs->active_schedule->version + 1, {}};
 
       // re-sign the bad block
       auto header_bmroot = digest_type::hash( std::make_pair( bad_block->digest(), remote.control->head_block_state()->blockroot_merkle ) );
@@ -1634,7 +1634,7 @@ BOOST_AUTO_TEST_CASE( producer_schedule_change_extension_test ) { try {
       emplace_extension(
               bad_block->header_extensions,
               producer_schedule_change_extension::extension_id(),
-              fc::raw::pack(std::make_pair(hbs->active_schedule.version + 1, std::vector<char>{}))
+              fc::raw::pack(std::make_pair(hbs->active_schedule->version + 1, std::vector<char>{}))
       );
 
       // re-sign the bad block
@@ -1654,7 +1654,7 @@ BOOST_AUTO_TEST_CASE( producer_schedule_change_extension_test ) { try {
 
       // create a bad block that has the producer schedule change extension before the feature upgrade
       auto bad_block = std::make_shared<signed_block>(first_new_block->clone());
-      bad_block->new_producers = legacy::producer_schedule_type{hbs->active_schedule.version + 1, {}};
+      bad_block->new_producers = legacy::producer_schedule_type{hbs->active_schedule->version + 1, {}};
 
       // re-sign the bad block
       auto header_bmroot = digest_type::hash( std::make_pair( bad_block->digest(), remote.control->head_block_state()->blockroot_merkle ) );
@@ -1,10 +1,14 @@
+#include <atomic>
 #include <sstream>
+#include <thread>
 
 #include <eosio/chain/block_log.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/snapshot.hpp>
 #include <eosio/testing/tester.hpp>
 
+#include <fc/io/fstream.hpp>
+
 #include <boost/mpl/list.hpp>
 #include <boost/test/unit_test.hpp>
 
@@ -78,4 +82,182 @@ BOOST_AUTO_TEST_CASE(test_restart_with_different_chain_id)
    BOOST_REQUIRE_EXCEPTION(other.open(chain_id), chain_id_type_exception, fc_exception_message_starts_with("chain ID in state "));
 }
 
+BOOST_AUTO_TEST_CASE(test_read_serialized_block)
+{
+   tester chain;
+   chain.produce_blocks(10);
+   chain.produce_block();
+   const auto lib = chain.control->last_irreversible_block_num();
+   BOOST_REQUIRE(lib > 1);
+
+   for (uint32_t num = 1; num <= lib; ++num) {
+      auto packed = chain.control->fetch_serialized_block_by_number(num);
+      auto b = chain.control->fetch_block_by_number(num);
+      BOOST_REQUIRE(b);
+      BOOST_TEST(packed == fc::raw::pack(*b));
+   }
+
+   // reversible blocks are not in the block log
+   if (chain.control->head_block_num() > lib)
+      BOOST_TEST(chain.control->fetch_serialized_block_by_number(chain.control->head_block_num()).empty());
+   BOOST_TEST(chain.control->fetch_serialized_block_by_number(chain.control->head_block_num() + 1).empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_block_log_concurrent_reads)
+{
+   tester chain;
+   chain.produce_blocks(30);
+   const auto lib = chain.control->last_irreversible_block_num();
+   BOOST_REQUIRE(lib > 10);
+
+   vector<signed_block_ptr> blocks;
+   for (uint32_t num = 2; num <= lib; ++num)
+      blocks.push_back(chain.control->fetch_block_by_number(num));
+
+   fc::temp_directory temp_dir;
+   block_log log(temp_dir.path());
+   log.reset(chain.control->get_chain_id(), 2);
+
+   // readers follow the appends, each block is readable once append returns
+   std::atomic<bool> failed{false};
+   vector<std::thread> readers;
+   for (int i = 0; i < 4; ++i) {
+      readers.emplace_back([&]() {
+         for (const auto& b : blocks) {
+            signed_block_ptr read;
+            while (!read && !failed)
+               read = log.read_block_by_num(b->block_num());
+            if (!read || read->id() != b->id() || log.read_block_id_by_num(b->block_num()) != b->id())
+               failed = true;
+         }
+      });
+   }
+   for (const auto& b : blocks)
+      log.append(b);
+   for (auto& t : readers)
+      t.join();
+
+   BOOST_TEST(!failed);
+   BOOST_TEST(log.read_serialized_block(lib) == fc::raw::pack(*blocks.back()));
+   BOOST_TEST(!log.read_block_by_num(lib + 1));
+}
+
+BOOST_AUTO_TEST_CASE(test_block_log_stride)
+{
+   tester chain;
+   chain.produce_blocks(30);
+   const uint32_t lib = chain.control->last_irreversible_block_num();
+   BOOST_REQUIRE(lib > 21);
+
+   fc::temp_directory temp_dir;
+   {
+      block_log log(temp_dir.path(), 5, 2);
+      log.reset(chain.control->get_chain_id(), 2);
+      for (uint32_t num = 2; num <= lib; ++num)
+         log.append(chain.control->fetch_block_by_number(num));
+
+      // blocks.log starts after the last completed stride, the two files before it are retained
+      const uint32_t log_first = (lib - 1) / 5 * 5 + 1;
+      BOOST_TEST(log.first_block_num() == log_first - 10);
+      BOOST_TEST(fc::exists(temp_dir.path() / ("blocks-" + std::to_string(log_first - 5) + "-" + std::to_string(log_first - 1) + ".log")));
+      BOOST_TEST(!fc::exists(temp_dir.path() / ("blocks-" + std::to_string(log_first - 15) + "-" + std::to_string(log_first - 11) + ".log")));
+      BOOST_TEST(!log.read_block_by_num(log_first - 11));
+      for (uint32_t num = log_first - 10; num <= lib; ++num) {
+         BOOST_TEST(log.read_block_id_by_num(num) == chain.control->fetch_block_by_number(num)->id());
+         BOOST_TEST(log.read_serialized_block(num) == fc::raw::pack(*chain.control->fetch_block_by_number(num)));
+      }
+   }
+
+   // the retained files are found again on restart
+   block_log log(temp_dir.path(), 5, 2);
+   BOOST_TEST(log.head_id() == chain.control->fetch_block_by_number(lib)->id());
+   const uint32_t first = log.first_block_num();
+   for (uint32_t num = first; num <= lib; ++num)
+      BOOST_TEST(log.read_block_by_num(num)->id() == chain.control->fetch_block_by_number(num)->id());
+}
+
+BOOST_AUTO_TEST_CASE(test_block_log_stride_repair)
+{
+   tester chain;
+   chain.produce_blocks(30);
+   const uint32_t lib = chain.control->last_irreversible_block_num();
+   BOOST_REQUIRE(lib > 11);
+   const auto genesis = block_log::extract_genesis_state(chain.get_config().blocks_dir);
+   BOOST_REQUIRE(genesis);
+
+   fc::temp_directory temp_dir;
+   const auto blocks_dir = temp_dir.path() / "blocks";
+   {
+      block_log log(blocks_dir, 5);
+      log.reset(*genesis, chain.control->fetch_block_by_number(1));
+      for (uint32_t num = 2; num <= lib; ++num)
+         log.append(chain.control->fetch_block_by_number(num));
+   }
+
+   // blocks.log only has the chain id, the genesis state is in the first retained file
+   const auto extracted = block_log::extract_genesis_state(blocks_dir);
+   BOOST_REQUIRE(extracted);
+   BOOST_TEST(extracted->compute_chain_id() == chain.control->get_chain_id());
+
+   block_log::repair_log(blocks_dir);
+   block_log log(blocks_dir, 5);
+   BOOST_TEST(log.first_block_num() == 1u);
+   BOOST_TEST(log.head_id() == chain.control->fetch_block_by_number(lib)->id());
+   for (uint32_t num = 1; num <= lib; ++num)
+      BOOST_TEST(log.read_block_id_by_num(num) == chain.control->fetch_block_by_number(num)->id());
+}
+
+BOOST_AUTO_TEST_CASE(test_block_log_async_writes)
+{
+   tester chain;
+   chain.produce_blocks(30);
+   const uint32_t lib = chain.control->last_irreversible_block_num();
+   BOOST_REQUIRE(lib > 21);
+
+   fc::temp_directory temp_dir;
+   {
+      block_log log(temp_dir.path(), 5, std::numeric_limits<uint32_t>::max(), block_log_write_options{4, 3, true});
+      log.reset(chain.control->get_chain_id(), 2);
+      for (uint32_t num = 2; num <= lib; ++num) {
+         auto b = chain.control->fetch_block_by_number(num);
+         log.append(b);
+         // readable right away, from the queue or from the files
+         BOOST_TEST(log.head_id() == b->id());
+         BOOST_TEST(log.read_block_id_by_num(num) == b->id());
+         BOOST_TEST(log.read_serialized_block(num) == fc::raw::pack(*b));
+      }
+      log.flush();
+      BOOST_TEST(log.get_block_pos(lib) != block_log::npos);
+   }
+
+   block_log log(temp_dir.path(), 5);
+   BOOST_TEST(log.head_id() == chain.control->fetch_block_by_number(lib)->id());
+   BOOST_TEST(log.first_block_num() == 2u);
+   for (uint32_t num = 2; num <= lib; ++num)
+      BOOST_TEST(log.read_block_by_num(num)->id() == chain.control->fetch_block_by_number(num)->id());
+}
+
+BOOST_AUTO_TEST_CASE(test_block_log_parallel_index)
+{
+   tester chain;
+   chain.produce_blocks(200);
+   chain.close();
+
+   const auto blocks_dir = chain.get_config().blocks_dir;
+   fc::temp_directory temp_dir;
+   const auto sequential = temp_dir.path() / "sequential.index";
+   const auto parallel = temp_dir.path() / "parallel.index";
+   block_log::construct_index(blocks_dir / "blocks.log", sequential, 1);
+   block_log::construct_index(blocks_dir / "blocks.log", parallel, 4);
+
+   auto read_file = [](const fc::path& p) {
+      std::string content;
+      fc::read_file_contents(p, content);
+      return content;
+   };
+   BOOST_REQUIRE(fc::file_size(sequential) > 0);
+   BOOST_TEST(read_file(parallel) == read_file(sequential));
+   BOOST_TEST(read_file(parallel) == read_file(blocks_dir / "blocks.index"));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -312,6 +312,138 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(test_exhaustive_snapshot, SNAPSHOT_SUITE, snapshot
    }
 }
 
+BOOST_AUTO_TEST_CASE(test_threaded_snapshot_writer)
+{
+   tester chain;
+
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(1);
+   chain.set_code(N(snapshot), contracts::snapshot_test_wasm());
+   chain.set_abi(N(snapshot), contracts::snapshot_test_abi().data());
+   chain.push_action(N(snapshot), N(increment), N(snapshot), mutable_variant_object()
+      ( "value", 1 )
+   );
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   std::ostringstream expected_out;
+   auto expected_writer = std::make_shared<ostream_snapshot_writer>(expected_out);
+   chain.control->write_snapshot(expected_writer);
+   expected_writer->finalize();
+
+   // more threads than sections in flight and fewer, both have to keep the section order
+   for (size_t threads : {1, 2, 8}) {
+      std::ostringstream out;
+      auto writer = std::make_shared<threaded_ostream_snapshot_writer>(out, threads);
+      chain.control->write_snapshot(writer);
+      writer->finalize();
+      BOOST_REQUIRE(expected_out.str() == out.str());
+   }
+}
+
+BOOST_AUTO_TEST_CASE(test_tree_integrity_hash)
+{
+   tester chain;
+
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(1);
+   chain.set_code(N(snapshot), contracts::snapshot_test_wasm());
+   chain.set_abi(N(snapshot), contracts::snapshot_test_abi().data());
+   chain.push_action(N(snapshot), N(increment), N(snapshot), mutable_variant_object()
+      ( "value", 1 )
+   );
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   // the tree does not depend on the number of threads
+   const auto expected = chain.control->calculate_tree_integrity_hash(1);
+   for (size_t threads : {2, 8}) {
+      BOOST_REQUIRE_EQUAL(expected.str(), chain.control->calculate_tree_integrity_hash(threads).str());
+   }
+   BOOST_REQUIRE_NE(expected.str(), chain.control->calculate_integrity_hash().str());
+
+   chain.push_action(N(snapshot), N(increment), N(snapshot), mutable_variant_object()
+      ( "value", 1 )
+   );
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+   BOOST_REQUIRE_NE(expected.str(), chain.control->calculate_tree_integrity_hash(4).str());
+}
+
+BOOST_AUTO_TEST_CASE(test_diff_snapshot)
+{
+   tester chain;
+
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(1);
+   chain.set_code(N(snapshot), contracts::snapshot_test_wasm());
+   chain.set_abi(N(snapshot), contracts::snapshot_test_abi().data());
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   std::ostringstream base_out;
+   std::ostringstream index_out;
+   auto base_writer = std::make_shared<indexed_ostream_snapshot_writer>(base_out, index_out, chain.control->head_block_id());
+   chain.control->write_snapshot(base_writer);
+   base_writer->finalize();
+
+   // the same snapshot and row index as writing them separately
+   std::ostringstream plain_out;
+   auto plain_writer = std::make_shared<ostream_snapshot_writer>(plain_out);
+   chain.control->write_snapshot(plain_writer);
+   plain_writer->finalize();
+   BOOST_REQUIRE(plain_out.str() == base_out.str());
+
+   std::ostringstream separate_index_out;
+   auto index_writer = std::make_shared<snapshot_row_index_writer>(separate_index_out, chain.control->head_block_id());
+   chain.control->write_snapshot(index_writer);
+   index_writer->finalize();
+   BOOST_REQUIRE(separate_index_out.str() == index_out.str());
+   const auto base_id = chain.control->head_block_id();
+
+   // updated rows, new rows and an account created after the base
+   chain.create_account(N(snapshot1));
+   for (int itr = 0; itr < 4; itr++) {
+      chain.push_action(N(snapshot), N(increment), N(snapshot), mutable_variant_object()
+         ( "value", 1 )
+      );
+      chain.produce_block();
+   }
+   chain.control->abort_block();
+
+   std::ostringstream full_out;
+   auto full_writer = std::make_shared<ostream_snapshot_writer>(full_out);
+   chain.control->write_snapshot(full_writer);
+   full_writer->finalize();
+
+   std::istringstream base_in(base_out.str());
+   std::istringstream index_in(index_out.str());
+   std::ostringstream diff_out;
+   auto diff_writer = std::make_shared<diff_ostream_snapshot_writer>(diff_out, base_in, index_in, chain.control->head_block_id());
+   chain.control->write_snapshot(diff_writer);
+   diff_writer->finalize();
+   BOOST_REQUIRE(diff_writer->base_block_id() == base_id);
+   BOOST_REQUIRE_LT(diff_out.str().size(), full_out.str().size());
+
+   // the base and the diff load the same state as the full snapshot
+   auto base_storage = std::make_shared<std::istringstream>(base_out.str());
+   auto diff_storage = std::make_shared<std::istringstream>(diff_out.str());
+   auto reader = std::make_shared<diff_istream_snapshot_reader>(*base_storage, *diff_storage);
+   snapshotted_tester snap_chain(chain.get_config(), reader, 0);
+   verify_integrity_hash<buffered_snapshot_suite>(*chain.control, *snap_chain.control);
+
+   auto block = chain.produce_block();
+   chain.control->abort_block();
+   snap_chain.push_block(block);
+   verify_integrity_hash<buffered_snapshot_suite>(*chain.control, *snap_chain.control);
+
+   // a diff is only read against its base
+   std::istringstream other_base_in(full_out.str());
+   std::istringstream other_diff_in(diff_out.str());
+   diff_istream_snapshot_reader other_reader(other_base_in, other_diff_in);
+   BOOST_REQUIRE_THROW(other_reader.validate(), snapshot_exception);
+}
+
 BOOST_AUTO_TEST_CASE_TEMPLATE(test_replay_over_snapshot, SNAPSHOT_SUITE, snapshot_suites)
 {
    tester chain;
@@ -47,9 +47,9 @@ BOOST_FIXTURE_TEST_CASE(accounts_exists, tester)
       const auto& active_producers = control->head_block_state()->active_schedule;
 
       const auto& producers_active_authority = chain1_db.get<permission_object, by_owner>(boost::make_tuple(config::producers_account_name, config::active_name));
-      auto expected_threshold = (active_producers.producers.size() * 2)/3 + 1;
+      auto expected_threshold = (active_producers->producers.size() * 2)/3 + 1;
       BOOST_CHECK_EQUAL(producers_active_authority.auth.threshold, expected_threshold);
-      BOOST_CHECK_EQUAL(producers_active_authority.auth.accounts.size(), active_producers.producers.size());
+      BOOST_CHECK_EQUAL(producers_active_authority.auth.accounts.size(), active_producers->producers.size());
       BOOST_CHECK_EQUAL(producers_active_authority.auth.keys.size(), 0u);
 
       std::vector<account_name> active_auth;
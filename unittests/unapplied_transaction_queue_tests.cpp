@@ -306,5 +306,42 @@ BOOST_AUTO_TEST_CASE( unapplied_transaction_queue_test ) try {
 
 } FC_LOG_AND_RETHROW() /// unapplied_transaction_queue_test
 
+BOOST_AUTO_TEST_CASE( unapplied_transaction_queue_priority_test ) try {
+
+   unapplied_transaction_queue q;
+   auto trx1 = unique_trx_meta_data();
+   auto trx2 = unique_trx_meta_data();
+   auto trx3 = unique_trx_meta_data();
+   auto trx4 = unique_trx_meta_data();
+   auto trx5 = unique_trx_meta_data();
+
+   std::map<transaction_id_type, uint64_t> priorities{ {trx2->id(), 5}, {trx3->id(), 1}, {trx4->id(), 5} };
+   q.set_priority_function( [&priorities]( const transaction_metadata& trx ) -> uint64_t {
+      auto itr = priorities.find( trx.id() );
+      return itr != priorities.end() ? itr->second : 0;
+   } );
+
+   // persisted stay first regardless of priority, equal priorities keep insertion order
+   q.add_aborted( { trx1, trx2, trx3, trx4 } );
+   q.add_persisted( trx5 );
+   BOOST_CHECK( q.size() == 5 );
+   BOOST_REQUIRE( next( q ) == trx5 );
+   BOOST_REQUIRE( next( q ) == trx2 );
+   BOOST_REQUIRE( next( q ) == trx4 );
+   BOOST_REQUIRE( next( q ) == trx3 );
+   BOOST_REQUIRE( next( q ) == trx1 );
+   BOOST_REQUIRE( next( q ) == nullptr );
+
+   // a persisted transaction keeps its priority among the persisted ones
+   q.add_aborted( { trx1, trx2 } );
+   q.add_persisted( trx1 );
+   q.add_persisted( trx2 );
+   BOOST_REQUIRE( q.persisted_begin()->trx_meta == trx2 );
+   BOOST_REQUIRE( next( q ) == trx2 );
+   BOOST_REQUIRE( next( q ) == trx1 );
+   BOOST_CHECK( q.empty() );
+
+} FC_LOG_AND_RETHROW() /// unapplied_transaction_queue_priority_test
+
 
 BOOST_AUTO_TEST_SUITE_END()
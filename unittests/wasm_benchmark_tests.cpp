@@ -0,0 +1,173 @@
+#include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/wasm_interface.hpp>
+#include <eosio/testing/tester.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <contracts.hpp>
+#include "test_wasts.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include <unistd.h>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+using mvo = fc::mutable_variant_object;
+
+/*
+ * Fixed workloads executed under the runtime selected on the command line (-- --wabt, --eos-vm, --eos-vm-jit,
+ * --eos-vm-oc), so each runtime is benchmarked by its own unit test of this suite. Every workload prints one line
+ *    benchmark {"runtime":...,"workload":...,...}
+ * for regression tracking. EOSIO_BENCHMARK_ACTIONS overrides the number of measured actions per workload.
+ * Latencies are the action elapsed times of the traces, the first one includes instantiating the contract.
+ */
+
+struct wasm_benchmark_result {
+   std::string runtime;
+   std::string workload;
+   uint32_t    actions = 0;
+   int64_t     first_us = 0;  ///< first execution, after setcode
+   int64_t     p50_us = 0;
+   int64_t     p90_us = 0;
+   int64_t     p99_us = 0;
+   int64_t     max_us = 0;
+   int64_t     total_us = 0;
+   int64_t     rss_kb = 0;        ///< resident set after the workload
+   int64_t     rss_growth_kb = 0; ///< during the workload
+};
+FC_REFLECT( wasm_benchmark_result, (runtime)(workload)(actions)(first_us)(p50_us)(p90_us)(p99_us)(max_us)(total_us)(rss_kb)(rss_growth_kb) )
+
+namespace {
+
+int64_t resident_kb() {
+   std::ifstream statm( "/proc/self/statm" );
+   int64_t size = 0, resident = 0;
+   statm >> size >> resident;
+   return resident * (sysconf( _SC_PAGESIZE ) / 1024);
+}
+
+uint32_t benchmark_actions() {
+   if( const char* a = getenv( "EOSIO_BENCHMARK_ACTIONS" ) )
+      return std::max( 1, atoi( a ) );
+   return 50;
+}
+
+class wasm_benchmark_tester : public tester {
+public:
+   /// runs push(i) for the first and then the measured actions, each pushing one transaction
+   template<typename Push>
+   wasm_benchmark_result run( const std::string& workload, Push&& push ) {
+      wasm_benchmark_result r;
+      r.runtime = wasm_interface::vm_type_string( get_config().wasm_runtime );
+      r.workload = workload;
+      r.actions = benchmark_actions();
+
+      r.first_us = elapsed_us( push( 0 ) );
+
+      const int64_t rss_before = resident_kb();
+      std::vector<int64_t> latencies;
+      latencies.reserve( r.actions );
+      for( uint32_t i = 1; i <= r.actions; ++i ) {
+         latencies.push_back( elapsed_us( push( i ) ) );
+         if( i % 100 == 0 )
+            produce_block();
+      }
+      produce_block();
+      r.rss_kb = resident_kb();
+      r.rss_growth_kb = r.rss_kb - rss_before;
+
+      std::sort( latencies.begin(), latencies.end() );
+      auto percentile = [&]( uint32_t p ) { return latencies[std::min<size_t>( latencies.size() - 1, latencies.size() * p / 100 )]; };
+      r.p50_us = percentile( 50 );
+      r.p90_us = percentile( 90 );
+      r.p99_us = percentile( 99 );
+      r.max_us = latencies.back();
+      for( auto l : latencies )
+         r.total_us += l;
+
+      std::cout << "benchmark " << fc::json::to_string( r, fc::time_point::maximum() ) << std::endl;
+      return r;
+   }
+
+   /// one action of a raw wast contract, distinct action names keep the transactions unique
+   transaction_trace_ptr push_wast_action( account_name account, uint32_t i ) {
+      signed_transaction trx;
+      action act;
+      act.account = account;
+      act.name = name( i );
+      act.authorization = vector<permission_level>{{account, config::active_name}};
+      trx.actions.push_back( act );
+      set_transaction_headers( trx );
+      trx.sign( get_private_key( account, "active" ), control->get_chain_id() );
+      return push_transaction( trx );
+   }
+
+   void run_wast( account_name account, const char* wast, const std::string& workload ) {
+      create_accounts( {account} );
+      set_code( account, wast );
+      produce_block();
+      run( workload, [&]( uint32_t i ) { return push_wast_action( account, i ); } );
+   }
+
+private:
+   static int64_t elapsed_us( const transaction_trace_ptr& trace ) {
+      BOOST_REQUIRE( trace );
+      BOOST_REQUIRE( !trace->except );
+      BOOST_REQUIRE( !trace->action_traces.empty() );
+      return trace->action_traces[0].elapsed.count(); // notifications of the action are not counted
+   }
+};
+
+}
+
+BOOST_AUTO_TEST_SUITE(wasm_benchmark_tests)
+
+BOOST_FIXTURE_TEST_CASE( token_transfer_benchmark, wasm_benchmark_tester ) try {
+   create_accounts( {N(eosio.token), N(alice), N(bob)} );
+   set_code( N(eosio.token), contracts::eosio_token_wasm() );
+   set_abi( N(eosio.token), contracts::eosio_token_abi().data() );
+   produce_block();
+
+   push_action( N(eosio.token), N(create), N(eosio.token), mvo()
+      ("issuer", "alice")
+      ("maximum_supply", "1000000000.0000 TKN") );
+   push_action( N(eosio.token), N(issue), N(alice), mvo()
+      ("to", "alice")
+      ("quantity", "1000000000.0000 TKN")
+      ("memo", "") );
+   produce_block();
+
+   run( "token_transfer", [&]( uint32_t i ) {
+      return push_action( N(eosio.token), N(transfer), N(alice), mvo()
+         ("from", "alice")
+         ("to", "bob")
+         ("quantity", "0.0001 TKN")
+         ("memo", std::to_string( i )) );
+   } );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( db_update_benchmark, wasm_benchmark_tester ) try {
+   run_wast( N(dbbench), db_intrinsics_benchmark_wast, "db_update" );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( db_scan_benchmark, wasm_benchmark_tester ) try {
+   run_wast( N(scanbench), db_scan_benchmark_wast, "db_scan" );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( crypto_benchmark, wasm_benchmark_tester ) try {
+   run_wast( N(cryptobench), crypto_benchmark_wast, "crypto" );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( softfloat_benchmark, wasm_benchmark_tester ) try {
+   run_wast( N(floatbench), softfloat_benchmark_wast, "softfloat" );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,7 @@
 #include <utility>
 
 #include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/resource_limits.hpp>
@@ -2144,4 +2145,32 @@ BOOST_FIXTURE_TEST_CASE(weighted_net_usage_tests, tester ) try {
 } FC_LOG_AND_RETHROW()
 #endif
 
+// reports the average cost of a table intrinsic call, run with --log_level=message to see it
+BOOST_FIXTURE_TEST_CASE( db_intrinsics_benchmark, TESTER ) try {
+   create_accounts( {N(dbbench)} );
+   set_code( N(dbbench), db_intrinsics_benchmark_wast );
+   produce_block();
+
+   constexpr uint32_t calls_per_action = 4000;
+   constexpr uint32_t actions = 20;
+   int64_t elapsed_us = 0;
+   for( uint32_t i = 0; i < actions; ++i ) {
+      signed_transaction trx;
+      action act;
+      act.account = N(dbbench);
+      act.name = name(i);
+      act.authorization = vector<permission_level>{{N(dbbench),config::active_name}};
+      trx.actions.push_back(act);
+      set_transaction_headers(trx);
+      trx.sign(get_private_key( N(dbbench), "active" ), control->get_chain_id());
+      auto trace = push_transaction(trx);
+      BOOST_REQUIRE_EQUAL( trace->action_traces.size(), 1u );
+      elapsed_us += trace->action_traces[0].elapsed.count();
+   }
+   produce_block();
+
+   BOOST_CHECK( control->db().find<table_id_object, by_code_scope_table>(boost::make_tuple(N(dbbench), N(dbbench), N(bench))) == nullptr );
+   BOOST_TEST_MESSAGE( "db intrinsics: " << (elapsed_us * 1000 / (actions * calls_per_action)) << " ns per call" );
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()